@@ -20,7 +20,7 @@ extern int json_get_int_field(const char* json, const char* field, int defaultVa
 // External persistence functions
 extern int persistent_storage_write(const char* key, const void* data, size_t size);
 extern int persistent_storage_read(const char* key, void* data, size_t maxSize, size_t* actualSize);
-extern int persistent_storage_get_keys(char** keys, size_t maxKeys);
+extern int persistent_storage_get_keys_with_prefix(const char* prefix, char** keys, size_t maxKeys);
 
 // Maximum bytecode program size (in bytes)
 #define MAX_DRIVER_BYTECODE_SIZE (8 * 1024)
@@ -968,9 +968,9 @@ int MCP_BytecodeDriverLoadAll(void) {
         return -1;
     }
 
-    // Get all keys from persistent storage
+    // Get the driver keys from persistent storage
     char* keys[128];
-    int keyCount = persistent_storage_get_keys(keys, 128);
+    int keyCount = persistent_storage_get_keys_with_prefix("driver_", keys, 128);
     if (keyCount <= 0) {
         return 0;  // No keys found
     }
@@ -1,4 +1,5 @@
 #include "config_system.h"
+#include "../../util/crc32.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -6,6 +7,19 @@
 // Forward declaration of persistent storage interface
 extern int persistent_storage_write(const char* key, const void* data, size_t size);
 extern int persistent_storage_read(const char* key, void* data, size_t maxSize, size_t* actualSize);
+extern bool persistent_storage_exists(const char* key);
+extern int persistent_storage_delete(const char* key);
+extern int persistent_storage_get_size(const char* key);
+extern int persistent_storage_begin_transaction(void);
+extern int persistent_storage_end_transaction(void);
+
+// Change subscription
+typedef struct {
+    char* prefix;
+    size_t prefixLength;
+    MCP_ConfigChangeCallback callback;
+    void* context;
+} ConfigSubscription;
 
 // Internal state
 static MCP_ConfigEntry* s_entries = NULL;
@@ -13,10 +27,28 @@ static uint16_t s_maxEntries = 0;
 static uint16_t s_entryCount = 0;
 static bool s_initialized = false;
 
+// Open-addressing hash index over s_entries
+static int32_t* s_buckets = NULL;      // Entry index or -1 when empty
+static uint32_t s_bucketMask = 0;      // Bucket count - 1 (bucket count is a power of two)
+
+static ConfigSubscription s_subscriptions[MCP_CONFIG_MAX_SUBSCRIBERS];
+
+// Persistence state
+static uint32_t s_snapshotSequence = 0;    // 0 until a snapshot is loaded or saved
+static size_t s_snapshotSize = 0;
+static bool s_unsaved = false;             // Changes since the last save of either blob
+static bool s_snapshotNeeded = false;      // A removal could not be recorded for the delta
+static char** s_removedKeys = NULL;        // Keys removed since the last snapshot
+static uint16_t s_removedCount = 0;
+static uint16_t s_removedCapacity = 0;
+
 int MCP_ConfigInit(uint16_t maxEntries) {
     if (s_initialized) {
         return -1;  // Already initialized
     }
+    if (maxEntries == MCP_CONFIG_INVALID_INDEX) {
+        return -3;  // Index reserved for invalid handles
+    }
     
     // Allocate entry array
     s_entries = (MCP_ConfigEntry*)calloc(maxEntries, sizeof(MCP_ConfigEntry));
@@ -24,6 +56,20 @@ int MCP_ConfigInit(uint16_t maxEntries) {
         return -2;  // Memory allocation failed
     }
     
+    // Keep the load factor at or below 50%
+    uint32_t bucketCount = 16;
+    while (bucketCount < (uint32_t)maxEntries * 2) {
+        bucketCount *= 2;
+    }
+    s_buckets = (int32_t*)malloc(bucketCount * sizeof(int32_t));
+    if (s_buckets == NULL) {
+        free(s_entries);
+        s_entries = NULL;
+        return -2;  // Memory allocation failed
+    }
+    memset(s_buckets, 0xFF, bucketCount * sizeof(int32_t));
+    s_bucketMask = bucketCount - 1;
+    
     s_maxEntries = maxEntries;
     s_entryCount = 0;
     s_initialized = true;
@@ -31,18 +77,136 @@ int MCP_ConfigInit(uint16_t maxEntries) {
     return 0;
 }
 
+// FNV-1a hash of a key
+static uint32_t hashKey(const char* key) {
+    uint32_t hash = 2166136261u;
+    while (*key != '\0') {
+        hash ^= (uint8_t)*key++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Bucket holding the entry with this key, or the empty bucket where it would go
+static uint32_t findBucket(const char* key, uint32_t hash) {
+    uint32_t bucket = hash & s_bucketMask;
+    for (;;) {
+        int32_t index = s_buckets[bucket];
+        if (index < 0) {
+            return bucket;
+        }
+        
+        const MCP_ConfigEntry* entry = &s_entries[index];
+        if (entry->hash == hash && strcmp(entry->key, key) == 0) {
+            return bucket;
+        }
+        
+        bucket = (bucket + 1) & s_bucketMask;
+    }
+}
+
+// Take an entry out of the index, shifting back later entries of its probe run
+static void unindexEntry(const MCP_ConfigEntry* entry) {
+    uint32_t hole = findBucket(entry->key, entry->hash);
+    uint32_t next = (hole + 1) & s_bucketMask;
+    
+    while (s_buckets[next] >= 0) {
+        uint32_t home = s_entries[s_buckets[next]].hash & s_bucketMask;
+        
+        // An entry may fill the hole unless its home bucket lies between the two
+        if (((next - home) & s_bucketMask) >= ((next - hole) & s_bucketMask)) {
+            s_buckets[hole] = s_buckets[next];
+            hole = next;
+        }
+        next = (next + 1) & s_bucketMask;
+    }
+    s_buckets[hole] = -1;
+}
+
 static MCP_ConfigEntry* findEntry(const char* key) {
     if (!s_initialized || key == NULL) {
         return NULL;
     }
     
-    for (uint16_t i = 0; i < s_maxEntries; i++) {
-        if (s_entries[i].key != NULL && strcmp(s_entries[i].key, key) == 0) {
-            return &s_entries[i];
-        }
+    int32_t index = s_buckets[findBucket(key, hashKey(key))];
+    return index >= 0 ? &s_entries[index] : NULL;
+}
+
+static MCP_ConfigHandle entryHandle(const MCP_ConfigEntry* entry) {
+    MCP_ConfigHandle handle;
+    handle.index = (uint16_t)(entry - s_entries);
+    handle.generation = entry->generation;
+    return handle;
+}
+
+static MCP_ConfigEntry* handleEntry(MCP_ConfigHandle handle) {
+    if (!s_initialized || handle.index >= s_maxEntries) {
+        return NULL;
     }
     
-    return NULL;
+    MCP_ConfigEntry* entry = &s_entries[handle.index];
+    if (entry->key == NULL || entry->generation != handle.generation) {
+        return NULL;
+    }
+    return entry;
+}
+
+// Note a change the next save has to write
+static void markUnsaved(MCP_ConfigEntry* entry) {
+    entry->dirty = true;
+    s_unsaved = true;
+}
+
+// Note a removal the next delta has to record, unless the key was never stored
+static void rememberRemoved(const MCP_ConfigEntry* entry) {
+    if (!entry->persistent && !entry->dirty) {
+        return;
+    }
+    s_unsaved = true;
+    
+    for (uint16_t i = 0; i < s_removedCount; i++) {
+        if (strcmp(s_removedKeys[i], entry->key) == 0) {
+            return;
+        }
+    }
+    if (s_removedCount == s_removedCapacity) {
+        uint16_t capacity = s_removedCapacity == 0 ? 8 : (uint16_t)(s_removedCapacity * 2);
+        char** grown = (char**)realloc(s_removedKeys, capacity * sizeof(char*));
+        if (grown == NULL) {
+            // Without a record the next save has to be a full snapshot
+            s_snapshotNeeded = true;
+            return;
+        }
+        s_removedKeys = grown;
+        s_removedCapacity = capacity;
+    }
+    s_removedKeys[s_removedCount] = strdup(entry->key);
+    if (s_removedKeys[s_removedCount] == NULL) {
+        s_snapshotNeeded = true;
+        return;
+    }
+    s_removedCount++;
+}
+
+static void clearRemovedKeys(void) {
+    for (uint16_t i = 0; i < s_removedCount; i++) {
+        free(s_removedKeys[i]);
+    }
+    free(s_removedKeys);
+    s_removedKeys = NULL;
+    s_removedCount = 0;
+    s_removedCapacity = 0;
+}
+
+// Tell the subscribers whose prefix matches the key
+static void notifyChange(const char* key, MCP_ConfigHandle handle) {
+    for (int i = 0; i < MCP_CONFIG_MAX_SUBSCRIBERS; i++) {
+        const ConfigSubscription* subscription = &s_subscriptions[i];
+        if (subscription->callback != NULL &&
+            (subscription->prefixLength == 0 || strncmp(key, subscription->prefix, subscription->prefixLength) == 0)) {
+            subscription->callback(key, handle, subscription->context);
+        }
+    }
 }
 
 static MCP_ConfigEntry* allocateEntry(const char* key) {
@@ -51,9 +215,10 @@ static MCP_ConfigEntry* allocateEntry(const char* key) {
     }
     
     // Check if entry already exists
-    MCP_ConfigEntry* entry = findEntry(key);
-    if (entry != NULL) {
-        return entry;
+    uint32_t hash = hashKey(key);
+    uint32_t bucket = findBucket(key, hash);
+    if (s_buckets[bucket] >= 0) {
+        return &s_entries[s_buckets[bucket]];
     }
     
     // Check if we have space for a new entry
@@ -79,6 +244,11 @@ static MCP_ConfigEntry* allocateEntry(const char* key) {
         return NULL;  // Memory allocation failed
     }
     
+    s_entries[i].hash = hash;
+    s_entries[i].type = MCP_CONFIG_TYPE_NONE;
+    s_entries[i].persistent = false;
+    s_entries[i].dirty = false;
+    s_buckets[bucket] = (int32_t)i;
     s_entryCount++;
     
     return &s_entries[i];
@@ -116,14 +286,22 @@ int MCP_ConfigSetBool(const char* key, bool value, bool persistent) {
         return -1;
     }
     
+    bool changed = entry->type != MCP_CONFIG_TYPE_BOOL || entry->value.boolValue != value;
+    
     // Free previous value if needed
     freeEntryValue(entry);
     
     // Set new value
     entry->type = MCP_CONFIG_TYPE_BOOL;
     entry->value.boolValue = value;
+    if (changed || entry->persistent != persistent) {
+        markUnsaved(entry);
+    }
     entry->persistent = persistent;
     
+    if (changed) {
+        notifyChange(entry->key, entryHandle(entry));
+    }
     return 0;
 }
 
@@ -133,14 +311,22 @@ int MCP_ConfigSetInt(const char* key, int32_t value, bool persistent) {
         return -1;
     }
     
+    bool changed = entry->type != MCP_CONFIG_TYPE_INT || entry->value.intValue != value;
+    
     // Free previous value if needed
     freeEntryValue(entry);
     
     // Set new value
     entry->type = MCP_CONFIG_TYPE_INT;
     entry->value.intValue = value;
+    if (changed || entry->persistent != persistent) {
+        markUnsaved(entry);
+    }
     entry->persistent = persistent;
     
+    if (changed) {
+        notifyChange(entry->key, entryHandle(entry));
+    }
     return 0;
 }
 
@@ -150,14 +336,22 @@ int MCP_ConfigSetFloat(const char* key, float value, bool persistent) {
         return -1;
     }
     
+    bool changed = entry->type != MCP_CONFIG_TYPE_FLOAT || entry->value.floatValue != value;
+    
     // Free previous value if needed
     freeEntryValue(entry);
     
     // Set new value
     entry->type = MCP_CONFIG_TYPE_FLOAT;
     entry->value.floatValue = value;
+    if (changed || entry->persistent != persistent) {
+        markUnsaved(entry);
+    }
     entry->persistent = persistent;
     
+    if (changed) {
+        notifyChange(entry->key, entryHandle(entry));
+    }
     return 0;
 }
 
@@ -171,6 +365,16 @@ int MCP_ConfigSetString(const char* key, const char* value, bool persistent) {
         return -1;
     }
     
+    // An unchanged string keeps its copy, so pointers handed out stay valid
+    if (entry->type == MCP_CONFIG_TYPE_STRING && entry->value.stringValue != NULL &&
+        strcmp(entry->value.stringValue, value) == 0) {
+        if (entry->persistent != persistent) {
+            markUnsaved(entry);
+        }
+        entry->persistent = persistent;
+        return 0;
+    }
+    
     // Free previous value if needed
     freeEntryValue(entry);
     
@@ -181,8 +385,10 @@ int MCP_ConfigSetString(const char* key, const char* value, bool persistent) {
         return -3;  // Memory allocation failed
     }
     
+    markUnsaved(entry);
     entry->persistent = persistent;
     
+    notifyChange(entry->key, entryHandle(entry));
     return 0;
 }
 
@@ -192,14 +398,22 @@ int MCP_ConfigSetObject(const char* key, void* value, bool persistent) {
         return -1;
     }
     
+    bool changed = entry->type != MCP_CONFIG_TYPE_OBJECT || entry->value.objectValue != value;
+    
     // Free previous value if needed
     freeEntryValue(entry);
     
     // Set new value
     entry->type = MCP_CONFIG_TYPE_OBJECT;
     entry->value.objectValue = value;
+    if (changed || entry->persistent != persistent) {
+        markUnsaved(entry);
+    }
     entry->persistent = persistent;
     
+    if (changed) {
+        notifyChange(entry->key, entryHandle(entry));
+    }
     return 0;
 }
 
@@ -254,6 +468,16 @@ int MCP_ConfigRemove(const char* key) {
         return -1;  // Entry not found
     }
     
+    // Handles to the entry go stale before subscribers hear of it
+    MCP_ConfigHandle handle = entryHandle(entry);
+    bool wasSet = entry->type != MCP_CONFIG_TYPE_NONE;
+    rememberRemoved(entry);
+    unindexEntry(entry);
+    entry->generation++;
+    if (wasSet) {
+        notifyChange(entry->key, handle);
+    }
+    
     // Free entry
     freeEntry(entry);
     s_entryCount--;
@@ -261,77 +485,524 @@ int MCP_ConfigRemove(const char* key) {
     return 0;
 }
 
-// Structure for persistent storage
-typedef struct {
-    char key[64];
-    MCP_ConfigType type;
-    union {
-        bool boolValue;
-        int32_t intValue;
-        float floatValue;
-        char stringValue[256];  // Fixed size for simplicity
-    } value;
-} StoredConfigEntry;
+MCP_ConfigHandle MCP_ConfigGetHandle(const char* key) {
+    MCP_ConfigEntry* entry = allocateEntry(key);
+    if (entry == NULL) {
+        MCP_ConfigHandle invalid;
+        invalid.index = MCP_CONFIG_INVALID_INDEX;
+        invalid.generation = 0;
+        return invalid;
+    }
+    
+    return entryHandle(entry);
+}
 
-int MCP_ConfigSave(void) {
-    if (!s_initialized) {
+bool MCP_ConfigHandleValid(MCP_ConfigHandle handle) {
+    return handleEntry(handle) != NULL;
+}
+
+bool MCP_ConfigHandleGetBool(MCP_ConfigHandle handle, bool defaultValue) {
+    const MCP_ConfigEntry* entry = handleEntry(handle);
+    if (entry == NULL || entry->type != MCP_CONFIG_TYPE_BOOL) {
+        return defaultValue;
+    }
+    
+    return entry->value.boolValue;
+}
+
+int32_t MCP_ConfigHandleGetInt(MCP_ConfigHandle handle, int32_t defaultValue) {
+    const MCP_ConfigEntry* entry = handleEntry(handle);
+    if (entry == NULL || entry->type != MCP_CONFIG_TYPE_INT) {
+        return defaultValue;
+    }
+    
+    return entry->value.intValue;
+}
+
+float MCP_ConfigHandleGetFloat(MCP_ConfigHandle handle, float defaultValue) {
+    const MCP_ConfigEntry* entry = handleEntry(handle);
+    if (entry == NULL || entry->type != MCP_CONFIG_TYPE_FLOAT) {
+        return defaultValue;
+    }
+    
+    return entry->value.floatValue;
+}
+
+const char* MCP_ConfigHandleGetString(MCP_ConfigHandle handle, const char* defaultValue) {
+    const MCP_ConfigEntry* entry = handleEntry(handle);
+    if (entry == NULL || entry->type != MCP_CONFIG_TYPE_STRING || entry->value.stringValue == NULL) {
+        return defaultValue;
+    }
+    
+    return entry->value.stringValue;
+}
+
+void* MCP_ConfigHandleGetObject(MCP_ConfigHandle handle, void* defaultValue) {
+    const MCP_ConfigEntry* entry = handleEntry(handle);
+    if (entry == NULL || entry->type != MCP_CONFIG_TYPE_OBJECT) {
+        return defaultValue;
+    }
+    
+    return entry->value.objectValue;
+}
+
+int MCP_ConfigSubscribe(const char* prefix, MCP_ConfigChangeCallback callback, void* context) {
+    if (callback == NULL) {
         return -1;
     }
     
-    // For each persistent entry, save to storage
+    for (int i = 0; i < MCP_CONFIG_MAX_SUBSCRIBERS; i++) {
+        ConfigSubscription* subscription = &s_subscriptions[i];
+        if (subscription->callback != NULL) {
+            continue;
+        }
+        
+        subscription->prefix = NULL;
+        subscription->prefixLength = prefix != NULL ? strlen(prefix) : 0;
+        if (subscription->prefixLength > 0) {
+            subscription->prefix = strdup(prefix);
+            if (subscription->prefix == NULL) {
+                return -3;  // Memory allocation failed
+            }
+        }
+        subscription->callback = callback;
+        subscription->context = context;
+        return i;
+    }
+    
+    return -2;  // No free subscription
+}
+
+int MCP_ConfigUnsubscribe(int subscription) {
+    if (subscription < 0 || subscription >= MCP_CONFIG_MAX_SUBSCRIBERS ||
+        s_subscriptions[subscription].callback == NULL) {
+        return -1;
+    }
+    
+    free(s_subscriptions[subscription].prefix);
+    memset(&s_subscriptions[subscription], 0, sizeof(ConfigSubscription));
+    return 0;
+}
+
+void MCP_ConfigDeinit(void) {
+    if (!s_initialized) {
+        return;
+    }
+    
     for (uint16_t i = 0; i < s_maxEntries; i++) {
-        if (s_entries[i].key != NULL && s_entries[i].persistent) {
-            StoredConfigEntry storedEntry;
-            memset(&storedEntry, 0, sizeof(StoredConfigEntry));
-            
-            // Copy key and type
-            strncpy(storedEntry.key, s_entries[i].key, sizeof(storedEntry.key) - 1);
-            storedEntry.type = s_entries[i].type;
+        freeEntry(&s_entries[i]);
+    }
+    for (int i = 0; i < MCP_CONFIG_MAX_SUBSCRIBERS; i++) {
+        free(s_subscriptions[i].prefix);
+    }
+    memset(s_subscriptions, 0, sizeof(s_subscriptions));
+    clearRemovedKeys();
+    s_snapshotSequence = 0;
+    s_snapshotSize = 0;
+    s_unsaved = false;
+    s_snapshotNeeded = false;
+    
+    free(s_entries);
+    free(s_buckets);
+    s_entries = NULL;
+    s_buckets = NULL;
+    s_bucketMask = 0;
+    s_maxEntries = 0;
+    s_entryCount = 0;
+    s_initialized = false;
+}
+
+// Blob layout, all fields little-endian:
+//   [magic u32][format u8][kind u8][record count u16][sequence u32][payload length u32][crc u32]
+//   record: [type u8][key length u16][key][value]
+//   value: bool u8, int i32, float f32 bits, string [length u16][bytes]; nothing for a removal
+// A snapshot carries its own sequence, a delta the sequence of the snapshot it applies to.
+#define CONFIG_SNAPSHOT_KEY "config.blob"
+#define CONFIG_DELTA_KEY "config.delta"
+#define CONFIG_BLOB_MAGIC 0x4746434Du      // "MCFG"
+#define CONFIG_BLOB_FORMAT 1
+#define CONFIG_BLOB_SNAPSHOT 0
+#define CONFIG_BLOB_DELTA 1
+#define CONFIG_BLOB_HEADER_SIZE 20
+#define CONFIG_RECORD_REMOVED 0xFF
+
+// A save writes a new snapshot once the delta grows past this fraction of it
+#define CONFIG_DELTA_DIVISOR 4
+
+// Blob being assembled
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+    uint16_t records;
+    bool failed;
+} ConfigBlob;
+
+static void blobPut(ConfigBlob* blob, const void* data, size_t size) {
+    if (blob->failed) {
+        return;
+    }
+    if (blob->size + size > blob->capacity) {
+        size_t capacity = blob->capacity == 0 ? 256 : blob->capacity;
+        while (capacity < blob->size + size) {
+            capacity *= 2;
+        }
+        uint8_t* grown = (uint8_t*)realloc(blob->data, capacity);
+        if (grown == NULL) {
+            blob->failed = true;
+            return;
+        }
+        blob->data = grown;
+        blob->capacity = capacity;
+    }
+    memcpy(blob->data + blob->size, data, size);
+    blob->size += size;
+}
+
+static void blobPutU16(ConfigBlob* blob, uint16_t value) {
+    uint8_t bytes[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
+    blobPut(blob, bytes, sizeof(bytes));
+}
+
+static void writeU32(uint8_t* bytes, uint32_t value) {
+    bytes[0] = (uint8_t)value;
+    bytes[1] = (uint8_t)(value >> 8);
+    bytes[2] = (uint8_t)(value >> 16);
+    bytes[3] = (uint8_t)(value >> 24);
+}
+
+static void blobPutU32(ConfigBlob* blob, uint32_t value) {
+    uint8_t bytes[4];
+    writeU32(bytes, value);
+    blobPut(blob, bytes, sizeof(bytes));
+}
+
+static uint16_t readU16(const uint8_t* bytes) {
+    return (uint16_t)(bytes[0] | (bytes[1] << 8));
+}
+
+static uint32_t readU32(const uint8_t* bytes) {
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+// Whether an entry's value goes into the snapshot
+static bool isStored(const MCP_ConfigEntry* entry) {
+    return entry->key != NULL && entry->persistent &&
+           (entry->type == MCP_CONFIG_TYPE_BOOL || entry->type == MCP_CONFIG_TYPE_INT ||
+            entry->type == MCP_CONFIG_TYPE_FLOAT || entry->type == MCP_CONFIG_TYPE_STRING);
+}
+
+static void blobPutKey(ConfigBlob* blob, uint8_t type, const char* key) {
+    size_t length = strlen(key);
+    if (length > UINT16_MAX || blob->records == UINT16_MAX) {
+        blob->failed = true;
+        return;
+    }
+    blobPut(blob, &type, 1);
+    blobPutU16(blob, (uint16_t)length);
+    blobPut(blob, key, length);
+    blob->records++;
+}
+
+static void blobPutEntry(ConfigBlob* blob, const MCP_ConfigEntry* entry) {
+    if (!isStored(entry)) {
+        blobPutKey(blob, CONFIG_RECORD_REMOVED, entry->key);
+        return;
+    }
+    
+    blobPutKey(blob, (uint8_t)entry->type, entry->key);
+    switch (entry->type) {
+        case MCP_CONFIG_TYPE_BOOL: {
+            uint8_t value = entry->value.boolValue ? 1 : 0;
+            blobPut(blob, &value, 1);
+            break;
+        }
+        
+        case MCP_CONFIG_TYPE_INT:
+            blobPutU32(blob, (uint32_t)entry->value.intValue);
+            break;
             
-            // Copy value based on type
-            switch (s_entries[i].type) {
-                case MCP_CONFIG_TYPE_BOOL:
-                    storedEntry.value.boolValue = s_entries[i].value.boolValue;
-                    break;
-                    
-                case MCP_CONFIG_TYPE_INT:
-                    storedEntry.value.intValue = s_entries[i].value.intValue;
-                    break;
-                    
-                case MCP_CONFIG_TYPE_FLOAT:
-                    storedEntry.value.floatValue = s_entries[i].value.floatValue;
-                    break;
-                    
-                case MCP_CONFIG_TYPE_STRING:
-                    if (s_entries[i].value.stringValue != NULL) {
-                        strncpy(storedEntry.value.stringValue, s_entries[i].value.stringValue, 
-                               sizeof(storedEntry.value.stringValue) - 1);
-                    }
-                    break;
-                    
-                case MCP_CONFIG_TYPE_OBJECT:
-                    // Not saving objects for simplicity
-                    break;
+        case MCP_CONFIG_TYPE_FLOAT: {
+            uint32_t bits;
+            memcpy(&bits, &entry->value.floatValue, sizeof(bits));
+            blobPutU32(blob, bits);
+            break;
+        }
+        
+        case MCP_CONFIG_TYPE_STRING: {
+            const char* value = entry->value.stringValue != NULL ? entry->value.stringValue : "";
+            size_t length = strlen(value);
+            if (length > UINT16_MAX) {
+                blob->failed = true;
+                return;
             }
-            
-            // Write to storage
-            persistent_storage_write(s_entries[i].key, &storedEntry, sizeof(StoredConfigEntry));
+            blobPutU16(blob, (uint16_t)length);
+            blobPut(blob, value, length);
+            break;
         }
+        
+        default:
+            break;
+    }
+}
+
+// Reserve room for the header; blobFinish fills it in
+static void blobBegin(ConfigBlob* blob) {
+    memset(blob, 0, sizeof(ConfigBlob));
+    uint8_t header[CONFIG_BLOB_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    blobPut(blob, header, sizeof(header));
+}
+
+static void blobFinish(ConfigBlob* blob, uint8_t kind, uint32_t sequence) {
+    if (blob->failed) {
+        return;
+    }
+    
+    uint8_t* header = blob->data;
+    uint32_t payloadLength = (uint32_t)(blob->size - CONFIG_BLOB_HEADER_SIZE);
+    writeU32(header, CONFIG_BLOB_MAGIC);
+    header[4] = CONFIG_BLOB_FORMAT;
+    header[5] = kind;
+    header[6] = (uint8_t)blob->records;
+    header[7] = (uint8_t)(blob->records >> 8);
+    writeU32(header + 8, sequence);
+    writeU32(header + 12, payloadLength);
+    
+    // The checksum covers the header fields before it and the payload
+    writeU32(header + 16, MCP_Crc32Update(MCP_Crc32(header, 16), header + CONFIG_BLOB_HEADER_SIZE, payloadLength));
+}
+
+static int saveSnapshot(void) {
+    ConfigBlob blob;
+    blobBegin(&blob);
+    for (uint16_t i = 0; i < s_maxEntries; i++) {
+        if (isStored(&s_entries[i])) {
+            blobPutEntry(&blob, &s_entries[i]);
+        }
+    }
+    
+    uint32_t sequence = s_snapshotSequence + 1;
+    blobFinish(&blob, CONFIG_BLOB_SNAPSHOT, sequence);
+    if (blob.failed) {
+        free(blob.data);
+        return -3;  // Memory allocation failed or value too long
+    }
+    
+    int result = persistent_storage_write(CONFIG_SNAPSHOT_KEY, blob.data, blob.size);
+    if (result == 0 && persistent_storage_exists(CONFIG_DELTA_KEY)) {
+        result = persistent_storage_delete(CONFIG_DELTA_KEY);
+    }
+    free(blob.data);
+    if (result != 0) {
+        return result;
     }
     
+    for (uint16_t i = 0; i < s_maxEntries; i++) {
+        s_entries[i].dirty = false;
+    }
+    clearRemovedKeys();
+    s_snapshotNeeded = false;
+    s_snapshotSequence = sequence;
+    s_snapshotSize = blob.size;
     return 0;
 }
 
-int MCP_ConfigLoad(void) {
+// Write the changes since the snapshot, or a new snapshot once they are too many
+static int saveDelta(void) {
+    ConfigBlob blob;
+    blobBegin(&blob);
+    
+    // Removals go first so a key removed and set again ends up set
+    for (uint16_t i = 0; i < s_removedCount; i++) {
+        blobPutKey(&blob, CONFIG_RECORD_REMOVED, s_removedKeys[i]);
+    }
+    for (uint16_t i = 0; i < s_maxEntries; i++) {
+        if (s_entries[i].key != NULL && s_entries[i].dirty) {
+            blobPutEntry(&blob, &s_entries[i]);
+        }
+    }
+    blobFinish(&blob, CONFIG_BLOB_DELTA, s_snapshotSequence);
+    
+    if (blob.failed || blob.size > s_snapshotSize / CONFIG_DELTA_DIVISOR) {
+        free(blob.data);
+        return saveSnapshot();
+    }
+    
+    int result = persistent_storage_write(CONFIG_DELTA_KEY, blob.data, blob.size);
+    free(blob.data);
+    return result;
+}
+
+int MCP_ConfigSave(void) {
     if (!s_initialized) {
         return -1;
     }
     
-    // Read all keys from persistent storage
-    // This is a simplified version, in practice you'd need to know all keys
-    // or have a directory of keys in the storage
+    // The snapshot can be gone if storage was cleared behind our back
+    bool haveSnapshot = s_snapshotSequence != 0 && persistent_storage_exists(CONFIG_SNAPSHOT_KEY);
+    if (haveSnapshot && !s_unsaved) {
+        return 0;
+    }
+    
+    // Both blobs change as one group (joins a caller's transaction)
+    bool ownTransaction = persistent_storage_begin_transaction() == 0;
+    
+    int result = haveSnapshot && !s_snapshotNeeded ? saveDelta() : saveSnapshot();
+    if (result == 0) {
+        s_unsaved = false;
+    }
+    
+    if (ownTransaction) {
+        int committed = persistent_storage_end_transaction();
+        return result != 0 ? result : committed;
+    }
+    
+    return result;
+}
+
+// Read a whole blob and check its header and checksum
+static int readBlob(const char* key, uint8_t kind, uint8_t** data, size_t* size) {
+    int storedSize = persistent_storage_get_size(key);
+    if (storedSize < 0) {
+        return 1;  // Not stored
+    }
+    if (storedSize < CONFIG_BLOB_HEADER_SIZE) {
+        return -4;  // Corrupt
+    }
     
-    // For demonstration, we'll assume we have a list of keys to load
+    uint8_t* blob = (uint8_t*)malloc((size_t)storedSize);
+    if (blob == NULL) {
+        return -3;  // Memory allocation failed
+    }
+    
+    size_t actualSize = 0;
+    if (persistent_storage_read(key, blob, (size_t)storedSize, &actualSize) != 0 ||
+        actualSize != (size_t)storedSize ||
+        readU32(blob) != CONFIG_BLOB_MAGIC || blob[4] != CONFIG_BLOB_FORMAT || blob[5] != kind ||
+        readU32(blob + 12) != actualSize - CONFIG_BLOB_HEADER_SIZE ||
+        readU32(blob + 16) != MCP_Crc32Update(MCP_Crc32(blob, 16), blob + CONFIG_BLOB_HEADER_SIZE,
+                                              actualSize - CONFIG_BLOB_HEADER_SIZE)) {
+        free(blob);
+        return -4;  // Unreadable, corrupt or of a newer format
+    }
+    
+    *data = blob;
+    *size = actualSize;
+    return 0;
+}
+
+// Apply the records of a checked blob; snapshot records leave their entries clean
+static int applyBlob(const uint8_t* blob, size_t size, bool snapshot) {
+    const uint8_t* cursor = blob + CONFIG_BLOB_HEADER_SIZE;
+    const uint8_t* end = blob + size;
+    uint16_t records = readU16(blob + 6);
+    char* key = NULL;
+    int result = 0;
+    
+    for (uint16_t i = 0; i < records && result == 0; i++) {
+        if (end - cursor < 3) {
+            result = -4;
+            break;
+        }
+        uint8_t type = cursor[0];
+        uint16_t keyLength = readU16(cursor + 1);
+        cursor += 3;
+        if ((size_t)(end - cursor) < keyLength) {
+            result = -4;
+            break;
+        }
+        
+        free(key);
+        key = (char*)malloc((size_t)keyLength + 1);
+        if (key == NULL) {
+            result = -3;
+            break;
+        }
+        memcpy(key, cursor, keyLength);
+        key[keyLength] = '\0';
+        cursor += keyLength;
+        
+        size_t valueSize = type == MCP_CONFIG_TYPE_BOOL ? 1 :
+                           (type == MCP_CONFIG_TYPE_INT || type == MCP_CONFIG_TYPE_FLOAT) ? 4 :
+                           type == MCP_CONFIG_TYPE_STRING ? 2 : 0;
+        if ((size_t)(end - cursor) < valueSize) {
+            result = -4;
+            break;
+        }
+        
+        switch (type) {
+            case MCP_CONFIG_TYPE_BOOL:
+                result = MCP_ConfigSetBool(key, cursor[0] != 0, true);
+                break;
+                
+            case MCP_CONFIG_TYPE_INT:
+                result = MCP_ConfigSetInt(key, (int32_t)readU32(cursor), true);
+                break;
+                
+            case MCP_CONFIG_TYPE_FLOAT: {
+                uint32_t bits = readU32(cursor);
+                float value;
+                memcpy(&value, &bits, sizeof(value));
+                result = MCP_ConfigSetFloat(key, value, true);
+                break;
+            }
+            
+            case MCP_CONFIG_TYPE_STRING: {
+                uint16_t length = readU16(cursor);
+                if ((size_t)(end - cursor) < 2u + length) {
+                    result = -4;
+                    break;
+                }
+                char* value = (char*)malloc((size_t)length + 1);
+                if (value == NULL) {
+                    result = -3;
+                    break;
+                }
+                memcpy(value, cursor + 2, length);
+                value[length] = '\0';
+                result = MCP_ConfigSetString(key, value, true);
+                free(value);
+                valueSize += length;
+                break;
+            }
+            
+            case CONFIG_RECORD_REMOVED:
+                MCP_ConfigRemove(key);
+                break;
+                
+            default:
+                result = -4;
+                break;
+        }
+        cursor += valueSize;
+        
+        if (result == 0 && snapshot && type != CONFIG_RECORD_REMOVED) {
+            MCP_ConfigEntry* entry = findEntry(key);
+            if (entry != NULL) {
+                entry->dirty = false;
+            }
+        }
+    }
+    
+    free(key);
+    return result;
+}
+
+// Structure of the per-key entries written by earlier versions
+typedef struct {
+    char key[64];
+    MCP_ConfigType type;
+    union {
+        bool boolValue;
+        int32_t intValue;
+        float floatValue;
+        char stringValue[256];
+    } value;
+} StoredConfigEntry;
+
+// Read the per-key entries of earlier versions; they are rewritten as a snapshot on the next save
+static void loadLegacyEntries(void) {
     const char* keysToLoad[] = {
         "deviceName",
         "version",
@@ -347,34 +1018,74 @@ int MCP_ConfigLoad(void) {
         size_t actualSize;
         
         int result = persistent_storage_read(keysToLoad[i], &storedEntry, sizeof(StoredConfigEntry), &actualSize);
+        if (result != 0 || actualSize != sizeof(StoredConfigEntry)) {
+            continue;
+        }
+        storedEntry.key[sizeof(storedEntry.key) - 1] = '\0';
+        storedEntry.value.stringValue[sizeof(storedEntry.value.stringValue) - 1] = '\0';
         
-        if (result == 0 && actualSize == sizeof(StoredConfigEntry)) {
-            // Process based on type
-            switch (storedEntry.type) {
-                case MCP_CONFIG_TYPE_BOOL:
-                    MCP_ConfigSetBool(storedEntry.key, storedEntry.value.boolValue, true);
-                    break;
-                    
-                case MCP_CONFIG_TYPE_INT:
-                    MCP_ConfigSetInt(storedEntry.key, storedEntry.value.intValue, true);
-                    break;
-                    
-                case MCP_CONFIG_TYPE_FLOAT:
-                    MCP_ConfigSetFloat(storedEntry.key, storedEntry.value.floatValue, true);
-                    break;
-                    
-                case MCP_CONFIG_TYPE_STRING:
-                    MCP_ConfigSetString(storedEntry.key, storedEntry.value.stringValue, true);
-                    break;
-                    
-                case MCP_CONFIG_TYPE_OBJECT:
-                    // Not loading objects for simplicity
-                    break;
-            }
+        switch (storedEntry.type) {
+            case MCP_CONFIG_TYPE_BOOL:
+                MCP_ConfigSetBool(storedEntry.key, storedEntry.value.boolValue, true);
+                break;
+                
+            case MCP_CONFIG_TYPE_INT:
+                MCP_ConfigSetInt(storedEntry.key, storedEntry.value.intValue, true);
+                break;
+                
+            case MCP_CONFIG_TYPE_FLOAT:
+                MCP_ConfigSetFloat(storedEntry.key, storedEntry.value.floatValue, true);
+                break;
+                
+            case MCP_CONFIG_TYPE_STRING:
+                MCP_ConfigSetString(storedEntry.key, storedEntry.value.stringValue, true);
+                break;
+                
+            default:
+                break;
         }
     }
+}
+
+int MCP_ConfigLoad(void) {
+    if (!s_initialized) {
+        return -1;
+    }
     
-    return 0;
+    uint8_t* snapshot = NULL;
+    size_t snapshotSize = 0;
+    int result = readBlob(CONFIG_SNAPSHOT_KEY, CONFIG_BLOB_SNAPSHOT, &snapshot, &snapshotSize);
+    if (result < 0) {
+        return result;
+    }
+    if (result > 0) {
+        loadLegacyEntries();
+        return 0;
+    }
+    
+    // Changes made before loading that the stored values do not override still need saving
+    bool unsaved = s_unsaved;
+    result = applyBlob(snapshot, snapshotSize, true);
+    uint32_t sequence = readU32(snapshot + 8);
+    free(snapshot);
+    if (result != 0) {
+        return result;
+    }
+    s_snapshotSequence = sequence;
+    s_snapshotSize = snapshotSize;
+    
+    // A delta left over from before the snapshot was last rewritten is stale
+    uint8_t* delta = NULL;
+    size_t deltaSize = 0;
+    if (readBlob(CONFIG_DELTA_KEY, CONFIG_BLOB_DELTA, &delta, &deltaSize) == 0) {
+        if (readU32(delta + 8) == sequence) {
+            result = applyBlob(delta, deltaSize, false);
+        }
+        free(delta);
+    }
+    
+    s_unsaved = unsaved;
+    return result;
 }
 
 // This is a minimal JSON implementation for simplicity
@@ -390,7 +1101,7 @@ int MCP_ConfigExportJson(char* buffer, size_t bufferSize) {
     // Add entries
     bool first = true;
     for (uint16_t i = 0; i < s_maxEntries; i++) {
-        if (s_entries[i].key != NULL) {
+        if (s_entries[i].key != NULL && s_entries[i].type != MCP_CONFIG_TYPE_NONE) {
             // Add comma if not first entry
             if (!first) {
                 offset += snprintf(buffer + offset, bufferSize - offset, ",");
@@ -429,6 +1140,9 @@ int MCP_ConfigExportJson(char* buffer, size_t bufferSize) {
                 case MCP_CONFIG_TYPE_OBJECT:
                     offset += snprintf(buffer + offset, bufferSize - offset, "{}");
                     break;
+                    
+                case MCP_CONFIG_TYPE_NONE:
+                    break;
             }
             
             // Check if we're about to overflow
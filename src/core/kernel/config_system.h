@@ -13,7 +13,8 @@ typedef enum {
     MCP_CONFIG_TYPE_INT,
     MCP_CONFIG_TYPE_FLOAT,
     MCP_CONFIG_TYPE_STRING,
-    MCP_CONFIG_TYPE_OBJECT
+    MCP_CONFIG_TYPE_OBJECT,
+    MCP_CONFIG_TYPE_NONE        // Resolved through a handle but not set yet
 } MCP_ConfigType;
 
 /**
@@ -35,8 +36,39 @@ typedef struct {
     MCP_ConfigType type;
     MCP_ConfigValue value;
     bool persistent;    // Should be saved to persistent storage
+    uint32_t hash;      // Hash of the key
+    uint16_t generation; // Bumped when the entry is removed, invalidating its handles
+    bool dirty;         // Changed since the last full save
 } MCP_ConfigEntry;
 
+/**
+ * @brief Pre-resolved reference to a configuration entry
+ *
+ * Reading through a handle skips the key lookup. A handle stays valid while
+ * its entry exists, whatever values are set on it; once the entry is removed
+ * the handle reads as the default value until it is resolved again.
+ */
+typedef struct {
+    uint16_t index;
+    uint16_t generation;
+} MCP_ConfigHandle;
+
+#define MCP_CONFIG_INVALID_INDEX 0xFFFF
+
+/**
+ * @brief Maximum number of change subscriptions
+ */
+#define MCP_CONFIG_MAX_SUBSCRIBERS 16
+
+/**
+ * @brief Called after an entry's value or type changes, or it is removed
+ *
+ * @param key Configuration key
+ * @param handle Handle of the entry, stale when the entry was removed
+ * @param context Context given at subscription
+ */
+typedef void (*MCP_ConfigChangeCallback)(const char* key, MCP_ConfigHandle handle, void* context);
+
 /**
  * @brief Initialize the configuration system
  * 
@@ -45,6 +77,11 @@ typedef struct {
  */
 int MCP_ConfigInit(uint16_t maxEntries);
 
+/**
+ * @brief Free all configuration entries and subscriptions
+ */
+void MCP_ConfigDeinit(void);
+
 /**
  * @brief Set a boolean configuration value
  * 
@@ -140,6 +177,89 @@ const char* MCP_ConfigGetString(const char* key, const char* defaultValue);
  */
 void* MCP_ConfigGetObject(const char* key, void* defaultValue);
 
+/**
+ * @brief Resolve a key to a handle, reserving an entry if it is not set yet
+ *
+ * @param key Configuration key
+ * @return MCP_ConfigHandle Handle, with index MCP_CONFIG_INVALID_INDEX on failure
+ */
+MCP_ConfigHandle MCP_ConfigGetHandle(const char* key);
+
+/**
+ * @brief Check whether a handle refers to an existing entry
+ *
+ * @param handle Handle to check
+ * @return bool True if the entry exists
+ */
+bool MCP_ConfigHandleValid(MCP_ConfigHandle handle);
+
+/**
+ * @brief Get a boolean configuration value through a handle
+ *
+ * @param handle Entry handle
+ * @param defaultValue Default value to return if the entry is unset, removed or of another type
+ * @return bool Configuration value or default value
+ */
+bool MCP_ConfigHandleGetBool(MCP_ConfigHandle handle, bool defaultValue);
+
+/**
+ * @brief Get an integer configuration value through a handle
+ *
+ * @param handle Entry handle
+ * @param defaultValue Default value to return if the entry is unset, removed or of another type
+ * @return int32_t Configuration value or default value
+ */
+int32_t MCP_ConfigHandleGetInt(MCP_ConfigHandle handle, int32_t defaultValue);
+
+/**
+ * @brief Get a float configuration value through a handle
+ *
+ * @param handle Entry handle
+ * @param defaultValue Default value to return if the entry is unset, removed or of another type
+ * @return float Configuration value or default value
+ */
+float MCP_ConfigHandleGetFloat(MCP_ConfigHandle handle, float defaultValue);
+
+/**
+ * @brief Get a string configuration value through a handle
+ *
+ * The string is owned by the entry and valid until its value is next set.
+ *
+ * @param handle Entry handle
+ * @param defaultValue Default value to return if the entry is unset, removed or of another type
+ * @return const char* Configuration value or default value
+ */
+const char* MCP_ConfigHandleGetString(MCP_ConfigHandle handle, const char* defaultValue);
+
+/**
+ * @brief Get an object configuration value through a handle
+ *
+ * @param handle Entry handle
+ * @param defaultValue Default value to return if the entry is unset, removed or of another type
+ * @return void* Configuration value or default value
+ */
+void* MCP_ConfigHandleGetObject(MCP_ConfigHandle handle, void* defaultValue);
+
+/**
+ * @brief Subscribe to changes of the entries whose keys start with a prefix
+ *
+ * Setting an entry to the value it already holds does not notify.
+ *
+ * @param prefix Key prefix, NULL or "" for every entry
+ * @param callback Function to call after a change
+ * @param context Context passed to the callback
+ * @return int Subscription ID or negative error code
+ */
+int MCP_ConfigSubscribe(const char* prefix, MCP_ConfigChangeCallback callback, void* context);
+
+/**
+ * @brief Cancel a change subscription
+ *
+ * @param subscription Subscription ID from MCP_ConfigSubscribe
+ * @return int 0 on success, negative error code on failure
+ */
+int MCP_ConfigUnsubscribe(int subscription);
+
 /**
  * @brief Remove a configuration entry
  * 
@@ -151,6 +271,12 @@ int MCP_ConfigRemove(const char* key);
 /**
  * @brief Save all persistent configuration to storage
  * 
+ * Configuration is stored as a checksummed snapshot blob holding every
+ * persistent entry, plus a delta blob holding the entries changed or removed
+ * since that snapshot. A save rewrites only the delta until it outgrows a
+ * quarter of the snapshot, then writes a new snapshot and drops the delta.
+ * Object values are not saved. A save with nothing changed writes nothing.
+ * 
  * @return int 0 on success, negative error code on failure
  */
 int MCP_ConfigSave(void);
@@ -158,7 +284,10 @@ int MCP_ConfigSave(void);
 /**
  * @brief Load configuration from storage
  * 
- * @return int 0 on success, negative error code on failure
+ * Reads the snapshot and delta blobs, or the per-key entries written by
+ * earlier versions when there is no snapshot yet.
+ * 
+ * @return int 0 on success (including when nothing is stored), negative error code on failure
  */
 int MCP_ConfigLoad(void);
 
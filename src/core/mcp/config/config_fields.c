@@ -0,0 +1,885 @@
+/**
+ * @file config_fields.c
+ * @brief Table-driven JSON patching and serialization of config structures
+ */
+#include "config_fields.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Longest dotted path a patch can address, and deepest nesting of sections
+#define CONFIG_MAX_PATH 128
+#define CONFIG_MAX_DEPTH 8
+
+// Nesting a patch may use, including arrays and objects that are skipped
+#define CONFIG_MAX_NESTING 32
+
+// Longest string member; longer members are filled up to this size
+#define CONFIG_MAX_STRING 256
+
+// Growable text
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+    bool fixed;                 // Data is the caller's buffer and cannot grow
+    bool failed;
+} ConfigText;
+
+// Patch being applied
+typedef struct {
+    const MCP_ConfigFieldTable* table;
+    uint8_t* config;
+    const uint8_t* defaults;
+    const char* cursor;
+    bool apply;                 // False while checking that the document is well-formed
+    uint32_t changed;
+    char path[CONFIG_MAX_PATH];
+} PatchParser;
+
+// Make room for length more bytes and a terminator; returns where they go
+static char* textReserve(ConfigText* text, size_t length) {
+    if (text->failed) {
+        return NULL;
+    }
+    if (text->length + length + 1 > text->capacity) {
+        if (text->fixed) {
+            text->failed = true;
+            return NULL;
+        }
+        size_t capacity = text->capacity == 0 ? 256 : text->capacity;
+        while (text->length + length + 1 > capacity) {
+            capacity *= 2;
+        }
+        char* grown = (char*)realloc(text->data, capacity);
+        if (grown == NULL) {
+            text->failed = true;
+            return NULL;
+        }
+        text->data = grown;
+        text->capacity = capacity;
+    }
+    return text->data + text->length;
+}
+
+static void textAppend(ConfigText* text, const char* data, size_t length) {
+    char* out = textReserve(text, length);
+    if (out == NULL) {
+        return;
+    }
+    memcpy(out, data, length);
+    text->length += length;
+    text->data[text->length] = '\0';
+}
+
+static void textAppendString(ConfigText* text, const char* data) {
+    textAppend(text, data, strlen(data));
+}
+
+static const char s_blanks[] = "                                ";
+
+static void textIndent(ConfigText* text, int spaces) {
+    while (spaces > 0) {
+        int count = spaces < (int)sizeof(s_blanks) - 1 ? spaces : (int)sizeof(s_blanks) - 1;
+        textAppend(text, s_blanks, count);
+        spaces -= count;
+    }
+}
+
+// Length of a string as a JSON literal, quotes included
+static size_t quotedLength(const char* value, size_t maxLength) {
+    size_t length = 2;
+    for (size_t i = 0; i < maxLength && value[i] != '\0'; i++) {
+        unsigned char c = (unsigned char)value[i];
+        if (c == '"' || c == '\\' || c == '\n' || c == '\r' || c == '\t') {
+            length += 2;
+        } else if (c < 0x20) {
+            length += 6;
+        } else {
+            length++;
+        }
+    }
+    return length;
+}
+
+// Write a string as a JSON literal, escaping what JSON requires
+static char* writeQuoted(char* out, const char* value, size_t maxLength) {
+    static const char hex[] = "0123456789abcdef";
+    *out++ = '"';
+    for (size_t i = 0; i < maxLength && value[i] != '\0'; i++) {
+        unsigned char c = (unsigned char)value[i];
+        if (c != '"' && c != '\\' && c >= 0x20) {
+            *out++ = (char)c;
+            continue;
+        }
+        *out++ = '\\';
+        switch (c) {
+            case '"':  *out++ = '"'; break;
+            case '\\': *out++ = '\\'; break;
+            case '\n': *out++ = 'n'; break;
+            case '\r': *out++ = 'r'; break;
+            case '\t': *out++ = 't'; break;
+            default:
+                memcpy(out, "u00", 3);
+                out[3] = hex[c >> 4];
+                out[4] = hex[c & 0xF];
+                out += 5;
+                break;
+        }
+    }
+    *out++ = '"';
+    return out;
+}
+
+static int64_t readInteger(const uint8_t* member, const MCP_ConfigField* field) {
+    bool isSigned = field->type == MCP_CONFIG_FIELD_INT;
+    switch (field->size) {
+        case 1: {
+            uint8_t value;
+            memcpy(&value, member, 1);
+            return isSigned ? (int64_t)(int8_t)value : (int64_t)value;
+        }
+        case 2: {
+            uint16_t value;
+            memcpy(&value, member, 2);
+            return isSigned ? (int64_t)(int16_t)value : (int64_t)value;
+        }
+        case 4: {
+            uint32_t value;
+            memcpy(&value, member, 4);
+            return isSigned ? (int64_t)(int32_t)value : (int64_t)value;
+        }
+        default:
+            return 0;
+    }
+}
+
+// Store an integer in a member, failing if the member cannot hold it
+static bool encodeInteger(const MCP_ConfigField* field, int64_t value, uint8_t* out) {
+    int64_t minimum = 0;
+    int64_t maximum = 0;
+    if (field->size != 1 && field->size != 2 && field->size != 4) {
+        return false;
+    }
+    int bits = field->size * 8;
+    if (field->type == MCP_CONFIG_FIELD_INT) {
+        minimum = -((int64_t)1 << (bits - 1));
+        maximum = ((int64_t)1 << (bits - 1)) - 1;
+    } else {
+        maximum = ((int64_t)1 << bits) - 1;
+    }
+    if (value < minimum || value > maximum) {
+        return false;
+    }
+
+    uint32_t bitsValue = (uint32_t)value;
+    if (field->size == 1) {
+        uint8_t narrow = (uint8_t)bitsValue;
+        memcpy(out, &narrow, 1);
+    } else if (field->size == 2) {
+        uint16_t narrow = (uint16_t)bitsValue;
+        memcpy(out, &narrow, 2);
+    } else {
+        memcpy(out, &bitsValue, 4);
+    }
+    return true;
+}
+
+// Render one member line, after the separator that ends the line before it
+static void renderField(ConfigText* text, const char* separator, const MCP_ConfigField* field,
+                        const uint8_t* config, int indent) {
+    const uint8_t* member = config + field->offset;
+    char number[24];
+    const char* value = NULL;
+    size_t valueLength = 0;
+
+    switch (field->type) {
+        case MCP_CONFIG_FIELD_BOOL: {
+            bool flag;
+            memcpy(&flag, member, sizeof(bool));
+            value = flag ? "true" : "false";
+            valueLength = flag ? 4 : 5;
+            break;
+        }
+        case MCP_CONFIG_FIELD_INT:
+        case MCP_CONFIG_FIELD_UINT: {
+            // Digits written backwards from the end; cheaper than snprintf on every render
+            int64_t integer = readInteger(member, field);
+            uint64_t magnitude = integer < 0 ? (uint64_t)(-integer) : (uint64_t)integer;
+            char* digit = number + sizeof(number);
+            do {
+                *--digit = (char)('0' + magnitude % 10);
+                magnitude /= 10;
+            } while (magnitude > 0);
+            if (integer < 0) {
+                *--digit = '-';
+            }
+            value = digit;
+            valueLength = (size_t)(number + sizeof(number) - digit);
+            break;
+        }
+        case MCP_CONFIG_FIELD_STRING:
+            valueLength = quotedLength((const char*)member, field->size);
+            break;
+        default:
+            value = "null";
+            valueLength = 4;
+            break;
+    }
+
+    // The whole line is written in one piece
+    size_t separatorLength = strlen(separator);
+    size_t nameLength = strlen(field->name);
+    if (indent > (int)sizeof(s_blanks) - 1) {
+        indent = (int)sizeof(s_blanks) - 1;
+    }
+    char* out = textReserve(text, separatorLength + indent + nameLength + 4 + valueLength);
+    if (out == NULL) {
+        return;
+    }
+    char* start = out;
+    memcpy(out, separator, separatorLength);
+    out += separatorLength;
+    memcpy(out, s_blanks, indent);
+    out += indent;
+    *out++ = '"';
+    memcpy(out, field->name, nameLength);
+    out += nameLength;
+    memcpy(out, "\": ", 3);
+    out += 3;
+    if (value != NULL) {
+        memcpy(out, value, valueLength);
+        out += valueLength;
+    } else {
+        out = writeQuoted(out, (const char*)member, field->size);
+    }
+    *out = '\0';
+    text->length += (size_t)(out - start);
+}
+
+static int countComponents(const char* path) {
+    int count = 1;
+    for (; *path != '\0'; path++) {
+        count += *path == '.';
+    }
+    return count;
+}
+
+static size_t componentLength(const char* component) {
+    const char* end = strchr(component, '.');
+    return end != NULL ? (size_t)(end - component) : strlen(component);
+}
+
+static const char* nextComponent(const char* component) {
+    const char* end = strchr(component, '.');
+    return end != NULL ? end + 1 : NULL;
+}
+
+// Render the member lines of one section, each starting on a new line
+static void renderSection(ConfigText* text, const MCP_ConfigFieldTable* table, const uint8_t* config,
+                          uint8_t section) {
+    int indent = 2 * (countComponents(table->sections[section]) + 1);
+    bool first = true;
+    for (uint16_t i = 0; i < table->fieldCount; i++) {
+        if (table->fields[i].section != section) {
+            continue;
+        }
+        renderField(text, first ? "\n" : ",\n", &table->fields[i], config, indent);
+        first = false;
+    }
+}
+
+// Render the text around the sections: the braces and names of the objects
+// opened and closed between one section and the next. Frame i precedes section i;
+// the end of each frame goes to frameEnd, or the section is rendered in place.
+static void renderFrames(ConfigText* text, const MCP_ConfigFieldTable* table, uint16_t* frameEnd,
+                         const uint8_t* config) {
+    bool hasMembers[CONFIG_MAX_DEPTH + 1];
+    const char* open = NULL;
+    int openDepth = 0;
+
+    textAppend(text, "{", 1);
+    hasMembers[0] = false;
+
+    for (uint8_t s = 0; s < table->sectionCount; s++) {
+        const char* path = table->sections[s];
+        int depth = countComponents(path);
+
+        // Objects shared with the previous section stay open
+        int common = 0;
+        const char* previous = open;
+        const char* current = path;
+        while (previous != NULL && common < openDepth && common < depth - 1 &&
+               componentLength(previous) == componentLength(current) &&
+               strncmp(previous, current, componentLength(current)) == 0) {
+            common++;
+            previous = nextComponent(previous);
+            current = nextComponent(current);
+        }
+
+        for (int d = openDepth; d > common; d--) {
+            textAppend(text, "\n", 1);
+            textIndent(text, 2 * d);
+            textAppend(text, "}", 1);
+        }
+        for (int d = common; d < depth; d++) {
+            textAppendString(text, hasMembers[d] ? ",\n" : "\n");
+            textIndent(text, 2 * (d + 1));
+            textAppend(text, "\"", 1);
+            textAppend(text, current, componentLength(current));
+            textAppend(text, "\": {", 4);
+            hasMembers[d] = true;
+            hasMembers[d + 1] = false;
+            current = nextComponent(current);
+        }
+
+        if (frameEnd != NULL) {
+            frameEnd[s] = (uint16_t)text->length;
+        } else {
+            renderSection(text, table, config, s);
+        }
+        open = path;
+        openDepth = depth;
+    }
+
+    for (int d = openDepth; d > 0; d--) {
+        textAppend(text, "\n", 1);
+        textIndent(text, 2 * d);
+        textAppend(text, "}", 1);
+    }
+    textAppend(text, "\n}\n", 3);
+    if (frameEnd != NULL) {
+        frameEnd[table->sectionCount] = (uint16_t)text->length;
+    }
+}
+
+static bool tableValid(const MCP_ConfigFieldTable* table) {
+    if (table == NULL || table->sectionCount > MCP_CONFIG_MAX_SECTIONS) {
+        return false;
+    }
+    for (uint8_t s = 0; s < table->sectionCount; s++) {
+        if (countComponents(table->sections[s]) > CONFIG_MAX_DEPTH) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Bring the cached document up to date, rendering only sections that are out of date
+static int refreshCache(const MCP_ConfigFieldTable* table, const uint8_t* config, MCP_ConfigJsonCache* cache) {
+    if (cache->documentValid) {
+        return 0;
+    }
+
+    // The frames depend only on the table
+    if (cache->frames == NULL) {
+        ConfigText frames = { NULL, 0, 0, false, false };
+        renderFrames(&frames, table, cache->frameEnd, NULL);
+        if (frames.failed || frames.length > UINT16_MAX) {
+            free(frames.data);
+            return -3;
+        }
+        cache->frames = frames.data;
+    }
+
+    size_t length = cache->frameEnd[table->sectionCount];
+    for (uint8_t s = 0; s < table->sectionCount; s++) {
+        uint32_t bit = 1u << s;
+        if (!(cache->validSections & bit)) {
+            ConfigText section = { NULL, 0, 0, false, false };
+            renderSection(&section, table, config, s);
+            if (section.failed || section.length > UINT16_MAX) {
+                free(section.data);
+                return -3;
+            }
+            free(cache->sectionText[s]);
+            cache->sectionText[s] = section.data;
+            cache->sectionLength[s] = (uint16_t)section.length;
+            cache->validSections |= bit;
+            cache->sectionRenders++;
+        }
+        length += cache->sectionLength[s];
+    }
+
+    if (length + 1 > cache->documentCapacity) {
+        char* grown = (char*)realloc(cache->document, length + 1);
+        if (grown == NULL) {
+            return -3;
+        }
+        cache->document = grown;
+        cache->documentCapacity = length + 1;
+    }
+
+    // Interleave frames and sections
+    size_t position = 0;
+    uint16_t frameStart = 0;
+    for (uint8_t s = 0; s <= table->sectionCount; s++) {
+        memcpy(cache->document + position, cache->frames + frameStart, cache->frameEnd[s] - frameStart);
+        position += cache->frameEnd[s] - frameStart;
+        frameStart = cache->frameEnd[s];
+        if (s < table->sectionCount && cache->sectionLength[s] > 0) {
+            memcpy(cache->document + position, cache->sectionText[s], cache->sectionLength[s]);
+            position += cache->sectionLength[s];
+        }
+    }
+    cache->document[position] = '\0';
+    cache->documentLength = position;
+    cache->documentValid = true;
+    return 0;
+}
+
+int MCP_ConfigFieldsSerialize(const MCP_ConfigFieldTable* table, const void* config,
+                              MCP_ConfigJsonCache* cache, char* buffer, size_t size) {
+    if (!tableValid(table) || config == NULL || buffer == NULL || size == 0 || size > INT32_MAX) {
+        return -1;
+    }
+
+    // Without a cache the document is rendered straight into the buffer
+    if (cache == NULL) {
+        ConfigText text = { buffer, 0, size, true, false };
+        renderFrames(&text, table, NULL, (const uint8_t*)config);
+        return text.failed ? -2 : (int)text.length;
+    }
+
+    int result = refreshCache(table, (const uint8_t*)config, cache);
+    if (result != 0) {
+        return result;
+    }
+    if (cache->documentLength + 1 > size) {
+        return -2;
+    }
+    memcpy(buffer, cache->document, cache->documentLength + 1);
+    return (int)cache->documentLength;
+}
+
+void MCP_ConfigJsonCacheInvalidate(MCP_ConfigJsonCache* cache, uint32_t sections) {
+    if (cache == NULL || sections == 0) {
+        return;
+    }
+    cache->validSections &= ~sections;
+    cache->documentValid = false;
+}
+
+void MCP_ConfigJsonCacheFree(MCP_ConfigJsonCache* cache) {
+    if (cache == NULL) {
+        return;
+    }
+    for (int s = 0; s < MCP_CONFIG_MAX_SECTIONS; s++) {
+        free(cache->sectionText[s]);
+    }
+    free(cache->frames);
+    free(cache->document);
+    memset(cache, 0, sizeof(MCP_ConfigJsonCache));
+}
+
+// --- Patch parsing ---
+
+static void skipWhitespace(PatchParser* parser) {
+    while (*parser->cursor == ' ' || *parser->cursor == '\t' ||
+           *parser->cursor == '\n' || *parser->cursor == '\r') {
+        parser->cursor++;
+    }
+}
+
+static bool matchLiteral(PatchParser* parser, const char* literal) {
+    size_t length = strlen(literal);
+    if (strncmp(parser->cursor, literal, length) != 0) {
+        return false;
+    }
+    parser->cursor += length;
+    return true;
+}
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static bool parseHex4(const char* digits, uint32_t* value) {
+    *value = 0;
+    for (int i = 0; i < 4; i++) {
+        int digit = hexValue(digits[i]);
+        if (digit < 0) {
+            return false;
+        }
+        *value = (*value << 4) | (uint32_t)digit;
+    }
+    return true;
+}
+
+static void putByte(char* out, size_t outSize, size_t* length, uint8_t byte) {
+    if (out != NULL && *length + 1 < outSize) {
+        out[*length] = (char)byte;
+    }
+    (*length)++;
+}
+
+// Decode a string literal at the cursor; out receives as much as fits, terminated
+static int parseString(PatchParser* parser, char* out, size_t outSize, size_t* outLength) {
+    if (*parser->cursor != '"') {
+        return -2;
+    }
+    parser->cursor++;
+
+    size_t length = 0;
+    for (;;) {
+        unsigned char c = (unsigned char)*parser->cursor;
+        if (c == '\0' || c < 0x20) {
+            return -2;
+        }
+        parser->cursor++;
+        if (c == '"') {
+            break;
+        }
+        if (c != '\\') {
+            putByte(out, outSize, &length, c);
+            continue;
+        }
+
+        char escape = *parser->cursor++;
+        uint32_t code = 0;
+        switch (escape) {
+            case '"':  code = '"'; break;
+            case '\\': code = '\\'; break;
+            case '/':  code = '/'; break;
+            case 'b':  code = '\b'; break;
+            case 'f':  code = '\f'; break;
+            case 'n':  code = '\n'; break;
+            case 'r':  code = '\r'; break;
+            case 't':  code = '\t'; break;
+            case 'u':
+                if (!parseHex4(parser->cursor, &code)) {
+                    return -2;
+                }
+                parser->cursor += 4;
+                // A surrogate pair spells one code point
+                if (code >= 0xD800 && code < 0xDC00 && parser->cursor[0] == '\\' && parser->cursor[1] == 'u') {
+                    uint32_t low;
+                    if (parseHex4(parser->cursor + 2, &low) && low >= 0xDC00 && low < 0xE000) {
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                        parser->cursor += 6;
+                    }
+                }
+                break;
+            default:
+                return -2;
+        }
+
+        // Encode as UTF-8
+        if (code < 0x80) {
+            putByte(out, outSize, &length, (uint8_t)code);
+        } else if (code < 0x800) {
+            putByte(out, outSize, &length, (uint8_t)(0xC0 | (code >> 6)));
+            putByte(out, outSize, &length, (uint8_t)(0x80 | (code & 0x3F)));
+        } else if (code < 0x10000) {
+            putByte(out, outSize, &length, (uint8_t)(0xE0 | (code >> 12)));
+            putByte(out, outSize, &length, (uint8_t)(0x80 | ((code >> 6) & 0x3F)));
+            putByte(out, outSize, &length, (uint8_t)(0x80 | (code & 0x3F)));
+        } else {
+            putByte(out, outSize, &length, (uint8_t)(0xF0 | (code >> 18)));
+            putByte(out, outSize, &length, (uint8_t)(0x80 | ((code >> 12) & 0x3F)));
+            putByte(out, outSize, &length, (uint8_t)(0x80 | ((code >> 6) & 0x3F)));
+            putByte(out, outSize, &length, (uint8_t)(0x80 | (code & 0x3F)));
+        }
+    }
+
+    if (out != NULL && outSize > 0) {
+        out[length < outSize ? length : outSize - 1] = '\0';
+    }
+    if (outLength != NULL) {
+        *outLength = length;
+    }
+    return 0;
+}
+
+static int parseNumber(PatchParser* parser, double* value) {
+    const char* start = parser->cursor;
+    char* end = NULL;
+    if (*start != '-' && (*start < '0' || *start > '9')) {
+        return -2;
+    }
+    *value = strtod(start, &end);
+    if (end == start) {
+        return -2;
+    }
+    parser->cursor = end;
+    return 0;
+}
+
+// Consume a value of any kind without applying it
+static int skipValue(PatchParser* parser, int nesting) {
+    if (nesting > CONFIG_MAX_NESTING) {
+        return -2;
+    }
+
+    char open = *parser->cursor;
+    if (open == '"') {
+        return parseString(parser, NULL, 0, NULL);
+    }
+    if (open == 't') {
+        return matchLiteral(parser, "true") ? 0 : -2;
+    }
+    if (open == 'f') {
+        return matchLiteral(parser, "false") ? 0 : -2;
+    }
+    if (open == 'n') {
+        return matchLiteral(parser, "null") ? 0 : -2;
+    }
+    if (open != '{' && open != '[') {
+        double number;
+        return parseNumber(parser, &number);
+    }
+
+    char close = open == '{' ? '}' : ']';
+    parser->cursor++;
+    skipWhitespace(parser);
+    if (*parser->cursor == close) {
+        parser->cursor++;
+        return 0;
+    }
+    for (;;) {
+        skipWhitespace(parser);
+        if (open == '{') {
+            if (parseString(parser, NULL, 0, NULL) != 0) {
+                return -2;
+            }
+            skipWhitespace(parser);
+            if (*parser->cursor++ != ':') {
+                return -2;
+            }
+            skipWhitespace(parser);
+        }
+        if (skipValue(parser, nesting + 1) != 0) {
+            return -2;
+        }
+        skipWhitespace(parser);
+        if (*parser->cursor == ',') {
+            parser->cursor++;
+            continue;
+        }
+        if (*parser->cursor++ != close) {
+            return -2;
+        }
+        return 0;
+    }
+}
+
+static int findSection(const MCP_ConfigFieldTable* table, const char* path, size_t length) {
+    for (uint8_t s = 0; s < table->sectionCount; s++) {
+        if (strlen(table->sections[s]) == length && strncmp(table->sections[s], path, length) == 0) {
+            return s;
+        }
+    }
+    return -1;
+}
+
+// Look up the field a full dotted path names
+static const MCP_ConfigField* findField(const MCP_ConfigFieldTable* table, const char* path) {
+    const char* name = strrchr(path, '.');
+    if (name == NULL) {
+        return NULL;
+    }
+    int section = findSection(table, path, (size_t)(name - path));
+    if (section < 0) {
+        return NULL;
+    }
+    name++;
+    for (uint16_t i = 0; i < table->fieldCount; i++) {
+        if (table->fields[i].section == section && strcmp(table->fields[i].name, name) == 0) {
+            return &table->fields[i];
+        }
+    }
+    return NULL;
+}
+
+// Write a new member value if it differs from the current one
+static void storeMember(PatchParser* parser, const MCP_ConfigField* field, const void* value) {
+    uint8_t* member = parser->config + field->offset;
+    if (!parser->apply || memcmp(member, value, field->size) == 0) {
+        return;
+    }
+    memcpy(member, value, field->size);
+    parser->changed |= 1u << field->section;
+}
+
+static void resetField(PatchParser* parser, const MCP_ConfigField* field) {
+    uint8_t zero[CONFIG_MAX_STRING];
+    if (parser->defaults != NULL) {
+        storeMember(parser, field, parser->defaults + field->offset);
+    } else if (field->size <= sizeof(zero)) {
+        memset(zero, 0, field->size);
+        storeMember(parser, field, zero);
+    }
+}
+
+// Null restores the field the path names, or every field of the sections under it
+static void resetPath(PatchParser* parser) {
+    const MCP_ConfigField* field = findField(parser->table, parser->path);
+    if (field != NULL) {
+        resetField(parser, field);
+        return;
+    }
+
+    size_t length = strlen(parser->path);
+    const MCP_ConfigFieldTable* table = parser->table;
+    for (uint16_t i = 0; i < table->fieldCount; i++) {
+        const char* section = table->sections[table->fields[i].section];
+        if (strncmp(section, parser->path, length) == 0 && (section[length] == '\0' || section[length] == '.')) {
+            resetField(parser, &table->fields[i]);
+        }
+    }
+}
+
+static int parseObject(PatchParser* parser, size_t pathLength, int nesting);
+
+// Apply the value at the cursor to the field the current path names, if any
+static int parseValue(PatchParser* parser, bool known, size_t pathLength, int nesting) {
+    if (!known) {
+        return skipValue(parser, nesting);
+    }
+
+    char c = *parser->cursor;
+    if (c == '{') {
+        return parseObject(parser, pathLength, nesting + 1);
+    }
+    if (c == 'n') {
+        if (!matchLiteral(parser, "null")) {
+            return -2;
+        }
+        resetPath(parser);
+        return 0;
+    }
+
+    const MCP_ConfigField* field = findField(parser->table, parser->path);
+    if (field == NULL) {
+        return skipValue(parser, nesting);
+    }
+
+    uint8_t value[CONFIG_MAX_STRING];
+    if (c == '"') {
+        size_t length = field->size < sizeof(value) ? field->size : sizeof(value);
+        memset(value, 0, sizeof(value));
+        if (field->type != MCP_CONFIG_FIELD_STRING || field->size > sizeof(value)) {
+            return skipValue(parser, nesting);
+        }
+        if (parseString(parser, (char*)value, length, NULL) != 0) {
+            return -2;
+        }
+        storeMember(parser, field, value);
+        return 0;
+    }
+    if (c == 't' || c == 'f') {
+        bool flag = c == 't';
+        if (!matchLiteral(parser, flag ? "true" : "false")) {
+            return -2;
+        }
+        if (field->type == MCP_CONFIG_FIELD_BOOL && field->size == sizeof(bool)) {
+            storeMember(parser, field, &flag);
+        }
+        return 0;
+    }
+    if (c == '-' || (c >= '0' && c <= '9')) {
+        double number;
+        if (parseNumber(parser, &number) != 0) {
+            return -2;
+        }
+        // Integers only, and only ones the member can hold
+        bool integral = number >= -2147483648.0 && number <= 4294967295.0 && number == (double)(int64_t)number;
+        if ((field->type == MCP_CONFIG_FIELD_INT || field->type == MCP_CONFIG_FIELD_UINT) && integral &&
+            encodeInteger(field, (int64_t)number, value)) {
+            storeMember(parser, field, value);
+        }
+        return 0;
+    }
+    return skipValue(parser, nesting);
+}
+
+static int parseObject(PatchParser* parser, size_t pathLength, int nesting) {
+    if (nesting > CONFIG_MAX_NESTING || *parser->cursor != '{') {
+        return -2;
+    }
+    parser->cursor++;
+    skipWhitespace(parser);
+    if (*parser->cursor == '}') {
+        parser->cursor++;
+        return 0;
+    }
+
+    for (;;) {
+        skipWhitespace(parser);
+
+        // The member name extends the path; one too long for the buffer matches nothing
+        bool room = pathLength + 1 < CONFIG_MAX_PATH;
+        size_t start = pathLength;
+        if (pathLength > 0 && room) {
+            parser->path[start++] = '.';
+        }
+        size_t keyLength = 0;
+        if (parseString(parser, room ? parser->path + start : NULL, room ? CONFIG_MAX_PATH - start : 0,
+                        &keyLength) != 0) {
+            return -2;
+        }
+        bool known = room && start + keyLength < CONFIG_MAX_PATH;
+
+        skipWhitespace(parser);
+        if (*parser->cursor++ != ':') {
+            return -2;
+        }
+        skipWhitespace(parser);
+        if (parseValue(parser, known, start + keyLength, nesting) != 0) {
+            return -2;
+        }
+        parser->path[pathLength] = '\0';
+
+        skipWhitespace(parser);
+        if (*parser->cursor == ',') {
+            parser->cursor++;
+            continue;
+        }
+        if (*parser->cursor++ != '}') {
+            return -2;
+        }
+        return 0;
+    }
+}
+
+static int runPatch(PatchParser* parser, const char* json) {
+    parser->cursor = json;
+    parser->path[0] = '\0';
+    skipWhitespace(parser);
+    if (parseObject(parser, 0, 0) != 0) {
+        return -2;
+    }
+    skipWhitespace(parser);
+    return *parser->cursor == '\0' ? 0 : -2;
+}
+
+int MCP_ConfigFieldsApplyPatch(const MCP_ConfigFieldTable* table, void* config, const void* defaults,
+                               const char* json, uint32_t* changedSections) {
+    if (changedSections != NULL) {
+        *changedSections = 0;
+    }
+    if (!tableValid(table) || config == NULL || json == NULL) {
+        return -1;
+    }
+
+    PatchParser parser;
+    parser.table = table;
+    parser.config = (uint8_t*)config;
+    parser.defaults = (const uint8_t*)defaults;
+    parser.changed = 0;
+
+    // Check the whole document first so a malformed one changes nothing
+    parser.apply = false;
+    if (runPatch(&parser, json) != 0) {
+        return -2;
+    }
+    parser.apply = true;
+    runPatch(&parser, json);
+
+    if (changedSections != NULL) {
+        *changedSections = parser.changed;
+    }
+    return 0;
+}
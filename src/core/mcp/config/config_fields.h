@@ -0,0 +1,145 @@
+/**
+ * @file config_fields.h
+ * @brief Table-driven JSON patching and serialization of config structures
+ *
+ * A field table maps dotted JSON paths onto the members of a plain config
+ * struct, so one parser and one serializer serve every platform's struct.
+ *
+ * Updates are JSON merge patches: nested objects name sections, members left
+ * out keep their value and null restores a field, or a whole section, to its
+ * default. Dotted member names ("server.port") are accepted as well and mean
+ * the same as the nested form. Unknown members and values of the wrong type
+ * are ignored; a malformed document changes nothing.
+ *
+ * Serialization can go through a cache that keeps each section's rendered
+ * text and the assembled document, so only sections a patch changed are
+ * rendered again.
+ */
+#ifndef CONFIG_FIELDS_H
+#define CONFIG_FIELDS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Maximum number of sections in a field table
+ */
+#define MCP_CONFIG_MAX_SECTIONS 32
+
+/**
+ * @brief Section bit mask covering every section
+ */
+#define MCP_CONFIG_ALL_SECTIONS 0xFFFFFFFFu
+
+/**
+ * @brief Member types a field can have
+ */
+typedef enum {
+    MCP_CONFIG_FIELD_BOOL,
+    MCP_CONFIG_FIELD_INT,       // Signed integer of 1, 2 or 4 bytes
+    MCP_CONFIG_FIELD_UINT,      // Unsigned integer of 1, 2 or 4 bytes
+    MCP_CONFIG_FIELD_STRING     // Character array, always kept terminated
+} MCP_ConfigFieldType;
+
+/**
+ * @brief One member of a config struct
+ */
+typedef struct {
+    uint8_t section;            // Index into the table's sections
+    uint8_t type;               // MCP_ConfigFieldType
+    uint16_t offset;            // Offset of the member in the struct
+    uint16_t size;              // Size of the member in bytes
+    const char* name;           // Member name within the section
+} MCP_ConfigField;
+
+/**
+ * @brief Build a field table entry for a struct member
+ *
+ * @param section Section index
+ * @param name JSON member name
+ * @param type BOOL, INT, UINT or STRING
+ * @param structType Config struct type
+ * @param member Member designator, which may name a nested member
+ */
+#define MCP_CONFIG_FIELD(section, name, type, structType, member) \
+    { (uint8_t)(section), (uint8_t)MCP_CONFIG_FIELD_##type, (uint16_t)offsetof(structType, member), \
+      (uint16_t)sizeof(((structType*)0)->member), (name) }
+
+/**
+ * @brief Field table for one config struct
+ *
+ * Sections are dotted paths serialized in table order; sections that share a
+ * parent object must be adjacent. Fields are serialized in table order within
+ * their section.
+ */
+typedef struct {
+    const char* const* sections;
+    uint8_t sectionCount;
+    const MCP_ConfigField* fields;
+    uint16_t fieldCount;
+} MCP_ConfigFieldTable;
+
+/**
+ * @brief Rendered JSON kept between serializations
+ *
+ * Zero-initialize before first use and free with MCP_ConfigJsonCacheFree.
+ * A cache belongs to one struct instance; whoever changes that instance
+ * invalidates the sections it touched.
+ */
+typedef struct {
+    char* sectionText[MCP_CONFIG_MAX_SECTIONS];
+    uint16_t sectionLength[MCP_CONFIG_MAX_SECTIONS];
+    uint32_t validSections;     // Sections whose text is current
+    char* frames;               // Object braces and names between the sections
+    uint16_t frameEnd[MCP_CONFIG_MAX_SECTIONS + 1];
+    char* document;
+    size_t documentLength;
+    size_t documentCapacity;
+    bool documentValid;
+    uint32_t sectionRenders;    // Sections rendered since the cache was created
+} MCP_ConfigJsonCache;
+
+/**
+ * @brief Apply a JSON merge patch to a config struct
+ *
+ * @param table Field table of the struct
+ * @param config Struct to update
+ * @param defaults Struct holding the values null restores, NULL for zero
+ * @param json Patch document
+ * @param changedSections Receives a bit per section whose values changed (may be NULL)
+ * @return int 0 on success, -1 on invalid arguments, -2 if the JSON is malformed
+ */
+int MCP_ConfigFieldsApplyPatch(const MCP_ConfigFieldTable* table, void* config, const void* defaults,
+                               const char* json, uint32_t* changedSections);
+
+/**
+ * @brief Serialize a config struct as indented JSON
+ *
+ * @param table Field table of the struct
+ * @param config Struct to serialize
+ * @param cache Rendered text to reuse and update, NULL to render everything
+ * @param buffer Buffer to store the JSON string
+ * @param size Size of the buffer
+ * @return int Length of the JSON string, -1 on invalid arguments, -2 if the
+ *         buffer is too small, -3 on memory allocation failure
+ */
+int MCP_ConfigFieldsSerialize(const MCP_ConfigFieldTable* table, const void* config,
+                              MCP_ConfigJsonCache* cache, char* buffer, size_t size);
+
+/**
+ * @brief Mark sections of a cache as out of date
+ *
+ * @param cache Cache to update
+ * @param sections Bit per section, MCP_CONFIG_ALL_SECTIONS for all
+ */
+void MCP_ConfigJsonCacheInvalidate(MCP_ConfigJsonCache* cache, uint32_t sections);
+
+/**
+ * @brief Free the text held by a cache and leave it empty
+ *
+ * @param cache Cache to free
+ */
+void MCP_ConfigJsonCacheFree(MCP_ConfigJsonCache* cache);
+
+#endif /* CONFIG_FIELDS_H */
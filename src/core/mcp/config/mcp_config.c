@@ -3,7 +3,7 @@
  * @brief Implementation of MCP configuration system
  */
 #include "mcp_config.h"
-#include "../../../json/json_helpers.h"
+#include "config_fields.h"
 #include "../../../system/logging.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -68,14 +68,17 @@ static MCP_PLATFORM_CONFIG s_config;
 static bool s_config_initialized = false;
 static char s_default_config_path[256] = "/etc/mcp/config.json";
 
+// Serialized text of s_config, kept per section
+static MCP_ConfigJsonCache s_json_cache;
+
+// Values a null in a JSON update restores
+static MCP_PLATFORM_CONFIG s_defaults;
+static bool s_defaults_ready = false;
+
 /**
- * @brief Initialize configuration with default values
+ * @brief Fill a configuration with default values
  */
-int MCP_ConfigInit(MCP_PLATFORM_CONFIG* config) {
-    if (config == NULL) {
-        return -1;
-    }
-    
+static void setDefaults(MCP_PLATFORM_CONFIG* config) {
     // Initialize common config with defaults
     memset(config, 0, sizeof(MCP_PLATFORM_CONFIG));
     
@@ -164,6 +167,20 @@ int MCP_ConfigInit(MCP_PLATFORM_CONFIG* config) {
     config->enable_mock_hardware = true;
     config->test_mode = 0;
 #endif
+}
+
+/**
+ * @brief Initialize configuration with default values
+ */
+int MCP_ConfigInit(MCP_PLATFORM_CONFIG* config) {
+    if (config == NULL) {
+        return -1;
+    }
+    
+    setDefaults(config);
+    if (config == &s_config) {
+        MCP_ConfigJsonCacheInvalidate(&s_json_cache, MCP_CONFIG_ALL_SECTIONS);
+    }
     
     s_config_initialized = true;
     return 0;
@@ -315,14 +332,145 @@ int MCP_ConfigSave(const MCP_PLATFORM_CONFIG* config, const char* file_path) {
     return 0;
 }
 
+// Sections of the JSON document, in output order
+enum {
+    SECTION_DEVICE,
+    SECTION_SERVER,
+    SECTION_WIFI,
+    SECTION_WIFI_AP,
+    SECTION_BLE,
+    SECTION_ETHERNET,
+    SECTION_I2C,
+    SECTION_SPI,
+    SECTION_UART,
+    SECTION_GPIO,
+    SECTION_SYSTEM,
+    SECTION_PLATFORM,
+    SECTION_COUNT
+};
+
+static const char* const s_sections[] = {
+    "device",
+    "server",
+    "network.wifi",
+    "network.wifi_ap",
+    "network.ble",
+    "network.ethernet",
+    "interfaces.i2c",
+    "interfaces.spi",
+    "interfaces.uart",
+    "interfaces.gpio",
+    "system",
+#if defined(MCP_PLATFORM_RPI)
+    "platform.rpi",
+#elif defined(MCP_PLATFORM_ESP32)
+    "platform.esp32",
+#elif defined(MCP_PLATFORM_ARDUINO)
+    "platform.arduino",
+#elif defined(MCP_PLATFORM_MBED)
+    "platform.mbed",
+#elif defined(MCP_PLATFORM_HOST)
+    "platform.host",
+#endif
+};
+
+#define FIELD(section, name, type, member) MCP_CONFIG_FIELD(section, name, type, MCP_PLATFORM_CONFIG, member)
+
+// Every setting and where it lives in the JSON document
+static const MCP_ConfigField s_fields[] = {
+    FIELD(SECTION_DEVICE, "name", STRING, common.device_name),
+    FIELD(SECTION_DEVICE, "firmware_version", STRING, common.firmware_version),
+    FIELD(SECTION_DEVICE, "debug_enabled", BOOL, common.debug_enabled),
+
+    FIELD(SECTION_SERVER, "enabled", BOOL, common.server_enabled),
+    FIELD(SECTION_SERVER, "port", UINT, common.server_port),
+    FIELD(SECTION_SERVER, "auto_start", BOOL, common.auto_start_server),
+
+    FIELD(SECTION_WIFI, "enabled", BOOL, common.network.enabled),
+    FIELD(SECTION_WIFI, "ssid", STRING, common.network.ssid),
+    FIELD(SECTION_WIFI, "password", STRING, common.network.password),
+    FIELD(SECTION_WIFI, "auto_connect", BOOL, common.network.auto_connect),
+
+    FIELD(SECTION_WIFI_AP, "enabled", BOOL, common.network.ap.enabled),
+    FIELD(SECTION_WIFI_AP, "ssid", STRING, common.network.ap.ssid),
+    FIELD(SECTION_WIFI_AP, "password", STRING, common.network.ap.password),
+    FIELD(SECTION_WIFI_AP, "channel", UINT, common.network.ap.channel),
+
+    FIELD(SECTION_BLE, "enabled", BOOL, common.network.ble.enabled),
+    FIELD(SECTION_BLE, "device_name", STRING, common.network.ble.device_name),
+    FIELD(SECTION_BLE, "auto_advertise", BOOL, common.network.ble.auto_advertise),
+
+    FIELD(SECTION_ETHERNET, "enabled", BOOL, common.network.ethernet.enabled),
+    FIELD(SECTION_ETHERNET, "interface", STRING, common.network.ethernet.interface),
+    FIELD(SECTION_ETHERNET, "dhcp", BOOL, common.network.ethernet.dhcp),
+    FIELD(SECTION_ETHERNET, "static_ip", STRING, common.network.ethernet.static_ip),
+    FIELD(SECTION_ETHERNET, "gateway", STRING, common.network.ethernet.gateway),
+    FIELD(SECTION_ETHERNET, "subnet", STRING, common.network.ethernet.subnet),
+
+    FIELD(SECTION_I2C, "enabled", BOOL, common.interfaces.i2c.enabled),
+    FIELD(SECTION_I2C, "bus_number", INT, common.interfaces.i2c.bus_number),
+
+    FIELD(SECTION_SPI, "enabled", BOOL, common.interfaces.spi.enabled),
+    FIELD(SECTION_SPI, "bus_number", INT, common.interfaces.spi.bus_number),
+
+    FIELD(SECTION_UART, "enabled", BOOL, common.interfaces.uart.enabled),
+    FIELD(SECTION_UART, "number", INT, common.interfaces.uart.number),
+    FIELD(SECTION_UART, "baud_rate", UINT, common.interfaces.uart.baud_rate),
+
+    FIELD(SECTION_GPIO, "enabled", BOOL, common.interfaces.gpio.enabled),
+
+    FIELD(SECTION_SYSTEM, "heap_size", UINT, common.heap_size),
+    FIELD(SECTION_SYSTEM, "config_file_path", STRING, common.config_file_path),
+    FIELD(SECTION_SYSTEM, "enable_persistence", BOOL, common.enable_persistence),
+
+    // Platform-specific configurations
+#if defined(MCP_PLATFORM_RPI)
+    FIELD(SECTION_PLATFORM, "enable_camera", BOOL, enable_camera),
+    FIELD(SECTION_PLATFORM, "camera_resolution", INT, camera_resolution),
+
+#elif defined(MCP_PLATFORM_ESP32)
+    FIELD(SECTION_PLATFORM, "enable_ota", BOOL, enable_ota),
+    FIELD(SECTION_PLATFORM, "enable_web_server", BOOL, enable_web_server),
+    FIELD(SECTION_PLATFORM, "web_server_port", UINT, web_server_port),
+    FIELD(SECTION_PLATFORM, "enable_deep_sleep", BOOL, enable_deep_sleep),
+    FIELD(SECTION_PLATFORM, "deep_sleep_time_ms", UINT, deep_sleep_time_ms),
+
+#elif defined(MCP_PLATFORM_ARDUINO)
+    FIELD(SECTION_PLATFORM, "analog_reference", INT, analog_reference),
+    FIELD(SECTION_PLATFORM, "enable_watchdog", BOOL, enable_watchdog),
+
+#elif defined(MCP_PLATFORM_MBED)
+    FIELD(SECTION_PLATFORM, "enable_rtos", BOOL, enable_rtos),
+    FIELD(SECTION_PLATFORM, "task_stack_size", UINT, task_stack_size),
+
+#elif defined(MCP_PLATFORM_HOST)
+    FIELD(SECTION_PLATFORM, "enable_mock_hardware", BOOL, enable_mock_hardware),
+    FIELD(SECTION_PLATFORM, "test_mode", INT, test_mode),
+#endif
+};
+
+static const MCP_ConfigFieldTable s_field_table = {
+    s_sections, (uint8_t)(sizeof(s_sections) / sizeof(s_sections[0])),
+    s_fields, (uint16_t)(sizeof(s_fields) / sizeof(s_fields[0]))
+};
+
 /**
- * @brief Update a string field in the configuration
+ * @brief Apply a JSON update, reporting the sections it changed
  */
-static void updateStringField(char* dest, size_t dest_size, const char* src) {
-    if (src != NULL) {
-        memset(dest, 0, dest_size);
-        strncpy(dest, src, dest_size - 1);
+static int applyJsonUpdate(MCP_PLATFORM_CONFIG* config, const char* json_string, uint32_t* changed) {
+    // Null in an update restores the default value
+    if (!s_defaults_ready) {
+        setDefaults(&s_defaults);
+        s_defaults_ready = true;
     }
+    
+    int result = MCP_ConfigFieldsApplyPatch(&s_field_table, config, &s_defaults, json_string, changed);
+    
+    // Only the sections that changed are serialized again
+    if (result == 0 && config == &s_config) {
+        MCP_ConfigJsonCacheInvalidate(&s_json_cache, *changed);
+    }
+    return result;
 }
 
 /**
@@ -333,153 +481,8 @@ int MCP_ConfigUpdateFromJSON(MCP_PLATFORM_CONFIG* config, const char* json_strin
         return -1;
     }
     
-    // Device information
-    char* device_name = json_get_string_field(json_string, "device.name");
-    if (device_name != NULL) {
-        updateStringField(config->common.device_name, sizeof(config->common.device_name), device_name);
-        free(device_name);
-    }
-    
-    char* firmware_version = json_get_string_field(json_string, "device.firmware_version");
-    if (firmware_version != NULL) {
-        updateStringField(config->common.firmware_version, sizeof(config->common.firmware_version), firmware_version);
-        free(firmware_version);
-    }
-    
-    config->common.debug_enabled = json_get_bool_field(json_string, "device.debug_enabled", config->common.debug_enabled);
-    
-    // Server configuration
-    config->common.server_enabled = json_get_bool_field(json_string, "server.enabled", config->common.server_enabled);
-    config->common.server_port = json_get_int_field(json_string, "server.port", config->common.server_port);
-    config->common.auto_start_server = json_get_bool_field(json_string, "server.auto_start", config->common.auto_start_server);
-    
-    // Network - WiFi configuration
-    config->common.network.enabled = json_get_bool_field(json_string, "network.wifi.enabled", config->common.network.enabled);
-    
-    char* wifi_ssid = json_get_string_field(json_string, "network.wifi.ssid");
-    if (wifi_ssid != NULL) {
-        updateStringField(config->common.network.ssid, sizeof(config->common.network.ssid), wifi_ssid);
-        free(wifi_ssid);
-    }
-    
-    char* wifi_password = json_get_string_field(json_string, "network.wifi.password");
-    if (wifi_password != NULL) {
-        updateStringField(config->common.network.password, sizeof(config->common.network.password), wifi_password);
-        free(wifi_password);
-    }
-    
-    config->common.network.auto_connect = json_get_bool_field(json_string, "network.wifi.auto_connect", config->common.network.auto_connect);
-    
-    // Network - WiFi AP configuration
-    config->common.network.ap.enabled = json_get_bool_field(json_string, "network.wifi_ap.enabled", config->common.network.ap.enabled);
-    
-    char* ap_ssid = json_get_string_field(json_string, "network.wifi_ap.ssid");
-    if (ap_ssid != NULL) {
-        updateStringField(config->common.network.ap.ssid, sizeof(config->common.network.ap.ssid), ap_ssid);
-        free(ap_ssid);
-    }
-    
-    char* ap_password = json_get_string_field(json_string, "network.wifi_ap.password");
-    if (ap_password != NULL) {
-        updateStringField(config->common.network.ap.password, sizeof(config->common.network.ap.password), ap_password);
-        free(ap_password);
-    }
-    
-    config->common.network.ap.channel = json_get_int_field(json_string, "network.wifi_ap.channel", config->common.network.ap.channel);
-    
-    // Network - BLE configuration
-    config->common.network.ble.enabled = json_get_bool_field(json_string, "network.ble.enabled", config->common.network.ble.enabled);
-    
-    char* ble_device_name = json_get_string_field(json_string, "network.ble.device_name");
-    if (ble_device_name != NULL) {
-        updateStringField(config->common.network.ble.device_name, sizeof(config->common.network.ble.device_name), ble_device_name);
-        free(ble_device_name);
-    }
-    
-    config->common.network.ble.auto_advertise = json_get_bool_field(json_string, "network.ble.auto_advertise", config->common.network.ble.auto_advertise);
-    
-    // Network - Ethernet configuration
-    config->common.network.ethernet.enabled = json_get_bool_field(json_string, "network.ethernet.enabled", config->common.network.ethernet.enabled);
-    
-    char* ethernet_interface = json_get_string_field(json_string, "network.ethernet.interface");
-    if (ethernet_interface != NULL) {
-        updateStringField(config->common.network.ethernet.interface, sizeof(config->common.network.ethernet.interface), ethernet_interface);
-        free(ethernet_interface);
-    }
-    
-    config->common.network.ethernet.dhcp = json_get_bool_field(json_string, "network.ethernet.dhcp", config->common.network.ethernet.dhcp);
-    
-    char* ethernet_static_ip = json_get_string_field(json_string, "network.ethernet.static_ip");
-    if (ethernet_static_ip != NULL) {
-        updateStringField(config->common.network.ethernet.static_ip, sizeof(config->common.network.ethernet.static_ip), ethernet_static_ip);
-        free(ethernet_static_ip);
-    }
-    
-    char* ethernet_gateway = json_get_string_field(json_string, "network.ethernet.gateway");
-    if (ethernet_gateway != NULL) {
-        updateStringField(config->common.network.ethernet.gateway, sizeof(config->common.network.ethernet.gateway), ethernet_gateway);
-        free(ethernet_gateway);
-    }
-    
-    char* ethernet_subnet = json_get_string_field(json_string, "network.ethernet.subnet");
-    if (ethernet_subnet != NULL) {
-        updateStringField(config->common.network.ethernet.subnet, sizeof(config->common.network.ethernet.subnet), ethernet_subnet);
-        free(ethernet_subnet);
-    }
-    
-    // Interfaces - I2C configuration
-    config->common.interfaces.i2c.enabled = json_get_bool_field(json_string, "interfaces.i2c.enabled", config->common.interfaces.i2c.enabled);
-    config->common.interfaces.i2c.bus_number = json_get_int_field(json_string, "interfaces.i2c.bus_number", config->common.interfaces.i2c.bus_number);
-    
-    // Interfaces - SPI configuration
-    config->common.interfaces.spi.enabled = json_get_bool_field(json_string, "interfaces.spi.enabled", config->common.interfaces.spi.enabled);
-    config->common.interfaces.spi.bus_number = json_get_int_field(json_string, "interfaces.spi.bus_number", config->common.interfaces.spi.bus_number);
-    
-    // Interfaces - UART configuration
-    config->common.interfaces.uart.enabled = json_get_bool_field(json_string, "interfaces.uart.enabled", config->common.interfaces.uart.enabled);
-    config->common.interfaces.uart.number = json_get_int_field(json_string, "interfaces.uart.number", config->common.interfaces.uart.number);
-    config->common.interfaces.uart.baud_rate = json_get_int_field(json_string, "interfaces.uart.baud_rate", config->common.interfaces.uart.baud_rate);
-    
-    // Interfaces - GPIO configuration
-    config->common.interfaces.gpio.enabled = json_get_bool_field(json_string, "interfaces.gpio.enabled", config->common.interfaces.gpio.enabled);
-    
-    // System configurations
-    config->common.heap_size = json_get_int_field(json_string, "system.heap_size", config->common.heap_size);
-    
-    char* config_file_path = json_get_string_field(json_string, "system.config_file_path");
-    if (config_file_path != NULL) {
-        updateStringField(config->common.config_file_path, sizeof(config->common.config_file_path), config_file_path);
-        free(config_file_path);
-    }
-    
-    config->common.enable_persistence = json_get_bool_field(json_string, "system.enable_persistence", config->common.enable_persistence);
-    
-    // Platform-specific configurations
-#if defined(MCP_PLATFORM_RPI)
-    config->enable_camera = json_get_bool_field(json_string, "platform.rpi.enable_camera", config->enable_camera);
-    config->camera_resolution = json_get_int_field(json_string, "platform.rpi.camera_resolution", config->camera_resolution);
-    
-#elif defined(MCP_PLATFORM_ESP32)
-    config->enable_ota = json_get_bool_field(json_string, "platform.esp32.enable_ota", config->enable_ota);
-    config->enable_web_server = json_get_bool_field(json_string, "platform.esp32.enable_web_server", config->enable_web_server);
-    config->web_server_port = json_get_int_field(json_string, "platform.esp32.web_server_port", config->web_server_port);
-    config->enable_deep_sleep = json_get_bool_field(json_string, "platform.esp32.enable_deep_sleep", config->enable_deep_sleep);
-    config->deep_sleep_time_ms = json_get_int_field(json_string, "platform.esp32.deep_sleep_time_ms", config->deep_sleep_time_ms);
-    
-#elif defined(MCP_PLATFORM_ARDUINO)
-    config->analog_reference = json_get_int_field(json_string, "platform.arduino.analog_reference", config->analog_reference);
-    config->enable_watchdog = json_get_bool_field(json_string, "platform.arduino.enable_watchdog", config->enable_watchdog);
-    
-#elif defined(MCP_PLATFORM_MBED)
-    config->enable_rtos = json_get_bool_field(json_string, "platform.mbed.enable_rtos", config->enable_rtos);
-    config->task_stack_size = json_get_int_field(json_string, "platform.mbed.task_stack_size", config->task_stack_size);
-
-#elif defined(MCP_PLATFORM_HOST)
-    config->enable_mock_hardware = json_get_bool_field(json_string, "platform.host.enable_mock_hardware", config->enable_mock_hardware);
-    config->test_mode = json_get_int_field(json_string, "platform.host.test_mode", config->test_mode);
-#endif
-    
-    return 0;
+    uint32_t changed = 0;
+    return applyJsonUpdate(config, json_string, &changed);
 }
 
 /**
@@ -490,227 +493,9 @@ int MCP_ConfigSerializeToJSON(const MCP_PLATFORM_CONFIG* config, char* buffer, s
         return -1;
     }
     
-    int pos = 0;
-    pos += snprintf(buffer + pos, size - pos, "{\n");
-    
-    // Device information
-    pos += snprintf(buffer + pos, size - pos,
-        "  \"device\": {\n"
-        "    \"name\": \"%s\",\n"
-        "    \"firmware_version\": \"%s\",\n"
-        "    \"debug_enabled\": %s\n"
-        "  },\n",
-        config->common.device_name,
-        config->common.firmware_version,
-        config->common.debug_enabled ? "true" : "false"
-    );
-    
-    // Server configuration
-    pos += snprintf(buffer + pos, size - pos,
-        "  \"server\": {\n"
-        "    \"enabled\": %s,\n"
-        "    \"port\": %u,\n"
-        "    \"auto_start\": %s\n"
-        "  },\n",
-        config->common.server_enabled ? "true" : "false",
-        config->common.server_port,
-        config->common.auto_start_server ? "true" : "false"
-    );
-    
-    // Network configuration
-    pos += snprintf(buffer + pos, size - pos, "  \"network\": {\n");
-    
-    // WiFi configuration
-    pos += snprintf(buffer + pos, size - pos,
-        "    \"wifi\": {\n"
-        "      \"enabled\": %s,\n"
-        "      \"ssid\": \"%s\",\n"
-        "      \"password\": \"%s\",\n"
-        "      \"auto_connect\": %s\n"
-        "    },\n",
-        config->common.network.enabled ? "true" : "false",
-        config->common.network.ssid,
-        config->common.network.password,
-        config->common.network.auto_connect ? "true" : "false"
-    );
-    
-    // WiFi AP configuration
-    pos += snprintf(buffer + pos, size - pos,
-        "    \"wifi_ap\": {\n"
-        "      \"enabled\": %s,\n"
-        "      \"ssid\": \"%s\",\n"
-        "      \"password\": \"%s\",\n"
-        "      \"channel\": %u\n"
-        "    },\n",
-        config->common.network.ap.enabled ? "true" : "false",
-        config->common.network.ap.ssid,
-        config->common.network.ap.password,
-        config->common.network.ap.channel
-    );
-    
-    // BLE configuration
-    pos += snprintf(buffer + pos, size - pos,
-        "    \"ble\": {\n"
-        "      \"enabled\": %s,\n"
-        "      \"device_name\": \"%s\",\n"
-        "      \"auto_advertise\": %s\n"
-        "    },\n",
-        config->common.network.ble.enabled ? "true" : "false",
-        config->common.network.ble.device_name,
-        config->common.network.ble.auto_advertise ? "true" : "false"
-    );
-    
-    // Ethernet configuration
-    pos += snprintf(buffer + pos, size - pos,
-        "    \"ethernet\": {\n"
-        "      \"enabled\": %s,\n"
-        "      \"interface\": \"%s\",\n"
-        "      \"dhcp\": %s,\n"
-        "      \"static_ip\": \"%s\",\n"
-        "      \"gateway\": \"%s\",\n"
-        "      \"subnet\": \"%s\"\n"
-        "    }\n"
-        "  },\n",
-        config->common.network.ethernet.enabled ? "true" : "false",
-        config->common.network.ethernet.interface,
-        config->common.network.ethernet.dhcp ? "true" : "false",
-        config->common.network.ethernet.static_ip,
-        config->common.network.ethernet.gateway,
-        config->common.network.ethernet.subnet
-    );
-    
-    // Interface configurations
-    pos += snprintf(buffer + pos, size - pos, "  \"interfaces\": {\n");
-    
-    // I2C configuration
-    pos += snprintf(buffer + pos, size - pos,
-        "    \"i2c\": {\n"
-        "      \"enabled\": %s,\n"
-        "      \"bus_number\": %d\n"
-        "    },\n",
-        config->common.interfaces.i2c.enabled ? "true" : "false",
-        config->common.interfaces.i2c.bus_number
-    );
-    
-    // SPI configuration
-    pos += snprintf(buffer + pos, size - pos,
-        "    \"spi\": {\n"
-        "      \"enabled\": %s,\n"
-        "      \"bus_number\": %d\n"
-        "    },\n",
-        config->common.interfaces.spi.enabled ? "true" : "false",
-        config->common.interfaces.spi.bus_number
-    );
-    
-    // UART configuration
-    pos += snprintf(buffer + pos, size - pos,
-        "    \"uart\": {\n"
-        "      \"enabled\": %s,\n"
-        "      \"number\": %d,\n"
-        "      \"baud_rate\": %u\n"
-        "    },\n",
-        config->common.interfaces.uart.enabled ? "true" : "false",
-        config->common.interfaces.uart.number,
-        config->common.interfaces.uart.baud_rate
-    );
-    
-    // GPIO configuration
-    pos += snprintf(buffer + pos, size - pos,
-        "    \"gpio\": {\n"
-        "      \"enabled\": %s\n"
-        "    }\n"
-        "  },\n",
-        config->common.interfaces.gpio.enabled ? "true" : "false"
-    );
-    
-    // System configurations
-    pos += snprintf(buffer + pos, size - pos,
-        "  \"system\": {\n"
-        "    \"heap_size\": %u,\n"
-        "    \"config_file_path\": \"%s\",\n"
-        "    \"enable_persistence\": %s\n"
-        "  }",
-        config->common.heap_size,
-        config->common.config_file_path,
-        config->common.enable_persistence ? "true" : "false"
-    );
-    
-    // Platform-specific configurations
-#if defined(MCP_PLATFORM_RPI)
-    pos += snprintf(buffer + pos, size - pos,
-        ",\n"
-        "  \"platform\": {\n"
-        "    \"rpi\": {\n"
-        "      \"enable_camera\": %s,\n"
-        "      \"camera_resolution\": %d\n"
-        "    }\n"
-        "  }",
-        config->enable_camera ? "true" : "false",
-        config->camera_resolution
-    );
-    
-#elif defined(MCP_PLATFORM_ESP32)
-    pos += snprintf(buffer + pos, size - pos,
-        ",\n"
-        "  \"platform\": {\n"
-        "    \"esp32\": {\n"
-        "      \"enable_ota\": %s,\n"
-        "      \"enable_web_server\": %s,\n"
-        "      \"web_server_port\": %u,\n"
-        "      \"enable_deep_sleep\": %s,\n"
-        "      \"deep_sleep_time_ms\": %u\n"
-        "    }\n"
-        "  }",
-        config->enable_ota ? "true" : "false",
-        config->enable_web_server ? "true" : "false",
-        config->web_server_port,
-        config->enable_deep_sleep ? "true" : "false",
-        config->deep_sleep_time_ms
-    );
-    
-#elif defined(MCP_PLATFORM_ARDUINO)
-    pos += snprintf(buffer + pos, size - pos,
-        ",\n"
-        "  \"platform\": {\n"
-        "    \"arduino\": {\n"
-        "      \"analog_reference\": %d,\n"
-        "      \"enable_watchdog\": %s\n"
-        "    }\n"
-        "  }",
-        config->analog_reference,
-        config->enable_watchdog ? "true" : "false"
-    );
-    
-#elif defined(MCP_PLATFORM_MBED)
-    pos += snprintf(buffer + pos, size - pos,
-        ",\n"
-        "  \"platform\": {\n"
-        "    \"mbed\": {\n"
-        "      \"enable_rtos\": %s,\n"
-        "      \"task_stack_size\": %u\n"
-        "    }\n"
-        "  }",
-        config->enable_rtos ? "true" : "false",
-        config->task_stack_size
-    );
-
-#elif defined(MCP_PLATFORM_HOST)
-    pos += snprintf(buffer + pos, size - pos,
-        ",\n"
-        "  \"platform\": {\n"
-        "    \"host\": {\n"
-        "      \"enable_mock_hardware\": %s,\n"
-        "      \"test_mode\": %d\n"
-        "    }\n"
-        "  }",
-        config->enable_mock_hardware ? "true" : "false",
-        config->test_mode
-    );
-#endif
-    
-    pos += snprintf(buffer + pos, size - pos, "\n}\n");
-    
-    return pos;
+    // Only the global instance changes through this module, so only its text is cached
+    MCP_ConfigJsonCache* cache = config == &s_config ? &s_json_cache : NULL;
+    return MCP_ConfigFieldsSerialize(&s_field_table, config, cache, buffer, size);
 }
 
 /**
@@ -736,13 +521,14 @@ int MCP_SetConfiguration(const char* json_config) {
         MCP_ConfigInit(&s_config);
     }
     
-    int result = MCP_ConfigUpdateFromJSON(&s_config, json_config);
+    uint32_t changed = 0;
+    int result = applyJsonUpdate(&s_config, json_config, &changed);
     if (result != 0) {
         return result;
     }
     
-    // Save the updated configuration if persistence is enabled
-    if (s_config.common.enable_persistence) {
+    // Save the updated configuration if persistence is enabled and anything changed
+    if (changed != 0 && s_config.common.enable_persistence) {
         result = MCP_ConfigSave(&s_config, NULL);
         if (result != 0) {
             return result;
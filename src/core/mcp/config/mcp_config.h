@@ -188,9 +188,13 @@ int MCP_ConfigSave(const MCP_PLATFORM_CONFIG* config, const char* file_path);
 /**
  * @brief Update configuration from JSON string
  * 
+ * The JSON is a merge patch in the layout MCP_ConfigSerializeToJSON writes:
+ * only the members it names change, and null restores a member or a whole
+ * section to its default. Dotted names such as "server.port" also work.
+ * 
  * @param config Pointer to configuration structure to update
  * @param json_string JSON string containing configuration updates
- * @return int 0 on success, negative error code on failure
+ * @return int 0 on success, -2 if the JSON is malformed (nothing changes), other negative error code on failure
  */
 int MCP_ConfigUpdateFromJSON(MCP_PLATFORM_CONFIG* config, const char* json_string);
 
@@ -200,7 +204,7 @@ int MCP_ConfigUpdateFromJSON(MCP_PLATFORM_CONFIG* config, const char* json_strin
  * @param config Pointer to configuration structure to serialize
  * @param buffer Buffer to store JSON string
  * @param size Size of buffer
- * @return int Length of JSON string written, or negative error code 
+ * @return int Length of JSON string written, or negative error code (-2 if the buffer is too small)
  */
 int MCP_ConfigSerializeToJSON(const MCP_PLATFORM_CONFIG* config, char* buffer, size_t size);
 
@@ -214,6 +218,9 @@ const char* MCP_ConfigGetDefaultPath(void);
 /**
  * @brief Platform-independent API for setting configuration via JSON
  * 
+ * Applies the JSON as an update (see MCP_ConfigUpdateFromJSON) and saves the
+ * configuration only if a value changed.
+ * 
  * @param json_config JSON string containing configuration updates
  * @return int 0 on success, negative error code on failure
  */
@@ -222,6 +229,9 @@ int MCP_SetConfiguration(const char* json_config);
 /**
  * @brief Platform-independent API for getting configuration as JSON
  * 
+ * The text is cached and only sections changed since the last call are
+ * serialized again.
+ * 
  * @param buffer Buffer to store JSON string
  * @param size Size of buffer
  * @return int Length of JSON string written, or negative error code
@@ -48,22 +48,27 @@ int MCP_ServerBroadcastEvent(struct MCP_Server* server, const char* eventType, M
     return 0;
 }
 
-uint32_t MCP_GetCurrentTimeMs(void) {
+uint64_t MCP_GetCurrentTimeMs(void) {
     return 0;
 }
 #endif
 
+// Largest log event sent to subscribers; longer messages are cut
+#define MCP_LOG_EVENT_SIZE 768
+
 // Static variables
 static struct MCP_Server* s_server = NULL;
 static LogLevel s_maxLevel = LOG_LEVEL_INFO;
 static bool s_enabled = false;
-static void (*s_originalLogCallback)(LogLevel level, const char* message) = NULL;
+static int s_sinkId = -1;
 
 // Module filtering
 static bool s_filterByModule = false;
 static char** s_allowedModules = NULL;
 static uint32_t s_allowedModuleCount = 0;
 static uint32_t s_allowedModuleCapacity = 0;
+static uint32_t s_allowedModuleMask = 0;    // Bit per interned module ID in the list
+static uint32_t s_unmappedModuleCount = 0;  // Listed modules beyond the table, matched by name
 
 // Log formatting
 static bool s_includeTimestamp = true;
@@ -72,9 +77,9 @@ static bool s_includeModuleName = true;
 static uint32_t s_outputs = LOG_OUTPUT_SERIAL | LOG_OUTPUT_MEMORY;
 
 // Forward declarations
-static void mcp_log_callback(LogLevel level, const char* message);
-static int mcp_send_log_event(LogLevel level, const char* module, const char* message);
-static bool is_module_allowed(const char* module);
+static void mcp_log_sink(const LogEntry* entry, void* context);
+static void update_sink_filter(void);
+static bool is_unmapped_module_allowed(const char* module);
 static int parse_log_config(const MCP_Content* content, MCP_LogConfig* config);
 static int serialize_log_config(const MCP_LogConfig* config, MCP_Content* content);
 
@@ -98,9 +103,14 @@ int MCP_LoggingInit(struct MCP_Server* server, LogLevel maxLevel) {
     s_includeModuleName = true;
     s_outputs = LOG_OUTPUT_SERIAL | LOG_OUTPUT_MEMORY;
     
-    // Store the original log callback if any
-    s_originalLogCallback = NULL;
-    log_set_custom_callback(&mcp_log_callback);
+    // Receive structured entries from the logging core
+    if (s_sinkId < 0) {
+        s_sinkId = log_add_sink(&mcp_log_sink, NULL, maxLevel, LOG_ALL_MODULES);
+        if (s_sinkId < 0) {
+            return -2;
+        }
+    }
+    update_sink_filter();
     
     return 0;
 }
@@ -109,15 +119,17 @@ int MCP_LoggingInit(struct MCP_Server* server, LogLevel maxLevel) {
  * @brief Deinitialize MCP logging bridge
  */
 int MCP_LoggingDeinit(void) {
-    // Restore original callback
-    log_set_custom_callback(s_originalLogCallback);
+    // Stop receiving log entries
+    if (s_sinkId >= 0) {
+        log_remove_sink(s_sinkId);
+        s_sinkId = -1;
+    }
     
     // Free module list
     MCP_LoggingClearAllowedModules();
     
     s_server = NULL;
     s_enabled = false;
-    s_originalLogCallback = NULL;
     
     return 0;
 }
@@ -128,6 +140,7 @@ int MCP_LoggingDeinit(void) {
 LogLevel MCP_LoggingSetMaxLevel(LogLevel level) {
     LogLevel prevLevel = s_maxLevel;
     s_maxLevel = level;
+    update_sink_filter();
     return prevLevel;
 }
 
@@ -144,6 +157,7 @@ LogLevel MCP_LoggingGetMaxLevel(void) {
 bool MCP_LoggingEnable(bool enable) {
     bool prevState = s_enabled;
     s_enabled = enable;
+    update_sink_filter();
     return prevState;
 }
 
@@ -240,11 +254,11 @@ int MCP_LoggingSetConfig(const MCP_LogConfig* config) {
         .includeLevelName = s_includeLevelName,
         .includeModuleName = s_includeModuleName,
         .colorOutput = true,
-        .customLogCallback = s_originalLogCallback
+        .customLogCallback = NULL
     };
     
     log_init(&sysLogConfig);
-    log_set_custom_callback(&mcp_log_callback);
+    update_sink_filter();
     
     return 0;
 }
@@ -283,6 +297,16 @@ int MCP_LoggingAddAllowedModule(const char* moduleName) {
     }
     
     s_allowedModuleCount++;
+    
+    // Modules beyond the logging core's table share ID 0; the sink takes
+    // those and compares their names against the list
+    int moduleId = log_module_id(moduleName);
+    if (moduleId > 0) {
+        s_allowedModuleMask |= 1u << moduleId;
+    } else {
+        s_unmappedModuleCount++;
+    }
+    update_sink_filter();
     return 0;
 }
 
@@ -306,6 +330,14 @@ int MCP_LoggingRemoveAllowedModule(const char* moduleName) {
             }
             
             s_allowedModuleCount--;
+            
+            int moduleId = log_module_id(moduleName);
+            if (moduleId > 0) {
+                s_allowedModuleMask &= ~(1u << moduleId);
+            } else {
+                s_unmappedModuleCount--;
+            }
+            update_sink_filter();
             return 0;
         }
     }
@@ -328,6 +360,9 @@ int MCP_LoggingClearAllowedModules(void) {
     
     s_allowedModuleCount = 0;
     s_allowedModuleCapacity = 0;
+    s_allowedModuleMask = 0;
+    s_unmappedModuleCount = 0;
+    update_sink_filter();
     return 0;
 }
 
@@ -337,6 +372,7 @@ int MCP_LoggingClearAllowedModules(void) {
 bool MCP_LoggingSetFilterByModule(bool enable) {
     bool prevState = s_filterByModule;
     s_filterByModule = enable;
+    update_sink_filter();
     return prevState;
 }
 
@@ -514,119 +550,136 @@ int MCP_LoggingSendConfig(const char* sessionId, const char* operationId) {
 }
 
 /**
- * @brief Custom log callback to forward logs to MCP clients
+ * @brief Pass the bridge's level and module filter to the logging core
+ *
+ * Messages the bridge would not send are then dropped before formatting.
  */
-static void mcp_log_callback(LogLevel level, const char* message) {
-    if (!s_enabled || level > s_maxLevel || s_server == NULL) {
-        // If disabled or level too high, skip
-        if (s_originalLogCallback != NULL) {
-            s_originalLogCallback(level, message);
-        }
+static void update_sink_filter(void) {
+    if (s_sinkId < 0) {
         return;
     }
     
-    // Extract module name from message (assumes format "[MODULE] message")
-    const char* moduleEnd = strchr(message, ']');
-    const char* moduleStart = strchr(message, '[');
-    
-    char module[32] = "unknown";
-    if (moduleStart != NULL && moduleEnd != NULL && moduleEnd > moduleStart) {
-        size_t moduleLen = moduleEnd - moduleStart - 1;
-        if (moduleLen < sizeof(module)) {
-            strncpy(module, moduleStart + 1, moduleLen);
-            module[moduleLen] = '\0';
-        }
+    LogLevel level = (s_enabled && s_server != NULL) ? s_maxLevel : LOG_LEVEL_NONE;
+    uint32_t mask = LOG_ALL_MODULES;
+    if (s_filterByModule) {
+        mask = s_allowedModuleMask | (s_unmappedModuleCount > 0 ? 1u : 0u);
     }
-    
-    // Check module filtering
-    if (s_filterByModule && !is_module_allowed(module)) {
-        // Skip this module
-        if (s_originalLogCallback != NULL) {
-            s_originalLogCallback(level, message);
-        }
-        return;
+    log_set_sink_filter(s_sinkId, level, mask);
+}
+
+/**
+ * @brief Check whether a module without an interned ID is in the allowed list
+ */
+static bool is_unmapped_module_allowed(const char* module) {
+    if (module == NULL || *module == '\0') {
+        return false;
     }
-    
-    // Extract actual message (after the module prefix)
-    const char* actualMessage = message;
-    if (moduleEnd != NULL) {
-        actualMessage = moduleEnd + 1;
-        while (*actualMessage == ' ') {
-            actualMessage++;
+    for (uint32_t i = 0; i < s_allowedModuleCount; i++) {
+        if (s_allowedModules[i] != NULL && strcmp(s_allowedModules[i], module) == 0) {
+            return true;
         }
     }
-    
-    // Send the log message as an MCP event
-    mcp_send_log_event(level, module, actualMessage);
-    
-    // Chain to original callback if any
-    if (s_originalLogCallback != NULL) {
-        s_originalLogCallback(level, message);
-    }
+    return false;
 }
 
 /**
- * @brief Send a log message as an MCP event
+ * @brief Append a string to an event as a JSON string literal
  */
-static int mcp_send_log_event(LogLevel level, const char* module, const char* message) {
-    if (s_server == NULL || !s_enabled) {
-        return -1;
-    }
-    
-    // Create event content
-    MCP_Content* content = MCP_ContentCreateObject();
-    if (content == NULL) {
-        return -1;
+static size_t append_json_string(char* out, size_t size, size_t length, const char* text, size_t textLength) {
+    static const char hex[] = "0123456789abcdef";
+    
+    // Leave room for the closing quote and the rest of the event
+    size_t limit = size - 160;
+    out[length++] = '"';
+    for (size_t i = 0; i < textLength && length < limit; i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c == '"' || c == '\\') {
+            out[length++] = '\\';
+            out[length++] = (char)c;
+        } else if (c == '\n') {
+            out[length++] = '\\';
+            out[length++] = 'n';
+        } else if (c < 0x20) {
+            memcpy(out + length, "\\u00", 4);
+            out[length + 4] = hex[c >> 4];
+            out[length + 5] = hex[c & 0x0F];
+            length += 6;
+        } else {
+            out[length++] = (char)c;
+        }
     }
+    out[length++] = '"';
+    return length;
+}
+
+/**
+ * @brief Append a constant to an event
+ */
+static size_t append_text(char* out, size_t length, const char* text) {
+    size_t textLength = strlen(text);
+    memcpy(out + length, text, textLength);
+    return length + textLength;
+}
+
+/**
+ * @brief Render a log entry as a log event
+ *
+ * @return int Length of the event
+ */
+static int render_log_event(const LogEntry* entry, char* out, size_t size) {
+    char number[24];
+    size_t length = 0;
+    
+    snprintf(number, sizeof(number), "%d", (int)entry->level);
+    length = append_text(out, length, "{\"level\":");
+    length = append_text(out, length, number);
+    length = append_text(out, length, ",\"levelName\":\"");
+    length = append_text(out, length, log_level_name(entry->level));
+    length = append_text(out, length, "\",\"module\":");
+    const char* module = entry->module[0] != '\0' ? entry->module : "unknown";
+    length = append_json_string(out, size, length, module, strlen(module));
+    length = append_text(out, length, ",\"message\":");
+    length = append_json_string(out, size, length, entry->message, entry->messageLength);
     
-    // Add log data
-    MCP_ContentAddNumber(content, "level", (double)level);
-    MCP_ContentAddString(content, "levelName", log_level_name(level));
-    MCP_ContentAddString(content, "module", module);
-    MCP_ContentAddString(content, "message", message);
     #if defined(MCP_PLATFORM_ARDUINO) || defined(MCP_OS_ARDUINO)
     // For Arduino, use a simpler timestamp approach
-    MCP_ContentAddNumber(content, "timestamp", (double)time(NULL) * 1000);
+    snprintf(number, sizeof(number), "%.0f", (double)time(NULL) * 1000);
     #else
-    MCP_ContentAddNumber(content, "timestamp", (double)MCP_GetCurrentTimeMs());
+    snprintf(number, sizeof(number), "%.0f", (double)MCP_GetCurrentTimeMs());
     #endif
+    length = append_text(out, length, ",\"timestamp\":");
+    length = append_text(out, length, number);
     
     // Add formatting flags
-    MCP_ContentAddBoolean(content, "includeTimestamp", s_includeTimestamp);
-    MCP_ContentAddBoolean(content, "includeLevelName", s_includeLevelName);
-    MCP_ContentAddBoolean(content, "includeModuleName", s_includeModuleName);
-    
-    // Send to all subscribed sessions
-    #if defined(MCP_PLATFORM_ARDUINO) || defined(MCP_OS_ARDUINO)
-    // For Arduino, use the other server event function
-    int result = MCP_ServerSendEvent(MCP_EVENT_TYPE_LOG, (const uint8_t*)content->resultJson, strlen(content->resultJson));
-    #else
-    int result = MCP_ServerBroadcastEvent(s_server, MCP_EVENT_TYPE_LOG, content);
-    #endif
-    
-    MCP_ContentFree(content);
-    return result;
+    length = append_text(out, length, s_includeTimestamp ? ",\"includeTimestamp\":true" : ",\"includeTimestamp\":false");
+    length = append_text(out, length, s_includeLevelName ? ",\"includeLevelName\":true" : ",\"includeLevelName\":false");
+    length = append_text(out, length, s_includeModuleName ? ",\"includeModuleName\":true}" : ",\"includeModuleName\":false}");
+    out[length] = '\0';
+    return (int)length;
 }
 
 /**
- * @brief Check if a module is in the allowed list
+ * @brief Sink forwarding log entries to subscribed clients
+ *
+ * The logging core has already applied the level and module filter, so the
+ * entry only needs to be rendered once and sent.
  */
-static bool is_module_allowed(const char* module) {
-    if (!s_filterByModule || module == NULL) {
-        return true;
+static void mcp_log_sink(const LogEntry* entry, void* context) {
+    (void)context;
+    if (s_server == NULL || !s_enabled) {
+        return;
     }
     
-    if (s_allowedModules == NULL || s_allowedModuleCount == 0) {
-        return false;
+    // ID 0 reaches this sink only when a listed module has no ID of its own
+    if (s_filterByModule && entry->moduleId == 0 && !is_unmapped_module_allowed(entry->module)) {
+        return;
     }
     
-    for (uint32_t i = 0; i < s_allowedModuleCount; i++) {
-        if (s_allowedModules[i] != NULL && strcmp(s_allowedModules[i], module) == 0) {
-            return true;
-        }
-    }
+    char event[MCP_LOG_EVENT_SIZE];
+    int length = render_log_event(entry, event, sizeof(event));
     
-    return false;
+    // Send to all subscribed sessions
+    MCP_ServerSendEvent(MCP_EVENT_TYPE_LOG, (const uint8_t*)event, (size_t)length);
 }
 
 /**
@@ -9,10 +9,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-// Forward declare MCP_Server for host platform
-#if defined(MCP_PLATFORM_HOST)
+// Forward declare MCP_Server, which not every platform's server header defines
 struct MCP_Server;
-#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -58,8 +58,11 @@ int MCP_SendToolResult(struct MCP_ServerTransport* transport, const char* sessio
 struct MCP_Content* MCP_ContentCreateObject(void);
 bool MCP_ContentAddString(struct MCP_Content* content, const char* key, const char* value);
 bool MCP_ContentAddBoolean(struct MCP_Content* content, const char* key, bool value);
+// content.h declares it with the MCP_ContentType parameter when included first
+#if !defined(MCP_CONTENT_DEFINED)
 struct MCP_Content* MCP_ContentCreate(int type, const uint8_t* data, size_t size, const char* mediaType);
 #endif
+#endif
 
 #ifdef __cplusplus
 }
@@ -1,8 +1,15 @@
 #include "automation_engine.h"
+#include "rule_interpreter.h"
 #include "tool_registry.h"
+#include "tool_info.h"
+#include "../mcp/content.h"
+#include "../mcp/server_defs.h"
+#include "../kernel/event_system.h"
+#include "../../util/crc32.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdarg.h>
 
 #ifdef MCP_PLATFORM_ARDUINO
 #include "platform_compatibility.h"
@@ -14,42 +21,45 @@ extern int persistent_storage_read(const char* key, void* data, size_t maxSize,
 extern char* json_get_string_field(const char* json, const char* field);
 extern bool json_validate_schema(const char* json, const char* schema);
 extern bool json_get_bool_field(const char* json, const char* field, bool defaultValue);
+extern double json_get_double_field(const char* json, const char* field, double defaultValue);
+extern void* json_get_object_field(const char* json, const char* field);
 extern void* json_get_array_field(const char* json, const char* field);
+extern size_t json_array_length(const void* array);
+extern char* json_array_get_item(const void* array, size_t index);
+extern void json_array_free(void* array);
+extern int MCP_ActuatorSendCommand(const char* id, const char* command, const char* params);
 
-#ifndef MCP_PLATFORM_ARDUINO
-// Forward declarations of internal functions
-static void freeRuleTrigger(RuleTrigger* trigger);
-static void freeRuleAction(RuleAction* action);
-static void freeRule(AutomationRule* rule);
-static bool evaluateCondition(RuleTrigger* trigger, uint32_t currentTimeMs);
-static int executeAction(RuleAction* action);
-#endif
+// Maximum number of top-level conjuncts in a condition expression
+#define MAX_CONDITION_TERMS 16
+
+struct Rule;
+struct ConditionNode;
 
 // Trigger structure
 typedef struct {
     MCP_TriggerType type;
+    int timerIndex;                         // Position in the deadline queue, -1 if none
     union {
         struct {
-            char* sensor;
-            MCP_ConditionOperator op_type; // Changed from 'operator' to 'op_type' to avoid C++ reserved word
-            union {
-                bool boolValue;
-                int32_t intValue;
-                float floatValue;
-                char* stringValue;
-            } value;
-            uint32_t checkInterval;
-            uint32_t lastCheckTime;
+            char* expression;               // Condition in rule interpreter syntax
+            struct ConditionNode** nodes;   // Shared nodes for the top-level conjuncts
+            uint8_t nodeCount;
+            uint8_t satisfiedCount;         // Conjuncts currently true (partial match state)
+            bool active;                    // Fired and not yet released
+            uint32_t holdMs;                // Must stay satisfied this long before firing
+            char* releaseExpression;        // Hysteresis: re-arms only once this holds
+            struct ConditionNode* releaseNode;
         } condition;
-        
+
         struct {
-            char* eventType;
-            char* eventSource;
+            MCP_EventType eventType;
+            char* eventSource;              // NULL matches any source
         } event;
-        
+
         struct {
             uint32_t intervalMs;
-            uint32_t lastTriggerTime;
+            uint32_t offsetMs;              // Phase of the occurrences within the interval
+            uint32_t nextTriggerTime;
         } schedule;
     } config;
 } RuleTrigger;
@@ -62,19 +72,20 @@ typedef struct {
             char* target;
             char* command;
             char* paramsJson;
+            int writeId;            // Interned (target, command) pair, used to coalesce writes
         } actuator;
-        
+
         struct {
             char* tool;
             char* paramsJson;
         } tool;
-        
+
         struct {
             char* message;
             char* level;
             char* destination;
         } notification;
-        
+
         struct {
             char* handlerName;
             char* paramsJson;
@@ -83,7 +94,8 @@ typedef struct {
 } RuleAction;
 
 // Rule structure
-typedef struct {
+typedef struct Rule {
+    int handle;             // Index in s_rules
     char* id;
     char* name;
     char* description;
@@ -93,16 +105,178 @@ typedef struct {
     int actionCount;
     bool enabled;
     bool persistent;
+    bool ready;             // Queued to run its actions in the next pass
+    int priority;           // Higher runs first and wins coalesced writes
+
+    // Rate limiting
+    uint32_t minIntervalMs; // Minimum time between runs
+    uint32_t lastRunTime;
+    bool hasRun;
+    float tokenRate;        // Token bucket refill per millisecond
+    float tokenBurst;       // Token bucket capacity, 0 if unlimited
+    float tokens;
+    uint32_t tokenTime;     // Last refill time
+    uint32_t suppressedCount;
+
+    // Profiling (conditions are profiled per node, see ConditionNode)
+    uint32_t firings;
+    uint32_t actionsIssued;
+    uint32_t timedActions;  // Actions whose latency was measured
+    uint64_t latencyTicks;  // Ready to action issued, cumulative over the timed actions
+    uint32_t maxLatencyTicks;
+    uint32_t readyTicks;    // When the rule last became ready
+    uint32_t readySamples;  // Runs seen by the latency sampling
+    bool readyTimed;        // readyTicks was read for the current run
 } Rule;
 
-// Internal state
+// Reference from a condition node to a trigger that uses it
+typedef struct {
+    int rule;               // Rule handle
+    int trigger;
+    bool release;           // Node is the trigger's release condition
+} TriggerRef;
+
+// Condition node: one compiled sub-expression shared by every trigger that uses it
+typedef struct ConditionNode {
+    char* expression;       // Normalized expression text (sharing key)
+    uint32_t hash;          // Hash of expression
+    struct ConditionNode* nextInBucket;  // Next node in the same hash bucket
+    MCP_RuleProgram* program;
+    int* variables;         // Variable handles the expression reads
+    int variableCount;
+    TriggerRef* dependents;
+    int dependentCount;
+    int dependentCapacity;
+    bool value;             // Result of the last evaluation
+    bool dirty;             // An input changed since the last evaluation
+
+    // Profiling
+    uint32_t evaluations;
+    uint32_t trueResults;
+    uint32_t timedEvaluations;  // Evaluations that read the clock
+    uint64_t evalTicks;     // Cumulative time of the timed evaluations
+    uint32_t maxEvalTicks;
+} ConditionNode;
+
+// List of condition nodes that read one variable
+typedef struct {
+    ConditionNode** nodes;
+    int count;
+    int capacity;
+} NodeList;
+
+// Event trigger binding
+typedef struct {
+    char* source;
+    int rule;               // Rule handle
+} EventBinding;
+
+// Deadline queue entry for a schedule trigger or a hold timer
+typedef struct {
+    uint32_t deadline;      // Next fire time
+    int rule;               // Rule handle
+    int trigger;
+} ScheduleEntry;
+
+#define EVENT_TYPE_COUNT (MCP_EVENT_TYPE_TOOL + 1)
+
+// Internal state; rules are addressed by their slot index (handle)
 static Rule** s_rules = NULL;
 static int s_maxRules = 0;
-static int s_ruleCount = 0;
+static int s_ruleCount = 0;     // Slots in use, including freed ones below the highest live rule
 static bool s_initialized = false;
 
+// Dependency graph: variables -> condition nodes -> triggers
+static ConditionNode** s_nodes = NULL;
+static int s_nodeCount = 0;
+static int s_nodeCapacity = 0;
+static ConditionNode** s_nodeBuckets = NULL;  // Nodes chained by expression hash
+static uint32_t s_nodeBucketMask = 0;         // Bucket count - 1 (bucket count is a power of two)
+static NodeList* s_variableNodes = NULL;    // Indexed by variable handle
+static int s_variableNodeCapacity = 0;
+static ConditionNode** s_dirtyNodes = NULL;
+static int s_dirtyCount = 0;
+static int s_dirtyCapacity = 0;
+
+// Event bindings, bucketed by event type
+static EventBinding* s_eventBindings[EVENT_TYPE_COUNT] = {0};
+static int s_eventBindingCount[EVENT_TYPE_COUNT] = {0};
+static int s_eventBindingCapacity[EVENT_TYPE_COUNT] = {0};
+static uint32_t s_eventHandlerId = 0;
+
+// Schedule triggers and hold timers, min-heap ordered by deadline
+static ScheduleEntry* s_schedule = NULL;
+static int s_scheduleCount = 0;
+static int s_scheduleCapacity = 0;
+
+// Handles of rules whose triggers fired and await action execution
+static int* s_readyRules = NULL;
+static int s_readyCount = 0;
+static int s_readyCapacity = 0;
+
+// Actions fired in a pass, coalesced per actuator target and command and run by priority
+typedef struct {
+    int rule;               // Rule handle, -1 once the rule is deleted
+    int action;             // Index in the rule's actions
+    int priority;
+    uint32_t sequence;      // Enqueue order, breaks priority ties
+    uint32_t readyTicks;    // When the rule became ready (profiling)
+    bool timed;             // Whether readyTicks was read
+} QueuedAction;
+
+static QueuedAction* s_actionQueue = NULL;
+static int s_actionCount = 0;
+static int s_actionCapacity = 0;
+static uint32_t s_actionSequence = 0;
+static char** s_writeTargets = NULL;    // Interned actuator writes: target and command
+static char** s_writeCommands = NULL;
+static int* s_writePending = NULL;      // Queue index of each write's pending action, -1 if none
+static int s_writeCount = 0;
+static int s_writeCapacity = 0;
+static uint32_t s_actionBudgetUs = 0;
+static uint32_t (*s_actionClock)(void) = NULL;
+static MCP_AutomationActionStats s_actionStats;
+
+// Profiling; with no clock only the counters are kept
+static bool s_profiling = false;
+// Timing reads the clock for the first evaluation of a node and the first run
+// of a rule, then one in PROFILE_TIME_INTERVAL (a power of two) after that;
+// totals are scaled up from the timed samples
+#define PROFILE_TIME_INTERVAL 16
+static uint32_t (*s_profileClock)(void) = NULL;
+static uint32_t s_profileTicksPerUs = 1;
+
+static uint32_t s_currentTimeMs = 0;
+
 static char s_ruleIdCounter[16] = "rule_1";
 
+// Grow an array so it can hold one more element
+static bool growArray(void** array, int* capacity, int count, size_t elementSize) {
+    if (count < *capacity) {
+        return true;
+    }
+
+    int newCapacity = *capacity == 0 ? 8 : *capacity * 2;
+    void* newArray = realloc(*array, newCapacity * elementSize);
+    if (newArray == NULL) {
+        return false;
+    }
+
+    *array = newArray;
+    *capacity = newCapacity;
+    return true;
+}
+
+// Remove the first occurrence of an element from a pointer array (order not preserved)
+static void removePointer(void** array, int* count, const void* element) {
+    for (int i = 0; i < *count; i++) {
+        if (array[i] == element) {
+            array[i] = array[--(*count)];
+            return;
+        }
+    }
+}
+
 static void generateNextRuleId(void) {
     int idNumber = 1;
     sscanf(s_ruleIdCounter, "rule_%d", &idNumber);
@@ -110,468 +284,2705 @@ static void generateNextRuleId(void) {
     snprintf(s_ruleIdCounter, sizeof(s_ruleIdCounter), "rule_%d", idNumber);
 }
 
-static void freeRuleTrigger(RuleTrigger* trigger) {
-    if (trigger == NULL) {
-        return;
-    }
-    
-    switch (trigger->type) {
-        case MCP_TRIGGER_TYPE_CONDITION:
-            free(trigger->config.condition.sensor);
-            if (trigger->config.condition.op_type >= MCP_CONDITION_OP_CONTAINS && 
-                trigger->config.condition.op_type <= MCP_CONDITION_OP_ENDS_WITH) {
-                free(trigger->config.condition.value.stringValue);
-            }
-            break;
-            
-        case MCP_TRIGGER_TYPE_EVENT:
-            free(trigger->config.event.eventType);
-            free(trigger->config.event.eventSource);
-            break;
-            
-        case MCP_TRIGGER_TYPE_SCHEDULE:
-        case MCP_TRIGGER_TYPE_MANUAL:
-            // No dynamic memory to free
-            break;
-    }
+// Whether to time this run of the rule: its first run and one in PROFILE_TIME_INTERVAL after it
+static bool sampleRun(Rule* rule) {
+    return s_profileClock != NULL && (rule->readySamples++ & (PROFILE_TIME_INTERVAL - 1)) == 0;
 }
 
-static void freeRuleAction(RuleAction* action) {
-    if (action == NULL) {
+static void markRuleReady(Rule* rule) {
+    if (rule->ready) {
         return;
     }
-    
-    switch (action->type) {
-        case MCP_ACTION_TYPE_ACTUATOR:
-            free(action->config.actuator.target);
-            free(action->config.actuator.command);
-            free(action->config.actuator.paramsJson);
-            break;
-            
-        case MCP_ACTION_TYPE_TOOL:
-            free(action->config.tool.tool);
-            free(action->config.tool.paramsJson);
-            break;
-            
-        case MCP_ACTION_TYPE_NOTIFICATION:
-            free(action->config.notification.message);
-            free(action->config.notification.level);
-            free(action->config.notification.destination);
-            break;
-            
-        case MCP_ACTION_TYPE_CUSTOM:
-            free(action->config.custom.handlerName);
-            free(action->config.custom.paramsJson);
-            break;
-    }
-}
 
-static void freeRule(Rule* rule) {
-    if (rule == NULL) {
+    if (!growArray((void**)&s_readyRules, &s_readyCapacity, s_readyCount, sizeof(*s_readyRules))) {
         return;
     }
-    
-    free(rule->id);
-    free(rule->name);
-    free(rule->description);
-    
-    for (int i = 0; i < rule->triggerCount; i++) {
-        freeRuleTrigger(&rule->triggers[i]);
-    }
-    free(rule->triggers);
-    
-    for (int i = 0; i < rule->actionCount; i++) {
-        freeRuleAction(&rule->actions[i]);
+
+    rule->ready = true;
+    s_readyRules[s_readyCount++] = rule->handle;
+
+    rule->readyTimed = sampleRun(rule);
+    if (rule->readyTimed) {
+        rule->readyTicks = s_profileClock();
     }
-    free(rule->actions);
-    
-    free(rule);
 }
 
-int MCP_AutomationInit(void) {
-    if (s_initialized) {
-        return -1;  // Already initialized
-    }
-    
-    // Initialize with capacity for 10 rules
-    s_maxRules = 10;
-    s_ruleCount = 0;
-    
-    s_rules = (Rule**)calloc(s_maxRules, sizeof(Rule*));
-    if (s_rules == NULL) {
-        return -2;  // Memory allocation failed
-    }
-    
-    s_initialized = true;
-    return 0;
+// ===== Schedule deadline queue =====
+
+// Wrap-safe deadline comparison
+static bool timeBefore(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
 }
 
-static Rule* findRule(const char* ruleId) {
-    if (!s_initialized || ruleId == NULL) {
-        return NULL;
+// First occurrence of offset + k * interval strictly after the given time
+static uint32_t nextOccurrence(const RuleTrigger* trigger, uint32_t afterMs) {
+    uint32_t intervalMs = trigger->config.schedule.intervalMs;
+    uint32_t offsetMs = trigger->config.schedule.offsetMs;
+    uint32_t phase;
+
+    // Position of afterMs within the current period
+    if (afterMs >= offsetMs) {
+        phase = (afterMs - offsetMs) % intervalMs;
+    } else {
+        phase = (intervalMs - (offsetMs - afterMs) % intervalMs) % intervalMs;
     }
-    
-    for (int i = 0; i < s_ruleCount; i++) {
-        if (s_rules[i] != NULL && strcmp(s_rules[i]->id, ruleId) == 0) {
-            return s_rules[i];
+
+    return afterMs + (intervalMs - phase);
+}
+
+static void scheduleSet(int index, ScheduleEntry entry) {
+    s_schedule[index] = entry;
+    s_rules[entry.rule]->triggers[entry.trigger].timerIndex = index;
+}
+
+static void scheduleSiftUp(int index) {
+    ScheduleEntry entry = s_schedule[index];
+
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (!timeBefore(entry.deadline, s_schedule[parent].deadline)) {
+            break;
         }
+        scheduleSet(index, s_schedule[parent]);
+        index = parent;
     }
-    
-    return NULL;
+
+    scheduleSet(index, entry);
 }
 
-// Forward declaration of parser functions
-static bool parseTriggers(const char* json, Rule* rule);
-static bool parseActions(const char* json, Rule* rule);
+static void scheduleSiftDown(int index) {
+    ScheduleEntry entry = s_schedule[index];
 
-const char* MCP_AutomationCreateRule(const char* json, size_t length) {
-    if (!s_initialized || json == NULL || length == 0) {
-        return NULL;
-    }
-    
-    // Extract rule info from JSON
-    char* ruleJson = json_get_string_field(json, "rule");
-    if (ruleJson == NULL) {
-        return NULL;
-    }
-    
-    // Allocate new rule
-    Rule* rule = (Rule*)calloc(1, sizeof(Rule));
-    if (rule == NULL) {
-        free(ruleJson);
-        return NULL;
-    }
-    
-    // Parse rule ID if provided, otherwise generate new ID
-    char* id = json_get_string_field(ruleJson, "id");
-    if (id != NULL) {
-        rule->id = id;
-    } else {
-        rule->id = strdup(s_ruleIdCounter);
-        generateNextRuleId();
-    }
-    
-    // Check if rule with this ID already exists
-    if (findRule(rule->id) != NULL) {
-        freeRule(rule);
-        free(ruleJson);
-        return NULL;
-    }
-    
-    // Parse rule name
-    rule->name = json_get_string_field(ruleJson, "name");
-    if (rule->name == NULL) {
-        rule->name = strdup("Unnamed Rule");
-    }
-    
-    // Parse rule description
-    rule->description = json_get_string_field(ruleJson, "description");
-    if (rule->description == NULL) {
-        rule->description = strdup("");
-    }
-    
-    // Parse triggers
-    if (!parseTriggers(ruleJson, rule)) {
-        freeRule(rule);
-        free(ruleJson);
-        return NULL;
-    }
-    
-    // Parse actions
-    if (!parseActions(ruleJson, rule)) {
-        freeRule(rule);
-        free(ruleJson);
-        return NULL;
-    }
-    
-    // Parse enabled state
-    rule->enabled = json_get_bool_field(ruleJson, "enabled", true);
-    
-    // Parse persistence
-    rule->persistent = json_get_bool_field(ruleJson, "persistent", false);
-    
-    free(ruleJson);
-    
-    // Add rule to array
-    if (s_ruleCount >= s_maxRules) {
-        // Expand array
-        int newMaxRules = s_maxRules * 2;
-        Rule** newRules = (Rule**)realloc(s_rules, newMaxRules * sizeof(Rule*));
-        if (newRules == NULL) {
-            freeRule(rule);
-            return NULL;
+    for (;;) {
+        int child = 2 * index + 1;
+        if (child >= s_scheduleCount) {
+            break;
         }
-        
-        s_rules = newRules;
-        s_maxRules = newMaxRules;
+        if (child + 1 < s_scheduleCount && timeBefore(s_schedule[child + 1].deadline, s_schedule[child].deadline)) {
+            child++;
+        }
+        if (!timeBefore(s_schedule[child].deadline, entry.deadline)) {
+            break;
+        }
+        scheduleSet(index, s_schedule[child]);
+        index = child;
     }
-    
-    s_rules[s_ruleCount++] = rule;
-    
-    // Save to persistent storage if needed
-    if (rule->persistent) {
-        // TODO: Implement rule serialization and storage
+
+    scheduleSet(index, entry);
+}
+
+static bool schedulePush(Rule* rule, int triggerIndex, uint32_t deadline) {
+    if (!growArray((void**)&s_schedule, &s_scheduleCapacity, s_scheduleCount, sizeof(*s_schedule))) {
+        return false;
     }
-    
-    return rule->id;
+
+    ScheduleEntry entry;
+    entry.deadline = deadline;
+    entry.rule = rule->handle;
+    entry.trigger = triggerIndex;
+
+    s_schedule[s_scheduleCount++] = entry;
+    scheduleSiftUp(s_scheduleCount - 1);
+    return true;
 }
 
-int MCP_AutomationSetRuleEnabled(const char* ruleId, bool enabled) {
-    Rule* rule = findRule(ruleId);
-    if (rule == NULL) {
-        return -1;  // Rule not found
+static void scheduleRemove(int index) {
+    s_scheduleCount--;
+    if (index == s_scheduleCount) {
+        return;
     }
-    
-    rule->enabled = enabled;
-    
-    // Update in persistent storage if needed
-    if (rule->persistent) {
-        // TODO: Implement rule serialization and storage
+
+    // Move the last entry into the hole and restore heap order
+    scheduleSet(index, s_schedule[s_scheduleCount]);
+    scheduleSiftUp(index);
+    scheduleSiftDown(index);
+}
+
+static void cancelTimer(RuleTrigger* trigger) {
+    if (trigger->timerIndex >= 0) {
+        scheduleRemove(trigger->timerIndex);
+        trigger->timerIndex = -1;
     }
-    
-    return 0;
 }
 
-int MCP_AutomationDeleteRule(const char* ruleId) {
-    if (!s_initialized || ruleId == NULL) {
-        return -1;
+// ===== Condition trigger qualifiers =====
+
+static bool conditionSatisfied(const RuleTrigger* trigger) {
+    return trigger->config.condition.nodeCount > 0 &&
+           trigger->config.condition.satisfiedCount == trigger->config.condition.nodeCount;
+}
+
+// The condition became fully satisfied
+static void conditionEntered(Rule* rule, int triggerIndex) {
+    RuleTrigger* trigger = &rule->triggers[triggerIndex];
+
+    if (trigger->config.condition.active || trigger->timerIndex >= 0) {
+        return;  // Already fired (awaiting release) or being held
     }
-    
-    for (int i = 0; i < s_ruleCount; i++) {
-        if (s_rules[i] != NULL && strcmp(s_rules[i]->id, ruleId) == 0) {
-            // Delete from persistent storage if needed
-            if (s_rules[i]->persistent) {
-                // TODO: Implement rule deletion from storage
-            }
-            
-            // Free rule
-            freeRule(s_rules[i]);
-            
-            // Shift remaining rules
-            for (int j = i; j < s_ruleCount - 1; j++) {
-                s_rules[j] = s_rules[j + 1];
-            }
-            
-            s_rules[s_ruleCount - 1] = NULL;
-            s_ruleCount--;
-            
-            return 0;
-        }
+
+    if (trigger->config.condition.holdMs > 0) {
+        // Debounce: fire only if still satisfied when the hold expires
+        schedulePush(rule, triggerIndex, s_currentTimeMs + trigger->config.condition.holdMs);
+        return;
     }
-    
-    return -2;  // Rule not found
+
+    trigger->config.condition.active = true;
+    markRuleReady(rule);
 }
 
-void MCP_AutomationProcess(uint32_t currentTimeMs) {
-    (void)currentTimeMs; // Unused parameter, would be used for time-based triggers
-    
-    if (!s_initialized) {
-        return;
+// The condition stopped being fully satisfied
+static void conditionLeft(RuleTrigger* trigger) {
+    cancelTimer(trigger);
+
+    // With a release condition the trigger stays latched until it holds
+    if (trigger->config.condition.releaseNode == NULL) {
+        trigger->config.condition.active = false;
     }
-    
-    for (int i = 0; i < s_ruleCount; i++) {
-        if (s_rules[i] == NULL || !s_rules[i]->enabled) {
+}
+
+// The release condition became true: re-arm the trigger
+static void conditionReleased(Rule* rule, int triggerIndex) {
+    RuleTrigger* trigger = &rule->triggers[triggerIndex];
+
+    trigger->config.condition.active = false;
+    if (conditionSatisfied(trigger)) {
+        conditionEntered(rule, triggerIndex);
+    }
+}
+
+// Fire every timer whose deadline has passed; cost depends only on the due count
+static void runDueSchedules(uint32_t currentTimeMs) {
+    while (s_scheduleCount > 0 && !timeBefore(currentTimeMs, s_schedule[0].deadline)) {
+        Rule* rule = s_rules[s_schedule[0].rule];
+        RuleTrigger* trigger = &rule->triggers[s_schedule[0].trigger];
+
+        if (trigger->type == MCP_TRIGGER_TYPE_CONDITION) {
+            // Hold expired while still satisfied (leaving cancels the timer)
+            cancelTimer(trigger);
+            trigger->config.condition.active = true;
+            markRuleReady(rule);
             continue;
         }
-        
-        // Check triggers
-        bool triggered = MCP_AutomationCheckTriggers(s_rules[i]->id);
-        
-        if (triggered) {
-            // Execute actions
-            MCP_AutomationExecuteActions(s_rules[i]->id);
-        }
+
+        markRuleReady(rule);
+
+        // Missed occurrences are skipped rather than replayed
+        trigger->config.schedule.nextTriggerTime = nextOccurrence(trigger, currentTimeMs);
+        s_schedule[0].deadline = trigger->config.schedule.nextTriggerTime;
+        scheduleSiftDown(0);
     }
 }
 
-bool MCP_AutomationCheckTriggers(const char* ruleId) {
-    Rule* rule = findRule(ruleId);
-    if (rule == NULL) {
-        return false;
-    }
-    
+// ===== Action queue =====
+
+// Writes with the same target and command set the same actuator state, so a
+// later one replaces an earlier one; different commands are all kept
+static int internWrite(const char* target, const char* command) {
+    for (int i = 0; i < s_writeCount; i++) {
+        if (strcmp(s_writeTargets[i], target) == 0 && strcmp(s_writeCommands[i], command) == 0) {
+            return i;
+        }
+    }
+
+    if (s_writeCount >= s_writeCapacity) {
+        int newCapacity = s_writeCapacity == 0 ? 8 : s_writeCapacity * 2;
+        char** newTargets = (char**)realloc(s_writeTargets, newCapacity * sizeof(char*));
+        if (newTargets == NULL) {
+            return -1;
+        }
+        s_writeTargets = newTargets;
+
+        char** newCommands = (char**)realloc(s_writeCommands, newCapacity * sizeof(char*));
+        if (newCommands == NULL) {
+            return -1;
+        }
+        s_writeCommands = newCommands;
+
+        int* newPending = (int*)realloc(s_writePending, newCapacity * sizeof(int));
+        if (newPending == NULL) {
+            return -1;
+        }
+        s_writePending = newPending;
+        s_writeCapacity = newCapacity;
+    }
+
+    s_writeTargets[s_writeCount] = strdup(target);
+    s_writeCommands[s_writeCount] = strdup(command);
+    if (s_writeTargets[s_writeCount] == NULL || s_writeCommands[s_writeCount] == NULL) {
+        free(s_writeTargets[s_writeCount]);
+        free(s_writeCommands[s_writeCount]);
+        return -1;
+    }
+    s_writePending[s_writeCount] = -1;
+
+    return s_writeCount++;
+}
+
+static int queuedWrite(const QueuedAction* queued) {
+    const RuleAction* action = &s_rules[queued->rule]->actions[queued->action];
+    return action->type == MCP_ACTION_TYPE_ACTUATOR ? action->config.actuator.writeId : -1;
+}
+
+// Queue a rule's actions; a pending write with the same target and command
+// is replaced by the higher-priority (or, on a tie, the newer) one
+static void enqueueRuleActions(Rule* rule) {
+    for (int i = 0; i < rule->actionCount; i++) {
+        RuleAction* action = &rule->actions[i];
+        s_actionStats.actionsQueued++;
+
+        QueuedAction queued;
+        queued.rule = rule->handle;
+        queued.action = i;
+        queued.priority = rule->priority;
+        queued.sequence = s_actionSequence++;
+        queued.readyTicks = rule->readyTicks;
+        queued.timed = rule->readyTimed;
+
+        int target = action->type == MCP_ACTION_TYPE_ACTUATOR ? action->config.actuator.writeId : -1;
+        if (target >= 0 && s_writePending[target] >= 0) {
+            QueuedAction* pending = &s_actionQueue[s_writePending[target]];
+            if (queued.priority >= pending->priority) {
+                *pending = queued;
+            }
+            s_actionStats.actionsCoalesced++;
+            continue;
+        }
+
+        if (!growArray((void**)&s_actionQueue, &s_actionCapacity, s_actionCount, sizeof(*s_actionQueue))) {
+            continue;
+        }
+
+        if (target >= 0) {
+            s_writePending[target] = s_actionCount;
+        }
+        s_actionQueue[s_actionCount++] = queued;
+    }
+}
+
+// Drop queued actions of a rule that is being deleted
+static void purgeQueuedActions(int handle) {
+    for (int i = 0; i < s_actionCount; i++) {
+        if (s_actionQueue[i].rule == handle) {
+            int target = queuedWrite(&s_actionQueue[i]);
+            if (target >= 0) {
+                s_writePending[target] = -1;
+            }
+            s_actionQueue[i].rule = -1;
+        }
+    }
+}
+
+static int compareQueuedActions(const void* a, const void* b) {
+    const QueuedAction* left = (const QueuedAction*)a;
+    const QueuedAction* right = (const QueuedAction*)b;
+
+    if (left->priority != right->priority) {
+        return left->priority > right->priority ? -1 : 1;
+    }
+    return left->sequence < right->sequence ? -1 : (left->sequence > right->sequence ? 1 : 0);
+}
+
+static void executeAction(const RuleAction* action);
+
+// Count an issued action and, for a timed run, its latency since the rule became ready
+static void profileAction(Rule* rule, uint32_t readyTicks, bool timed) {
+    rule->actionsIssued++;
+
+    if (timed && s_profileClock != NULL) {
+        uint32_t latency = s_profileClock() - readyTicks;
+        rule->timedActions++;
+        rule->latencyTicks += latency;
+        if (latency > rule->maxLatencyTicks) {
+            rule->maxLatencyTicks = latency;
+        }
+    }
+}
+
+// Run queued actions by priority until the queue is empty or the budget is spent
+static void runActionQueue(void) {
+    if (s_actionCount == 0) {
+        return;
+    }
+
+    qsort(s_actionQueue, s_actionCount, sizeof(QueuedAction), compareQueuedActions);
+
+    uint32_t start = s_actionClock != NULL ? s_actionClock() : 0;
+    int executed = 0;
+
+    while (executed < s_actionCount) {
+        // At least one action runs per pass so the queue always drains
+        if (executed > 0 && s_actionBudgetUs > 0 && s_actionClock != NULL &&
+            s_actionClock() - start >= s_actionBudgetUs) {
+            break;
+        }
+
+        QueuedAction* queued = &s_actionQueue[executed++];
+        if (queued->rule < 0) {
+            continue;  // Rule deleted while queued
+        }
+
+        int target = queuedWrite(queued);
+        if (target >= 0) {
+            s_writePending[target] = -1;
+        }
+
+        executeAction(&s_rules[queued->rule]->actions[queued->action]);
+        s_actionStats.actionsIssued++;
+
+        if (s_profiling) {
+            profileAction(s_rules[queued->rule], queued->readyTicks, queued->timed);
+        }
+    }
+
+    // Keep the remainder for the next pass, still open to coalescing
+    s_actionCount -= executed;
+    if (s_actionCount > 0) {
+        memmove(s_actionQueue, s_actionQueue + executed, s_actionCount * sizeof(QueuedAction));
+        s_actionStats.actionsDeferred += s_actionCount;
+
+        for (int i = 0; i < s_actionCount; i++) {
+            if (s_actionQueue[i].rule >= 0) {
+                int target = queuedWrite(&s_actionQueue[i]);
+                if (target >= 0) {
+                    s_writePending[target] = i;
+                }
+            }
+        }
+    }
+}
+
+// ===== Dependency graph =====
+
+static void markNodeDirty(ConditionNode* node) {
+    if (node->dirty) {
+        return;
+    }
+
+    if (!growArray((void**)&s_dirtyNodes, &s_dirtyCapacity, s_dirtyCount, sizeof(*s_dirtyNodes))) {
+        return;
+    }
+
+    node->dirty = true;
+    s_dirtyNodes[s_dirtyCount++] = node;
+}
+
+// Called by the rule interpreter whenever a variable value changes
+static void onVariableChanged(int handle, void* userData) {
+    (void)userData;
+
+    if (handle < 0 || handle >= s_variableNodeCapacity) {
+        return;  // No condition reads this variable
+    }
+
+    NodeList* list = &s_variableNodes[handle];
+    for (int i = 0; i < list->count; i++) {
+        markNodeDirty(list->nodes[i]);
+    }
+}
+
+static bool addVariableDependency(int handle, ConditionNode* node) {
+    if (handle >= s_variableNodeCapacity) {
+        int newCapacity = s_variableNodeCapacity == 0 ? 16 : s_variableNodeCapacity;
+        while (newCapacity <= handle) {
+            newCapacity *= 2;
+        }
+
+        NodeList* newLists = (NodeList*)realloc(s_variableNodes, newCapacity * sizeof(NodeList));
+        if (newLists == NULL) {
+            return false;
+        }
+        memset(newLists + s_variableNodeCapacity, 0, (newCapacity - s_variableNodeCapacity) * sizeof(NodeList));
+
+        s_variableNodes = newLists;
+        s_variableNodeCapacity = newCapacity;
+    }
+
+    NodeList* list = &s_variableNodes[handle];
+    if (!growArray((void**)&list->nodes, &list->capacity, list->count, sizeof(*list->nodes))) {
+        return false;
+    }
+
+    list->nodes[list->count++] = node;
+    return true;
+}
+
+static void destroyNode(ConditionNode* node) {
+    for (int i = 0; i < node->variableCount; i++) {
+        int handle = node->variables[i];
+        if (handle < s_variableNodeCapacity) {
+            removePointer((void**)s_variableNodes[handle].nodes, &s_variableNodes[handle].count, node);
+        }
+    }
+
+    if (node->dirty) {
+        removePointer((void**)s_dirtyNodes, &s_dirtyCount, node);
+    }
+    removePointer((void**)s_nodes, &s_nodeCount, node);
+
+    ConditionNode** link = &s_nodeBuckets[node->hash & s_nodeBucketMask];
+    while (*link != NULL && *link != node) {
+        link = &(*link)->nextInBucket;
+    }
+    if (*link == node) {
+        *link = node->nextInBucket;
+    }
+
+    MCP_RuleFreeProgram(node->program);
+    free(node->expression);
+    free(node->variables);
+    free(node->dependents);
+    free(node);
+}
+
+// FNV-1a hash of an expression
+static uint32_t hashExpression(const char* expression) {
+    uint32_t hash = 2166136261u;
+    while (*expression != '\0') {
+        hash ^= (uint8_t)*expression++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static ConditionNode* findNode(const char* expression, uint32_t hash) {
+    if (s_nodeBuckets == NULL) {
+        return NULL;
+    }
+
+    ConditionNode* node = s_nodeBuckets[hash & s_nodeBucketMask];
+    while (node != NULL && (node->hash != hash || strcmp(node->expression, expression) != 0)) {
+        node = node->nextInBucket;
+    }
+    return node;
+}
+
+// Make room for one more node, keeping at most one node per bucket on average
+static bool growNodeBuckets(void) {
+    if (s_nodeBuckets != NULL && (uint32_t)s_nodeCount < s_nodeBucketMask + 1) {
+        return true;
+    }
+
+    uint32_t bucketCount = s_nodeBuckets != NULL ? (s_nodeBucketMask + 1) * 2 : 64;
+    ConditionNode** buckets = (ConditionNode**)calloc(bucketCount, sizeof(*buckets));
+    if (buckets == NULL) {
+        return false;
+    }
+
+    for (int i = 0; i < s_nodeCount; i++) {
+        ConditionNode* node = s_nodes[i];
+        uint32_t bucket = node->hash & (bucketCount - 1);
+        node->nextInBucket = buckets[bucket];
+        buckets[bucket] = node;
+    }
+
+    free(s_nodeBuckets);
+    s_nodeBuckets = buckets;
+    s_nodeBucketMask = bucketCount - 1;
+    return true;
+}
+
+// Find the node for a normalized expression or create it, compiling the
+// expression unless a precompiled program is given (ownership passes in)
+static ConditionNode* findOrCreateNode(const char* expression, MCP_RuleProgram* program) {
+    uint32_t hash = hashExpression(expression);
+    ConditionNode* node = findNode(expression, hash);
+    if (node != NULL) {
+        MCP_RuleFreeProgram(program);
+        return node;
+    }
+
+    if (growArray((void**)&s_nodes, &s_nodeCapacity, s_nodeCount, sizeof(*s_nodes)) && growNodeBuckets()) {
+        node = (ConditionNode*)calloc(1, sizeof(ConditionNode));
+    }
+    if (node == NULL) {
+        MCP_RuleFreeProgram(program);
+        return NULL;
+    }
+
+    node->expression = strdup(expression);
+    node->program = program != NULL ? program : MCP_RuleCompile(expression);
+    if (node->expression == NULL || node->program == NULL) {
+        MCP_RuleFreeProgram(node->program);
+        free(node->expression);
+        free(node);
+        return NULL;
+    }
+
+    // Register the node with every variable it reads
+    int handles[16];
+    int variableCount = MCP_RuleProgramGetVariables(node->program, handles, 16);
+    if (variableCount > 0) {
+        node->variables = (int*)malloc(variableCount * sizeof(int));
+        if (node->variables == NULL) {
+            MCP_RuleFreeProgram(node->program);
+            free(node->expression);
+            free(node);
+            return NULL;
+        }
+
+        if (variableCount <= 16) {
+            memcpy(node->variables, handles, variableCount * sizeof(int));
+        } else {
+            MCP_RuleProgramGetVariables(node->program, node->variables, variableCount);
+        }
+    }
+
+    node->hash = hash;
+    node->nextInBucket = s_nodeBuckets[hash & s_nodeBucketMask];
+    s_nodeBuckets[hash & s_nodeBucketMask] = node;
+    s_nodes[s_nodeCount++] = node;
+
+    for (int i = 0; i < variableCount; i++) {
+        if (!addVariableDependency(node->variables[i], node)) {
+            node->variableCount = i;
+            destroyNode(node);
+            return NULL;
+        }
+    }
+    node->variableCount = variableCount;
+
+    // Evaluate on the next pass
+    markNodeDirty(node);
+
+    return node;
+}
+
+static bool attachTrigger(ConditionNode* node, int rule, int trigger, bool release) {
+    if (node->dependentCount >= node->dependentCapacity) {
+        int newCapacity = node->dependentCapacity == 0 ? 4 : node->dependentCapacity * 2;
+        TriggerRef* newDependents = (TriggerRef*)realloc(node->dependents, newCapacity * sizeof(TriggerRef));
+        if (newDependents == NULL) {
+            return false;
+        }
+        node->dependents = newDependents;
+        node->dependentCapacity = newCapacity;
+    }
+
+    node->dependents[node->dependentCount].rule = rule;
+    node->dependents[node->dependentCount].trigger = trigger;
+    node->dependents[node->dependentCount].release = release;
+    node->dependentCount++;
+
+    return true;
+}
+
+static void detachTrigger(ConditionNode* node, int rule, int trigger, bool release) {
+    for (int i = 0; i < node->dependentCount; i++) {
+        if (node->dependents[i].rule == rule && node->dependents[i].trigger == trigger &&
+            node->dependents[i].release == release) {
+            node->dependents[i] = node->dependents[--node->dependentCount];
+            break;
+        }
+    }
+}
+
+// Re-evaluate only the nodes whose inputs changed and propagate flips to triggers
+static void evaluateDirtyNodes(void) {
+    while (s_dirtyCount > 0) {
+        ConditionNode* node = s_dirtyNodes[--s_dirtyCount];
+        node->dirty = false;
+
+        // Only sampled evaluations pay for the clock reads
+        bool timed = s_profileClock != NULL && (node->evaluations & (PROFILE_TIME_INTERVAL - 1)) == 0;
+        uint32_t start = timed ? s_profileClock() : 0;
+        MCP_RuleValue result = MCP_RuleExecute(node->program);
+        bool value = (result.type == MCP_RULE_VALUE_BOOL && result.value.boolValue) ||
+                     (result.type == MCP_RULE_VALUE_NUMBER && result.value.numberValue != 0);
+        MCP_RuleFreeValue(result);
+
+        if (s_profiling) {
+            node->evaluations++;
+            node->trueResults += value ? 1 : 0;
+            if (timed) {
+                uint32_t elapsed = s_profileClock() - start;
+                node->timedEvaluations++;
+                node->evalTicks += elapsed;
+                if (elapsed > node->maxEvalTicks) {
+                    node->maxEvalTicks = elapsed;
+                }
+            }
+        }
+
+        if (value == node->value) {
+            continue;
+        }
+        node->value = value;
+
+        for (int i = 0; i < node->dependentCount; i++) {
+            Rule* rule = s_rules[node->dependents[i].rule];
+            int triggerIndex = node->dependents[i].trigger;
+            RuleTrigger* trigger = &rule->triggers[triggerIndex];
+
+            if (node->dependents[i].release) {
+                if (value) {
+                    conditionReleased(rule, triggerIndex);
+                }
+            } else if (value) {
+                trigger->config.condition.satisfiedCount++;
+
+                // Fire on the transition to fully satisfied
+                if (conditionSatisfied(trigger)) {
+                    conditionEntered(rule, triggerIndex);
+                }
+            } else {
+                if (conditionSatisfied(trigger)) {
+                    conditionLeft(trigger);
+                }
+                trigger->config.condition.satisfiedCount--;
+            }
+        }
+    }
+}
+
+// Copy an expression without whitespace outside string literals
+static char* normalizeExpression(const char* start, size_t length) {
+    char* result = (char*)malloc(length + 1);
+    if (result == NULL) {
+        return NULL;
+    }
+
+    size_t out = 0;
+    char quote = '\0';
+    for (size_t i = 0; i < length; i++) {
+        char c = start[i];
+        if (quote != '\0') {
+            if (c == quote) {
+                quote = '\0';
+            }
+        } else if (c == '"' || c == '\'') {
+            quote = c;
+        } else if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            continue;
+        }
+        result[out++] = c;
+    }
+    result[out] = '\0';
+
+    return result;
+}
+
+// Split an expression into its top-level && terms; an expression with a
+// top-level || is kept whole since && binds tighter
+static int splitConjuncts(const char* expression, const char** starts, size_t* lengths, int maxTerms) {
+    int depth = 0;
+    char quote = '\0';
+    int count = 0;
+    const char* termStart = expression;
+    const char* p;
+
+    for (p = expression; *p != '\0'; p++) {
+        if (quote != '\0') {
+            if (*p == quote) {
+                quote = '\0';
+            }
+        } else if (*p == '"' || *p == '\'') {
+            quote = *p;
+        } else if (*p == '(') {
+            depth++;
+        } else if (*p == ')') {
+            depth--;
+        } else if (depth == 0 && p[0] == '|' && p[1] == '|') {
+            starts[0] = expression;
+            lengths[0] = strlen(expression);
+            return 1;
+        } else if (depth == 0 && p[0] == '&' && p[1] == '&') {
+            if (count >= maxTerms - 1) {
+                starts[0] = expression;
+                lengths[0] = strlen(expression);
+                return 1;
+            }
+            starts[count] = termStart;
+            lengths[count] = p - termStart;
+            count++;
+            termStart = p + 2;
+            p++;
+        }
+    }
+
+    starts[count] = termStart;
+    lengths[count] = p - termStart;
+    return count + 1;
+}
+
+// Add a node to a condition trigger's conjuncts (repeated terms are kept once)
+static void addConditionNode(RuleTrigger* trigger, ConditionNode* node) {
+    for (int i = 0; i < trigger->config.condition.nodeCount; i++) {
+        if (trigger->config.condition.nodes[i] == node) {
+            return;
+        }
+    }
+    trigger->config.condition.nodes[trigger->config.condition.nodeCount++] = node;
+}
+
+// Find or create the shared nodes for each conjunct and the release condition
+static bool resolveConditionNodes(RuleTrigger* trigger) {
+    // Validate the whole expression first
+    MCP_RuleProgram* program = MCP_RuleCompile(trigger->config.condition.expression);
+    if (program == NULL) {
+        return false;
+    }
+    MCP_RuleFreeProgram(program);
+
+    const char* starts[MAX_CONDITION_TERMS];
+    size_t lengths[MAX_CONDITION_TERMS];
+    int termCount = splitConjuncts(trigger->config.condition.expression, starts, lengths, MAX_CONDITION_TERMS);
+
+    trigger->config.condition.nodes = (ConditionNode**)calloc(termCount, sizeof(ConditionNode*));
+    if (trigger->config.condition.nodes == NULL) {
+        return false;
+    }
+
+    for (int i = 0; i < termCount; i++) {
+        char* term = normalizeExpression(starts[i], lengths[i]);
+        if (term == NULL) {
+            return false;
+        }
+
+        ConditionNode* node = findOrCreateNode(term, NULL);
+        free(term);
+        if (node == NULL) {
+            return false;
+        }
+        addConditionNode(trigger, node);
+    }
+
+    // Optional release condition, kept whole
+    if (trigger->config.condition.releaseExpression != NULL) {
+        char* release = normalizeExpression(trigger->config.condition.releaseExpression,
+                                            strlen(trigger->config.condition.releaseExpression));
+        if (release == NULL) {
+            return false;
+        }
+
+        ConditionNode* node = findOrCreateNode(release, NULL);
+        free(release);
+        if (node == NULL) {
+            return false;
+        }
+        for (int i = 0; i < trigger->config.condition.nodeCount; i++) {
+            if (trigger->config.condition.nodes[i] == node) {
+                return false;  // Release identical to a conjunct
+            }
+        }
+        trigger->config.condition.releaseNode = node;
+    }
+
+    return true;
+}
+
+// Attach a condition trigger to its resolved nodes and pick up their current state
+static bool attachConditionTrigger(Rule* rule, int triggerIndex) {
+    RuleTrigger* trigger = &rule->triggers[triggerIndex];
+
+    for (int i = 0; i < trigger->config.condition.nodeCount; i++) {
+        ConditionNode* node = trigger->config.condition.nodes[i];
+        if (!attachTrigger(node, rule->handle, triggerIndex, false)) {
+            return false;
+        }
+
+        // Shared nodes contribute their cached state
+        if (node->value) {
+            trigger->config.condition.satisfiedCount++;
+        }
+    }
+
+    if (trigger->config.condition.releaseNode != NULL &&
+        !attachTrigger(trigger->config.condition.releaseNode, rule->handle, triggerIndex, true)) {
+        return false;
+    }
+
+    if (conditionSatisfied(trigger)) {
+        conditionEntered(rule, triggerIndex);
+    }
+
+    return true;
+}
+
+static bool bindEventTrigger(Rule* rule, RuleTrigger* trigger) {
+    int type = (int)trigger->config.event.eventType;
+
+    if (s_eventBindingCount[type] >= s_eventBindingCapacity[type]) {
+        int newCapacity = s_eventBindingCapacity[type] == 0 ? 4 : s_eventBindingCapacity[type] * 2;
+        EventBinding* newBindings = (EventBinding*)realloc(s_eventBindings[type], newCapacity * sizeof(EventBinding));
+        if (newBindings == NULL) {
+            return false;
+        }
+        s_eventBindings[type] = newBindings;
+        s_eventBindingCapacity[type] = newCapacity;
+    }
+
+    EventBinding* binding = &s_eventBindings[type][s_eventBindingCount[type]++];
+    binding->source = trigger->config.event.eventSource;
+    binding->rule = rule->handle;
+
+    return true;
+}
+
+static void unbindEventTriggers(Rule* rule) {
+    for (int type = 0; type < EVENT_TYPE_COUNT; type++) {
+        for (int i = 0; i < s_eventBindingCount[type]; ) {
+            if (s_eventBindings[type][i].rule == rule->handle) {
+                s_eventBindings[type][i] = s_eventBindings[type][--s_eventBindingCount[type]];
+            } else {
+                i++;
+            }
+        }
+    }
+}
+
+// Connect a parsed rule to the dependency graph, event bindings and schedule list
+static bool bindRule(Rule* rule) {
+    for (int i = 0; i < rule->triggerCount; i++) {
+        RuleTrigger* trigger = &rule->triggers[i];
+
+        switch (trigger->type) {
+            case MCP_TRIGGER_TYPE_CONDITION:
+                // Snapshot-loaded triggers arrive with their nodes already resolved
+                if (trigger->config.condition.nodes == NULL && !resolveConditionNodes(trigger)) {
+                    return false;
+                }
+                if (!attachConditionTrigger(rule, i)) {
+                    return false;
+                }
+                break;
+
+            case MCP_TRIGGER_TYPE_EVENT:
+                if (!bindEventTrigger(rule, trigger)) {
+                    return false;
+                }
+                break;
+
+            case MCP_TRIGGER_TYPE_SCHEDULE:
+                // Next occurrence is computed once here and once per firing
+                trigger->config.schedule.nextTriggerTime = nextOccurrence(trigger, s_currentTimeMs);
+                if (!schedulePush(rule, i, trigger->config.schedule.nextTriggerTime)) {
+                    return false;
+                }
+                break;
+
+            case MCP_TRIGGER_TYPE_MANUAL:
+                break;
+        }
+    }
+
+    return true;
+}
+
+// Destroy a node no trigger depends on and drop the rule's other references to it
+static void releaseUnusedNode(Rule* rule, ConditionNode* node) {
+    if (node == NULL || node->dependentCount > 0) {
+        return;
+    }
+
+    for (int i = 0; i < rule->triggerCount; i++) {
+        RuleTrigger* trigger = &rule->triggers[i];
+        if (trigger->type != MCP_TRIGGER_TYPE_CONDITION) {
+            continue;
+        }
+        for (int j = 0; j < trigger->config.condition.nodeCount; j++) {
+            if (trigger->config.condition.nodes[j] == node) {
+                trigger->config.condition.nodes[j] = NULL;
+            }
+        }
+        if (trigger->config.condition.releaseNode == node) {
+            trigger->config.condition.releaseNode = NULL;
+        }
+    }
+
+    destroyNode(node);
+}
+
+// Disconnect a rule from everything that can fire it
+static void unbindRule(Rule* rule) {
+    // Detach everything first: triggers of one rule may share nodes
+    for (int i = 0; i < rule->triggerCount; i++) {
+        RuleTrigger* trigger = &rule->triggers[i];
+
+        cancelTimer(trigger);
+
+        if (trigger->type == MCP_TRIGGER_TYPE_CONDITION) {
+            for (int j = 0; j < trigger->config.condition.nodeCount; j++) {
+                detachTrigger(trigger->config.condition.nodes[j], rule->handle, i, false);
+            }
+            if (trigger->config.condition.releaseNode != NULL) {
+                detachTrigger(trigger->config.condition.releaseNode, rule->handle, i, true);
+            }
+        }
+    }
+
+    // Then free nodes left without dependents, including ones resolved but never attached
+    for (int i = 0; i < rule->triggerCount; i++) {
+        RuleTrigger* trigger = &rule->triggers[i];
+        if (trigger->type != MCP_TRIGGER_TYPE_CONDITION) {
+            continue;
+        }
+        for (int j = 0; j < trigger->config.condition.nodeCount; j++) {
+            releaseUnusedNode(rule, trigger->config.condition.nodes[j]);
+        }
+        releaseUnusedNode(rule, trigger->config.condition.releaseNode);
+        trigger->config.condition.nodeCount = 0;
+        trigger->config.condition.releaseNode = NULL;
+    }
+
+    if (rule->handle < 0) {
+        return;  // Never bound
+    }
+
+    unbindEventTriggers(rule);
+    purgeQueuedActions(rule->handle);
+
+    // Leave a tombstone so a pass in progress is not disturbed
+    if (rule->ready) {
+        for (int i = 0; i < s_readyCount; i++) {
+            if (s_readyRules[i] == rule->handle) {
+                s_readyRules[i] = -1;
+            }
+        }
+        rule->ready = false;
+    }
+}
+
+// ===== Rule lifetime =====
+
+static void freeRuleTrigger(RuleTrigger* trigger) {
+    if (trigger == NULL) {
+        return;
+    }
+
+    switch (trigger->type) {
+        case MCP_TRIGGER_TYPE_CONDITION:
+            free(trigger->config.condition.expression);
+            free(trigger->config.condition.releaseExpression);
+            free(trigger->config.condition.nodes);
+            break;
+
+        case MCP_TRIGGER_TYPE_EVENT:
+            free(trigger->config.event.eventSource);
+            break;
+
+        case MCP_TRIGGER_TYPE_SCHEDULE:
+        case MCP_TRIGGER_TYPE_MANUAL:
+            // No dynamic memory to free
+            break;
+    }
+}
+
+static void freeRuleAction(RuleAction* action) {
+    if (action == NULL) {
+        return;
+    }
+
+    switch (action->type) {
+        case MCP_ACTION_TYPE_ACTUATOR:
+            free(action->config.actuator.target);
+            free(action->config.actuator.command);
+            free(action->config.actuator.paramsJson);
+            break;
+
+        case MCP_ACTION_TYPE_TOOL:
+            free(action->config.tool.tool);
+            free(action->config.tool.paramsJson);
+            break;
+
+        case MCP_ACTION_TYPE_NOTIFICATION:
+            free(action->config.notification.message);
+            free(action->config.notification.level);
+            free(action->config.notification.destination);
+            break;
+
+        case MCP_ACTION_TYPE_CUSTOM:
+            free(action->config.custom.handlerName);
+            free(action->config.custom.paramsJson);
+            break;
+    }
+}
+
+static void freeRule(Rule* rule) {
+    if (rule == NULL) {
+        return;
+    }
+
+    unbindRule(rule);
+
+    free(rule->id);
+    free(rule->name);
+    free(rule->description);
+
+    for (int i = 0; i < rule->triggerCount; i++) {
+        freeRuleTrigger(&rule->triggers[i]);
+    }
+    free(rule->triggers);
+
+    for (int i = 0; i < rule->actionCount; i++) {
+        freeRuleAction(&rule->actions[i]);
+    }
+    free(rule->actions);
+
+    free(rule);
+}
+
+// Free a rule and release its slot
+static void releaseRule(Rule* rule) {
+    int handle = rule->handle;
+
+    freeRule(rule);
+    s_rules[handle] = NULL;
+
+    // Trim trailing free slots
+    while (s_ruleCount > 0 && s_rules[s_ruleCount - 1] == NULL) {
+        s_ruleCount--;
+    }
+}
+
+// Built-in string functions for condition expressions
+static MCP_RuleValue ruleContains(MCP_RuleValue* params, int paramCount) {
+    if (paramCount != 2 || params[0].type != MCP_RULE_VALUE_STRING || params[1].type != MCP_RULE_VALUE_STRING) {
+        return MCP_RuleCreateBoolValue(false);
+    }
+    return MCP_RuleCreateBoolValue(strstr(params[0].value.stringValue, params[1].value.stringValue) != NULL);
+}
+
+static MCP_RuleValue ruleStartsWith(MCP_RuleValue* params, int paramCount) {
+    if (paramCount != 2 || params[0].type != MCP_RULE_VALUE_STRING || params[1].type != MCP_RULE_VALUE_STRING) {
+        return MCP_RuleCreateBoolValue(false);
+    }
+    size_t prefixLength = strlen(params[1].value.stringValue);
+    return MCP_RuleCreateBoolValue(strncmp(params[0].value.stringValue, params[1].value.stringValue, prefixLength) == 0);
+}
+
+static MCP_RuleValue ruleEndsWith(MCP_RuleValue* params, int paramCount) {
+    if (paramCount != 2 || params[0].type != MCP_RULE_VALUE_STRING || params[1].type != MCP_RULE_VALUE_STRING) {
+        return MCP_RuleCreateBoolValue(false);
+    }
+    size_t length = strlen(params[0].value.stringValue);
+    size_t suffixLength = strlen(params[1].value.stringValue);
+    return MCP_RuleCreateBoolValue(suffixLength <= length &&
+        strcmp(params[0].value.stringValue + length - suffixLength, params[1].value.stringValue) == 0);
+}
+
+int MCP_AutomationInit(void) {
+    if (s_initialized) {
+        return -1;  // Already initialized
+    }
+
+    // Initialize with capacity for 10 rules
+    s_maxRules = 10;
+    s_ruleCount = 0;
+
+    s_rules = (Rule**)calloc(s_maxRules, sizeof(Rule*));
+    if (s_rules == NULL) {
+        return -2;  // Memory allocation failed
+    }
+
+    // Conditions are evaluated by the rule interpreter (it may already be running)
+    MCP_RuleInterpreterInit();
+    if (MCP_RuleSetChangeListener(onVariableChanged, NULL) != 0) {
+        free(s_rules);
+        s_rules = NULL;
+        return -3;
+    }
+    MCP_RuleRegisterFunction("contains", ruleContains);
+    MCP_RuleRegisterFunction("starts_with", ruleStartsWith);
+    MCP_RuleRegisterFunction("ends_with", ruleEndsWith);
+
+    // Subscribe to all events; fails quietly if the event system is not running,
+    // in which case events can be fed through MCP_AutomationHandleEvent
+    s_eventHandlerId = MCP_EventRegisterHandler(-1, NULL, MCP_AutomationHandleEvent, NULL);
+
+    // Likewise the profile tool is only reachable when the tool registry is running
+    MCP_AutomationProfileToolRegister();
+
+    s_initialized = true;
+    return 0;
+}
+
+static Rule* findRule(const char* ruleId) {
+    if (!s_initialized || ruleId == NULL) {
+        return NULL;
+    }
+
+    for (int i = 0; i < s_ruleCount; i++) {
+        if (s_rules[i] != NULL && strcmp(s_rules[i]->id, ruleId) == 0) {
+            return s_rules[i];
+        }
+    }
+
+    return NULL;
+}
+
+// Forward declaration of parser functions
+static bool parseTriggers(const char* json, Rule* rule);
+static bool parseActions(const char* json, Rule* rule);
+
+// Give a parsed rule a slot and connect it; frees the rule on failure
+static bool addRule(Rule* rule) {
+    // Reuse a freed slot or add one at the end
+    int handle = 0;
+    while (handle < s_ruleCount && s_rules[handle] != NULL) {
+        handle++;
+    }
+
+    if (handle >= s_maxRules) {
+        // Expand array
+        int newMaxRules = s_maxRules * 2;
+        Rule** newRules = (Rule**)realloc(s_rules, newMaxRules * sizeof(Rule*));
+        if (newRules == NULL) {
+            freeRule(rule);
+            return false;
+        }
+
+        s_rules = newRules;
+        s_maxRules = newMaxRules;
+    }
+
+    rule->handle = handle;
+    s_rules[handle] = rule;
+    if (handle == s_ruleCount) {
+        s_ruleCount++;
+    }
+
+    // Connect triggers to the dependency graph, event bindings and deadline queue
+    if (!bindRule(rule)) {
+        releaseRule(rule);
+        return false;
+    }
+
+    return true;
+}
+
+const char* MCP_AutomationCreateRule(const char* json, size_t length) {
+    if (!s_initialized || json == NULL || length == 0) {
+        return NULL;
+    }
+
+    // Extract rule object from JSON (or use the document itself)
+    char* ruleJson = (char*)json_get_object_field(json, "rule");
+    if (ruleJson == NULL) {
+        ruleJson = strdup(json);
+        if (ruleJson == NULL) {
+            return NULL;
+        }
+    }
+
+    // Allocate new rule
+    Rule* rule = (Rule*)calloc(1, sizeof(Rule));
+    if (rule == NULL) {
+        free(ruleJson);
+        return NULL;
+    }
+    rule->handle = -1;
+
+    // Parse rule ID if provided, otherwise generate new ID
+    char* id = json_get_string_field(ruleJson, "id");
+    if (id != NULL) {
+        rule->id = id;
+    } else {
+        rule->id = strdup(s_ruleIdCounter);
+        generateNextRuleId();
+    }
+
+    // Check if rule with this ID already exists
+    if (findRule(rule->id) != NULL) {
+        freeRule(rule);
+        free(ruleJson);
+        return NULL;
+    }
+
+    // Parse rule name
+    rule->name = json_get_string_field(ruleJson, "name");
+    if (rule->name == NULL) {
+        rule->name = strdup("Unnamed Rule");
+    }
+
+    // Parse rule description
+    rule->description = json_get_string_field(ruleJson, "description");
+    if (rule->description == NULL) {
+        rule->description = strdup("");
+    }
+
+    // Parse triggers
+    if (!parseTriggers(ruleJson, rule)) {
+        freeRule(rule);
+        free(ruleJson);
+        return NULL;
+    }
+
+    // Parse actions
+    if (!parseActions(ruleJson, rule)) {
+        freeRule(rule);
+        free(ruleJson);
+        return NULL;
+    }
+
+    // Parse enabled state
+    rule->enabled = json_get_bool_field(ruleJson, "enabled", true);
+
+    // Parse persistence
+    rule->persistent = json_get_bool_field(ruleJson, "persistent", false);
+
+    // Parse priority
+    rule->priority = (int)json_get_double_field(ruleJson, "priority", 0);
+
+    // Parse rate limits: minimum re-fire interval and token bucket (runs per second, burst)
+    rule->minIntervalMs = (uint32_t)json_get_double_field(ruleJson, "minInterval", 0);
+    char* rateLimit = (char*)json_get_object_field(ruleJson, "rateLimit");
+    if (rateLimit != NULL) {
+        rule->tokenRate = (float)(json_get_double_field(rateLimit, "rate", 0) / 1000.0);
+        rule->tokenBurst = (float)json_get_double_field(rateLimit, "burst", 1);
+        rule->tokens = rule->tokenBurst;
+        rule->tokenTime = s_currentTimeMs;
+        free(rateLimit);
+    }
+
+    free(ruleJson);
+
+    if (!addRule(rule)) {
+        return NULL;
+    }
+
+    // Save to persistent storage if needed
+    if (rule->persistent) {
+        // TODO: Implement rule serialization and storage
+    }
+
+    return rule->id;
+}
+
+int MCP_AutomationSetRuleEnabled(const char* ruleId, bool enabled) {
+    Rule* rule = findRule(ruleId);
+    if (rule == NULL) {
+        return -1;  // Rule not found
+    }
+
+    rule->enabled = enabled;
+
+    // Update in persistent storage if needed
+    if (rule->persistent) {
+        // TODO: Implement rule serialization and storage
+    }
+
+    return 0;
+}
+
+int MCP_AutomationDeleteRule(const char* ruleId) {
+    if (!s_initialized || ruleId == NULL) {
+        return -1;
+    }
+
+    Rule* rule = findRule(ruleId);
+    if (rule == NULL) {
+        return -2;  // Rule not found
+    }
+
+    // Delete from persistent storage if needed
+    if (rule->persistent) {
+        // TODO: Implement rule deletion from storage
+    }
+
+    releaseRule(rule);
+    return 0;
+}
+
+static int executeRuleActions(Rule* rule);
+
+// Apply the rule's minimum re-fire interval and token bucket
+static bool admitRun(Rule* rule, uint32_t currentTimeMs) {
+    if (rule->minIntervalMs > 0 && rule->hasRun && currentTimeMs - rule->lastRunTime < rule->minIntervalMs) {
+        rule->suppressedCount++;
+        return false;
+    }
+
+    if (rule->tokenBurst > 0) {
+        rule->tokens += (currentTimeMs - rule->tokenTime) * rule->tokenRate;
+        if (rule->tokens > rule->tokenBurst) {
+            rule->tokens = rule->tokenBurst;
+        }
+        rule->tokenTime = currentTimeMs;
+
+        if (rule->tokens < 1.0f) {
+            rule->suppressedCount++;
+            return false;
+        }
+        rule->tokens -= 1.0f;
+    }
+
+    rule->hasRun = true;
+    rule->lastRunTime = currentTimeMs;
+    return true;
+}
+
+void MCP_AutomationProcess(uint32_t currentTimeMs) {
+    if (!s_initialized) {
+        return;
+    }
+
+    s_currentTimeMs = currentTimeMs;
+
+    // Only conditions whose inputs changed and schedules that are due are examined
+    evaluateDirtyNodes();
+    runDueSchedules(currentTimeMs);
+
+    // Queue the actions of rules that fired before this pass; actions may fire more for the next one
+    int readyCount = s_readyCount;
+    for (int i = 0; i < readyCount; i++) {
+        if (s_readyRules[i] < 0) {
+            continue;  // Deleted while queued
+        }
+
+        Rule* rule = s_rules[s_readyRules[i]];
+        s_readyRules[i] = -1;
+        rule->ready = false;
+
+        if (rule->enabled && admitRun(rule, currentTimeMs)) {
+            rule->firings += s_profiling ? 1 : 0;
+            enqueueRuleActions(rule);
+        }
+    }
+
+    s_readyCount -= readyCount;
+    if (s_readyCount > 0) {
+        memmove(s_readyRules, s_readyRules + readyCount, s_readyCount * sizeof(*s_readyRules));
+    }
+
+    runActionQueue();
+}
+
+int MCP_AutomationSetActionBudget(uint32_t budgetUs, uint32_t (*clockUs)(void)) {
+    if (budgetUs > 0 && clockUs == NULL) {
+        return -1;  // A budget needs a clock
+    }
+
+    s_actionBudgetUs = budgetUs;
+    s_actionClock = clockUs;
+    return 0;
+}
+
+int MCP_AutomationGetActionStats(MCP_AutomationActionStats* stats) {
+    if (stats == NULL) {
+        return -1;
+    }
+
+    *stats = s_actionStats;
+    return 0;
+}
+
+void MCP_AutomationHandleEvent(const MCP_Event* event, void* userData) {
+    (void)userData;
+
+    if (!s_initialized || event == NULL || (int)event->type < 0 || (int)event->type >= EVENT_TYPE_COUNT) {
+        return;
+    }
+
+    // Only bindings for this event type are considered
+    int type = (int)event->type;
+    for (int i = 0; i < s_eventBindingCount[type]; i++) {
+        EventBinding* binding = &s_eventBindings[type][i];
+
+        if (binding->source == NULL ||
+            (event->source != NULL && strcmp(binding->source, event->source) == 0)) {
+            markRuleReady(s_rules[binding->rule]);
+        }
+    }
+}
+
+bool MCP_AutomationCheckTriggers(const char* ruleId) {
+    Rule* rule = findRule(ruleId);
+    if (rule == NULL) {
+        return false;
+    }
+
     // No triggers means never triggered
     if (rule->triggerCount == 0) {
         return false;
     }
-    
-    // Check each trigger
+
+    // Bring condition state up to date
+    evaluateDirtyNodes();
+
+    // Pending events count as triggered
+    if (rule->ready) {
+        return true;
+    }
+
+    // Check each trigger
+    for (int i = 0; i < rule->triggerCount; i++) {
+        RuleTrigger* trigger = &rule->triggers[i];
+        bool triggered = false;
+
+        switch (trigger->type) {
+            case MCP_TRIGGER_TYPE_CONDITION:
+                triggered = conditionSatisfied(trigger);
+                break;
+
+            case MCP_TRIGGER_TYPE_EVENT:
+                // Handled through the ready queue
+                triggered = false;
+                break;
+
+            case MCP_TRIGGER_TYPE_SCHEDULE:
+                triggered = !timeBefore(s_currentTimeMs, trigger->config.schedule.nextTriggerTime);
+                break;
+
+            case MCP_TRIGGER_TYPE_MANUAL:
+                // Manual triggers are not checked automatically
+                triggered = false;
+                break;
+        }
+
+        if (triggered) {
+            return true;  // One trigger is enough
+        }
+    }
+
+    return false;
+}
+
+static void executeAction(const RuleAction* action) {
+    switch (action->type) {
+        case MCP_ACTION_TYPE_ACTUATOR:
+            if (action->config.actuator.target != NULL && action->config.actuator.command != NULL) {
+                MCP_ActuatorSendCommand(action->config.actuator.target,
+                                        action->config.actuator.command,
+                                        action->config.actuator.paramsJson);
+            }
+            break;
+
+        case MCP_ACTION_TYPE_TOOL:
+            if (action->config.tool.tool != NULL) {
+                // Create tool JSON
+                char toolJson[512];
+                snprintf(toolJson, sizeof(toolJson),
+                         "{\"tool\":\"%s\",\"params\":%s}",
+                         action->config.tool.tool,
+                         action->config.tool.paramsJson ? action->config.tool.paramsJson : "{}");
+
+                // Execute tool
+                MCP_ToolExecute(toolJson, strlen(toolJson));
+            }
+            break;
+
+        case MCP_ACTION_TYPE_NOTIFICATION:
+            // This is a simplified implementation
+            // In a real implementation, you'd send notifications
+            break;
+
+        case MCP_ACTION_TYPE_CUSTOM:
+            // This is a simplified implementation
+            // In a real implementation, you'd call custom handlers
+            break;
+    }
+}
+
+static int executeRuleActions(Rule* rule) {
+    bool timed = sampleRun(rule);
+    uint32_t start = timed ? s_profileClock() : 0;
+
+    // Execute each action
+    for (int i = 0; i < rule->actionCount; i++) {
+        executeAction(&rule->actions[i]);
+
+        if (s_profiling) {
+            profileAction(rule, start, timed);
+        }
+    }
+
+    return 0;
+}
+
+int MCP_AutomationExecuteActions(const char* ruleId) {
+    Rule* rule = findRule(ruleId);
+    if (rule == NULL) {
+        return -1;
+    }
+
+    return executeRuleActions(rule);
+}
+
+int MCP_AutomationTriggerRule(const char* ruleId) {
+    Rule* rule = findRule(ruleId);
+    if (rule == NULL) {
+        return -1;
+    }
+
+    if (!rule->enabled) {
+        return -2;  // Rule disabled
+    }
+
+    rule->firings += s_profiling ? 1 : 0;
+    return executeRuleActions(rule);
+}
+
+// JSON output with overflow tracking
+typedef struct {
+    char* buffer;
+    size_t size;
+    size_t length;
+} JsonWriter;
+
+static void jsonAppend(JsonWriter* w, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    size_t available = w->length < w->size ? w->size - w->length : 0;
+    int written = vsnprintf(available > 0 ? w->buffer + w->length : NULL, available, format, args);
+    va_end(args);
+
+    if (written > 0) {
+        w->length += (size_t)written;
+    }
+}
+
+// Append ,"field":"value" when the value is set
+static void jsonAppendString(JsonWriter* w, const char* field, const char* value) {
+    if (value != NULL) {
+        jsonAppend(w, ",\"%s\":\"%s\"", field, value);
+    }
+}
+
+static void jsonAppendObject(JsonWriter* w, const char* field, const char* value) {
+    if (value != NULL) {
+        jsonAppend(w, ",\"%s\":%s", field, value);
+    }
+}
+
+static const char* const s_eventTypeNames[EVENT_TYPE_COUNT] = {
+    "system", "sensor", "actuator", "input", "network", "user", "tool"
+};
+
+// Write a rule in the form MCP_AutomationCreateRule accepts; scalar rule fields
+// come first so field lookups never land inside a trigger or action
+static void exportRule(JsonWriter* w, const Rule* rule) {
+    jsonAppend(w, "{\"id\":\"%s\",\"name\":\"%s\",\"description\":\"%s\",\"enabled\":%s,\"persistent\":%s,\"priority\":%d",
+               rule->id, rule->name, rule->description,
+               rule->enabled ? "true" : "false",
+               rule->persistent ? "true" : "false",
+               rule->priority);
+
+    if (rule->minIntervalMs > 0) {
+        jsonAppend(w, ",\"minInterval\":%u", (unsigned)rule->minIntervalMs);
+    }
+    if (rule->tokenBurst > 0) {
+        jsonAppend(w, ",\"rateLimit\":{\"rate\":%g,\"burst\":%g}", rule->tokenRate * 1000.0, rule->tokenBurst);
+    }
+
+    jsonAppend(w, ",\"triggers\":[");
+    for (int i = 0; i < rule->triggerCount; i++) {
+        const RuleTrigger* trigger = &rule->triggers[i];
+        jsonAppend(w, i > 0 ? "," : "");
+
+        switch (trigger->type) {
+            case MCP_TRIGGER_TYPE_CONDITION:
+                jsonAppend(w, "{\"type\":\"condition\"");
+                jsonAppendString(w, "expression", trigger->config.condition.expression);
+                if (trigger->config.condition.holdMs > 0) {
+                    jsonAppend(w, ",\"hold\":%u", (unsigned)trigger->config.condition.holdMs);
+                }
+                jsonAppendString(w, "release", trigger->config.condition.releaseExpression);
+                break;
+
+            case MCP_TRIGGER_TYPE_EVENT:
+                jsonAppend(w, "{\"type\":\"event\",\"event\":\"%s\"", s_eventTypeNames[trigger->config.event.eventType]);
+                jsonAppendString(w, "source", trigger->config.event.eventSource);
+                break;
+
+            case MCP_TRIGGER_TYPE_SCHEDULE:
+                jsonAppend(w, "{\"type\":\"schedule\",\"interval\":%u,\"at\":%u",
+                           (unsigned)trigger->config.schedule.intervalMs,
+                           (unsigned)trigger->config.schedule.offsetMs);
+                break;
+
+            case MCP_TRIGGER_TYPE_MANUAL:
+                jsonAppend(w, "{\"type\":\"manual\"");
+                break;
+        }
+        jsonAppend(w, "}");
+    }
+
+    jsonAppend(w, "],\"actions\":[");
+    for (int i = 0; i < rule->actionCount; i++) {
+        const RuleAction* action = &rule->actions[i];
+        jsonAppend(w, i > 0 ? "," : "");
+
+        switch (action->type) {
+            case MCP_ACTION_TYPE_ACTUATOR:
+                jsonAppend(w, "{\"type\":\"actuator\"");
+                jsonAppendString(w, "target", action->config.actuator.target);
+                jsonAppendString(w, "command", action->config.actuator.command);
+                jsonAppendObject(w, "params", action->config.actuator.paramsJson);
+                break;
+
+            case MCP_ACTION_TYPE_TOOL:
+                jsonAppend(w, "{\"type\":\"tool\"");
+                jsonAppendString(w, "tool", action->config.tool.tool);
+                jsonAppendObject(w, "params", action->config.tool.paramsJson);
+                break;
+
+            case MCP_ACTION_TYPE_NOTIFICATION:
+                jsonAppend(w, "{\"type\":\"notification\"");
+                jsonAppendString(w, "message", action->config.notification.message);
+                jsonAppendString(w, "level", action->config.notification.level);
+                jsonAppendString(w, "destination", action->config.notification.destination);
+                break;
+
+            case MCP_ACTION_TYPE_CUSTOM:
+                jsonAppend(w, "{\"type\":\"custom\"");
+                jsonAppendString(w, "handler", action->config.custom.handlerName);
+                jsonAppendObject(w, "params", action->config.custom.paramsJson);
+                break;
+        }
+        jsonAppend(w, "}");
+    }
+    jsonAppend(w, "]}");
+}
+
+int MCP_AutomationExportRules(char* buffer, size_t bufferSize) {
+    if (!s_initialized || buffer == NULL || bufferSize == 0) {
+        return -1;
+    }
+
+    JsonWriter w = { buffer, bufferSize, 0 };
+
+    // Start JSON array
+    jsonAppend(&w, "[");
+
+    // Add rules
+    bool first = true;
+    for (int i = 0; i < s_ruleCount; i++) {
+        Rule* rule = s_rules[i];
+        if (rule == NULL) {
+            continue;
+        }
+
+        // Add comma if not first rule
+        if (!first) {
+            jsonAppend(&w, ",");
+        }
+        first = false;
+
+        exportRule(&w, rule);
+    }
+
+    // End JSON array
+    jsonAppend(&w, "]");
+
+    if (w.length >= bufferSize) {
+        return -2;  // Buffer too small
+    }
+
+    return (int)w.length;
+}
+
+int MCP_AutomationImportRules(const char* json, size_t length) {
+    if (!s_initialized || json == NULL || length == 0) {
+        return -1;
+    }
+
+    // Accept the exported array as is, or an object with a "rules" array
+    void* rulesJson = json_get_array_field(json, "rules");
+    if (rulesJson == NULL) {
+        char* wrapped = (char*)malloc(length + 12);
+        if (wrapped == NULL) {
+            return -2;
+        }
+        snprintf(wrapped, length + 12, "{\"rules\":%.*s}", (int)length, json);
+        rulesJson = json_get_array_field(wrapped, "rules");
+        free(wrapped);
+    }
+    if (rulesJson == NULL) {
+        return -3;  // No rule array
+    }
+
+    int imported = 0;
+    size_t count = json_array_length(rulesJson);
+    for (size_t i = 0; i < count; i++) {
+        char* item = json_array_get_item(rulesJson, i);
+        if (item == NULL) {
+            continue;
+        }
+
+        if (MCP_AutomationCreateRule(item, strlen(item)) != NULL) {
+            imported++;
+        }
+        free(item);
+    }
+
+    json_array_free(rulesJson);
+    return imported;
+}
+
+// ===== Profiling =====
+
+int MCP_AutomationSetProfiling(bool enabled, uint32_t (*clockTicks)(void), uint32_t ticksPerUs) {
+    if (enabled && clockTicks != NULL && ticksPerUs == 0) {
+        return -1;
+    }
+
+    s_profiling = enabled;
+    s_profileClock = enabled ? clockTicks : NULL;
+    s_profileTicksPerUs = clockTicks != NULL ? ticksPerUs : 1;
+    return 0;
+}
+
+void MCP_AutomationResetProfile(void) {
+    for (int i = 0; i < s_nodeCount; i++) {
+        ConditionNode* node = s_nodes[i];
+        node->evaluations = 0;
+        node->trueResults = 0;
+        node->timedEvaluations = 0;
+        node->evalTicks = 0;
+        node->maxEvalTicks = 0;
+    }
+
+    for (int i = 0; i < s_ruleCount; i++) {
+        Rule* rule = s_rules[i];
+        if (rule != NULL) {
+            rule->suppressedCount = 0;
+            rule->firings = 0;
+            rule->actionsIssued = 0;
+            rule->timedActions = 0;
+            rule->readySamples = 0;
+            rule->latencyTicks = 0;
+            rule->maxLatencyTicks = 0;
+        }
+    }
+}
+
+static uint64_t ticksToNs(uint64_t ticks) {
+    return ticks * 1000 / s_profileTicksPerUs;
+}
+
+// Condition counters come from the rule's nodes; a node shared by several
+// rules is charged in full to each of them
+static void fillRuleProfile(const Rule* rule, MCP_AutomationRuleProfile* profile) {
+    uint64_t evalTicks = 0;
+    uint32_t maxEvalTicks = 0;
+
+    memset(profile, 0, sizeof(*profile));
+    profile->ruleId = rule->id;
+
+    for (int i = 0; i < rule->triggerCount; i++) {
+        const RuleTrigger* trigger = &rule->triggers[i];
+        if (trigger->type != MCP_TRIGGER_TYPE_CONDITION) {
+            continue;
+        }
+
+        for (int j = 0; j <= trigger->config.condition.nodeCount; j++) {
+            const ConditionNode* node = j < trigger->config.condition.nodeCount ?
+                trigger->config.condition.nodes[j] : trigger->config.condition.releaseNode;
+            if (node == NULL) {
+                continue;
+            }
+
+            profile->evaluations += node->evaluations;
+            profile->trueResults += node->trueResults;
+            if (node->timedEvaluations > 0) {
+                evalTicks += node->evalTicks * node->evaluations / node->timedEvaluations;
+            }
+            if (node->maxEvalTicks > maxEvalTicks) {
+                maxEvalTicks = node->maxEvalTicks;
+            }
+        }
+    }
+
+    profile->firings = rule->firings;
+    profile->suppressed = rule->suppressedCount;
+    profile->actionsIssued = rule->actionsIssued;
+    profile->evalTimeNs = ticksToNs(evalTicks);
+    profile->maxEvalNs = (uint32_t)ticksToNs(maxEvalTicks);
+    if (rule->timedActions > 0) {
+        profile->actionLatencyNs = ticksToNs(rule->latencyTicks * rule->actionsIssued / rule->timedActions);
+    }
+    profile->maxActionLatencyNs = (uint32_t)ticksToNs(rule->maxLatencyTicks);
+}
+
+int MCP_AutomationGetRuleProfile(const char* ruleId, MCP_AutomationRuleProfile* profile) {
+    Rule* rule = findRule(ruleId);
+    if (rule == NULL || profile == NULL) {
+        return -1;
+    }
+
+    fillRuleProfile(rule, profile);
+    return 0;
+}
+
+static uint64_t profileSortValue(const MCP_AutomationRuleProfile* profile, MCP_AutomationProfileSort sortBy) {
+    switch (sortBy) {
+        case MCP_AUTOMATION_SORT_MAX_EVAL_TIME:
+            return profile->maxEvalNs;
+        case MCP_AUTOMATION_SORT_EVALUATIONS:
+            return profile->evaluations;
+        case MCP_AUTOMATION_SORT_FIRINGS:
+            return profile->firings;
+        case MCP_AUTOMATION_SORT_ACTION_LATENCY:
+            return profile->actionLatencyNs;
+        case MCP_AUTOMATION_SORT_MAX_ACTION_LATENCY:
+            return profile->maxActionLatencyNs;
+        case MCP_AUTOMATION_SORT_EVAL_TIME:
+        default:
+            return profile->evalTimeNs;
+    }
+}
+
+int MCP_AutomationGetTopRules(MCP_AutomationRuleProfile* profiles, int maxCount, MCP_AutomationProfileSort sortBy) {
+    if (!s_initialized || profiles == NULL || maxCount <= 0) {
+        return -1;
+    }
+
+    // Keep the best maxCount entries sorted, inserting each rule in place
+    int count = 0;
+    for (int i = 0; i < s_ruleCount; i++) {
+        if (s_rules[i] == NULL) {
+            continue;
+        }
+
+        MCP_AutomationRuleProfile profile;
+        fillRuleProfile(s_rules[i], &profile);
+        uint64_t value = profileSortValue(&profile, sortBy);
+
+        int position = count;
+        while (position > 0 && profileSortValue(&profiles[position - 1], sortBy) < value) {
+            position--;
+        }
+        if (position >= maxCount) {
+            continue;
+        }
+
+        int last = count < maxCount ? count : maxCount - 1;
+        memmove(&profiles[position + 1], &profiles[position], (last - position) * sizeof(*profiles));
+        profiles[position] = profile;
+        if (count < maxCount) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static const char* s_profileToolSchema =
+    "{"
+    "\"type\":\"object\","
+    "\"properties\":{"
+        "\"top\":{\"type\":\"integer\",\"minimum\":1,\"description\":\"Number of rules to return (default 5)\"},"
+        "\"sortBy\":{\"type\":\"string\",\"enum\":[\"evalTime\",\"maxEvalTime\",\"evaluations\",\"firings\",\"actionLatency\",\"maxActionLatency\"]},"
+        "\"reset\":{\"type\":\"boolean\",\"description\":\"Clear the counters after reading\"}"
+    "}"
+    "}";
+
+MCP_ToolResult MCP_AutomationProfileToolHandler(const char* json, size_t length) {
+    static const char* const sortNames[] = {
+        "evalTime", "maxEvalTime", "evaluations", "firings", "actionLatency", "maxActionLatency"
+    };
+    MCP_AutomationProfileSort sortBy = MCP_AUTOMATION_SORT_EVAL_TIME;
+    int top = 5;
+    bool reset = false;
+
+    MCP_ToolResult result;
+    memset(&result, 0, sizeof(result));
+
+    if (json != NULL && length > 0) {
+        top = (int)json_get_double_field(json, "top", top);
+        reset = json_get_bool_field(json, "reset", false);
+
+        char* sortName = json_get_string_field(json, "sortBy");
+        if (sortName != NULL) {
+            for (int i = 0; i < (int)(sizeof(sortNames) / sizeof(sortNames[0])); i++) {
+                if (strcmp(sortName, sortNames[i]) == 0) {
+                    sortBy = (MCP_AutomationProfileSort)i;
+                }
+            }
+            free(sortName);
+        }
+    }
+    if (top < 1) {
+        top = 1;
+    }
+
+    MCP_AutomationRuleProfile* profiles = (MCP_AutomationRuleProfile*)malloc(top * sizeof(MCP_AutomationRuleProfile));
+    size_t bufferSize = 64 + (size_t)top * 320;
+    char* buffer = (char*)malloc(bufferSize);
+    if (profiles == NULL || buffer == NULL) {
+        free(profiles);
+        free(buffer);
+        result.status = MCP_TOOL_RESULT_ERROR;
+        result.resultJson = strdup("{\"error\":\"Out of memory\"}");
+        return result;
+    }
+
+    int count = MCP_AutomationGetTopRules(profiles, top, sortBy);
+    JsonWriter w = { buffer, bufferSize, 0 };
+
+    jsonAppend(&w, "{\"profiling\":%s,\"timed\":%s,\"sortBy\":\"%s\",\"rules\":[",
+               s_profiling ? "true" : "false", s_profileClock != NULL ? "true" : "false", sortNames[sortBy]);
+    for (int i = 0; i < count; i++) {
+        const MCP_AutomationRuleProfile* p = &profiles[i];
+        jsonAppend(&w, "%s{\"id\":\"%s\",\"evaluations\":%u,\"trueResults\":%u,\"firings\":%u,\"suppressed\":%u,"
+                   "\"evalTimeNs\":%llu,\"maxEvalNs\":%u,\"actions\":%u,\"actionLatencyNs\":%llu,\"maxActionLatencyNs\":%u}",
+                   i > 0 ? "," : "", p->ruleId, (unsigned)p->evaluations, (unsigned)p->trueResults,
+                   (unsigned)p->firings, (unsigned)p->suppressed, (unsigned long long)p->evalTimeNs,
+                   (unsigned)p->maxEvalNs, (unsigned)p->actionsIssued, (unsigned long long)p->actionLatencyNs,
+                   (unsigned)p->maxActionLatencyNs);
+    }
+    jsonAppend(&w, "]}");
+    free(profiles);
+
+    if (reset) {
+        MCP_AutomationResetProfile();
+    }
+
+    if (w.length >= bufferSize) {
+        free(buffer);
+        result.status = MCP_TOOL_RESULT_ERROR;
+        result.resultJson = strdup("{\"error\":\"Profile too large\"}");
+        return result;
+    }
+
+    result.status = MCP_TOOL_RESULT_SUCCESS;
+    result.resultJson = buffer;
+    return result;
+}
+
+// Tool registry entry point: runs the handler on the JSON parameters and sends its result
+static int profileToolInvoke(const char* sessionId, const char* operationId, const MCP_Content* params) {
+    if (sessionId == NULL || operationId == NULL) {
+        return -1;
+    }
+
+    // Content data is not terminated, and the JSON helpers read strings
+    const char* data = MCP_ContentGetString(params);
+    size_t length = data != NULL ? params->size : 0;
+    char* json = (char*)malloc(length + 1);
+    if (json == NULL) {
+        return -2;
+    }
+    if (length > 0) {
+        memcpy(json, data, length);
+    }
+    json[length] = '\0';
+
+    MCP_ToolResult result = MCP_AutomationProfileToolHandler(json, length);
+    free(json);
+    bool success = result.status == MCP_TOOL_RESULT_SUCCESS;
+
+    MCP_Content* content = NULL;
+    if (result.resultJson != NULL) {
+        content = MCP_ContentCreateFromJson(result.resultJson, strlen(result.resultJson));
+        free((void*)result.resultJson);
+    }
+    if (content == NULL) {
+        return -2;
+    }
+
+    MCP_SendToolResult(MCP_GetServer()->transport, sessionId, operationId, success, content);
+    MCP_ContentFree(content);
+    return success ? 0 : -3;
+}
+
+int MCP_AutomationProfileToolRegister(void) {
+    MCP_ToolInfo toolInfo;
+    memset(&toolInfo, 0, sizeof(toolInfo));
+    toolInfo.name = MCP_AUTOMATION_PROFILE_TOOL_NAME;
+    toolInfo.description = "Report the automation rules that cost the most to evaluate";
+    toolInfo.schemaJson = s_profileToolSchema;
+    toolInfo.invoke = profileToolInvoke;
+
+    return MCP_ToolRegister(&toolInfo);
+}
+
+// ===== Binary snapshot =====
+//
+// Header: "MCPR", u16 version, u16 rule count, u32 payload length, u32 CRC-32 of payload.
+// Each rule record holds its strings, flags and rate limits, then its trigger table
+// and action descriptors. Condition triggers carry their normalized conjuncts with
+// compiled programs, so loading binds rules without tokenizing or compiling.
+// Strings are u16 length + bytes; 0xFFFF marks an absent string. All values are
+// little-endian and read in place from the snapshot buffer.
+
+#define SNAPSHOT_MAGIC "MCPR"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_HEADER_SIZE 16
+#define SNAPSHOT_NO_STRING 0xFFFF
+
+typedef struct {
+    uint8_t* buffer;        // NULL to measure only
+    size_t size;
+    size_t position;
+} SnapshotWriter;
+
+static void snapshotWrite(SnapshotWriter* w, const void* data, size_t length) {
+    if (w->buffer != NULL && w->position + length <= w->size) {
+        memcpy(w->buffer + w->position, data, length);
+    }
+    w->position += length;
+}
+
+static void snapshotWriteU8(SnapshotWriter* w, uint8_t value) {
+    snapshotWrite(w, &value, 1);
+}
+
+static void snapshotWriteU16(SnapshotWriter* w, uint16_t value) {
+    uint8_t bytes[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
+    snapshotWrite(w, bytes, 2);
+}
+
+static void snapshotWriteU32(SnapshotWriter* w, uint32_t value) {
+    uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+    snapshotWrite(w, bytes, 4);
+}
+
+static void snapshotWriteFloat(SnapshotWriter* w, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    snapshotWriteU32(w, bits);
+}
+
+static void snapshotWriteString(SnapshotWriter* w, const char* value) {
+    if (value == NULL) {
+        snapshotWriteU16(w, SNAPSHOT_NO_STRING);
+        return;
+    }
+
+    size_t length = strlen(value);
+    snapshotWriteU16(w, (uint16_t)length);
+    snapshotWrite(w, value, length);
+}
+
+static bool snapshotWriteNode(SnapshotWriter* w, const ConditionNode* node) {
+    int length = MCP_RuleProgramSerialize(node->program, NULL, 0);
+    if (length < 0 || length >= SNAPSHOT_NO_STRING) {
+        return false;
+    }
+
+    snapshotWriteString(w, node->expression);
+    snapshotWriteU16(w, (uint16_t)length);
+    if (w->buffer != NULL && w->position + length <= w->size) {
+        MCP_RuleProgramSerialize(node->program, w->buffer + w->position, length);
+    }
+    w->position += length;
+
+    return true;
+}
+
+static bool snapshotWriteRule(SnapshotWriter* w, const Rule* rule) {
+    snapshotWriteString(w, rule->id);
+    snapshotWriteString(w, rule->name);
+    snapshotWriteString(w, rule->description);
+    snapshotWriteU8(w, (uint8_t)((rule->enabled ? 1 : 0) | (rule->persistent ? 2 : 0)));
+    snapshotWriteU32(w, (uint32_t)rule->priority);
+    snapshotWriteU32(w, rule->minIntervalMs);
+    snapshotWriteFloat(w, rule->tokenRate);
+    snapshotWriteFloat(w, rule->tokenBurst);
+
+    snapshotWriteU16(w, (uint16_t)rule->triggerCount);
     for (int i = 0; i < rule->triggerCount; i++) {
-        RuleTrigger* trigger = &rule->triggers[i];
-        bool triggered = false;
-        
+        const RuleTrigger* trigger = &rule->triggers[i];
+        snapshotWriteU8(w, (uint8_t)trigger->type);
+
         switch (trigger->type) {
             case MCP_TRIGGER_TYPE_CONDITION:
-                // This is a simplified implementation
-                // In a real implementation, you'd check sensor values
-                triggered = false;  // Placeholder
+                snapshotWriteString(w, trigger->config.condition.expression);
+                snapshotWriteString(w, trigger->config.condition.releaseExpression);
+                snapshotWriteU32(w, trigger->config.condition.holdMs);
+                snapshotWriteU8(w, trigger->config.condition.nodeCount);
+                for (int j = 0; j < trigger->config.condition.nodeCount; j++) {
+                    if (!snapshotWriteNode(w, trigger->config.condition.nodes[j])) {
+                        return false;
+                    }
+                }
+                if (trigger->config.condition.releaseNode != NULL &&
+                    !snapshotWriteNode(w, trigger->config.condition.releaseNode)) {
+                    return false;
+                }
                 break;
-                
+
             case MCP_TRIGGER_TYPE_EVENT:
-                // This would be handled through the event system
-                triggered = false;  // Placeholder
-                break;
-                
-            case MCP_TRIGGER_TYPE_SCHEDULE: {
-                uint32_t currentTimeMs = 0;  // TODO: Get current time
-                uint32_t elapsed = currentTimeMs - trigger->config.schedule.lastTriggerTime;
-                
-                if (elapsed >= trigger->config.schedule.intervalMs) {
-                    triggered = true;
-                    trigger->config.schedule.lastTriggerTime = currentTimeMs;
-                }
+                snapshotWriteU8(w, (uint8_t)trigger->config.event.eventType);
+                snapshotWriteString(w, trigger->config.event.eventSource);
                 break;
-            }
-                
+
+            case MCP_TRIGGER_TYPE_SCHEDULE:
+                snapshotWriteU32(w, trigger->config.schedule.intervalMs);
+                snapshotWriteU32(w, trigger->config.schedule.offsetMs);
+                break;
+
             case MCP_TRIGGER_TYPE_MANUAL:
-                // Manual triggers are not checked automatically
-                triggered = false;
                 break;
         }
-        
-        if (triggered) {
-            return true;  // One trigger is enough
+    }
+
+    snapshotWriteU16(w, (uint16_t)rule->actionCount);
+    for (int i = 0; i < rule->actionCount; i++) {
+        const RuleAction* action = &rule->actions[i];
+        snapshotWriteU8(w, (uint8_t)action->type);
+
+        switch (action->type) {
+            case MCP_ACTION_TYPE_ACTUATOR:
+                snapshotWriteString(w, action->config.actuator.target);
+                snapshotWriteString(w, action->config.actuator.command);
+                snapshotWriteString(w, action->config.actuator.paramsJson);
+                break;
+
+            case MCP_ACTION_TYPE_TOOL:
+                snapshotWriteString(w, action->config.tool.tool);
+                snapshotWriteString(w, action->config.tool.paramsJson);
+                break;
+
+            case MCP_ACTION_TYPE_NOTIFICATION:
+                snapshotWriteString(w, action->config.notification.message);
+                snapshotWriteString(w, action->config.notification.level);
+                snapshotWriteString(w, action->config.notification.destination);
+                break;
+
+            case MCP_ACTION_TYPE_CUSTOM:
+                snapshotWriteString(w, action->config.custom.handlerName);
+                snapshotWriteString(w, action->config.custom.paramsJson);
+                break;
         }
     }
-    
-    return false;
+
+    return true;
 }
 
-int MCP_AutomationExecuteActions(const char* ruleId) {
-    Rule* rule = findRule(ruleId);
-    if (rule == NULL) {
+int MCP_AutomationSaveSnapshot(uint8_t* buffer, size_t bufferSize) {
+    if (!s_initialized) {
         return -1;
     }
-    
-    // Execute each action
-    for (int i = 0; i < rule->actionCount; i++) {
+
+    SnapshotWriter w = { buffer, bufferSize, SNAPSHOT_HEADER_SIZE };
+    uint16_t ruleCount = 0;
+
+    for (int i = 0; i < s_ruleCount; i++) {
+        if (s_rules[i] == NULL) {
+            continue;
+        }
+        if (!snapshotWriteRule(&w, s_rules[i])) {
+            return -3;  // Rule too large for the format
+        }
+        ruleCount++;
+    }
+
+    if (buffer == NULL) {
+        return (int)w.position;  // Required size
+    }
+    if (w.position > bufferSize) {
+        return -2;  // Buffer too small
+    }
+
+    // Header last, once the payload checksum is known
+    size_t payloadLength = w.position - SNAPSHOT_HEADER_SIZE;
+    SnapshotWriter header = { buffer, SNAPSHOT_HEADER_SIZE, 0 };
+    snapshotWrite(&header, SNAPSHOT_MAGIC, 4);
+    snapshotWriteU16(&header, SNAPSHOT_VERSION);
+    snapshotWriteU16(&header, ruleCount);
+    snapshotWriteU32(&header, (uint32_t)payloadLength);
+    snapshotWriteU32(&header, MCP_Crc32(buffer + SNAPSHOT_HEADER_SIZE, payloadLength));
+
+    return (int)w.position;
+}
+
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+    size_t position;
+    bool error;
+} SnapshotReader;
+
+static const uint8_t* snapshotRead(SnapshotReader* r, size_t length) {
+    if (r->error || r->position + length > r->size) {
+        r->error = true;
+        return NULL;
+    }
+
+    const uint8_t* bytes = r->data + r->position;
+    r->position += length;
+    return bytes;
+}
+
+static uint8_t snapshotReadU8(SnapshotReader* r) {
+    const uint8_t* bytes = snapshotRead(r, 1);
+    return bytes != NULL ? bytes[0] : 0;
+}
+
+static uint16_t snapshotReadU16(SnapshotReader* r) {
+    const uint8_t* bytes = snapshotRead(r, 2);
+    return bytes != NULL ? (uint16_t)(bytes[0] | (bytes[1] << 8)) : 0;
+}
+
+static uint32_t snapshotReadU32(SnapshotReader* r) {
+    const uint8_t* bytes = snapshotRead(r, 4);
+    return bytes != NULL ? (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) |
+                           ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24) : 0;
+}
+
+static float snapshotReadFloat(SnapshotReader* r) {
+    uint32_t bits = snapshotReadU32(r);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static char* snapshotReadString(SnapshotReader* r) {
+    uint16_t length = snapshotReadU16(r);
+    if (length == SNAPSHOT_NO_STRING) {
+        return NULL;
+    }
+
+    const uint8_t* bytes = snapshotRead(r, length);
+    char* value = bytes != NULL ? (char*)malloc(length + 1) : NULL;
+    if (value == NULL) {
+        r->error = true;
+        return NULL;
+    }
+
+    memcpy(value, bytes, length);
+    value[length] = '\0';
+    return value;
+}
+
+static ConditionNode* snapshotReadNode(SnapshotReader* r) {
+    char* expression = snapshotReadString(r);
+    uint16_t length = snapshotReadU16(r);
+    const uint8_t* code = snapshotRead(r, length);
+    if (expression == NULL || code == NULL) {
+        free(expression);
+        r->error = true;
+        return NULL;
+    }
+
+    // An existing node with the same text is reused without loading the program
+    ConditionNode* node = findNode(expression, hashExpression(expression));
+    if (node == NULL) {
+        MCP_RuleProgram* program = MCP_RuleProgramDeserialize(code, length, NULL);
+        node = program != NULL ? findOrCreateNode(expression, program) : NULL;
+    }
+
+    free(expression);
+    if (node == NULL) {
+        r->error = true;
+    }
+    return node;
+}
+
+static Rule* snapshotReadRule(SnapshotReader* r) {
+    Rule* rule = (Rule*)calloc(1, sizeof(Rule));
+    if (rule == NULL) {
+        r->error = true;
+        return NULL;
+    }
+    rule->handle = -1;
+
+    rule->id = snapshotReadString(r);
+    rule->name = snapshotReadString(r);
+    rule->description = snapshotReadString(r);
+    uint8_t flags = snapshotReadU8(r);
+    rule->enabled = (flags & 1) != 0;
+    rule->persistent = (flags & 2) != 0;
+    rule->priority = (int)snapshotReadU32(r);
+    rule->minIntervalMs = snapshotReadU32(r);
+    rule->tokenRate = snapshotReadFloat(r);
+    rule->tokenBurst = snapshotReadFloat(r);
+    rule->tokens = rule->tokenBurst;
+    rule->tokenTime = s_currentTimeMs;
+
+    uint16_t triggerCount = snapshotReadU16(r);
+    if (!r->error && triggerCount > 0) {
+        rule->triggers = (RuleTrigger*)calloc(triggerCount, sizeof(RuleTrigger));
+        r->error = rule->triggers == NULL;
+    }
+
+    for (uint16_t i = 0; i < triggerCount && !r->error; i++) {
+        RuleTrigger* trigger = &rule->triggers[i];
+        trigger->timerIndex = -1;
+        trigger->type = (MCP_TriggerType)snapshotReadU8(r);
+        rule->triggerCount++;
+
+        switch (trigger->type) {
+            case MCP_TRIGGER_TYPE_CONDITION: {
+                trigger->config.condition.expression = snapshotReadString(r);
+                trigger->config.condition.releaseExpression = snapshotReadString(r);
+                trigger->config.condition.holdMs = snapshotReadU32(r);
+                uint8_t nodeCount = snapshotReadU8(r);
+                if (r->error || nodeCount == 0) {
+                    r->error = true;
+                    break;
+                }
+
+                trigger->config.condition.nodes = (ConditionNode**)calloc(nodeCount, sizeof(ConditionNode*));
+                if (trigger->config.condition.nodes == NULL) {
+                    r->error = true;
+                    break;
+                }
+                for (uint8_t j = 0; j < nodeCount && !r->error; j++) {
+                    ConditionNode* node = snapshotReadNode(r);
+                    if (node != NULL) {
+                        addConditionNode(trigger, node);
+                    }
+                }
+                if (trigger->config.condition.releaseExpression != NULL && !r->error) {
+                    trigger->config.condition.releaseNode = snapshotReadNode(r);
+                }
+                break;
+            }
+
+            case MCP_TRIGGER_TYPE_EVENT:
+                trigger->config.event.eventType = (MCP_EventType)snapshotReadU8(r);
+                trigger->config.event.eventSource = snapshotReadString(r);
+                r->error = r->error || (int)trigger->config.event.eventType >= EVENT_TYPE_COUNT;
+                break;
+
+            case MCP_TRIGGER_TYPE_SCHEDULE:
+                trigger->config.schedule.intervalMs = snapshotReadU32(r);
+                trigger->config.schedule.offsetMs = snapshotReadU32(r);
+                r->error = r->error || trigger->config.schedule.intervalMs == 0;
+                break;
+
+            case MCP_TRIGGER_TYPE_MANUAL:
+                break;
+
+            default:
+                r->error = true;
+                break;
+        }
+    }
+
+    uint16_t actionCount = r->error ? 0 : snapshotReadU16(r);
+    if (!r->error && actionCount > 0) {
+        rule->actions = (RuleAction*)calloc(actionCount, sizeof(RuleAction));
+        r->error = rule->actions == NULL;
+    }
+
+    for (uint16_t i = 0; i < actionCount && !r->error; i++) {
         RuleAction* action = &rule->actions[i];
-        
+        action->type = (MCP_ActionType)snapshotReadU8(r);
+        rule->actionCount++;
+
         switch (action->type) {
             case MCP_ACTION_TYPE_ACTUATOR:
-                // This is a simplified implementation
-                // In a real implementation, you'd control actuators
+                action->config.actuator.target = snapshotReadString(r);
+                action->config.actuator.command = snapshotReadString(r);
+                action->config.actuator.paramsJson = snapshotReadString(r);
+                if (action->config.actuator.target == NULL || action->config.actuator.command == NULL) {
+                    r->error = true;
+                } else {
+                    action->config.actuator.writeId = internWrite(action->config.actuator.target,
+                                                                  action->config.actuator.command);
+                }
                 break;
-                
+
             case MCP_ACTION_TYPE_TOOL:
-                if (action->config.tool.tool != NULL) {
-                    // Create tool JSON
-                    char toolJson[512];
-                    snprintf(toolJson, sizeof(toolJson), 
-                             "{\"tool\":\"%s\",\"params\":%s}",
-                             action->config.tool.tool,
-                             action->config.tool.paramsJson ? action->config.tool.paramsJson : "{}");
-                    
-                    // Execute tool
-                    MCP_ToolExecute(toolJson, strlen(toolJson));
-                }
+                action->config.tool.tool = snapshotReadString(r);
+                action->config.tool.paramsJson = snapshotReadString(r);
                 break;
-                
+
             case MCP_ACTION_TYPE_NOTIFICATION:
-                // This is a simplified implementation
-                // In a real implementation, you'd send notifications
+                action->config.notification.message = snapshotReadString(r);
+                action->config.notification.level = snapshotReadString(r);
+                action->config.notification.destination = snapshotReadString(r);
                 break;
-                
+
             case MCP_ACTION_TYPE_CUSTOM:
-                // This is a simplified implementation
-                // In a real implementation, you'd call custom handlers
+                action->config.custom.handlerName = snapshotReadString(r);
+                action->config.custom.paramsJson = snapshotReadString(r);
+                break;
+
+            default:
+                r->error = true;
                 break;
         }
     }
-    
-    return 0;
-}
 
-int MCP_AutomationTriggerRule(const char* ruleId) {
-    Rule* rule = findRule(ruleId);
-    if (rule == NULL) {
-        return -1;
-    }
-    
-    if (!rule->enabled) {
-        return -2;  // Rule disabled
+    if (r->error || rule->id == NULL || rule->name == NULL || rule->description == NULL) {
+        r->error = true;
+        freeRule(rule);
+        return NULL;
     }
-    
-    return MCP_AutomationExecuteActions(ruleId);
+
+    return rule;
 }
 
-int MCP_AutomationExportRules(char* buffer, size_t bufferSize) {
-    if (!s_initialized || buffer == NULL || bufferSize == 0) {
+int MCP_AutomationLoadSnapshot(const uint8_t* data, size_t size) {
+    if (!s_initialized || data == NULL) {
         return -1;
     }
-    
-    // Start JSON array
-    int offset = 0;
-    offset += snprintf(buffer + offset, bufferSize - offset, "[");
-    
-    // Add rules
-    for (int i = 0; i < s_ruleCount; i++) {
-        Rule* rule = s_rules[i];
+
+    // Validate the header and checksum before touching the rule set
+    SnapshotReader header = { data, size, 0, false };
+    const uint8_t* magic = snapshotRead(&header, 4);
+    uint16_t version = snapshotReadU16(&header);
+    uint16_t ruleCount = snapshotReadU16(&header);
+    uint32_t payloadLength = snapshotReadU32(&header);
+    uint32_t crc = snapshotReadU32(&header);
+
+    if (header.error || memcmp(magic, SNAPSHOT_MAGIC, 4) != 0) {
+        return -2;  // Not a snapshot
+    }
+    if (version != SNAPSHOT_VERSION) {
+        return -3;  // Unsupported version
+    }
+    if (payloadLength > size - SNAPSHOT_HEADER_SIZE ||
+        MCP_Crc32(data + SNAPSHOT_HEADER_SIZE, payloadLength) != crc) {
+        return -4;  // Truncated or corrupted
+    }
+
+    SnapshotReader r = { data + SNAPSHOT_HEADER_SIZE, payloadLength, 0, false };
+    int loaded = 0;
+
+    for (uint16_t i = 0; i < ruleCount; i++) {
+        Rule* rule = snapshotReadRule(&r);
         if (rule == NULL) {
+            return loaded > 0 ? loaded : -5;  // Malformed record
+        }
+
+        // Rules that already exist are kept as they are
+        if (findRule(rule->id) != NULL) {
+            freeRule(rule);
             continue;
         }
-        
-        // Add comma if not first rule
-        if (i > 0) {
-            offset += snprintf(buffer + offset, bufferSize - offset, ",");
-        }
-        
-        // Add rule info (simplified)
-        offset += snprintf(buffer + offset, bufferSize - offset, 
-                          "{\"id\":\"%s\",\"name\":\"%s\",\"enabled\":%s,\"persistent\":%s}",
-                          rule->id,
-                          rule->name,
-                          rule->enabled ? "true" : "false",
-                          rule->persistent ? "true" : "false");
-        
-        // Check if we're about to overflow
-        if ((size_t)offset >= bufferSize - 2) {
-            return -2;  // Buffer too small
-        }
-    }
-    
-    // End JSON array
-    offset += snprintf(buffer + offset, bufferSize - offset, "]");
-    
-    return offset;
+
+        if (addRule(rule)) {
+            loaded++;
+        }
+    }
+
+    return loaded;
 }
 
-int MCP_AutomationImportRules(const char* json, size_t length) {
-    // Mark parameters as unused to avoid compiler warnings
-    (void)json;
-    (void)length;
-    
-    // Not implemented for simplicity
-    // In a real implementation, you'd parse the JSON and create rules
-    return -100;  // Not implemented
+// ===== Parser functions =====
+
+static bool parseEventType(const char* name, MCP_EventType* type) {
+    for (int i = 0; i < EVENT_TYPE_COUNT; i++) {
+        if (strcmp(name, s_eventTypeNames[i]) == 0) {
+            *type = (MCP_EventType)i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Build a condition expression from the {"sensor", "operator", "value"} form
+static char* buildConditionExpression(const char* json) {
+    char* sensor = json_get_string_field(json, "sensor");
+    char* op = json_get_string_field(json, "operator");
+    if (sensor == NULL || op == NULL) {
+        free(sensor);
+        free(op);
+        return NULL;
+    }
+
+    // Format the comparison value as a rule literal
+    char value[160];
+    char* stringValue = json_get_string_field(json, "value");
+    if (stringValue != NULL) {
+        snprintf(value, sizeof(value), "'%s'", stringValue);
+        free(stringValue);
+    } else if (json_get_bool_field(json, "value", false) == json_get_bool_field(json, "value", true)) {
+        snprintf(value, sizeof(value), "%s", json_get_bool_field(json, "value", false) ? "true" : "false");
+    } else {
+        snprintf(value, sizeof(value), "%.17g", json_get_double_field(json, "value", 0));
+    }
+
+    static const struct {
+        const char* symbol;
+        const char* name;
+        const char* format;
+    } operators[] = {
+        { "==", "equal",         "%s == %s" },
+        { "!=", "not_equal",     "%s != %s" },
+        { ">",  "greater_than",  "%s > %s" },
+        { "<",  "less_than",     "%s < %s" },
+        { ">=", "greater_equal", "%s >= %s" },
+        { "<=", "less_equal",    "%s <= %s" },
+        { NULL, "contains",      "contains(%s, %s)" },
+        { NULL, "not_contains",  "!contains(%s, %s)" },
+        { NULL, "starts_with",   "starts_with(%s, %s)" },
+        { NULL, "ends_with",     "ends_with(%s, %s)" }
+    };
+
+    char* expression = NULL;
+    for (size_t i = 0; i < sizeof(operators) / sizeof(operators[0]); i++) {
+        if ((operators[i].symbol != NULL && strcmp(op, operators[i].symbol) == 0) ||
+            strcmp(op, operators[i].name) == 0) {
+            size_t size = strlen(sensor) + strlen(value) + 32;
+            expression = (char*)malloc(size);
+            if (expression != NULL) {
+                snprintf(expression, size, operators[i].format, sensor, value);
+            }
+            break;
+        }
+    }
+
+    free(sensor);
+    free(op);
+    return expression;
+}
+
+// Build the hysteresis release condition for a structured numeric threshold:
+// "x > 30" with a band of 2 re-arms once "x <= 28"
+static char* buildReleaseExpression(const char* json, double band) {
+    char* sensor = json_get_string_field(json, "sensor");
+    char* op = json_get_string_field(json, "operator");
+    double threshold = json_get_double_field(json, "value", 0);
+    char* expression = NULL;
+
+    if (sensor != NULL && op != NULL) {
+        const char* format = NULL;
+        double releaseAt = threshold;
+
+        if (strcmp(op, ">") == 0 || strcmp(op, ">=") == 0 ||
+            strcmp(op, "greater_than") == 0 || strcmp(op, "greater_equal") == 0) {
+            format = "%s <= %.17g";
+            releaseAt = threshold - band;
+        } else if (strcmp(op, "<") == 0 || strcmp(op, "<=") == 0 ||
+                   strcmp(op, "less_than") == 0 || strcmp(op, "less_equal") == 0) {
+            format = "%s >= %.17g";
+            releaseAt = threshold + band;
+        }
+
+        if (format != NULL) {
+            size_t size = strlen(sensor) + 40;
+            expression = (char*)malloc(size);
+            if (expression != NULL) {
+                snprintf(expression, size, format, sensor, releaseAt);
+            }
+        }
+    }
+
+    free(sensor);
+    free(op);
+    return expression;
+}
+
+static bool parseTrigger(const char* json, RuleTrigger* trigger) {
+    trigger->timerIndex = -1;
+
+    char* type = json_get_string_field(json, "type");
+    if (type == NULL) {
+        return false;
+    }
+
+    bool ok = true;
+
+    if (strcmp(type, "condition") == 0) {
+        trigger->type = MCP_TRIGGER_TYPE_CONDITION;
+        trigger->config.condition.expression = json_get_string_field(json, "expression");
+        if (trigger->config.condition.expression == NULL) {
+            trigger->config.condition.expression = buildConditionExpression(json);
+        }
+        ok = trigger->config.condition.expression != NULL;
+
+        // Qualifiers: hold-for-duration and hysteresis (explicit release or band)
+        trigger->config.condition.holdMs = (uint32_t)json_get_double_field(json, "hold", 0);
+        trigger->config.condition.releaseExpression = json_get_string_field(json, "release");
+        double band = json_get_double_field(json, "hysteresis", 0);
+        if (ok && band > 0 && trigger->config.condition.releaseExpression == NULL) {
+            trigger->config.condition.releaseExpression = buildReleaseExpression(json, band);
+            ok = trigger->config.condition.releaseExpression != NULL;
+        }
+    } else if (strcmp(type, "event") == 0) {
+        trigger->type = MCP_TRIGGER_TYPE_EVENT;
+        char* eventType = json_get_string_field(json, "event");
+        ok = eventType != NULL && parseEventType(eventType, &trigger->config.event.eventType);
+        free(eventType);
+        trigger->config.event.eventSource = json_get_string_field(json, "source");
+    } else if (strcmp(type, "schedule") == 0) {
+        trigger->type = MCP_TRIGGER_TYPE_SCHEDULE;
+        trigger->config.schedule.intervalMs = (uint32_t)json_get_double_field(json, "interval", 0);
+        ok = trigger->config.schedule.intervalMs > 0;
+
+        // Optional phase ("at"), e.g. 07:00 daily; defaults to the creation time
+        double offset = json_get_double_field(json, "at", -1);
+        trigger->config.schedule.offsetMs = offset >= 0 ? (uint32_t)offset : s_currentTimeMs;
+    } else if (strcmp(type, "manual") == 0) {
+        trigger->type = MCP_TRIGGER_TYPE_MANUAL;
+    } else {
+        ok = false;
+    }
+
+    free(type);
+    return ok;
+}
+
+static bool parseAction(const char* json, RuleAction* action) {
+    char* type = json_get_string_field(json, "type");
+    if (type == NULL) {
+        return false;
+    }
+
+    bool ok = true;
+
+    if (strcmp(type, "actuator") == 0) {
+        action->type = MCP_ACTION_TYPE_ACTUATOR;
+        action->config.actuator.target = json_get_string_field(json, "target");
+        action->config.actuator.command = json_get_string_field(json, "command");
+        action->config.actuator.paramsJson = (char*)json_get_object_field(json, "params");
+        ok = action->config.actuator.target != NULL && action->config.actuator.command != NULL;
+        if (ok) {
+            action->config.actuator.writeId = internWrite(action->config.actuator.target,
+                                                          action->config.actuator.command);
+        }
+    } else if (strcmp(type, "tool") == 0) {
+        action->type = MCP_ACTION_TYPE_TOOL;
+        action->config.tool.tool = json_get_string_field(json, "tool");
+        action->config.tool.paramsJson = (char*)json_get_object_field(json, "params");
+        ok = action->config.tool.tool != NULL;
+    } else if (strcmp(type, "notification") == 0) {
+        action->type = MCP_ACTION_TYPE_NOTIFICATION;
+        action->config.notification.message = json_get_string_field(json, "message");
+        action->config.notification.level = json_get_string_field(json, "level");
+        action->config.notification.destination = json_get_string_field(json, "destination");
+        if (action->config.notification.message == NULL) {
+            action->config.notification.message = strdup("Rule triggered");
+        }
+        if (action->config.notification.level == NULL) {
+            action->config.notification.level = strdup("info");
+        }
+        if (action->config.notification.destination == NULL) {
+            action->config.notification.destination = strdup("log");
+        }
+    } else if (strcmp(type, "custom") == 0) {
+        action->type = MCP_ACTION_TYPE_CUSTOM;
+        action->config.custom.handlerName = json_get_string_field(json, "handler");
+        action->config.custom.paramsJson = (char*)json_get_object_field(json, "params");
+        ok = action->config.custom.handlerName != NULL;
+    } else {
+        ok = false;
+    }
+
+    free(type);
+    return ok;
 }
 
-// Parser functions implementation (simplified)
 static bool parseTriggers(const char* json, Rule* rule) {
     // Get triggers array
     void* triggersJson = json_get_array_field(json, "triggers");
     if (triggersJson == NULL) {
         return false;
     }
-    
-    // Get trigger count
-    int triggerCount = 1;  // Simplified - in reality would get array length
-    
-    // Allocate triggers array
-    rule->triggers = (RuleTrigger*)calloc(triggerCount, sizeof(RuleTrigger));
-    if (rule->triggers == NULL) {
-        return false;
+
+    size_t triggerCount = json_array_length(triggersJson);
+    if (triggerCount > 0) {
+        rule->triggers = (RuleTrigger*)calloc(triggerCount, sizeof(RuleTrigger));
+        if (rule->triggers == NULL) {
+            json_array_free(triggersJson);
+            return false;
+        }
     }
-    
-    rule->triggerCount = triggerCount;
-    
-    // Parse triggers (simplified - in reality would iterate through array)
-    RuleTrigger* trigger = &rule->triggers[0];
-    
-    // Set default values
-    trigger->type = MCP_TRIGGER_TYPE_MANUAL;
-    
-    return true;
+
+    bool ok = true;
+    for (size_t i = 0; i < triggerCount && ok; i++) {
+        char* item = json_array_get_item(triggersJson, i);
+        if (item == NULL) {
+            ok = false;
+            break;
+        }
+
+        // Count the trigger even if parsing fails so its memory is released
+        ok = parseTrigger(item, &rule->triggers[i]);
+        rule->triggerCount++;
+        free(item);
+    }
+
+    json_array_free(triggersJson);
+    return ok;
 }
 
 static bool parseActions(const char* json, Rule* rule) {
@@ -580,26 +2991,30 @@ static bool parseActions(const char* json, Rule* rule) {
     if (actionsJson == NULL) {
         return false;
     }
-    
-    // Get action count
-    int actionCount = 1;  // Simplified - in reality would get array length
-    
-    // Allocate actions array
-    rule->actions = (RuleAction*)calloc(actionCount, sizeof(RuleAction));
-    if (rule->actions == NULL) {
-        return false;
+
+    size_t actionCount = json_array_length(actionsJson);
+    if (actionCount > 0) {
+        rule->actions = (RuleAction*)calloc(actionCount, sizeof(RuleAction));
+        if (rule->actions == NULL) {
+            json_array_free(actionsJson);
+            return false;
+        }
     }
-    
-    rule->actionCount = actionCount;
-    
-    // Parse actions (simplified - in reality would iterate through array)
-    RuleAction* action = &rule->actions[0];
-    
-    // Set default values
-    action->type = MCP_ACTION_TYPE_NOTIFICATION;
-    action->config.notification.message = strdup("Rule triggered");
-    action->config.notification.level = strdup("info");
-    action->config.notification.destination = strdup("log");
-    
-    return true;
-}
\ No newline at end of file
+
+    bool ok = true;
+    for (size_t i = 0; i < actionCount && ok; i++) {
+        char* item = json_array_get_item(actionsJson, i);
+        if (item == NULL) {
+            ok = false;
+            break;
+        }
+
+        // Count the action even if parsing fails so its memory is released
+        ok = parseAction(item, &rule->actions[i]);
+        rule->actionCount++;
+        free(item);
+    }
+
+    json_array_free(actionsJson);
+    return ok;
+}
@@ -4,6 +4,13 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include "../kernel/event_system.h"
+#include "tool_registry.h"
+
+/**
+ * @brief Tool name for the rule profile
+ */
+#define MCP_AUTOMATION_PROFILE_TOOL_NAME "automation.profile"
 
 /**
  * @brief Trigger types for automation rules
@@ -41,6 +48,48 @@ typedef enum {
     MCP_ACTION_TYPE_CUSTOM        // Custom action
 } MCP_ActionType;
 
+/**
+ * @brief Action queue counters
+ */
+typedef struct {
+    uint32_t actionsQueued;     // Actions fired by rules
+    uint32_t actionsIssued;     // Actions executed
+    uint32_t actionsCoalesced;  // Actuator writes replaced by a write of the same command to the same target
+    uint32_t actionsDeferred;   // Actions carried to a later pass by the time budget
+} MCP_AutomationActionStats;
+
+/**
+ * @brief Per-rule profile counters
+ *
+ * Condition counters are taken from the rule's condition nodes; a condition
+ * shared by several rules is charged in full to each of them. Times are zero
+ * unless profiling runs with a clock.
+ */
+typedef struct {
+    const char* ruleId;             // Valid until the rule is deleted
+    uint32_t evaluations;           // Condition evaluations
+    uint32_t trueResults;           // Evaluations that returned true
+    uint32_t firings;               // Runs admitted (after rate limits) or triggered manually
+    uint32_t suppressed;            // Runs dropped by rate limits
+    uint32_t actionsIssued;
+    uint64_t evalTimeNs;            // Cumulative condition evaluation time
+    uint32_t maxEvalNs;
+    uint64_t actionLatencyNs;       // Cumulative time from ready to action issued
+    uint32_t maxActionLatencyNs;
+} MCP_AutomationRuleProfile;
+
+/**
+ * @brief Sort keys for MCP_AutomationGetTopRules
+ */
+typedef enum {
+    MCP_AUTOMATION_SORT_EVAL_TIME,
+    MCP_AUTOMATION_SORT_MAX_EVAL_TIME,
+    MCP_AUTOMATION_SORT_EVALUATIONS,
+    MCP_AUTOMATION_SORT_FIRINGS,
+    MCP_AUTOMATION_SORT_ACTION_LATENCY,
+    MCP_AUTOMATION_SORT_MAX_ACTION_LATENCY
+} MCP_AutomationProfileSort;
+
 /**
  * @brief Initialize the automation engine
  * 
@@ -81,6 +130,38 @@ int MCP_AutomationDeleteRule(const char* ruleId);
  */
 void MCP_AutomationProcess(uint32_t currentTimeMs);
 
+/**
+ * @brief Limit the time spent executing actions in one process pass
+ *
+ * Actions are queued per pass and run by rule priority. Writes of the same
+ * command to the same actuator target coalesce; different commands all run.
+ * Actions left when the budget runs out stay queued for the next pass.
+ *
+ * @param budgetUs Budget in microseconds (0 for unlimited)
+ * @param clockUs Microsecond clock used to measure the budget
+ * @return int 0 on success, negative error code on failure
+ */
+int MCP_AutomationSetActionBudget(uint32_t budgetUs, uint32_t (*clockUs)(void));
+
+/**
+ * @brief Get action queue counters
+ *
+ * @param stats Output counters
+ * @return int 0 on success, negative error code on failure
+ */
+int MCP_AutomationGetActionStats(MCP_AutomationActionStats* stats);
+
+/**
+ * @brief Feed an event to the automation engine
+ *
+ * Fires every rule with an event trigger bound to the event's type and source.
+ * Registered with the event system automatically when it is running at init.
+ *
+ * @param event Event to match against event triggers
+ * @param userData Unused
+ */
+void MCP_AutomationHandleEvent(const MCP_Event* event, void* userData);
+
 /**
  * @brief Check and evaluate a rule's triggers
  * 
@@ -123,4 +204,94 @@ int MCP_AutomationExportRules(char* buffer, size_t bufferSize);
  */
 int MCP_AutomationImportRules(const char* json, size_t length);
 
+/**
+ * @brief Write the rule set as a binary snapshot
+ *
+ * The snapshot is versioned and checksummed, and holds compiled condition
+ * programs, trigger tables and action descriptors so it loads without parsing.
+ *
+ * @param buffer Output buffer, or NULL to compute the required size
+ * @param bufferSize Size of buffer
+ * @return int Number of bytes written (or required) or negative error code
+ */
+int MCP_AutomationSaveSnapshot(uint8_t* buffer, size_t bufferSize);
+
+/**
+ * @brief Load rules from a binary snapshot
+ *
+ * The header and checksum are validated before any rule is added. Rules whose
+ * IDs already exist are skipped.
+ *
+ * @param data Snapshot written by MCP_AutomationSaveSnapshot
+ * @param size Size of data
+ * @return int Number of rules loaded or negative error code
+ */
+int MCP_AutomationLoadSnapshot(const uint8_t* data, size_t size);
+
+/**
+ * @brief Enable or disable rule profiling
+ *
+ * Profiling is off by default. Without a clock only counters are kept; with
+ * one, evaluation time and action latency are measured too. A cycle counter
+ * gives sub-microsecond resolution.
+ *
+ * Counters add up to about a tenth to the cost of an incremental update, and
+ * timing about as much again. To keep timing cheap, each condition times only
+ * its first evaluation and one in 16 after that, and each rule the action
+ * latency of its first run and one in 16 after that. Cumulative times are
+ * scaled up from those samples; maximums are the largest sampled times.
+ *
+ * @param enabled Whether to record profile data
+ * @param clockTicks Free-running tick counter, or NULL for counters only
+ * @param ticksPerUs Ticks per microsecond of clockTicks
+ * @return int 0 on success, -1 if a clock is given without a tick rate
+ */
+int MCP_AutomationSetProfiling(bool enabled, uint32_t (*clockTicks)(void), uint32_t ticksPerUs);
+
+/**
+ * @brief Clear all profile counters
+ */
+void MCP_AutomationResetProfile(void);
+
+/**
+ * @brief Get the profile of a rule
+ *
+ * @param ruleId Rule ID
+ * @param profile Output profile
+ * @return int 0 on success, negative error code on failure
+ */
+int MCP_AutomationGetRuleProfile(const char* ruleId, MCP_AutomationRuleProfile* profile);
+
+/**
+ * @brief Get the most expensive rules
+ *
+ * @param profiles Output array, sorted by the key in descending order
+ * @param maxCount Size of profiles
+ * @param sortBy Sort key
+ * @return int Number of profiles written or negative error code
+ */
+int MCP_AutomationGetTopRules(MCP_AutomationRuleProfile* profiles, int maxCount, MCP_AutomationProfileSort sortBy);
+
+/**
+ * @brief Tool handler for automation.profile
+ *
+ * Parameters: "top" (default 5), "sortBy" (evalTime, maxEvalTime, evaluations,
+ * firings, actionLatency, maxActionLatency) and "reset" to clear the counters
+ * after reading.
+ *
+ * @param json Input JSON
+ * @param length Length of input JSON
+ * @return MCP_ToolResult Tool result with the top rules
+ */
+MCP_ToolResult MCP_AutomationProfileToolHandler(const char* json, size_t length);
+
+/**
+ * @brief Register automation.profile with the tool registry
+ *
+ * Called by MCP_AutomationInit; the call fails if the registry is not running.
+ *
+ * @return int 0 on success, negative error code on failure
+ */
+int MCP_AutomationProfileToolRegister(void);
+
 #endif /* MCP_AUTOMATION_ENGINE_H */
\ No newline at end of file
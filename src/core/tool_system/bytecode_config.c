@@ -18,6 +18,9 @@ static MCP_BytecodeRuntimeConfig g_bytecodeConfig;
 static size_t g_totalAllocated = 0;
 static bool g_initialized = false;
 
+// Log handle for the allocation tracking, which runs on every allocation
+static LogModule g_bytecodeLog = LOG_MODULE_INIT("BYTECODE");
+
 // Tool handler prototypes
 static int handle_get_config(const char* sessionId, const char* operationId, 
                            const MCP_Content* params, MCP_Content** result);
@@ -77,6 +80,7 @@ int MCP_BytecodeConfigInit(void) {
     
     g_totalAllocated = 0;
     g_initialized = true;
+    log_register_module(&g_bytecodeLog);
     
     LOG_INFO("BYTECODE", "Initialized bytecode configuration with max size %u bytes",
             g_bytecodeConfig.max_bytecode_size);
@@ -209,7 +213,7 @@ int MCP_BytecodeConfigTrackAllocation(size_t size) {
     
     g_totalAllocated += size;
     
-    LOG_DEBUG("BYTECODE", "Tracked allocation of %zu bytes, total now %zu bytes",
+    LOG_AT(LOG_LEVEL_DEBUG, g_bytecodeLog, "Tracked allocation of %zu bytes, total now %zu bytes",
             size, g_totalAllocated);
     
     return 0;
@@ -231,7 +235,7 @@ int MCP_BytecodeConfigTrackDeallocation(size_t size) {
         g_totalAllocated -= size;
     }
     
-    LOG_DEBUG("BYTECODE", "Tracked deallocation of %zu bytes, total now %zu bytes",
+    LOG_AT(LOG_LEVEL_DEBUG, g_bytecodeLog, "Tracked deallocation of %zu bytes, total now %zu bytes",
             size, g_totalAllocated);
     
     return 0;
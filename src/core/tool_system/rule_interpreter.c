@@ -5,30 +5,113 @@
 #include <stdio.h>
 #include <math.h>
 
-// Variable structure
-typedef struct Variable {
+// Interned symbol name
+typedef struct {
     char* name;
-    MCP_RuleValue value;
-    struct Variable* next;
-} Variable;
+    uint32_t hash;
+} Symbol;
 
-// Function structure
-typedef struct Function {
-    char* name;
-    MCP_RuleFunctionHandler handler;
-    struct Function* next;
-} Function;
+// Symbol table: slot array plus an open-addressing hash index over it
+typedef struct {
+    Symbol* symbols;
+    int count;
+    int capacity;
+    int32_t* buckets;       // Slot index or -1 when empty
+    uint32_t bucketMask;    // Bucket count - 1 (bucket count is a power of two)
+} SymbolTable;
+
+// Window aggregates computed by RULE_OP_WINDOW
+typedef enum {
+    RULE_WINDOW_AVG,
+    RULE_WINDOW_MIN,
+    RULE_WINDOW_MAX,
+    RULE_WINDOW_SLOPE,
+    RULE_WINDOW_COUNT_ABOVE,    // Takes a threshold argument
+    RULE_WINDOW_AGGREGATE_COUNT
+} RuleWindowAggregate;
+
+static const char* const s_windowAggregateNames[RULE_WINDOW_AGGREGATE_COUNT] = {
+    "avg", "min", "max", "slope", "count_above"
+};
+
+// Thresholds per window whose counts are kept up to date on every sample
+#define RULE_WINDOW_THRESHOLDS 4
+
+// Monotonic queue entry for the sliding minimum and maximum
+typedef struct {
+    uint32_t sequence;
+    double value;
+} WindowExtreme;
+
+// Sliding window over the last samples of a numeric variable; every aggregate
+// is maintained in O(1) (amortized for min and max) per sample
+typedef struct {
+    double* samples;            // Ring buffer
+    WindowExtreme* minQueue;    // Increasing values, oldest first
+    WindowExtreme* maxQueue;    // Decreasing values, oldest first
+    uint16_t size;
+    uint16_t count;             // Samples held
+    uint16_t position;          // Next write index in samples
+    uint16_t minHead, minCount;
+    uint16_t maxHead, maxCount;
+    uint16_t sinceRefresh;      // Samples since the sums were recomputed
+    uint32_t sequence;          // Sequence number of the next sample
+    double sum;                 // Sum of held samples
+    double weightedSum;         // Sum of index * sample, oldest at index 0
+    double thresholds[RULE_WINDOW_THRESHOLDS];
+    uint16_t aboveCounts[RULE_WINDOW_THRESHOLDS];
+    uint8_t thresholdCount;
+} SampleWindow;
 
 // Internal state
-static Variable* s_variables = NULL;
-static Function* s_functions = NULL;
+// Slots are never removed, so compiled programs and handles refer to them by index
+static SymbolTable s_variableSymbols = {0};
+static MCP_RuleValue* s_variableValues = NULL;
+static SampleWindow** s_variableWindows = NULL;    // Per variable slot, NULL without a window
+static SymbolTable s_functionSymbols = {0};
+static MCP_RuleFunctionHandler* s_functionHandlers = NULL;
+static MCP_RuleChangeListener s_changeListener = NULL;
+static void* s_changeListenerData = NULL;
 static bool s_initialized = false;
 
+// Limits for compiled programs
+#define RULE_MAX_STACK 32
+#define RULE_MAX_PARAMS 10
+
+// Compiled program opcodes
+typedef enum {
+    RULE_OP_PUSH_CONST,     // Push constants[operand]
+    RULE_OP_LOAD_VAR,       // Push value of variable slot operand
+    RULE_OP_CALL,           // Call function slot operand with argc parameters
+    RULE_OP_BINARY,         // Apply binary operator argc to the two topmost values
+    RULE_OP_NOT,            // Logical not
+    RULE_OP_NEGATE,         // Unary minus
+    RULE_OP_AND_JUMP,       // If top is false, leave false and jump to operand, else pop
+    RULE_OP_OR_JUMP,        // If top is true, leave true and jump to operand, else pop
+    RULE_OP_TO_BOOL,        // Convert top to boolean
+    RULE_OP_WINDOW          // Push aggregate argc of variable slot operand's window
+} RuleOpcode;
+
+typedef struct {
+    uint8_t opcode;
+    uint8_t argc;
+    uint16_t operand;
+} RuleInstruction;
+
+struct MCP_RuleProgram {
+    RuleInstruction* code;
+    uint16_t codeLength;
+    MCP_RuleValue* constants;
+    uint16_t constantCount;
+    uint16_t maxStack;
+};
+
 // Tokenizer context
 typedef struct {
     const char* input;
     size_t position;
     MCP_Token current;
+    bool error;
 } TokenizerContext;
 
 // Helper function to check if character is operator
@@ -37,11 +120,6 @@ static bool isOperatorChar(char c) {
            c == '=' || c == '!' || c == '<' || c == '>' || c == '&' || c == '|';
 }
 
-// Helper function to check if operator is binary
-static bool isBinaryOperator(MCP_RuleOperator op) {
-    return op >= MCP_RULE_OP_ADD && op <= MCP_RULE_OP_LESS_EQUAL;
-}
-
 // Helper function to get operator precedence
 static int getOperatorPrecedence(MCP_RuleOperator op) {
     switch (op) {
@@ -83,100 +161,519 @@ int MCP_RuleInterpreterInit(void) {
         return -1;  // Already initialized
     }
     
-    s_variables = NULL;
-    s_functions = NULL;
+    memset(&s_variableSymbols, 0, sizeof(s_variableSymbols));
+    memset(&s_functionSymbols, 0, sizeof(s_functionSymbols));
+    s_variableValues = NULL;
+    s_variableWindows = NULL;
+    s_functionHandlers = NULL;
     s_initialized = true;
     
     return 0;
 }
 
-static Variable* findVariable(const char* name) {
-    Variable* current = s_variables;
-    while (current != NULL) {
-        if (strcmp(current->name, name) == 0) {
-            return current;
+// FNV-1a hash of a name
+static uint32_t hashName(const char* name) {
+    uint32_t hash = 2166136261u;
+    while (*name != '\0') {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int symbolFind(const SymbolTable* table, const char* name, uint32_t hash) {
+    if (table->buckets == NULL) {
+        return -1;
+    }
+    
+    uint32_t bucket = hash & table->bucketMask;
+    for (;;) {
+        int32_t slot = table->buckets[bucket];
+        if (slot < 0) {
+            return -1;
         }
-        current = current->next;
+        
+        const Symbol* symbol = &table->symbols[slot];
+        if (symbol->hash == hash && (symbol->name == name || strcmp(symbol->name, name) == 0)) {
+            return slot;
+        }
+        
+        bucket = (bucket + 1) & table->bucketMask;
     }
-    return NULL;
 }
 
-static Function* findFunction(const char* name) {
-    Function* current = s_functions;
-    while (current != NULL) {
-        if (strcmp(current->name, name) == 0) {
-            return current;
+// Grow the slot array to hold at least minCapacity symbols and rebuild the index
+static int symbolReserve(SymbolTable* table, int minCapacity) {
+    if (minCapacity <= table->capacity) {
+        return 0;
+    }
+    
+    int newCapacity = table->capacity == 0 ? 16 : table->capacity;
+    while (newCapacity < minCapacity) {
+        newCapacity *= 2;
+    }
+    
+    Symbol* newSymbols = (Symbol*)realloc(table->symbols, newCapacity * sizeof(Symbol));
+    if (newSymbols == NULL) {
+        return -1;
+    }
+    table->symbols = newSymbols;
+    
+    // Keep the load factor at or below 50%
+    uint32_t bucketCount = (uint32_t)newCapacity * 2;
+    int32_t* newBuckets = (int32_t*)malloc(bucketCount * sizeof(int32_t));
+    if (newBuckets == NULL) {
+        return -1;
+    }
+    memset(newBuckets, 0xFF, bucketCount * sizeof(int32_t));
+    
+    for (int i = 0; i < table->count; i++) {
+        uint32_t bucket = table->symbols[i].hash & (bucketCount - 1);
+        while (newBuckets[bucket] >= 0) {
+            bucket = (bucket + 1) & (bucketCount - 1);
         }
-        current = current->next;
+        newBuckets[bucket] = i;
     }
-    return NULL;
+    
+    free(table->buckets);
+    table->buckets = newBuckets;
+    table->bucketMask = bucketCount - 1;
+    table->capacity = newCapacity;
+    
+    return 0;
 }
 
-int MCP_RuleRegisterVariable(const char* name, MCP_RuleValue value) {
-    if (!s_initialized || name == NULL) {
+// Add a symbol; capacity must have been reserved
+static int symbolAdd(SymbolTable* table, const char* name, uint32_t hash) {
+    char* nameCopy = strdup(name);
+    if (nameCopy == NULL) {
         return -1;
     }
     
-    // Check if variable already exists
-    Variable* existingVar = findVariable(name);
-    if (existingVar != NULL) {
-        // Update existing variable
-        MCP_RuleFreeValue(existingVar->value);
-        existingVar->value = value;
+    int slot = table->count++;
+    table->symbols[slot].name = nameCopy;
+    table->symbols[slot].hash = hash;
+    
+    uint32_t bucket = hash & table->bucketMask;
+    while (table->buckets[bucket] >= 0) {
+        bucket = (bucket + 1) & table->bucketMask;
+    }
+    table->buckets[bucket] = slot;
+    
+    return slot;
+}
+
+// Make room for at least minCount variables in the symbol table and the per-slot arrays
+static int reserveVariables(int minCount) {
+    if (minCount <= s_variableSymbols.capacity) {
         return 0;
     }
     
-    // Create new variable
-    Variable* newVar = (Variable*)malloc(sizeof(Variable));
-    if (newVar == NULL) {
+    int oldCapacity = s_variableSymbols.capacity;
+    if (symbolReserve(&s_variableSymbols, minCount) != 0) {
         return -2;  // Memory allocation failed
     }
     
-    newVar->name = strdup(name);
-    if (newVar->name == NULL) {
-        free(newVar);
+    MCP_RuleValue* newValues = (MCP_RuleValue*)realloc(s_variableValues,
+                               s_variableSymbols.capacity * sizeof(MCP_RuleValue));
+    if (newValues == NULL) {
+        s_variableSymbols.capacity = oldCapacity;
+        return -2;  // Memory allocation failed
+    }
+    s_variableValues = newValues;
+    
+    SampleWindow** newWindows = (SampleWindow**)realloc(s_variableWindows,
+                                s_variableSymbols.capacity * sizeof(SampleWindow*));
+    if (newWindows == NULL) {
+        s_variableSymbols.capacity = oldCapacity;
+        return -2;  // Memory allocation failed
+    }
+    s_variableWindows = newWindows;
+    
+    return 0;
+}
+
+// Find a variable slot, creating an empty one if it does not exist yet
+static int resolveVariableSlot(const char* name, uint32_t hash) {
+    int slot = symbolFind(&s_variableSymbols, name, hash);
+    if (slot >= 0) {
+        return slot;
+    }
+    
+    if (reserveVariables(s_variableSymbols.count + 1) != 0) {
+        return -2;  // Memory allocation failed
+    }
+    
+    slot = symbolAdd(&s_variableSymbols, name, hash);
+    if (slot < 0) {
+        return -3;  // Memory allocation failed
+    }
+    s_variableValues[slot].type = MCP_RULE_VALUE_NULL;
+    s_variableWindows[slot] = NULL;
+    
+    return slot;
+}
+
+// Find a function slot, creating an unbound one if it does not exist yet
+static int resolveFunctionSlot(const char* name, uint32_t hash) {
+    int slot = symbolFind(&s_functionSymbols, name, hash);
+    if (slot >= 0) {
+        return slot;
+    }
+    
+    if (s_functionSymbols.count >= s_functionSymbols.capacity) {
+        int oldCapacity = s_functionSymbols.capacity;
+        if (symbolReserve(&s_functionSymbols, s_functionSymbols.count + 1) != 0) {
+            return -2;  // Memory allocation failed
+        }
+        
+        MCP_RuleFunctionHandler* newHandlers = (MCP_RuleFunctionHandler*)realloc(s_functionHandlers,
+                                               s_functionSymbols.capacity * sizeof(MCP_RuleFunctionHandler));
+        if (newHandlers == NULL) {
+            s_functionSymbols.capacity = oldCapacity;
+            return -2;  // Memory allocation failed
+        }
+        s_functionHandlers = newHandlers;
+    }
+    
+    slot = symbolAdd(&s_functionSymbols, name, hash);
+    if (slot < 0) {
         return -3;  // Memory allocation failed
     }
+    s_functionHandlers[slot] = NULL;
     
-    newVar->value = value;
+    return slot;
+}
+
+static bool valuesEqual(const MCP_RuleValue* a, const MCP_RuleValue* b) {
+    if (a->type != b->type) {
+        return false;
+    }
     
-    // Add to linked list
-    newVar->next = s_variables;
-    s_variables = newVar;
+    switch (a->type) {
+        case MCP_RULE_VALUE_NUMBER:
+            return a->value.numberValue == b->value.numberValue;
+            
+        case MCP_RULE_VALUE_STRING:
+            return strcmp(a->value.stringValue, b->value.stringValue) == 0;
+            
+        case MCP_RULE_VALUE_BOOL:
+            return a->value.boolValue == b->value.boolValue;
+            
+        default:
+            return true;
+    }
+}
+
+// ===== Sample windows =====
+
+// Recompute the running sums from the ring to bound floating point drift
+static void windowRefreshSums(SampleWindow* w) {
+    uint16_t index = (uint16_t)((w->position + w->size - w->count) % w->size);
     
-    return 0;
+    w->sum = 0;
+    w->weightedSum = 0;
+    for (uint16_t i = 0; i < w->count; i++) {
+        w->sum += w->samples[index];
+        w->weightedSum += (double)i * w->samples[index];
+        index = (uint16_t)((index + 1) % w->size);
+    }
+    w->sinceRefresh = 0;
 }
 
-int MCP_RuleRegisterFunction(const char* name, MCP_RuleFunctionHandler handler) {
-    if (!s_initialized || name == NULL || handler == NULL) {
+static void windowPush(SampleWindow* w, double sample) {
+    uint32_t sequence = w->sequence++;
+    
+    if (w->count == w->size) {
+        // Evict the oldest sample; the remaining ones move down one index
+        double oldest = w->samples[w->position];
+        w->weightedSum -= w->sum - oldest;
+        w->sum -= oldest;
+        w->count--;
+        
+        for (uint8_t i = 0; i < w->thresholdCount; i++) {
+            if (oldest > w->thresholds[i]) {
+                w->aboveCounts[i]--;
+            }
+        }
+        if (w->minCount > 0 && w->minQueue[w->minHead].sequence == sequence - w->size) {
+            w->minHead = (uint16_t)((w->minHead + 1) % w->size);
+            w->minCount--;
+        }
+        if (w->maxCount > 0 && w->maxQueue[w->maxHead].sequence == sequence - w->size) {
+            w->maxHead = (uint16_t)((w->maxHead + 1) % w->size);
+            w->maxCount--;
+        }
+    }
+    
+    w->samples[w->position] = sample;
+    w->position = (uint16_t)((w->position + 1) % w->size);
+    w->weightedSum += (double)w->count * sample;
+    w->sum += sample;
+    w->count++;
+    
+    for (uint8_t i = 0; i < w->thresholdCount; i++) {
+        if (sample > w->thresholds[i]) {
+            w->aboveCounts[i]++;
+        }
+    }
+    
+    // Samples dominated by the new one can never be the extreme again
+    while (w->minCount > 0 && w->minQueue[(w->minHead + w->minCount - 1) % w->size].value >= sample) {
+        w->minCount--;
+    }
+    w->minQueue[(w->minHead + w->minCount) % w->size].sequence = sequence;
+    w->minQueue[(w->minHead + w->minCount) % w->size].value = sample;
+    w->minCount++;
+    
+    while (w->maxCount > 0 && w->maxQueue[(w->maxHead + w->maxCount - 1) % w->size].value <= sample) {
+        w->maxCount--;
+    }
+    w->maxQueue[(w->maxHead + w->maxCount) % w->size].sequence = sequence;
+    w->maxQueue[(w->maxHead + w->maxCount) % w->size].value = sample;
+    w->maxCount++;
+    
+    if (++w->sinceRefresh >= w->size) {
+        windowRefreshSums(w);
+    }
+}
+
+static uint16_t windowCountAbove(const SampleWindow* w, double threshold) {
+    uint16_t above = 0;
+    for (uint16_t i = 0; i < w->count; i++) {
+        if (w->samples[(w->position + w->size - 1 - i) % w->size] > threshold) {
+            above++;
+        }
+    }
+    return above;
+}
+
+// Thresholds are tracked from their first use; beyond the tracked ones the window is scanned
+static uint16_t windowAbove(SampleWindow* w, double threshold) {
+    for (uint8_t i = 0; i < w->thresholdCount; i++) {
+        if (w->thresholds[i] == threshold) {
+            return w->aboveCounts[i];
+        }
+    }
+    
+    uint16_t above = windowCountAbove(w, threshold);
+    if (w->thresholdCount < RULE_WINDOW_THRESHOLDS) {
+        w->thresholds[w->thresholdCount] = threshold;
+        w->aboveCounts[w->thresholdCount] = above;
+        w->thresholdCount++;
+    }
+    return above;
+}
+
+static MCP_RuleValue windowAggregate(int slot, uint8_t aggregate, const MCP_RuleValue* argument) {
+    SampleWindow* w = s_variableWindows[slot];
+    MCP_RuleValue result;
+    result.type = MCP_RULE_VALUE_NULL;
+    
+    if (w == NULL || w->count == 0) {
+        return result;
+    }
+    
+    switch (aggregate) {
+        case RULE_WINDOW_AVG:
+            return MCP_RuleCreateNumberValue(w->sum / w->count);
+            
+        case RULE_WINDOW_MIN:
+            return MCP_RuleCreateNumberValue(w->minQueue[w->minHead].value);
+            
+        case RULE_WINDOW_MAX:
+            return MCP_RuleCreateNumberValue(w->maxQueue[w->maxHead].value);
+            
+        case RULE_WINDOW_SLOPE: {
+            // Least-squares slope per sample, closed-form sums of the indices
+            double n = w->count;
+            double sumX = n * (n - 1) / 2;
+            double sumXX = (n - 1) * n * (2 * n - 1) / 6;
+            double denominator = n * sumXX - sumX * sumX;
+            return MCP_RuleCreateNumberValue(denominator > 0 ? (n * w->weightedSum - sumX * w->sum) / denominator : 0);
+        }
+            
+        case RULE_WINDOW_COUNT_ABOVE:
+            if (argument->type != MCP_RULE_VALUE_NUMBER) {
+                return result;
+            }
+            return MCP_RuleCreateNumberValue(windowAbove(w, argument->value.numberValue));
+            
+        default:
+            return result;
+    }
+}
+
+static void freeWindow(SampleWindow* w) {
+    if (w != NULL) {
+        free(w->samples);
+        free(w->minQueue);
+        free(w->maxQueue);
+        free(w);
+    }
+}
+
+int MCP_RuleSetSampleWindow(const char* name, uint16_t size) {
+    if (!s_initialized || name == NULL) {
         return -1;
     }
     
-    // Check if function already exists
-    Function* existingFunc = findFunction(name);
-    if (existingFunc != NULL) {
-        // Update existing function
-        existingFunc->handler = handler;
+    int slot = resolveVariableSlot(name, hashName(name));
+    if (slot < 0) {
+        return slot;  // Memory allocation failed
+    }
+    
+    freeWindow(s_variableWindows[slot]);
+    s_variableWindows[slot] = NULL;
+    if (size == 0) {
         return 0;
     }
     
-    // Create new function
-    Function* newFunc = (Function*)malloc(sizeof(Function));
-    if (newFunc == NULL) {
+    SampleWindow* w = (SampleWindow*)calloc(1, sizeof(SampleWindow));
+    if (w != NULL) {
+        w->samples = (double*)malloc(size * sizeof(double));
+        w->minQueue = (WindowExtreme*)malloc(size * sizeof(WindowExtreme));
+        w->maxQueue = (WindowExtreme*)malloc(size * sizeof(WindowExtreme));
+    }
+    if (w == NULL || w->samples == NULL || w->minQueue == NULL || w->maxQueue == NULL) {
+        freeWindow(w);
         return -2;  // Memory allocation failed
     }
+    w->size = size;
     
-    newFunc->name = strdup(name);
-    if (newFunc->name == NULL) {
-        free(newFunc);
-        return -3;  // Memory allocation failed
+    s_variableWindows[slot] = w;
+    return 0;
+}
+
+// Replace a variable value and notify the change listener if it differs;
+// a numeric value is also a new sample for the variable's window
+static void storeVariable(int slot, MCP_RuleValue value) {
+    bool changed = !valuesEqual(&s_variableValues[slot], &value);
+    
+    if (s_variableWindows[slot] != NULL && value.type == MCP_RULE_VALUE_NUMBER) {
+        windowPush(s_variableWindows[slot], value.value.numberValue);
+        changed = true;  // Aggregates move even when the value repeats
+    }
+    
+    MCP_RuleFreeValue(s_variableValues[slot]);
+    s_variableValues[slot] = value;
+    
+    if (changed && s_changeListener != NULL) {
+        s_changeListener(slot, s_changeListenerData);
+    }
+}
+
+int MCP_RulePushSamples(int handle, const double* samples, int count) {
+    if (!s_initialized || handle < 0 || handle >= s_variableSymbols.count || samples == NULL || count <= 0) {
+        return -1;
+    }
+    
+    SampleWindow* w = s_variableWindows[handle];
+    if (w == NULL) {
+        return -2;  // No window on this variable
+    }
+    
+    // All but the last sample go straight into the window; the last one
+    // becomes the variable value, with a single change notification
+    for (int i = 0; i < count - 1; i++) {
+        windowPush(w, samples[i]);
+    }
+    storeVariable(handle, MCP_RuleCreateNumberValue(samples[count - 1]));
+    
+    return 0;
+}
+
+int MCP_RuleRegisterVariable(const char* name, MCP_RuleValue value) {
+    if (!s_initialized || name == NULL) {
+        return -1;
+    }
+    
+    int slot = resolveVariableSlot(name, hashName(name));
+    if (slot < 0) {
+        return slot;  // Memory allocation failed
+    }
+    
+    // Replace the previous value (if any)
+    storeVariable(slot, value);
+    
+    return 0;
+}
+
+int MCP_RuleGetVariableHandle(const char* name) {
+    if (!s_initialized || name == NULL) {
+        return -1;
+    }
+    
+    return resolveVariableSlot(name, hashName(name));
+}
+
+int MCP_RuleSetVariableByHandle(int handle, MCP_RuleValue value) {
+    if (!s_initialized || handle < 0 || handle >= s_variableSymbols.count) {
+        return -1;
+    }
+    
+    storeVariable(handle, value);
+    
+    return 0;
+}
+
+int MCP_RuleUpdateVariables(const MCP_RuleVariableUpdate* updates, int count) {
+    if (!s_initialized || updates == NULL || count < 0) {
+        return -1;
+    }
+    
+    // Reserve once for the whole batch instead of growing per new name
+    if (reserveVariables(s_variableSymbols.count + count) != 0) {
+        return -2;  // Memory allocation failed
+    }
+    
+    int updated = 0;
+    for (int i = 0; i < count; i++) {
+        if (updates[i].name == NULL) {
+            continue;
+        }
+        
+        int slot = resolveVariableSlot(updates[i].name, hashName(updates[i].name));
+        if (slot < 0) {
+            break;
+        }
+        
+        storeVariable(slot, updates[i].value);
+        updated++;
+    }
+    
+    return updated;
+}
+
+int MCP_RuleSetChangeListener(MCP_RuleChangeListener listener, void* userData) {
+    if (!s_initialized) {
+        return -1;
+    }
+    
+    s_changeListener = listener;
+    s_changeListenerData = userData;
+    
+    return 0;
+}
+
+int MCP_RuleRegisterFunction(const char* name, MCP_RuleFunctionHandler handler) {
+    if (!s_initialized || name == NULL || handler == NULL) {
+        return -1;
+    }
+    
+    // Window aggregate names are reserved for the built-in instructions
+    for (int i = 0; i < RULE_WINDOW_AGGREGATE_COUNT; i++) {
+        if (strcmp(name, s_windowAggregateNames[i]) == 0) {
+            return -3;
+        }
     }
     
-    newFunc->handler = handler;
+    int slot = resolveFunctionSlot(name, hashName(name));
+    if (slot < 0) {
+        return slot;  // Memory allocation failed
+    }
     
-    // Add to linked list
-    newFunc->next = s_functions;
-    s_functions = newFunc;
+    s_functionHandlers[slot] = handler;
     
     return 0;
 }
@@ -185,12 +682,37 @@ int MCP_RuleRegisterFunction(const char* name, MCP_RuleFunctionHandler handler)
 static void initTokenizer(TokenizerContext* ctx, const char* input) {
     ctx->input = input;
     ctx->position = 0;
+    ctx->current.type = MCP_TOKEN_TYPE_END;
+    ctx->error = false;
+}
+
+// Release memory owned by the current token
+static void releaseToken(MCP_Token* token) {
+    switch (token->type) {
+        case MCP_TOKEN_TYPE_STRING:
+            free(token->value.stringValue);
+            break;
+            
+        case MCP_TOKEN_TYPE_VARIABLE:
+            free(token->value.variableName);
+            break;
+            
+        case MCP_TOKEN_TYPE_FUNCTION:
+            free(token->value.functionName);
+            break;
+            
+        default:
+            break;
+    }
+    token->type = MCP_TOKEN_TYPE_END;
 }
 
 static void getNextToken(TokenizerContext* ctx) {
     const char* input = ctx->input;
     size_t pos = ctx->position;
     
+    releaseToken(&ctx->current);
+    
     // Skip whitespace
     while (input[pos] != '\0' && isspace(input[pos])) {
         pos++;
@@ -241,12 +763,14 @@ static void getNextToken(TokenizerContext* ctx) {
             } else {
                 // Memory allocation failed
                 ctx->current.type = MCP_TOKEN_TYPE_END;
+                ctx->error = true;
             }
             
             pos++;  // Skip closing quote
         } else {
             // Unterminated string
             ctx->current.type = MCP_TOKEN_TYPE_END;
+            ctx->error = true;
         }
         
         ctx->position = pos;
@@ -293,6 +817,7 @@ static void getNextToken(TokenizerContext* ctx) {
                 } else {
                     // Memory allocation failed
                     ctx->current.type = MCP_TOKEN_TYPE_END;
+                    ctx->error = true;
                 }
             } else {
                 // It's a variable
@@ -306,6 +831,7 @@ static void getNextToken(TokenizerContext* ctx) {
                 } else {
                     // Memory allocation failed
                     ctx->current.type = MCP_TOKEN_TYPE_END;
+                    ctx->error = true;
                 }
             }
         }
@@ -396,6 +922,7 @@ static void getNextToken(TokenizerContext* ctx) {
             default:
                 // Unknown operator
                 ctx->current.type = MCP_TOKEN_TYPE_END;
+                ctx->error = true;
                 break;
         }
         
@@ -420,239 +947,1020 @@ static void getNextToken(TokenizerContext* ctx) {
     
     // Unknown token
     ctx->current.type = MCP_TOKEN_TYPE_END;
+    ctx->error = true;
     ctx->position = pos + 1;
 }
 
-// Helper function to resolve variable values
-static MCP_RuleValue resolveVariable(const char* name) {
-    Variable* var = findVariable(name);
-    if (var != NULL) {
-        // Return a copy of the value
-        switch (var->value.type) {
-            case MCP_RULE_VALUE_NUMBER:
-                return MCP_RuleCreateNumberValue(var->value.value.numberValue);
-                
-            case MCP_RULE_VALUE_STRING:
-                return MCP_RuleCreateStringValue(var->value.value.stringValue);
-                
-            case MCP_RULE_VALUE_BOOL:
-                return MCP_RuleCreateBoolValue(var->value.value.boolValue);
-                
-            case MCP_RULE_VALUE_NULL:
-                // Fall through to default
-                break;
-        }
-    }
-    
-    // Variable not found or null value
-    return (MCP_RuleValue){ .type = MCP_RULE_VALUE_NULL };
-}
+// ===== Compiler =====
 
-// Helper function to handle function calls
-static MCP_RuleValue callFunction(const char* name, TokenizerContext* ctx) {
-    Function* func = findFunction(name);
-    if (func == NULL) {
-        // Function not found
-        return (MCP_RuleValue){ .type = MCP_RULE_VALUE_NULL };
-    }
-    
-    // Parse arguments
-    MCP_RuleValue params[10];  // Maximum 10 parameters for simplicity
-    int paramCount = 0;
-    
-    getNextToken(ctx);  // Consume opening parenthesis
-    
-    if (ctx->current.type != MCP_TOKEN_TYPE_PARENTHESIS_CLOSE) {
-        // Parse first parameter
-        params[paramCount++] = MCP_RuleEvaluate(ctx->input + ctx->position);
-        
-        // Parse additional parameters
-        while (ctx->current.type == MCP_TOKEN_TYPE_COMMA && paramCount < 10) {
-            getNextToken(ctx);  // Consume comma
-            params[paramCount++] = MCP_RuleEvaluate(ctx->input + ctx->position);
-        }
+// Compiler context
+typedef struct {
+    TokenizerContext tok;
+    RuleInstruction* code;
+    uint16_t codeLength;
+    uint16_t codeCapacity;
+    MCP_RuleValue* constants;
+    uint16_t constantCount;
+    uint16_t constantCapacity;
+    int depth;
+    int maxDepth;
+    bool error;
+} CompilerContext;
+
+// Append an instruction and track the resulting stack depth
+static int emit(CompilerContext* c, RuleOpcode opcode, uint8_t argc, uint16_t operand, int stackEffect) {
+    if (c->error) {
+        return -1;
     }
     
-    if (ctx->current.type != MCP_TOKEN_TYPE_PARENTHESIS_CLOSE) {
-        // Invalid syntax
-        for (int i = 0; i < paramCount; i++) {
-            MCP_RuleFreeValue(params[i]);
+    if (c->codeLength >= c->codeCapacity) {
+        uint16_t newCapacity = c->codeCapacity == 0 ? 16 : c->codeCapacity * 2;
+        RuleInstruction* newCode = (RuleInstruction*)realloc(c->code, newCapacity * sizeof(RuleInstruction));
+        if (newCode == NULL) {
+            c->error = true;
+            return -1;
         }
-        return (MCP_RuleValue){ .type = MCP_RULE_VALUE_NULL };
+        c->code = newCode;
+        c->codeCapacity = newCapacity;
     }
     
-    getNextToken(ctx);  // Consume closing parenthesis
-    
-    // Call function handler
-    MCP_RuleValue result = func->handler(params, paramCount);
+    c->code[c->codeLength].opcode = (uint8_t)opcode;
+    c->code[c->codeLength].argc = argc;
+    c->code[c->codeLength].operand = operand;
     
-    // Free parameter values
-    for (int i = 0; i < paramCount; i++) {
-        MCP_RuleFreeValue(params[i]);
+    c->depth += stackEffect;
+    if (c->depth > c->maxDepth) {
+        c->maxDepth = c->depth;
+    }
+    if (c->maxDepth > RULE_MAX_STACK) {
+        c->error = true;  // Expression too deep
+        return -1;
     }
     
-    return result;
+    return c->codeLength++;
 }
 
-// Recursive descent parser
-static MCP_RuleValue parseExpression(TokenizerContext* ctx);
-static MCP_RuleValue parseTerm(TokenizerContext* ctx);
-static MCP_RuleValue parseFactor(TokenizerContext* ctx);
-
-static MCP_RuleValue parseExpression(TokenizerContext* ctx) {
-    MCP_RuleValue left = parseTerm(ctx);
-    
-    while (ctx->current.type == MCP_TOKEN_TYPE_OPERATOR) {
-        MCP_RuleOperator op = ctx->current.value.operatorType;
-        
-        if (getOperatorPrecedence(op) < getOperatorPrecedence(MCP_RULE_OP_MULTIPLY)) {
-            getNextToken(ctx);
-            MCP_RuleValue right = parseTerm(ctx);
-            
-            // Apply operator
-            // This is a simplified implementation
-            // In a real implementation, you'd handle different types and operations
-            
-            // For now, just handle numeric values
-            if (left.type == MCP_RULE_VALUE_NUMBER && right.type == MCP_RULE_VALUE_NUMBER) {
-                switch (op) {
-                    case MCP_RULE_OP_ADD:
-                        left.value.numberValue += right.value.numberValue;
-                        break;
-                        
-                    case MCP_RULE_OP_SUBTRACT:
-                        left.value.numberValue -= right.value.numberValue;
-                        break;
-                        
-                    default:
-                        // Unsupported operator
-                        break;
-                }
-            }
-            
-            MCP_RuleFreeValue(right);
-        } else {
-            break;
+// Add a constant (takes ownership of string values) and emit a push
+static void emitConstant(CompilerContext* c, MCP_RuleValue value) {
+    if (c->error) {
+        MCP_RuleFreeValue(value);
+        return;
+    }
+    
+    if (c->constantCount >= c->constantCapacity) {
+        uint16_t newCapacity = c->constantCapacity == 0 ? 4 : c->constantCapacity * 2;
+        MCP_RuleValue* newConstants = (MCP_RuleValue*)realloc(c->constants, newCapacity * sizeof(MCP_RuleValue));
+        if (newConstants == NULL) {
+            MCP_RuleFreeValue(value);
+            c->error = true;
+            return;
         }
+        c->constants = newConstants;
+        c->constantCapacity = newCapacity;
     }
     
-    return left;
-}
-
-static MCP_RuleValue parseTerm(TokenizerContext* ctx) {
-    MCP_RuleValue left = parseFactor(ctx);
-    
-    while (ctx->current.type == MCP_TOKEN_TYPE_OPERATOR) {
-        MCP_RuleOperator op = ctx->current.value.operatorType;
-        
-        if (getOperatorPrecedence(op) == getOperatorPrecedence(MCP_RULE_OP_MULTIPLY)) {
-            getNextToken(ctx);
-            MCP_RuleValue right = parseFactor(ctx);
-            
-            // Apply operator
-            // This is a simplified implementation
-            // In a real implementation, you'd handle different types and operations
-            
-            // For now, just handle numeric values
-            if (left.type == MCP_RULE_VALUE_NUMBER && right.type == MCP_RULE_VALUE_NUMBER) {
-                switch (op) {
-                    case MCP_RULE_OP_MULTIPLY:
-                        left.value.numberValue *= right.value.numberValue;
-                        break;
-                        
-                    case MCP_RULE_OP_DIVIDE:
-                        if (right.value.numberValue != 0) {
-                            left.value.numberValue /= right.value.numberValue;
-                        } else {
-                            // Division by zero
-                            left.type = MCP_RULE_VALUE_NULL;
-                        }
-                        break;
-                        
-                    case MCP_RULE_OP_MODULO:
-                        if (right.value.numberValue != 0) {
-                            left.value.numberValue = fmod(left.value.numberValue, right.value.numberValue);
-                        } else {
-                            // Division by zero
-                            left.type = MCP_RULE_VALUE_NULL;
-                        }
-                        break;
-                        
-                    default:
-                        // Unsupported operator
-                        break;
-                }
+    c->constants[c->constantCount] = value;
+    emit(c, RULE_OP_PUSH_CONST, 0, c->constantCount, 1);
+    c->constantCount++;
+}
+
+static void compileExpression(CompilerContext* c, int minPrecedence);
+
+// aggregate(variable) or count_above(variable, threshold) over the variable's sample window
+static void compileWindowAggregate(CompilerContext* c, RuleWindowAggregate aggregate) {
+    getNextToken(&c->tok);  // Consume function name
+    if (c->tok.current.type != MCP_TOKEN_TYPE_PARENTHESIS_OPEN) {
+        c->error = true;
+        return;
+    }
+    getNextToken(&c->tok);  // Consume opening parenthesis
+    
+    if (c->tok.current.type != MCP_TOKEN_TYPE_VARIABLE) {
+        c->error = true;  // The window belongs to a variable, not to a value
+        return;
+    }
+    const char* variable = c->tok.current.value.variableName;
+    int slot = resolveVariableSlot(variable, hashName(variable));
+    if (slot < 0) {
+        c->error = true;
+        return;
+    }
+    getNextToken(&c->tok);  // Consume variable
+    
+    int stackEffect = 1;
+    if (aggregate == RULE_WINDOW_COUNT_ABOVE) {
+        if (c->tok.current.type != MCP_TOKEN_TYPE_COMMA) {
+            c->error = true;
+            return;
+        }
+        getNextToken(&c->tok);  // Consume comma
+        compileExpression(c, 0);
+        stackEffect = 0;  // Replaces the threshold
+    }
+    
+    if (c->tok.current.type != MCP_TOKEN_TYPE_PARENTHESIS_CLOSE) {
+        c->error = true;
+        return;
+    }
+    getNextToken(&c->tok);  // Consume closing parenthesis
+    
+    emit(c, RULE_OP_WINDOW, (uint8_t)aggregate, (uint16_t)slot, stackEffect);
+}
+
+static void compileCall(CompilerContext* c) {
+    const char* name = c->tok.current.value.functionName;
+    
+    uint32_t hash = hashName(name);
+    
+    // Window aggregates are built in and compile to a single instruction;
+    // their names cannot be registered as functions
+    for (int i = 0; i < RULE_WINDOW_AGGREGATE_COUNT; i++) {
+        if (strcmp(name, s_windowAggregateNames[i]) == 0) {
+            compileWindowAggregate(c, (RuleWindowAggregate)i);
+            return;
+        }
+    }
+    
+    int slot = resolveFunctionSlot(name, hash);
+    if (slot < 0) {
+        c->error = true;
+        return;
+    }
+    
+    getNextToken(&c->tok);  // Consume function name
+    if (c->tok.current.type != MCP_TOKEN_TYPE_PARENTHESIS_OPEN) {
+        c->error = true;
+        return;
+    }
+    getNextToken(&c->tok);  // Consume opening parenthesis
+    
+    int paramCount = 0;
+    if (c->tok.current.type != MCP_TOKEN_TYPE_PARENTHESIS_CLOSE) {
+        for (;;) {
+            if (paramCount >= RULE_MAX_PARAMS) {
+                c->error = true;
+                return;
             }
+            compileExpression(c, 0);
+            paramCount++;
             
-            MCP_RuleFreeValue(right);
-        } else {
-            break;
+            if (c->tok.current.type != MCP_TOKEN_TYPE_COMMA) {
+                break;
+            }
+            getNextToken(&c->tok);  // Consume comma
         }
     }
     
-    return left;
+    if (c->tok.current.type != MCP_TOKEN_TYPE_PARENTHESIS_CLOSE) {
+        c->error = true;
+        return;
+    }
+    getNextToken(&c->tok);  // Consume closing parenthesis
+    
+    emit(c, RULE_OP_CALL, (uint8_t)paramCount, (uint16_t)slot, 1 - paramCount);
 }
 
-static MCP_RuleValue parseFactor(TokenizerContext* ctx) {
-    MCP_RuleValue result;
+static void compileUnary(CompilerContext* c) {
+    MCP_Token* token = &c->tok.current;
     
-    switch (ctx->current.type) {
+    switch (token->type) {
         case MCP_TOKEN_TYPE_NUMBER:
-            result = MCP_RuleCreateNumberValue(ctx->current.value.numberValue);
-            getNextToken(ctx);
+            emitConstant(c, MCP_RuleCreateNumberValue(token->value.numberValue));
+            getNextToken(&c->tok);
             break;
             
-        case MCP_TOKEN_TYPE_STRING:
-            result = MCP_RuleCreateStringValue(ctx->current.value.stringValue);
-            getNextToken(ctx);
+        case MCP_TOKEN_TYPE_STRING: {
+            // Move the token string into the constant pool
+            MCP_RuleValue value;
+            value.type = MCP_RULE_VALUE_STRING;
+            value.value.stringValue = token->value.stringValue;
+            token->type = MCP_TOKEN_TYPE_END;
+            emitConstant(c, value);
+            getNextToken(&c->tok);
             break;
+        }
             
         case MCP_TOKEN_TYPE_BOOL:
-            result = MCP_RuleCreateBoolValue(ctx->current.value.boolValue);
-            getNextToken(ctx);
+            emitConstant(c, MCP_RuleCreateBoolValue(token->value.boolValue));
+            getNextToken(&c->tok);
             break;
             
-        case MCP_TOKEN_TYPE_VARIABLE:
-            result = resolveVariable(ctx->current.value.variableName);
-            getNextToken(ctx);
+        case MCP_TOKEN_TYPE_VARIABLE: {
+            int slot = resolveVariableSlot(token->value.variableName, hashName(token->value.variableName));
+            if (slot < 0) {
+                c->error = true;
+                return;
+            }
+            emit(c, RULE_OP_LOAD_VAR, 0, (uint16_t)slot, 1);
+            getNextToken(&c->tok);
             break;
+        }
             
         case MCP_TOKEN_TYPE_FUNCTION:
-            result = callFunction(ctx->current.value.functionName, ctx);
+            compileCall(c);
             break;
             
         case MCP_TOKEN_TYPE_PARENTHESIS_OPEN:
-            getNextToken(ctx);
-            result = parseExpression(ctx);
+            getNextToken(&c->tok);
+            compileExpression(c, 0);
             
-            if (ctx->current.type != MCP_TOKEN_TYPE_PARENTHESIS_CLOSE) {
+            if (c->tok.current.type != MCP_TOKEN_TYPE_PARENTHESIS_CLOSE) {
                 // Missing closing parenthesis
-                MCP_RuleFreeValue(result);
-                result.type = MCP_RULE_VALUE_NULL;
+                c->error = true;
+                return;
+            }
+            getNextToken(&c->tok);
+            break;
+            
+        case MCP_TOKEN_TYPE_OPERATOR:
+            if (token->value.operatorType == MCP_RULE_OP_NOT) {
+                getNextToken(&c->tok);
+                compileUnary(c);
+                emit(c, RULE_OP_NOT, 0, 0, 0);
+            } else if (token->value.operatorType == MCP_RULE_OP_SUBTRACT) {
+                getNextToken(&c->tok);
+                compileUnary(c);
+                
+                // Fold negative numeric literals
+                RuleInstruction* last = c->codeLength > 0 ? &c->code[c->codeLength - 1] : NULL;
+                if (!c->error && last != NULL && last->opcode == RULE_OP_PUSH_CONST &&
+                    last->operand == c->constantCount - 1 &&
+                    c->constants[last->operand].type == MCP_RULE_VALUE_NUMBER) {
+                    c->constants[last->operand].value.numberValue = -c->constants[last->operand].value.numberValue;
+                } else {
+                    emit(c, RULE_OP_NEGATE, 0, 0, 0);
+                }
             } else {
-                getNextToken(ctx);
+                c->error = true;
             }
             break;
             
         default:
             // Invalid token
-            result.type = MCP_RULE_VALUE_NULL;
+            c->error = true;
             break;
     }
+}
+
+// Precedence climbing over the operator table used by getOperatorPrecedence
+static void compileExpression(CompilerContext* c, int minPrecedence) {
+    compileUnary(c);
     
-    return result;
+    while (!c->error && c->tok.current.type == MCP_TOKEN_TYPE_OPERATOR) {
+        MCP_RuleOperator op = c->tok.current.value.operatorType;
+        int precedence = getOperatorPrecedence(op);
+        
+        if (op == MCP_RULE_OP_NOT || precedence < minPrecedence) {
+            break;
+        }
+        
+        getNextToken(&c->tok);
+        
+        if (op == MCP_RULE_OP_AND || op == MCP_RULE_OP_OR) {
+            // Short-circuit: the jump keeps the left value when it decides the result
+            int jump = emit(c, op == MCP_RULE_OP_AND ? RULE_OP_AND_JUMP : RULE_OP_OR_JUMP, 0, 0, -1);
+            compileExpression(c, precedence + 1);
+            emit(c, RULE_OP_TO_BOOL, 0, 0, 0);
+            if (!c->error) {
+                c->code[jump].operand = c->codeLength;
+            }
+        } else {
+            compileExpression(c, precedence + 1);
+            emit(c, RULE_OP_BINARY, (uint8_t)op, 0, -1);
+        }
+    }
 }
 
-MCP_RuleValue MCP_RuleEvaluate(const char* expression) {
+MCP_RuleProgram* MCP_RuleCompile(const char* expression) {
     if (!s_initialized || expression == NULL) {
-        return (MCP_RuleValue){ .type = MCP_RULE_VALUE_NULL };
+        return NULL;
+    }
+    
+    CompilerContext c;
+    memset(&c, 0, sizeof(c));
+    initTokenizer(&c.tok, expression);
+    
+    getNextToken(&c.tok);
+    compileExpression(&c, 0);
+    
+    // The whole input must be consumed
+    if (c.tok.error || c.tok.current.type != MCP_TOKEN_TYPE_END || c.depth != 1) {
+        c.error = true;
+    }
+    releaseToken(&c.tok.current);
+    
+    MCP_RuleProgram* program = NULL;
+    if (!c.error) {
+        program = (MCP_RuleProgram*)malloc(sizeof(MCP_RuleProgram));
+    }
+    
+    if (program == NULL) {
+        for (uint16_t i = 0; i < c.constantCount; i++) {
+            MCP_RuleFreeValue(c.constants[i]);
+        }
+        free(c.constants);
+        free(c.code);
+        return NULL;
+    }
+    
+    program->code = c.code;
+    program->codeLength = c.codeLength;
+    program->constants = c.constants;
+    program->constantCount = c.constantCount;
+    program->maxStack = (uint16_t)c.maxDepth;
+    
+    return program;
+}
+
+void MCP_RuleFreeProgram(MCP_RuleProgram* program) {
+    if (program == NULL) {
+        return;
+    }
+    
+    for (uint16_t i = 0; i < program->constantCount; i++) {
+        MCP_RuleFreeValue(program->constants[i]);
+    }
+    free(program->constants);
+    free(program->code);
+    free(program);
+}
+
+int MCP_RuleProgramGetVariables(const MCP_RuleProgram* program, int* handles, int maxHandles) {
+    if (program == NULL || handles == NULL || maxHandles < 0) {
+        return -1;
+    }
+    
+    int count = 0;
+    for (uint16_t pc = 0; pc < program->codeLength; pc++) {
+        if (program->code[pc].opcode != RULE_OP_LOAD_VAR && program->code[pc].opcode != RULE_OP_WINDOW) {
+            continue;
+        }
+        
+        int handle = program->code[pc].operand;
+        bool seen = false;
+        for (int i = 0; i < count && i < maxHandles; i++) {
+            if (handles[i] == handle) {
+                seen = true;
+                break;
+            }
+        }
+        
+        if (!seen) {
+            if (count < maxHandles) {
+                handles[count] = handle;
+            }
+            count++;
+        }
+    }
+    
+    return count;
+}
+
+// ===== Program serialization =====
+//
+// Layout (little-endian):
+//   u16 codeLength, u16 constantCount, u16 maxStack, u16 nameCount
+//   code:      u8 opcode, u8 argc, u16 operand
+//   constants: u8 type, then f64 (number), u8 (bool) or u16 length + bytes (string)
+//   names:     u8 kind (0 variable, 1 function), u16 length, bytes
+// Variable and function operands index the name list, so a program can be
+// loaded after a restart without re-parsing its source text.
+
+typedef struct {
+    uint8_t* buffer;        // NULL to measure only
+    size_t size;
+    size_t position;
+} ProgramWriter;
+
+static void putBytes(ProgramWriter* w, const void* data, size_t length) {
+    if (w->buffer != NULL && w->position + length <= w->size) {
+        memcpy(w->buffer + w->position, data, length);
+    }
+    w->position += length;
+}
+
+static void putU8(ProgramWriter* w, uint8_t value) {
+    putBytes(w, &value, 1);
+}
+
+static void putU16(ProgramWriter* w, uint16_t value) {
+    uint8_t bytes[2] = { (uint8_t)(value & 0xFF), (uint8_t)(value >> 8) };
+    putBytes(w, bytes, 2);
+}
+
+static void putF64(ProgramWriter* w, double value) {
+    uint64_t bits;
+    uint8_t bytes[8];
+    memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = (uint8_t)(bits >> (8 * i));
+    }
+    putBytes(w, bytes, 8);
+}
+
+static bool referencesSymbol(uint8_t opcode) {
+    return opcode == RULE_OP_LOAD_VAR || opcode == RULE_OP_CALL || opcode == RULE_OP_WINDOW;
+}
+
+int MCP_RuleProgramSerialize(const MCP_RuleProgram* program, uint8_t* buffer, size_t bufferSize) {
+    if (program == NULL) {
+        return -1;
+    }
+    
+    // Map symbol slots to a compact name list
+    uint16_t* names = NULL;
+    uint8_t* kinds = NULL;
+    uint16_t nameCount = 0;
+    if (program->codeLength > 0) {
+        names = (uint16_t*)malloc(program->codeLength * sizeof(uint16_t));
+        kinds = (uint8_t*)malloc(program->codeLength);
+        if (names == NULL || kinds == NULL) {
+            free(names);
+            free(kinds);
+            return -2;
+        }
+    }
+    
+    for (uint16_t pc = 0; pc < program->codeLength; pc++) {
+        const RuleInstruction* ins = &program->code[pc];
+        if (!referencesSymbol(ins->opcode)) {
+            continue;
+        }
+        
+        uint8_t kind = ins->opcode == RULE_OP_CALL ? 1 : 0;
+        uint16_t i;
+        for (i = 0; i < nameCount; i++) {
+            if (names[i] == ins->operand && kinds[i] == kind) {
+                break;
+            }
+        }
+        if (i == nameCount) {
+            names[nameCount] = ins->operand;
+            kinds[nameCount] = kind;
+            nameCount++;
+        }
+    }
+    
+    ProgramWriter w = { buffer, bufferSize, 0 };
+    putU16(&w, program->codeLength);
+    putU16(&w, program->constantCount);
+    putU16(&w, program->maxStack);
+    putU16(&w, nameCount);
+    
+    for (uint16_t pc = 0; pc < program->codeLength; pc++) {
+        const RuleInstruction* ins = &program->code[pc];
+        uint16_t operand = ins->operand;
+        
+        if (referencesSymbol(ins->opcode)) {
+            uint8_t kind = ins->opcode == RULE_OP_CALL ? 1 : 0;
+            for (uint16_t i = 0; i < nameCount; i++) {
+                if (names[i] == ins->operand && kinds[i] == kind) {
+                    operand = i;
+                    break;
+                }
+            }
+        }
+        
+        putU8(&w, ins->opcode);
+        putU8(&w, ins->argc);
+        putU16(&w, operand);
+    }
+    
+    for (uint16_t i = 0; i < program->constantCount; i++) {
+        const MCP_RuleValue* value = &program->constants[i];
+        putU8(&w, (uint8_t)value->type);
+        
+        if (value->type == MCP_RULE_VALUE_NUMBER) {
+            putF64(&w, value->value.numberValue);
+        } else if (value->type == MCP_RULE_VALUE_BOOL) {
+            putU8(&w, value->value.boolValue ? 1 : 0);
+        } else if (value->type == MCP_RULE_VALUE_STRING) {
+            size_t length = value->value.stringValue != NULL ? strlen(value->value.stringValue) : 0;
+            putU16(&w, (uint16_t)length);
+            putBytes(&w, value->value.stringValue, length);
+        }
+    }
+    
+    for (uint16_t i = 0; i < nameCount; i++) {
+        const Symbol* symbol = kinds[i] ? &s_functionSymbols.symbols[names[i]] : &s_variableSymbols.symbols[names[i]];
+        size_t length = strlen(symbol->name);
+        putU8(&w, kinds[i]);
+        putU16(&w, (uint16_t)length);
+        putBytes(&w, symbol->name, length);
+    }
+    
+    free(names);
+    free(kinds);
+    
+    if (buffer != NULL && w.position > bufferSize) {
+        return -3;  // Buffer too small
+    }
+    
+    return (int)w.position;
+}
+
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+    size_t position;
+    bool error;
+} ProgramReader;
+
+static const uint8_t* getBytes(ProgramReader* r, size_t length) {
+    if (r->error || r->position + length > r->size) {
+        r->error = true;
+        return NULL;
+    }
+    const uint8_t* bytes = r->data + r->position;
+    r->position += length;
+    return bytes;
+}
+
+static uint8_t getU8(ProgramReader* r) {
+    const uint8_t* bytes = getBytes(r, 1);
+    return bytes != NULL ? bytes[0] : 0;
+}
+
+static uint16_t getU16(ProgramReader* r) {
+    const uint8_t* bytes = getBytes(r, 2);
+    return bytes != NULL ? (uint16_t)(bytes[0] | (bytes[1] << 8)) : 0;
+}
+
+static double getF64(ProgramReader* r) {
+    const uint8_t* bytes = getBytes(r, 8);
+    uint64_t bits = 0;
+    double value = 0;
+    if (bytes != NULL) {
+        for (int i = 0; i < 8; i++) {
+            bits |= (uint64_t)bytes[i] << (8 * i);
+        }
+        memcpy(&value, &bits, sizeof(value));
+    }
+    return value;
+}
+
+// Check what the compiler guarantees for its own output: no instruction pops
+// more than the stack holds, the depth stays within maxStack, short-circuit
+// jumps go forward inside the code and meet the fall-through path at the same
+// depth, and exactly one value is left
+static bool verifyProgramStack(const MCP_RuleProgram* program) {
+    uint16_t codeLength = program->codeLength;
+    int8_t* depthAt = (int8_t*)malloc(codeLength + 1);  // Depth on arrival by jump, -1 if none
+    if (depthAt == NULL) {
+        return false;
+    }
+    memset(depthAt, -1, codeLength + 1);
+    
+    bool valid = true;
+    int depth = 0;
+    for (uint16_t pc = 0; pc < codeLength && valid; pc++) {
+        const RuleInstruction* ins = &program->code[pc];
+        if (depthAt[pc] >= 0 && depthAt[pc] != depth) {
+            valid = false;
+            break;
+        }
+        
+        int pops = 0;
+        int pushes = 0;
+        switch (ins->opcode) {
+            case RULE_OP_PUSH_CONST:
+            case RULE_OP_LOAD_VAR:
+                pushes = 1;
+                break;
+            case RULE_OP_CALL:
+                pops = ins->argc;
+                pushes = 1;
+                break;
+            case RULE_OP_BINARY:
+                pops = 2;
+                pushes = 1;
+                valid = ins->argc < MCP_RULE_OP_NOT;
+                break;
+            case RULE_OP_NOT:
+            case RULE_OP_NEGATE:
+            case RULE_OP_TO_BOOL:
+                pops = 1;
+                pushes = 1;
+                break;
+            case RULE_OP_AND_JUMP:
+            case RULE_OP_OR_JUMP:
+                // Taken: the value stays; not taken: it is popped
+                valid = depth >= 1 && ins->operand > pc && ins->operand <= codeLength &&
+                        (depthAt[ins->operand] < 0 || depthAt[ins->operand] == depth);
+                if (valid) {
+                    depthAt[ins->operand] = (int8_t)depth;
+                }
+                pops = 1;
+                break;
+            case RULE_OP_WINDOW:
+                pops = ins->argc == RULE_WINDOW_COUNT_ABOVE ? 1 : 0;
+                pushes = 1;
+                break;
+            default:
+                valid = false;
+                break;
+        }
+        
+        if (depth < pops) {
+            valid = false;
+        }
+        depth += pushes - pops;
+        if (depth > program->maxStack) {
+            valid = false;
+        }
+    }
+    
+    if (valid && (depth != 1 || (depthAt[codeLength] >= 0 && depthAt[codeLength] != depth))) {
+        valid = false;
+    }
+    
+    free(depthAt);
+    return valid;
+}
+
+MCP_RuleProgram* MCP_RuleProgramDeserialize(const uint8_t* data, size_t size, size_t* consumed) {
+    if (!s_initialized || data == NULL) {
+        return NULL;
+    }
+    
+    ProgramReader r = { data, size, 0, false };
+    uint16_t codeLength = getU16(&r);
+    uint16_t constantCount = getU16(&r);
+    uint16_t maxStack = getU16(&r);
+    uint16_t nameCount = getU16(&r);
+    
+    if (r.error || codeLength == 0 || maxStack == 0 || maxStack > RULE_MAX_STACK) {
+        return NULL;
+    }
+    
+    MCP_RuleProgram* program = (MCP_RuleProgram*)calloc(1, sizeof(MCP_RuleProgram));
+    if (program == NULL) {
+        return NULL;
+    }
+    program->code = (RuleInstruction*)malloc(codeLength * sizeof(RuleInstruction));
+    program->constants = constantCount > 0 ? (MCP_RuleValue*)calloc(constantCount, sizeof(MCP_RuleValue)) : NULL;
+    program->maxStack = maxStack;
+    if (program->code == NULL || (constantCount > 0 && program->constants == NULL)) {
+        MCP_RuleFreeProgram(program);
+        return NULL;
+    }
+    
+    for (uint16_t pc = 0; pc < codeLength; pc++) {
+        program->code[pc].opcode = getU8(&r);
+        program->code[pc].argc = getU8(&r);
+        program->code[pc].operand = getU16(&r);
+    }
+    program->codeLength = codeLength;
+    
+    for (uint16_t i = 0; i < constantCount && !r.error; i++) {
+        MCP_RuleValue* value = &program->constants[i];
+        value->type = (MCP_RuleValueType)getU8(&r);
+        
+        if (value->type == MCP_RULE_VALUE_NUMBER) {
+            value->value.numberValue = getF64(&r);
+        } else if (value->type == MCP_RULE_VALUE_BOOL) {
+            value->value.boolValue = getU8(&r) != 0;
+        } else if (value->type == MCP_RULE_VALUE_STRING) {
+            uint16_t length = getU16(&r);
+            const uint8_t* bytes = getBytes(&r, length);
+            value->value.stringValue = (char*)malloc(length + 1);
+            if (bytes == NULL || value->value.stringValue == NULL) {
+                r.error = true;
+                break;
+            }
+            memcpy(value->value.stringValue, bytes, length);
+            value->value.stringValue[length] = '\0';
+        } else if (value->type != MCP_RULE_VALUE_NULL) {
+            value->type = MCP_RULE_VALUE_NULL;
+            r.error = true;
+        }
+        program->constantCount = i + 1;
+    }
+    
+    // Resolve names to this instance's slots (programs rarely reference more than a few)
+    int slots[32];
+    int* resolved = nameCount <= 32 ? slots : (int*)malloc(nameCount * sizeof(int));
+    if (resolved == NULL) {
+        r.error = true;
+    }
+    
+    for (uint16_t i = 0; i < nameCount && !r.error; i++) {
+        uint8_t kind = getU8(&r);
+        uint16_t length = getU16(&r);
+        const uint8_t* bytes = getBytes(&r, length);
+        char name[128];
+        if (bytes == NULL || length >= sizeof(name)) {
+            r.error = true;
+            break;
+        }
+        memcpy(name, bytes, length);
+        name[length] = '\0';
+        
+        uint32_t hash = hashName(name);
+        resolved[i] = kind ? resolveFunctionSlot(name, hash) : resolveVariableSlot(name, hash);
+        if (resolved[i] < 0) {
+            r.error = true;
+        }
+    }
+    
+    // Validate operands and rebind symbol references
+    for (uint16_t pc = 0; pc < codeLength && !r.error; pc++) {
+        RuleInstruction* ins = &program->code[pc];
+        switch (ins->opcode) {
+            case RULE_OP_PUSH_CONST:
+                r.error = ins->operand >= program->constantCount;
+                break;
+            case RULE_OP_LOAD_VAR:
+            case RULE_OP_CALL:
+            case RULE_OP_WINDOW:
+                r.error = ins->operand >= nameCount || (ins->opcode == RULE_OP_CALL && ins->argc > RULE_MAX_PARAMS) ||
+                          (ins->opcode == RULE_OP_WINDOW && ins->argc >= RULE_WINDOW_AGGREGATE_COUNT);
+                if (!r.error) {
+                    ins->operand = (uint16_t)resolved[ins->operand];
+                }
+                break;
+            case RULE_OP_AND_JUMP:
+            case RULE_OP_OR_JUMP:
+            case RULE_OP_BINARY:
+            case RULE_OP_NOT:
+            case RULE_OP_NEGATE:
+            case RULE_OP_TO_BOOL:
+                break;
+            default:
+                r.error = true;
+                break;
+        }
+    }
+    
+    if (resolved != slots) {
+        free(resolved);
+    }
+    
+    // Snapshot bytes are untrusted; the evaluator does no stack checks of its own
+    if (!r.error && !verifyProgramStack(program)) {
+        r.error = true;
+    }
+    
+    if (r.error) {
+        MCP_RuleFreeProgram(program);
+        return NULL;
+    }
+    
+    if (consumed != NULL) {
+        *consumed = r.position;
+    }
+    return program;
+}
+
+// ===== Evaluator =====
+
+static bool isTruthy(const MCP_RuleValue* value) {
+    switch (value->type) {
+        case MCP_RULE_VALUE_BOOL:
+            return value->value.boolValue;
+            
+        case MCP_RULE_VALUE_NUMBER:
+            return value->value.numberValue != 0;
+            
+        case MCP_RULE_VALUE_STRING:
+            return value->value.stringValue != NULL && value->value.stringValue[0] != '\0';
+            
+        default:
+            return false;
+    }
+}
+
+static MCP_RuleValue applyBinary(MCP_RuleOperator op, const MCP_RuleValue* left, const MCP_RuleValue* right) {
+    MCP_RuleValue result;
+    result.type = MCP_RULE_VALUE_NULL;
+    
+    // Arithmetic is only defined for numbers
+    if (op <= MCP_RULE_OP_MODULO) {
+        if (left->type != MCP_RULE_VALUE_NUMBER || right->type != MCP_RULE_VALUE_NUMBER) {
+            return result;
+        }
+        
+        double a = left->value.numberValue;
+        double b = right->value.numberValue;
+        
+        switch (op) {
+            case MCP_RULE_OP_ADD:
+                return MCP_RuleCreateNumberValue(a + b);
+            case MCP_RULE_OP_SUBTRACT:
+                return MCP_RuleCreateNumberValue(a - b);
+            case MCP_RULE_OP_MULTIPLY:
+                return MCP_RuleCreateNumberValue(a * b);
+            case MCP_RULE_OP_DIVIDE:
+                // Division by zero yields null
+                return b != 0 ? MCP_RuleCreateNumberValue(a / b) : result;
+            case MCP_RULE_OP_MODULO:
+                return b != 0 ? MCP_RuleCreateNumberValue(fmod(a, b)) : result;
+            default:
+                return result;
+        }
+    }
+    
+    // Comparison: numbers and strings are ordered, other types only compare for equality
+    int cmp;
+    bool ordered = true;
+    
+    if (left->type != right->type) {
+        cmp = 1;
+        ordered = false;
+    } else if (left->type == MCP_RULE_VALUE_NUMBER) {
+        double a = left->value.numberValue;
+        double b = right->value.numberValue;
+        cmp = a < b ? -1 : (a > b ? 1 : 0);
+    } else if (left->type == MCP_RULE_VALUE_STRING) {
+        cmp = strcmp(left->value.stringValue, right->value.stringValue);
+    } else if (left->type == MCP_RULE_VALUE_BOOL) {
+        cmp = left->value.boolValue == right->value.boolValue ? 0 : 1;
+        ordered = false;
+    } else {
+        cmp = 0;  // null == null
+        ordered = false;
+    }
+    
+    switch (op) {
+        case MCP_RULE_OP_EQUAL:
+            return MCP_RuleCreateBoolValue(cmp == 0);
+        case MCP_RULE_OP_NOT_EQUAL:
+            return MCP_RuleCreateBoolValue(cmp != 0);
+        case MCP_RULE_OP_GREATER_THAN:
+            return ordered ? MCP_RuleCreateBoolValue(cmp > 0) : result;
+        case MCP_RULE_OP_LESS_THAN:
+            return ordered ? MCP_RuleCreateBoolValue(cmp < 0) : result;
+        case MCP_RULE_OP_GREATER_EQUAL:
+            return ordered ? MCP_RuleCreateBoolValue(cmp >= 0) : result;
+        case MCP_RULE_OP_LESS_EQUAL:
+            return ordered ? MCP_RuleCreateBoolValue(cmp <= 0) : result;
+        default:
+            return result;
+    }
+}
+
+// Evaluation stack: strings are borrowed from constants and variables and
+// only function results are owned, so evaluation itself does not allocate
+#if RULE_MAX_STACK > 32
+#error "EvalStack keeps one ownership bit per entry in a uint32_t"
+#endif
+
+typedef struct {
+    MCP_RuleValue values[RULE_MAX_STACK];
+    uint32_t owned;         // Bit per entry: value must be freed when popped
+} EvalStack;
+
+static void releaseEntry(EvalStack* stack, int index) {
+    if (stack->owned & (1u << index)) {
+        MCP_RuleFreeValue(stack->values[index]);
+        stack->owned &= ~(1u << index);
+    }
+}
+
+static void setEntry(EvalStack* stack, int index, MCP_RuleValue value, bool owned) {
+    stack->values[index] = value;
+    if (owned && value.type == MCP_RULE_VALUE_STRING) {
+        stack->owned |= 1u << index;
     }
+}
+
+MCP_RuleValue MCP_RuleExecute(const MCP_RuleProgram* program) {
+    MCP_RuleValue result;
+    result.type = MCP_RULE_VALUE_NULL;
+    
+    if (!s_initialized || program == NULL) {
+        return result;
+    }
+    
+    EvalStack stack;
+    stack.owned = 0;
+    MCP_RuleValue* values = stack.values;
+    int sp = 0;
+    uint16_t pc = 0;
     
-    TokenizerContext ctx;
-    initTokenizer(&ctx, expression);
+    while (pc < program->codeLength) {
+        const RuleInstruction* ins = &program->code[pc++];
+        
+        switch (ins->opcode) {
+            case RULE_OP_PUSH_CONST:
+                setEntry(&stack, sp++, program->constants[ins->operand], false);
+                break;
+                
+            case RULE_OP_LOAD_VAR:
+                setEntry(&stack, sp++, s_variableValues[ins->operand], false);
+                break;
+                
+            case RULE_OP_CALL: {
+                MCP_RuleValue* params = &values[sp - ins->argc];
+                MCP_RuleFunctionHandler handler = s_functionHandlers[ins->operand];
+                MCP_RuleValue value;
+                
+                if (handler != NULL) {
+                    value = handler(params, ins->argc);
+                } else {
+                    // Function not registered
+                    value.type = MCP_RULE_VALUE_NULL;
+                }
+                
+                for (int i = 0; i < ins->argc; i++) {
+                    releaseEntry(&stack, --sp);
+                }
+                setEntry(&stack, sp++, value, true);
+                break;
+            }
+                
+            case RULE_OP_BINARY: {
+                // Results are numbers, booleans or null: never strings
+                MCP_RuleValue value = applyBinary((MCP_RuleOperator)ins->argc, &values[sp - 2], &values[sp - 1]);
+                releaseEntry(&stack, sp - 1);
+                releaseEntry(&stack, sp - 2);
+                sp--;
+                values[sp - 1] = value;
+                break;
+            }
+                
+            case RULE_OP_NOT: {
+                bool truthy = isTruthy(&values[sp - 1]);
+                releaseEntry(&stack, sp - 1);
+                values[sp - 1] = MCP_RuleCreateBoolValue(!truthy);
+                break;
+            }
+                
+            case RULE_OP_NEGATE:
+                if (values[sp - 1].type == MCP_RULE_VALUE_NUMBER) {
+                    values[sp - 1].value.numberValue = -values[sp - 1].value.numberValue;
+                } else {
+                    releaseEntry(&stack, sp - 1);
+                    values[sp - 1].type = MCP_RULE_VALUE_NULL;
+                }
+                break;
+                
+            case RULE_OP_AND_JUMP:
+            case RULE_OP_OR_JUMP: {
+                bool truthy = isTruthy(&values[sp - 1]);
+                releaseEntry(&stack, sp - 1);
+                
+                if (truthy == (ins->opcode == RULE_OP_OR_JUMP)) {
+                    values[sp - 1] = MCP_RuleCreateBoolValue(truthy);
+                    pc = ins->operand;
+                } else {
+                    sp--;
+                }
+                break;
+            }
+                
+            case RULE_OP_TO_BOOL: {
+                bool truthy = isTruthy(&values[sp - 1]);
+                releaseEntry(&stack, sp - 1);
+                values[sp - 1] = MCP_RuleCreateBoolValue(truthy);
+                break;
+            }
+                
+            case RULE_OP_WINDOW:
+                if (ins->argc == RULE_WINDOW_COUNT_ABOVE) {
+                    MCP_RuleValue value = windowAggregate(ins->operand, ins->argc, &values[sp - 1]);
+                    releaseEntry(&stack, sp - 1);
+                    values[sp - 1] = value;
+                } else {
+                    values[sp++] = windowAggregate(ins->operand, ins->argc, NULL);
+                }
+                break;
+                
+            default:
+                // Corrupt program
+                while (sp > 0) {
+                    releaseEntry(&stack, --sp);
+                }
+                return result;
+        }
+    }
+    
+    // A well-formed program leaves exactly one value
+    while (sp > 1) {
+        releaseEntry(&stack, --sp);
+    }
+    if (sp != 1) {
+        return result;
+    }
+    
+    // The caller owns the result: a borrowed string is copied once here
+    if (values[0].type == MCP_RULE_VALUE_STRING && !(stack.owned & 1u)) {
+        return MCP_RuleCreateStringValue(values[0].value.stringValue);
+    }
+    return values[0];
+}
+
+MCP_RuleValue MCP_RuleEvaluate(const char* expression) {
+    MCP_RuleValue result;
+    result.type = MCP_RULE_VALUE_NULL;
+    
+    MCP_RuleProgram* program = MCP_RuleCompile(expression);
+    if (program == NULL) {
+        return result;
+    }
     
-    getNextToken(&ctx);
-    MCP_RuleValue result = parseExpression(&ctx);
+    result = MCP_RuleExecute(program);
+    MCP_RuleFreeProgram(program);
     
     return result;
 }
@@ -78,6 +78,15 @@ typedef struct {
     } value;
 } MCP_RuleValue;
 
+/**
+ * @brief Compiled rule expression
+ *
+ * Produced by MCP_RuleCompile. Variables and functions referenced by the
+ * expression are resolved to slots at compile time, so the program can be
+ * executed repeatedly without touching the source text.
+ */
+typedef struct MCP_RuleProgram MCP_RuleProgram;
+
 /**
  * @brief Initialize the rule interpreter
  * 
@@ -93,6 +102,36 @@ int MCP_RuleInterpreterInit(void);
  */
 MCP_RuleValue MCP_RuleEvaluate(const char* expression);
 
+/**
+ * @brief Compile a rule expression
+ *
+ * Variables and functions that are not registered yet are bound to empty
+ * slots and pick up their values once registered.
+ *
+ * @param expression Rule expression string
+ * @return MCP_RuleProgram* Compiled program or NULL on syntax error
+ */
+MCP_RuleProgram* MCP_RuleCompile(const char* expression);
+
+/**
+ * @brief Execute a compiled rule expression
+ *
+ * Strings are borrowed from constants and variables while the program runs,
+ * so evaluation does not allocate unless a function returns a string or the
+ * result itself is a string (returned as a copy).
+ *
+ * @param program Compiled program
+ * @return MCP_RuleValue Result of evaluation
+ */
+MCP_RuleValue MCP_RuleExecute(const MCP_RuleProgram* program);
+
+/**
+ * @brief Free a compiled rule expression
+ *
+ * @param program Compiled program
+ */
+void MCP_RuleFreeProgram(MCP_RuleProgram* program);
+
 /**
  * @brief Register a variable for rule evaluation
  * 
@@ -102,12 +141,139 @@ MCP_RuleValue MCP_RuleEvaluate(const char* expression);
  */
 int MCP_RuleRegisterVariable(const char* name, MCP_RuleValue value);
 
+/**
+ * @brief Variable update entry for MCP_RuleUpdateVariables
+ */
+typedef struct {
+    const char* name;       // Variable name
+    MCP_RuleValue value;    // New value (ownership passes to the interpreter)
+} MCP_RuleVariableUpdate;
+
+/**
+ * @brief Update many variables in one call
+ *
+ * Intended for batches of sensor readings. Unknown names are registered.
+ *
+ * @param updates Array of updates
+ * @param count Number of updates
+ * @return int Number of variables updated or negative error code
+ */
+int MCP_RuleUpdateVariables(const MCP_RuleVariableUpdate* updates, int count);
+
+/**
+ * @brief Get a handle for a variable, registering it if needed
+ *
+ * Handles stay valid for the lifetime of the interpreter.
+ *
+ * @param name Variable name
+ * @return int Variable handle or negative error code
+ */
+int MCP_RuleGetVariableHandle(const char* name);
+
+/**
+ * @brief Set a variable through a handle (no name lookup)
+ *
+ * @param handle Variable handle from MCP_RuleGetVariableHandle
+ * @param value Variable value
+ * @return int 0 on success, negative error code on failure
+ */
+int MCP_RuleSetVariableByHandle(int handle, MCP_RuleValue value);
+
+/**
+ * @brief Keep a sliding window of a variable's last samples
+ *
+ * Every numeric value stored in the variable is also a sample. Expressions read
+ * the window through avg(x), min(x), max(x), slope(x) (least-squares change per
+ * sample) and count_above(x, threshold), each maintained in O(1) per sample.
+ * Up to four count_above thresholds per window are tracked incrementally from
+ * their first use; further ones scan the window. These names are reserved
+ * and cannot be registered as functions.
+ *
+ * @param name Variable name
+ * @param size Number of samples kept (0 removes the window)
+ * @return int 0 on success, negative error code on failure
+ */
+int MCP_RuleSetSampleWindow(const char* name, uint16_t size);
+
+/**
+ * @brief Append a batch of samples to a variable's window
+ *
+ * The last sample becomes the variable value. The change listener is notified
+ * once for the whole batch.
+ *
+ * @param handle Variable handle from MCP_RuleGetVariableHandle
+ * @param samples Samples, oldest first
+ * @param count Number of samples
+ * @return int 0 on success, negative error code on failure
+ */
+int MCP_RulePushSamples(int handle, const double* samples, int count);
+
+/**
+ * @brief Variable change listener
+ *
+ * @param handle Handle of the variable whose value changed
+ * @param userData User data passed to MCP_RuleSetChangeListener
+ */
+typedef void (*MCP_RuleChangeListener)(int handle, void* userData);
+
+/**
+ * @brief Set the listener notified when a variable value changes
+ *
+ * Only one listener is supported; it is not called when a variable is set
+ * to the value it already holds.
+ *
+ * @param listener Listener function (NULL to remove)
+ * @param userData User data to pass to the listener
+ * @return int 0 on success, negative error code on failure
+ */
+int MCP_RuleSetChangeListener(MCP_RuleChangeListener listener, void* userData);
+
+/**
+ * @brief Get the variables a compiled program reads
+ *
+ * @param program Compiled program
+ * @param handles Array to store distinct variable handles
+ * @param maxHandles Size of the handles array
+ * @return int Number of distinct variables (may exceed maxHandles) or negative error code
+ */
+int MCP_RuleProgramGetVariables(const MCP_RuleProgram* program, int* handles, int maxHandles);
+
+/**
+ * @brief Serialize a compiled program
+ *
+ * Variables and functions are stored by name, so the result can be loaded
+ * with MCP_RuleProgramDeserialize after a restart.
+ *
+ * @param program Compiled program
+ * @param buffer Output buffer, or NULL to compute the required size
+ * @param bufferSize Size of buffer
+ * @return int Number of bytes written (or required) or negative error code
+ */
+int MCP_RuleProgramSerialize(const MCP_RuleProgram* program, uint8_t* buffer, size_t bufferSize);
+
+/**
+ * @brief Load a program written by MCP_RuleProgramSerialize
+ *
+ * @param data Serialized program
+ * @param size Bytes available at data
+ * @param consumed Receives the number of bytes used (optional)
+ * @return MCP_RuleProgram* Program (free with MCP_RuleFreeProgram) or NULL if invalid
+ */
+MCP_RuleProgram* MCP_RuleProgramDeserialize(const uint8_t* data, size_t size, size_t* consumed);
+
 /**
  * @brief Register a function for rule evaluation
  * 
+ * Parameters are borrowed for the duration of the call: the handler must not
+ * free or keep them, and must not change rule variables. A string result is
+ * owned by the interpreter and freed after use.
+ *
+ * The window aggregate names (avg, min, max, slope, count_above) are reserved
+ * and cannot be registered.
+ *
  * @param name Function name
  * @param handler Function handler
- * @return int 0 on success, negative error code on failure
+ * @return int 0 on success, -3 if the name is a window aggregate, other negative error code on failure
  */
 typedef MCP_RuleValue (*MCP_RuleFunctionHandler)(MCP_RuleValue* params, int paramCount);
 int MCP_RuleRegisterFunction(const char* name, MCP_RuleFunctionHandler handler);
@@ -5,6 +5,7 @@
 #include "mcp_rpi.h"
 #include "hal_rpi.h"
 #include "../../logging.h"
+#include "../../core/mcp/config/config_fields.h"
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
@@ -96,6 +97,8 @@ static bool s_queue_used[MAX_QUEUES];
 
 // --- Forward declarations ---
 static void timer_callback_wrapper(void* arg);
+static int SerializeConfigToJSON(char* buffer, size_t size);
+static int ParseJSONConfig(const char* json, uint32_t* changedSections);
 
 /**
  * @brief Platform-specific MCP initialization
@@ -170,6 +173,9 @@ int MCP_PlatformInit(void) {
     s_persistent_config.heap_size = 1024 * 1024; // 1MB heap by default
     strncpy(s_persistent_config.config_file_path, "/etc/mcp_rpi/config.json", sizeof(s_persistent_config.config_file_path) - 1);
     
+    s_default_config = s_persistent_config;
+    MCP_ConfigJsonCacheInvalidate(&s_config_json_cache, MCP_CONFIG_ALL_SECTIONS);
+    
     // Create configuration mutex
     s_config_mutex = MCP_MutexCreate();
     if (s_config_mutex <= 0) {
@@ -1455,7 +1461,8 @@ int MCP_SetConfiguration(const char* json_config) {
     }
     
     // Parse the JSON configuration and update persistent config
-    int result = ParseJSONConfig(json_config);
+    uint32_t changed = 0;
+    int result = ParseJSONConfig(json_config, &changed);
     if (result != 0) {
         log_error("Failed to parse configuration JSON: %d", result);
         MCP_MutexUnlock(s_config_mutex);
@@ -1465,6 +1472,11 @@ int MCP_SetConfiguration(const char* json_config) {
     // Unlock config mutex
     MCP_MutexUnlock(s_config_mutex);
     
+    // Nothing to apply or save when every value was already set
+    if (changed == 0) {
+        return 0;
+    }
+    
     // Apply configuration changes
     
     // Server configuration
@@ -2260,6 +2272,78 @@ static MCP_PersistentConfig s_persistent_config;
 static MCP_MutexHandle s_config_mutex;
 static bool s_config_initialized = false;
 
+// Values a null in a configuration update restores
+static MCP_PersistentConfig s_default_config;
+
+// Serialized text of the persistent configuration, kept per section
+static MCP_ConfigJsonCache s_config_json_cache;
+
+// Sections of the configuration JSON, in output order
+enum {
+    CONFIG_SECTION_DEVICE,
+    CONFIG_SECTION_SERVER,
+    CONFIG_SECTION_WIFI,
+    CONFIG_SECTION_WIFI_AP,
+    CONFIG_SECTION_BLE,
+    CONFIG_SECTION_ETHERNET,
+    CONFIG_SECTION_I2C,
+    CONFIG_SECTION_SPI,
+    CONFIG_SECTION_UART,
+    CONFIG_SECTION_GPIO,
+    CONFIG_SECTION_SYSTEM,
+    CONFIG_SECTION_COUNT
+};
+
+static const char* const s_config_sections[CONFIG_SECTION_COUNT] = {
+    "device", "server", "wifi", "wifi_ap", "ble", "ethernet",
+    "interfaces.i2c", "interfaces.spi", "interfaces.uart", "interfaces.gpio", "system"
+};
+
+#define CONFIG_FIELD(section, name, type, member) \
+    MCP_CONFIG_FIELD(CONFIG_SECTION_##section, name, type, MCP_PersistentConfig, member)
+
+// Every persistent setting and where it lives in the configuration JSON
+static const MCP_ConfigField s_config_fields[] = {
+    CONFIG_FIELD(DEVICE, "name", STRING, device_name),
+    CONFIG_FIELD(DEVICE, "firmware_version", STRING, firmware_version),
+    CONFIG_FIELD(DEVICE, "debug_enabled", BOOL, debug_enabled),
+    CONFIG_FIELD(SERVER, "enabled", BOOL, server_enabled),
+    CONFIG_FIELD(SERVER, "port", UINT, server_port),
+    CONFIG_FIELD(SERVER, "auto_start", BOOL, auto_start_server),
+    CONFIG_FIELD(WIFI, "enabled", BOOL, wifi_enabled),
+    CONFIG_FIELD(WIFI, "ssid", STRING, wifi_ssid),
+    CONFIG_FIELD(WIFI, "password", STRING, wifi_password),
+    CONFIG_FIELD(WIFI, "auto_connect", BOOL, wifi_auto_connect),
+    CONFIG_FIELD(WIFI_AP, "enabled", BOOL, wifi_ap_enabled),
+    CONFIG_FIELD(WIFI_AP, "ssid", STRING, wifi_ap_ssid),
+    CONFIG_FIELD(WIFI_AP, "password", STRING, wifi_ap_password),
+    CONFIG_FIELD(WIFI_AP, "channel", UINT, wifi_ap_channel),
+    CONFIG_FIELD(BLE, "enabled", BOOL, ble_enabled),
+    CONFIG_FIELD(BLE, "device_name", STRING, ble_device_name),
+    CONFIG_FIELD(BLE, "auto_advertise", BOOL, ble_auto_advertise),
+    CONFIG_FIELD(ETHERNET, "enabled", BOOL, ethernet_enabled),
+    CONFIG_FIELD(ETHERNET, "interface", STRING, ethernet_interface),
+    CONFIG_FIELD(ETHERNET, "dhcp", BOOL, ethernet_dhcp),
+    CONFIG_FIELD(ETHERNET, "static_ip", STRING, ethernet_static_ip),
+    CONFIG_FIELD(ETHERNET, "gateway", STRING, ethernet_gateway),
+    CONFIG_FIELD(ETHERNET, "subnet", STRING, ethernet_subnet),
+    CONFIG_FIELD(I2C, "enabled", BOOL, i2c_enabled),
+    CONFIG_FIELD(I2C, "bus_number", INT, i2c_bus_number),
+    CONFIG_FIELD(SPI, "enabled", BOOL, spi_enabled),
+    CONFIG_FIELD(SPI, "bus_number", INT, spi_bus_number),
+    CONFIG_FIELD(UART, "enabled", BOOL, uart_enabled),
+    CONFIG_FIELD(UART, "number", INT, uart_number),
+    CONFIG_FIELD(UART, "baud_rate", UINT, uart_baud_rate),
+    CONFIG_FIELD(GPIO, "enabled", BOOL, gpio_enabled),
+    CONFIG_FIELD(SYSTEM, "heap_size", UINT, heap_size),
+    CONFIG_FIELD(SYSTEM, "config_file_path", STRING, config_file_path),
+};
+
+static const MCP_ConfigFieldTable s_config_field_table = {
+    s_config_sections, CONFIG_SECTION_COUNT,
+    s_config_fields, (uint16_t)(sizeof(s_config_fields) / sizeof(s_config_fields[0]))
+};
+
 // WiFi connection state
 static struct {
     bool initialized;
@@ -2433,6 +2517,7 @@ int MCP_SystemInit(const MCP_RPiConfig* config) {
             strncpy(s_persistent_config.config_file_path, config->configFile, 
                     sizeof(s_persistent_config.config_file_path) - 1);
         }
+        MCP_ConfigJsonCacheInvalidate(&s_config_json_cache, MCP_CONFIG_ALL_SECTIONS);
         
         // Unlock config mutex
         MCP_MutexUnlock(s_config_mutex);
@@ -3412,6 +3497,8 @@ int MCP_ServerStart(void) {
 /**
  * @brief Serialize the config to JSON
  * 
+ * Sections unchanged since the last call are copied from the cache.
+ * 
  * @param buffer Buffer to store the JSON string
  * @param size Size of the buffer
  * @return int Length of the JSON string or negative error code
@@ -3421,268 +3508,34 @@ static int SerializeConfigToJSON(char* buffer, size_t size) {
         return -1;
     }
     
-    int pos = 0;
-    pos += snprintf(buffer + pos, size - pos, "{\n");
-    
-    // Device information
-    pos += snprintf(buffer + pos, size - pos,
-        "  \"device\": {\n"
-        "    \"name\": \"%s\",\n"
-        "    \"firmware_version\": \"%s\",\n"
-        "    \"debug_enabled\": %s\n"
-        "  },\n",
-        s_persistent_config.device_name,
-        s_persistent_config.firmware_version,
-        s_persistent_config.debug_enabled ? "true" : "false"
-    );
-    
-    // Server configuration
-    pos += snprintf(buffer + pos, size - pos,
-        "  \"server\": {\n"
-        "    \"enabled\": %s,\n"
-        "    \"port\": %u,\n"
-        "    \"auto_start\": %s\n"
-        "  },\n",
-        s_persistent_config.server_enabled ? "true" : "false",
-        s_persistent_config.server_port,
-        s_persistent_config.auto_start_server ? "true" : "false"
-    );
-    
-    // WiFi configuration
-    pos += snprintf(buffer + pos, size - pos,
-        "  \"wifi\": {\n"
-        "    \"enabled\": %s,\n"
-        "    \"ssid\": \"%s\",\n"
-        "    \"password\": \"%s\",\n"
-        "    \"auto_connect\": %s\n"
-        "  },\n",
-        s_persistent_config.wifi_enabled ? "true" : "false",
-        s_persistent_config.wifi_ssid,
-        s_persistent_config.wifi_password,
-        s_persistent_config.wifi_auto_connect ? "true" : "false"
-    );
-    
-    // WiFi AP configuration
-    pos += snprintf(buffer + pos, size - pos,
-        "  \"wifi_ap\": {\n"
-        "    \"enabled\": %s,\n"
-        "    \"ssid\": \"%s\",\n"
-        "    \"password\": \"%s\",\n"
-        "    \"channel\": %u\n"
-        "  },\n",
-        s_persistent_config.wifi_ap_enabled ? "true" : "false",
-        s_persistent_config.wifi_ap_ssid,
-        s_persistent_config.wifi_ap_password,
-        s_persistent_config.wifi_ap_channel
-    );
-    
-    // BLE configuration
-    pos += snprintf(buffer + pos, size - pos,
-        "  \"ble\": {\n"
-        "    \"enabled\": %s,\n"
-        "    \"device_name\": \"%s\",\n"
-        "    \"auto_advertise\": %s\n"
-        "  },\n",
-        s_persistent_config.ble_enabled ? "true" : "false",
-        s_persistent_config.ble_device_name,
-        s_persistent_config.ble_auto_advertise ? "true" : "false"
-    );
-    
-    // Ethernet configuration
-    pos += snprintf(buffer + pos, size - pos,
-        "  \"ethernet\": {\n"
-        "    \"enabled\": %s,\n"
-        "    \"interface\": \"%s\",\n"
-        "    \"dhcp\": %s,\n"
-        "    \"static_ip\": \"%s\",\n"
-        "    \"gateway\": \"%s\",\n"
-        "    \"subnet\": \"%s\"\n"
-        "  },\n",
-        s_persistent_config.ethernet_enabled ? "true" : "false",
-        s_persistent_config.ethernet_interface,
-        s_persistent_config.ethernet_dhcp ? "true" : "false",
-        s_persistent_config.ethernet_static_ip,
-        s_persistent_config.ethernet_gateway,
-        s_persistent_config.ethernet_subnet
-    );
-    
-    // Interface configurations
-    pos += snprintf(buffer + pos, size - pos,
-        "  \"interfaces\": {\n"
-        "    \"i2c\": {\n"
-        "      \"enabled\": %s,\n"
-        "      \"bus_number\": %d\n"
-        "    },\n"
-        "    \"spi\": {\n"
-        "      \"enabled\": %s,\n"
-        "      \"bus_number\": %d\n"
-        "    },\n"
-        "    \"uart\": {\n"
-        "      \"enabled\": %s,\n"
-        "      \"number\": %d,\n"
-        "      \"baud_rate\": %u\n"
-        "    },\n"
-        "    \"gpio\": {\n"
-        "      \"enabled\": %s\n"
-        "    }\n"
-        "  },\n",
-        s_persistent_config.i2c_enabled ? "true" : "false",
-        s_persistent_config.i2c_bus_number,
-        s_persistent_config.spi_enabled ? "true" : "false",
-        s_persistent_config.spi_bus_number,
-        s_persistent_config.uart_enabled ? "true" : "false",
-        s_persistent_config.uart_number,
-        s_persistent_config.uart_baud_rate,
-        s_persistent_config.gpio_enabled ? "true" : "false"
-    );
-    
-    // System configurations
-    pos += snprintf(buffer + pos, size - pos,
-        "  \"system\": {\n"
-        "    \"heap_size\": %u,\n"
-        "    \"config_file_path\": \"%s\"\n"
-        "  }\n",
-        s_persistent_config.heap_size,
-        s_persistent_config.config_file_path
-    );
-    
-    pos += snprintf(buffer + pos, size - pos, "}\n");
-    
-    return pos;
+    return MCP_ConfigFieldsSerialize(&s_config_field_table, &s_persistent_config, &s_config_json_cache,
+                                     buffer, size);
 }
 
 /**
  * @brief Parse JSON into configuration
  * 
+ * The JSON is a merge patch: only the members it names change, and null
+ * restores a member or section to its default.
+ * 
  * @param json JSON string to parse
+ * @param changedSections Receives a bit per section that changed (may be NULL)
  * @return int 0 on success, negative error code on failure
  */
-static int ParseJSONConfig(const char* json) {
+static int ParseJSONConfig(const char* json, uint32_t* changedSections) {
     if (json == NULL) {
         return -1;
     }
     
-    // Use json_parser.h functions to extract values
-    // This is a simplified version - in a real implementation,
-    // we would use a proper JSON parser library
-    
-    // Device information
-    char* device_name = json_get_string_field(json, "device.name");
-    if (device_name != NULL) {
-        strncpy(s_persistent_config.device_name, device_name, sizeof(s_persistent_config.device_name) - 1);
-        free(device_name);
-    }
+    uint32_t changed = 0;
+    int result = MCP_ConfigFieldsApplyPatch(&s_config_field_table, &s_persistent_config, &s_default_config,
+                                            json, &changed);
+    MCP_ConfigJsonCacheInvalidate(&s_config_json_cache, changed);
     
-    char* firmware_version = json_get_string_field(json, "device.firmware_version");
-    if (firmware_version != NULL) {
-        strncpy(s_persistent_config.firmware_version, firmware_version, sizeof(s_persistent_config.firmware_version) - 1);
-        free(firmware_version);
+    if (changedSections != NULL) {
+        *changedSections = changed;
     }
-    
-    s_persistent_config.debug_enabled = json_get_bool_field(json, "device.debug_enabled", s_persistent_config.debug_enabled);
-    
-    // Server configuration
-    s_persistent_config.server_enabled = json_get_bool_field(json, "server.enabled", s_persistent_config.server_enabled);
-    s_persistent_config.server_port = json_get_int_field(json, "server.port", s_persistent_config.server_port);
-    s_persistent_config.auto_start_server = json_get_bool_field(json, "server.auto_start", s_persistent_config.auto_start_server);
-    
-    // WiFi configuration
-    s_persistent_config.wifi_enabled = json_get_bool_field(json, "wifi.enabled", s_persistent_config.wifi_enabled);
-    
-    char* wifi_ssid = json_get_string_field(json, "wifi.ssid");
-    if (wifi_ssid != NULL) {
-        strncpy(s_persistent_config.wifi_ssid, wifi_ssid, sizeof(s_persistent_config.wifi_ssid) - 1);
-        free(wifi_ssid);
-    }
-    
-    char* wifi_password = json_get_string_field(json, "wifi.password");
-    if (wifi_password != NULL) {
-        strncpy(s_persistent_config.wifi_password, wifi_password, sizeof(s_persistent_config.wifi_password) - 1);
-        free(wifi_password);
-    }
-    
-    s_persistent_config.wifi_auto_connect = json_get_bool_field(json, "wifi.auto_connect", s_persistent_config.wifi_auto_connect);
-    
-    // WiFi AP configuration
-    s_persistent_config.wifi_ap_enabled = json_get_bool_field(json, "wifi_ap.enabled", s_persistent_config.wifi_ap_enabled);
-    
-    char* wifi_ap_ssid = json_get_string_field(json, "wifi_ap.ssid");
-    if (wifi_ap_ssid != NULL) {
-        strncpy(s_persistent_config.wifi_ap_ssid, wifi_ap_ssid, sizeof(s_persistent_config.wifi_ap_ssid) - 1);
-        free(wifi_ap_ssid);
-    }
-    
-    char* wifi_ap_password = json_get_string_field(json, "wifi_ap.password");
-    if (wifi_ap_password != NULL) {
-        strncpy(s_persistent_config.wifi_ap_password, wifi_ap_password, sizeof(s_persistent_config.wifi_ap_password) - 1);
-        free(wifi_ap_password);
-    }
-    
-    s_persistent_config.wifi_ap_channel = json_get_int_field(json, "wifi_ap.channel", s_persistent_config.wifi_ap_channel);
-    
-    // BLE configuration
-    s_persistent_config.ble_enabled = json_get_bool_field(json, "ble.enabled", s_persistent_config.ble_enabled);
-    
-    char* ble_device_name = json_get_string_field(json, "ble.device_name");
-    if (ble_device_name != NULL) {
-        strncpy(s_persistent_config.ble_device_name, ble_device_name, sizeof(s_persistent_config.ble_device_name) - 1);
-        free(ble_device_name);
-    }
-    
-    s_persistent_config.ble_auto_advertise = json_get_bool_field(json, "ble.auto_advertise", s_persistent_config.ble_auto_advertise);
-    
-    // Ethernet configuration
-    s_persistent_config.ethernet_enabled = json_get_bool_field(json, "ethernet.enabled", s_persistent_config.ethernet_enabled);
-    
-    char* ethernet_interface = json_get_string_field(json, "ethernet.interface");
-    if (ethernet_interface != NULL) {
-        strncpy(s_persistent_config.ethernet_interface, ethernet_interface, sizeof(s_persistent_config.ethernet_interface) - 1);
-        free(ethernet_interface);
-    }
-    
-    s_persistent_config.ethernet_dhcp = json_get_bool_field(json, "ethernet.dhcp", s_persistent_config.ethernet_dhcp);
-    
-    char* ethernet_static_ip = json_get_string_field(json, "ethernet.static_ip");
-    if (ethernet_static_ip != NULL) {
-        strncpy(s_persistent_config.ethernet_static_ip, ethernet_static_ip, sizeof(s_persistent_config.ethernet_static_ip) - 1);
-        free(ethernet_static_ip);
-    }
-    
-    char* ethernet_gateway = json_get_string_field(json, "ethernet.gateway");
-    if (ethernet_gateway != NULL) {
-        strncpy(s_persistent_config.ethernet_gateway, ethernet_gateway, sizeof(s_persistent_config.ethernet_gateway) - 1);
-        free(ethernet_gateway);
-    }
-    
-    char* ethernet_subnet = json_get_string_field(json, "ethernet.subnet");
-    if (ethernet_subnet != NULL) {
-        strncpy(s_persistent_config.ethernet_subnet, ethernet_subnet, sizeof(s_persistent_config.ethernet_subnet) - 1);
-        free(ethernet_subnet);
-    }
-    
-    // Interface configurations
-    s_persistent_config.i2c_enabled = json_get_bool_field(json, "interfaces.i2c.enabled", s_persistent_config.i2c_enabled);
-    s_persistent_config.i2c_bus_number = json_get_int_field(json, "interfaces.i2c.bus_number", s_persistent_config.i2c_bus_number);
-    
-    s_persistent_config.spi_enabled = json_get_bool_field(json, "interfaces.spi.enabled", s_persistent_config.spi_enabled);
-    s_persistent_config.spi_bus_number = json_get_int_field(json, "interfaces.spi.bus_number", s_persistent_config.spi_bus_number);
-    
-    s_persistent_config.uart_enabled = json_get_bool_field(json, "interfaces.uart.enabled", s_persistent_config.uart_enabled);
-    s_persistent_config.uart_number = json_get_int_field(json, "interfaces.uart.number", s_persistent_config.uart_number);
-    s_persistent_config.uart_baud_rate = json_get_int_field(json, "interfaces.uart.baud_rate", s_persistent_config.uart_baud_rate);
-    
-    s_persistent_config.gpio_enabled = json_get_bool_field(json, "interfaces.gpio.enabled", s_persistent_config.gpio_enabled);
-    
-    // System configurations
-    s_persistent_config.heap_size = json_get_int_field(json, "system.heap_size", s_persistent_config.heap_size);
-    
-    char* config_file_path = json_get_string_field(json, "system.config_file_path");
-    if (config_file_path != NULL) {
-        strncpy(s_persistent_config.config_file_path, config_file_path, sizeof(s_persistent_config.config_file_path) - 1);
-        free(config_file_path);
-    }
-    
-    return 0;
+    return result;
 }
 
 /**
@@ -3736,7 +3589,7 @@ int MCP_LoadPersistentState(void) {
     MCP_FileClose(file);
     
     // Parse JSON config
-    int result = ParseJSONConfig(json_buffer);
+    int result = ParseJSONConfig(json_buffer, NULL);
     free(json_buffer);
     
     if (result != 0) {
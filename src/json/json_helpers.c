@@ -539,6 +539,15 @@ char* json_array_get_item(const void* array, size_t index) {
     return item;
 }
 
+void json_array_free(void* array) {
+    if (array == NULL) {
+        return;
+    }
+    
+    free(((JsonArray*)array)->jsonArray);
+    free(array);
+}
+
 bool json_validate_schema(const char* json, const char* schema) {
     // Simplified implementation - just check if json contains schema fields
     if (json == NULL || schema == NULL) {
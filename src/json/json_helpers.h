@@ -78,6 +78,13 @@ size_t json_array_length(const void* array);
  */
 char* json_array_get_item(const void* array, size_t index);
 
+/**
+ * @brief Free an array returned by json_get_array_field
+ * 
+ * @param array Opaque pointer to the array
+ */
+void json_array_free(void* array);
+
 /**
  * @brief Validate a JSON string against a schema
  * 
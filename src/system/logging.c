@@ -8,9 +8,11 @@
 #include <time.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
 
 // Define LogHandler type
-typedef void (*LogHandler)(LogLevel level, const char* message, void* context);
+typedef void (*LogHandler)(LogLevel level, const char* module, const char* message, void* context);
 
 // Log configuration
 static LogLevel s_logLevel = LOG_LEVEL_INFO;
@@ -18,6 +20,43 @@ static LogHandler s_logHandler = NULL;
 static void* s_logContext = NULL;
 static bool s_timestampEnabled = true;
 static bool s_colorEnabled = true;
+static uint32_t s_outputs = LOG_OUTPUT_SERIAL;
+static FILE* s_logFile = NULL;
+
+// Interned module names; ID 0 is the empty name
+static const char* s_moduleNames[LOG_MAX_MODULES] = { "" };
+static uint32_t s_moduleCount = 1;
+static bool s_moduleLock = false;
+
+// Module name pointers seen before, so a lookup usually costs one comparison
+#define MODULE_CACHE_SIZE 64
+#define MODULE_CACHE_PROBES 4
+
+typedef struct {
+    const char* name;
+    uint8_t id;
+} ModuleCacheEntry;
+
+static ModuleCacheEntry s_moduleCache[MODULE_CACHE_SIZE];
+
+// Registered sinks
+typedef struct {
+    LogSink sink;
+    void* context;
+    LogLevel maxLevel;
+    uint32_t moduleMask;
+} SinkEntry;
+
+static SinkEntry s_sinks[LOG_MAX_SINKS];
+static int s_sinkCount = 0;           // Highest used slot plus one
+static LogLevel s_gateLevel = LOG_LEVEL_INFO; // Most verbose level any output takes
+
+// Console level per module ID as level + 1; 0 follows s_logLevel
+static uint8_t s_moduleLevels[LOG_MAX_MODULES];
+static int s_moduleLevelCount = 0;
+
+// Read by the log macros; all zero until log_init() so every call reaches log_message()
+uint8_t log_skip_levels[LOG_MAX_MODULES];
 
 // ANSI color codes
 #define COLOR_RESET   "\033[0m"
@@ -29,42 +68,210 @@ static bool s_colorEnabled = true;
 #define COLOR_CYAN    "\033[36m"
 #define COLOR_WHITE   "\033[37m"
 
-// Default log handler function
-static void defaultLogHandler(LogLevel level, const char* message, void* context) {
-    const char* levelStr = "UNKNOWN";
-    const char* color = "";
-    
-    // Unused parameter
-    (void)context;
-    
-    // Set level string and color
+// Longest formatted line: timestamp, colored level, module prefix and message
+#define LINE_SIZE 1200
+
+// Message text kept per ring slot; longer messages are truncated
+#ifndef LOG_ASYNC_TEXT_SIZE
+#define LOG_ASYNC_TEXT_SIZE 224
+#endif
+
+// Longest conversion specification that can be deferred, such as "%-08.3lld"
+#define SPEC_SIZE 16
+
+// Output buffer the sink fills before each write
+#ifndef LOG_ASYNC_BATCH_SIZE
+#define LOG_ASYNC_BATCH_SIZE 4096
+#endif
+
+// Atomics shared by callers and the sink; the builtins work from C and C++
+#define ATOMIC_LOAD(pointer, order) __atomic_load_n(pointer, __ATOMIC_##order)
+#define ATOMIC_STORE(pointer, value, order) __atomic_store_n(pointer, value, __ATOMIC_##order)
+#define ATOMIC_ADD(pointer, value) __atomic_fetch_add(pointer, value, __ATOMIC_RELAXED)
+
+// One queued message. The sequence number tells whose turn the slot is:
+// equal to the enqueue position when free, one past it once filled.
+// A deferred record keeps its format string and the raw argument values in
+// the text area; otherwise the text area holds the formatted message.
+typedef struct {
+    uint32_t sequence;
+    uint8_t level;
+    uint16_t length;            // Bytes used in the text area
+    uint8_t moduleId;
+    time_t timestamp;
+    const char* format;         // Format of a deferred record, NULL for text
+    char text[LOG_ASYNC_TEXT_SIZE];
+} LogRecord;
+
+// Bytes of a record that carry information, for comparing the two encodings
+#define RECORD_HEADER_SIZE (offsetof(LogRecord, text) - offsetof(LogRecord, level))
+
+// Argument types of deferred conversions, as read with va_arg
+typedef enum {
+    ARG_NONE,           // "%%"
+    ARG_INT,
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_SIZE,
+    ARG_INTMAX,
+    ARG_PTRDIFF,
+    ARG_DOUBLE,
+    ARG_LDOUBLE,
+    ARG_POINTER,
+    ARG_STRING,
+    ARG_UNSUPPORTED     // "%n", wide characters, or a specification too long
+} ArgType;
+
+// One conversion specification of a format string
+typedef struct {
+    uint8_t length;     // Characters from the '%' to the conversion
+    uint8_t stars;      // Width and precision taken from int arguments
+    bool plain;         // No flags, width or precision
+    uint8_t type;       // ArgType
+    int precision;      // Numeric precision, -1 if none, -2 if taken from an argument
+} FormatSpec;
+
+// Asynchronous state
+static LogRecord* s_ring = NULL;
+static uint32_t s_ringMask = 0;
+static uint32_t s_enqueuePos = 0;       // Shared by callers
+static uint32_t s_dequeuePos = 0;       // Owned by the sink
+static bool s_draining = false;
+static bool s_deferred = false;
+static uint32_t s_recordBytes = 0;
+static char* s_batch = NULL;
+static uint32_t s_written = 0;
+static uint32_t s_dropped = 0;
+static uint32_t s_truncated = 0;
+static uint32_t s_batches = 0;
+static uint32_t s_droppedReported = 0;
+
+// In-memory store: variable-length records in a byte ring whose size is a
+// power of two. A record never wraps; the room left at the end of the
+// buffer is skipped, marked by sequence 0 when a header fits there.
+typedef struct {
+    uint32_t sequence;          // Starts at 1; 0 marks padding
+    uint32_t timestamp;
+    uint16_t size;              // Record bytes, header and alignment included
+    uint16_t length;            // Message bytes, the terminator not included
+    uint8_t level;
+    uint8_t moduleId;
+} MemoryRecord;
+
+#define MEMORY_HEADER_SIZE ((uint32_t)sizeof(MemoryRecord))
+#define MEMORY_ALIGN 4
+
+// Buffer bytes per LogConfig.maxMemoryEntries; messages vary in length
+#ifndef LOG_MEMORY_BYTES_PER_ENTRY
+#define LOG_MEMORY_BYTES_PER_ENTRY 64
+#endif
+
+// Every this many records the position is indexed for cursor lookups
+#define MEMORY_CHECKPOINT_STRIDE 16
+
+static uint8_t* s_memory = NULL;
+static uint32_t s_memoryMask = 0;       // Buffer bytes minus one
+static uint32_t s_memoryHead = 0;       // Byte position of the oldest record
+static uint32_t s_memoryTail = 0;       // Byte position of the next record
+static uint32_t s_memoryFirst = 1;      // Sequence of the oldest record
+static uint32_t s_memoryNext = 1;       // Sequence of the next record
+static uint32_t* s_checkpoints = NULL;  // Position of every stride-th sequence
+static uint32_t s_checkpointMask = 0;
+static uint32_t s_memoryEntries = 0;    // Requested size in entries
+static bool s_memoryLock = false;
+
+// Timestamp text of the last second the sink formatted
+static time_t s_stampSecond = (time_t)-1;
+static char s_stampText[24] = "";
+
+// Get level string and color
+static void levelStyle(LogLevel level, const char** levelStr, const char** color) {
+    *levelStr = "UNKNOWN";
+    *color = "";
+
     switch (level) {
         case LOG_LEVEL_TRACE:
-            levelStr = "TRACE";
-            color = COLOR_CYAN;
+            *levelStr = "TRACE";
+            *color = COLOR_CYAN;
             break;
         case LOG_LEVEL_DEBUG:
-            levelStr = "DEBUG";
-            color = COLOR_GREEN;
+            *levelStr = "DEBUG";
+            *color = COLOR_GREEN;
             break;
         case LOG_LEVEL_INFO:
-            levelStr = "INFO";
-            color = COLOR_WHITE;
+            *levelStr = "INFO";
+            *color = COLOR_WHITE;
             break;
         case LOG_LEVEL_WARN:
-            levelStr = "WARN";
-            color = COLOR_YELLOW;
+            *levelStr = "WARN";
+            *color = COLOR_YELLOW;
             break;
         case LOG_LEVEL_ERROR:
-            levelStr = "ERROR";
-            color = COLOR_RED;
+            *levelStr = "ERROR";
+            *color = COLOR_RED;
             break;
         case LOG_LEVEL_NONE:
-            levelStr = "NONE";
-            color = COLOR_MAGENTA;
+            *levelStr = "NONE";
+            *color = COLOR_MAGENTA;
             break;
     }
-    
+}
+
+// Append text to a line, stopping one short of the end for the newline
+static size_t appendText(char* line, size_t length, size_t size, const char* text) {
+    size_t textLength = strlen(text);
+    if (textLength > size - 2 - length) {
+        textLength = size - 2 - length;
+    }
+    memcpy(line + length, text, textLength);
+    return length + textLength;
+}
+
+// Format one output line; the module may be NULL or empty
+static int formatLine(char* line, size_t size, LogLevel level, bool color, const char* timestamp,
+                      const char* module, const char* message) {
+    const char* levelStr;
+    const char* colorCode;
+    levelStyle(level, &levelStr, &colorCode);
+
+    // Plain appends; snprintf costs more than the rest of the sink together
+    size_t length = appendText(line, 0, size, timestamp);
+    if (color) {
+        length = appendText(line, length, size, colorCode);
+    }
+    length = appendText(line, length, size, "[");
+    length = appendText(line, length, size, levelStr);
+    length = appendText(line, length, size, color ? "]" COLOR_RESET " " : "] ");
+    if (module && *module) {
+        length = appendText(line, length, size, "[");
+        length = appendText(line, length, size, module);
+        length = appendText(line, length, size, "] ");
+    }
+    length = appendText(line, length, size, message);
+
+    // The newline is kept even when the message was cut
+    line[length++] = '\n';
+    line[length] = '\0';
+    return (int)length;
+}
+
+// Write formatted lines to the active outputs
+static void writeOutput(const char* data, size_t length) {
+    if (s_logFile != NULL) {
+        fwrite(data, 1, length, s_logFile);
+    }
+    // Standard output also stands in when no other output is active
+    if ((s_outputs & (LOG_OUTPUT_SERIAL | LOG_OUTPUT_CONSOLE)) ||
+        (s_logFile == NULL && !(s_outputs & LOG_OUTPUT_MEMORY))) {
+        fwrite(data, 1, length, stdout);
+    }
+}
+
+// Default log handler function
+static void defaultLogHandler(LogLevel level, const char* module, const char* message, void* context) {
+    // Unused parameter
+    (void)context;
+
     // Generate timestamp if enabled
     char timestamp[24] = "";
     if (s_timestampEnabled) {
@@ -72,13 +279,174 @@ static void defaultLogHandler(LogLevel level, const char* message, void* context
         struct tm* tm_info = localtime(&now);
         strftime(timestamp, sizeof(timestamp), "[%Y-%m-%d %H:%M:%S] ", tm_info);
     }
-    
-    // Print log message
-    if (s_colorEnabled) {
-        printf("%s%s[%s]%s %s\n", timestamp, color, levelStr, COLOR_RESET, message);
-    } else {
-        printf("%s[%s] %s\n", timestamp, levelStr, message);
+
+    char line[LINE_SIZE];
+    int length = formatLine(line, sizeof(line), level, s_colorEnabled, timestamp, module, message);
+    writeOutput(line, (size_t)length);
+}
+
+// True when messages taken by the console are also stored in memory
+static inline bool memoryActive(void) {
+    return s_memory != NULL && (s_outputs & LOG_OUTPUT_MEMORY);
+}
+
+static void lockMemory(void) {
+    while (__atomic_exchange_n(&s_memoryLock, true, __ATOMIC_ACQUIRE)) {
+    }
+}
+
+static void unlockMemory(void) {
+    __atomic_store_n(&s_memoryLock, false, __ATOMIC_RELEASE);
+}
+
+static inline MemoryRecord* memoryRecordAt(uint32_t position) {
+    return (MemoryRecord*)(s_memory + (position & s_memoryMask));
+}
+
+// Step over the padding at the end of the buffer, if position is on it
+static uint32_t memorySkipPadding(uint32_t position) {
+    uint32_t room = s_memoryMask + 1 - (position & s_memoryMask);
+    if (room < MEMORY_HEADER_SIZE || memoryRecordAt(position)->sequence == 0) {
+        return position + room;
+    }
+    return position;
+}
+
+// Allocate the store for a number of average entries; keeps a store of the same size
+static int allocateMemory(uint32_t entries) {
+    uint32_t capacity = 1024;
+    while (capacity < entries * LOG_MEMORY_BYTES_PER_ENTRY && capacity < (1u << 24)) {
+        capacity <<= 1;
+    }
+    if (s_memory != NULL && capacity == s_memoryMask + 1) {
+        return 0;
+    }
+
+    // Records are at least a header long, so this many checkpoints cover the store
+    uint32_t checkpoints = 4;
+    while (checkpoints < capacity / (MEMORY_HEADER_SIZE * MEMORY_CHECKPOINT_STRIDE) + 2) {
+        checkpoints <<= 1;
+    }
+    uint8_t* memory = (uint8_t*)malloc(capacity);
+    uint32_t* index = (uint32_t*)malloc(checkpoints * sizeof(uint32_t));
+    if (memory == NULL || index == NULL) {
+        free(memory);
+        free(index);
+        return -1;
+    }
+
+    lockMemory();
+    free(s_memory);
+    free(s_checkpoints);
+    s_memory = memory;
+    s_memoryMask = capacity - 1;
+    s_checkpoints = index;
+    s_checkpointMask = checkpoints - 1;
+    s_memoryHead = 0;
+    s_memoryTail = 0;
+    s_memoryFirst = s_memoryNext;
+    unlockMemory();
+    return 0;
+}
+
+// Store a message, evicting the oldest records to make room
+static void memoryAppend(LogLevel level, int moduleId, time_t timestamp, const char* message) {
+    lockMemory();
+    if (s_memory == NULL) {
+        unlockMemory();
+        return; // Freed since the caller checked
     }
+
+    uint32_t capacity = s_memoryMask + 1;
+    size_t length = strlen(message);
+    if (length > capacity / 2 - MEMORY_HEADER_SIZE - 1) {
+        length = capacity / 2 - MEMORY_HEADER_SIZE - 1;
+    }
+    if (length > 0xFFFF - MEMORY_HEADER_SIZE - MEMORY_ALIGN) {
+        length = 0xFFFF - MEMORY_HEADER_SIZE - MEMORY_ALIGN;
+    }
+    uint32_t size = (MEMORY_HEADER_SIZE + (uint32_t)length + 1 + MEMORY_ALIGN - 1) & ~(uint32_t)(MEMORY_ALIGN - 1);
+
+    // A record that does not fit before the end starts over at the beginning
+    uint32_t room = capacity - (s_memoryTail & s_memoryMask);
+    uint32_t padding = room < size ? room : 0;
+    while (s_memoryTail + padding + size - s_memoryHead > capacity) {
+        uint32_t head = memorySkipPadding(s_memoryHead);
+        if (head != s_memoryHead) {
+            s_memoryHead = head;
+            continue;
+        }
+        const MemoryRecord* oldest = memoryRecordAt(head);
+        s_memoryHead = head + oldest->size;
+        s_memoryFirst = oldest->sequence + 1;
+    }
+    if (padding >= MEMORY_HEADER_SIZE) {
+        memoryRecordAt(s_memoryTail)->sequence = 0;
+    }
+    s_memoryTail += padding;
+
+    MemoryRecord* record = memoryRecordAt(s_memoryTail);
+    record->sequence = s_memoryNext;
+    record->timestamp = (uint32_t)timestamp;
+    record->size = (uint16_t)size;
+    record->length = (uint16_t)length;
+    record->level = (uint8_t)level;
+    record->moduleId = (uint8_t)moduleId;
+    char* text = (char*)(record + 1);
+    memcpy(text, message, length);
+    text[length] = '\0';
+
+    if (s_memoryNext % MEMORY_CHECKPOINT_STRIDE == 0) {
+        s_checkpoints[(s_memoryNext / MEMORY_CHECKPOINT_STRIDE) & s_checkpointMask] = s_memoryTail;
+    }
+    s_memoryTail += size;
+    s_memoryNext++;
+
+    unlockMemory();
+}
+
+// Position of a stored record, walking at most a stride from the nearest checkpoint
+static uint32_t memoryFind(uint32_t sequence) {
+    uint32_t checkpoint = sequence - sequence % MEMORY_CHECKPOINT_STRIDE;
+    uint32_t position = s_memoryHead;
+    uint32_t current = s_memoryFirst;
+    if (checkpoint > s_memoryFirst) {
+        position = s_checkpoints[(checkpoint / MEMORY_CHECKPOINT_STRIDE) & s_checkpointMask];
+        current = checkpoint;
+    }
+    position = memorySkipPadding(position);
+    while (current < sequence) {
+        position = memorySkipPadding(position + memoryRecordAt(position)->size);
+        current++;
+    }
+    return position;
+}
+
+// Most verbose level the console takes from a module
+static inline LogLevel consoleLevel(int moduleId) {
+    return s_moduleLevels[moduleId] != 0 ? (LogLevel)(s_moduleLevels[moduleId] - 1) : s_logLevel;
+}
+
+// Recompute the levels below which the macros and log_message() return at once
+static void updateGateLevel(void) {
+    LogLevel any = LOG_LEVEL_NONE;
+    for (int id = 0; id < LOG_MAX_MODULES; id++) {
+        LogLevel gate = consoleLevel(id);
+        for (int i = 0; i < s_sinkCount; i++) {
+            const SinkEntry* entry = &s_sinks[i];
+            if (entry->sink != NULL && (entry->moduleMask & (1u << id)) && entry->maxLevel > gate) {
+                gate = entry->maxLevel;
+            }
+        }
+        log_skip_levels[id] = (uint8_t)(LOG_LEVEL_TRACE - gate);
+        if (gate > any) {
+            any = gate;
+        }
+    }
+
+    // ID 0 also stands for unregistered handles and plain module names
+    log_skip_levels[0] = (uint8_t)(LOG_LEVEL_TRACE - any);
+    s_gateLevel = any;
 }
 
 int log_init(const LogConfig* config) {
@@ -87,18 +455,48 @@ int log_init(const LogConfig* config) {
     s_logHandler = defaultLogHandler;
     s_timestampEnabled = config ? config->includeTimestamp : true;
     s_colorEnabled = config ? config->colorOutput : true;
-    
+    s_outputs = config ? config->outputs : (uint32_t)LOG_OUTPUT_SERIAL;
+    updateGateLevel();
+
+    s_memoryEntries = (config && config->maxMemoryEntries > 0) ? config->maxMemoryEntries : 128;
+    if ((s_outputs & LOG_OUTPUT_MEMORY) && allocateMemory(s_memoryEntries) != 0) {
+        return -1;
+    }
+
+    if (s_logFile != NULL) {
+        fclose(s_logFile);
+        s_logFile = NULL;
+    }
+    if ((s_outputs & LOG_OUTPUT_FILE) && config->logFileName != NULL) {
+        s_logFile = fopen(config->logFileName, "a");
+    }
+
     return 0;
 }
 
 int log_deinit(void) {
-    // Nothing to do for basic implementation
+    log_set_async(0);
+    log_flush();
+
+    if (s_logFile != NULL) {
+        fclose(s_logFile);
+        s_logFile = NULL;
+    }
+
+    lockMemory();
+    free(s_memory);
+    free(s_checkpoints);
+    s_memory = NULL;
+    s_checkpoints = NULL;
+    s_memoryFirst = s_memoryNext;
+    unlockMemory();
     return 0;
 }
 
 LogLevel log_set_level(LogLevel level) {
     LogLevel previous = s_logLevel;
     s_logLevel = level;
+    updateGateLevel();
     return previous;
 }
 
@@ -106,29 +504,752 @@ LogLevel log_get_level(void) {
     return s_logLevel;
 }
 
+// Look a module name up in the table, adding it if it is new
+static int internModule(const char* name) {
+    uint32_t count = ATOMIC_LOAD(&s_moduleCount, ACQUIRE);
+    for (uint32_t id = 1; id < count; id++) {
+        if (strcmp(s_moduleNames[id], name) == 0) {
+            return (int)id;
+        }
+    }
+    if (count == LOG_MAX_MODULES) {
+        return 0;
+    }
+
+    size_t length = strlen(name);
+    char* copy = (char*)malloc(length + 1);
+    if (copy == NULL) {
+        return 0;
+    }
+    memcpy(copy, name, length + 1);
+    s_moduleNames[count] = copy;
+    ATOMIC_STORE(&s_moduleCount, count + 1, RELEASE);
+    return (int)count;
+}
+
+int log_module_id(const char* name) {
+    if (name == NULL || *name == '\0') {
+        return 0;
+    }
+
+    // The cache is keyed by pointer; the name is compared as well, since a
+    // pointer may be reused for another name
+    uint32_t slot = (uint32_t)(((uintptr_t)name >> 2) * 2654435761u) >> 26;
+    for (int probe = 0; probe < MODULE_CACHE_PROBES; probe++) {
+        ModuleCacheEntry* entry = &s_moduleCache[(slot + probe) & (MODULE_CACHE_SIZE - 1)];
+        const char* cached = ATOMIC_LOAD(&entry->name, ACQUIRE);
+        if (cached == NULL) {
+            break;
+        }
+        if (cached == name && strcmp(s_moduleNames[entry->id], name) == 0) {
+            return entry->id;
+        }
+    }
+
+    while (__atomic_exchange_n(&s_moduleLock, true, __ATOMIC_ACQUIRE)) {
+    }
+    int id = internModule(name);
+    for (int probe = 0; probe < MODULE_CACHE_PROBES; probe++) {
+        ModuleCacheEntry* entry = &s_moduleCache[(slot + probe) & (MODULE_CACHE_SIZE - 1)];
+        if (entry->name == NULL) {
+            entry->id = (uint8_t)id;
+            ATOMIC_STORE(&entry->name, name, RELEASE);
+            break;
+        }
+    }
+    __atomic_store_n(&s_moduleLock, false, __ATOMIC_RELEASE);
+    return id;
+}
+
+int log_register_module(LogModule* module) {
+    if (module == NULL) {
+        return -1;
+    }
+    module->id = (uint8_t)log_module_id(module->name);
+    return module->id;
+}
+
+int log_set_module_level(const char* module, LogLevel level) {
+    int moduleId = log_module_id(module);
+    if (moduleId == 0 || level < LOG_LEVEL_NONE || level > LOG_LEVEL_TRACE) {
+        return -1;
+    }
+    if (s_moduleLevels[moduleId] == 0) {
+        s_moduleLevelCount++;
+    }
+    s_moduleLevels[moduleId] = (uint8_t)(level + 1);
+    updateGateLevel();
+    return 0;
+}
+
+int log_clear_module_level(const char* module) {
+    int moduleId = log_module_id(module);
+    if (moduleId == 0) {
+        return -1;
+    }
+    if (s_moduleLevels[moduleId] != 0) {
+        s_moduleLevels[moduleId] = 0;
+        s_moduleLevelCount--;
+        updateGateLevel();
+    }
+    return 0;
+}
+
+const char* log_module_name(int moduleId) {
+    if (moduleId <= 0 || (uint32_t)moduleId >= ATOMIC_LOAD(&s_moduleCount, ACQUIRE)) {
+        return "";
+    }
+    return s_moduleNames[moduleId];
+}
+
+int log_add_sink(LogSink sink, void* context, LogLevel maxLevel, uint32_t moduleMask) {
+    if (sink == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < LOG_MAX_SINKS; i++) {
+        if (s_sinks[i].sink == NULL) {
+            s_sinks[i].context = context;
+            s_sinks[i].maxLevel = maxLevel;
+            s_sinks[i].moduleMask = moduleMask;
+            s_sinks[i].sink = sink;
+            if (i >= s_sinkCount) {
+                s_sinkCount = i + 1;
+            }
+            updateGateLevel();
+            return i;
+        }
+    }
+    return -2;
+}
+
+int log_set_sink_filter(int sinkId, LogLevel maxLevel, uint32_t moduleMask) {
+    if (sinkId < 0 || sinkId >= LOG_MAX_SINKS || s_sinks[sinkId].sink == NULL) {
+        return -1;
+    }
+    s_sinks[sinkId].maxLevel = maxLevel;
+    s_sinks[sinkId].moduleMask = moduleMask;
+    updateGateLevel();
+    return 0;
+}
+
+int log_remove_sink(int sinkId) {
+    if (sinkId < 0 || sinkId >= LOG_MAX_SINKS || s_sinks[sinkId].sink == NULL) {
+        return -1;
+    }
+    s_sinks[sinkId].sink = NULL;
+    while (s_sinkCount > 0 && s_sinks[s_sinkCount - 1].sink == NULL) {
+        s_sinkCount--;
+    }
+    updateGateLevel();
+    return 0;
+}
+
+// Bit per sink that takes a message of this level and module
+static uint32_t matchingSinks(LogLevel level, int moduleId) {
+    uint32_t matches = 0;
+    for (int i = 0; i < s_sinkCount; i++) {
+        const SinkEntry* entry = &s_sinks[i];
+        if (entry->sink != NULL && level <= entry->maxLevel && (entry->moduleMask & (1u << moduleId))) {
+            matches |= 1u << i;
+        }
+    }
+    return matches;
+}
+
+// Pass a message to the sinks selected by matchingSinks()
+static void dispatchSinks(uint32_t sinks, LogLevel level, int moduleId, const char* module,
+                          const char* message, time_t timestamp) {
+    LogEntry entry;
+    entry.level = level;
+    entry.moduleId = (uint8_t)moduleId;
+    entry.module = module;
+    entry.message = message;
+    entry.messageLength = strlen(message);
+    entry.timestamp = timestamp;
+    for (int i = 0; sinks != 0; i++, sinks >>= 1) {
+        if ((sinks & 1u) && s_sinks[i].sink != NULL) {
+            s_sinks[i].sink(&entry, s_sinks[i].context);
+        }
+    }
+}
+
+// Parse the conversion specification starting at a '%'
+static void parseSpec(const char* format, FormatSpec* spec) {
+    const char* p = format + 1;
+    spec->stars = 0;
+    spec->precision = -1;
+    spec->type = ARG_UNSUPPORTED;
+
+    while (*p && strchr("-+ #0'", *p)) {
+        p++;
+    }
+    if (*p == '*') {
+        spec->stars++;
+        p++;
+    } else {
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+    }
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            spec->stars++;
+            spec->precision = -2;
+            p++;
+        } else {
+            spec->precision = 0;
+            while (*p >= '0' && *p <= '9') {
+                spec->precision = spec->precision * 10 + (*p++ - '0');
+            }
+        }
+    }
+
+    spec->plain = (p == format + 1);
+
+    int type = ARG_INT;
+    bool isLongDouble = false;
+    if (p[0] == 'h') {
+        p += (p[1] == 'h') ? 2 : 1;
+    } else if (p[0] == 'l' && p[1] == 'l') {
+        type = ARG_LLONG;
+        p += 2;
+    } else if (p[0] == 'l') {
+        type = ARG_LONG;
+        p++;
+    } else if (p[0] == 'z') {
+        type = ARG_SIZE;
+        p++;
+    } else if (p[0] == 'j') {
+        type = ARG_INTMAX;
+        p++;
+    } else if (p[0] == 't') {
+        type = ARG_PTRDIFF;
+        p++;
+    } else if (p[0] == 'L') {
+        isLongDouble = true;
+        p++;
+    }
+
+    char conversion = *p;
+    spec->length = (uint8_t)(p - format + (conversion != '\0'));
+    if (p - format >= SPEC_SIZE - 1) {
+        return;
+    }
+
+    switch (conversion) {
+        case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+            spec->type = (uint8_t)type;
+            break;
+        case 'c':
+            spec->type = type == ARG_INT ? ARG_INT : ARG_UNSUPPORTED;
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            spec->type = isLongDouble ? ARG_LDOUBLE : ARG_DOUBLE;
+            break;
+        case 's':
+            spec->type = type == ARG_INT ? ARG_STRING : ARG_UNSUPPORTED;
+            break;
+        case 'p':
+            spec->type = ARG_POINTER;
+            break;
+        case '%':
+            spec->type = spec->length == 2 ? ARG_NONE : ARG_UNSUPPORTED;
+            break;
+    }
+}
+
+// Copy an argument of the given type from the list into the record
+#define PACK_VALUE(valueType) \
+    do { \
+        valueType value = va_arg(*args, valueType); \
+        if (used + sizeof(value) > size) { \
+            return -1; \
+        } \
+        memcpy(data + used, &value, sizeof(value)); \
+        used += sizeof(value); \
+    } while (0)
+
+// Store the raw arguments of a format; return the bytes used, or -1 if the
+// format has a conversion that cannot be deferred or the values do not fit
+static int packArguments(char* data, size_t size, const char* format, va_list* args) {
+    size_t used = 0;
+    for (const char* p = strchr(format, '%'); p != NULL; p = strchr(p, '%')) {
+        FormatSpec spec;
+        parseSpec(p, &spec);
+        if (spec.type == ARG_UNSUPPORTED) {
+            return -1;
+        }
+        p += spec.length;
+
+        int precision = spec.precision;
+        for (int i = 0; i < spec.stars; i++) {
+            PACK_VALUE(int);
+        }
+        if (precision == -2) {
+            memcpy(&precision, data + used - sizeof(int), sizeof(int));
+            precision = precision < 0 ? -1 : precision;
+        }
+
+        switch (spec.type) {
+            case ARG_INT:       PACK_VALUE(int); break;
+            case ARG_LONG:      PACK_VALUE(long); break;
+            case ARG_LLONG:     PACK_VALUE(long long); break;
+            case ARG_SIZE:      PACK_VALUE(size_t); break;
+            case ARG_INTMAX:    PACK_VALUE(intmax_t); break;
+            case ARG_PTRDIFF:   PACK_VALUE(ptrdiff_t); break;
+            case ARG_DOUBLE:    PACK_VALUE(double); break;
+            case ARG_LDOUBLE:   PACK_VALUE(long double); break;
+            case ARG_POINTER:   PACK_VALUE(void*); break;
+            case ARG_STRING: {
+                // Strings may not outlive the call, so their text is copied
+                const char* text = va_arg(*args, const char*);
+                if (text == NULL) {
+                    text = "(null)";
+                }
+                size_t length = 0;
+                while (text[length] != '\0' && (precision < 0 || length < (size_t)precision)) {
+                    length++;
+                }
+                if (used + length + 1 > size) {
+                    return -1;
+                }
+                memcpy(data + used, text, length);
+                data[used + length] = '\0';
+                used += length + 1;
+                break;
+            }
+        }
+    }
+    return (int)used;
+}
+
+// Read a value back from a deferred record and format it
+#define FORMAT_VALUE(valueType) \
+    do { \
+        valueType value; \
+        memcpy(&value, data + used, sizeof(value)); \
+        used += sizeof(value); \
+        length = spec.stars == 0 ? snprintf(out, room, specText, value) \
+               : spec.stars == 1 ? snprintf(out, room, specText, stars[0], value) \
+               : snprintf(out, room, specText, stars[0], stars[1], value); \
+    } while (0)
+
+// Write a decimal number; plain integer and string conversions are the common
+// case and are formatted here rather than through snprintf
+static size_t formatDecimal(char* out, size_t room, unsigned long long value, bool negative) {
+    char digits[24];
+    size_t count = 0;
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    if (negative) {
+        digits[count++] = '-';
+    }
+
+    size_t length = 0;
+    while (count > 0 && length < room - 1) {
+        out[length++] = digits[--count];
+    }
+    out[length] = '\0';
+    return length;
+}
+
+// Format a deferred record into message text
+static void formatDeferred(char* message, size_t size, const char* format, const char* data) {
+    size_t used = 0;
+    size_t position = 0;
+    const char* p = format;
+
+    while (*p != '\0' && position < size - 1) {
+        if (*p != '%') {
+            const char* next = strchr(p, '%');
+            size_t literal = next != NULL ? (size_t)(next - p) : strlen(p);
+            literal = literal < size - 1 - position ? literal : size - 1 - position;
+            memcpy(message + position, p, literal);
+            position += literal;
+            p += literal;
+            continue;
+        }
+
+        FormatSpec spec;
+        parseSpec(p, &spec);
+        char specText[SPEC_SIZE];
+        memcpy(specText, p, spec.length);
+        specText[spec.length] = '\0';
+        p += spec.length;
+
+        int stars[2] = { 0, 0 };
+        for (int i = 0; i < spec.stars; i++) {
+            memcpy(&stars[i], data + used, sizeof(int));
+            used += sizeof(int);
+        }
+
+        char* out = message + position;
+        size_t room = size - position;
+        int length = 0;
+        char conversion = p[-1];
+        if (spec.plain && spec.type >= ARG_INT && spec.type <= ARG_SIZE &&
+            (conversion == 'd' || conversion == 'i' || conversion == 'u')) {
+            long long value = 0;
+            unsigned long long unsignedValue = 0;
+            switch (spec.type) {
+                case ARG_INT: {
+                    int raw;
+                    memcpy(&raw, data + used, sizeof(raw));
+                    value = raw;
+                    unsignedValue = (unsigned)raw;
+                    used += sizeof(raw);
+                    break;
+                }
+                case ARG_LONG: {
+                    long raw;
+                    memcpy(&raw, data + used, sizeof(raw));
+                    value = raw;
+                    unsignedValue = (unsigned long)raw;
+                    used += sizeof(raw);
+                    break;
+                }
+                case ARG_SIZE: {
+                    size_t raw;
+                    memcpy(&raw, data + used, sizeof(raw));
+                    value = (long long)raw;
+                    unsignedValue = raw;
+                    used += sizeof(raw);
+                    break;
+                }
+                default: {
+                    long long raw;
+                    memcpy(&raw, data + used, sizeof(raw));
+                    value = raw;
+                    unsignedValue = (unsigned long long)raw;
+                    used += sizeof(raw);
+                    break;
+                }
+            }
+            if (conversion == 'u') {
+                position += formatDecimal(out, room, unsignedValue, false);
+            } else {
+                position += formatDecimal(out, room, value < 0 ? 0ull - (unsigned long long)value
+                                                               : (unsigned long long)value, value < 0);
+            }
+            continue;
+        }
+        if (spec.plain && spec.type == ARG_STRING) {
+            const char* value = data + used;
+            size_t valueLength = strlen(value);
+            used += valueLength + 1;
+            valueLength = valueLength < room - 1 ? valueLength : room - 1;
+            memcpy(out, value, valueLength);
+            position += valueLength;
+            continue;
+        }
+        switch (spec.type) {
+            case ARG_NONE:      length = snprintf(out, room, "%%"); break;
+            case ARG_INT:       FORMAT_VALUE(int); break;
+            case ARG_LONG:      FORMAT_VALUE(long); break;
+            case ARG_LLONG:     FORMAT_VALUE(long long); break;
+            case ARG_SIZE:      FORMAT_VALUE(size_t); break;
+            case ARG_INTMAX:    FORMAT_VALUE(intmax_t); break;
+            case ARG_PTRDIFF:   FORMAT_VALUE(ptrdiff_t); break;
+            case ARG_DOUBLE:    FORMAT_VALUE(double); break;
+            case ARG_LDOUBLE:   FORMAT_VALUE(long double); break;
+            case ARG_POINTER:   FORMAT_VALUE(void*); break;
+            case ARG_STRING: {
+                const char* value = data + used;
+                used += strlen(value) + 1;
+                length = spec.stars == 0 ? snprintf(out, room, specText, value)
+                       : spec.stars == 1 ? snprintf(out, room, specText, stars[0], value)
+                       : snprintf(out, room, specText, stars[0], stars[1], value);
+                break;
+            }
+        }
+        if (length > 0) {
+            position += (size_t)length < room ? (size_t)length : room - 1;
+        }
+    }
+    message[position] = '\0';
+}
+
+// Claim a ring slot, or return NULL when the ring is full
+static LogRecord* claimSlot(LogRecord* ring, uint32_t* position) {
+    uint32_t pos = ATOMIC_LOAD(&s_enqueuePos, RELAXED);
+    for (;;) {
+        LogRecord* record = &ring[pos & s_ringMask];
+        int32_t diff = (int32_t)(ATOMIC_LOAD(&record->sequence, ACQUIRE) - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&s_enqueuePos, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                *position = pos;
+                return record;
+            }
+        } else if (diff < 0) {
+            return NULL;
+        } else {
+            pos = ATOMIC_LOAD(&s_enqueuePos, RELAXED);
+        }
+    }
+}
+
+// Queue a message for the sink; only the message text is formatted here
+static void queueMessage(LogRecord* ring, LogLevel level, int moduleId, const char* format, va_list args) {
+    uint32_t position;
+    LogRecord* record = claimSlot(ring, &position);
+    if (record == NULL) {
+        ATOMIC_ADD(&s_dropped, 1);
+        return;
+    }
+
+    record->level = (uint8_t)level;
+    record->moduleId = (uint8_t)moduleId;
+    record->timestamp = (s_timestampEnabled || s_sinkCount > 0 || memoryActive()) ? time(NULL) : 0;
+
+    // Deferred records keep the argument values; the sink formats them
+    int length = -1;
+    record->format = NULL;
+    if (s_deferred) {
+        va_list values;
+        va_copy(values, args);
+        length = packArguments(record->text, sizeof(record->text), format, &values);
+        va_end(values);
+        if (length >= 0) {
+            record->format = format;
+            record->length = (uint16_t)length;
+            ATOMIC_STORE(&record->sequence, position + 1, RELEASE);
+            return;
+        }
+    }
+
+    length = vsnprintf(record->text, sizeof(record->text), format, args);
+    if (length < 0) {
+        length = 0;
+        record->text[0] = '\0';
+    } else if (length >= (int)sizeof(record->text)) {
+        length = (int)sizeof(record->text) - 1;
+        ATOMIC_ADD(&s_truncated, 1);
+    }
+    record->length = (uint16_t)length;
+
+    // Publish the slot to the sink
+    ATOMIC_STORE(&record->sequence, position + 1, RELEASE);
+}
+
+// Log a message that passed the gate; moduleId is -1 if only the name is known
+static void logMessageV(LogLevel level, int moduleId, const char* module, const char* format, va_list args) {
+    // Sinks and module levels filter before anything is formatted
+    LogRecord* ring = ATOMIC_LOAD(&s_ring, ACQUIRE);
+    LogLevel console = s_logLevel;
+    uint32_t sinks = 0;
+    bool memory = memoryActive();
+    if (s_sinkCount > 0 || ring != NULL || s_moduleLevelCount > 0 || memory) {
+        if (moduleId < 0) {
+            moduleId = log_module_id(module);
+        }
+        console = consoleLevel(moduleId);
+        sinks = matchingSinks(level, moduleId);
+    }
+    if (level > console && sinks == 0) {
+        return;
+    }
+
+    if (ring != NULL) {
+        queueMessage(ring, level, moduleId, format, args);
+        return;
+    }
+
+    char message[1024];
+    vsnprintf(message, sizeof(message), format, args);
+
+    // Call log handler
+    if (level <= console) {
+        s_logHandler(level, module, message, s_logContext);
+        if (memory) {
+            memoryAppend(level, moduleId, time(NULL), message);
+        }
+    }
+    if (sinks != 0) {
+        dispatchSinks(sinks, level, moduleId, module != NULL ? module : "", message, time(NULL));
+    }
+}
+
 void log_message(LogLevel level, const char* module, const char* format, ...) {
-    if (level > s_logLevel || s_logHandler == NULL) {
-        return; // Higher log level than current or no handler
-    }
-    
-    // Format message with module prefix if provided
-    char buffer[1024];
-    char fullMessage[1152]; // buffer + prefix + margin
-    
+    if (level > s_gateLevel || s_logHandler == NULL) {
+        return; // More verbose than any output takes, or no handler
+    }
+
     va_list args;
     va_start(args, format);
-    vsnprintf(buffer, sizeof(buffer), format, args);
+    logMessageV(level, -1, module, format, args);
     va_end(args);
-    
-    if (module && *module) {
-        snprintf(fullMessage, sizeof(fullMessage), "[%s] %s", module, buffer);
+}
+
+void log_module_message(const LogModule* module, LogLevel level, const char* format, ...) {
+    int moduleId = module != NULL ? module->id : 0;
+    if ((int)level + log_skip_levels[moduleId] > LOG_LEVEL_TRACE || s_logHandler == NULL) {
+        return;
+    }
+
+    // An unregistered handle is looked up by name
+    va_list args;
+    va_start(args, format);
+    if (module == NULL) {
+        logMessageV(level, 0, NULL, format, args);
     } else {
-        strncpy(fullMessage, buffer, sizeof(fullMessage) - 1);
-        fullMessage[sizeof(fullMessage) - 1] = '\0';
+        logMessageV(level, moduleId > 0 ? moduleId : -1, module->name, format, args);
     }
-    
-    // Call log handler
-    s_logHandler(level, fullMessage, s_logContext);
+    va_end(args);
+}
+
+// Timestamp text for a record, formatted once per second
+static const char* sinkTimestamp(time_t timestamp) {
+    if (!s_timestampEnabled) {
+        return "";
+    }
+    if (timestamp != s_stampSecond) {
+        struct tm* tm_info = localtime(&timestamp);
+        strftime(s_stampText, sizeof(s_stampText), "[%Y-%m-%d %H:%M:%S] ", tm_info);
+        s_stampSecond = timestamp;
+    }
+    return s_stampText;
+}
+
+// Append a line to the sink's batch, writing the batch out when it is full
+static void sinkAppend(size_t* used, LogLevel level, time_t timestamp, const char* module, const char* text) {
+    if (LOG_ASYNC_BATCH_SIZE - *used < LINE_SIZE) {
+        writeOutput(s_batch, *used);
+        s_batches++;
+        *used = 0;
+    }
+    *used += (size_t)formatLine(s_batch + *used, LOG_ASYNC_BATCH_SIZE - *used, level, s_colorEnabled,
+                                sinkTimestamp(timestamp), module, text);
+}
+
+int log_set_async(uint32_t queueEntries) {
+    if (s_ring != NULL) {
+        log_process(0);
+        LogRecord* ring = s_ring;
+        ATOMIC_STORE(&s_ring, (LogRecord*)NULL, RELEASE);
+        free(ring);
+        free(s_batch);
+        s_batch = NULL;
+        s_ringMask = 0;
+    }
+    if (queueEntries == 0) {
+        return 0;
+    }
+
+    uint32_t entries = 2;
+    while (entries < queueEntries && entries < 0x40000000u) {
+        entries <<= 1;
+    }
+
+    LogRecord* ring = (LogRecord*)malloc(entries * sizeof(LogRecord));
+    s_batch = (char*)malloc(LOG_ASYNC_BATCH_SIZE);
+    if (ring == NULL || s_batch == NULL) {
+        free(ring);
+        free(s_batch);
+        s_batch = NULL;
+        return -1;
+    }
+    for (uint32_t i = 0; i < entries; i++) {
+        ring[i].sequence = i;
+    }
+
+    s_ringMask = entries - 1;
+    s_enqueuePos = 0;
+    s_dequeuePos = 0;
+    s_written = 0;
+    s_dropped = 0;
+    s_truncated = 0;
+    s_batches = 0;
+    s_droppedReported = 0;
+    s_recordBytes = 0;
+    ATOMIC_STORE(&s_ring, ring, RELEASE);
+    return 0;
+}
+
+int log_process(uint32_t maxRecords) {
+    LogRecord* ring = ATOMIC_LOAD(&s_ring, ACQUIRE);
+    if (ring == NULL || __atomic_exchange_n(&s_draining, true, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+
+    size_t used = 0;
+    uint32_t count = 0;
+    while (maxRecords == 0 || count < maxRecords) {
+        LogRecord* record = &ring[s_dequeuePos & s_ringMask];
+        if (ATOMIC_LOAD(&record->sequence, ACQUIRE) != s_dequeuePos + 1) {
+            break;
+        }
+
+        const char* text = record->text;
+        char message[LINE_SIZE - 64];
+        if (record->format != NULL) {
+            formatDeferred(message, sizeof(message), record->format, record->text);
+            text = message;
+        }
+
+        LogLevel level = (LogLevel)record->level;
+        const char* module = log_module_name(record->moduleId);
+        if (level <= consoleLevel(record->moduleId)) {
+            sinkAppend(&used, level, record->timestamp, module, text);
+            if (memoryActive()) {
+                memoryAppend(level, record->moduleId, record->timestamp, text);
+            }
+        }
+        uint32_t sinks = matchingSinks(level, record->moduleId);
+        if (sinks != 0) {
+            dispatchSinks(sinks, level, record->moduleId, module, text, record->timestamp);
+        }
+        s_recordBytes += (uint32_t)(RECORD_HEADER_SIZE + record->length);
+
+        // Hand the slot back to the callers one lap ahead
+        ATOMIC_STORE(&record->sequence, s_dequeuePos + s_ringMask + 1, RELEASE);
+        s_dequeuePos++;
+        count++;
+    }
+
+    // Say in the output that messages are missing
+    uint32_t dropped = ATOMIC_LOAD(&s_dropped, RELAXED);
+    if (dropped != s_droppedReported) {
+        char notice[64];
+        snprintf(notice, sizeof(notice), "%lu messages dropped, log queue full",
+                 (unsigned long)(dropped - s_droppedReported));
+        sinkAppend(&used, LOG_LEVEL_WARN, s_timestampEnabled ? time(NULL) : 0, "log", notice);
+        s_droppedReported = dropped;
+    }
+
+    if (used > 0) {
+        writeOutput(s_batch, used);
+        s_batches++;
+    }
+    s_written += count;
+
+    __atomic_store_n(&s_draining, false, __ATOMIC_RELEASE);
+    return (int)count;
+}
+
+bool log_set_deferred(bool deferred) {
+    bool previous = s_deferred;
+    s_deferred = deferred;
+    return previous;
+}
+
+void log_get_stats(LogStats* stats) {
+    if (stats == NULL) {
+        return;
+    }
+    stats->recordsQueued = ATOMIC_LOAD(&s_enqueuePos, RELAXED);
+    stats->recordsWritten = s_written;
+    stats->recordsDropped = ATOMIC_LOAD(&s_dropped, RELAXED);
+    stats->recordsTruncated = ATOMIC_LOAD(&s_truncated, RELAXED);
+    stats->batchesWritten = s_batches;
+    stats->recordBytes = s_recordBytes;
+    stats->queueEntries = s_ring != NULL ? s_ringMask + 1 : 0;
+    stats->memoryFirstSequence = s_memoryFirst;
+    stats->memoryNextSequence = s_memoryNext;
+    stats->memoryBytes = s_memory != NULL ? s_memoryMask + 1 : 0;
 }
 
 // Utility function to get level name
@@ -144,11 +1265,111 @@ const char* log_level_name(LogLevel level) {
     }
 }
 
+int log_flush(void) {
+    log_process(0);
+    if (s_logFile != NULL) {
+        fflush(s_logFile);
+    }
+    fflush(stdout);
+    return 0;
+}
+
+uint32_t log_set_outputs(uint32_t outputs) {
+    uint32_t previous = s_outputs;
+    if ((outputs & LOG_OUTPUT_MEMORY) && s_memory == NULL &&
+        allocateMemory(s_memoryEntries > 0 ? s_memoryEntries : 128) != 0) {
+        outputs &= ~(uint32_t)LOG_OUTPUT_MEMORY;
+    }
+    s_outputs = outputs;
+    return previous;
+}
+
+uint32_t log_get_outputs(void) {
+    return s_outputs;
+}
+
+int log_read_memory_entries(uint32_t* cursor, LogLevel maxLevel, char* buffer, size_t bufferSize) {
+    if (cursor == NULL || buffer == NULL || bufferSize < 2) {
+        return -1;
+    }
+    buffer[0] = '\0';
+    if (s_memory == NULL) {
+        return 0;
+    }
+
+    lockMemory();
+
+    // A cursor behind the store starts at the oldest record kept
+    uint32_t sequence = *cursor;
+    if (sequence < s_memoryFirst) {
+        sequence = s_memoryFirst;
+    } else if (sequence > s_memoryNext) {
+        sequence = s_memoryNext;
+    }
+
+    size_t used = 0;
+    int copied = 0;
+    time_t stampSecond = (time_t)-1;
+    char stamp[24] = "";
+    uint32_t position = sequence < s_memoryNext ? memoryFind(sequence) : 0;
+    while (sequence < s_memoryNext) {
+        const MemoryRecord* record = memoryRecordAt(position);
+        if (record->level <= maxLevel) {
+            time_t timestamp = (time_t)record->timestamp;
+            if (s_timestampEnabled && timestamp != stampSecond) {
+                struct tm* tm_info = localtime(&timestamp);
+                strftime(stamp, sizeof(stamp), "[%Y-%m-%d %H:%M:%S] ", tm_info);
+                stampSecond = timestamp;
+            }
+
+            char line[LINE_SIZE];
+            const char* text = (const char*)(record + 1);
+            const char* module = log_module_name(record->moduleId);
+            int length = formatLine(line, sizeof(line), (LogLevel)record->level, false, stamp, module, text);
+            if ((size_t)length >= bufferSize - used) {
+                if (copied > 0) {
+                    break; // The next call continues here
+                }
+                // A line longer than the whole buffer is cut rather than never returned
+                length = formatLine(buffer, bufferSize, (LogLevel)record->level, false, stamp, module, text);
+            } else {
+                memcpy(buffer + used, line, (size_t)length + 1);
+            }
+            used += (size_t)length;
+            copied++;
+        }
+        sequence++;
+        if (sequence < s_memoryNext) {
+            position = memorySkipPadding(position + record->size);
+        }
+    }
+    *cursor = sequence;
+
+    unlockMemory();
+    return copied;
+}
+
+int log_get_memory_entries(char* buffer, size_t bufferSize) {
+    uint32_t cursor = 0;
+    int copied = log_read_memory_entries(&cursor, LOG_LEVEL_TRACE, buffer, bufferSize);
+    return copied < 0 ? copied : (int)strlen(buffer);
+}
+
+int log_clear_memory_entries(void) {
+    lockMemory();
+    int cleared = (int)(s_memoryNext - s_memoryFirst);
+    s_memoryHead = s_memoryTail;
+    s_memoryFirst = s_memoryNext;
+    unlockMemory();
+    return cleared;
+}
+
+int log_get_memory_entry_count(void) {
+    lockMemory();
+    int count = (int)(s_memoryNext - s_memoryFirst);
+    unlockMemory();
+    return count;
+}
+
 // Additional functions not required for basic build
-int log_flush(void) { return 0; }
-int log_get_memory_entries(char* buffer, size_t bufferSize) { (void)buffer; (void)bufferSize; return 0; }
-int log_clear_memory_entries(void) { return 0; }
-int log_get_memory_entry_count(void) { return 0; }
-uint32_t log_set_outputs(uint32_t outputs) { (void)outputs; return 0; }
-uint32_t log_get_outputs(void) { return 0; }
 int log_set_custom_callback(void (*callback)(LogLevel, const char*)) { (void)callback; return 0; }
@@ -1,9 +1,52 @@
+/**
+ * @file logging.h
+ * @brief System logging
+ *
+ * Messages are written synchronously by default: the caller formats the
+ * line and writes it to the outputs before log_message() returns.
+ *
+ * In asynchronous mode (log_set_async()) callers only format the message
+ * text into a slot of a lock-free ring and return. A sink drains the ring
+ * with log_process(), adding the timestamp, level and colors and writing the
+ * lines to the outputs in batches. The sink is meant to run from a
+ * low-priority task or thread; log_flush() drains the ring from the caller.
+ * When the ring is full the message is dropped and counted, and the sink
+ * reports the number of dropped messages in the output.
+ *
+ * With deferred formatting (log_set_deferred()) callers do not format at
+ * all: a queued record keeps the format string and the raw argument values,
+ * and the text is produced only by the sink. Strings passed for %s are
+ * copied; the format string itself must stay valid until the sink runs,
+ * which string literals do. Formats with %n or wide characters, or whose
+ * arguments do not fit a slot, are formatted by the caller as before.
+ *
+ * Besides the console and file outputs, sinks registered with log_add_sink()
+ * receive each message as a structured entry: level, module ID and the
+ * message text without any prefix. Module names are interned into small IDs
+ * so a sink filters by level and module bitmask; a message no output or
+ * sink accepts is dropped before it is formatted. In asynchronous mode the
+ * sinks run on the thread that calls log_process().
+ *
+ * The LOG_* macros check the level before the call, so a disabled message
+ * costs one compare and its arguments are not evaluated. Levels above
+ * LOG_COMPILE_LEVEL are removed at compile time. Modules that log in hot
+ * paths define a LogModule handle and use LOG_AT(); the check then uses the
+ * level of that module, including per-module levels set with
+ * log_set_module_level().
+ *
+ * With LOG_OUTPUT_MEMORY, the messages the console takes are also kept in a
+ * fixed-size circular store for reading back after the fact. Each message
+ * gets a sequence number; log_read_memory_entries() returns the messages
+ * from a cursor on, so a reader polls for new messages without copying the
+ * whole store. The oldest messages are overwritten when the store is full.
+ */
 #ifndef LOGGING_H
 #define LOGGING_H
 
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <time.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -42,7 +85,7 @@ typedef struct {
     uint32_t outputs;             // Bit mask of log outputs
     const char* logFileName;      // Log file name (for LOG_OUTPUT_FILE)
     uint32_t maxFileSize;         // Maximum log file size in bytes
-    uint32_t maxMemoryEntries;    // Maximum memory buffer entries
+    uint32_t maxMemoryEntries;    // Memory store size in entries of average length
     bool includeTimestamp;        // Include timestamp in log entries
     bool includeLevelName;        // Include level name in log entries
     bool includeModuleName;       // Include module name in log entries
@@ -50,6 +93,56 @@ typedef struct {
     void (*customLogCallback)(LogLevel level, const char* message); // Custom log callback
 } LogConfig;
 
+/**
+ * @brief Number of module IDs, one bit each in a module mask
+ *
+ * ID 0 stands for messages without a module and for modules beyond the table.
+ */
+#define LOG_MAX_MODULES 32
+
+/**
+ * @brief Module mask accepting every module
+ */
+#define LOG_ALL_MODULES 0xFFFFFFFFu
+
+/**
+ * @brief Maximum number of registered sinks
+ */
+#define LOG_MAX_SINKS 4
+
+/**
+ * @brief One log message as passed to sinks
+ */
+typedef struct {
+    LogLevel level;
+    uint8_t moduleId;             // Interned module, 0 for none
+    const char* module;           // Module name, "" for none
+    const char* message;          // Message text, valid during the call only
+    size_t messageLength;
+    time_t timestamp;             // Seconds since the epoch when logged
+} LogEntry;
+
+/**
+ * @brief Sink receiving structured log entries
+ */
+typedef void (*LogSink)(const LogEntry* entry, void* context);
+
+/**
+ * @brief Logging counters
+ */
+typedef struct {
+    uint32_t recordsQueued;       // Messages queued in asynchronous mode
+    uint32_t recordsWritten;      // Messages written by the sink
+    uint32_t recordsDropped;      // Messages dropped because the ring was full
+    uint32_t recordsTruncated;    // Messages cut to fit a ring slot
+    uint32_t batchesWritten;      // Output writes made by the sink
+    uint32_t recordBytes;         // Header and payload bytes of the written messages
+    uint32_t queueEntries;        // Ring size, 0 in synchronous mode
+    uint32_t memoryFirstSequence; // Oldest message kept in memory
+    uint32_t memoryNextSequence;  // Sequence number the next stored message gets
+    uint32_t memoryBytes;         // Size of the in-memory store, 0 if not allocated
+} LogStats;
+
 /**
  * @brief Initialize logging system
  * 
@@ -105,14 +198,201 @@ uint32_t log_get_outputs(void);
  */
 void log_message(LogLevel level, const char* module, const char* format, ...);
 
+/**
+ * @brief Switch between synchronous and asynchronous logging
+ *
+ * Switching is not synchronized with callers of log_message(); do it before
+ * other threads log or after they stop. Switching back to synchronous mode
+ * drains the ring first.
+ *
+ * @param queueEntries Ring slots, rounded up to a power of two, or 0 for synchronous logging
+ * @return int 0 on success, -1 on memory allocation failure
+ */
+int log_set_async(uint32_t queueEntries);
+
+/**
+ * @brief Drain queued messages to the outputs
+ *
+ * Only one caller drains at a time; a concurrent call returns 0 at once.
+ *
+ * @param maxRecords Maximum messages to write, 0 for all that are queued
+ * @return int Number of messages written
+ */
+int log_process(uint32_t maxRecords);
+
+/**
+ * @brief Queue format strings and raw arguments instead of formatted text
+ *
+ * Only takes effect in asynchronous mode.
+ *
+ * @param deferred true to defer formatting to the sink
+ * @return bool Previous setting
+ */
+bool log_set_deferred(bool deferred);
+
+/**
+ * @brief Get logging counters
+ *
+ * @param stats Receives the counters
+ */
+void log_get_stats(LogStats* stats);
+
+/**
+ * @brief Get the interned ID of a module name
+ *
+ * The first call with a new name adds it to the module table; the name is
+ * copied. Later calls with the same pointer are answered from a cache.
+ *
+ * @param name Module name
+ * @return int Module ID, 0 for NULL, "" or when the table is full
+ */
+int log_module_id(const char* name);
+
+/**
+ * @brief Get the name of an interned module
+ *
+ * @param moduleId Module ID
+ * @return const char* Module name, "" for ID 0 or an unknown ID
+ */
+const char* log_module_name(int moduleId);
+
+/**
+ * @brief Register a sink for structured log entries
+ *
+ * Register sinks before other threads log; filters may change at any time.
+ *
+ * @param sink Sink function
+ * @param context Passed to the sink with every entry
+ * @param maxLevel Most verbose level the sink receives
+ * @param moduleMask Bit per module ID the sink receives, LOG_ALL_MODULES for all
+ * @return int Sink ID on success, -1 on invalid arguments, -2 if all sink slots are taken
+ */
+int log_add_sink(LogSink sink, void* context, LogLevel maxLevel, uint32_t moduleMask);
+
+/**
+ * @brief Change the filter of a sink
+ *
+ * @param sinkId Sink ID from log_add_sink()
+ * @param maxLevel Most verbose level the sink receives, LOG_LEVEL_NONE for none
+ * @param moduleMask Bit per module ID the sink receives
+ * @return int 0 on success, -1 if the sink does not exist
+ */
+int log_set_sink_filter(int sinkId, LogLevel maxLevel, uint32_t moduleMask);
+
+/**
+ * @brief Unregister a sink
+ *
+ * @param sinkId Sink ID from log_add_sink()
+ * @return int 0 on success, -1 if the sink does not exist
+ */
+int log_remove_sink(int sinkId);
+
+/**
+ * @brief Most verbose level compiled into the log macros
+ *
+ * Macros for more verbose levels expand to dead code: the call and the
+ * argument expressions are removed by the compiler. Define it on the
+ * command line, e.g. -DLOG_COMPILE_LEVEL=3 to drop debug and trace sites.
+ */
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 5
+#endif
+
+/**
+ * @brief Handle of a log module
+ *
+ * Define one per module with LOG_MODULE_INIT() and register it once at
+ * startup. An unregistered handle still logs, but gates on the most verbose
+ * level of any module and looks its name up on every message.
+ */
+typedef struct {
+    const char* name;             // Module name, must stay valid
+    uint8_t id;                   // Interned module ID, 0 until registered
+} LogModule;
+
+/**
+ * @brief Initializer of a LogModule handle
+ */
+#define LOG_MODULE_INIT(name) { name, 0 }
+
+/**
+ * @brief Per module ID, how many of the most verbose levels no output takes
+ *
+ * Kept up to date by the logging system and read by the macros. Index 0
+ * holds the gate of all modules together.
+ */
+extern uint8_t log_skip_levels[LOG_MAX_MODULES];
+
+/**
+ * @brief Check whether a message of a level and module ID would be logged
+ */
+#define LOG_LEVEL_ENABLED(level, moduleId) \
+    ((level) <= LOG_COMPILE_LEVEL && (int)(level) + log_skip_levels[moduleId] <= LOG_LEVEL_TRACE)
+
+/**
+ * @brief Check whether a module handle logs at a level, to guard costly preparation
+ */
+#define LOG_MODULE_ENABLED(module, level) LOG_LEVEL_ENABLED(level, (module).id)
+
+/**
+ * @brief Register a module handle
+ *
+ * @param module Handle defined with LOG_MODULE_INIT()
+ * @return int Module ID, 0 if the module table is full, -1 if module is NULL
+ */
+int log_register_module(LogModule* module);
+
+/**
+ * @brief Log a message for a module handle
+ *
+ * Prefer LOG_AT(), which skips the call for disabled levels.
+ *
+ * @param module Module handle
+ * @param level Log level
+ * @param format Format string
+ * @param ... Format arguments
+ */
+void log_module_message(const LogModule* module, LogLevel level, const char* format, ...);
+
+/**
+ * @brief Set the console level of one module
+ *
+ * Overrides the level of log_set_level() for this module; sinks keep their
+ * own filters.
+ *
+ * @param module Module name
+ * @param level Most verbose level the console takes from the module
+ * @return int 0 on success, -1 on an invalid level, empty name or full module table
+ */
+int log_set_module_level(const char* module, LogLevel level);
+
+/**
+ * @brief Make a module follow the global console level again
+ *
+ * @param module Module name
+ * @return int 0 on success, -1 on an empty name or full module table
+ */
+int log_clear_module_level(const char* module);
+
 /**
  * @brief Convenience macros for different log levels
+ *
+ * The level is checked before the arguments are evaluated.
+ */
+#define LOG_ERROR(module, format, ...) LOG_NAMED(LOG_LEVEL_ERROR, module, format, ##__VA_ARGS__)
+#define LOG_WARN(module, format, ...)  LOG_NAMED(LOG_LEVEL_WARN, module, format, ##__VA_ARGS__)
+#define LOG_INFO(module, format, ...)  LOG_NAMED(LOG_LEVEL_INFO, module, format, ##__VA_ARGS__)
+#define LOG_DEBUG(module, format, ...) LOG_NAMED(LOG_LEVEL_DEBUG, module, format, ##__VA_ARGS__)
+#define LOG_TRACE(module, format, ...) LOG_NAMED(LOG_LEVEL_TRACE, module, format, ##__VA_ARGS__)
+
+#define LOG_NAMED(level, module, format, ...) \
+    (LOG_LEVEL_ENABLED(level, 0) ? log_message(level, module, format, ##__VA_ARGS__) : (void)0)
+
+/**
+ * @brief Log through a module handle, e.g. LOG_AT(LOG_LEVEL_DEBUG, s_vmLog, "pc %u", pc)
  */
-#define LOG_ERROR(module, format, ...) log_message(LOG_LEVEL_ERROR, module, format, ##__VA_ARGS__)
-#define LOG_WARN(module, format, ...)  log_message(LOG_LEVEL_WARN, module, format, ##__VA_ARGS__)
-#define LOG_INFO(module, format, ...)  log_message(LOG_LEVEL_INFO, module, format, ##__VA_ARGS__)
-#define LOG_DEBUG(module, format, ...) log_message(LOG_LEVEL_DEBUG, module, format, ##__VA_ARGS__)
-#define LOG_TRACE(module, format, ...) log_message(LOG_LEVEL_TRACE, module, format, ##__VA_ARGS__)
+#define LOG_AT(level, module, format, ...) \
+    (LOG_MODULE_ENABLED(module, level) ? log_module_message(&(module), level, format, ##__VA_ARGS__) : (void)0)
 
 /**
  * @brief Simplified logging functions for Arduino
@@ -126,6 +406,24 @@ void log_debug(const char* format, ...);
 void log_trace(const char* format, ...);
 #endif
 
+/**
+ * @brief Read stored messages from a cursor on, oldest first
+ *
+ * Lines are formatted like the console output, without colors, and the
+ * buffer is NUL-terminated. Reading stops at the first line that does not
+ * fit. The cost grows with the messages read, not with the size of the
+ * store. Callers that log block while the read runs.
+ *
+ * @param cursor In: sequence number of the first message wanted, 0 for the
+ *               oldest kept. Out: sequence number to pass to the next call.
+ *               A cursor below LogStats.memoryFirstSequence lost messages.
+ * @param maxLevel Most verbose level returned; others are skipped
+ * @param buffer Buffer for the lines
+ * @param bufferSize Size of buffer
+ * @return int Number of messages copied, -1 on invalid arguments
+ */
+int log_read_memory_entries(uint32_t* cursor, LogLevel maxLevel, char* buffer, size_t bufferSize);
+
 /**
  * @brief Get memory buffer log entries
  * 
@@ -137,8 +435,10 @@ int log_get_memory_entries(char* buffer, size_t bufferSize);
 
 /**
  * @brief Clear memory buffer log entries
+ *
+ * Sequence numbers continue, so cursors stay valid.
  * 
- * @return int 0 on success, negative error code on failure
+ * @return int Number of entries cleared
  */
 int log_clear_memory_entries(void);
 
@@ -151,6 +451,8 @@ int log_get_memory_entry_count(void);
 
 /**
  * @brief Flush log outputs
+ *
+ * Drains queued messages in asynchronous mode, then flushes the outputs.
  * 
  * @return int 0 on success, negative error code on failure
  */
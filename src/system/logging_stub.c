@@ -18,6 +18,9 @@ static LogConfig s_log_config = {
     .customLogCallback = NULL
 };
 
+// All zero, so the log macros always call log_message()
+uint8_t log_skip_levels[LOG_MAX_MODULES];
+
 /**
  * @brief Initialize logging system
  */
@@ -136,6 +139,19 @@ const char* log_level_name(LogLevel level) {
     }
 }
 
+/**
+ * @brief Read stored messages from a cursor on
+ */
+int log_read_memory_entries(uint32_t* cursor, LogLevel maxLevel, char* buffer, size_t bufferSize) {
+    // The stub stores nothing
+    (void)maxLevel;
+    if (cursor == NULL || buffer == NULL || bufferSize < 2) {
+        return -1;
+    }
+    buffer[0] = '\0';
+    return 0;
+}
+
 /**
  * @brief Get memory buffer log entries
  */
@@ -172,6 +188,126 @@ int log_get_memory_entry_count(void) {
     return 0;
 }
 
+/**
+ * @brief Switch between synchronous and asynchronous logging
+ */
+int log_set_async(uint32_t queueEntries) {
+    // The stub always logs synchronously
+    (void)queueEntries;
+    return 0;
+}
+
+/**
+ * @brief Drain queued messages to the outputs
+ */
+int log_process(uint32_t maxRecords) {
+    // Nothing is ever queued in the stub
+    (void)maxRecords;
+    return 0;
+}
+
+/**
+ * @brief Queue format strings and raw arguments instead of formatted text
+ */
+bool log_set_deferred(bool deferred) {
+    // The stub always formats at the call site
+    (void)deferred;
+    return false;
+}
+
+/**
+ * @brief Get logging counters
+ */
+void log_get_stats(LogStats* stats) {
+    if (stats != NULL) {
+        memset(stats, 0, sizeof(LogStats));
+    }
+}
+
+/**
+ * @brief Get the ID of a module name
+ */
+int log_module_id(const char* module) {
+    // The stub does not intern module names
+    (void)module;
+    return 0;
+}
+
+/**
+ * @brief Register a module handle
+ */
+int log_register_module(LogModule* module) {
+    // Handles keep ID 0 and log by name
+    return module == NULL ? -1 : 0;
+}
+
+/**
+ * @brief Log a message for a module handle
+ */
+void log_module_message(const LogModule* module, LogLevel level, const char* format, ...) {
+    char message[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    log_message(level, module != NULL ? module->name : NULL, "%s", message);
+}
+
+/**
+ * @brief Set the console level of one module
+ */
+int log_set_module_level(const char* module, LogLevel level) {
+    // The stub has one level for all modules
+    (void)module;
+    (void)level;
+    return -1;
+}
+
+/**
+ * @brief Make a module follow the global console level again
+ */
+int log_clear_module_level(const char* module) {
+    (void)module;
+    return -1;
+}
+
+/**
+ * @brief Get the name of a module ID
+ */
+const char* log_module_name(int moduleId) {
+    (void)moduleId;
+    return "";
+}
+
+/**
+ * @brief Register a structured log sink
+ */
+int log_add_sink(LogSink sink, void* context, LogLevel maxLevel, uint32_t moduleMask) {
+    // The stub has no sinks
+    (void)context;
+    (void)maxLevel;
+    (void)moduleMask;
+    return sink == NULL ? -1 : -2;
+}
+
+/**
+ * @brief Change the filter of a registered sink
+ */
+int log_set_sink_filter(int sinkId, LogLevel maxLevel, uint32_t moduleMask) {
+    (void)sinkId;
+    (void)maxLevel;
+    (void)moduleMask;
+    return -1;
+}
+
+/**
+ * @brief Unregister a sink
+ */
+int log_remove_sink(int sinkId) {
+    (void)sinkId;
+    return -1;
+}
+
 /**
  * @brief Flush log outputs
  */
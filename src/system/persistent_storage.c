@@ -3,6 +3,10 @@
  * @brief Persistent storage implementation for embedded systems
  */
 #include "persistent_storage.h"
+#include "storage_host.h"
+#include "storage_directory.h"
+#include "storage_cache.h"
+#include "storage_codec.h"
 #include "logging.h"
 #include <string.h>
 #include <stdlib.h>
@@ -27,6 +31,7 @@ static bool s_initialized = false;
 // Storage context
 typedef struct {
     StorageType type;
+    StorageLayout layout;
     void* handle;
     bool transaction_active;
     bool compression_enabled;
@@ -34,32 +39,23 @@ typedef struct {
 
 static StorageContext s_context = {0};
 
-// Key directory structure (for EEPROM/Flash storage)
-#define MAX_KEYS 32
-#define MAX_KEY_LENGTH 32
-
-typedef struct {
-    char key[MAX_KEY_LENGTH];
-    uint32_t address;
-    uint32_t size;
-} KeyEntry;
-
-typedef struct {
-    uint32_t magic;         // Magic number to identify valid directory
-    uint32_t version;       // Directory format version
-    uint32_t keyCount;      // Number of keys in directory
-    KeyEntry entries[MAX_KEYS]; // Key entries
-} KeyDirectory;
-
-#define DIRECTORY_MAGIC 0x5073746F // "Psto" in ASCII
-#define DIRECTORY_VERSION 1
-#define DIRECTORY_SIZE sizeof(KeyDirectory)
-#define DIRECTORY_ADDRESS 0
-
 // Memory-backed storage (for testing)
 #define MEM_STORAGE_SIZE (64 * 1024) // 64 KB
 static uint8_t* s_memStorage = NULL;
 
+// Directory or log layout over the memory-backed storage, which s_medium
+// wraps to count media writes
+static StorageMedium s_rawMedium;
+static StorageMedium s_medium;
+static StorageDirectory* s_directory = NULL;
+static StorageLog* s_log = NULL;
+static StorageFtl* s_ftl = NULL;
+static StorageMedium s_ftlMedium;  // Logical medium of s_ftl, under the layout
+
+// Host backing: an image file mapped as the memory-backed storage, or one file per key
+static StorageImage s_image = {0};
+static StorageFiles* s_files = NULL;
+
 // Forward declarations for platform-specific implementations
 static int storage_init_eeprom(const StorageConfig* config);
 static int storage_init_flash(const StorageConfig* config);
@@ -91,11 +87,11 @@ static int storage_delete_sd_card(const char* key);
 static int storage_delete_file_system(const char* key);
 static int storage_delete_nvs(const char* key);
 
-static int storage_get_keys_eeprom(char** keys, size_t maxKeys);
-static int storage_get_keys_flash(char** keys, size_t maxKeys);
-static int storage_get_keys_sd_card(char** keys, size_t maxKeys);
-static int storage_get_keys_file_system(char** keys, size_t maxKeys);
-static int storage_get_keys_nvs(char** keys, size_t maxKeys);
+static int storage_get_keys_eeprom(const char* prefix, char** keys, size_t maxKeys);
+static int storage_get_keys_flash(const char* prefix, char** keys, size_t maxKeys);
+static int storage_get_keys_sd_card(const char* prefix, char** keys, size_t maxKeys);
+static int storage_get_keys_file_system(const char* prefix, char** keys, size_t maxKeys);
+static int storage_get_keys_nvs(const char* prefix, char** keys, size_t maxKeys);
 
 static int storage_get_size_eeprom(const char* key);
 static int storage_get_size_flash(const char* key);
@@ -103,21 +99,38 @@ static int storage_get_size_sd_card(const char* key);
 static int storage_get_size_file_system(const char* key);
 static int storage_get_size_nvs(const char* key);
 
-// Directory management for EEPROM/Flash
-static KeyDirectory s_directory = {0};
-static bool s_directoryLoaded = false;
+// Write-behind cache: writes and deletes staged until the next group commit
+static StorageCache* s_cache = NULL;
+static bool s_cacheAging = false;   // A poll has seen the cache holding entries
+static uint32_t s_cacheSinceMs = 0; // Time of that poll
+static StorageWriteStats s_writeStats = {0};
 
 // Helper functions
-static int load_directory(void);
-static int save_directory(void);
-static int find_key_entry(const char* key);
-static int add_key_entry(const char* key, uint32_t address, uint32_t size);
-static int remove_key_entry(const char* key);
-static uint32_t allocate_storage(size_t size);
-
-// Compression helpers (simple RLE implementation)
-static size_t compress_data(const void* data, size_t size, void* compressedData, size_t maxCompressedSize);
-static size_t decompress_data(const void* compressedData, size_t compressedSize, void* data, size_t maxSize);
+static int sync_media(void);
+static void init_counted_medium(uint8_t* buffer, uint32_t size);
+
+// Backend dispatch by storage type
+static int backend_write(const char* key, const void* data, size_t size);
+static int backend_read(const char* key, void* data, size_t maxSize, size_t* actualSize);
+static bool backend_exists(const char* key);
+static int backend_delete(const char* key);
+static int backend_get_keys(const char* prefix, char** keys, size_t maxKeys);
+static int backend_get_size(const char* key);
+static int backend_begin_group(void);
+static int backend_end_group(bool apply);
+
+// Write-behind cache helpers
+static bool caching(void);
+static int stage_write(const char* key, const void* data, size_t size);
+static int stage_delete(const char* key);
+static int commit_if_full(void);
+static int flush_cache(void);
+static int merge_cached_keys(const char* prefix, char** keys, size_t count, size_t maxKeys);
+
+// Compression helpers
+static int stored_size(const char* key);
+static int read_stored(const char* key, void* data, size_t maxSize, size_t* actualSize);
+static int read_decoded(const char* key, void* data, size_t maxSize, size_t* actualSize);
 
 /**
  * @brief Initialize persistent storage
@@ -136,8 +149,15 @@ int persistent_storage_init(const StorageConfig* config) {
     
     // Initialize context
     s_context.type = config->type;
+    s_context.layout = config->layout;
+    if (s_context.layout == STORAGE_LAYOUT_DEFAULT) {
+        // Flash cannot be rewritten in place, so it gets the log by default
+        s_context.layout = config->type == STORAGE_TYPE_FLASH ? STORAGE_LAYOUT_LOG : STORAGE_LAYOUT_DIRECTORY;
+    }
     s_context.transaction_active = false;
     s_context.compression_enabled = false;
+    memset(&s_writeStats, 0, sizeof(s_writeStats));
+    s_cacheAging = false;
     
     // Initialize storage based on type
     int result = 0;
@@ -185,7 +205,11 @@ int persistent_storage_deinit(void) {
     // Commit any pending changes
     if (s_context.transaction_active) {
         persistent_storage_end_transaction();
+    } else if (storage_cache_count(s_cache) > 0) {
+        persistent_storage_commit();
     }
+    storage_cache_destroy(s_cache);
+    s_cache = NULL;
     
     // Clean up based on storage type
     switch (s_context.type) {
@@ -202,7 +226,11 @@ int persistent_storage_deinit(void) {
             break;
             
         case STORAGE_TYPE_FILE_SYSTEM:
-            // Unmount file system if needed
+            if (s_files != NULL) {
+                sync_media();
+                storage_files_close(s_files);
+                s_files = NULL;
+            }
             break;
             
         case STORAGE_TYPE_NVS:
@@ -220,11 +248,26 @@ int persistent_storage_deinit(void) {
     }
     
     // Free memory-backed storage if allocated
-    if (s_memStorage != NULL) {
+    if (s_log != NULL) {
+        storage_log_unmount(s_log);
+        s_log = NULL;
+    }
+    if (s_directory != NULL) {
+        storage_directory_unmount(s_directory);
+        s_directory = NULL;
+    }
+    if (s_ftl != NULL) {
+        storage_ftl_unmount(s_ftl);
+        s_ftl = NULL;
+    }
+    if (s_image.data != NULL) {
+        sync_media();
+        storage_image_close(&s_image);
+        s_memStorage = NULL;
+    } else if (s_memStorage != NULL) {
         free(s_memStorage);
         s_memStorage = NULL;
     }
-    
     s_initialized = false;
     return 0;
 }
@@ -242,60 +285,44 @@ int persistent_storage_write(const char* key, const void* data, size_t size) {
         return -2;
     }
     
-    // Compress data if enabled
-    void* dataToWrite = (void*)data;
+    // Compress data if enabled and it saves space
+    const void* dataToWrite = data;
     size_t sizeToWrite = size;
+    void* encoded = NULL;
     
-    if (s_context.compression_enabled && size > 16) { // Only compress if data is large enough
-        void* compressedData = malloc(size); // Allocate buffer for compressed data
-        if (compressedData == NULL) {
+    if (s_context.compression_enabled) {
+        encoded = malloc(storage_codec_bound(size));
+        if (encoded == NULL) {
             return -3; // Memory allocation failed
         }
         
-        size_t compressedSize = compress_data(data, size, compressedData, size);
-        if (compressedSize > 0 && compressedSize < size) {
-            // Use compressed data
-            dataToWrite = compressedData;
-            sizeToWrite = compressedSize;
+        size_t encodedSize = storage_codec_encode(data, size, encoded, storage_codec_bound(size));
+        if (encodedSize > 0) {
+            dataToWrite = encoded;
+            sizeToWrite = encodedSize;
         }
     }
     
-    // Write data based on storage type
+    // Stage the write, or write it through to the backend
     int result = 0;
+    bool staged = caching();
     
-    switch (s_context.type) {
-        case STORAGE_TYPE_EEPROM:
-            result = storage_write_eeprom(key, dataToWrite, sizeToWrite);
-            break;
-            
-        case STORAGE_TYPE_FLASH:
-            result = storage_write_flash(key, dataToWrite, sizeToWrite);
-            break;
-            
-        case STORAGE_TYPE_SD_CARD:
-            result = storage_write_sd_card(key, dataToWrite, sizeToWrite);
-            break;
-            
-        case STORAGE_TYPE_FILE_SYSTEM:
-            result = storage_write_file_system(key, dataToWrite, sizeToWrite);
-            break;
-            
-        case STORAGE_TYPE_NVS:
-            result = storage_write_nvs(key, dataToWrite, sizeToWrite);
-            break;
-            
-        default:
-            result = -4; // Unknown storage type
+    if (staged) {
+        result = stage_write(key, dataToWrite, sizeToWrite);
+    } else {
+        result = backend_write(key, dataToWrite, sizeToWrite);
     }
+    s_writeStats.writes++;
     
-    // Free compressed data if allocated
-    if (dataToWrite != data) {
-        free(dataToWrite);
-    }
+    free(encoded);
     
     // Auto-commit if not in transaction
-    if (result == 0 && !s_context.transaction_active) {
-        persistent_storage_commit();
+    if (result == 0 && staged) {
+        result = commit_if_full();
+    } else if (result == 0 && !s_context.transaction_active) {
+        result = persistent_storage_commit();
+    } else if (result == 0 && s_config.syncPolicy == STORAGE_SYNC_ALWAYS) {
+        result = sync_media();
     }
     
     return result;
@@ -314,66 +341,12 @@ int persistent_storage_read(const char* key, void* data, size_t maxSize, size_t*
         return -2; // Key not found
     }
     
-    // Read data based on storage type
-    int result = 0;
-    
-    switch (s_context.type) {
-        case STORAGE_TYPE_EEPROM:
-            result = storage_read_eeprom(key, data, maxSize, actualSize);
-            break;
-            
-        case STORAGE_TYPE_FLASH:
-            result = storage_read_flash(key, data, maxSize, actualSize);
-            break;
-            
-        case STORAGE_TYPE_SD_CARD:
-            result = storage_read_sd_card(key, data, maxSize, actualSize);
-            break;
-            
-        case STORAGE_TYPE_FILE_SYSTEM:
-            result = storage_read_file_system(key, data, maxSize, actualSize);
-            break;
-            
-        case STORAGE_TYPE_NVS:
-            result = storage_read_nvs(key, data, maxSize, actualSize);
-            break;
-            
-        default:
-            result = -3; // Unknown storage type
-    }
-    
-    // Decompress data if needed
-    if (result == 0 && s_context.compression_enabled) {
-        // Check for compression marker (simplified approach)
-        uint8_t* byteData = (uint8_t*)data;
-        if (byteData[0] == 0xAB && byteData[1] == 0xCD) { // Compression marker
-            // This is compressed data
-            void* decompressedData = malloc(maxSize);
-            if (decompressedData == NULL) {
-                return -4; // Memory allocation failed
-            }
-            
-            size_t decompressedSize = decompress_data(data, *actualSize, decompressedData, maxSize);
-            if (decompressedSize > 0) {
-                // Copy decompressed data back to buffer
-                if (decompressedSize <= maxSize) {
-                    memcpy(data, decompressedData, decompressedSize);
-                    *actualSize = decompressedSize;
-                } else {
-                    // Buffer too small for decompressed data
-                    memcpy(data, decompressedData, maxSize);
-                    *actualSize = maxSize;
-                    result = -5;
-                }
-            } else {
-                result = -6; // Decompression failed
-            }
-            
-            free(decompressedData);
-        }
+    // Compressed values are decoded into the caller's buffer
+    if (s_context.compression_enabled) {
+        return read_decoded(key, data, maxSize, actualSize);
     }
     
-    return result;
+    return read_stored(key, data, maxSize, actualSize);
 }
 
 /**
@@ -384,26 +357,13 @@ bool persistent_storage_exists(const char* key) {
         return false;
     }
     
-    // Check if key exists based on storage type
-    switch (s_context.type) {
-        case STORAGE_TYPE_EEPROM:
-            return storage_exists_eeprom(key);
-            
-        case STORAGE_TYPE_FLASH:
-            return storage_exists_flash(key);
-            
-        case STORAGE_TYPE_SD_CARD:
-            return storage_exists_sd_card(key);
-            
-        case STORAGE_TYPE_FILE_SYSTEM:
-            return storage_exists_file_system(key);
-            
-        case STORAGE_TYPE_NVS:
-            return storage_exists_nvs(key);
-            
-        default:
-            return false;
+    // A pending write or delete decides before the backend
+    StorageCacheEntry cached;
+    if (storage_cache_find(s_cache, key, &cached)) {
+        return !cached.deleted;
     }
+    
+    return backend_exists(key);
 }
 
 /**
@@ -419,37 +379,24 @@ int persistent_storage_delete(const char* key) {
         return -2;
     }
     
-    // Delete key based on storage type
+    // Stage the delete, or apply it to the backend
     int result = 0;
+    bool staged = caching();
     
-    switch (s_context.type) {
-        case STORAGE_TYPE_EEPROM:
-            result = storage_delete_eeprom(key);
-            break;
-            
-        case STORAGE_TYPE_FLASH:
-            result = storage_delete_flash(key);
-            break;
-            
-        case STORAGE_TYPE_SD_CARD:
-            result = storage_delete_sd_card(key);
-            break;
-            
-        case STORAGE_TYPE_FILE_SYSTEM:
-            result = storage_delete_file_system(key);
-            break;
-            
-        case STORAGE_TYPE_NVS:
-            result = storage_delete_nvs(key);
-            break;
-            
-        default:
-            result = -3; // Unknown storage type
+    if (staged) {
+        result = stage_delete(key);
+    } else {
+        result = backend_delete(key);
     }
+    s_writeStats.writes++;
     
     // Auto-commit if not in transaction
-    if (result == 0 && !s_context.transaction_active) {
-        persistent_storage_commit();
+    if (result == 0 && staged) {
+        result = commit_if_full();
+    } else if (result == 0 && !s_context.transaction_active) {
+        result = persistent_storage_commit();
+    } else if (result == 0 && s_config.syncPolicy == STORAGE_SYNC_ALWAYS) {
+        result = sync_media();
     }
     
     return result;
@@ -459,30 +406,23 @@ int persistent_storage_delete(const char* key) {
  * @brief Get all keys in persistent storage
  */
 int persistent_storage_get_keys(char** keys, size_t maxKeys) {
+    return persistent_storage_get_keys_with_prefix(NULL, keys, maxKeys);
+}
+
+/**
+ * @brief Get the keys starting with a prefix
+ */
+int persistent_storage_get_keys_with_prefix(const char* prefix, char** keys, size_t maxKeys) {
     if (!s_initialized || keys == NULL || maxKeys == 0) {
         return -1;
     }
     
-    // Get keys based on storage type
-    switch (s_context.type) {
-        case STORAGE_TYPE_EEPROM:
-            return storage_get_keys_eeprom(keys, maxKeys);
-            
-        case STORAGE_TYPE_FLASH:
-            return storage_get_keys_flash(keys, maxKeys);
-            
-        case STORAGE_TYPE_SD_CARD:
-            return storage_get_keys_sd_card(keys, maxKeys);
-            
-        case STORAGE_TYPE_FILE_SYSTEM:
-            return storage_get_keys_file_system(keys, maxKeys);
-            
-        case STORAGE_TYPE_NVS:
-            return storage_get_keys_nvs(keys, maxKeys);
-            
-        default:
-            return -2; // Unknown storage type
+    int count = backend_get_keys(prefix, keys, maxKeys);
+    if (count < 0 || storage_cache_count(s_cache) == 0) {
+        return count;
     }
+    
+    return merge_cached_keys(prefix, keys, (size_t)count, maxKeys);
 }
 
 /**
@@ -498,26 +438,18 @@ int persistent_storage_get_size(const char* key) {
         return -2; // Key not found
     }
     
-    // Get size based on storage type
-    switch (s_context.type) {
-        case STORAGE_TYPE_EEPROM:
-            return storage_get_size_eeprom(key);
-            
-        case STORAGE_TYPE_FLASH:
-            return storage_get_size_flash(key);
-            
-        case STORAGE_TYPE_SD_CARD:
-            return storage_get_size_sd_card(key);
-            
-        case STORAGE_TYPE_FILE_SYSTEM:
-            return storage_get_size_file_system(key);
-            
-        case STORAGE_TYPE_NVS:
-            return storage_get_size_nvs(key);
-            
-        default:
-            return -3; // Unknown storage type
+    // Compressed values report their original size
+    if (s_context.compression_enabled) {
+        uint8_t header[STORAGE_CODEC_HEADER_SIZE];
+        size_t headerSize = 0;
+        size_t originalSize = 0;
+        if (read_stored(key, header, sizeof(header), &headerSize) == 0 &&
+            storage_codec_parse_header(header, headerSize, NULL, &originalSize)) {
+            return (int)originalSize;
+        }
     }
+    
+    return stored_size(key);
 }
 
 /**
@@ -528,18 +460,24 @@ int persistent_storage_commit(void) {
         return -1;
     }
     
+    // Staged writes go to the backend first so they share this commit
+    int flushResult = flush_cache();
+    
+    // Log records are complete on append, only the medium needs flushing
+    if (s_log != NULL) {
+        int result = storage_log_sync(s_log);
+        result = result == 0 ? sync_media() : result;
+        return flushResult != 0 ? flushResult : result;
+    }
+    
     // Commit changes based on storage type
     int result = 0;
     
     switch (s_context.type) {
         case STORAGE_TYPE_EEPROM:
-            // Save directory for EEPROM
-            result = save_directory();
-            break;
-            
         case STORAGE_TYPE_FLASH:
-            // Save directory for flash
-            result = save_directory();
+            // Write back the directory slots changed since the last commit
+            result = storage_directory_commit(s_directory);
             break;
             
         case STORAGE_TYPE_SD_CARD:
@@ -547,7 +485,7 @@ int persistent_storage_commit(void) {
             break;
             
         case STORAGE_TYPE_FILE_SYSTEM:
-            // Nothing to do for file system
+            // Key files are flushed by sync_media below
             break;
             
         case STORAGE_TYPE_NVS:
@@ -563,7 +501,11 @@ int persistent_storage_commit(void) {
             result = -2; // Unknown storage type
     }
     
-    return result;
+    if (result == 0) {
+        result = sync_media();
+    }
+    
+    return flushResult != 0 ? flushResult : result;
 }
 
 /**
@@ -579,26 +521,22 @@ int persistent_storage_clear(void) {
         return -2;
     }
     
+    // Staged writes would only land on the cleared storage
+    storage_cache_clear(s_cache);
+    s_cacheAging = false;
+    
+    if (s_log != NULL) {
+        return storage_log_clear(s_log);
+    }
+    
     // Clear storage based on type
     int result = 0;
     
     switch (s_context.type) {
         case STORAGE_TYPE_EEPROM:
-            // Clear directory for EEPROM
-            memset(&s_directory, 0, sizeof(s_directory));
-            s_directory.magic = DIRECTORY_MAGIC;
-            s_directory.version = DIRECTORY_VERSION;
-            s_directory.keyCount = 0;
-            result = save_directory();
-            break;
-            
         case STORAGE_TYPE_FLASH:
-            // Clear directory for flash
-            memset(&s_directory, 0, sizeof(s_directory));
-            s_directory.magic = DIRECTORY_MAGIC;
-            s_directory.version = DIRECTORY_VERSION;
-            s_directory.keyCount = 0;
-            result = save_directory();
+            // Write an empty directory
+            result = storage_directory_clear(s_directory);
             break;
             
         case STORAGE_TYPE_SD_CARD:
@@ -606,7 +544,9 @@ int persistent_storage_clear(void) {
             break;
             
         case STORAGE_TYPE_FILE_SYSTEM:
-            // Would need to delete all files
+            if (s_files != NULL) {
+                result = storage_files_clear(s_files);
+            }
             break;
             
         case STORAGE_TYPE_NVS:
@@ -643,36 +583,18 @@ int persistent_storage_get_free_space(void) {
         return -1;
     }
     
+    if (s_log != NULL) {
+        return storage_log_get_free_space(s_log);
+    }
+    
     // Calculate free space based on storage type
     int freeSpace = 0;
     
     switch (s_context.type) {
         case STORAGE_TYPE_EEPROM:
-            // Calculate free space for EEPROM
-            if (load_directory() == 0) {
-                uint32_t usedSpace = DIRECTORY_SIZE;
-                for (uint32_t i = 0; i < s_directory.keyCount; i++) {
-                    usedSpace += s_directory.entries[i].size;
-                }
-                freeSpace = s_config.size - usedSpace;
-                if (freeSpace < 0) {
-                    freeSpace = 0;
-                }
-            }
-            break;
-            
         case STORAGE_TYPE_FLASH:
-            // Calculate free space for flash
-            if (load_directory() == 0) {
-                uint32_t usedSpace = DIRECTORY_SIZE;
-                for (uint32_t i = 0; i < s_directory.keyCount; i++) {
-                    usedSpace += s_directory.entries[i].size;
-                }
-                freeSpace = s_config.size - usedSpace;
-                if (freeSpace < 0) {
-                    freeSpace = 0;
-                }
-            }
+            // Data area not held by values
+            freeSpace = storage_directory_get_free_space(s_directory);
             break;
             
         case STORAGE_TYPE_SD_CARD:
@@ -681,8 +603,11 @@ int persistent_storage_get_free_space(void) {
             break;
             
         case STORAGE_TYPE_FILE_SYSTEM:
-            // Would need to check file system free space
-            freeSpace = -2; // Not implemented
+            if (s_files != NULL) {
+                freeSpace = storage_files_get_free_space(s_files);
+            } else {
+                freeSpace = -2; // Not implemented
+            }
             break;
             
         case STORAGE_TYPE_NVS:
@@ -709,10 +634,16 @@ int persistent_storage_get_total_space(void) {
     switch (s_context.type) {
         case STORAGE_TYPE_EEPROM:
         case STORAGE_TYPE_FLASH:
-            return s_config.size;
+            // Spare blocks of the translation layer do not hold data
+            return s_ftl != NULL ? (int)s_ftlMedium.size : (int)s_config.size;
             
-        case STORAGE_TYPE_SD_CARD:
         case STORAGE_TYPE_FILE_SYSTEM:
+            if (s_files != NULL) {
+                return storage_files_get_total_space(s_files);
+            }
+            return -2; // Not implemented
+            
+        case STORAGE_TYPE_SD_CARD:
         case STORAGE_TYPE_NVS:
             // Would need to check total space
             return -2; // Not implemented
@@ -735,6 +666,15 @@ int persistent_storage_begin_transaction(void) {
         return -2;
     }
     
+    // Commit earlier write-behind entries so the transaction's group holds
+    // only its own, and a failed transaction drops nothing else
+    if (storage_cache_count(s_cache) > 0) {
+        int result = persistent_storage_commit();
+        if (result != 0) {
+            return result;
+        }
+    }
+    
     s_context.transaction_active = true;
     return 0;
 }
@@ -752,9 +692,14 @@ int persistent_storage_end_transaction(void) {
         return -2;
     }
     
-    // Commit changes
+    // Commit changes; a transaction that fails is dropped as a whole rather
+    // than retried by a later commit
     int result = persistent_storage_commit();
     s_context.transaction_active = false;
+    if (result != 0) {
+        storage_cache_clear(s_cache);
+        s_cacheAging = false;
+    }
     
     return result;
 }
@@ -771,157 +716,204 @@ int persistent_storage_set_compression(bool enable) {
     return 0;
 }
 
-// ===== Platform-specific implementations =====
-
-// --- EEPROM storage implementation ---
-static int storage_init_eeprom(const StorageConfig* config) {
-    // Allocate memory-backed storage for testing
-    s_memStorage = (uint8_t*)malloc(config->size);
-    if (s_memStorage == NULL) {
+/**
+ * @brief Reclaim space held by overwritten and deleted records
+ */
+int persistent_storage_compact(uint32_t maxSegments) {
+    if (!s_initialized) {
         return -1;
     }
     
-    // Clear storage
-    memset(s_memStorage, 0xFF, config->size);
-    
-    // Initialize directory
-    load_directory();
+    if (s_log == NULL) {
+        return 0; // Directory layout reuses space in place
+    }
     
-    return 0;
+    return storage_log_compact(s_log, maxSegments);
 }
 
-static int storage_write_eeprom(const char* key, const void* data, size_t size) {
-    // Load directory if needed
-    if (!s_directoryLoaded) {
-        if (load_directory() != 0) {
-            return -1;
-        }
-    }
-    
-    // Check if key already exists
-    int keyIndex = find_key_entry(key);
-    if (keyIndex >= 0) {
-        // Key exists, check if we can overwrite in place
-        if (s_directory.entries[keyIndex].size >= size) {
-            // Can overwrite in place
-            uint32_t address = s_directory.entries[keyIndex].address;
-            memcpy(s_memStorage + address, data, size);
-            s_directory.entries[keyIndex].size = size;
-        } else {
-            // Need to allocate new space
-            storage_delete_eeprom(key);
-            // Fall through to allocate new space
-            keyIndex = -1;
-        }
+/**
+ * @brief Get log store counters
+ */
+int persistent_storage_get_log_stats(StorageLogStats* stats) {
+    if (!s_initialized || stats == NULL) {
+        return -1;
     }
     
-    if (keyIndex < 0) {
-        // Allocate space for data
-        uint32_t address = allocate_storage(size);
-        if (address == 0) {
-            return -2; // Out of space
-        }
-        
-        // Write data
-        memcpy(s_memStorage + address, data, size);
-        
-        // Add key to directory
-        if (add_key_entry(key, address, size) != 0) {
-            return -3; // Directory full
-        }
+    if (s_log == NULL) {
+        return -2; // Not using the log layout
     }
     
+    storage_log_get_stats(s_log, stats);
     return 0;
 }
 
-static int storage_read_eeprom(const char* key, void* data, size_t maxSize, size_t* actualSize) {
-    // Load directory if needed
-    if (!s_directoryLoaded) {
-        if (load_directory() != 0) {
-            return -1;
-        }
-    }
-    
-    // Find key in directory
-    int keyIndex = find_key_entry(key);
-    if (keyIndex < 0) {
-        return -2; // Key not found
+/**
+ * @brief Get flash translation layer counters
+ */
+int persistent_storage_get_ftl_stats(StorageFtlStats* stats) {
+    if (!s_initialized || stats == NULL) {
+        return -1;
     }
     
-    // Read data
-    uint32_t address = s_directory.entries[keyIndex].address;
-    uint32_t size = s_directory.entries[keyIndex].size;
-    
-    *actualSize = size <= maxSize ? size : maxSize;
-    memcpy(data, s_memStorage + address, *actualSize);
-    
-    return 0;
-}
-
-static bool storage_exists_eeprom(const char* key) {
-    // Load directory if needed
-    if (!s_directoryLoaded) {
-        if (load_directory() != 0) {
-            return false;
-        }
+    if (s_ftl == NULL) {
+        return -2; // Not using the translation layer
     }
     
-    return find_key_entry(key) >= 0;
+    return storage_ftl_get_stats(s_ftl, stats);
 }
 
-static int storage_delete_eeprom(const char* key) {
-    // Load directory if needed
-    if (!s_directoryLoaded) {
-        if (load_directory() != 0) {
-            return -1;
-        }
+/**
+ * @brief Commit the write-behind cache once it has waited long enough
+ */
+int persistent_storage_poll(uint32_t nowMs) {
+    if (!s_initialized) {
+        return -1;
     }
     
-    // Find key in directory
-    int keyIndex = find_key_entry(key);
-    if (keyIndex < 0) {
-        return -2; // Key not found
+    if (s_context.transaction_active || storage_cache_count(s_cache) == 0) {
+        return 0;
     }
     
-    // Remove key from directory
-    return remove_key_entry(key);
-}
-
-static int storage_get_keys_eeprom(char** keys, size_t maxKeys) {
-    // Load directory if needed
-    if (!s_directoryLoaded) {
-        if (load_directory() != 0) {
-            return -1;
-        }
+    // The wait starts at the first poll that sees cached entries
+    if (!s_cacheAging) {
+        s_cacheAging = true;
+        s_cacheSinceMs = nowMs;
     }
     
-    // Copy keys
-    size_t count = 0;
-    for (uint32_t i = 0; i < s_directory.keyCount && count < maxKeys; i++) {
-        keys[count] = strdup(s_directory.entries[i].key);
-        if (keys[count] != NULL) {
-            count++;
-        }
+    if (s_config.writeBehindDelayMs == 0 || nowMs - s_cacheSinceMs < s_config.writeBehindDelayMs) {
+        return 0;
     }
     
-    return count;
+    int result = persistent_storage_commit();
+    return result == 0 ? 1 : result;
 }
 
-static int storage_get_size_eeprom(const char* key) {
-    // Load directory if needed
-    if (!s_directoryLoaded) {
-        if (load_directory() != 0) {
-            return -1;
-        }
+/**
+ * @brief Get write path counters
+ */
+int persistent_storage_get_write_stats(StorageWriteStats* stats) {
+    if (!s_initialized || stats == NULL) {
+        return -1;
     }
     
-    // Find key in directory
-    int keyIndex = find_key_entry(key);
-    if (keyIndex < 0) {
-        return -2; // Key not found
+    *stats = s_writeStats;
+    stats->pendingEntries = storage_cache_count(s_cache);
+    stats->pendingBytes = (uint32_t)storage_cache_bytes(s_cache);
+    return 0;
+}
+
+// ===== Platform-specific implementations =====
+
+// --- EEPROM storage implementation ---
+// This is the memory-backed implementation the other platforms fall back to.
+// With the log layout, key operations go to the log store mounted on it.
+static int storage_init_eeprom(const StorageConfig* config) {
+#ifdef STORAGE_HOST_POSIX
+    if (config->imagePath != NULL) {
+        // Map the image file so the contents survive a restart
+        if (storage_image_open(&s_image, config->imagePath, config->size) != 0) {
+            return -3;
+        }
+        s_memStorage = s_image.data;
+    } else
+#endif
+    {
+        // Allocate memory-backed storage for testing; without a POSIX file
+        // system an image path is ignored
+        s_memStorage = (uint8_t*)malloc(config->size);
+        if (s_memStorage == NULL) {
+            return -1;
+        }
+        
+        // Clear storage
+        memset(s_memStorage, 0xFF, config->size);
+    }
+    
+    // Flash with a known erase block size gets the translation layer beneath the layout
+    init_counted_medium(s_memStorage, config->size);
+    const StorageMedium* layoutMedium = &s_medium;
+    if (config->eraseBlockSize > 0) {
+        StorageFtlConfig ftlConfig;
+        memset(&ftlConfig, 0, sizeof(ftlConfig));
+        ftlConfig.blockSize = config->eraseBlockSize;
+        
+        s_ftl = storage_ftl_mount(&s_medium, &ftlConfig);
+        if (s_ftl != NULL) {
+            storage_ftl_get_medium(s_ftl, &s_ftlMedium);
+            layoutMedium = &s_ftlMedium;
+        }
+    }
+    
+    // Mount the layout, picking up whatever the medium already holds
+    if (config->eraseBlockSize == 0 || s_ftl != NULL) {
+        if (s_context.layout == STORAGE_LAYOUT_LOG) {
+            s_log = storage_log_mount(layoutMedium, config->segmentSize);
+        } else {
+            s_directory = storage_directory_mount(layoutMedium, config->maxKeys);
+        }
+    }
+    
+    if (s_log == NULL && s_directory == NULL) {
+        storage_ftl_unmount(s_ftl);
+        s_ftl = NULL;
+        if (s_image.data != NULL) {
+            storage_image_close(&s_image);
+        } else {
+            free(s_memStorage);
+        }
+        s_memStorage = NULL;
+        return -2;
+    }
+    
+    return 0;
+}
+
+static int storage_write_eeprom(const char* key, const void* data, size_t size) {
+    if (s_log != NULL) {
+        return storage_log_write(s_log, key, data, size);
+    }
+    
+    return storage_directory_write(s_directory, key, data, size);
+}
+
+static int storage_read_eeprom(const char* key, void* data, size_t maxSize, size_t* actualSize) {
+    if (s_log != NULL) {
+        return storage_log_read(s_log, key, data, maxSize, actualSize);
+    }
+    
+    return storage_directory_read(s_directory, key, data, maxSize, actualSize);
+}
+
+static bool storage_exists_eeprom(const char* key) {
+    if (s_log != NULL) {
+        return storage_log_exists(s_log, key);
+    }
+    
+    return storage_directory_exists(s_directory, key);
+}
+
+static int storage_delete_eeprom(const char* key) {
+    if (s_log != NULL) {
+        return storage_log_delete(s_log, key);
+    }
+    
+    return storage_directory_delete(s_directory, key);
+}
+
+static int storage_get_keys_eeprom(const char* prefix, char** keys, size_t maxKeys) {
+    if (s_log != NULL) {
+        return storage_log_get_keys(s_log, prefix, keys, maxKeys);
+    }
+    
+    return storage_directory_get_keys(s_directory, prefix, keys, maxKeys);
+}
+
+static int storage_get_size_eeprom(const char* key) {
+    if (s_log != NULL) {
+        return storage_log_get_size(s_log, key);
     }
     
-    return s_directory.entries[keyIndex].size;
+    return storage_directory_get_size(s_directory, key);
 }
 
 // --- Flash storage implementation ---
@@ -947,8 +939,8 @@ static int storage_delete_flash(const char* key) {
     return storage_delete_eeprom(key);
 }
 
-static int storage_get_keys_flash(char** keys, size_t maxKeys) {
-    return storage_get_keys_eeprom(keys, maxKeys);
+static int storage_get_keys_flash(const char* prefix, char** keys, size_t maxKeys) {
+    return storage_get_keys_eeprom(prefix, keys, maxKeys);
 }
 
 static int storage_get_size_flash(const char* key) {
@@ -982,9 +974,9 @@ static int storage_delete_sd_card(const char* key) {
     return storage_delete_eeprom(key);
 }
 
-static int storage_get_keys_sd_card(char** keys, size_t maxKeys) {
+static int storage_get_keys_sd_card(const char* prefix, char** keys, size_t maxKeys) {
     // In a real implementation, this would list files on SD card
-    return storage_get_keys_eeprom(keys, maxKeys);
+    return storage_get_keys_eeprom(prefix, keys, maxKeys);
 }
 
 static int storage_get_size_sd_card(const char* key) {
@@ -993,39 +985,59 @@ static int storage_get_size_sd_card(const char* key) {
 }
 
 // --- File system storage implementation ---
+// On POSIX hosts with a base path, each key is a file in that directory.
+// Otherwise the memory-backed storage stands in.
 static int storage_init_file_system(const StorageConfig* config) {
-    // In a real implementation, this would initialize file system
-    // For now, reuse memory-backed storage
+#ifdef STORAGE_HOST_POSIX
+    const char* path = config->basePath != NULL ? config->basePath : config->mountPoint;
+    if (path != NULL) {
+        // Values wait in temporary files until a commit flushes them
+        s_files = storage_files_open(path, config->syncPolicy != STORAGE_SYNC_NONE);
+        return s_files != NULL ? 0 : -4;
+    }
+#endif
     return storage_init_eeprom(config);
 }
 
 static int storage_write_file_system(const char* key, const void* data, size_t size) {
-    // In a real implementation, this would write to a file
+    if (s_files != NULL) {
+        return storage_files_write(s_files, key, data, size);
+    }
     return storage_write_eeprom(key, data, size);
 }
 
 static int storage_read_file_system(const char* key, void* data, size_t maxSize, size_t* actualSize) {
-    // In a real implementation, this would read from a file
+    if (s_files != NULL) {
+        return storage_files_read(s_files, key, data, maxSize, actualSize);
+    }
     return storage_read_eeprom(key, data, maxSize, actualSize);
 }
 
 static bool storage_exists_file_system(const char* key) {
-    // In a real implementation, this would check if file exists
+    if (s_files != NULL) {
+        return storage_files_exists(s_files, key);
+    }
     return storage_exists_eeprom(key);
 }
 
 static int storage_delete_file_system(const char* key) {
-    // In a real implementation, this would delete a file
+    if (s_files != NULL) {
+        return storage_files_delete(s_files, key);
+    }
     return storage_delete_eeprom(key);
 }
 
-static int storage_get_keys_file_system(char** keys, size_t maxKeys) {
-    // In a real implementation, this would list files
-    return storage_get_keys_eeprom(keys, maxKeys);
+static int storage_get_keys_file_system(const char* prefix, char** keys, size_t maxKeys) {
+    if (s_files != NULL) {
+        return storage_files_get_keys(s_files, prefix, keys, maxKeys);
+    }
+    return storage_get_keys_eeprom(prefix, keys, maxKeys);
 }
 
 static int storage_get_size_file_system(const char* key) {
-    // In a real implementation, this would get file size
+    if (s_files != NULL) {
+        return storage_files_get_size(s_files, key);
+    }
     return storage_get_size_eeprom(key);
 }
 
@@ -1163,7 +1175,7 @@ static int storage_delete_nvs(const char* key) {
 #endif
 }
 
-static int storage_get_keys_nvs(char** keys, size_t maxKeys) {
+static int storage_get_keys_nvs(const char* prefix, char** keys, size_t maxKeys) {
 #ifdef ESP32
     // NVS doesn't provide a way to list keys
     // As a workaround, we could store a special key with a list of all keys
@@ -1171,7 +1183,7 @@ static int storage_get_keys_nvs(char** keys, size_t maxKeys) {
     return -1;
 #else
     // ESP32 not supported, fall back to memory-backed storage
-    return storage_get_keys_eeprom(keys, maxKeys);
+    return storage_get_keys_eeprom(prefix, keys, maxKeys);
 #endif
 }
 
@@ -1198,281 +1210,468 @@ static int storage_get_size_nvs(const char* key) {
 // ===== Helper functions =====
 
 /**
- * @brief Load key directory from storage
+ * @brief Flush host files according to the sync policy
  */
-static int load_directory(void) {
-    if (s_memStorage == NULL) {
-        return -1;
+static int sync_media(void) {
+    if (s_config.syncPolicy == STORAGE_SYNC_NONE) {
+        return 0;
     }
     
-    // Read directory
-    memcpy(&s_directory, s_memStorage + DIRECTORY_ADDRESS, DIRECTORY_SIZE);
+    if (s_files != NULL) {
+        return storage_files_sync(s_files);
+    }
     
-    // Check magic number
-    if (s_directory.magic != DIRECTORY_MAGIC) {
-        // Initialize directory
-        memset(&s_directory, 0, sizeof(s_directory));
-        s_directory.magic = DIRECTORY_MAGIC;
-        s_directory.version = DIRECTORY_VERSION;
-        s_directory.keyCount = 0;
-        
-        // Write directory
-        if (save_directory() != 0) {
-            return -2;
-        }
+    if (s_image.data != NULL) {
+        return storage_image_sync(&s_image);
     }
     
-    s_directoryLoaded = true;
     return 0;
 }
 
+// Forward the memory medium's operations, counting writes
+static int counted_read(void* context, uint32_t offset, void* data, size_t size) {
+    (void)context;
+    return s_rawMedium.read(s_rawMedium.context, offset, data, size);
+}
+
+static int counted_write(void* context, uint32_t offset, const void* data, size_t size) {
+    (void)context;
+    s_writeStats.mediaWrites++;
+    s_writeStats.mediaBytesWritten += size;
+    return s_rawMedium.write(s_rawMedium.context, offset, data, size);
+}
+
+static int counted_erase(void* context, uint32_t offset, uint32_t size) {
+    (void)context;
+    return s_rawMedium.erase(s_rawMedium.context, offset, size);
+}
+
 /**
- * @brief Save key directory to storage
+ * @brief Set up s_medium over the memory-backed storage
  */
-static int save_directory(void) {
-    if (s_memStorage == NULL) {
-        return -1;
-    }
+static void init_counted_medium(uint8_t* buffer, uint32_t size) {
+    storage_medium_init_memory(&s_rawMedium, buffer, size);
+    s_medium = s_rawMedium;
+    s_medium.read = counted_read;
+    s_medium.write = counted_write;
+    s_medium.erase = counted_erase;
+}
+
+/**
+ * @brief Write a value to the backend for the storage type
+ */
+static int backend_write(const char* key, const void* data, size_t size) {
+    int result = 0;
     
-    // Write directory
-    memcpy(s_memStorage + DIRECTORY_ADDRESS, &s_directory, DIRECTORY_SIZE);
+    switch (s_context.type) {
+        case STORAGE_TYPE_EEPROM:
+            result = storage_write_eeprom(key, data, size);
+            break;
+            
+        case STORAGE_TYPE_FLASH:
+            result = storage_write_flash(key, data, size);
+            break;
+            
+        case STORAGE_TYPE_SD_CARD:
+            result = storage_write_sd_card(key, data, size);
+            break;
+            
+        case STORAGE_TYPE_FILE_SYSTEM:
+            result = storage_write_file_system(key, data, size);
+            break;
+            
+        case STORAGE_TYPE_NVS:
+            result = storage_write_nvs(key, data, size);
+            break;
+            
+        default:
+            result = -4; // Unknown storage type
+    }
     
-    return 0;
+    return result;
 }
 
 /**
- * @brief Find key entry in directory
+ * @brief Delete a key from the backend for the storage type
  */
-static int find_key_entry(const char* key) {
-    for (uint32_t i = 0; i < s_directory.keyCount; i++) {
-        if (strcmp(s_directory.entries[i].key, key) == 0) {
-            return i;
-        }
+static int backend_delete(const char* key) {
+    int result = 0;
+    
+    switch (s_context.type) {
+        case STORAGE_TYPE_EEPROM:
+            result = storage_delete_eeprom(key);
+            break;
+            
+        case STORAGE_TYPE_FLASH:
+            result = storage_delete_flash(key);
+            break;
+            
+        case STORAGE_TYPE_SD_CARD:
+            result = storage_delete_sd_card(key);
+            break;
+            
+        case STORAGE_TYPE_FILE_SYSTEM:
+            result = storage_delete_file_system(key);
+            break;
+            
+        case STORAGE_TYPE_NVS:
+            result = storage_delete_nvs(key);
+            break;
+            
+        default:
+            result = -3; // Unknown storage type
     }
     
-    return -1;
+    return result;
 }
 
 /**
- * @brief Add key entry to directory
+ * @brief Read a value from the backend for the storage type
  */
-static int add_key_entry(const char* key, uint32_t address, uint32_t size) {
-    // Check if directory is full
-    if (s_directory.keyCount >= MAX_KEYS) {
-        return -1;
-    }
+static int backend_read(const char* key, void* data, size_t maxSize, size_t* actualSize) {
+    int result = 0;
     
-    // Check if key already exists
-    int keyIndex = find_key_entry(key);
-    if (keyIndex >= 0) {
-        // Update existing entry
-        s_directory.entries[keyIndex].address = address;
-        s_directory.entries[keyIndex].size = size;
-    } else {
-        // Add new entry
-        keyIndex = s_directory.keyCount;
-        strncpy(s_directory.entries[keyIndex].key, key, MAX_KEY_LENGTH - 1);
-        s_directory.entries[keyIndex].key[MAX_KEY_LENGTH - 1] = '\0';
-        s_directory.entries[keyIndex].address = address;
-        s_directory.entries[keyIndex].size = size;
-        s_directory.keyCount++;
+    switch (s_context.type) {
+        case STORAGE_TYPE_EEPROM:
+            result = storage_read_eeprom(key, data, maxSize, actualSize);
+            break;
+            
+        case STORAGE_TYPE_FLASH:
+            result = storage_read_flash(key, data, maxSize, actualSize);
+            break;
+            
+        case STORAGE_TYPE_SD_CARD:
+            result = storage_read_sd_card(key, data, maxSize, actualSize);
+            break;
+            
+        case STORAGE_TYPE_FILE_SYSTEM:
+            result = storage_read_file_system(key, data, maxSize, actualSize);
+            break;
+            
+        case STORAGE_TYPE_NVS:
+            result = storage_read_nvs(key, data, maxSize, actualSize);
+            break;
+            
+        default:
+            result = -3; // Unknown storage type
     }
     
+    return result;
+}
+
+/**
+ * @brief Check the backend for the storage type for a key
+ */
+static bool backend_exists(const char* key) {
+    switch (s_context.type) {
+        case STORAGE_TYPE_EEPROM:
+            return storage_exists_eeprom(key);
+            
+        case STORAGE_TYPE_FLASH:
+            return storage_exists_flash(key);
+            
+        case STORAGE_TYPE_SD_CARD:
+            return storage_exists_sd_card(key);
+            
+        case STORAGE_TYPE_FILE_SYSTEM:
+            return storage_exists_file_system(key);
+            
+        case STORAGE_TYPE_NVS:
+            return storage_exists_nvs(key);
+            
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Get keys from the backend for the storage type
+ */
+static int backend_get_keys(const char* prefix, char** keys, size_t maxKeys) {
+    switch (s_context.type) {
+        case STORAGE_TYPE_EEPROM:
+            return storage_get_keys_eeprom(prefix, keys, maxKeys);
+            
+        case STORAGE_TYPE_FLASH:
+            return storage_get_keys_flash(prefix, keys, maxKeys);
+            
+        case STORAGE_TYPE_SD_CARD:
+            return storage_get_keys_sd_card(prefix, keys, maxKeys);
+            
+        case STORAGE_TYPE_FILE_SYSTEM:
+            return storage_get_keys_file_system(prefix, keys, maxKeys);
+            
+        case STORAGE_TYPE_NVS:
+            return storage_get_keys_nvs(prefix, keys, maxKeys);
+            
+        default:
+            return -2; // Unknown storage type
+    }
+}
+
+static int backend_get_size(const char* key) {
+    switch (s_context.type) {
+        case STORAGE_TYPE_EEPROM:
+            return storage_get_size_eeprom(key);
+            
+        case STORAGE_TYPE_FLASH:
+            return storage_get_size_flash(key);
+            
+        case STORAGE_TYPE_SD_CARD:
+            return storage_get_size_sd_card(key);
+            
+        case STORAGE_TYPE_FILE_SYSTEM:
+            return storage_get_size_file_system(key);
+            
+        case STORAGE_TYPE_NVS:
+            return storage_get_size_nvs(key);
+            
+        default:
+            return -3; // Unknown storage type
+    }
+}
+
+/**
+ * @brief Open an atomic group of writes and deletes on the layouts that have one
+ */
+static int backend_begin_group(void) {
+    return s_log != NULL ? storage_log_begin_batch(s_log) : 0;
+}
+
+/**
+ * @brief Close the group opened by backend_begin_group, applying or dropping it
+ *
+ * The directory layout needs no group of its own: its next commit makes
+ * everything since the last one durable at once.
+ */
+static int backend_end_group(bool apply) {
+    if (s_log != NULL) {
+        return apply ? storage_log_end_batch(s_log) : storage_log_abort_batch(s_log);
+    }
+    if (s_directory != NULL && !apply) {
+        return storage_directory_rollback(s_directory);
+    }
     return 0;
 }
 
 /**
- * @brief Remove key entry from directory
+ * @brief Whether writes and deletes are staged in the write-behind cache
  */
-static int remove_key_entry(const char* key) {
-    // Find key
-    int keyIndex = find_key_entry(key);
-    if (keyIndex < 0) {
-        return -1;
+static bool caching(void) {
+    // Every write is flushed on its own under this policy
+    if (s_config.syncPolicy == STORAGE_SYNC_ALWAYS) {
+        return false;
     }
     
-    // Remove entry by shifting all entries after it
-    for (uint32_t i = keyIndex; i < s_directory.keyCount - 1; i++) {
-        memcpy(&s_directory.entries[i], &s_directory.entries[i + 1], sizeof(KeyEntry));
+    return s_context.transaction_active || s_config.writeBehindBytes > 0 || s_config.writeBehindDelayMs > 0;
+}
+
+/**
+ * @brief Stage a write, replacing one already waiting for the key
+ */
+static int stage_write(const char* key, const void* data, size_t size) {
+    if (s_cache == NULL) {
+        s_cache = storage_cache_create();
+        if (s_cache == NULL) {
+            return -3; // Memory allocation failed
+        }
     }
     
-    s_directory.keyCount--;
-    
+    bool replaced = false;
+    if (storage_cache_put(s_cache, key, data, size, &replaced) != 0) {
+        return -3; // Memory allocation failed
+    }
+    if (replaced) {
+        s_writeStats.absorbed++;
+    }
     return 0;
 }
 
 /**
- * @brief Allocate storage space
+ * @brief Stage a delete, replacing a write already waiting for the key
  */
-static uint32_t allocate_storage(size_t size) {
-    if (s_memStorage == NULL) {
-        return 0;
+static int stage_delete(const char* key) {
+    if (!persistent_storage_exists(key)) {
+        return -2; // Key not found
     }
     
-    // Start after directory
-    uint32_t address = DIRECTORY_SIZE;
-    
-    // Find a free block
-    for (uint32_t i = 0; i < s_directory.keyCount; i++) {
-        // Check if there's enough space before this entry
-        if (s_directory.entries[i].address > address && 
-            s_directory.entries[i].address - address >= size) {
-            // Found a free block
-            return address;
+    if (s_cache == NULL) {
+        s_cache = storage_cache_create();
+        if (s_cache == NULL) {
+            return -4; // Memory allocation failed
         }
-        
-        // Move past this entry
-        address = s_directory.entries[i].address + s_directory.entries[i].size;
     }
     
-    // Check if there's enough space at the end
-    if (address + size <= s_config.size) {
-        return address;
+    bool replaced = false;
+    if (storage_cache_delete(s_cache, key, &replaced) != 0) {
+        return -4; // Memory allocation failed
+    }
+    if (replaced) {
+        s_writeStats.absorbed++;
     }
-    
-    // No space found
     return 0;
 }
 
 /**
- * @brief Compress data using RLE
+ * @brief Commit outside a transaction once the cache reaches its size limit
  */
-static size_t compress_data(const void* data, size_t size, void* compressedData, size_t maxCompressedSize) {
-    const uint8_t* src = (const uint8_t*)data;
-    uint8_t* dst = (uint8_t*)compressedData;
+static int commit_if_full(void) {
+    if (s_context.transaction_active || s_config.writeBehindBytes == 0 ||
+        storage_cache_bytes(s_cache) < s_config.writeBehindBytes) {
+        return 0;
+    }
     
-    // Add compression marker
-    if (maxCompressedSize < 2) {
+    return persistent_storage_commit();
+}
+
+/**
+ * @brief Apply the staged writes and deletes to the backend, in the order
+ * their keys were first staged
+ *
+ * If any entry fails, all entries stay staged for the next commit to retry
+ * and the first error is returned.
+ */
+static int flush_cache(void) {
+    uint32_t count = storage_cache_count(s_cache);
+    if (count == 0) {
         return 0;
     }
     
-    dst[0] = 0xAB;
-    dst[1] = 0xCD;
+    // The group is applied as a whole or, if any entry fails, not at all
+    int result = backend_begin_group();
+    for (uint32_t i = 0; i < count && result == 0; i++) {
+        StorageCacheEntry entry;
+        storage_cache_get(s_cache, i, &entry);
+        
+        if (entry.deleted) {
+            // A key written and deleted while staged never reached the backend
+            result = backend_delete(entry.key);
+            if (result == -2) {
+                result = 0;
+            }
+        } else {
+            result = backend_write(entry.key, entry.data, entry.size);
+        }
+    }
     
-    size_t srcPos = 0;
-    size_t dstPos = 2;
+    int endResult = backend_end_group(result == 0);
+    result = result != 0 ? result : endResult;
+    if (result != 0) {
+        return result;
+    }
     
-    while (srcPos < size) {
-        // Check if we have enough space for worst case (2 bytes)
-        if (dstPos + 2 > maxCompressedSize) {
-            return 0; // Not enough space
+    s_writeStats.groupCommits++;
+    s_writeStats.entriesFlushed += count;
+    storage_cache_clear(s_cache);
+    s_cacheAging = false;
+    return 0;
+}
+
+/**
+ * @brief Apply staged deletes and first writes to a key list from the backend
+ */
+static int merge_cached_keys(const char* prefix, char** keys, size_t count, size_t maxKeys) {
+    // Drop keys with a staged delete
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        StorageCacheEntry entry;
+        if (storage_cache_find(s_cache, keys[i], &entry) && entry.deleted) {
+            free(keys[i]);
+        } else {
+            keys[kept++] = keys[i];
         }
-        
-        uint8_t currentByte = src[srcPos];
-        uint8_t count = 1;
-        
-        // Count repeating bytes
-        while (srcPos + count < size && 
-               src[srcPos + count] == currentByte && 
-               count < 255) {
-            count++;
+    }
+    
+    // Add keys the backend does not have yet
+    size_t prefixLength = prefix != NULL ? strlen(prefix) : 0;
+    for (uint32_t i = 0; i < storage_cache_count(s_cache) && kept < maxKeys; i++) {
+        StorageCacheEntry entry;
+        storage_cache_get(s_cache, i, &entry);
+        if (entry.deleted || (prefixLength > 0 && strncmp(entry.key, prefix, prefixLength) != 0) ||
+            backend_exists(entry.key)) {
+            continue;
         }
         
-        if (count >= 3) {
-            // Use RLE for 3 or more repeating bytes
-            dst[dstPos++] = 0; // Control byte
-            dst[dstPos++] = count;
-            dst[dstPos++] = currentByte;
-            srcPos += count;
-        } else {
-            // Use literal for 1 or 2 bytes
-            uint8_t literalCount = 0;
-            size_t literalStart = srcPos;
-            
-            // Count non-repeating bytes
-            while (srcPos < size && literalCount < 255) {
-                currentByte = src[srcPos];
-                
-                // Look ahead for repeating bytes
-                uint8_t repeatCount = 0;
-                while (srcPos + repeatCount + 1 < size && 
-                       src[srcPos + repeatCount + 1] == currentByte && 
-                       repeatCount < 255) {
-                    repeatCount++;
-                }
-                
-                if (repeatCount >= 2) {
-                    // Found a repeating sequence, stop literal
-                    break;
-                }
-                
-                srcPos++;
-                literalCount++;
-            }
-            
-            // Check if we have enough space
-            if (dstPos + 2 + literalCount > maxCompressedSize) {
-                return 0; // Not enough space
-            }
-            
-            // Write literal
-            dst[dstPos++] = 1; // Control byte
-            dst[dstPos++] = literalCount;
-            memcpy(dst + dstPos, src + literalStart, literalCount);
-            dstPos += literalCount;
+        keys[kept] = strdup(entry.key);
+        if (keys[kept] != NULL) {
+            kept++;
         }
     }
     
-    return dstPos;
+    return (int)kept;
 }
 
 /**
- * @brief Decompress data using RLE
+ * @brief Get the size of the bytes stored under a key, encoded or not
  */
-static size_t decompress_data(const void* compressedData, size_t compressedSize, void* data, size_t maxSize) {
-    const uint8_t* src = (const uint8_t*)compressedData;
-    uint8_t* dst = (uint8_t*)data;
+static int stored_size(const char* key) {
+    StorageCacheEntry cached;
+    if (storage_cache_find(s_cache, key, &cached)) {
+        return cached.deleted ? -2 : (int)cached.size;
+    }
     
-    // Check compression marker
-    if (compressedSize < 2 || src[0] != 0xAB || src[1] != 0xCD) {
+    return backend_get_size(key);
+}
+
+/**
+ * @brief Read the bytes stored under a key from the cache or the backend
+ */
+static int read_stored(const char* key, void* data, size_t maxSize, size_t* actualSize) {
+    StorageCacheEntry cached;
+    if (storage_cache_find(s_cache, key, &cached)) {
+        if (cached.deleted) {
+            return -2;
+        }
+        *actualSize = cached.size <= maxSize ? cached.size : maxSize;
+        memcpy(data, cached.data, *actualSize);
         return 0;
     }
     
-    size_t srcPos = 2;
-    size_t dstPos = 0;
+    return backend_read(key, data, maxSize, actualSize);
+}
+
+/**
+ * @brief Read a value that may have been stored with a codec header
+ */
+static int read_decoded(const char* key, void* data, size_t maxSize, size_t* actualSize) {
+    int storedSize = stored_size(key);
+    if (storedSize < 0) {
+        return storedSize;
+    }
+    
+    // Values that fit are read in place and only copied aside when encoded
+    bool inPlace = (size_t)storedSize <= maxSize;
+    if (inPlace) {
+        int result = read_stored(key, data, maxSize, actualSize);
+        if (result != 0 || !storage_codec_parse_header(data, *actualSize, NULL, NULL)) {
+            return result;
+        }
+    }
     
-    while (srcPos < compressedSize) {
-        uint8_t controlByte = src[srcPos++];
-        
-        if (controlByte == 0) {
-            // RLE block
-            if (srcPos + 1 >= compressedSize) {
-                return 0; // Invalid compressed data
-            }
-            
-            uint8_t count = src[srcPos++];
-            uint8_t value = src[srcPos++];
-            
-            // Check if we have enough space
-            if (dstPos + count > maxSize) {
-                return 0; // Not enough space
-            }
-            
-            // Repeat byte
-            for (uint8_t i = 0; i < count; i++) {
-                dst[dstPos++] = value;
-            }
-        } else if (controlByte == 1) {
-            // Literal block
-            if (srcPos >= compressedSize) {
-                return 0; // Invalid compressed data
-            }
-            
-            uint8_t count = src[srcPos++];
-            
-            // Check if we have enough space
-            if (dstPos + count > maxSize || srcPos + count > compressedSize) {
-                return 0; // Not enough space
-            }
-            
-            // Copy literal bytes
-            memcpy(dst + dstPos, src + srcPos, count);
-            dstPos += count;
-            srcPos += count;
-        } else {
-            return 0; // Invalid control byte
+    uint8_t* blob = (uint8_t*)malloc((size_t)storedSize);
+    if (blob == NULL) {
+        return -4; // Memory allocation failed
+    }
+    
+    int result = 0;
+    size_t blobSize = 0;
+    if (inPlace) {
+        blobSize = *actualSize;
+        memcpy(blob, data, blobSize);
+    } else {
+        result = read_stored(key, blob, (size_t)storedSize, &blobSize);
+    }
+    if (result == 0) {
+        int decoded = storage_codec_decode(blob, blobSize, data, maxSize, actualSize);
+        if (decoded == -1) {
+            // Raw value larger than the buffer
+            *actualSize = blobSize <= maxSize ? blobSize : maxSize;
+            memcpy(data, blob, *actualSize);
+        } else if (decoded != 0) {
+            result = -6; // Decompression failed
         }
     }
     
-    return dstPos;
-}
\ No newline at end of file
+    free(blob);
+    return result;
+}
@@ -1,9 +1,33 @@
+/**
+ * @file persistent_storage.h
+ * @brief Key-value persistent storage over EEPROM, flash, files and NVS
+ *
+ * Durability: outside a transaction, and with write-behind off, a write or
+ * delete is committed before it returns. Inside a transaction writes and
+ * deletes are staged in RAM and reach the media together when the transaction
+ * ends. With write-behind on (writeBehindBytes or writeBehindDelayMs), they
+ * are staged the same way outside transactions too. The next group commit
+ * makes them durable. A commit runs when the staged bytes reach
+ * writeBehindBytes, when persistent_storage_poll finds them older than
+ * writeBehindDelayMs, on persistent_storage_commit, and on deinit. A crash
+ * loses what was staged since the last commit. Reads always see staged
+ * values. STORAGE_SYNC_ALWAYS bypasses staging.
+ *
+ * Crash consistency: on the directory and log layouts every commit is atomic.
+ * After a power loss at any point, a single write or delete and a whole group
+ * commit are either fully there or not at all, and mount recovers without a
+ * reformat. A write the medium rejects leaves the key's previous value. If
+ * one entry of a group fails, none is applied and the commit returns its
+ * error. The host key-file backend and NVS apply a group key by key.
+ */
 #ifndef PERSISTENT_STORAGE_H
 #define PERSISTENT_STORAGE_H
 
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include "storage_log.h"
+#include "storage_ftl.h"
 
 /**
  * @brief Storage types
@@ -16,20 +40,60 @@ typedef enum {
     STORAGE_TYPE_NVS          // Non-volatile storage (ESP32)
 } StorageType;
 
+/**
+ * @brief On-media layout for the EEPROM, flash, SD and file system backends
+ */
+typedef enum {
+    STORAGE_LAYOUT_DEFAULT,   // Log for flash, directory for the others
+    STORAGE_LAYOUT_DIRECTORY, // Hashed key directory at address 0, values updated in place (see storage_directory.h)
+    STORAGE_LAYOUT_LOG        // Log-structured records with an in-RAM index (see storage_log.h)
+} StorageLayout;
+
+/**
+ * @brief When writes are flushed to durable media (host image and key files)
+ */
+typedef enum {
+    STORAGE_SYNC_ON_COMMIT,   // Flush on commit: after each write outside a transaction, once per transaction
+    STORAGE_SYNC_ALWAYS,      // Flush after every write and delete, inside transactions too
+    STORAGE_SYNC_NONE         // Leave write-back to the OS; a crash can lose recent writes
+} StorageSyncPolicy;
+
 /**
  * @brief Storage initialization configuration
  */
 typedef struct {
     StorageType type;          // Storage type
     const char* mountPoint;    // Mount point (for file system)
-    const char* basePath;      // Base path (for file system)
+    const char* basePath;      // Base path (for file system; on hosts, the directory holding one file per key)
     uint32_t baseAddress;      // Base address (for EEPROM/flash)
     uint32_t size;             // Storage size in bytes
     bool formatIfMounted;      // Format if mount fails (for file system)
     const char* partition;     // Partition name (for ESP32 NVS)
     bool readOnly;             // Read-only mode
+    StorageLayout layout;      // On-media layout
+    uint32_t segmentSize;      // Log segment size, 0 for the default (log layout)
+    uint32_t maxKeys;          // Key capacity of a new directory, 0 to size it from the storage (directory layout)
+    const char* imagePath;     // Host file mapped as the EEPROM/flash/SD image, NULL for RAM (ignored without POSIX files)
+    StorageSyncPolicy syncPolicy; // Flush policy for host files
+    uint32_t writeBehindBytes; // Commit staged writes once they hold this many bytes, 0 for no size limit
+    uint32_t writeBehindDelayMs; // Commit staged writes this long after they are first polled, 0 for no time limit
+    uint32_t eraseBlockSize;   // Flash erase block size; non-zero runs the layout on the wear-leveling translation layer (EEPROM/flash)
 } StorageConfig;
 
+/**
+ * @brief Write path counters
+ */
+typedef struct {
+    uint32_t writes;           // Writes and deletes accepted
+    uint32_t absorbed;         // Writes and deletes that replaced one still staged for the key
+    uint32_t groupCommits;     // Commits that applied staged writes
+    uint32_t entriesFlushed;   // Staged writes and deletes applied by those commits
+    uint32_t pendingEntries;   // Writes and deletes staged now
+    uint32_t pendingBytes;     // Key and value bytes staged now
+    uint32_t mediaWrites;      // Write calls on the EEPROM/flash medium
+    uint64_t mediaBytesWritten; // Bytes written to the EEPROM/flash medium
+} StorageWriteStats;
+
 /**
  * @brief Initialize persistent storage
  * 
@@ -91,6 +155,19 @@ int persistent_storage_delete(const char* key);
  */
 int persistent_storage_get_keys(char** keys, size_t maxKeys);
 
+/**
+ * @brief Get the keys starting with a prefix
+ * 
+ * The directory layout returns them in sorted order without scanning the
+ * other keys.
+ * 
+ * @param prefix Key prefix, or NULL for all keys
+ * @param keys Array to store keys (must be pre-allocated)
+ * @param maxKeys Maximum number of keys to return
+ * @return int Number of keys found or negative error code
+ */
+int persistent_storage_get_keys_with_prefix(const char* prefix, char** keys, size_t maxKeys);
+
 /**
  * @brief Get size of data stored under key
  * 
@@ -102,6 +179,10 @@ int persistent_storage_get_size(const char* key);
 /**
  * @brief Commit changes to persistent storage
  * 
+ * Applies the staged writes and deletes as one atomic group, then commits the
+ * backend. If the group fails, the writes and deletes stay staged and the
+ * next commit retries them.
+ * 
  * @return int 0 on success, negative error code on failure
  */
 int persistent_storage_commit(void);
@@ -130,6 +211,9 @@ int persistent_storage_get_total_space(void);
 /**
  * @brief Begin a transaction (for multi-operation consistency)
  * 
+ * Write-behind entries still staged are committed first; if that commit
+ * fails, its error is returned and no transaction is started.
+ * 
  * @return int 0 on success, negative error code on failure
  */
 int persistent_storage_begin_transaction(void);
@@ -137,6 +221,9 @@ int persistent_storage_begin_transaction(void);
 /**
  * @brief End a transaction and commit changes
  * 
+ * If the commit fails, none of the transaction's writes and deletes are
+ * applied and they are discarded.
+ * 
  * @return int 0 on success, negative error code on failure
  */
 int persistent_storage_end_transaction(void);
@@ -144,9 +231,60 @@ int persistent_storage_end_transaction(void);
 /**
  * @brief Set storage compression (if supported)
  * 
+ * While enabled, each value is written with whichever codec in storage_codec.h
+ * shrinks it, or as-is when none does. Reads and persistent_storage_get_size()
+ * decode transparently, so callers always see the original value.
+ * 
  * @param enable Enable compression
  * @return int 0 on success, negative error code on failure
  */
 int persistent_storage_set_compression(bool enable);
 
+/**
+ * @brief Reclaim space held by overwritten and deleted records
+ *
+ * Meant to be called from an idle task when the log layout is in use; writes
+ * compact on their own when space runs out.
+ *
+ * @param maxSegments Maximum number of log segments to compact
+ * @return int Number of segments reclaimed, 0 for the directory layout, or negative error code
+ */
+int persistent_storage_compact(uint32_t maxSegments);
+
+/**
+ * @brief Get log store counters
+ *
+ * @param stats Output counters
+ * @return int 0 on success, negative error code if the log layout is not in use
+ */
+int persistent_storage_get_log_stats(StorageLogStats* stats);
+
+/**
+ * @brief Get flash translation layer counters, including the erase count spread
+ *
+ * @param stats Output counters
+ * @return int 0 on success, negative error code if the translation layer is not in use
+ */
+int persistent_storage_get_ftl_stats(StorageFtlStats* stats);
+
+/**
+ * @brief Commit staged writes that have waited writeBehindDelayMs
+ *
+ * Call periodically with a millisecond clock. The wait is measured from the
+ * first poll that sees staged writes, so they can wait up to one poll interval
+ * longer than the delay. Nothing is committed inside a transaction.
+ *
+ * @param nowMs Current time in milliseconds
+ * @return int 1 if a commit ran, 0 if none was due, negative error code on failure
+ */
+int persistent_storage_poll(uint32_t nowMs);
+
+/**
+ * @brief Get write path counters
+ *
+ * @param stats Output counters, reset by persistent_storage_init
+ * @return int 0 on success, negative error code on failure
+ */
+int persistent_storage_get_write_stats(StorageWriteStats* stats);
+
 #endif /* PERSISTENT_STORAGE_H */
\ No newline at end of file
@@ -0,0 +1,236 @@
+/**
+ * @file storage_cache.c
+ * @brief Pending writes and deletes held in RAM until a group commit
+ */
+#include "storage_cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_INITIAL_CAPACITY 16
+#define EMPTY_SLOT 0xFFFFFFFFu
+
+typedef struct {
+    char* key;
+    uint8_t* data;          // NULL for a delete or an empty value
+    size_t size;
+    uint32_t hash;
+    bool deleted;
+} CachedEntry;
+
+struct StorageCache {
+    CachedEntry* entries;   // In the order keys were first cached
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t* index;        // Open-addressing table of entry positions
+    uint32_t indexCapacity; // Power of two, twice the entry capacity
+    size_t bytes;
+};
+
+static uint32_t hash_key(const char* key) {
+    uint32_t hash = 2166136261u;
+    for (; *key != '\0'; key++) {
+        hash ^= (uint8_t)*key;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t* index_slot(const StorageCache* cache, const char* key, uint32_t hash) {
+    uint32_t mask = cache->indexCapacity - 1;
+    uint32_t i = hash & mask;
+    while (cache->index[i] != EMPTY_SLOT) {
+        const CachedEntry* entry = &cache->entries[cache->index[i]];
+        if (entry->hash == hash && strcmp(entry->key, key) == 0) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return &cache->index[i];
+}
+
+static int grow(StorageCache* cache) {
+    uint32_t capacity = cache->capacity * 2;
+    CachedEntry* entries = (CachedEntry*)realloc(cache->entries, capacity * sizeof(CachedEntry));
+    if (entries == NULL) {
+        return -1;
+    }
+    cache->entries = entries;
+
+    uint32_t* index = (uint32_t*)malloc(capacity * 2 * sizeof(uint32_t));
+    if (index == NULL) {
+        return -1;
+    }
+    free(cache->index);
+    cache->index = index;
+    cache->indexCapacity = capacity * 2;
+    cache->capacity = capacity;
+
+    memset(cache->index, 0xFF, cache->indexCapacity * sizeof(uint32_t));
+    for (uint32_t i = 0; i < cache->count; i++) {
+        *index_slot(cache, cache->entries[i].key, cache->entries[i].hash) = i;
+    }
+    return 0;
+}
+
+// Find or add the entry for a key, dropping any value it held
+static CachedEntry* claim_entry(StorageCache* cache, const char* key, bool* replaced) {
+    uint32_t hash = hash_key(key);
+    uint32_t* slot = index_slot(cache, key, hash);
+    if (*slot != EMPTY_SLOT) {
+        CachedEntry* entry = &cache->entries[*slot];
+        cache->bytes -= entry->size;
+        free(entry->data);
+        entry->data = NULL;
+        entry->size = 0;
+        if (replaced != NULL) {
+            *replaced = true;
+        }
+        return entry;
+    }
+
+    if (cache->count == cache->capacity) {
+        if (grow(cache) != 0) {
+            return NULL;
+        }
+        slot = index_slot(cache, key, hash);
+    }
+
+    CachedEntry* entry = &cache->entries[cache->count];
+    entry->key = strdup(key);
+    if (entry->key == NULL) {
+        return NULL;
+    }
+    entry->data = NULL;
+    entry->size = 0;
+    entry->hash = hash;
+    *slot = cache->count++;
+    cache->bytes += strlen(key);
+    if (replaced != NULL) {
+        *replaced = false;
+    }
+    return entry;
+}
+
+// Empty values point at the key so callers always get a usable buffer
+static void fill_entry(const CachedEntry* cached, StorageCacheEntry* entry) {
+    entry->key = cached->key;
+    entry->data = cached->deleted ? NULL : (cached->data != NULL ? cached->data : (const void*)cached->key);
+    entry->size = cached->size;
+    entry->deleted = cached->deleted;
+}
+
+StorageCache* storage_cache_create(void) {
+    StorageCache* cache = (StorageCache*)calloc(1, sizeof(StorageCache));
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    cache->capacity = CACHE_INITIAL_CAPACITY;
+    cache->indexCapacity = CACHE_INITIAL_CAPACITY * 2;
+    cache->entries = (CachedEntry*)malloc(cache->capacity * sizeof(CachedEntry));
+    cache->index = (uint32_t*)malloc(cache->indexCapacity * sizeof(uint32_t));
+    if (cache->entries == NULL || cache->index == NULL) {
+        storage_cache_destroy(cache);
+        return NULL;
+    }
+    memset(cache->index, 0xFF, cache->indexCapacity * sizeof(uint32_t));
+    return cache;
+}
+
+void storage_cache_destroy(StorageCache* cache) {
+    if (cache == NULL) {
+        return;
+    }
+
+    if (cache->entries != NULL) {
+        storage_cache_clear(cache);
+    }
+    free(cache->entries);
+    free(cache->index);
+    free(cache);
+}
+
+int storage_cache_put(StorageCache* cache, const char* key, const void* data, size_t size, bool* replaced) {
+    if (cache == NULL || key == NULL || (data == NULL && size > 0)) {
+        return -1;
+    }
+
+    uint8_t* copy = NULL;
+    if (size > 0) {
+        copy = (uint8_t*)malloc(size);
+        if (copy == NULL) {
+            return -2;
+        }
+        memcpy(copy, data, size);
+    }
+
+    CachedEntry* entry = claim_entry(cache, key, replaced);
+    if (entry == NULL) {
+        free(copy);
+        return -2;
+    }
+    entry->data = copy;
+    entry->size = size;
+    entry->deleted = false;
+    cache->bytes += size;
+    return 0;
+}
+
+int storage_cache_delete(StorageCache* cache, const char* key, bool* replaced) {
+    if (cache == NULL || key == NULL) {
+        return -1;
+    }
+
+    CachedEntry* entry = claim_entry(cache, key, replaced);
+    if (entry == NULL) {
+        return -2;
+    }
+    entry->deleted = true;
+    return 0;
+}
+
+bool storage_cache_find(const StorageCache* cache, const char* key, StorageCacheEntry* entry) {
+    if (cache == NULL || key == NULL || cache->count == 0) {
+        return false;
+    }
+
+    uint32_t slot = *index_slot(cache, key, hash_key(key));
+    if (slot == EMPTY_SLOT) {
+        return false;
+    }
+    if (entry != NULL) {
+        fill_entry(&cache->entries[slot], entry);
+    }
+    return true;
+}
+
+int storage_cache_get(const StorageCache* cache, uint32_t index, StorageCacheEntry* entry) {
+    if (cache == NULL || entry == NULL || index >= cache->count) {
+        return -1;
+    }
+
+    fill_entry(&cache->entries[index], entry);
+    return 0;
+}
+
+uint32_t storage_cache_count(const StorageCache* cache) {
+    return cache != NULL ? cache->count : 0;
+}
+
+size_t storage_cache_bytes(const StorageCache* cache) {
+    return cache != NULL ? cache->bytes : 0;
+}
+
+void storage_cache_clear(StorageCache* cache) {
+    if (cache == NULL) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < cache->count; i++) {
+        free(cache->entries[i].key);
+        free(cache->entries[i].data);
+    }
+    cache->count = 0;
+    cache->bytes = 0;
+    memset(cache->index, 0xFF, cache->indexCapacity * sizeof(uint32_t));
+}
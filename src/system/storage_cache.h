@@ -0,0 +1,107 @@
+/**
+ * @file storage_cache.h
+ * @brief Pending writes and deletes held in RAM until a group commit
+ *
+ * Each key has at most one pending entry: a later write or delete replaces the
+ * earlier one. Entries keep the order in which their keys were first cached so
+ * a flush applies them deterministically.
+ */
+#ifndef STORAGE_CACHE_H
+#define STORAGE_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct StorageCache StorageCache;
+
+/**
+ * @brief Pending operation on one key
+ */
+typedef struct {
+    const char* key;
+    const void* data;   // NULL for a delete
+    size_t size;
+    bool deleted;
+} StorageCacheEntry;
+
+/**
+ * @brief Create an empty cache
+ *
+ * @return StorageCache* Cache or NULL on failure
+ */
+StorageCache* storage_cache_create(void);
+
+/**
+ * @brief Free a cache and its pending entries
+ *
+ * @param cache Cache to free
+ */
+void storage_cache_destroy(StorageCache* cache);
+
+/**
+ * @brief Cache a write, replacing any pending entry for the key
+ *
+ * @param cache Cache
+ * @param key Key
+ * @param data Value (copied)
+ * @param size Size of value
+ * @param replaced Set to true if a pending entry was replaced (may be NULL)
+ * @return int 0 on success, negative error code on failure
+ */
+int storage_cache_put(StorageCache* cache, const char* key, const void* data, size_t size, bool* replaced);
+
+/**
+ * @brief Cache a delete, replacing any pending entry for the key
+ *
+ * @param cache Cache
+ * @param key Key
+ * @param replaced Set to true if a pending entry was replaced (may be NULL)
+ * @return int 0 on success, negative error code on failure
+ */
+int storage_cache_delete(StorageCache* cache, const char* key, bool* replaced);
+
+/**
+ * @brief Look up the pending entry for a key
+ *
+ * @param cache Cache
+ * @param key Key
+ * @param entry Output entry, valid until the cache is next changed
+ * @return bool True if the key has a pending entry
+ */
+bool storage_cache_find(const StorageCache* cache, const char* key, StorageCacheEntry* entry);
+
+/**
+ * @brief Get a pending entry by position
+ *
+ * @param cache Cache
+ * @param index Position, from 0 to storage_cache_count() - 1
+ * @param entry Output entry, valid until the cache is next changed
+ * @return int 0 on success, -1 if the index is out of range
+ */
+int storage_cache_get(const StorageCache* cache, uint32_t index, StorageCacheEntry* entry);
+
+/**
+ * @brief Get the number of pending entries
+ *
+ * @param cache Cache
+ * @return uint32_t Entry count
+ */
+uint32_t storage_cache_count(const StorageCache* cache);
+
+/**
+ * @brief Get the key and value bytes held by pending entries
+ *
+ * @param cache Cache
+ * @return size_t Byte count
+ */
+size_t storage_cache_bytes(const StorageCache* cache);
+
+/**
+ * @brief Drop every pending entry
+ *
+ * @param cache Cache
+ */
+void storage_cache_clear(StorageCache* cache);
+
+#endif /* STORAGE_CACHE_H */
@@ -0,0 +1,435 @@
+/**
+ * @file storage_codec.c
+ * @brief Compression codecs for values kept in persistent storage
+ */
+#include "storage_codec.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define HEADER_MAGIC0 0xAB
+#define HEADER_MAGIC1 0xCF
+#define HEADER_CHECK_SEED 0x5A
+
+// LZ sequence limits, as in LZ4: matches are at least MIN_MATCH bytes, the last
+// LAST_LITERALS bytes are always literals and no match starts in the final
+// MATCH_SEARCH_LIMIT bytes
+#define MIN_MATCH 4
+#define LAST_LITERALS 5
+#define MATCH_SEARCH_LIMIT 12
+#define MAX_OFFSET 65535
+#define RUN_MASK 15
+
+// Skip ahead faster through data that keeps failing to match
+#define SKIP_SHIFT 6
+
+static uint8_t header_check(uint8_t codec, uint32_t size) {
+    return (uint8_t)(HEADER_CHECK_SEED ^ codec ^ size ^ (size >> 8) ^ (size >> 16) ^ (size >> 24));
+}
+
+static void write_header(uint8_t* blob, StorageCodec codec, size_t size) {
+    uint32_t original = (uint32_t)size;
+    blob[0] = HEADER_MAGIC0;
+    blob[1] = HEADER_MAGIC1;
+    blob[2] = (uint8_t)codec;
+    blob[3] = header_check((uint8_t)codec, original);
+    blob[4] = (uint8_t)original;
+    blob[5] = (uint8_t)(original >> 8);
+    blob[6] = (uint8_t)(original >> 16);
+    blob[7] = (uint8_t)(original >> 24);
+}
+
+static uint32_t read32(const uint8_t* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t hash_sequence(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - STORAGE_CODEC_HASH_BITS);
+}
+
+// Append a length beyond the token's 4 bits as a run of 255s and a remainder
+static size_t put_length(uint8_t* dst, size_t op, size_t length) {
+    while (length >= 255) {
+        dst[op++] = 255;
+        length -= 255;
+    }
+    dst[op++] = (uint8_t)length;
+    return op;
+}
+
+// Emit literals followed by a match, or only literals when matchLength is 0
+static size_t emit_sequence(uint8_t* dst, size_t op, size_t capacity, const uint8_t* literals,
+                            size_t literalLength, size_t offset, size_t matchLength) {
+    size_t worstCase = 1 + literalLength / 255 + 1 + literalLength + (matchLength > 0 ? 2 + matchLength / 255 + 1 : 0);
+    if (op + worstCase > capacity) {
+        return 0;
+    }
+
+    uint8_t* token = &dst[op++];
+    *token = (uint8_t)((literalLength < RUN_MASK ? literalLength : RUN_MASK) << 4);
+    if (literalLength >= RUN_MASK) {
+        op = put_length(dst, op, literalLength - RUN_MASK);
+    }
+    memcpy(dst + op, literals, literalLength);
+    op += literalLength;
+
+    if (matchLength > 0) {
+        dst[op++] = (uint8_t)offset;
+        dst[op++] = (uint8_t)(offset >> 8);
+        size_t extra = matchLength - MIN_MATCH;
+        *token |= (uint8_t)(extra < RUN_MASK ? extra : RUN_MASK);
+        if (extra >= RUN_MASK) {
+            op = put_length(dst, op, extra - RUN_MASK);
+        }
+    }
+    return op;
+}
+
+static size_t lz_compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity) {
+    size_t op = 0;
+    size_t anchor = 0;
+
+    if (size > MATCH_SEARCH_LIMIT) {
+        uint32_t* table = (uint32_t*)calloc((size_t)1 << STORAGE_CODEC_HASH_BITS, sizeof(uint32_t));
+        if (table == NULL) {
+            return 0;
+        }
+
+        size_t limit = size - MATCH_SEARCH_LIMIT;
+        size_t matchLimit = size - LAST_LITERALS;
+        size_t ip = 1;
+
+        while (ip < limit) {
+            uint32_t sequence = read32(src + ip);
+            uint32_t* entry = &table[hash_sequence(sequence)];
+            size_t candidate = *entry;
+            *entry = (uint32_t)ip;
+
+            if (candidate >= ip || ip - candidate > MAX_OFFSET || read32(src + candidate) != sequence) {
+                ip += 1 + ((ip - anchor) >> SKIP_SHIFT);
+                continue;
+            }
+
+            // Grow the match backwards into pending literals, then forwards
+            while (ip > anchor && candidate > 0 && src[ip - 1] == src[candidate - 1]) {
+                ip--;
+                candidate--;
+            }
+            size_t length = MIN_MATCH;
+            while (ip + length < matchLimit && src[ip + length] == src[candidate + length]) {
+                length++;
+            }
+
+            op = emit_sequence(dst, op, capacity, src + anchor, ip - anchor, ip - candidate, length);
+            if (op == 0) {
+                free(table);
+                return 0;
+            }
+
+            ip += length;
+            anchor = ip;
+            if (ip < limit) {
+                table[hash_sequence(read32(src + ip - 2))] = (uint32_t)(ip - 2);
+            }
+        }
+        free(table);
+    }
+
+    return emit_sequence(dst, op, capacity, src + anchor, size - anchor, 0, 0);
+}
+
+// Read a length continued past the token's 4 bits
+static int get_length(const uint8_t* src, size_t size, size_t* ip, size_t* length) {
+    uint8_t byte;
+    do {
+        if (*ip >= size) {
+            return -2;
+        }
+        byte = src[(*ip)++];
+        *length += byte;
+    } while (byte == 255);
+    return 0;
+}
+
+static int lz_decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t maxSize, size_t* actualSize) {
+    size_t ip = 0;
+    size_t op = 0;
+
+    while (ip < size) {
+        uint8_t token = src[ip++];
+
+        size_t literalLength = token >> 4;
+        if (literalLength == RUN_MASK && get_length(src, size, &ip, &literalLength) != 0) {
+            return -2;
+        }
+        if (literalLength > size - ip) {
+            return -2;
+        }
+        if (literalLength >= maxSize - op) {
+            memcpy(dst + op, src + ip, maxSize - op);
+            *actualSize = maxSize;
+            return 0;
+        }
+        memcpy(dst + op, src + ip, literalLength);
+        ip += literalLength;
+        op += literalLength;
+
+        // The final sequence has no match
+        if (ip == size) {
+            break;
+        }
+
+        if (size - ip < 2) {
+            return -2;
+        }
+        size_t offset = src[ip] | ((size_t)src[ip + 1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op) {
+            return -2;
+        }
+
+        size_t matchLength = token & RUN_MASK;
+        if (matchLength == RUN_MASK && get_length(src, size, &ip, &matchLength) != 0) {
+            return -2;
+        }
+        matchLength += MIN_MATCH;
+
+        bool truncated = matchLength >= maxSize - op;
+        if (truncated) {
+            matchLength = maxSize - op;
+        }
+
+        // Overlapping matches repeat the bytes just written
+        const uint8_t* match = dst + op - offset;
+        if (offset >= matchLength) {
+            memcpy(dst + op, match, matchLength);
+        } else {
+            for (size_t i = 0; i < matchLength; i++) {
+                dst[op + i] = match[i];
+            }
+        }
+        op += matchLength;
+
+        if (truncated) {
+            break;
+        }
+    }
+
+    *actualSize = op;
+    return 0;
+}
+
+static size_t rle_compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity) {
+    size_t srcPos = 0;
+    size_t dstPos = 0;
+
+    while (srcPos < size) {
+        // Check if we have enough space for worst case
+        if (dstPos + 3 > capacity) {
+            return 0;
+        }
+
+        uint8_t currentByte = src[srcPos];
+        uint8_t count = 1;
+
+        // Count repeating bytes
+        while (srcPos + count < size && src[srcPos + count] == currentByte && count < 255) {
+            count++;
+        }
+
+        if (count >= 3) {
+            // Use RLE for 3 or more repeating bytes
+            dst[dstPos++] = 0;
+            dst[dstPos++] = count;
+            dst[dstPos++] = currentByte;
+            srcPos += count;
+            continue;
+        }
+
+        // Use a literal run up to the next repeat
+        uint8_t literalCount = 0;
+        size_t literalStart = srcPos;
+        while (srcPos < size && literalCount < 255) {
+            if (srcPos + 2 < size && src[srcPos + 1] == src[srcPos] && src[srcPos + 2] == src[srcPos]) {
+                break;
+            }
+            srcPos++;
+            literalCount++;
+        }
+
+        if (dstPos + 2 + literalCount > capacity) {
+            return 0;
+        }
+        dst[dstPos++] = 1;
+        dst[dstPos++] = literalCount;
+        memcpy(dst + dstPos, src + literalStart, literalCount);
+        dstPos += literalCount;
+    }
+
+    return dstPos;
+}
+
+static int rle_decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t maxSize, size_t* actualSize) {
+    size_t srcPos = 0;
+    size_t dstPos = 0;
+
+    while (srcPos < size && dstPos < maxSize) {
+        uint8_t controlByte = src[srcPos++];
+        if (srcPos >= size) {
+            return -2;
+        }
+        size_t count = src[srcPos++];
+        size_t room = maxSize - dstPos;
+
+        if (controlByte == 0) {
+            // Repeated byte
+            if (srcPos >= size) {
+                return -2;
+            }
+            memset(dst + dstPos, src[srcPos++], count < room ? count : room);
+        } else if (controlByte == 1) {
+            // Literal bytes
+            if (count > size - srcPos) {
+                return -2;
+            }
+            memcpy(dst + dstPos, src + srcPos, count < room ? count : room);
+            srcPos += count;
+        } else {
+            return -2;
+        }
+        dstPos += count < room ? count : room;
+    }
+
+    *actualSize = dstPos;
+    return 0;
+}
+
+size_t storage_codec_bound(size_t size) {
+    return size + STORAGE_CODEC_HEADER_SIZE;
+}
+
+size_t storage_codec_encode(const void* data, size_t size, void* blob, size_t capacity) {
+    if (data == NULL || blob == NULL || size > UINT32_MAX) {
+        return 0;
+    }
+
+    uint8_t* out = (uint8_t*)blob;
+
+    // Only keep a payload that saves space after paying for the header
+    if (size > STORAGE_CODEC_HEADER_SIZE + 1 && capacity > STORAGE_CODEC_HEADER_SIZE) {
+        size_t room = size - STORAGE_CODEC_HEADER_SIZE - 1;
+        if (room > capacity - STORAGE_CODEC_HEADER_SIZE) {
+            room = capacity - STORAGE_CODEC_HEADER_SIZE;
+        }
+
+        static const StorageCodec codecs[] = { STORAGE_CODEC_LZ, STORAGE_CODEC_RLE };
+        for (size_t i = 0; i < sizeof(codecs) / sizeof(codecs[0]); i++) {
+            size_t payload = storage_codec_compress(codecs[i], data, size, out + STORAGE_CODEC_HEADER_SIZE, room);
+            if (payload > 0) {
+                write_header(out, codecs[i], size);
+                return STORAGE_CODEC_HEADER_SIZE + payload;
+            }
+        }
+    }
+
+    // Raw values that look encoded get a header of their own
+    if (storage_codec_parse_header(data, size, NULL, NULL)) {
+        if (capacity < storage_codec_bound(size)) {
+            return 0;
+        }
+        write_header(out, STORAGE_CODEC_NONE, size);
+        memcpy(out + STORAGE_CODEC_HEADER_SIZE, data, size);
+        return storage_codec_bound(size);
+    }
+
+    return 0;
+}
+
+int storage_codec_decode(const void* blob, size_t blobSize, void* data, size_t maxSize, size_t* actualSize) {
+    StorageCodec codec;
+    size_t originalSize;
+    if (!storage_codec_parse_header(blob, blobSize, &codec, &originalSize)) {
+        return -1;
+    }
+    if (data == NULL || actualSize == NULL) {
+        return -2;
+    }
+
+    size_t limit = originalSize < maxSize ? originalSize : maxSize;
+    int result = storage_codec_decompress(codec, (const uint8_t*)blob + STORAGE_CODEC_HEADER_SIZE,
+                                          blobSize - STORAGE_CODEC_HEADER_SIZE, data, limit, actualSize);
+    if (result != 0 || *actualSize != limit) {
+        return -2;
+    }
+    return 0;
+}
+
+bool storage_codec_parse_header(const void* blob, size_t blobSize, StorageCodec* codec, size_t* originalSize) {
+    const uint8_t* header = (const uint8_t*)blob;
+    if (header == NULL || blobSize < STORAGE_CODEC_HEADER_SIZE ||
+        header[0] != HEADER_MAGIC0 || header[1] != HEADER_MAGIC1 || header[2] > STORAGE_CODEC_LZ) {
+        return false;
+    }
+
+    uint32_t size = header[4] | ((uint32_t)header[5] << 8) | ((uint32_t)header[6] << 16) | ((uint32_t)header[7] << 24);
+    if (header[3] != header_check(header[2], size)) {
+        return false;
+    }
+
+    if (codec != NULL) {
+        *codec = (StorageCodec)header[2];
+    }
+    if (originalSize != NULL) {
+        *originalSize = size;
+    }
+    return true;
+}
+
+size_t storage_codec_compress(StorageCodec codec, const void* data, size_t size, void* output, size_t capacity) {
+    if (data == NULL || output == NULL) {
+        return 0;
+    }
+
+    switch (codec) {
+        case STORAGE_CODEC_NONE:
+            if (size > capacity) {
+                return 0;
+            }
+            memcpy(output, data, size);
+            return size;
+
+        case STORAGE_CODEC_RLE:
+            return rle_compress((const uint8_t*)data, size, (uint8_t*)output, capacity);
+
+        case STORAGE_CODEC_LZ:
+            return lz_compress((const uint8_t*)data, size, (uint8_t*)output, capacity);
+
+        default:
+            return 0;
+    }
+}
+
+int storage_codec_decompress(StorageCodec codec, const void* payload, size_t payloadSize,
+                             void* data, size_t maxSize, size_t* actualSize) {
+    if (payload == NULL || data == NULL || actualSize == NULL) {
+        return -2;
+    }
+
+    *actualSize = 0;
+    switch (codec) {
+        case STORAGE_CODEC_NONE:
+            *actualSize = payloadSize < maxSize ? payloadSize : maxSize;
+            memcpy(data, payload, *actualSize);
+            return 0;
+
+        case STORAGE_CODEC_RLE:
+            return rle_decompress((const uint8_t*)payload, payloadSize, (uint8_t*)data, maxSize, actualSize);
+
+        case STORAGE_CODEC_LZ:
+            return lz_decompress((const uint8_t*)payload, payloadSize, (uint8_t*)data, maxSize, actualSize);
+
+        default:
+            return -2;
+    }
+}
@@ -0,0 +1,115 @@
+/**
+ * @file storage_codec.h
+ * @brief Compression codecs for values kept in persistent storage
+ *
+ * An encoded blob starts with an 8-byte header naming the codec and the
+ * original size, followed by the codec's payload:
+ *
+ *   [0xAB 0xCF] [codec] [check] [original size, u32 little-endian] [payload]
+ *
+ * The check byte ties the header fields together so raw values are rarely
+ * mistaken for encoded ones. STORAGE_CODEC_LZ is an LZ77 block format with the
+ * same sequence layout as LZ4: a token byte holding literal and match lengths,
+ * the literals, then a 16-bit match offset. Compression uses a fixed hash
+ * table of 2^STORAGE_CODEC_HASH_BITS positions; decompression needs no memory
+ * beyond its output buffer.
+ */
+#ifndef STORAGE_CODEC_H
+#define STORAGE_CODEC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Size of the header in front of every encoded blob
+#define STORAGE_CODEC_HEADER_SIZE 8
+
+// Match finder table size as a power of two (4 bytes per entry)
+#ifndef STORAGE_CODEC_HASH_BITS
+#define STORAGE_CODEC_HASH_BITS 12
+#endif
+
+/**
+ * @brief Codec recorded in a blob header
+ */
+typedef enum {
+    STORAGE_CODEC_NONE = 0, // Payload is the value itself
+    STORAGE_CODEC_RLE = 1,  // Run-length encoding
+    STORAGE_CODEC_LZ = 2    // LZ77 with LZ4-style sequences
+} StorageCodec;
+
+/**
+ * @brief Get the largest blob storage_codec_encode() can produce
+ *
+ * @param size Size of the value
+ * @return size_t Buffer size needed for the blob
+ */
+size_t storage_codec_bound(size_t size);
+
+/**
+ * @brief Encode a value with whichever codec saves space
+ *
+ * Tries LZ, then RLE. A value that neither shrinks is left for the caller to
+ * store as-is, unless it happens to start with a valid header, in which case it
+ * is wrapped with STORAGE_CODEC_NONE so it reads back unchanged.
+ *
+ * @param data Value
+ * @param size Size of value
+ * @param blob Output buffer of at least storage_codec_bound(size) bytes
+ * @param capacity Size of output buffer
+ * @return size_t Blob size, or 0 if the value should be stored as-is
+ */
+size_t storage_codec_encode(const void* data, size_t size, void* blob, size_t capacity);
+
+/**
+ * @brief Decode a blob, truncating the value to the buffer size
+ *
+ * @param blob Blob
+ * @param blobSize Size of blob
+ * @param data Output buffer
+ * @param maxSize Size of output buffer
+ * @param actualSize Bytes written to data
+ * @return int 0 on success, -1 if blob is not encoded, -2 if it is corrupt
+ */
+int storage_codec_decode(const void* blob, size_t blobSize, void* data, size_t maxSize, size_t* actualSize);
+
+/**
+ * @brief Read the header of a blob
+ *
+ * @param blob Blob, or at least its first STORAGE_CODEC_HEADER_SIZE bytes
+ * @param blobSize Bytes available
+ * @param codec Codec of the blob (may be NULL)
+ * @param originalSize Size of the decoded value (may be NULL)
+ * @return bool True if the blob starts with a valid header
+ */
+bool storage_codec_parse_header(const void* blob, size_t blobSize, StorageCodec* codec, size_t* originalSize);
+
+/**
+ * @brief Compress with one codec, without a header
+ *
+ * @param codec Codec to use
+ * @param data Value
+ * @param size Size of value
+ * @param output Output buffer
+ * @param capacity Size of output buffer
+ * @return size_t Payload size, or 0 if it does not fit in capacity
+ */
+size_t storage_codec_compress(StorageCodec codec, const void* data, size_t size, void* output, size_t capacity);
+
+/**
+ * @brief Decompress a payload made by storage_codec_compress()
+ *
+ * Stops once maxSize bytes are produced, so a short buffer yields a prefix.
+ *
+ * @param codec Codec of the payload
+ * @param payload Payload
+ * @param payloadSize Size of payload
+ * @param data Output buffer
+ * @param maxSize Size of output buffer
+ * @param actualSize Bytes written to data
+ * @return int 0 on success, -2 if the payload is corrupt
+ */
+int storage_codec_decompress(StorageCodec codec, const void* payload, size_t payloadSize,
+                             void* data, size_t maxSize, size_t* actualSize);
+
+#endif /* STORAGE_CODEC_H */
@@ -0,0 +1,942 @@
+/**
+ * @file storage_directory.c
+ * @brief Hashed key directory over a storage medium
+ */
+#include "storage_directory.h"
+#include "../util/crc32.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define DIRECTORY_MAGIC 0x5073746F // "Psto" in ASCII
+#define DIRECTORY_VERSION 3
+#define TABLE_COPIES 2
+#define HEADER_SIZE 32             // Each copy's header, both in the first slot
+#define MIN_SLOTS 8
+#define DEFAULT_MIN_KEYS 32
+#define DEFAULT_BYTES_PER_KEY 1024
+#define HOLES_INITIAL_CAPACITY 16
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;     // Power of two
+    uint32_t sequence;      // Commit number; the copy with the higher one is current
+    uint32_t crc;           // CRC-32 of the fields above
+} DirectoryHeader;
+
+typedef struct {
+    uint32_t hash;
+    uint32_t address;
+    uint32_t size;
+    uint8_t used;           // 0 for an empty slot
+    uint8_t keyLength;
+    uint16_t reserved;
+    char key[STORAGE_DIRECTORY_MAX_KEY_LENGTH + 1];
+} DirectorySlot;
+
+#define SLOT_SIZE ((uint32_t)sizeof(DirectorySlot))
+
+typedef struct {
+    uint32_t address;
+    uint32_t size;
+} Extent;
+
+typedef struct {
+    Extent* items;          // Unordered
+    uint32_t count;
+    uint32_t capacity;
+} ExtentList;
+
+struct StorageDirectory {
+    StorageMedium medium;
+    DirectorySlot* slots;   // RAM copy of the table
+    uint32_t slotCount;
+    uint32_t maxKeys;       // 3/4 of the slots
+    uint32_t keyCount;
+    uint32_t* dirty;        // One bit per slot changed since the last commit
+    bool anyDirty;
+    uint32_t* stale;        // One bit per slot the other table copy has out of date
+    uint32_t active;        // Table copy holding the last commit
+    uint32_t sequence;      // Sequence of the last commit
+    uint32_t dataStart;     // First byte after the table copies
+    uint32_t top;           // End of the highest allocation
+    uint32_t usedBytes;
+    Extent* holes;          // Free gaps below top, sorted by address
+    uint32_t holeCount;
+    uint32_t holeCapacity;
+    ExtentList fresh;       // Values written since the last commit
+    ExtentList released;    // Values of the last commit dropped since, kept until the next
+    DirectorySlot** sorted; // Used slots in key order
+    bool sortedValid;
+};
+
+// ===== Table =====
+
+static uint32_t hash_key(const char* key, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)key[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t slot_offset(const StorageDirectory* directory, uint32_t copy, uint32_t index) {
+    return SLOT_SIZE * (1 + copy * directory->slotCount + index);
+}
+
+static uint32_t data_start(uint32_t slotCount) {
+    return SLOT_SIZE * (1 + TABLE_COPIES * slotCount);
+}
+
+static bool bit_set(const uint32_t* bits, uint32_t index) {
+    return (bits[index / 32] & (1u << (index % 32))) != 0;
+}
+
+static void mark_dirty(StorageDirectory* directory, uint32_t index) {
+    directory->dirty[index / 32] |= 1u << (index % 32);
+    directory->anyDirty = true;
+}
+
+static DirectorySlot* find_slot(const StorageDirectory* directory, const char* key, size_t keyLength, uint32_t hash) {
+    uint32_t mask = directory->slotCount - 1;
+    for (uint32_t i = hash & mask; directory->slots[i].used; i = (i + 1) & mask) {
+        DirectorySlot* slot = &directory->slots[i];
+        if (slot->hash == hash && slot->keyLength == keyLength && memcmp(slot->key, key, keyLength) == 0) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+static DirectorySlot* lookup(const StorageDirectory* directory, const char* key) {
+    size_t keyLength = strlen(key);
+    if (keyLength > STORAGE_DIRECTORY_MAX_KEY_LENGTH) {
+        return NULL;
+    }
+    return find_slot(directory, key, keyLength, hash_key(key, keyLength));
+}
+
+static DirectorySlot* insert_slot(StorageDirectory* directory, const char* key, size_t keyLength, uint32_t hash) {
+    uint32_t mask = directory->slotCount - 1;
+    uint32_t i = hash & mask;
+    while (directory->slots[i].used) {
+        i = (i + 1) & mask;
+    }
+
+    DirectorySlot* slot = &directory->slots[i];
+    memset(slot, 0, sizeof(*slot));
+    slot->used = 1;
+    slot->hash = hash;
+    slot->keyLength = (uint8_t)keyLength;
+    memcpy(slot->key, key, keyLength);
+    mark_dirty(directory, i);
+
+    directory->keyCount++;
+    directory->sortedValid = false;
+    return slot;
+}
+
+static void remove_slot(StorageDirectory* directory, DirectorySlot* slot) {
+    uint32_t mask = directory->slotCount - 1;
+    uint32_t hole = (uint32_t)(slot - directory->slots);
+
+    // Backward-shift deletion keeps probe chains intact without tombstones
+    for (uint32_t i = (hole + 1) & mask; directory->slots[i].used; i = (i + 1) & mask) {
+        uint32_t home = directory->slots[i].hash & mask;
+        bool movable = (hole <= i) ? (home <= hole || home > i) : (home <= hole && home > i);
+        if (movable) {
+            directory->slots[hole] = directory->slots[i];
+            mark_dirty(directory, hole);
+            hole = i;
+        }
+    }
+
+    memset(&directory->slots[hole], 0, sizeof(DirectorySlot));
+    mark_dirty(directory, hole);
+
+    directory->keyCount--;
+    directory->sortedValid = false;
+}
+
+static bool slot_valid(const StorageDirectory* directory, const DirectorySlot* slot) {
+    return slot->keyLength <= STORAGE_DIRECTORY_MAX_KEY_LENGTH &&
+           slot->key[slot->keyLength] == '\0' &&
+           slot->hash == hash_key(slot->key, slot->keyLength) &&
+           slot->address >= directory->dataStart &&
+           slot->size <= directory->medium.size - slot->address;
+}
+
+// Re-insert the valid slots of a damaged table and schedule a full write-back
+static void rebuild_table(StorageDirectory* directory, DirectorySlot* loaded) {
+    memset(directory->slots, 0, (size_t)directory->slotCount * sizeof(DirectorySlot));
+    directory->keyCount = 0;
+
+    for (uint32_t i = 0; i < directory->slotCount; i++) {
+        if (loaded[i].used && slot_valid(directory, &loaded[i]) &&
+            find_slot(directory, loaded[i].key, loaded[i].keyLength, loaded[i].hash) == NULL) {
+            DirectorySlot* slot = insert_slot(directory, loaded[i].key, loaded[i].keyLength, loaded[i].hash);
+            slot->address = loaded[i].address;
+            slot->size = loaded[i].size;
+        }
+    }
+
+    for (uint32_t i = 0; i < directory->slotCount; i++) {
+        mark_dirty(directory, i);
+    }
+}
+
+// ===== Space =====
+
+static int add_hole(StorageDirectory* directory, uint32_t index, uint32_t address, uint32_t size) {
+    if (directory->holeCount == directory->holeCapacity) {
+        uint32_t capacity = directory->holeCapacity * 2;
+        Extent* holes = (Extent*)realloc(directory->holes, capacity * sizeof(Extent));
+        if (holes == NULL) {
+            return -1;
+        }
+        directory->holes = holes;
+        directory->holeCapacity = capacity;
+    }
+
+    memmove(&directory->holes[index + 1], &directory->holes[index],
+            (directory->holeCount - index) * sizeof(Extent));
+    directory->holes[index].address = address;
+    directory->holes[index].size = size;
+    directory->holeCount++;
+    return 0;
+}
+
+static void remove_hole(StorageDirectory* directory, uint32_t index) {
+    memmove(&directory->holes[index], &directory->holes[index + 1],
+            (directory->holeCount - index - 1) * sizeof(Extent));
+    directory->holeCount--;
+}
+
+static bool allocate_space(StorageDirectory* directory, uint32_t size, uint32_t* address) {
+    if (size == 0) {
+        *address = directory->dataStart;
+        return true;
+    }
+
+    // First fit among the gaps, then the end of the data area
+    for (uint32_t i = 0; i < directory->holeCount; i++) {
+        Extent* hole = &directory->holes[i];
+        if (hole->size >= size) {
+            *address = hole->address;
+            hole->address += size;
+            hole->size -= size;
+            if (hole->size == 0) {
+                remove_hole(directory, i);
+            }
+            directory->usedBytes += size;
+            return true;
+        }
+    }
+
+    if (size > directory->medium.size - directory->top) {
+        return false;
+    }
+    *address = directory->top;
+    directory->top += size;
+    directory->usedBytes += size;
+    return true;
+}
+
+// Turn an extent no longer counted in usedBytes into a gap
+static void insert_gap(StorageDirectory* directory, uint32_t address, uint32_t size) {
+    if (address + size == directory->top) {
+        // Give the space back to the end, along with a gap that now touches it
+        directory->top = address;
+        if (directory->holeCount > 0) {
+            Extent* last = &directory->holes[directory->holeCount - 1];
+            if (last->address + last->size == directory->top) {
+                directory->top = last->address;
+                directory->holeCount--;
+            }
+        }
+        return;
+    }
+
+    // Binary search for the first gap after the freed extent
+    uint32_t low = 0;
+    uint32_t high = directory->holeCount;
+    while (low < high) {
+        uint32_t middle = (low + high) / 2;
+        if (directory->holes[middle].address < address) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    bool joinsPrevious = low > 0 && directory->holes[low - 1].address + directory->holes[low - 1].size == address;
+    bool joinsNext = low < directory->holeCount && address + size == directory->holes[low].address;
+
+    if (joinsPrevious && joinsNext) {
+        directory->holes[low - 1].size += size + directory->holes[low].size;
+        remove_hole(directory, low);
+    } else if (joinsPrevious) {
+        directory->holes[low - 1].size += size;
+    } else if (joinsNext) {
+        directory->holes[low].address = address;
+        directory->holes[low].size += size;
+    } else if (add_hole(directory, low, address, size) != 0) {
+        // Out of memory: the space stays lost until the next mount
+        directory->usedBytes += size;
+    }
+}
+
+static void free_space(StorageDirectory* directory, uint32_t address, uint32_t size) {
+    if (size == 0) {
+        return;
+    }
+    directory->usedBytes -= size;
+    insert_gap(directory, address, size);
+}
+
+static bool list_add(ExtentList* list, uint32_t address, uint32_t size) {
+    if (list->count == list->capacity) {
+        uint32_t capacity = list->capacity > 0 ? list->capacity * 2 : HOLES_INITIAL_CAPACITY;
+        Extent* items = (Extent*)realloc(list->items, capacity * sizeof(Extent));
+        if (items == NULL) {
+            return false;
+        }
+        list->items = items;
+        list->capacity = capacity;
+    }
+
+    list->items[list->count].address = address;
+    list->items[list->count].size = size;
+    list->count++;
+    return true;
+}
+
+static int list_find(const ExtentList* list, uint32_t address) {
+    for (uint32_t i = 0; i < list->count; i++) {
+        if (list->items[i].address == address) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static void list_remove(ExtentList* list, uint32_t index) {
+    list->items[index] = list->items[--list->count];
+}
+
+// Find a value written since the last commit, which may be overwritten
+static int find_fresh(const StorageDirectory* directory, const DirectorySlot* slot) {
+    return slot != NULL && slot->size > 0 ? list_find(&directory->fresh, slot->address) : -1;
+}
+
+// Drop the extent of a replaced or deleted value. The table on the medium may
+// still point at it, so space from the last commit only becomes a gap once the
+// next commit has replaced that table.
+static void release_space(StorageDirectory* directory, uint32_t address, uint32_t size) {
+    if (size == 0) {
+        return;
+    }
+
+    int fresh = list_find(&directory->fresh, address);
+    if (fresh >= 0) {
+        list_remove(&directory->fresh, (uint32_t)fresh);
+        free_space(directory, address, size);
+        return;
+    }
+
+    // Out of memory: the space stays lost until the next mount
+    if (list_add(&directory->released, address, size)) {
+        directory->usedBytes -= size;
+    }
+}
+
+// Take back a specific extent that was just freed
+static void claim_space(StorageDirectory* directory, uint32_t address, uint32_t size) {
+    if (size == 0) {
+        return;
+    }
+    directory->usedBytes += size;
+
+    if (address >= directory->top) {
+        if (address > directory->top && add_hole(directory, directory->holeCount, directory->top,
+                                                 address - directory->top) != 0) {
+            directory->usedBytes += address - directory->top;
+        }
+        directory->top = address + size;
+        return;
+    }
+
+    for (uint32_t i = 0; i < directory->holeCount; i++) {
+        Extent* hole = &directory->holes[i];
+        if (address >= hole->address && address + size <= hole->address + hole->size) {
+            uint32_t tail = hole->address + hole->size - (address + size);
+            hole->size = address - hole->address;
+            if (tail > 0 && add_hole(directory, i + 1, address + size, tail) != 0) {
+                directory->usedBytes += tail;
+            }
+            if (hole->size == 0) {
+                remove_hole(directory, i);
+            }
+            return;
+        }
+    }
+}
+
+static int compare_extents(const void* a, const void* b) {
+    uint32_t x = ((const Extent*)a)->address;
+    uint32_t y = ((const Extent*)b)->address;
+    return (x > y) - (x < y);
+}
+
+// Derive the gaps and the end of the data area from the slots
+static int rebuild_space(StorageDirectory* directory) {
+    Extent* extents = (Extent*)malloc(((size_t)directory->keyCount + 1) * sizeof(Extent));
+    if (extents == NULL) {
+        return -1;
+    }
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < directory->slotCount; i++) {
+        if (directory->slots[i].used && directory->slots[i].size > 0) {
+            extents[count].address = directory->slots[i].address;
+            extents[count].size = directory->slots[i].size;
+            count++;
+        }
+    }
+    qsort(extents, count, sizeof(Extent), compare_extents);
+
+    directory->holeCount = 0;
+    directory->fresh.count = 0;
+    directory->released.count = 0;
+    directory->usedBytes = 0;
+    directory->top = directory->dataStart;
+    int result = 0;
+    for (uint32_t i = 0; i < count && result == 0; i++) {
+        if (extents[i].address > directory->top) {
+            result = add_hole(directory, directory->holeCount, directory->top, extents[i].address - directory->top);
+        }
+        uint32_t end = extents[i].address + extents[i].size;
+        if (end > directory->top) {
+            directory->top = end;
+        }
+        directory->usedBytes += extents[i].size;
+    }
+
+    free(extents);
+    return result;
+}
+
+// ===== Medium =====
+
+static uint32_t header_crc(const DirectoryHeader* header) {
+    return MCP_Crc32(header, offsetof(DirectoryHeader, crc));
+}
+
+static int write_header(StorageDirectory* directory, uint32_t copy, uint32_t sequence) {
+    DirectoryHeader header;
+    header.magic = DIRECTORY_MAGIC;
+    header.version = DIRECTORY_VERSION;
+    header.slotCount = directory->slotCount;
+    header.sequence = sequence;
+    header.crc = header_crc(&header);
+
+    return directory->medium.write(directory->medium.context, copy * HEADER_SIZE, &header,
+                                   sizeof(header)) == 0 ? 0 : -5;
+}
+
+static bool read_header(const StorageMedium* medium, uint32_t copy, DirectoryHeader* header) {
+    if (medium->read(medium->context, copy * HEADER_SIZE, header, sizeof(*header)) != 0) {
+        return false;
+    }
+
+    uint32_t slotCount = header->slotCount;
+    return header->magic == DIRECTORY_MAGIC &&
+           header->version == DIRECTORY_VERSION &&
+           header->crc == header_crc(header) &&
+           slotCount >= MIN_SLOTS && (slotCount & (slotCount - 1)) == 0 &&
+           slotCount < medium->size / (TABLE_COPIES * SLOT_SIZE);
+}
+
+static int sync_medium(StorageDirectory* directory) {
+    if (directory->medium.sync != NULL && directory->medium.sync(directory->medium.context) != 0) {
+        return -5;
+    }
+    return 0;
+}
+
+// Write the slots flagged in either bitmap to a table copy, or read them back
+// from it, one medium access per run
+static int transfer_slots(StorageDirectory* directory, uint32_t copy, const uint32_t* first, const uint32_t* second,
+                          bool toMedium) {
+    uint32_t i = 0;
+    while (i < directory->slotCount) {
+        if ((first[i / 32] | second[i / 32]) == 0) {
+            i = (i / 32 + 1) * 32;
+            continue;
+        }
+        if (!bit_set(first, i) && !bit_set(second, i)) {
+            i++;
+            continue;
+        }
+
+        uint32_t end = i;
+        while (end < directory->slotCount && (bit_set(first, end) || bit_set(second, end))) {
+            end++;
+        }
+        uint32_t offset = slot_offset(directory, copy, i);
+        size_t size = (size_t)(end - i) * sizeof(DirectorySlot);
+        int result = toMedium ? directory->medium.write(directory->medium.context, offset, &directory->slots[i], size)
+                              : directory->medium.read(directory->medium.context, offset, &directory->slots[i], size);
+        if (result != 0) {
+            return -5;
+        }
+        i = end;
+    }
+    return 0;
+}
+
+// Flag the slots where the other table copy differs from the RAM table
+static void find_stale_slots(StorageDirectory* directory, const DirectoryHeader* other) {
+    size_t words = (directory->slotCount + 31) / 32;
+    uint32_t chunkSlots = directory->slotCount < 64 ? directory->slotCount : 64;
+    DirectorySlot* chunk = NULL;
+    if (other != NULL && other->slotCount == directory->slotCount) {
+        chunk = (DirectorySlot*)malloc((size_t)chunkSlots * sizeof(DirectorySlot));
+    }
+
+    // Without the other copy to compare, all of it is rewritten by the next commit
+    memset(directory->stale, chunk != NULL ? 0 : 0xFF, words * sizeof(uint32_t));
+    if (chunk == NULL) {
+        return;
+    }
+
+    uint32_t copy = directory->active ^ 1;
+    for (uint32_t start = 0; start < directory->slotCount; start += chunkSlots) {
+        if (directory->medium.read(directory->medium.context, slot_offset(directory, copy, start), chunk,
+                                   (size_t)chunkSlots * sizeof(DirectorySlot)) != 0) {
+            memset(directory->stale, 0xFF, words * sizeof(uint32_t));
+            break;
+        }
+        for (uint32_t i = 0; i < chunkSlots; i++) {
+            if (memcmp(&chunk[i], &directory->slots[start + i], sizeof(DirectorySlot)) != 0) {
+                directory->stale[(start + i) / 32] |= 1u << ((start + i) % 32);
+            }
+        }
+    }
+    free(chunk);
+}
+
+// Count the keys and check every slot; anything out of place means the table gets rebuilt
+static int check_table(StorageDirectory* directory) {
+    bool damaged = false;
+    directory->keyCount = 0;
+    for (uint32_t i = 0; i < directory->slotCount; i++) {
+        DirectorySlot* slot = &directory->slots[i];
+        if (!slot->used) {
+            continue;
+        }
+        directory->keyCount++;
+        if (slot->used != 1 || !slot_valid(directory, slot)) {
+            damaged = true;
+        }
+    }
+    directory->sortedValid = false;
+
+    if (damaged || directory->keyCount > directory->maxKeys) {
+        DirectorySlot* loaded = (DirectorySlot*)malloc((size_t)directory->slotCount * sizeof(DirectorySlot));
+        if (loaded == NULL) {
+            return -1;
+        }
+        memcpy(loaded, directory->slots, (size_t)directory->slotCount * sizeof(DirectorySlot));
+        rebuild_table(directory, loaded);
+        free(loaded);
+    }
+
+    return rebuild_space(directory);
+}
+
+// Choose a table size for a new directory
+static uint32_t plan_slots(const StorageMedium* medium, uint32_t maxKeys) {
+    if (maxKeys == 0) {
+        maxKeys = medium->size / DEFAULT_BYTES_PER_KEY;
+        if (maxKeys < DEFAULT_MIN_KEYS) {
+            maxKeys = DEFAULT_MIN_KEYS;
+        }
+    }
+
+    // Keep the load factor at or under 3/4
+    uint32_t slotCount = MIN_SLOTS;
+    while (slotCount * 3 / 4 < maxKeys && slotCount < 0x1000000) {
+        slotCount *= 2;
+    }
+
+    // Leave about half of a small medium for data
+    while (slotCount > MIN_SLOTS && TABLE_COPIES * slotCount * SLOT_SIZE > medium->size / 2) {
+        slotCount /= 2;
+    }
+    return data_start(slotCount) <= medium->size ? slotCount : 0;
+}
+
+// ===== Public API =====
+
+StorageDirectory* storage_directory_mount(const StorageMedium* medium, uint32_t maxKeys) {
+    if (medium == NULL || medium->read == NULL || medium->write == NULL) {
+        return NULL;
+    }
+
+    // The valid header with the higher sequence names the committed table copy
+    DirectoryHeader headers[TABLE_COPIES];
+    bool valid[TABLE_COPIES];
+    for (uint32_t copy = 0; copy < TABLE_COPIES; copy++) {
+        valid[copy] = read_header(medium, copy, &headers[copy]);
+    }
+    int active = -1;
+    if (valid[0] && (!valid[1] || (int32_t)(headers[0].sequence - headers[1].sequence) > 0)) {
+        active = 0;
+    } else if (valid[1]) {
+        active = 1;
+    }
+
+    bool formatted = active >= 0;
+    uint32_t slotCount = formatted ? headers[active].slotCount : plan_slots(medium, maxKeys);
+    if (slotCount == 0) {
+        return NULL;
+    }
+
+    StorageDirectory* directory = (StorageDirectory*)calloc(1, sizeof(StorageDirectory));
+    if (directory == NULL) {
+        return NULL;
+    }
+    size_t words = (slotCount + 31) / 32;
+    directory->medium = *medium;
+    directory->slotCount = slotCount;
+    directory->maxKeys = slotCount * 3 / 4;
+    directory->dataStart = data_start(slotCount);
+    directory->holeCapacity = HOLES_INITIAL_CAPACITY;
+    directory->slots = (DirectorySlot*)calloc(slotCount, sizeof(DirectorySlot));
+    directory->dirty = (uint32_t*)calloc(words, sizeof(uint32_t));
+    directory->stale = (uint32_t*)calloc(words, sizeof(uint32_t));
+    directory->holes = (Extent*)malloc(directory->holeCapacity * sizeof(Extent));
+    directory->sorted = (DirectorySlot**)malloc(directory->maxKeys * sizeof(DirectorySlot*));
+    if (directory->slots == NULL || directory->dirty == NULL || directory->stale == NULL ||
+        directory->holes == NULL || directory->sorted == NULL) {
+        storage_directory_unmount(directory);
+        return NULL;
+    }
+
+    directory->top = directory->dataStart;
+    if (!formatted) {
+        // Blank or foreign medium: commit an empty table to the first copy
+        directory->active = 1;
+        if (storage_directory_clear(directory) != 0) {
+            storage_directory_unmount(directory);
+            return NULL;
+        }
+        return directory;
+    }
+
+    directory->active = (uint32_t)active;
+    directory->sequence = headers[active].sequence;
+    if (medium->read(medium->context, slot_offset(directory, directory->active, 0), directory->slots,
+                     (size_t)slotCount * sizeof(DirectorySlot)) != 0) {
+        storage_directory_unmount(directory);
+        return NULL;
+    }
+
+    // A commit cut short leaves the other copy partly written; the diff
+    // tells the next commit which of its slots to rewrite
+    find_stale_slots(directory, valid[active ^ 1] ? &headers[active ^ 1] : NULL);
+
+    if (check_table(directory) != 0) {
+        storage_directory_unmount(directory);
+        return NULL;
+    }
+    return directory;
+}
+
+void storage_directory_unmount(StorageDirectory* directory) {
+    if (directory == NULL) {
+        return;
+    }
+
+    free(directory->slots);
+    free(directory->dirty);
+    free(directory->stale);
+    free(directory->holes);
+    free(directory->fresh.items);
+    free(directory->released.items);
+    free(directory->sorted);
+    free(directory);
+}
+
+int storage_directory_write(StorageDirectory* directory, const char* key, const void* data, size_t size) {
+    if (directory == NULL || key == NULL || (data == NULL && size > 0)) {
+        return -1;
+    }
+
+    size_t keyLength = strlen(key);
+    if (keyLength > STORAGE_DIRECTORY_MAX_KEY_LENGTH) {
+        return -4;
+    }
+    if (size > directory->medium.size) {
+        return -2;
+    }
+
+    uint32_t hash = hash_key(key, keyLength);
+    DirectorySlot* slot = find_slot(directory, key, keyLength, hash);
+    if (slot == NULL && directory->keyCount >= directory->maxKeys) {
+        return -3;
+    }
+
+    // The committed value is never overwritten, so a crash before the next
+    // commit still finds it; a value written since then can be. The old
+    // extent is only given up once the new value is on the medium, so a
+    // failed write leaves the key and the space accounting as they were.
+    int fresh = find_fresh(directory, slot);
+    uint32_t address;
+    if (fresh >= 0 && size <= slot->size) {
+        // Rewrite in place, then give back the tail
+        address = slot->address;
+        if (size > 0 && directory->medium.write(directory->medium.context, address, data, size) != 0) {
+            return -5;
+        }
+        free_space(directory, address + (uint32_t)size, slot->size - (uint32_t)size);
+        if (size > 0) {
+            directory->fresh.items[fresh].size = (uint32_t)size;
+        } else {
+            list_remove(&directory->fresh, (uint32_t)fresh);
+        }
+    } else if (allocate_space(directory, (uint32_t)size, &address)) {
+        if (size > 0 && directory->medium.write(directory->medium.context, address, data, size) != 0) {
+            free_space(directory, address, (uint32_t)size);
+            return -5;
+        }
+        if (slot != NULL) {
+            release_space(directory, slot->address, slot->size);
+        }
+        // Out of memory: the value is treated as committed, which only delays reusing its space
+        if (size > 0) {
+            list_add(&directory->fresh, address, (uint32_t)size);
+        }
+    } else {
+        if (fresh < 0) {
+            return -2;
+        }
+
+        // Try again with the old value's space merged into the gaps
+        free_space(directory, slot->address, slot->size);
+        int result = 0;
+        if (!allocate_space(directory, (uint32_t)size, &address)) {
+            result = -2;
+        } else if (directory->medium.write(directory->medium.context, address, data, size) != 0) {
+            free_space(directory, address, (uint32_t)size);
+            result = -5;
+        }
+        if (result != 0) {
+            claim_space(directory, slot->address, slot->size);
+            return result;
+        }
+        directory->fresh.items[fresh].address = address;
+        directory->fresh.items[fresh].size = (uint32_t)size;
+    }
+
+    if (slot == NULL) {
+        slot = insert_slot(directory, key, keyLength, hash);
+    } else {
+        mark_dirty(directory, (uint32_t)(slot - directory->slots));
+    }
+    slot->address = address;
+    slot->size = (uint32_t)size;
+    return 0;
+}
+
+int storage_directory_read(StorageDirectory* directory, const char* key, void* data, size_t maxSize, size_t* actualSize) {
+    if (directory == NULL || key == NULL || data == NULL || actualSize == NULL) {
+        return -1;
+    }
+
+    DirectorySlot* slot = lookup(directory, key);
+    if (slot == NULL) {
+        return -2;
+    }
+
+    *actualSize = slot->size <= maxSize ? slot->size : maxSize;
+    if (*actualSize > 0 &&
+        directory->medium.read(directory->medium.context, slot->address, data, *actualSize) != 0) {
+        return -5;
+    }
+    return 0;
+}
+
+bool storage_directory_exists(StorageDirectory* directory, const char* key) {
+    return directory != NULL && key != NULL && lookup(directory, key) != NULL;
+}
+
+int storage_directory_delete(StorageDirectory* directory, const char* key) {
+    if (directory == NULL || key == NULL) {
+        return -1;
+    }
+
+    DirectorySlot* slot = lookup(directory, key);
+    if (slot == NULL) {
+        return -2;
+    }
+
+    release_space(directory, slot->address, slot->size);
+    remove_slot(directory, slot);
+    return 0;
+}
+
+int storage_directory_get_size(StorageDirectory* directory, const char* key) {
+    if (directory == NULL || key == NULL) {
+        return -1;
+    }
+
+    DirectorySlot* slot = lookup(directory, key);
+    return slot != NULL ? (int)slot->size : -2;
+}
+
+static int compare_slot_keys(const void* a, const void* b) {
+    return strcmp((*(DirectorySlot* const*)a)->key, (*(DirectorySlot* const*)b)->key);
+}
+
+int storage_directory_get_keys(StorageDirectory* directory, const char* prefix, char** keys, size_t maxKeys) {
+    if (directory == NULL || keys == NULL) {
+        return -1;
+    }
+
+    if (!directory->sortedValid) {
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < directory->slotCount; i++) {
+            if (directory->slots[i].used) {
+                directory->sorted[count++] = &directory->slots[i];
+            }
+        }
+        qsort(directory->sorted, count, sizeof(DirectorySlot*), compare_slot_keys);
+        directory->sortedValid = true;
+    }
+
+    // Binary search for the first key not below the prefix
+    size_t prefixLength = prefix != NULL ? strlen(prefix) : 0;
+    uint32_t low = 0;
+    uint32_t high = directory->keyCount;
+    while (prefixLength > 0 && low < high) {
+        uint32_t middle = (low + high) / 2;
+        if (strcmp(directory->sorted[middle]->key, prefix) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    size_t count = 0;
+    for (uint32_t i = low; i < directory->keyCount && count < maxKeys; i++) {
+        const char* key = directory->sorted[i]->key;
+        if (prefixLength > 0 && strncmp(key, prefix, prefixLength) != 0) {
+            break;
+        }
+        keys[count] = strdup(key);
+        if (keys[count] != NULL) {
+            count++;
+        }
+    }
+
+    return (int)count;
+}
+
+int storage_directory_commit(StorageDirectory* directory) {
+    if (directory == NULL) {
+        return -1;
+    }
+    if (!directory->anyDirty) {
+        return sync_medium(directory);
+    }
+
+    // Bring the other table copy up to date with the slots changed since the
+    // last commit and the ones that commit changed. Its header, written last
+    // with the next sequence, is what makes it the current copy.
+    uint32_t copy = directory->active ^ 1;
+    int result = transfer_slots(directory, copy, directory->dirty, directory->stale, true);
+    if (result == 0) {
+        result = sync_medium(directory);
+    }
+    if (result == 0) {
+        result = write_header(directory, copy, directory->sequence + 1);
+    }
+    if (result == 0) {
+        result = sync_medium(directory);
+    }
+    if (result != 0) {
+        return result;
+    }
+
+    directory->active = copy;
+    directory->sequence++;
+
+    // The copy just replaced now trails by the slots of this commit
+    uint32_t* stale = directory->stale;
+    directory->stale = directory->dirty;
+    directory->dirty = stale;
+    memset(directory->dirty, 0, ((directory->slotCount + 31) / 32) * sizeof(uint32_t));
+    directory->anyDirty = false;
+
+    // Nothing on the medium points at the released values any more
+    for (uint32_t i = 0; i < directory->released.count; i++) {
+        insert_gap(directory, directory->released.items[i].address, directory->released.items[i].size);
+    }
+    directory->released.count = 0;
+    directory->fresh.count = 0;
+    return 0;
+}
+
+int storage_directory_rollback(StorageDirectory* directory) {
+    if (directory == NULL) {
+        return -1;
+    }
+    if (!directory->anyDirty) {
+        return 0;
+    }
+
+    // Reread the changed slots from the committed copy
+    if (transfer_slots(directory, directory->active, directory->dirty, directory->dirty, false) != 0) {
+        return -5;
+    }
+    memset(directory->dirty, 0, ((directory->slotCount + 31) / 32) * sizeof(uint32_t));
+    directory->anyDirty = false;
+
+    return check_table(directory) == 0 ? 0 : -1;
+}
+
+int storage_directory_clear(StorageDirectory* directory) {
+    if (directory == NULL) {
+        return -1;
+    }
+
+    // The values stay on the medium until the empty table is committed
+    for (uint32_t i = 0; i < directory->slotCount; i++) {
+        if (directory->slots[i].used) {
+            release_space(directory, directory->slots[i].address, directory->slots[i].size);
+        }
+        mark_dirty(directory, i);
+    }
+    memset(directory->slots, 0, (size_t)directory->slotCount * sizeof(DirectorySlot));
+    directory->keyCount = 0;
+    directory->sortedValid = false;
+
+    return storage_directory_commit(directory);
+}
+
+int storage_directory_get_free_space(StorageDirectory* directory) {
+    if (directory == NULL) {
+        return -1;
+    }
+    return (int)(directory->medium.size - directory->dataStart - directory->usedBytes);
+}
+
+int storage_directory_get_capacity(StorageDirectory* directory) {
+    if (directory == NULL) {
+        return -1;
+    }
+    return (int)directory->maxKeys;
+}
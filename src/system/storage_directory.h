@@ -0,0 +1,161 @@
+/**
+ * @file storage_directory.h
+ * @brief Hashed key directory for in-place storage
+ *
+ * The start of the medium holds an open-addressing hash table of fixed-size
+ * slots, one per key, giving the address and size of its value in the data
+ * area behind the table. A RAM copy of the table serves lookups.
+ *
+ * Commits are atomic. The medium holds two copies of the table, each with a
+ * CRC-checked header carrying a commit sequence, and mount uses the valid copy
+ * with the higher sequence. A commit writes the changed slots to the other
+ * copy, then that copy's header, so a power loss at any byte leaves either the
+ * old or the new table. Values are copy-on-write: a value the last commit
+ * points to is never overwritten, and its space is reused only after the next
+ * commit. Values written since the last commit are rewritten in place when
+ * they fit. Mount reads both copies and recovers in time bounded by the table
+ * size, whatever the amount of data.
+ */
+#ifndef STORAGE_DIRECTORY_H
+#define STORAGE_DIRECTORY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "storage_medium.h"
+
+#define STORAGE_DIRECTORY_MAX_KEY_LENGTH 47
+
+typedef struct StorageDirectory StorageDirectory;
+
+/**
+ * @brief Mount a directory, formatting the medium if it holds none
+ *
+ * An existing directory keeps the capacity it was formatted with.
+ *
+ * @param medium Medium holding the directory (copied)
+ * @param maxKeys Key capacity for a new directory, or 0 to size it from the medium
+ * @return StorageDirectory* Mounted directory or NULL on failure
+ */
+StorageDirectory* storage_directory_mount(const StorageMedium* medium, uint32_t maxKeys);
+
+/**
+ * @brief Release a mounted directory (uncommitted changes are dropped)
+ *
+ * @param directory Directory to release
+ */
+void storage_directory_unmount(StorageDirectory* directory);
+
+/**
+ * @brief Write a value
+ *
+ * Space freed since the last commit is not reused before the next one. On a
+ * medium error the key keeps its previous value and space.
+ *
+ * @param directory Directory
+ * @param key Key (at most STORAGE_DIRECTORY_MAX_KEY_LENGTH bytes)
+ * @param data Value
+ * @param size Size of value
+ * @return int 0 on success, -2 if out of space, -3 if the directory is full,
+ *             -4 if the key is too long, -5 on a medium error
+ */
+int storage_directory_write(StorageDirectory* directory, const char* key, const void* data, size_t size);
+
+/**
+ * @brief Read a value
+ *
+ * @param directory Directory
+ * @param key Key
+ * @param data Output buffer
+ * @param maxSize Size of data; longer values are truncated
+ * @param actualSize Number of bytes copied
+ * @return int 0 on success, -2 if the key is not found
+ */
+int storage_directory_read(StorageDirectory* directory, const char* key, void* data, size_t maxSize, size_t* actualSize);
+
+/**
+ * @brief Check whether a key exists
+ *
+ * @param directory Directory
+ * @param key Key
+ * @return bool True if the key exists
+ */
+bool storage_directory_exists(StorageDirectory* directory, const char* key);
+
+/**
+ * @brief Delete a key and free its space
+ *
+ * @param directory Directory
+ * @param key Key
+ * @return int 0 on success, -2 if the key is not found
+ */
+int storage_directory_delete(StorageDirectory* directory, const char* key);
+
+/**
+ * @brief Get the value size of a key
+ *
+ * @param directory Directory
+ * @param key Key
+ * @return int Size in bytes, or -2 if the key is not found
+ */
+int storage_directory_get_size(StorageDirectory* directory, const char* key);
+
+/**
+ * @brief Copy out keys in sorted order
+ *
+ * The sorted view is cached until a key is added or removed, so repeated
+ * prefix queries cost a binary search plus the matches.
+ *
+ * @param directory Directory
+ * @param prefix Only return keys starting with this, or NULL for all keys
+ * @param keys Output array; each key is allocated with strdup
+ * @param maxKeys Size of keys
+ * @return int Number of keys written or negative error code
+ */
+int storage_directory_get_keys(StorageDirectory* directory, const char* prefix, char** keys, size_t maxKeys);
+
+/**
+ * @brief Make the writes and deletes since the last commit durable as one
+ *
+ * @param directory Directory
+ * @return int 0 on success, negative error code on failure; the changes stay
+ *             uncommitted and the next commit retries them
+ */
+int storage_directory_commit(StorageDirectory* directory);
+
+/**
+ * @brief Drop the writes and deletes since the last commit
+ *
+ * @param directory Directory
+ * @return int 0 on success, negative error code on failure
+ */
+int storage_directory_rollback(StorageDirectory* directory);
+
+/**
+ * @brief Drop all keys and commit the empty table
+ *
+ * @param directory Directory
+ * @return int 0 on success, negative error code on failure
+ */
+int storage_directory_clear(StorageDirectory* directory);
+
+/**
+ * @brief Get the data bytes not held by values
+ *
+ * Space freed since the last commit is counted, although it is only reused
+ * after the next commit.
+ *
+ * @param directory Directory
+ * @return int Free space in bytes or negative error code
+ */
+int storage_directory_get_free_space(StorageDirectory* directory);
+
+/**
+ * @brief Get the number of keys the directory can hold
+ *
+ * @param directory Directory
+ * @return int Key capacity or negative error code
+ */
+int storage_directory_get_capacity(StorageDirectory* directory);
+
+#endif /* STORAGE_DIRECTORY_H */
@@ -0,0 +1,182 @@
+/**
+ * @file storage_flash_sim.c
+ * @brief Simulated NOR flash device for developing and measuring storage layouts
+ */
+#include "storage_flash_sim.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_PROGRAM_PAGE_SIZE 256
+#define DEFAULT_READ_US 4
+#define DEFAULT_PROGRAM_US 700
+#define DEFAULT_ERASE_US 45000
+
+struct StorageFlashSim {
+    StorageFlashSimConfig config;
+    uint8_t* data;
+    uint32_t* eraseCounts;
+    bool* bad;
+    StorageFlashSimStats stats;
+};
+
+// Cost of an operation covering size bytes, charged per program page touched
+static uint64_t page_cost(const StorageFlashSim* sim, uint32_t offset, size_t size, uint32_t usPerPage) {
+    if (size == 0) {
+        return 0;
+    }
+    uint32_t pageSize = sim->config.programPageSize;
+    uint64_t first = offset / pageSize;
+    uint64_t last = (offset + size - 1) / pageSize;
+    return (last - first + 1) * usPerPage;
+}
+
+static int sim_read(void* context, uint32_t offset, void* data, size_t size) {
+    StorageFlashSim* sim = (StorageFlashSim*)context;
+    memcpy(data, sim->data + offset, size);
+    sim->stats.reads++;
+    sim->stats.busyUs += page_cost(sim, offset, size, sim->config.readUsPerPage);
+    return 0;
+}
+
+static int sim_write(void* context, uint32_t offset, const void* data, size_t size) {
+    StorageFlashSim* sim = (StorageFlashSim*)context;
+    uint32_t blockSize = sim->config.blockSize;
+
+    bool failed = false;
+    for (uint32_t block = offset / blockSize; size > 0 && block <= (offset + size - 1) / blockSize; block++) {
+        failed = failed || sim->bad[block];
+    }
+
+    // Programming only clears bits, and a failing block still clears some of them
+    const uint8_t* bytes = (const uint8_t*)data;
+    bool raised = false;
+    for (size_t i = 0; i < size; i++) {
+        uint8_t current = sim->data[offset + i];
+        raised = raised || (bytes[i] & ~current) != 0;
+        sim->data[offset + i] = current & bytes[i];
+    }
+    if (raised) {
+        sim->stats.bitsRaised++;
+    }
+
+    sim->stats.busyUs += page_cost(sim, offset, size, sim->config.programUsPerPage);
+    if (failed) {
+        sim->stats.failedPrograms++;
+        return -2;
+    }
+    sim->stats.programs++;
+    return 0;
+}
+
+static int sim_erase(void* context, uint32_t offset, uint32_t size) {
+    StorageFlashSim* sim = (StorageFlashSim*)context;
+    uint32_t blockSize = sim->config.blockSize;
+    if (offset % blockSize != 0 || size % blockSize != 0) {
+        return -1;
+    }
+
+    for (uint32_t block = offset / blockSize; block < (offset + size) / blockSize; block++) {
+        sim->stats.busyUs += sim->config.eraseUsPerBlock;
+
+        // A worn-out block fails the erase after its last good one, and everything after
+        if (sim->config.endurance > 0 && sim->eraseCounts[block] >= sim->config.endurance) {
+            sim->bad[block] = true;
+        }
+        if (sim->bad[block]) {
+            sim->stats.failedErases++;
+            return -2;
+        }
+
+        memset(sim->data + (size_t)block * blockSize, 0xFF, blockSize);
+        sim->eraseCounts[block]++;
+        sim->stats.erases++;
+    }
+    return 0;
+}
+
+StorageFlashSim* storage_flash_sim_create(const StorageFlashSimConfig* config) {
+    if (config == NULL || config->blockSize == 0 || config->blockCount == 0 ||
+        (uint64_t)config->blockSize * config->blockCount > UINT32_MAX) {
+        return NULL;
+    }
+
+    StorageFlashSim* sim = (StorageFlashSim*)calloc(1, sizeof(StorageFlashSim));
+    if (sim == NULL) {
+        return NULL;
+    }
+
+    sim->config = *config;
+    if (sim->config.programPageSize == 0) {
+        sim->config.programPageSize = DEFAULT_PROGRAM_PAGE_SIZE;
+    }
+    if (sim->config.readUsPerPage == 0) {
+        sim->config.readUsPerPage = DEFAULT_READ_US;
+    }
+    if (sim->config.programUsPerPage == 0) {
+        sim->config.programUsPerPage = DEFAULT_PROGRAM_US;
+    }
+    if (sim->config.eraseUsPerBlock == 0) {
+        sim->config.eraseUsPerBlock = DEFAULT_ERASE_US;
+    }
+
+    size_t size = (size_t)config->blockSize * config->blockCount;
+    sim->data = (uint8_t*)malloc(size);
+    sim->eraseCounts = (uint32_t*)calloc(config->blockCount, sizeof(uint32_t));
+    sim->bad = (bool*)calloc(config->blockCount, sizeof(bool));
+    if (sim->data == NULL || sim->eraseCounts == NULL || sim->bad == NULL) {
+        storage_flash_sim_destroy(sim);
+        return NULL;
+    }
+    memset(sim->data, 0xFF, size);
+    return sim;
+}
+
+void storage_flash_sim_destroy(StorageFlashSim* sim) {
+    if (sim == NULL) {
+        return;
+    }
+
+    free(sim->data);
+    free(sim->eraseCounts);
+    free(sim->bad);
+    free(sim);
+}
+
+int storage_flash_sim_get_medium(StorageFlashSim* sim, StorageMedium* medium) {
+    if (sim == NULL || medium == NULL) {
+        return -1;
+    }
+
+    medium->read = sim_read;
+    medium->write = sim_write;
+    medium->erase = sim_erase;
+    medium->sync = NULL;
+    medium->context = sim;
+    medium->size = sim->config.blockSize * sim->config.blockCount;
+    return 0;
+}
+
+int storage_flash_sim_mark_bad(StorageFlashSim* sim, uint32_t block) {
+    if (sim == NULL || block >= sim->config.blockCount) {
+        return -1;
+    }
+
+    sim->bad[block] = true;
+    return 0;
+}
+
+uint32_t storage_flash_sim_get_erase_count(const StorageFlashSim* sim, uint32_t block) {
+    if (sim == NULL || block >= sim->config.blockCount) {
+        return 0;
+    }
+    return sim->eraseCounts[block];
+}
+
+int storage_flash_sim_get_stats(const StorageFlashSim* sim, StorageFlashSimStats* stats) {
+    if (sim == NULL || stats == NULL) {
+        return -1;
+    }
+
+    *stats = sim->stats;
+    return 0;
+}
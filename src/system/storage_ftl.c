@@ -0,0 +1,716 @@
+/**
+ * @file storage_ftl.c
+ * @brief Wear-leveling flash translation layer
+ */
+#include "storage_ftl.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define FTL_MAGIC 0x46544C31u          // "FTL1"
+#define FTL_BAD_MAGIC 0u               // Programmed over the magic of a retired block
+#define HEADER_SIZE 32
+#define HEADER_MAGIC 0
+#define HEADER_ERASE_COUNT 4           // Erase count and its complement
+#define HEADER_SEQUENCE 12             // Sequence and its complement, written when the block is opened
+
+#define DEFAULT_PAGE_SIZE 256
+#define DEFAULT_WEAR_LEVEL_THRESHOLD 16
+#define MIN_SPARE_BLOCKS 3
+
+// Free blocks kept back so garbage collection always has somewhere to copy to,
+// even after a victim fails to erase and is retired
+#define GC_RESERVE 2
+
+// Attempts at placing a page before giving up on failing blocks
+#define MAX_PROGRAM_ATTEMPTS 4
+
+#define NO_BLOCK 0xFFFFFFFFu
+#define UNMAPPED 0xFFFFFFFFu
+#define MAP_TRIMMED 0x80000000u        // The slot holds a trim record, so the page reads as erased
+#define ERASED_TAG 0xFFFFFFFFu
+#define TAG_PAGE_MASK 0x007FFFFFu
+#define TAG_TRIM 0x00800000u
+#define MAX_LOGICAL_PAGES TAG_PAGE_MASK
+
+typedef enum {
+    BLOCK_FREE,     // Erased, header written
+    BLOCK_DIRTY,    // Must be erased before use
+    BLOCK_USED,     // Holds pages, or is the active block
+    BLOCK_BAD       // Retired
+} BlockState;
+
+typedef struct {
+    uint32_t eraseCount;
+    uint32_t sequence;
+    uint32_t validPages;
+    uint32_t nextSlot;
+    uint8_t state;
+} BlockInfo;
+
+struct StorageFtl {
+    StorageMedium flash;
+    uint32_t blockSize;
+    uint32_t pageSize;
+    uint32_t blockCount;
+    uint32_t slotsPerBlock;
+    uint32_t dataOffset;            // Offset of slot 0 within a block
+    uint32_t logicalPages;
+    uint32_t wearLevelThreshold;
+    uint32_t* map;                  // Logical page to physical slot, possibly MAP_TRIMMED
+    BlockInfo* blocks;
+    uint32_t active;
+    uint32_t sequence;
+    uint32_t freeBlocks;
+    uint32_t writesSinceWearCheck;
+    uint8_t* pageBuffer;            // Read-modify-write of partial pages
+    StorageFtlStats counters;
+};
+
+static int program_page(StorageFtl* ftl, uint32_t page, const void* data, bool gc);
+
+static uint32_t make_tag(uint32_t page, bool trim) {
+    uint32_t value = page | (trim ? TAG_TRIM : 0);
+    uint8_t check = (uint8_t)~(value ^ (value >> 8) ^ (value >> 16));
+    return value | ((uint32_t)check << 24);
+}
+
+static bool parse_tag(uint32_t tag, uint32_t* page, bool* trim) {
+    if (tag == ERASED_TAG) {
+        return false;
+    }
+    uint32_t value = tag & 0x00FFFFFFu;
+    if (make_tag(value & TAG_PAGE_MASK, (value & TAG_TRIM) != 0) != tag) {
+        return false;
+    }
+    *page = value & TAG_PAGE_MASK;
+    *trim = (value & TAG_TRIM) != 0;
+    return true;
+}
+
+// Slot a map entry refers to
+static uint32_t map_slot(uint32_t entry) {
+    return entry & ~MAP_TRIMMED;
+}
+
+// Whether a page has data on flash, as opposed to never written or trimmed
+static bool has_data(uint32_t entry) {
+    return entry != UNMAPPED && (entry & MAP_TRIMMED) == 0;
+}
+
+static uint32_t block_address(const StorageFtl* ftl, uint32_t block) {
+    return block * ftl->blockSize;
+}
+
+static uint32_t tag_address(const StorageFtl* ftl, uint32_t slot) {
+    return block_address(ftl, slot / ftl->slotsPerBlock) + HEADER_SIZE + (slot % ftl->slotsPerBlock) * 4;
+}
+
+static uint32_t data_address(const StorageFtl* ftl, uint32_t slot) {
+    return block_address(ftl, slot / ftl->slotsPerBlock) + ftl->dataOffset + (slot % ftl->slotsPerBlock) * ftl->pageSize;
+}
+
+static bool is_free(uint8_t state) {
+    return state == BLOCK_FREE || state == BLOCK_DIRTY;
+}
+
+static void set_state(StorageFtl* ftl, uint32_t block, BlockState state) {
+    BlockInfo* info = &ftl->blocks[block];
+    ftl->freeBlocks -= is_free(info->state) ? 1 : 0;
+    ftl->freeBlocks += is_free((uint8_t)state) ? 1 : 0;
+    info->state = (uint8_t)state;
+}
+
+static int write_pair(StorageFtl* ftl, uint32_t address, uint32_t value) {
+    uint32_t pair[2] = { value, ~value };
+    return ftl->flash.write(ftl->flash.context, address, pair, sizeof(pair));
+}
+
+static bool read_pair(const uint8_t* header, uint32_t* value) {
+    uint32_t pair[2];
+    memcpy(pair, header, sizeof(pair));
+    *value = pair[0];
+    return pair[0] == ~pair[1];
+}
+
+static void mark_bad(StorageFtl* ftl, uint32_t block) {
+    uint32_t magic = FTL_BAD_MAGIC;
+    ftl->flash.write(ftl->flash.context, block_address(ftl, block) + HEADER_MAGIC, &magic, sizeof(magic));
+
+    if (ftl->active == block) {
+        ftl->active = NO_BLOCK;
+    }
+    set_state(ftl, block, BLOCK_BAD);
+}
+
+// Erase a block unless it is known blank, then write its header; retires it on failure
+static int format_block(StorageFtl* ftl, uint32_t block, bool erase) {
+    BlockInfo* info = &ftl->blocks[block];
+    if (erase) {
+        if (ftl->flash.erase(ftl->flash.context, block_address(ftl, block), ftl->blockSize) != 0) {
+            mark_bad(ftl, block);
+            return -5;
+        }
+        info->eraseCount++;
+    }
+    info->validPages = 0;
+    info->nextSlot = 0;
+    info->sequence = 0;
+
+    uint32_t magic = FTL_MAGIC;
+    if (ftl->flash.write(ftl->flash.context, block_address(ftl, block) + HEADER_MAGIC, &magic, sizeof(magic)) != 0 ||
+        write_pair(ftl, block_address(ftl, block) + HEADER_ERASE_COUNT, info->eraseCount) != 0) {
+        mark_bad(ftl, block);
+        return -5;
+    }
+    set_state(ftl, block, BLOCK_FREE);
+    return 0;
+}
+
+static bool block_blank(StorageFtl* ftl, uint32_t block) {
+    uint8_t chunk[64];
+    for (uint32_t offset = 0; offset < ftl->blockSize; offset += sizeof(chunk)) {
+        uint32_t size = ftl->blockSize - offset < sizeof(chunk) ? ftl->blockSize - offset : (uint32_t)sizeof(chunk);
+        if (ftl->flash.read(ftl->flash.context, block_address(ftl, block) + offset, chunk, size) != 0) {
+            return false;
+        }
+        for (uint32_t i = 0; i < size; i++) {
+            if (chunk[i] != 0xFF) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Make the least worn free block the active one
+static int open_block(StorageFtl* ftl) {
+    for (;;) {
+        uint32_t best = NO_BLOCK;
+        for (uint32_t block = 0; block < ftl->blockCount; block++) {
+            const BlockInfo* info = &ftl->blocks[block];
+            if (is_free(info->state) && (best == NO_BLOCK || info->eraseCount < ftl->blocks[best].eraseCount)) {
+                best = block;
+            }
+        }
+        if (best == NO_BLOCK) {
+            return -2; // No space
+        }
+
+        // Blank flash needs only a header, not an erase
+        BlockInfo* info = &ftl->blocks[best];
+        if (info->state == BLOCK_DIRTY && format_block(ftl, best, !block_blank(ftl, best)) != 0) {
+            continue;
+        }
+
+        if (write_pair(ftl, block_address(ftl, best) + HEADER_SEQUENCE, ftl->sequence + 1) != 0) {
+            mark_bad(ftl, best);
+            continue;
+        }
+        info->sequence = ++ftl->sequence;
+        set_state(ftl, best, BLOCK_USED);
+        ftl->active = best;
+        return 0;
+    }
+}
+
+// Copy the live pages of a block elsewhere. Trim records are live too: dropping
+// one would let an older copy of its page reappear at the next mount.
+static int relocate_block(StorageFtl* ftl, uint32_t block) {
+    uint8_t* buffer = (uint8_t*)malloc(ftl->pageSize);
+    if (buffer == NULL) {
+        return -4;
+    }
+
+    int result = 0;
+    uint32_t first = block * ftl->slotsPerBlock;
+    for (uint32_t slot = first; slot < first + ftl->slotsPerBlock && ftl->blocks[block].validPages > 0; slot++) {
+        uint32_t tag;
+        uint32_t page;
+        bool trim;
+        if (ftl->flash.read(ftl->flash.context, tag_address(ftl, slot), &tag, sizeof(tag)) != 0) {
+            result = -5;
+            break;
+        }
+        if (!parse_tag(tag, &page, &trim) || page >= ftl->logicalPages ||
+            ftl->map[page] != (trim ? slot | MAP_TRIMMED : slot)) {
+            continue;
+        }
+
+        if (!trim && ftl->flash.read(ftl->flash.context, data_address(ftl, slot), buffer, ftl->pageSize) != 0) {
+            result = -5;
+            break;
+        }
+        result = program_page(ftl, page, trim ? NULL : buffer, true);
+        if (result != 0) {
+            break;
+        }
+    }
+
+    free(buffer);
+    return result;
+}
+
+// Move what a failing block still holds and take it out of service
+static void retire_block(StorageFtl* ftl, uint32_t block) {
+    if (ftl->active == block) {
+        ftl->active = NO_BLOCK;
+    }
+    relocate_block(ftl, block);
+    mark_bad(ftl, block);
+}
+
+// Reclaim the block with the fewest live pages. Without a free block to copy
+// into, as after power failed mid-collection, only one whose live pages fit in
+// the rest of the active block will do.
+static int collect(StorageFtl* ftl) {
+    uint32_t room = ftl->slotsPerBlock;
+    if (ftl->freeBlocks == 0) {
+        room = ftl->active != NO_BLOCK ? ftl->slotsPerBlock - ftl->blocks[ftl->active].nextSlot : 0;
+    }
+
+    uint32_t victim = NO_BLOCK;
+    for (uint32_t block = 0; block < ftl->blockCount; block++) {
+        const BlockInfo* info = &ftl->blocks[block];
+        if (info->state != BLOCK_USED || block == ftl->active || info->validPages > room) {
+            continue;
+        }
+        if (victim == NO_BLOCK || info->validPages < ftl->blocks[victim].validPages ||
+            (info->validPages == ftl->blocks[victim].validPages && info->eraseCount < ftl->blocks[victim].eraseCount)) {
+            victim = block;
+        }
+    }
+    if (victim == NO_BLOCK || ftl->blocks[victim].validPages >= ftl->slotsPerBlock) {
+        return -2; // No space
+    }
+
+    int result = relocate_block(ftl, victim);
+    if (result != 0) {
+        return result;
+    }
+    ftl->counters.collections++;
+    format_block(ftl, victim, true);
+    return 0;
+}
+
+// Move the data of the least worn block once it lags too far behind
+static void level_wear(StorageFtl* ftl) {
+    // Moving a block borrows from the reserve just like a collection does
+    if (ftl->freeBlocks < GC_RESERVE) {
+        return;
+    }
+
+    uint32_t coldest = NO_BLOCK;
+    uint32_t maxErases = 0;
+    for (uint32_t block = 0; block < ftl->blockCount; block++) {
+        const BlockInfo* info = &ftl->blocks[block];
+        if (info->state == BLOCK_BAD) {
+            continue;
+        }
+        if (info->eraseCount > maxErases) {
+            maxErases = info->eraseCount;
+        }
+        if (info->state == BLOCK_USED && block != ftl->active &&
+            (coldest == NO_BLOCK || info->eraseCount < ftl->blocks[coldest].eraseCount)) {
+            coldest = block;
+        }
+    }
+
+    if (coldest != NO_BLOCK && maxErases - ftl->blocks[coldest].eraseCount > ftl->wearLevelThreshold &&
+        relocate_block(ftl, coldest) == 0) {
+        ftl->counters.wearLevelMoves++;
+        format_block(ftl, coldest, true);
+    }
+}
+
+// Take the next free slot, collecting garbage first unless this is a copy
+static int reserve_slot(StorageFtl* ftl, bool gc, uint32_t* slot) {
+    // Host writes never eat into the blocks collection needs
+    while (!gc && ftl->freeBlocks < GC_RESERVE) {
+        int result = collect(ftl);
+        if (result != 0) {
+            return result;
+        }
+    }
+
+    for (;;) {
+        if (ftl->active != NO_BLOCK && ftl->blocks[ftl->active].nextSlot < ftl->slotsPerBlock) {
+            *slot = ftl->active * ftl->slotsPerBlock + ftl->blocks[ftl->active].nextSlot++;
+            return 0;
+        }
+
+        int result;
+        if (!gc && ftl->freeBlocks <= GC_RESERVE) {
+            result = collect(ftl);
+        } else {
+            result = open_block(ftl);
+        }
+        if (result != 0) {
+            return result;
+        }
+    }
+}
+
+// Write a logical page to a fresh slot, or a trim record when data is NULL
+static int program_page(StorageFtl* ftl, uint32_t page, const void* data, bool gc) {
+    for (int attempt = 0; attempt < MAX_PROGRAM_ATTEMPTS; attempt++) {
+        uint32_t slot;
+        int result = reserve_slot(ftl, gc, &slot);
+        if (result != 0) {
+            return result;
+        }
+
+        // The tag goes last so a torn page is never mapped
+        uint32_t tag = make_tag(page, data == NULL);
+        if ((data != NULL && ftl->flash.write(ftl->flash.context, data_address(ftl, slot), data, ftl->pageSize) != 0) ||
+            ftl->flash.write(ftl->flash.context, tag_address(ftl, slot), &tag, sizeof(tag)) != 0) {
+            retire_block(ftl, slot / ftl->slotsPerBlock);
+            continue;
+        }
+
+        uint32_t old = ftl->map[page];
+        if (old != UNMAPPED) {
+            ftl->blocks[map_slot(old) / ftl->slotsPerBlock].validPages--;
+        }
+        ftl->map[page] = data != NULL ? slot : slot | MAP_TRIMMED;
+        ftl->blocks[slot / ftl->slotsPerBlock].validPages++;
+        ftl->counters.flashPageWrites++;
+        return 0;
+    }
+    return -5;
+}
+
+// Write a page on behalf of the medium and keep wear in check
+static int write_host_page(StorageFtl* ftl, uint32_t page, const void* data) {
+    int result = program_page(ftl, page, data, false);
+    if (result != 0) {
+        return result;
+    }
+
+    ftl->counters.hostPageWrites++;
+    if (++ftl->writesSinceWearCheck >= ftl->slotsPerBlock) {
+        ftl->writesSinceWearCheck = 0;
+        level_wear(ftl);
+    }
+    return 0;
+}
+
+static int read_page(StorageFtl* ftl, uint32_t page, uint32_t offset, void* data, size_t size) {
+    uint32_t entry = ftl->map[page];
+    if (!has_data(entry)) {
+        memset(data, 0xFF, size);
+        return 0;
+    }
+    return ftl->flash.read(ftl->flash.context, data_address(ftl, entry) + offset, data, size);
+}
+
+static int ftl_read(void* context, uint32_t offset, void* data, size_t size) {
+    StorageFtl* ftl = (StorageFtl*)context;
+    uint8_t* bytes = (uint8_t*)data;
+
+    while (size > 0) {
+        uint32_t page = offset / ftl->pageSize;
+        uint32_t within = offset % ftl->pageSize;
+        size_t chunk = ftl->pageSize - within < size ? ftl->pageSize - within : size;
+        if (read_page(ftl, page, within, bytes, chunk) != 0) {
+            return -5;
+        }
+        bytes += chunk;
+        offset += (uint32_t)chunk;
+        size -= chunk;
+    }
+    return 0;
+}
+
+// Apply data to part of each page, or 0xFF when data is NULL
+static int update_pages(StorageFtl* ftl, uint32_t offset, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        uint32_t page = offset / ftl->pageSize;
+        uint32_t within = offset % ftl->pageSize;
+        size_t chunk = ftl->pageSize - within < size ? ftl->pageSize - within : size;
+        int result = 0;
+
+        if (chunk == ftl->pageSize) {
+            if (data != NULL || has_data(ftl->map[page])) {
+                result = write_host_page(ftl, page, data);
+            }
+        } else if (data != NULL || has_data(ftl->map[page])) {
+            result = read_page(ftl, page, 0, ftl->pageBuffer, ftl->pageSize);
+            if (result == 0) {
+                if (data != NULL) {
+                    memcpy(ftl->pageBuffer + within, data, chunk);
+                } else {
+                    memset(ftl->pageBuffer + within, 0xFF, chunk);
+                }
+                result = write_host_page(ftl, page, ftl->pageBuffer);
+            }
+        }
+        if (result != 0) {
+            return result;
+        }
+
+        if (data != NULL) {
+            data += chunk;
+        }
+        offset += (uint32_t)chunk;
+        size -= chunk;
+    }
+    return 0;
+}
+
+static int ftl_write(void* context, uint32_t offset, const void* data, size_t size) {
+    return update_pages((StorageFtl*)context, offset, (const uint8_t*)data, size);
+}
+
+static int ftl_erase(void* context, uint32_t offset, uint32_t size) {
+    return update_pages((StorageFtl*)context, offset, NULL, size);
+}
+
+static int ftl_sync(void* context) {
+    StorageFtl* ftl = (StorageFtl*)context;
+    return ftl->flash.sync != NULL ? ftl->flash.sync(ftl->flash.context) : 0;
+}
+
+// Read the header of every block and note its state and erase count
+static void scan_blocks(StorageFtl* ftl) {
+    uint64_t knownErases = 0;
+    uint32_t knownBlocks = 0;
+
+    for (uint32_t block = 0; block < ftl->blockCount; block++) {
+        BlockInfo* info = &ftl->blocks[block];
+        uint8_t header[HEADER_SEQUENCE + 8];
+        uint32_t magic = 0;
+        info->state = BLOCK_DIRTY;
+
+        if (ftl->flash.read(ftl->flash.context, block_address(ftl, block), header, sizeof(header)) != 0) {
+            continue;
+        }
+        memcpy(&magic, header + HEADER_MAGIC, sizeof(magic));
+        if (magic == FTL_BAD_MAGIC) {
+            info->state = BLOCK_BAD;
+            continue;
+        }
+        if (magic != FTL_MAGIC || !read_pair(header + HEADER_ERASE_COUNT, &info->eraseCount)) {
+            continue;
+        }
+
+        knownErases += info->eraseCount;
+        knownBlocks++;
+        info->state = read_pair(header + HEADER_SEQUENCE, &info->sequence) ? BLOCK_USED : BLOCK_FREE;
+        if (info->state == BLOCK_USED && info->sequence > ftl->sequence) {
+            ftl->sequence = info->sequence;
+        }
+    }
+
+    // Blocks that lost their header are assumed to be as worn as the average
+    uint32_t mean = knownBlocks > 0 ? (uint32_t)(knownErases / knownBlocks) : 0;
+    for (uint32_t block = 0; block < ftl->blockCount; block++) {
+        if (ftl->blocks[block].state == BLOCK_DIRTY) {
+            ftl->blocks[block].eraseCount = mean;
+        }
+        if (is_free(ftl->blocks[block].state)) {
+            ftl->freeBlocks++;
+        }
+    }
+}
+
+static bool slot_data_blank(StorageFtl* ftl, uint32_t slot) {
+    if (ftl->flash.read(ftl->flash.context, data_address(ftl, slot), ftl->pageBuffer, ftl->pageSize) != 0) {
+        return false;
+    }
+    for (uint32_t i = 0; i < ftl->pageSize; i++) {
+        if (ftl->pageBuffer[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Blocks being ordered by replay_blocks
+static const BlockInfo* s_sortBlocks = NULL;
+
+static int compare_block_sequence(const void* a, const void* b) {
+    uint32_t left = s_sortBlocks[*(const uint32_t*)a].sequence;
+    uint32_t right = s_sortBlocks[*(const uint32_t*)b].sequence;
+    return left < right ? -1 : (left > right ? 1 : 0);
+}
+
+// Replay the tags of the used blocks, oldest first, to rebuild the page map
+static int replay_blocks(StorageFtl* ftl) {
+    uint32_t* order = (uint32_t*)malloc(ftl->blockCount * sizeof(uint32_t));
+    uint32_t* tags = (uint32_t*)malloc(ftl->slotsPerBlock * sizeof(uint32_t));
+    if (order == NULL || tags == NULL) {
+        free(order);
+        free(tags);
+        return -4;
+    }
+
+    uint32_t used = 0;
+    for (uint32_t block = 0; block < ftl->blockCount; block++) {
+        if (ftl->blocks[block].state == BLOCK_USED) {
+            order[used++] = block;
+        }
+    }
+    s_sortBlocks = ftl->blocks;
+    qsort(order, used, sizeof(uint32_t), compare_block_sequence);
+
+    for (uint32_t i = 0; i < used; i++) {
+        uint32_t block = order[i];
+        uint32_t first = block * ftl->slotsPerBlock;
+        if (ftl->flash.read(ftl->flash.context, tag_address(ftl, first), tags, ftl->slotsPerBlock * sizeof(uint32_t)) != 0) {
+            continue;
+        }
+
+        uint32_t slot = 0;
+        for (; slot < ftl->slotsPerBlock && tags[slot] != ERASED_TAG; slot++) {
+            uint32_t page;
+            bool trim;
+            if (parse_tag(tags[slot], &page, &trim) && page < ftl->logicalPages) {
+                ftl->map[page] = trim ? (first + slot) | MAP_TRIMMED : first + slot;
+            }
+        }
+
+        // Only the newest block is appended to, past the data of any torn write,
+        // since tags in older blocks would be replayed before newer ones
+        if (i == used - 1 && slot < ftl->slotsPerBlock) {
+            if (!slot_data_blank(ftl, first + slot)) {
+                slot++;
+            }
+            if (slot < ftl->slotsPerBlock) {
+                ftl->active = block;
+            }
+        } else {
+            slot = ftl->slotsPerBlock;
+        }
+        ftl->blocks[block].nextSlot = slot;
+    }
+
+    for (uint32_t page = 0; page < ftl->logicalPages; page++) {
+        if (ftl->map[page] != UNMAPPED) {
+            ftl->blocks[map_slot(ftl->map[page]) / ftl->slotsPerBlock].validPages++;
+        }
+    }
+
+    // A block left with nothing live, as when power failed before garbage
+    // collection erased it, only needs erasing before reuse
+    for (uint32_t i = 0; i < used; i++) {
+        if (order[i] != ftl->active && ftl->blocks[order[i]].validPages == 0) {
+            set_state(ftl, order[i], BLOCK_DIRTY);
+        }
+    }
+
+    free(order);
+    free(tags);
+    return 0;
+}
+
+StorageFtl* storage_ftl_mount(const StorageMedium* flash, const StorageFtlConfig* config) {
+    if (flash == NULL || config == NULL || config->blockSize <= HEADER_SIZE || flash->size % config->blockSize != 0) {
+        return NULL;
+    }
+
+    uint32_t pageSize = config->pageSize > 0 ? config->pageSize : DEFAULT_PAGE_SIZE;
+    uint32_t blockCount = flash->size / config->blockSize;
+    uint32_t slotsPerBlock = (config->blockSize - HEADER_SIZE) / (pageSize + 4);
+    uint32_t spareBlocks = config->spareBlocks;
+    if (spareBlocks == 0) {
+        spareBlocks = blockCount / 8 > MIN_SPARE_BLOCKS ? blockCount / 8 : MIN_SPARE_BLOCKS;
+    }
+    if (slotsPerBlock < 2 || blockCount <= spareBlocks + GC_RESERVE ||
+        (uint64_t)(blockCount - spareBlocks) * slotsPerBlock > MAX_LOGICAL_PAGES ||
+        (uint64_t)(blockCount - spareBlocks) * slotsPerBlock * pageSize > UINT32_MAX) {
+        return NULL;
+    }
+
+    StorageFtl* ftl = (StorageFtl*)calloc(1, sizeof(StorageFtl));
+    if (ftl == NULL) {
+        return NULL;
+    }
+
+    ftl->flash = *flash;
+    ftl->blockSize = config->blockSize;
+    ftl->pageSize = pageSize;
+    ftl->blockCount = blockCount;
+    ftl->slotsPerBlock = slotsPerBlock;
+    ftl->dataOffset = HEADER_SIZE + slotsPerBlock * 4;
+    ftl->logicalPages = (blockCount - spareBlocks) * slotsPerBlock;
+    ftl->wearLevelThreshold = config->wearLevelThreshold > 0 ? config->wearLevelThreshold : DEFAULT_WEAR_LEVEL_THRESHOLD;
+    ftl->active = NO_BLOCK;
+    ftl->map = (uint32_t*)malloc(ftl->logicalPages * sizeof(uint32_t));
+    ftl->blocks = (BlockInfo*)calloc(blockCount, sizeof(BlockInfo));
+    ftl->pageBuffer = (uint8_t*)malloc(pageSize);
+    if (ftl->map == NULL || ftl->blocks == NULL || ftl->pageBuffer == NULL) {
+        storage_ftl_unmount(ftl);
+        return NULL;
+    }
+    memset(ftl->map, 0xFF, ftl->logicalPages * sizeof(uint32_t));
+
+    scan_blocks(ftl);
+    if (replay_blocks(ftl) != 0) {
+        storage_ftl_unmount(ftl);
+        return NULL;
+    }
+    return ftl;
+}
+
+void storage_ftl_unmount(StorageFtl* ftl) {
+    if (ftl == NULL) {
+        return;
+    }
+
+    free(ftl->map);
+    free(ftl->blocks);
+    free(ftl->pageBuffer);
+    free(ftl);
+}
+
+int storage_ftl_get_medium(StorageFtl* ftl, StorageMedium* medium) {
+    if (ftl == NULL || medium == NULL) {
+        return -1;
+    }
+
+    medium->read = ftl_read;
+    medium->write = ftl_write;
+    medium->erase = ftl_erase;
+    medium->sync = ftl_sync;
+    medium->context = ftl;
+    medium->size = ftl->logicalPages * ftl->pageSize;
+    return 0;
+}
+
+int storage_ftl_get_stats(const StorageFtl* ftl, StorageFtlStats* stats) {
+    if (ftl == NULL || stats == NULL) {
+        return -1;
+    }
+
+    *stats = ftl->counters;
+    stats->blockCount = ftl->blockCount;
+    stats->freeBlocks = ftl->freeBlocks;
+    stats->logicalPages = ftl->logicalPages;
+    stats->slotsPerBlock = ftl->slotsPerBlock;
+    stats->badBlocks = 0;
+
+    uint64_t totalErases = 0;
+    uint32_t goodBlocks = 0;
+    stats->eraseCountMin = UINT32_MAX;
+    stats->eraseCountMax = 0;
+    for (uint32_t block = 0; block < ftl->blockCount; block++) {
+        const BlockInfo* info = &ftl->blocks[block];
+        if (info->state == BLOCK_BAD) {
+            stats->badBlocks++;
+            continue;
+        }
+        goodBlocks++;
+        totalErases += info->eraseCount;
+        if (info->eraseCount < stats->eraseCountMin) {
+            stats->eraseCountMin = info->eraseCount;
+        }
+        if (info->eraseCount > stats->eraseCountMax) {
+            stats->eraseCountMax = info->eraseCount;
+        }
+    }
+    if (goodBlocks == 0) {
+        stats->eraseCountMin = 0;
+    }
+    stats->eraseCountMean = goodBlocks > 0 ? (float)totalErases / goodBlocks : 0.0f;
+    return 0;
+}
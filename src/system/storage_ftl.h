@@ -0,0 +1,99 @@
+/**
+ * @file storage_ftl.h
+ * @brief Wear-leveling flash translation layer
+ *
+ * Presents raw flash as a medium that can be rewritten in place, so the
+ * directory and log layouts can run on it unchanged. The logical space is cut
+ * into pages; every page write goes to the next free slot of the active erase
+ * block and the page map is updated in RAM, so no write erases anything.
+ *
+ * Each erase block holds a header, a tag per slot and the slot data:
+ *
+ *   [magic, erase count, sequence] [tag 0 .. tag n-1] [slot 0 .. slot n-1]
+ *
+ * A tag names the logical page whose data its slot holds and is programmed
+ * after the data, so a torn write leaves an untagged slot that mount ignores.
+ * Mount replays the tags of every block in sequence order to rebuild the map.
+ * Erasing a whole page writes a tag marked as a trim with no data; it stays
+ * mapped and moves with garbage collection so older copies never reappear.
+ *
+ * When free blocks run low, garbage collection copies the live pages of the
+ * block with the fewest of them and erases it. New blocks are taken in order
+ * of lowest erase count, and a block whose count trails the most worn block by
+ * more than the wear-level threshold has its cold data moved so it rejoins the
+ * rotation. Blocks that fail to erase or program are retired and recorded as
+ * bad in their header; spare blocks keep the logical size fixed as they go.
+ */
+#ifndef STORAGE_FTL_H
+#define STORAGE_FTL_H
+
+#include "storage_medium.h"
+
+typedef struct StorageFtl StorageFtl;
+
+/**
+ * @brief Translation layer geometry, fixed for the life of the flash contents
+ */
+typedef struct {
+    uint32_t blockSize;             // Erase block size in bytes
+    uint32_t pageSize;              // Logical page size, 0 for 256
+    uint32_t spareBlocks;           // Blocks not counted in the logical size, 0 for one eighth (at least 3)
+    uint32_t wearLevelThreshold;    // Erase count gap that moves cold data, 0 for 16
+} StorageFtlConfig;
+
+/**
+ * @brief Translation layer counters
+ */
+typedef struct {
+    uint32_t blockCount;
+    uint32_t freeBlocks;            // Erased or erasable without copying
+    uint32_t badBlocks;
+    uint32_t logicalPages;
+    uint32_t slotsPerBlock;
+    uint32_t hostPageWrites;        // Pages written through the medium
+    uint32_t flashPageWrites;       // Pages programmed, including copies
+    uint32_t collections;           // Blocks reclaimed by garbage collection
+    uint32_t wearLevelMoves;        // Blocks whose cold data was moved
+    uint32_t eraseCountMin;         // Over blocks that are not bad
+    uint32_t eraseCountMax;
+    float eraseCountMean;
+} StorageFtlStats;
+
+/**
+ * @brief Mount the translation layer, formatting flash that holds none
+ *
+ * @param flash Raw flash medium; its size must be a multiple of the block size
+ * @param config Geometry, which must match the one the flash was formatted with
+ * @return StorageFtl* Translation layer or NULL on failure
+ */
+StorageFtl* storage_ftl_mount(const StorageMedium* flash, const StorageFtlConfig* config);
+
+/**
+ * @brief Unmount the translation layer
+ *
+ * @param ftl Translation layer to free
+ */
+void storage_ftl_unmount(StorageFtl* ftl);
+
+/**
+ * @brief Get the logical medium
+ *
+ * Erasing a range of it discards the pages it covers entirely and fills the
+ * rest with 0xFF. The medium is valid until the layer is unmounted.
+ *
+ * @param ftl Translation layer
+ * @param medium Medium to initialize
+ * @return int 0 on success, negative error code on failure
+ */
+int storage_ftl_get_medium(StorageFtl* ftl, StorageMedium* medium);
+
+/**
+ * @brief Get the translation layer counters
+ *
+ * @param ftl Translation layer
+ * @param stats Output counters
+ * @return int 0 on success, negative error code on failure
+ */
+int storage_ftl_get_stats(const StorageFtl* ftl, StorageFtlStats* stats);
+
+#endif /* STORAGE_FTL_H */
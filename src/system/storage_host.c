@@ -0,0 +1,572 @@
+/**
+ * @file storage_host.c
+ * @brief Host (POSIX) storage: a memory-mapped image file and one file per key
+ */
+#include "storage_host.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef STORAGE_HOST_POSIX
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+#define NAME_BUFFER_SIZE 256
+#define TEMP_PREFIX '~'
+
+struct StorageFiles {
+    int dirFd;
+    bool deferSync;
+    char** pending;         // Keys whose value waits in a temporary file
+    size_t pendingCount;
+    size_t pendingCapacity;
+};
+
+// ===== Image =====
+
+int storage_image_open(StorageImage* image, const char* path, uint32_t size) {
+    if (image == NULL || path == NULL || size == 0) {
+        return -1;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -2;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -2;
+    }
+
+    off_t existing = st.st_size;
+    if (existing < (off_t)size && ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        return -3;
+    }
+
+    void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        return -4;
+    }
+
+    // New bytes read as erased, like a fresh EEPROM or flash part
+    if (existing < (off_t)size) {
+        memset((uint8_t*)data + existing, 0xFF, size - (size_t)existing);
+    }
+
+    image->data = (uint8_t*)data;
+    image->size = size;
+    image->fd = fd;
+    return 0;
+}
+
+int storage_image_sync(StorageImage* image) {
+    if (image == NULL || image->data == NULL) {
+        return -1;
+    }
+    return msync(image->data, image->size, MS_SYNC) == 0 ? 0 : -2;
+}
+
+void storage_image_close(StorageImage* image) {
+    if (image == NULL || image->data == NULL) {
+        return;
+    }
+
+    munmap(image->data, image->size);
+    close(image->fd);
+    image->data = NULL;
+    image->fd = -1;
+}
+
+// ===== Key files =====
+
+static bool is_plain_char(char c, size_t position) {
+    if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) {
+        return true;
+    }
+    // A leading dot would make hidden, "." or ".." names
+    return c == '_' || c == '-' || (c == '.' && position > 0);
+}
+
+// Build the file name of a key, or of its temporary file
+static int key_name(const char* key, bool temporary, char* name) {
+    static const char hex[] = "0123456789ABCDEF";
+    size_t length = 0;
+
+    if (key == NULL || key[0] == '\0') {
+        return -1;
+    }
+
+    if (temporary) {
+        name[length++] = TEMP_PREFIX;
+    }
+
+    for (size_t i = 0; key[i] != '\0'; i++) {
+        if (length + 4 > NAME_BUFFER_SIZE) {
+            return -1; // Longer than a file name can be
+        }
+
+        if (is_plain_char(key[i], i)) {
+            name[length++] = key[i];
+        } else {
+            uint8_t byte = (uint8_t)key[i];
+            name[length++] = '%';
+            name[length++] = hex[byte >> 4];
+            name[length++] = hex[byte & 0x0F];
+        }
+    }
+
+    name[length] = '\0';
+    return 0;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+static char* decode_name(const char* name) {
+    char* key = (char*)malloc(strlen(name) + 1);
+    if (key == NULL) {
+        return NULL;
+    }
+
+    size_t length = 0;
+    for (size_t i = 0; name[i] != '\0'; i++) {
+        if (name[i] == '%' && hex_value(name[i + 1]) >= 0 && hex_value(name[i + 2]) >= 0) {
+            key[length++] = (char)(hex_value(name[i + 1]) << 4 | hex_value(name[i + 2]));
+            i += 2;
+        } else {
+            key[length++] = name[i];
+        }
+    }
+
+    key[length] = '\0';
+    return key;
+}
+
+static int find_pending(const StorageFiles* files, const char* key) {
+    for (size_t i = 0; i < files->pendingCount; i++) {
+        if (strcmp(files->pending[i], key) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static int add_pending(StorageFiles* files, const char* key) {
+    if (find_pending(files, key) >= 0) {
+        return 0;
+    }
+
+    if (files->pendingCount == files->pendingCapacity) {
+        size_t capacity = files->pendingCapacity == 0 ? 16 : files->pendingCapacity * 2;
+        char** pending = (char**)realloc(files->pending, capacity * sizeof(char*));
+        if (pending == NULL) {
+            return -1;
+        }
+        files->pending = pending;
+        files->pendingCapacity = capacity;
+    }
+
+    files->pending[files->pendingCount] = strdup(key);
+    if (files->pending[files->pendingCount] == NULL) {
+        return -1;
+    }
+    files->pendingCount++;
+    return 0;
+}
+
+static void remove_pending(StorageFiles* files, int index) {
+    free(files->pending[index]);
+    files->pending[index] = files->pending[--files->pendingCount];
+}
+
+// Name a key is currently read from: its temporary file while pending
+static int current_name(const StorageFiles* files, const char* key, char* name) {
+    return key_name(key, find_pending(files, key) >= 0, name);
+}
+
+// List the directory through a duplicate of its descriptor
+static DIR* open_listing(const StorageFiles* files) {
+    int fd = dup(files->dirFd);
+    DIR* dir = fd >= 0 ? fdopendir(fd) : NULL;
+    if (dir == NULL) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+
+    // The duplicate shares the read position of earlier listings
+    rewinddir(dir);
+    return dir;
+}
+
+static void remove_entries(StorageFiles* files, bool temporaryOnly) {
+    DIR* dir = open_listing(files);
+    if (dir == NULL) {
+        return;
+    }
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.' || (temporaryOnly && entry->d_name[0] != TEMP_PREFIX)) {
+            continue;
+        }
+        unlinkat(files->dirFd, entry->d_name, 0);
+    }
+    closedir(dir);
+}
+
+StorageFiles* storage_files_open(const char* path, bool deferSync) {
+    if (path == NULL) {
+        return NULL;
+    }
+
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+        return NULL;
+    }
+
+    StorageFiles* files = (StorageFiles*)calloc(1, sizeof(StorageFiles));
+    if (files == NULL) {
+        return NULL;
+    }
+
+    files->dirFd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (files->dirFd < 0) {
+        free(files);
+        return NULL;
+    }
+    files->deferSync = deferSync;
+
+    // Values that never reached a sync were not committed
+    remove_entries(files, true);
+    return files;
+}
+
+void storage_files_close(StorageFiles* files) {
+    if (files == NULL) {
+        return;
+    }
+
+    while (files->pendingCount > 0) {
+        char name[NAME_BUFFER_SIZE];
+        if (key_name(files->pending[0], true, name) == 0) {
+            unlinkat(files->dirFd, name, 0);
+        }
+        remove_pending(files, 0);
+    }
+
+    free(files->pending);
+    close(files->dirFd);
+    free(files);
+}
+
+int storage_files_write(StorageFiles* files, const char* key, const void* data, size_t size) {
+    char temporary[NAME_BUFFER_SIZE];
+    if (files == NULL || key_name(key, true, temporary) != 0) {
+        return -1;
+    }
+
+    int fd = openat(files->dirFd, temporary, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -3;
+    }
+
+    const uint8_t* bytes = (const uint8_t*)data;
+    size_t written = 0;
+    while (written < size) {
+        ssize_t result = write(fd, bytes + written, size - written);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            close(fd);
+            unlinkat(files->dirFd, temporary, 0);
+            return -4;
+        }
+        written += (size_t)result;
+    }
+    close(fd);
+
+    if (files->deferSync) {
+        return add_pending(files, key) == 0 ? 0 : -5;
+    }
+
+    char name[NAME_BUFFER_SIZE];
+    key_name(key, false, name);
+    return renameat(files->dirFd, temporary, files->dirFd, name) == 0 ? 0 : -6;
+}
+
+int storage_files_read(StorageFiles* files, const char* key, void* data, size_t maxSize, size_t* actualSize) {
+    char name[NAME_BUFFER_SIZE];
+    if (files == NULL || data == NULL || current_name(files, key, name) != 0) {
+        return -1;
+    }
+
+    int fd = openat(files->dirFd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return errno == ENOENT ? -2 : -3;
+    }
+
+    uint8_t* bytes = (uint8_t*)data;
+    size_t total = 0;
+    while (total < maxSize) {
+        ssize_t result = read(fd, bytes + total, maxSize - total);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result < 0) {
+            close(fd);
+            return -4;
+        }
+        if (result == 0) {
+            break;
+        }
+        total += (size_t)result;
+    }
+    close(fd);
+
+    if (actualSize != NULL) {
+        *actualSize = total;
+    }
+    return 0;
+}
+
+bool storage_files_exists(StorageFiles* files, const char* key) {
+    return storage_files_get_size(files, key) >= 0;
+}
+
+int storage_files_delete(StorageFiles* files, const char* key) {
+    char name[NAME_BUFFER_SIZE];
+    if (files == NULL || key_name(key, false, name) != 0) {
+        return -1;
+    }
+
+    bool found = false;
+    int pending = find_pending(files, key);
+    if (pending >= 0) {
+        char temporary[NAME_BUFFER_SIZE];
+        key_name(key, true, temporary);
+        unlinkat(files->dirFd, temporary, 0);
+        remove_pending(files, pending);
+        found = true;
+    }
+
+    if (unlinkat(files->dirFd, name, 0) == 0) {
+        found = true;
+    }
+
+    return found ? 0 : -2;
+}
+
+int storage_files_get_size(StorageFiles* files, const char* key) {
+    char name[NAME_BUFFER_SIZE];
+    if (files == NULL || current_name(files, key, name) != 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstatat(files->dirFd, name, &st, 0) != 0) {
+        return -2;
+    }
+    return st.st_size > INT_MAX ? INT_MAX : (int)st.st_size;
+}
+
+int storage_files_get_keys(StorageFiles* files, const char* prefix, char** keys, size_t maxKeys) {
+    if (files == NULL || keys == NULL) {
+        return -1;
+    }
+
+    size_t prefixLength = prefix != NULL ? strlen(prefix) : 0;
+
+    DIR* dir = open_listing(files);
+    if (dir == NULL) {
+        return -2;
+    }
+
+    size_t count = 0;
+    struct dirent* entry;
+    while (count < maxKeys && (entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.' || entry->d_name[0] == TEMP_PREFIX) {
+            continue;
+        }
+
+        keys[count] = decode_name(entry->d_name);
+        if (keys[count] != NULL && strncmp(keys[count], prefix != NULL ? prefix : "", prefixLength) != 0) {
+            free(keys[count]);
+        } else if (keys[count] != NULL) {
+            count++;
+        }
+    }
+    closedir(dir);
+
+    // Pending keys that have no file yet
+    for (size_t i = 0; i < files->pendingCount && count < maxKeys; i++) {
+        char name[NAME_BUFFER_SIZE];
+        struct stat st;
+        key_name(files->pending[i], false, name);
+        if (strncmp(files->pending[i], prefix != NULL ? prefix : "", prefixLength) == 0 &&
+            fstatat(files->dirFd, name, &st, 0) != 0) {
+            keys[count] = strdup(files->pending[i]);
+            if (keys[count] != NULL) {
+                count++;
+            }
+        }
+    }
+
+    return (int)count;
+}
+
+int storage_files_sync(StorageFiles* files) {
+    if (files == NULL) {
+        return -1;
+    }
+
+    int result = 0;
+    while (files->pendingCount > 0) {
+        char temporary[NAME_BUFFER_SIZE];
+        char name[NAME_BUFFER_SIZE];
+        key_name(files->pending[0], true, temporary);
+        key_name(files->pending[0], false, name);
+
+        // Data first, then the rename that publishes it
+        int fd = openat(files->dirFd, temporary, O_RDONLY | O_CLOEXEC);
+        if (fd < 0 || fsync(fd) != 0 || renameat(files->dirFd, temporary, files->dirFd, name) != 0) {
+            result = -2;
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        remove_pending(files, 0);
+    }
+
+    if (fsync(files->dirFd) != 0) {
+        result = -3;
+    }
+    return result;
+}
+
+int storage_files_clear(StorageFiles* files) {
+    if (files == NULL) {
+        return -1;
+    }
+
+    while (files->pendingCount > 0) {
+        remove_pending(files, 0);
+    }
+    remove_entries(files, false);
+    return fsync(files->dirFd) == 0 ? 0 : -2;
+}
+
+static int capped_bytes(unsigned long long bytes) {
+    return bytes > INT_MAX ? INT_MAX : (int)bytes;
+}
+
+int storage_files_get_free_space(StorageFiles* files) {
+    struct statvfs st;
+    if (files == NULL || fstatvfs(files->dirFd, &st) != 0) {
+        return -1;
+    }
+    return capped_bytes((unsigned long long)st.f_bavail * st.f_frsize);
+}
+
+int storage_files_get_total_space(StorageFiles* files) {
+    struct statvfs st;
+    if (files == NULL || fstatvfs(files->dirFd, &st) != 0) {
+        return -1;
+    }
+    return capped_bytes((unsigned long long)st.f_blocks * st.f_frsize);
+}
+
+#else // !STORAGE_HOST_POSIX
+
+// No host file system: callers fall back to the RAM emulation
+
+int storage_image_open(StorageImage* image, const char* path, uint32_t size) {
+    (void)image; (void)path; (void)size;
+    return -1;
+}
+
+int storage_image_sync(StorageImage* image) {
+    (void)image;
+    return -1;
+}
+
+void storage_image_close(StorageImage* image) {
+    (void)image;
+}
+
+StorageFiles* storage_files_open(const char* path, bool deferSync) {
+    (void)path; (void)deferSync;
+    return NULL;
+}
+
+void storage_files_close(StorageFiles* files) {
+    (void)files;
+}
+
+int storage_files_write(StorageFiles* files, const char* key, const void* data, size_t size) {
+    (void)files; (void)key; (void)data; (void)size;
+    return -1;
+}
+
+int storage_files_read(StorageFiles* files, const char* key, void* data, size_t maxSize, size_t* actualSize) {
+    (void)files; (void)key; (void)data; (void)maxSize; (void)actualSize;
+    return -1;
+}
+
+bool storage_files_exists(StorageFiles* files, const char* key) {
+    (void)files; (void)key;
+    return false;
+}
+
+int storage_files_delete(StorageFiles* files, const char* key) {
+    (void)files; (void)key;
+    return -1;
+}
+
+int storage_files_get_size(StorageFiles* files, const char* key) {
+    (void)files; (void)key;
+    return -1;
+}
+
+int storage_files_get_keys(StorageFiles* files, const char* prefix, char** keys, size_t maxKeys) {
+    (void)files; (void)prefix; (void)keys; (void)maxKeys;
+    return -1;
+}
+
+int storage_files_sync(StorageFiles* files) {
+    (void)files;
+    return -1;
+}
+
+int storage_files_clear(StorageFiles* files) {
+    (void)files;
+    return -1;
+}
+
+int storage_files_get_free_space(StorageFiles* files) {
+    (void)files;
+    return -1;
+}
+
+int storage_files_get_total_space(StorageFiles* files) {
+    (void)files;
+    return -1;
+}
+
+#endif // STORAGE_HOST_POSIX
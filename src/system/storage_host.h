@@ -0,0 +1,178 @@
+/**
+ * @file storage_host.h
+ * @brief Host (POSIX) storage: a memory-mapped image file and one file per key
+ *
+ * Only available on hosts with a POSIX file system; elsewhere the open
+ * functions fail and persistent storage keeps its RAM emulation.
+ */
+#ifndef STORAGE_HOST_H
+#define STORAGE_HOST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#if (defined(MCP_OS_HOST) || defined(MCP_PLATFORM_HOST) || defined(MCP_OS_RPI)) && !defined(_WIN32)
+#define STORAGE_HOST_POSIX 1
+#endif
+
+/**
+ * @brief Image file mapped in place of the RAM emulation
+ */
+typedef struct {
+    uint8_t* data;      // Mapping, NULL when closed
+    uint32_t size;
+    int fd;
+} StorageImage;
+
+/**
+ * @brief Directory holding one file per key
+ */
+typedef struct StorageFiles StorageFiles;
+
+/**
+ * @brief Map an image file, creating or extending it with erased (0xFF) bytes
+ *
+ * @param image Image to open
+ * @param path File path
+ * @param size Image size in bytes
+ * @return int 0 on success, negative error code on failure
+ */
+int storage_image_open(StorageImage* image, const char* path, uint32_t size);
+
+/**
+ * @brief Write dirty pages of the image back to the file (msync)
+ *
+ * @param image Open image
+ * @return int 0 on success, negative error code on failure
+ */
+int storage_image_sync(StorageImage* image);
+
+/**
+ * @brief Unmap and close an image (no sync)
+ *
+ * @param image Image to close
+ */
+void storage_image_close(StorageImage* image);
+
+/**
+ * @brief Open a key directory, creating it if needed
+ *
+ * Keys are stored as files named after the key, with bytes outside
+ * [A-Za-z0-9._-] escaped as %XX. Leftover temporary files are removed.
+ *
+ * @param path Directory path
+ * @param deferSync Keep new values in temporary files until storage_files_sync
+ *                  instead of replacing the key file on write
+ * @return StorageFiles* Open directory or NULL on failure
+ */
+StorageFiles* storage_files_open(const char* path, bool deferSync);
+
+/**
+ * @brief Close a key directory (pending values are discarded)
+ *
+ * @param files Directory to close
+ */
+void storage_files_close(StorageFiles* files);
+
+/**
+ * @brief Write a key
+ *
+ * The value goes to a temporary file that replaces the key file by rename, so
+ * a key never holds a partial value. With deferred sync the rename happens at
+ * the next storage_files_sync; until then reads see the pending value.
+ *
+ * @param files Directory
+ * @param key Key
+ * @param data Value
+ * @param size Size of value
+ * @return int 0 on success, negative error code on failure
+ */
+int storage_files_write(StorageFiles* files, const char* key, const void* data, size_t size);
+
+/**
+ * @brief Read a key
+ *
+ * @param files Directory
+ * @param key Key
+ * @param data Output buffer
+ * @param maxSize Size of data; longer values are truncated
+ * @param actualSize Number of bytes copied
+ * @return int 0 on success, -2 if the key is not found, other negative codes on failure
+ */
+int storage_files_read(StorageFiles* files, const char* key, void* data, size_t maxSize, size_t* actualSize);
+
+/**
+ * @brief Check whether a key exists
+ *
+ * @param files Directory
+ * @param key Key
+ * @return bool True if the key exists
+ */
+bool storage_files_exists(StorageFiles* files, const char* key);
+
+/**
+ * @brief Delete a key
+ *
+ * @param files Directory
+ * @param key Key
+ * @return int 0 on success, -2 if the key is not found
+ */
+int storage_files_delete(StorageFiles* files, const char* key);
+
+/**
+ * @brief Get the value size of a key
+ *
+ * @param files Directory
+ * @param key Key
+ * @return int Size in bytes, or -2 if the key is not found
+ */
+int storage_files_get_size(StorageFiles* files, const char* key);
+
+/**
+ * @brief Copy out the stored keys
+ *
+ * @param files Directory
+ * @param prefix Only return keys starting with this, or NULL for all keys
+ * @param keys Output array; each key is allocated with strdup
+ * @param maxKeys Size of keys
+ * @return int Number of keys written or negative error code
+ */
+int storage_files_get_keys(StorageFiles* files, const char* prefix, char** keys, size_t maxKeys);
+
+/**
+ * @brief Make all writes and deletes so far durable
+ *
+ * Pending values are fsynced and renamed into place, then the directory is
+ * fsynced.
+ *
+ * @param files Directory
+ * @return int 0 on success, negative error code on failure
+ */
+int storage_files_sync(StorageFiles* files);
+
+/**
+ * @brief Delete every key
+ *
+ * @param files Directory
+ * @return int 0 on success, negative error code on failure
+ */
+int storage_files_clear(StorageFiles* files);
+
+/**
+ * @brief Get the free space of the file system holding the directory
+ *
+ * @param files Directory
+ * @return int Free bytes (capped at INT_MAX) or negative error code
+ */
+int storage_files_get_free_space(StorageFiles* files);
+
+/**
+ * @brief Get the size of the file system holding the directory
+ *
+ * @param files Directory
+ * @return int Total bytes (capped at INT_MAX) or negative error code
+ */
+int storage_files_get_total_space(StorageFiles* files);
+
+#endif /* STORAGE_HOST_H */
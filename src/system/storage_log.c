@@ -0,0 +1,987 @@
+/**
+ * @file storage_log.c
+ * @brief Log-structured key-value store over a storage medium
+ */
+#include "storage_log.h"
+#include "../util/crc32.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SEGMENT_MAGIC 0x4C6F6753 // "LogS" in ASCII
+#define RECORD_PUT 0x01
+#define RECORD_DELETE 0x02
+#define RECORD_COMMIT 0x03     // Ends a batch; no key or value
+#define RECORD_ALIGN 4
+#define INDEX_INITIAL_CAPACITY 32
+#define MIN_SEGMENTS 2
+
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;      // Order of the segment in the log, never 0
+    uint32_t crc;           // CRC-32 of magic and sequence
+} SegmentHeader;
+
+typedef struct {
+    uint8_t type;
+    uint8_t keyLength;
+    uint16_t batch;         // Batch the record belongs to, 0 for none
+    uint32_t valueLength;
+    uint32_t crc;           // CRC-32 of the fields above, the key and the value
+} RecordHeader;
+
+typedef struct {
+    uint32_t sequence;      // 0 when the segment is free
+    uint32_t used;          // Bytes appended, segment header included
+    uint32_t live;          // Bytes held by records the index points to
+} Segment;
+
+typedef struct {
+    char* key;              // NULL for an empty slot
+    uint32_t hash;
+    uint32_t offset;        // Record offset on the medium
+    uint32_t valueLength;
+} IndexEntry;
+
+typedef struct {
+    char* key;
+    uint32_t hash;
+    uint32_t offset;        // Record offset on the medium
+    uint32_t valueLength;
+    uint8_t type;           // RECORD_PUT or RECORD_DELETE
+} PendingRecord;
+
+struct StorageLog {
+    StorageMedium medium;
+    uint32_t segmentSize;
+    uint32_t segmentCount;
+    Segment* segments;
+    uint32_t head;          // Segment receiving appends
+    uint32_t nextSequence;
+    uint8_t* scratch;       // One segment, used to assemble and copy records
+    IndexEntry* index;
+    uint32_t indexCapacity; // Power of two
+    uint32_t keyCount;
+    bool batchOpen;
+    uint16_t batch;         // Number of the open batch, 0 until its first record; during mount, the batch being replayed
+    uint16_t lastBatch;     // Last batch number handed out or replayed
+    PendingRecord* pending; // Latest record per key of the open batch, kept out of the index
+    uint32_t pendingCount;
+    uint32_t pendingCapacity;
+    StorageLogStats stats;  // Running counters, space fields filled on request
+};
+
+// ===== Record helpers =====
+
+static uint32_t record_size(uint32_t keyLength, uint32_t valueLength) {
+    uint32_t size = (uint32_t)sizeof(RecordHeader) + keyLength + valueLength;
+    return (size + RECORD_ALIGN - 1) & ~(uint32_t)(RECORD_ALIGN - 1);
+}
+
+static uint32_t record_crc(const RecordHeader* header, const void* key, const void* value) {
+    uint32_t crc = MCP_Crc32Update(0, header, offsetof(RecordHeader, crc));
+    crc = MCP_Crc32Update(crc, key, header->keyLength);
+    return MCP_Crc32Update(crc, value, header->valueLength);
+}
+
+static uint32_t segment_base(const StorageLog* log, uint32_t segment) {
+    return segment * log->segmentSize;
+}
+
+static uint32_t segment_payload(const StorageLog* log) {
+    return log->segmentSize - (uint32_t)sizeof(SegmentHeader);
+}
+
+// ===== Index =====
+
+static uint32_t hash_key(const char* key, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)key[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static IndexEntry* index_find(const StorageLog* log, const char* key, uint32_t hash) {
+    uint32_t mask = log->indexCapacity - 1;
+    for (uint32_t i = hash & mask; log->index[i].key != NULL; i = (i + 1) & mask) {
+        if (log->index[i].hash == hash && strcmp(log->index[i].key, key) == 0) {
+            return &log->index[i];
+        }
+    }
+    return NULL;
+}
+
+static IndexEntry* index_slot(IndexEntry* index, uint32_t capacity, uint32_t hash) {
+    uint32_t mask = capacity - 1;
+    uint32_t i = hash & mask;
+    while (index[i].key != NULL) {
+        i = (i + 1) & mask;
+    }
+    return &index[i];
+}
+
+static int index_grow(StorageLog* log) {
+    uint32_t capacity = log->indexCapacity * 2;
+    IndexEntry* index = (IndexEntry*)calloc(capacity, sizeof(IndexEntry));
+    if (index == NULL) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < log->indexCapacity; i++) {
+        if (log->index[i].key != NULL) {
+            *index_slot(index, capacity, log->index[i].hash) = log->index[i];
+        }
+    }
+
+    free(log->index);
+    log->index = index;
+    log->indexCapacity = capacity;
+    return 0;
+}
+
+static IndexEntry* index_add(StorageLog* log, const char* key, size_t keyLength, uint32_t hash) {
+    // Keep the load factor under 3/4
+    if ((log->keyCount + 1) * 4 > log->indexCapacity * 3 && index_grow(log) != 0) {
+        return NULL;
+    }
+
+    char* copy = (char*)malloc(keyLength + 1);
+    if (copy == NULL) {
+        return NULL;
+    }
+    memcpy(copy, key, keyLength);
+    copy[keyLength] = '\0';
+
+    IndexEntry* entry = index_slot(log->index, log->indexCapacity, hash);
+    entry->key = copy;
+    entry->hash = hash;
+    log->keyCount++;
+    return entry;
+}
+
+static void index_remove(StorageLog* log, IndexEntry* entry) {
+    uint32_t mask = log->indexCapacity - 1;
+    uint32_t hole = (uint32_t)(entry - log->index);
+
+    free(entry->key);
+
+    // Backward-shift deletion keeps probe chains intact without tombstones
+    for (uint32_t i = (hole + 1) & mask; log->index[i].key != NULL; i = (i + 1) & mask) {
+        uint32_t home = log->index[i].hash & mask;
+        bool movable = (hole <= i) ? (home <= hole || home > i) : (home <= hole && home > i);
+        if (movable) {
+            log->index[hole] = log->index[i];
+            hole = i;
+        }
+    }
+
+    log->index[hole].key = NULL;
+    log->keyCount--;
+}
+
+static void index_clear(StorageLog* log) {
+    for (uint32_t i = 0; i < log->indexCapacity; i++) {
+        free(log->index[i].key);
+        log->index[i].key = NULL;
+    }
+    log->keyCount = 0;
+}
+
+// Drop the live bytes of the record an entry points to
+static void release_record(StorageLog* log, const IndexEntry* entry) {
+    uint32_t segment = entry->offset / log->segmentSize;
+    log->segments[segment].live -= record_size((uint32_t)strlen(entry->key), entry->valueLength);
+}
+
+// Point the index at a put or tombstone record that is now committed
+static int apply_record(StorageLog* log, const char* key, size_t keyLength, uint32_t hash, uint8_t type,
+                        uint32_t offset, uint32_t valueLength) {
+    IndexEntry* entry = index_find(log, key, hash);
+    if (entry != NULL) {
+        release_record(log, entry);
+    }
+
+    if (type == RECORD_DELETE) {
+        if (entry != NULL) {
+            index_remove(log, entry);
+        }
+        return 0;
+    }
+
+    if (entry == NULL) {
+        entry = index_add(log, key, keyLength, hash);
+        if (entry == NULL) {
+            return -6; // Record is on the medium but the index is out of memory
+        }
+    }
+    entry->offset = offset;
+    entry->valueLength = valueLength;
+    log->segments[offset / log->segmentSize].live += record_size((uint32_t)keyLength, valueLength);
+    return 0;
+}
+
+// ===== Pending batch records =====
+
+static PendingRecord* pending_find(const StorageLog* log, const char* key, uint32_t hash) {
+    for (uint32_t i = 0; i < log->pendingCount; i++) {
+        if (log->pending[i].hash == hash && strcmp(log->pending[i].key, key) == 0) {
+            return &log->pending[i];
+        }
+    }
+    return NULL;
+}
+
+// Record the latest write or delete of a key in the open batch
+static int pending_set(StorageLog* log, const char* key, size_t keyLength, uint32_t hash, uint8_t type,
+                       uint32_t offset, uint32_t valueLength) {
+    PendingRecord* record = pending_find(log, key, hash);
+    if (record == NULL) {
+        if (log->pendingCount == log->pendingCapacity) {
+            uint32_t capacity = log->pendingCapacity > 0 ? log->pendingCapacity * 2 : INDEX_INITIAL_CAPACITY;
+            PendingRecord* pending = (PendingRecord*)realloc(log->pending, capacity * sizeof(PendingRecord));
+            if (pending == NULL) {
+                return -6;
+            }
+            log->pending = pending;
+            log->pendingCapacity = capacity;
+        }
+
+        char* copy = (char*)malloc(keyLength + 1);
+        if (copy == NULL) {
+            return -6;
+        }
+        memcpy(copy, key, keyLength);
+        copy[keyLength] = '\0';
+
+        record = &log->pending[log->pendingCount++];
+        record->key = copy;
+        record->hash = hash;
+    }
+
+    record->type = type;
+    record->offset = offset;
+    record->valueLength = valueLength;
+    return 0;
+}
+
+static void pending_clear(StorageLog* log) {
+    for (uint32_t i = 0; i < log->pendingCount; i++) {
+        free(log->pending[i].key);
+    }
+    log->pendingCount = 0;
+}
+
+// Apply the records of a batch whose commit record is on the medium, in order
+static int pending_apply(StorageLog* log) {
+    int result = 0;
+    for (uint32_t i = 0; i < log->pendingCount; i++) {
+        const PendingRecord* record = &log->pending[i];
+        int applied = apply_record(log, record->key, strlen(record->key), record->hash, record->type,
+                                   record->offset, record->valueLength);
+        if (applied != 0 && result == 0) {
+            result = applied;
+        }
+    }
+    pending_clear(log);
+    return result;
+}
+
+// ===== Segments =====
+
+static uint32_t count_free_segments(const StorageLog* log) {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < log->segmentCount; i++) {
+        if (log->segments[i].sequence == 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static int oldest_segment(const StorageLog* log) {
+    int oldest = -1;
+    for (uint32_t i = 0; i < log->segmentCount; i++) {
+        uint32_t sequence = log->segments[i].sequence;
+        if (sequence != 0 && (oldest < 0 || sequence < log->segments[oldest].sequence)) {
+            oldest = (int)i;
+        }
+    }
+    return oldest;
+}
+
+static uint32_t dead_bytes(const StorageLog* log, uint32_t segment) {
+    const Segment* s = &log->segments[segment];
+    return s->used - (uint32_t)sizeof(SegmentHeader) - s->live;
+}
+
+static int erase_segment(StorageLog* log, uint32_t segment) {
+    if (log->medium.erase(log->medium.context, segment_base(log, segment), log->segmentSize) != 0) {
+        return -5;
+    }
+
+    memset(&log->segments[segment], 0, sizeof(Segment));
+    log->stats.segmentsErased++;
+    return 0;
+}
+
+static int open_segment(StorageLog* log, uint32_t segment) {
+    int result = erase_segment(log, segment);
+    if (result != 0) {
+        return result;
+    }
+
+    SegmentHeader header;
+    header.magic = SEGMENT_MAGIC;
+    header.sequence = log->nextSequence++;
+    header.crc = MCP_Crc32(&header, offsetof(SegmentHeader, crc));
+
+    if (log->medium.write(log->medium.context, segment_base(log, segment), &header, sizeof(header)) != 0) {
+        return -5;
+    }
+
+    log->segments[segment].sequence = header.sequence;
+    log->segments[segment].used = (uint32_t)sizeof(header);
+    log->stats.mediaBytesWritten += sizeof(header);
+    log->head = segment;
+    return 0;
+}
+
+static int advance_head(StorageLog* log) {
+    for (uint32_t step = 1; step <= log->segmentCount; step++) {
+        uint32_t segment = (log->head + step) % log->segmentCount;
+        if (log->segments[segment].sequence == 0) {
+            return open_segment(log, segment);
+        }
+    }
+    return -4;
+}
+
+static bool head_has_room(const StorageLog* log, uint32_t size) {
+    return log->segments[log->head].used + size <= log->segmentSize;
+}
+
+// Write an assembled record at the head and return its offset
+static int append_record(StorageLog* log, const void* record, uint32_t size, uint32_t* offset) {
+    Segment* head = &log->segments[log->head];
+    uint32_t at = segment_base(log, log->head) + head->used;
+
+    if (log->medium.write(log->medium.context, at, record, size) != 0) {
+        return -5;
+    }
+
+    head->used += size;
+    log->stats.mediaBytesWritten += size;
+    *offset = at;
+    return 0;
+}
+
+/**
+ * @brief Copy the live records of the oldest segment to the head and erase it
+ *
+ * The copies are written before the erase, so a power loss at any point
+ * replays to the same state. Tombstones are dropped: every older record of
+ * their key sits in this segment or has already been erased. Records of the
+ * open batch are copied with their batch number so its commit record still
+ * covers them; copies of committed batch records stand on their own.
+ */
+static int compact_oldest(StorageLog* log) {
+    int oldest = oldest_segment(log);
+    if (oldest < 0) {
+        return -4;
+    }
+
+    uint32_t tail = (uint32_t)oldest;
+    if (tail == log->head) {
+        int result = advance_head(log);
+        if (result != 0) {
+            return result;
+        }
+    }
+
+    uint32_t base = segment_base(log, tail);
+    uint32_t offset = (uint32_t)sizeof(SegmentHeader);
+    uint32_t end = log->segments[tail].used;
+
+    while (offset + sizeof(RecordHeader) <= end) {
+        RecordHeader header;
+        if (log->medium.read(log->medium.context, base + offset, &header, sizeof(header)) != 0) {
+            return -5;
+        }
+
+        uint32_t size = record_size(header.keyLength, header.valueLength);
+        if (offset + size > end) {
+            break;
+        }
+
+        bool inOpenBatch = header.batch != 0 && header.batch == log->batch;
+        if (header.type == RECORD_PUT || (inOpenBatch && header.type == RECORD_DELETE)) {
+            if (log->medium.read(log->medium.context, base + offset, log->scratch, size) != 0) {
+                return -5;
+            }
+
+            char key[STORAGE_LOG_MAX_KEY_LENGTH + 1];
+            memcpy(key, log->scratch + sizeof(RecordHeader), header.keyLength);
+            key[header.keyLength] = '\0';
+            uint32_t hash = hash_key(key, header.keyLength);
+
+            // Find what still points at this record, if anything
+            uint32_t* location = NULL;
+            bool live = false;
+            if (inOpenBatch) {
+                PendingRecord* record = pending_find(log, key, hash);
+                if (record != NULL && record->offset == base + offset) {
+                    location = &record->offset;
+                }
+            } else {
+                IndexEntry* entry = index_find(log, key, hash);
+                if (entry != NULL && entry->offset == base + offset) {
+                    location = &entry->offset;
+                    live = true;
+                    if (header.batch != 0) {
+                        RecordHeader* copy = (RecordHeader*)log->scratch;
+                        copy->batch = 0;
+                        copy->crc = record_crc(copy, log->scratch + sizeof(RecordHeader),
+                                               log->scratch + sizeof(RecordHeader) + header.keyLength);
+                    }
+                }
+            }
+
+            if (location != NULL) {
+                if (!head_has_room(log, size)) {
+                    int result = advance_head(log);
+                    if (result != 0) {
+                        return result;
+                    }
+                }
+
+                uint32_t copied;
+                int result = append_record(log, log->scratch, size, &copied);
+                if (result != 0) {
+                    return result;
+                }
+
+                *location = copied;
+                if (live) {
+                    log->segments[log->head].live += size;
+                }
+                log->stats.recordsCompacted++;
+            }
+        }
+
+        offset += size;
+    }
+
+    return erase_segment(log, tail);
+}
+
+// Make room for a record at the head, compacting when only the reserve is left
+static int reserve_space(StorageLog* log, uint32_t size) {
+    // One free segment always stays in reserve so compaction can make progress
+    for (uint32_t attempt = 0; !head_has_room(log, size) && count_free_segments(log) < 2; attempt++) {
+        uint32_t dead = 0;
+        for (uint32_t i = 0; i < log->segmentCount; i++) {
+            if (log->segments[i].sequence != 0) {
+                dead += dead_bytes(log, i);
+            }
+        }
+
+        if (attempt >= log->segmentCount || dead < size) {
+            return -4; // Store is full of live data
+        }
+
+        int result = compact_oldest(log);
+        if (result != 0) {
+            return result;
+        }
+    }
+
+    return head_has_room(log, size) ? 0 : advance_head(log);
+}
+
+// ===== Mount =====
+
+static void replay_segment(StorageLog* log, uint32_t segment) {
+    uint32_t base = segment_base(log, segment);
+    uint32_t offset = (uint32_t)sizeof(SegmentHeader);
+    bool torn = false;
+
+    while (offset + sizeof(RecordHeader) <= log->segmentSize) {
+        RecordHeader header;
+        if (log->medium.read(log->medium.context, base + offset, &header, sizeof(header)) != 0) {
+            torn = true;
+            break;
+        }
+
+        static const uint8_t erased[sizeof(RecordHeader)] = {
+            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+        };
+        if (memcmp(&header, erased, sizeof(header)) == 0) {
+            break; // Clean end of the segment
+        }
+
+        uint32_t size = record_size(header.keyLength, header.valueLength);
+        bool commit = header.type == RECORD_COMMIT;
+        bool wellFormed = commit ? header.keyLength == 0 && header.valueLength == 0 && header.batch != 0
+                                 : (header.type == RECORD_PUT || header.type == RECORD_DELETE) && header.keyLength > 0;
+        if (!wellFormed || header.valueLength > log->segmentSize || offset + size > log->segmentSize ||
+            log->medium.read(log->medium.context, base + offset, log->scratch, size) != 0) {
+            torn = true;
+            break;
+        }
+
+        const char* key = (const char*)log->scratch + sizeof(RecordHeader);
+        if (record_crc(&header, key, key + header.keyLength) != header.crc) {
+            torn = true;
+            break;
+        }
+
+        char keyCopy[STORAGE_LOG_MAX_KEY_LENGTH + 1];
+        memcpy(keyCopy, key, header.keyLength);
+        keyCopy[header.keyLength] = '\0';
+        uint32_t hash = hash_key(keyCopy, header.keyLength);
+
+        // A batch only counts once its commit record follows; a record of
+        // another batch means the one collected so far was cut short
+        if (header.batch != 0 && header.batch != log->batch) {
+            if (log->pendingCount > 0) {
+                log->stats.batchesDiscarded++;
+            }
+            pending_clear(log);
+            log->batch = header.batch;
+        }
+        if (header.batch != 0) {
+            log->lastBatch = header.batch;
+        }
+
+        if (commit) {
+            pending_apply(log);
+            log->batch = 0;
+        } else if (header.batch != 0) {
+            pending_set(log, keyCopy, header.keyLength, hash, header.type, base + offset, header.valueLength);
+        } else {
+            apply_record(log, keyCopy, header.keyLength, hash, header.type, base + offset, header.valueLength);
+        }
+
+        offset += size;
+        log->stats.recordsRecovered++;
+    }
+
+    // Appends resume at the torn record and overwrite it. Keeping the torn
+    // bytes would strand the space a crash mid-compaction needs to finish.
+    log->segments[segment].used = offset;
+    if (torn) {
+        log->stats.tornRecords++;
+    }
+}
+
+StorageLog* storage_log_mount(const StorageMedium* medium, uint32_t segmentSize) {
+    if (medium == NULL || medium->read == NULL || medium->write == NULL || medium->erase == NULL) {
+        return NULL;
+    }
+
+    if (segmentSize == 0) {
+        segmentSize = STORAGE_LOG_DEFAULT_SEGMENT_SIZE;
+    }
+    if (segmentSize % RECORD_ALIGN != 0 ||
+        segmentSize < sizeof(SegmentHeader) + record_size(STORAGE_LOG_MAX_KEY_LENGTH, 0) ||
+        medium->size / segmentSize < MIN_SEGMENTS) {
+        return NULL;
+    }
+
+    StorageLog* log = (StorageLog*)calloc(1, sizeof(StorageLog));
+    if (log == NULL) {
+        return NULL;
+    }
+
+    log->medium = *medium;
+    log->segmentSize = segmentSize;
+    log->segmentCount = medium->size / segmentSize;
+    log->segments = (Segment*)calloc(log->segmentCount, sizeof(Segment));
+    log->scratch = (uint8_t*)malloc(segmentSize);
+    log->indexCapacity = INDEX_INITIAL_CAPACITY;
+    log->index = (IndexEntry*)calloc(log->indexCapacity, sizeof(IndexEntry));
+    if (log->segments == NULL || log->scratch == NULL || log->index == NULL) {
+        storage_log_unmount(log);
+        return NULL;
+    }
+
+    // Find the segments in use
+    uint32_t* order = (uint32_t*)malloc(log->segmentCount * sizeof(uint32_t));
+    if (order == NULL) {
+        storage_log_unmount(log);
+        return NULL;
+    }
+
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < log->segmentCount; i++) {
+        SegmentHeader header;
+        if (medium->read(medium->context, segment_base(log, i), &header, sizeof(header)) != 0 ||
+            header.magic != SEGMENT_MAGIC || header.sequence == 0 ||
+            header.crc != MCP_Crc32(&header, offsetof(SegmentHeader, crc))) {
+            continue;
+        }
+
+        // Insertion sort by sequence; segment counts are small
+        uint32_t at = used++;
+        while (at > 0 && log->segments[order[at - 1]].sequence > header.sequence) {
+            order[at] = order[at - 1];
+            at--;
+        }
+        order[at] = i;
+        log->segments[i].sequence = header.sequence;
+    }
+
+    // Replay oldest first so later records win
+    for (uint32_t i = 0; i < used; i++) {
+        replay_segment(log, order[i]);
+    }
+
+    // A batch still collecting at the end never reached its commit record
+    if (log->pendingCount > 0) {
+        log->stats.batchesDiscarded++;
+        pending_clear(log);
+    }
+    log->batch = 0;
+
+    int result = 0;
+    if (used == 0) {
+        log->nextSequence = 1;
+        log->head = log->segmentCount - 1;
+        result = advance_head(log);
+    } else {
+        log->head = order[used - 1];
+        log->nextSequence = log->segments[log->head].sequence + 1;
+
+        // No free segment means a compaction was cut short; its copies fit in
+        // the head, so finish it to restore the reserve. If that fails the
+        // store still mounts and writes report it as full.
+        if (used == log->segmentCount) {
+            compact_oldest(log);
+        }
+    }
+    free(order);
+
+    if (result != 0) {
+        storage_log_unmount(log);
+        return NULL;
+    }
+
+    return log;
+}
+
+void storage_log_unmount(StorageLog* log) {
+    if (log == NULL) {
+        return;
+    }
+
+    if (log->index != NULL) {
+        index_clear(log);
+        free(log->index);
+    }
+    pending_clear(log);
+    free(log->pending);
+    free(log->segments);
+    free(log->scratch);
+    free(log);
+}
+
+// ===== Key-value operations =====
+
+static int append_key_record(StorageLog* log, uint8_t type, const char* key, size_t keyLength,
+                             const void* data, size_t size, uint32_t* offset) {
+    // Records of a batch carry its number, handed out with the first one
+    if (log->batchOpen && log->batch == 0) {
+        log->lastBatch = log->lastBatch == 0xFFFF ? 1 : (uint16_t)(log->lastBatch + 1);
+        log->batch = log->lastBatch;
+    }
+
+    uint32_t recordSize = record_size((uint32_t)keyLength, (uint32_t)size);
+    if (recordSize > segment_payload(log)) {
+        return -3;
+    }
+
+    int result = reserve_space(log, recordSize);
+    if (result != 0) {
+        return result;
+    }
+
+    // Assemble after reserving: compaction uses the scratch buffer too
+    RecordHeader header;
+    header.type = type;
+    header.keyLength = (uint8_t)keyLength;
+    header.batch = log->batch;
+    header.valueLength = (uint32_t)size;
+    header.crc = record_crc(&header, key, data);
+
+    memcpy(log->scratch, &header, sizeof(header));
+    memcpy(log->scratch + sizeof(header), key, keyLength);
+    if (size > 0) {
+        memcpy(log->scratch + sizeof(header) + keyLength, data, size);
+    }
+    memset(log->scratch + sizeof(header) + keyLength + size, 0,
+           recordSize - sizeof(header) - keyLength - size);
+
+    result = append_record(log, log->scratch, recordSize, offset);
+    if (result == 0) {
+        log->stats.userBytesWritten += keyLength + size;
+    }
+    return result;
+}
+
+int storage_log_write(StorageLog* log, const char* key, const void* data, size_t size) {
+    if (log == NULL || key == NULL || (data == NULL && size > 0)) {
+        return -1;
+    }
+
+    size_t keyLength = strlen(key);
+    if (keyLength == 0 || keyLength > STORAGE_LOG_MAX_KEY_LENGTH) {
+        return -1;
+    }
+
+    uint32_t offset;
+    int result = append_key_record(log, RECORD_PUT, key, keyLength, data, size, &offset);
+    if (result != 0) {
+        return result;
+    }
+
+    // Look up after the append: compaction may have moved the old record
+    uint32_t hash = hash_key(key, keyLength);
+    if (log->batchOpen) {
+        return pending_set(log, key, keyLength, hash, RECORD_PUT, offset, (uint32_t)size);
+    }
+    return apply_record(log, key, keyLength, hash, RECORD_PUT, offset, (uint32_t)size);
+}
+
+int storage_log_read(StorageLog* log, const char* key, void* data, size_t maxSize, size_t* actualSize) {
+    if (log == NULL || key == NULL || data == NULL) {
+        return -1;
+    }
+
+    size_t keyLength = strlen(key);
+    IndexEntry* entry = index_find(log, key, hash_key(key, keyLength));
+    if (entry == NULL) {
+        return -2;
+    }
+
+    size_t size = entry->valueLength <= maxSize ? entry->valueLength : maxSize;
+    uint32_t at = entry->offset + (uint32_t)sizeof(RecordHeader) + (uint32_t)keyLength;
+    if (log->medium.read(log->medium.context, at, data, size) != 0) {
+        return -5;
+    }
+
+    if (actualSize != NULL) {
+        *actualSize = size;
+    }
+    return 0;
+}
+
+bool storage_log_exists(StorageLog* log, const char* key) {
+    if (log == NULL || key == NULL) {
+        return false;
+    }
+    return index_find(log, key, hash_key(key, strlen(key))) != NULL;
+}
+
+int storage_log_delete(StorageLog* log, const char* key) {
+    if (log == NULL || key == NULL) {
+        return -1;
+    }
+
+    // Inside a batch the key may have been written or deleted by it already
+    size_t keyLength = strlen(key);
+    uint32_t hash = hash_key(key, keyLength);
+    PendingRecord* record = log->batchOpen ? pending_find(log, key, hash) : NULL;
+    bool exists = record != NULL ? record->type == RECORD_PUT : index_find(log, key, hash) != NULL;
+    if (!exists) {
+        return -2;
+    }
+
+    uint32_t offset;
+    int result = append_key_record(log, RECORD_DELETE, key, keyLength, NULL, 0, &offset);
+    if (result != 0) {
+        return result;
+    }
+
+    if (log->batchOpen) {
+        return pending_set(log, key, keyLength, hash, RECORD_DELETE, offset, 0);
+    }
+    return apply_record(log, key, keyLength, hash, RECORD_DELETE, offset, 0);
+}
+
+int storage_log_get_size(StorageLog* log, const char* key) {
+    if (log == NULL || key == NULL) {
+        return -1;
+    }
+
+    IndexEntry* entry = index_find(log, key, hash_key(key, strlen(key)));
+    return entry != NULL ? (int)entry->valueLength : -2;
+}
+
+int storage_log_get_keys(StorageLog* log, const char* prefix, char** keys, size_t maxKeys) {
+    if (log == NULL || keys == NULL) {
+        return -1;
+    }
+
+    size_t prefixLength = prefix != NULL ? strlen(prefix) : 0;
+    size_t count = 0;
+    for (uint32_t i = 0; i < log->indexCapacity && count < maxKeys; i++) {
+        if (log->index[i].key != NULL && strncmp(log->index[i].key, prefix != NULL ? prefix : "", prefixLength) == 0) {
+            keys[count] = strdup(log->index[i].key);
+            if (keys[count] != NULL) {
+                count++;
+            }
+        }
+    }
+
+    return (int)count;
+}
+
+// ===== Batches =====
+
+int storage_log_begin_batch(StorageLog* log) {
+    if (log == NULL) {
+        return -1;
+    }
+    if (log->batchOpen) {
+        return -2;
+    }
+
+    log->batchOpen = true;
+    log->batch = 0;
+    return 0;
+}
+
+int storage_log_end_batch(StorageLog* log) {
+    if (log == NULL) {
+        return -1;
+    }
+    if (!log->batchOpen) {
+        return -2;
+    }
+
+    // The commit record is what makes the batch count on replay
+    int result = 0;
+    if (log->pendingCount > 0) {
+        uint32_t offset;
+        result = append_key_record(log, RECORD_COMMIT, "", 0, NULL, 0, &offset);
+        if (result == 0) {
+            result = pending_apply(log);
+        }
+    }
+
+    pending_clear(log);
+    log->batchOpen = false;
+    log->batch = 0;
+    return result;
+}
+
+int storage_log_abort_batch(StorageLog* log) {
+    if (log == NULL) {
+        return -1;
+    }
+    if (!log->batchOpen) {
+        return -2;
+    }
+
+    // Without a commit record the appended records are dead on replay too
+    pending_clear(log);
+    log->batchOpen = false;
+    log->batch = 0;
+    return 0;
+}
+
+// ===== Maintenance =====
+
+int storage_log_compact(StorageLog* log, uint32_t maxSegments) {
+    if (log == NULL) {
+        return -1;
+    }
+
+    uint32_t reclaimed = 0;
+    while (reclaimed < maxSegments) {
+        int oldest = oldest_segment(log);
+        if (oldest < 0 || (uint32_t)oldest == log->head) {
+            break;
+        }
+
+        uint32_t payload = log->segments[oldest].used - (uint32_t)sizeof(SegmentHeader);
+        uint32_t dead = dead_bytes(log, (uint32_t)oldest);
+        bool mostlyDead = dead * 2 >= payload;
+        bool lowOnSpace = count_free_segments(log) * 4 < log->segmentCount;
+        if (dead == 0 || (!mostlyDead && !lowOnSpace)) {
+            break;
+        }
+
+        int result = compact_oldest(log);
+        if (result != 0) {
+            return result;
+        }
+        reclaimed++;
+    }
+
+    return (int)reclaimed;
+}
+
+int storage_log_clear(StorageLog* log) {
+    if (log == NULL) {
+        return -1;
+    }
+
+    index_clear(log);
+    pending_clear(log);
+    log->batch = 0;
+    for (uint32_t i = 0; i < log->segmentCount; i++) {
+        if (log->segments[i].sequence != 0 || log->segments[i].used != 0) {
+            int result = erase_segment(log, i);
+            if (result != 0) {
+                return result;
+            }
+        }
+    }
+
+    log->head = log->segmentCount - 1;
+    return advance_head(log);
+}
+
+int storage_log_sync(StorageLog* log) {
+    if (log == NULL) {
+        return -1;
+    }
+    return log->medium.sync != NULL ? log->medium.sync(log->medium.context) : 0;
+}
+
+int storage_log_get_free_space(StorageLog* log) {
+    if (log == NULL) {
+        return -1;
+    }
+
+    StorageLogStats stats;
+    storage_log_get_stats(log, &stats);
+
+    uint32_t spare = stats.freeSegments > 0 ? stats.freeSegments - 1 : 0;
+    uint32_t headRoom = log->segmentSize - log->segments[log->head].used;
+    return (int)(spare * segment_payload(log) + stats.deadBytes + headRoom);
+}
+
+void storage_log_get_stats(const StorageLog* log, StorageLogStats* stats) {
+    if (log == NULL || stats == NULL) {
+        return;
+    }
+
+    *stats = log->stats;
+    stats->keyCount = log->keyCount;
+    stats->liveBytes = 0;
+    stats->deadBytes = 0;
+    stats->segmentCount = log->segmentCount;
+    stats->freeSegments = 0;
+
+    for (uint32_t i = 0; i < log->segmentCount; i++) {
+        if (log->segments[i].sequence == 0) {
+            stats->freeSegments++;
+        } else {
+            stats->liveBytes += log->segments[i].live;
+            stats->deadBytes += dead_bytes(log, i);
+        }
+    }
+}
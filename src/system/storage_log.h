@@ -0,0 +1,210 @@
+/**
+ * @file storage_log.h
+ * @brief Log-structured key-value store
+ *
+ * The medium is divided into fixed-size segments. Writes and deletes append
+ * CRC-protected records to the head segment; an in-RAM hash index maps each key
+ * to its latest record and is rebuilt by replaying the segments on mount. A
+ * torn record ends the replay of its segment, so a power loss loses at most the
+ * write in progress. Compaction copies the live records of the oldest segment
+ * to the head and erases it.
+ *
+ * Writes and deletes made between storage_log_begin_batch() and
+ * storage_log_end_batch() are atomic as a group: their records carry a batch
+ * number and only count on replay once the batch's commit record follows
+ * them, so mount drops a batch a power loss cut short.
+ *
+ * Appends after a torn record overwrite it, so the medium must allow bytes
+ * left by an interrupted write to be programmed again (EEPROM, files, RAM).
+ * Raw NOR/NAND flash needs a translation layer underneath.
+ */
+#ifndef STORAGE_LOG_H
+#define STORAGE_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "storage_medium.h"
+
+#define STORAGE_LOG_DEFAULT_SEGMENT_SIZE 4096
+#define STORAGE_LOG_MAX_KEY_LENGTH 255
+
+typedef struct StorageLog StorageLog;
+
+/**
+ * @brief Log store counters
+ */
+typedef struct {
+    uint32_t keyCount;            // Live keys
+    uint32_t liveBytes;           // Bytes held by live records
+    uint32_t deadBytes;           // Bytes held by overwritten records and tombstones
+    uint32_t segmentCount;
+    uint32_t freeSegments;
+    uint64_t userBytesWritten;    // Key and value bytes passed to write/delete
+    uint64_t mediaBytesWritten;   // Bytes programmed on the medium, compaction included
+    uint32_t segmentsErased;
+    uint32_t recordsCompacted;    // Live records copied by compaction
+    uint32_t recordsRecovered;    // Records replayed by the last mount
+    uint32_t tornRecords;         // Torn or corrupt records found by the last mount
+    uint32_t batchesDiscarded;    // Batches without a commit record dropped by the last mount
+} StorageLogStats;
+
+/**
+ * @brief Mount a log store, replaying the records on the medium
+ *
+ * Segments without a valid header are treated as free, so a blank medium
+ * mounts as an empty store.
+ *
+ * @param medium Medium holding the log (copied)
+ * @param segmentSize Segment size in bytes, or 0 for the default
+ * @return StorageLog* Mounted store or NULL on failure
+ */
+StorageLog* storage_log_mount(const StorageMedium* medium, uint32_t segmentSize);
+
+/**
+ * @brief Release a mounted store (the medium is left as is)
+ *
+ * @param log Store to release
+ */
+void storage_log_unmount(StorageLog* log);
+
+/**
+ * @brief Append a value for a key
+ *
+ * @param log Store
+ * @param key Key (at most STORAGE_LOG_MAX_KEY_LENGTH bytes)
+ * @param data Value
+ * @param size Size of value, which must fit in one segment with its key
+ * @return int 0 on success, -3 if the record is too large, -4 if the store is full
+ */
+int storage_log_write(StorageLog* log, const char* key, const void* data, size_t size);
+
+/**
+ * @brief Read the value of a key
+ *
+ * @param log Store
+ * @param key Key
+ * @param data Output buffer
+ * @param maxSize Size of data; longer values are truncated
+ * @param actualSize Number of bytes copied
+ * @return int 0 on success, -2 if the key is not found
+ */
+int storage_log_read(StorageLog* log, const char* key, void* data, size_t maxSize, size_t* actualSize);
+
+/**
+ * @brief Check whether a key exists
+ *
+ * @param log Store
+ * @param key Key
+ * @return bool True if the key exists
+ */
+bool storage_log_exists(StorageLog* log, const char* key);
+
+/**
+ * @brief Append a tombstone for a key
+ *
+ * @param log Store
+ * @param key Key
+ * @return int 0 on success, -2 if the key is not found
+ */
+int storage_log_delete(StorageLog* log, const char* key);
+
+/**
+ * @brief Get the value size of a key
+ *
+ * @param log Store
+ * @param key Key
+ * @return int Size in bytes, or -2 if the key is not found
+ */
+int storage_log_get_size(StorageLog* log, const char* key);
+
+/**
+ * @brief Copy out the live keys
+ *
+ * @param log Store
+ * @param prefix Only return keys starting with this, or NULL for all keys
+ * @param keys Output array; each key is allocated with strdup
+ * @param maxKeys Size of keys
+ * @return int Number of keys written or negative error code
+ */
+int storage_log_get_keys(StorageLog* log, const char* prefix, char** keys, size_t maxKeys);
+
+/**
+ * @brief Start a batch of writes and deletes that commit together
+ *
+ * Until the batch ends, reads, key listings and existence checks see the
+ * store without its changes. Deleting a key the batch wrote is allowed.
+ *
+ * @param log Store
+ * @return int 0 on success, -2 if a batch is already open
+ */
+int storage_log_begin_batch(StorageLog* log);
+
+/**
+ * @brief Append the commit record of the open batch and apply its changes
+ *
+ * The batch is closed whether or not this succeeds; on failure its records
+ * stay uncommitted and are dropped on the next mount.
+ *
+ * @param log Store
+ * @return int 0 on success, -2 if no batch is open, or the append error
+ */
+int storage_log_end_batch(StorageLog* log);
+
+/**
+ * @brief Drop the open batch; its records never count
+ *
+ * @param log Store
+ * @return int 0 on success, -2 if no batch is open
+ */
+int storage_log_abort_batch(StorageLog* log);
+
+/**
+ * @brief Reclaim space in the background
+ *
+ * Compacts the oldest segment while at least half of it is dead or fewer than
+ * a quarter of the segments are free. Writes compact on their own when the
+ * store runs out of free segments; calling this from an idle task keeps that
+ * work off the write path.
+ *
+ * @param log Store
+ * @param maxSegments Maximum number of segments to compact
+ * @return int Number of segments reclaimed or negative error code
+ */
+int storage_log_compact(StorageLog* log, uint32_t maxSegments);
+
+/**
+ * @brief Erase the medium and drop all keys
+ *
+ * @param log Store
+ * @return int 0 on success, negative error code on failure
+ */
+int storage_log_clear(StorageLog* log);
+
+/**
+ * @brief Flush the medium
+ *
+ * @param log Store
+ * @return int 0 on success, negative error code on failure
+ */
+int storage_log_sync(StorageLog* log);
+
+/**
+ * @brief Get the bytes still available for new records
+ *
+ * Counts free segments (less the one reserved for compaction) and dead bytes.
+ *
+ * @param log Store
+ * @return int Free space in bytes or negative error code
+ */
+int storage_log_get_free_space(StorageLog* log);
+
+/**
+ * @brief Get store counters
+ *
+ * @param log Store
+ * @param stats Output counters
+ */
+void storage_log_get_stats(const StorageLog* log, StorageLogStats* stats);
+
+#endif /* STORAGE_LOG_H */
@@ -0,0 +1,35 @@
+/**
+ * @file storage_medium.c
+ * @brief RAM-backed storage medium
+ */
+#include "storage_medium.h"
+#include <string.h>
+
+static int memory_read(void* context, uint32_t offset, void* data, size_t size) {
+    memcpy(data, (uint8_t*)context + offset, size);
+    return 0;
+}
+
+static int memory_write(void* context, uint32_t offset, const void* data, size_t size) {
+    memcpy((uint8_t*)context + offset, data, size);
+    return 0;
+}
+
+static int memory_erase(void* context, uint32_t offset, uint32_t size) {
+    memset((uint8_t*)context + offset, 0xFF, size);
+    return 0;
+}
+
+int storage_medium_init_memory(StorageMedium* medium, uint8_t* buffer, uint32_t size) {
+    if (medium == NULL || buffer == NULL || size == 0) {
+        return -1;
+    }
+
+    medium->read = memory_read;
+    medium->write = memory_write;
+    medium->erase = memory_erase;
+    medium->sync = NULL;
+    medium->context = buffer;
+    medium->size = size;
+    return 0;
+}
@@ -0,0 +1,37 @@
+/**
+ * @file storage_medium.h
+ * @brief Byte-addressable storage medium used by the storage layouts
+ */
+#ifndef STORAGE_MEDIUM_H
+#define STORAGE_MEDIUM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Storage medium operations
+ *
+ * Offsets are relative to the start of the medium and are bounds-checked by
+ * the caller. Erased bytes read back as 0xFF.
+ */
+typedef struct {
+    int (*read)(void* context, uint32_t offset, void* data, size_t size);
+    int (*write)(void* context, uint32_t offset, const void* data, size_t size);
+    int (*erase)(void* context, uint32_t offset, uint32_t size);
+    int (*sync)(void* context);    // Optional, NULL when writes are durable on return
+    void* context;
+    uint32_t size;                 // Medium size in bytes
+} StorageMedium;
+
+/**
+ * @brief Set up a medium over a RAM buffer
+ *
+ * @param medium Medium to initialize
+ * @param buffer Backing buffer (owned by the caller)
+ * @param size Size of buffer
+ * @return int 0 on success, negative error code on failure
+ */
+int storage_medium_init_memory(StorageMedium* medium, uint8_t* buffer, uint32_t size);
+
+#endif /* STORAGE_MEDIUM_H */
@@ -0,0 +1,38 @@
+/**
+ * @file crc32.h
+ * @brief CRC-32 (IEEE 802.3) checksum for stored and transferred data
+ */
+#ifndef MCP_CRC32_H
+#define MCP_CRC32_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Extend a CRC-32 over more data
+ * 
+ * @param crc Result of the previous call, or 0 to start
+ * @param data Data to checksum
+ * @param length Length of data
+ * @return uint32_t Updated CRC-32
+ */
+uint32_t MCP_Crc32Update(uint32_t crc, const void* data, size_t length);
+
+/**
+ * @brief Compute the CRC-32 of a buffer
+ * 
+ * @param data Data to checksum
+ * @param length Length of data
+ * @return uint32_t CRC-32
+ */
+uint32_t MCP_Crc32(const void* data, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MCP_CRC32_H */
@@ -0,0 +1,26 @@
+#!/bin/bash
+# Build script for automation engine tests and benchmarks
+
+set -e  # Exit on error
+
+# Print command being executed
+set -x
+
+# Create build directory
+mkdir -p build
+
+# Compile the test
+gcc -O2 -o build/test_automation_engine \
+   -I. \
+   -Isrc/core/tool_system \
+   -Isrc/util \
+   tests/test_automation_engine.c \
+   src/core/tool_system/automation_engine.c \
+   src/core/tool_system/rule_interpreter.c \
+   src/core/mcp/content.c \
+   src/json/json_helpers.c \
+   src/util/crc32.c \
+   -lm
+
+# Run the test
+./build/test_automation_engine
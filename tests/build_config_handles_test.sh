@@ -0,0 +1,20 @@
+#!/bin/bash
+# Build script for hashed configuration entries, handles and change hooks
+
+set -e  # Exit on error
+
+# Print command being executed
+set -x
+
+# Create build directory
+mkdir -p build
+
+# Compile the test
+gcc -O2 -o build/test_config_handles \
+   -I. \
+   tests/test_config_handles.c \
+   src/core/kernel/config_system.c \
+   src/util/crc32.c
+
+# Run the test
+./build/test_config_handles
@@ -16,6 +16,7 @@ gcc -o build/test_config_json \
    tests/test_config_json.c \
    tests/logging_stub.c \
    src/core/mcp/config/mcp_config.c \
+   src/core/mcp/config/config_fields.c \
    src/core/mcp/config/platform_config.c \
    src/json/json_helpers.c
 
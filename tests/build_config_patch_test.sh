@@ -0,0 +1,22 @@
+#!/bin/bash
+# Build script for configuration merge patch and cached serialization tests
+
+set -e  # Exit on error
+
+# Print command being executed
+set -x
+
+# Create build directory
+mkdir -p build
+
+# Compile the test
+gcc -O2 -o build/test_config_patch \
+   -DMCP_PLATFORM_RPI \
+   -I. \
+   tests/test_config_patch.c \
+   tests/logging_stub.c \
+   src/core/mcp/config/mcp_config.c \
+   src/core/mcp/config/config_fields.c
+
+# Run the test
+./build/test_config_patch
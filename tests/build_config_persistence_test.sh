@@ -0,0 +1,30 @@
+#!/bin/bash
+# Build script for config blob persistence tests and benchmarks
+
+set -e  # Exit on error
+
+# Print command being executed
+set -x
+
+# Create build directory
+mkdir -p build
+
+# Compile the test
+gcc -O2 -o build/test_config_persistence \
+   -DMCP_OS_HOST=1 \
+   -I. \
+   -Isrc/system \
+   tests/test_config_persistence.c \
+   src/core/kernel/config_system.c \
+   src/system/persistent_storage.c \
+   src/system/storage_cache.c \
+   src/system/storage_codec.c \
+   src/system/storage_directory.c \
+   src/system/storage_ftl.c \
+   src/system/storage_host.c \
+   src/system/storage_log.c \
+   src/system/storage_medium.c \
+   src/util/crc32.c
+
+# Run the test
+./build/test_config_persistence
@@ -0,0 +1,20 @@
+#!/bin/bash
+# Build script for log level gating tests and benchmarks
+
+set -e  # Exit on error
+
+# Print command being executed
+set -x
+
+# Create build directory
+mkdir -p build
+
+# Compile the test
+gcc -O2 -o build/test_log_gating \
+   -I. \
+   -Isrc/system \
+   tests/test_log_gating.c \
+   src/system/logging.c
+
+# Run the test
+./build/test_log_gating
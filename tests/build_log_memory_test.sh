@@ -0,0 +1,20 @@
+#!/bin/bash
+# Build script for the in-memory log store tests and benchmarks
+
+set -e  # Exit on error
+
+# Print command being executed
+set -x
+
+# Create build directory
+mkdir -p build
+
+# Compile the test
+gcc -O2 -o build/test_log_memory \
+   -I. \
+   -Isrc/system \
+   tests/test_log_memory.c \
+   src/system/logging.c
+
+# Run the test
+./build/test_log_memory
@@ -0,0 +1,21 @@
+#!/bin/bash
+# Build script for asynchronous logging tests and benchmarks
+
+set -e  # Exit on error
+
+# Print command being executed
+set -x
+
+# Create build directory
+mkdir -p build
+
+# Compile the test
+gcc -O2 -o build/test_logging_async \
+   -I. \
+   -Isrc/system \
+   tests/test_logging_async.c \
+   src/system/logging.c \
+   -lpthread
+
+# Run the test
+./build/test_logging_async
@@ -0,0 +1,23 @@
+#!/bin/bash
+# Build script for the MCP logging bridge tests and benchmarks
+
+set -e  # Exit on error
+
+# Print command being executed
+set -x
+
+# Create build directory
+mkdir -p build
+
+# Compile the test
+gcc -O2 -o build/test_mcp_logging \
+   -DMCP_PLATFORM_HOST \
+   -I. \
+   tests/test_mcp_logging.c \
+   src/core/mcp/logging/mcp_logging.c \
+   src/core/mcp/content.c \
+   src/core/mcp/content_api_helpers.c \
+   src/system/logging.c
+
+# Run the test
+./build/test_mcp_logging
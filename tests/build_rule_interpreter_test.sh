@@ -0,0 +1,21 @@
+#!/bin/bash
+# Build script for rule interpreter tests and benchmarks
+
+set -e  # Exit on error
+
+# Print command being executed
+set -x
+
+# Create build directory
+mkdir -p build
+
+# Compile the test
+gcc -O2 -o build/test_rule_interpreter \
+   -I. \
+   tests/test_rule_interpreter.c \
+   src/core/tool_system/rule_interpreter.c \
+   -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=strdup \
+   -lm
+
+# Run the test
+./build/test_rule_interpreter
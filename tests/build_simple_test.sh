@@ -15,6 +15,7 @@ gcc -o build/test_config_simple \
    -I. \
    tests/test_config_simple.c \
    src/core/mcp/config/mcp_config.c \
+   src/core/mcp/config/config_fields.c \
    src/core/mcp/config/platform_config.c \
    src/json/json_helpers.c
 
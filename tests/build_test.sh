@@ -16,6 +16,7 @@ gcc -o build/config_test \
    tests/config_test.c \
    tests/logging_stub.c \
    src/core/mcp/config/mcp_config.c \
+   src/core/mcp/config/config_fields.c \
    src/core/mcp/config/platform_config.c \
    src/json/json_helpers.c
 
@@ -48,6 +48,18 @@ void log_message(LogLevel level, const char* module, const char* format, ...) {
     va_end(args);
 }
 
+void log_module_message(const LogModule* module, LogLevel level, const char* format, ...) {
+    char message[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    log_message(level, module != NULL ? module->name : NULL, "%s", message);
+}
+
+// All zero, so the log macros always call the stubs
+uint8_t log_skip_levels[LOG_MAX_MODULES];
+
 // Simple aliases for log_message
 void log_error(const char* format, ...) {
     va_list args;
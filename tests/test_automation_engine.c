@@ -0,0 +1,971 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <math.h>
+
+#include "../src/core/tool_system/automation_engine.h"
+#include "../src/core/tool_system/rule_interpreter.h"
+#include "../src/core/tool_system/tool_registry.h"
+#include "../src/core/tool_system/tool_info.h"
+#include "../src/core/mcp/content.h"
+#include "../src/core/mcp/server_defs.h"
+
+// Benchmark update count per configuration
+#define BENCH_UPDATES 20000
+
+// Scheduled rules in the schedule benchmark
+#define BENCH_SCHEDULED_RULES 1000
+
+// Rules in the cold start benchmark
+#define BENCH_COLD_START_RULES 500
+
+// ===== Stubs for the engine's dependencies =====
+
+static int s_actuatorCalls = 0;
+static char s_lastTarget[64];
+static char s_lastCommand[64];
+static char s_lastParams[64];
+static int s_targetFires[BENCH_SCHEDULED_RULES];
+static char s_callLog[256];
+static uint32_t s_fakeClockUs = 0;
+static int s_driverSpin = 0;
+
+int MCP_ActuatorSendCommand(const char* id, const char* command, const char* params) {
+    s_actuatorCalls++;
+
+    // Simulated driver cost
+    s_fakeClockUs += 100;
+    for (volatile int spin = 0; spin < s_driverSpin; spin++) {
+    }
+
+    if (strlen(s_callLog) + strlen(command) + 2 < sizeof(s_callLog)) {
+        strcat(s_callLog, command);
+        strcat(s_callLog, " ");
+    }
+    if (id[0] == 't' && id[1] == '_') {
+        s_targetFires[atoi(id + 2)]++;
+    }
+    snprintf(s_lastTarget, sizeof(s_lastTarget), "%s", id);
+    snprintf(s_lastCommand, sizeof(s_lastCommand), "%s", command);
+    snprintf(s_lastParams, sizeof(s_lastParams), "%s", params != NULL ? params : "");
+    return 0;
+}
+
+MCP_ToolResult MCP_ToolExecute(const char* json, size_t length) {
+    MCP_ToolResult result;
+    (void)json;
+    (void)length;
+    memset(&result, 0, sizeof(result));
+    return result;
+}
+
+// Tool registry and transport stand-ins: keep the registered tool and the last result sent
+static MCP_ToolInfo s_registeredTool;
+static char s_sentResult[512];
+static bool s_sentSuccess = false;
+
+int MCP_ToolRegister(const void* info) {
+    memcpy(&s_registeredTool, info, sizeof(s_registeredTool));
+    return 0;
+}
+
+struct MCP_Server* MCP_GetServer(void) {
+    static struct MCP_Server server;
+    return &server;
+}
+
+int MCP_SendToolResult(struct MCP_ServerTransport* transport, const char* sessionId,
+                       const char* operationId, bool success, const struct MCP_Content* result) {
+    (void)transport;
+    (void)sessionId;
+    (void)operationId;
+    snprintf(s_sentResult, sizeof(s_sentResult), "%.*s", (int)result->size, (const char*)result->data);
+    s_sentSuccess = success;
+    return 0;
+}
+
+uint32_t MCP_EventRegisterHandler(int type, const char* source, MCP_EventHandler handler, void* userData) {
+    (void)type;
+    (void)source;
+    (void)handler;
+    (void)userData;
+    return 0;  // Event system not running; events are fed directly
+}
+
+int persistent_storage_write(const char* key, const void* data, size_t size) {
+    (void)key;
+    (void)data;
+    (void)size;
+    return 0;
+}
+
+int persistent_storage_read(const char* key, void* data, size_t maxSize, size_t* actualSize) {
+    (void)key;
+    (void)data;
+    (void)maxSize;
+    (void)actualSize;
+    return -1;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t fake_clock_us(void) {
+    return s_fakeClockUs;
+}
+
+// Deterministic profile clock: every reading advances 10 ticks (1 us)
+static uint32_t s_fakeTicks = 0;
+
+static uint32_t fake_ticks(void) {
+    s_fakeTicks += 10;
+    return s_fakeTicks;
+}
+
+static uint32_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+
+static void set_number(const char* name, double value) {
+    MCP_RuleUpdateVariables(&(MCP_RuleVariableUpdate){ name, MCP_RuleCreateNumberValue(value) }, 1);
+}
+
+// Test condition triggers fire once per rising edge
+static void test_condition_triggers() {
+    printf("Testing condition triggers...\n");
+
+    set_number("temperature", 20);
+    set_number("humidity", 70);
+
+    const char* id = MCP_AutomationCreateRule(
+        "{\"rule\":{\"id\":\"fan_on\",\"name\":\"Fan on\","
+        "\"triggers\":[{\"type\":\"condition\",\"expression\":\"temperature > 30 && humidity < 60\"}],"
+        "\"actions\":[{\"type\":\"actuator\",\"target\":\"fan\",\"command\":\"on\"}]}}", 1);
+    assert(id != NULL && strcmp(id, "fan_on") == 0);
+
+    MCP_AutomationProcess(0);
+    assert(s_actuatorCalls == 0);
+
+    // Only one conjunct satisfied
+    set_number("temperature", 35);
+    MCP_AutomationProcess(10);
+    assert(s_actuatorCalls == 0);
+    assert(!MCP_AutomationCheckTriggers("fan_on"));
+
+    // Second conjunct completes the match
+    set_number("humidity", 50);
+    MCP_AutomationProcess(20);
+    assert(s_actuatorCalls == 1);
+    assert(strcmp(s_lastTarget, "fan") == 0 && strcmp(s_lastCommand, "on") == 0);
+    assert(MCP_AutomationCheckTriggers("fan_on"));
+
+    // Updates that keep the condition true do not refire
+    set_number("humidity", 45);
+    set_number("temperature", 36);
+    MCP_AutomationProcess(30);
+    assert(s_actuatorCalls == 1);
+
+    // Falling then rising edge fires again
+    set_number("temperature", 25);
+    MCP_AutomationProcess(40);
+    set_number("temperature", 33);
+    MCP_AutomationProcess(50);
+    assert(s_actuatorCalls == 2);
+
+    // Disabled rules keep tracking state but do not run
+    MCP_AutomationSetRuleEnabled("fan_on", false);
+    set_number("temperature", 25);
+    MCP_AutomationProcess(60);
+    set_number("temperature", 33);
+    MCP_AutomationProcess(70);
+    assert(s_actuatorCalls == 2);
+
+    assert(MCP_AutomationDeleteRule("fan_on") == 0);
+    assert(MCP_AutomationDeleteRule("fan_on") == -2);
+
+    printf("Condition trigger tests passed!\n");
+}
+
+// Test rules sharing a sub-expression and the structured condition form
+static void test_shared_conditions() {
+    printf("Testing shared conditions...\n");
+
+    s_actuatorCalls = 0;
+    set_number("mode", 0);
+    set_number("level", 0);
+
+    assert(MCP_AutomationCreateRule(
+        "{\"id\":\"a\",\"triggers\":[{\"type\":\"condition\",\"expression\":\"mode == 1 && level > 10\"}],"
+        "\"actions\":[{\"type\":\"actuator\",\"target\":\"a\",\"command\":\"x\"}]}", 1) != NULL);
+    assert(MCP_AutomationCreateRule(
+        "{\"id\":\"b\",\"triggers\":[{\"type\":\"condition\",\"expression\":\"mode==1&&level>20\"}],"
+        "\"actions\":[{\"type\":\"actuator\",\"target\":\"b\",\"command\":\"x\"}]}", 1) != NULL);
+    assert(MCP_AutomationCreateRule(
+        "{\"id\":\"c\",\"triggers\":[{\"type\":\"condition\",\"sensor\":\"level\",\"operator\":\">=\",\"value\":15}],"
+        "\"actions\":[{\"type\":\"actuator\",\"target\":\"c\",\"command\":\"x\"}]}", 1) != NULL);
+
+    MCP_AutomationProcess(0);
+    set_number("level", 15);
+    MCP_AutomationProcess(10);
+    assert(s_actuatorCalls == 1);  // c only
+
+    set_number("mode", 1);
+    MCP_AutomationProcess(20);
+    assert(s_actuatorCalls == 2);  // a joins
+
+    // Deleting one user of the shared node keeps the other working
+    assert(MCP_AutomationDeleteRule("a") == 0);
+    set_number("level", 25);
+    MCP_AutomationProcess(30);
+    assert(s_actuatorCalls == 3);  // b fires
+    assert(strcmp(s_lastTarget, "b") == 0);
+
+    // A rule added while its condition already holds fires once
+    assert(MCP_AutomationCreateRule(
+        "{\"id\":\"d\",\"triggers\":[{\"type\":\"condition\",\"expression\":\"mode == 1\"}],"
+        "\"actions\":[{\"type\":\"actuator\",\"target\":\"d\",\"command\":\"x\"}]}", 1) != NULL);
+    MCP_AutomationProcess(40);
+    assert(s_actuatorCalls == 4);
+
+    // Invalid expressions are rejected
+    assert(MCP_AutomationCreateRule(
+        "{\"id\":\"bad\",\"triggers\":[{\"type\":\"condition\",\"expression\":\"mode == \"}],"
+        "\"actions\":[]}", 1) == NULL);
+
+    MCP_AutomationDeleteRule("b");
+    MCP_AutomationDeleteRule("c");
+    MCP_AutomationDeleteRule("d");
+
+    printf("Shared condition tests passed!\n");
+}
+
+// Test event and schedule triggers
+static void test_event_and_schedule_triggers() {
+    printf("Testing event and schedule triggers...\n");
+
+    s_actuatorCalls = 0;
+
+    assert(MCP_AutomationCreateRule(
+        "{\"id\":\"door\",\"triggers\":[{\"type\":\"event\",\"event\":\"input\",\"source\":\"door\"}],"
+        "\"actions\":[{\"type\":\"actuator\",\"target\":\"light\",\"command\":\"on\"}]}", 1) != NULL);
+
+    MCP_Event event;
+    memset(&event, 0, sizeof(event));
+    event.type = MCP_EVENT_TYPE_INPUT;
+    event.source = "window";
+    MCP_AutomationHandleEvent(&event, NULL);
+    MCP_AutomationProcess(0);
+    assert(s_actuatorCalls == 0);
+
+    event.source = "door";
+    MCP_AutomationHandleEvent(&event, NULL);
+    event.type = MCP_EVENT_TYPE_SENSOR;
+    MCP_AutomationHandleEvent(&event, NULL);
+    MCP_AutomationProcess(0);
+    assert(s_actuatorCalls == 1);
+
+    assert(MCP_AutomationCreateRule(
+        "{\"id\":\"tick\",\"triggers\":[{\"type\":\"schedule\",\"interval\":1000}],"
+        "\"actions\":[{\"type\":\"actuator\",\"target\":\"tick\",\"command\":\"x\"}]}", 1) != NULL);
+    MCP_AutomationProcess(500);
+    assert(s_actuatorCalls == 1);
+    MCP_AutomationProcess(1000);
+    assert(s_actuatorCalls == 2);
+    MCP_AutomationProcess(1500);
+    assert(s_actuatorCalls == 2);
+    MCP_AutomationProcess(2100);
+    assert(s_actuatorCalls == 3);
+
+    MCP_AutomationDeleteRule("door");
+    MCP_AutomationDeleteRule("tick");
+
+    printf("Event and schedule trigger tests passed!\n");
+}
+
+// Test the schedule deadline queue with mixed intervals, phases and deletions
+static void test_schedule_queue() {
+    printf("Testing schedule queue...\n");
+
+    char json[256];
+    const int intervals[] = { 100, 250, 70, 1000, 30, 400, 90, 160 };
+    const int count = sizeof(intervals) / sizeof(intervals[0]);
+
+    memset(s_targetFires, 0, sizeof(s_targetFires));
+    MCP_AutomationProcess(0);
+
+    for (int i = 0; i < count; i++) {
+        snprintf(json, sizeof(json),
+                 "{\"id\":\"q%d\",\"triggers\":[{\"type\":\"schedule\",\"interval\":%d,\"at\":%d}],"
+                 "\"actions\":[{\"type\":\"actuator\",\"target\":\"t_%d\",\"command\":\"x\"}]}",
+                 i, intervals[i], i * 7 % intervals[i], i);
+        assert(MCP_AutomationCreateRule(json, strlen(json)) != NULL);
+    }
+
+    // Each rule fires once per period at its phase
+    for (uint32_t t = 1; t <= 2000; t++) {
+        MCP_AutomationProcess(t);
+    }
+    for (int i = 0; i < count; i++) {
+        int phase = i * 7 % intervals[i];
+        int expected = (2000 - phase) / intervals[i] + (phase == 0 ? 0 : 1);
+        assert(s_targetFires[i] == expected);
+    }
+
+    // Deleted rules leave the queue; the others keep their order
+    assert(MCP_AutomationDeleteRule("q4") == 0);
+    assert(MCP_AutomationDeleteRule("q0") == 0);
+    memset(s_targetFires, 0, sizeof(s_targetFires));
+    for (uint32_t t = 2001; t <= 3000; t++) {
+        MCP_AutomationProcess(t);
+    }
+    assert(s_targetFires[0] == 0 && s_targetFires[4] == 0);
+    assert(s_targetFires[3] == 1 && s_targetFires[2] > 13);
+
+    // Missed occurrences are skipped rather than replayed
+    memset(s_targetFires, 0, sizeof(s_targetFires));
+    MCP_AutomationProcess(10000);
+    for (int i = 1; i < count; i++) {
+        assert(s_targetFires[i] == (i == 4 ? 0 : 1));
+    }
+
+    for (int i = 0; i < count; i++) {
+        snprintf(json, sizeof(json), "q%d", i);
+        MCP_AutomationDeleteRule(json);
+    }
+
+    printf("Schedule queue tests passed!\n");
+}
+
+// Simulate a noisy sensor hovering around a threshold and compare action counts
+static void test_noisy_trace_qualifiers() {
+    printf("Testing trigger qualifiers on a noisy trace...\n");
+
+    static const char* const rules[] = {
+        "{\"id\":\"raw\",\"triggers\":[{\"type\":\"condition\",\"expression\":\"temperature > 30\"}],"
+        "\"actions\":[{\"type\":\"actuator\",\"target\":\"t_0\",\"command\":\"on\"}]}",
+        "{\"id\":\"hysteresis\",\"triggers\":[{\"type\":\"condition\",\"sensor\":\"temperature\",\"operator\":\">\",\"value\":30,\"hysteresis\":3.5}],"
+        "\"actions\":[{\"type\":\"actuator\",\"target\":\"t_1\",\"command\":\"on\"}]}",
+        "{\"id\":\"hold\",\"triggers\":[{\"type\":\"condition\",\"expression\":\"temperature > 30\",\"hold\":2000}],"
+        "\"actions\":[{\"type\":\"actuator\",\"target\":\"t_2\",\"command\":\"on\"}]}",
+        "{\"id\":\"min_interval\",\"minInterval\":60000,\"triggers\":[{\"type\":\"condition\",\"expression\":\"temperature > 30\"}],"
+        "\"actions\":[{\"type\":\"actuator\",\"target\":\"t_3\",\"command\":\"on\"}]}",
+        "{\"id\":\"token_bucket\",\"rateLimit\":{\"rate\":0.01,\"burst\":2},\"triggers\":[{\"type\":\"condition\",\"expression\":\"temperature > 30\"}],"
+        "\"actions\":[{\"type\":\"actuator\",\"target\":\"t_4\",\"command\":\"on\"}]}"
+    };
+    static const char* const ids[] = { "raw", "hysteresis", "hold", "min_interval", "token_bucket" };
+    const int ruleCount = sizeof(rules) / sizeof(rules[0]);
+
+    memset(s_targetFires, 0, sizeof(s_targetFires));
+    set_number("temperature", 20);
+    MCP_AutomationProcess(0);
+
+    for (int i = 0; i < ruleCount; i++) {
+        assert(MCP_AutomationCreateRule(rules[i], strlen(rules[i])) != NULL);
+    }
+
+    // 10 minutes at 100 ms: a slow 2-minute swing of +/-3 around 30 plus +/-1.5 noise
+    uint32_t seed = 12345;
+    for (uint32_t t = 100; t <= 600000; t += 100) {
+        seed = seed * 1103515245 + 12345;
+        double noise = ((seed >> 16) & 0x7fff) / 32767.0 * 3.0 - 1.5;
+        set_number("temperature", 30 + 3 * sin(2 * M_PI * t / 120000.0) + noise);
+        MCP_AutomationProcess(t);
+    }
+
+    printf("%14s %8s\n", "rule", "actions");
+    for (int i = 0; i < ruleCount; i++) {
+        printf("%14s %8d\n", ids[i], s_targetFires[i]);
+    }
+
+    // Every qualifier cuts the storm to a small fraction of the raw count
+    assert(s_targetFires[0] > 100);
+    for (int i = 1; i < ruleCount; i++) {
+        assert(s_targetFires[i] > 0 && s_targetFires[i] * 10 < s_targetFires[0]);
+    }
+    assert(s_targetFires[1] <= 7);   // Band wider than the noise: about one per swing
+    assert(s_targetFires[3] <= 10);  // At most one per minute
+    assert(s_targetFires[4] <= 8);   // Burst of 2 plus one per 100 s
+
+    for (int i = 0; i < ruleCount; i++) {
+        MCP_AutomationDeleteRule(ids[i]);
+    }
+
+    printf("Noisy trace qualifier tests passed!\n");
+}
+
+// Test action coalescing, priority order and the time budget
+static void test_action_queue() {
+    printf("Testing action queue...\n");
+
+    MCP_AutomationActionStats before, after;
+    char json[256];
+
+    set_number("alarm", 0);
+    MCP_AutomationProcess(0);
+
+    // Different commands to the same relay all run, by priority and then in order.
+    // A second write of the same command replaces the pending one: the higher
+    // priority wins, ties go to the newest.
+    const char* writes[][4] = {
+        { "relay", "low", "0", "" },
+        { "relay", "high", "5", "" },
+        { "relay", "tie", "5", "" },
+        { "siren", "siren", "9", "" },
+        { "relay", "low", "0", ",\"params\":{\"v\":2}" },
+        { "relay", "high", "1", ",\"params\":{\"v\":3}" },
+    };
+    for (int i = 0; i < 6; i++) {
+        snprintf(json, sizeof(json),
+                 "{\"id\":\"w%d\",\"priority\":%s,\"triggers\":[{\"type\":\"condition\",\"expression\":\"alarm == 1\"}],"
+                 "\"actions\":[{\"type\":\"actuator\",\"target\":\"%s\",\"command\":\"%s\"%s}]}",
+                 i, writes[i][2], writes[i][0], writes[i][1], writes[i][3]);
+        assert(MCP_AutomationCreateRule(json, strlen(json)) != NULL);
+    }
+
+    MCP_AutomationGetActionStats(&before);
+    s_actuatorCalls = 0;
+    s_callLog[0] = '\0';
+    set_number("alarm", 1);
+    MCP_AutomationProcess(10);
+    MCP_AutomationGetActionStats(&after);
+
+    assert(s_actuatorCalls == 4);
+    assert(strcmp(s_callLog, "siren high tie low ") == 0);
+    assert(strcmp(s_lastCommand, "low") == 0 && strstr(s_lastParams, "2") != NULL);
+    assert(after.actionsQueued - before.actionsQueued == 6);
+    assert(after.actionsIssued - before.actionsIssued == 4);
+    assert(after.actionsCoalesced - before.actionsCoalesced == 2);
+
+    // Budget of 250 us with 100 us per driver call: three actions per pass
+    for (int i = 0; i < 6; i++) {
+        snprintf(json, sizeof(json), "w%d", i);
+        MCP_AutomationDeleteRule(json);
+    }
+    set_number("alarm", 0);
+    MCP_AutomationProcess(20);
+    for (int i = 0; i < 8; i++) {
+        snprintf(json, sizeof(json),
+                 "{\"id\":\"b%d\",\"triggers\":[{\"type\":\"condition\",\"expression\":\"alarm == 1\"}],"
+                 "\"actions\":[{\"type\":\"actuator\",\"target\":\"relay_%d\",\"command\":\"on\"}]}", i, i);
+        assert(MCP_AutomationCreateRule(json, strlen(json)) != NULL);
+    }
+
+    assert(MCP_AutomationSetActionBudget(250, NULL) == -1);
+    assert(MCP_AutomationSetActionBudget(250, fake_clock_us) == 0);
+    s_actuatorCalls = 0;
+    set_number("alarm", 1);
+    MCP_AutomationProcess(30);
+    assert(s_actuatorCalls == 3);
+    MCP_AutomationProcess(40);
+    assert(s_actuatorCalls == 6);
+
+    // Deleting a rule drops its deferred action
+    MCP_AutomationDeleteRule("b6");
+    MCP_AutomationDeleteRule("b7");
+    MCP_AutomationProcess(50);
+    assert(s_actuatorCalls == 6);
+
+    MCP_AutomationSetActionBudget(0, NULL);
+    for (int i = 0; i < 8; i++) {
+        snprintf(json, sizeof(json), "b%d", i);
+        MCP_AutomationDeleteRule(json);
+    }
+
+    printf("Action queue tests passed!\n");
+}
+
+// Fire the persisted rule set and return the actuator log
+static const char* fire_persisted_rules(uint32_t now) {
+    s_callLog[0] = '\0';
+    set_number("door", 0);
+    MCP_AutomationProcess(now);
+    set_number("door", 1);
+    MCP_AutomationProcess(now + 1);
+    MCP_AutomationTriggerRule("p_manual");
+    return s_callLog;
+}
+
+// Test rules survive JSON export/import and a binary snapshot
+static void test_rule_persistence() {
+    printf("Testing rule export, import and snapshots...\n");
+
+    const char* rules[] = {
+        "{\"id\":\"p_door\",\"name\":\"Door\",\"priority\":3,\"minInterval\":5,"
+        "\"triggers\":[{\"type\":\"condition\",\"expression\":\"door == 1 && armed == 1\"}],"
+        "\"actions\":[{\"type\":\"actuator\",\"target\":\"siren\",\"command\":\"wail\",\"params\":{\"level\":2}}]}",
+        "{\"id\":\"p_hold\",\"triggers\":[{\"type\":\"condition\",\"expression\":\"door == 1\",\"hold\":0,"
+        "\"release\":\"door == 0\"},{\"type\":\"schedule\",\"interval\":60000,\"at\":7}],"
+        "\"rateLimit\":{\"rate\":2,\"burst\":4},"
+        "\"actions\":[{\"type\":\"actuator\",\"target\":\"lamp\",\"command\":\"on\"},{\"type\":\"notification\",\"message\":\"hi\"}]}",
+        "{\"id\":\"p_manual\",\"triggers\":[{\"type\":\"manual\"},{\"type\":\"event\",\"event\":\"sensor\",\"source\":\"s1\"}],"
+        "\"actions\":[{\"type\":\"actuator\",\"target\":\"bell\",\"command\":\"ring\"}]}"
+    };
+    const char* ids[] = { "p_door", "p_hold", "p_manual" };
+    char reference[256];
+    char json[2048];
+    uint8_t snapshot[2048];
+
+    set_number("armed", 1);
+    for (int i = 0; i < 3; i++) {
+        assert(MCP_AutomationCreateRule(rules[i], strlen(rules[i])) != NULL);
+    }
+    snprintf(reference, sizeof(reference), "%s", fire_persisted_rules(100));
+    assert(strcmp(reference, "wail on ring ") == 0);
+
+    // JSON round trip
+    int jsonLength = MCP_AutomationExportRules(json, sizeof(json));
+    assert(jsonLength > 0);
+    assert(MCP_AutomationExportRules(json, 64) == -2);
+    MCP_AutomationExportRules(json, sizeof(json));
+    for (int i = 0; i < 3; i++) {
+        MCP_AutomationDeleteRule(ids[i]);
+    }
+    assert(MCP_AutomationImportRules(json, jsonLength) == 3);
+    assert(strcmp(fire_persisted_rules(200), reference) == 0);
+
+    // Snapshot round trip
+    int snapshotLength = MCP_AutomationSaveSnapshot(NULL, 0);
+    assert(snapshotLength > 16);
+    assert(MCP_AutomationSaveSnapshot(snapshot, 16) == -2);
+    assert(MCP_AutomationSaveSnapshot(snapshot, sizeof(snapshot)) == snapshotLength);
+
+    // Existing rules are kept
+    assert(MCP_AutomationLoadSnapshot(snapshot, snapshotLength) == 0);
+    for (int i = 0; i < 3; i++) {
+        MCP_AutomationDeleteRule(ids[i]);
+    }
+    assert(MCP_AutomationLoadSnapshot(snapshot, snapshotLength) == 3);
+    assert(strcmp(fire_persisted_rules(300), reference) == 0);
+    for (int i = 0; i < 3; i++) {
+        MCP_AutomationDeleteRule(ids[i]);
+    }
+
+    // Corrupted, truncated and foreign data are rejected without adding rules
+    snapshot[snapshotLength / 2] ^= 0x40;
+    assert(MCP_AutomationLoadSnapshot(snapshot, snapshotLength) == -4);
+    snapshot[snapshotLength / 2] ^= 0x40;
+    assert(MCP_AutomationLoadSnapshot(snapshot, snapshotLength - 1) == -4);
+    assert(MCP_AutomationLoadSnapshot((const uint8_t*)"JSON", 4) == -2);
+    assert(MCP_AutomationTriggerRule("p_manual") != 0);
+
+    assert(MCP_AutomationLoadSnapshot(snapshot, snapshotLength) == 3);
+    for (int i = 0; i < 3; i++) {
+        MCP_AutomationDeleteRule(ids[i]);
+    }
+
+    printf("Rule persistence tests passed!\n");
+}
+
+// Test per-rule profile counters and the top-N query
+static void test_rule_profiler() {
+    printf("Testing rule profiler...\n");
+
+    const char* rules[] = {
+        "{\"id\":\"pf_light\",\"triggers\":[{\"type\":\"condition\",\"expression\":\"load > 5\"}],"
+        "\"actions\":[{\"type\":\"actuator\",\"target\":\"pf_a\",\"command\":\"on\"}]}",
+        "{\"id\":\"pf_heavy\",\"triggers\":[{\"type\":\"condition\",\"expression\":\"load > 2 && level > 1\"}],"
+        "\"actions\":[{\"type\":\"actuator\",\"target\":\"pf_b\",\"command\":\"on\"}]}",
+        "{\"id\":\"pf_manual\",\"triggers\":[{\"type\":\"manual\"}],"
+        "\"actions\":[{\"type\":\"notification\"}]}"
+    };
+    MCP_AutomationRuleProfile profile;
+    MCP_AutomationRuleProfile top[3];
+
+    set_number("load", 0);
+    set_number("level", 0);
+    for (int i = 0; i < 3; i++) {
+        assert(MCP_AutomationCreateRule(rules[i], strlen(rules[i])) != NULL);
+    }
+    MCP_AutomationProcess(0);
+
+    assert(MCP_AutomationSetProfiling(true, fake_ticks, 0) == -1);
+    assert(MCP_AutomationSetProfiling(true, fake_ticks, 10) == 0);
+    MCP_AutomationResetProfile();
+
+    // Ten updates of both inputs; load crosses both thresholds twice
+    const int loads[] = { 1, 8, 1, 8, 1, 1, 1, 1, 1, 1 };
+    for (int i = 0; i < 10; i++) {
+        set_number("load", loads[i]);
+        set_number("level", 2 + i);
+        MCP_AutomationProcess(10 + i);
+    }
+    MCP_AutomationTriggerRule("pf_manual");
+
+    assert(MCP_AutomationGetRuleProfile("pf_light", &profile) == 0);
+    assert(profile.evaluations == 5);       // Only changes of load re-evaluate it
+    assert(profile.trueResults == 2);
+    assert(profile.firings == 2);
+    assert(profile.actionsIssued == 2);
+    assert(profile.evalTimeNs == 5 * 1000); // One clock step per evaluation, the first one timed
+    assert(profile.maxEvalNs == 1000);
+    assert(profile.maxActionLatencyNs > 0);
+
+    assert(MCP_AutomationGetRuleProfile("pf_heavy", &profile) == 0);
+    assert(profile.evaluations == 5 + 10);  // Two conjuncts, level changes every pass
+    assert(profile.evalTimeNs == 15 * 1000); // Scaled up from the first evaluation of each
+    assert(profile.firings == 2);
+
+    assert(MCP_AutomationGetRuleProfile("pf_manual", &profile) == 0);
+    assert(profile.evaluations == 0 && profile.firings == 1 && profile.actionsIssued == 1);
+
+    // Top-N by evaluation time and by evaluation count
+    assert(MCP_AutomationGetTopRules(top, 2, MCP_AUTOMATION_SORT_EVAL_TIME) == 2);
+    assert(strcmp(top[0].ruleId, "pf_heavy") == 0 && strcmp(top[1].ruleId, "pf_light") == 0);
+    assert(MCP_AutomationGetTopRules(top, 1, MCP_AUTOMATION_SORT_EVALUATIONS) == 1);
+    assert(strcmp(top[0].ruleId, "pf_heavy") == 0);
+
+    // Action latency sorts by the total, with a separate key for the maximum
+    assert(MCP_AutomationGetTopRules(top, 3, MCP_AUTOMATION_SORT_ACTION_LATENCY) == 3);
+    assert(top[0].actionLatencyNs >= top[1].actionLatencyNs && top[1].actionLatencyNs >= top[2].actionLatencyNs);
+    assert(MCP_AutomationGetTopRules(top, 3, MCP_AUTOMATION_SORT_MAX_ACTION_LATENCY) == 3);
+    assert(top[0].maxActionLatencyNs >= top[1].maxActionLatencyNs);
+    assert(top[1].maxActionLatencyNs >= top[2].maxActionLatencyNs);
+
+    // MCP_AutomationInit registered the tool; invoke it through the registry entry
+    assert(strcmp(s_registeredTool.name, MCP_AUTOMATION_PROFILE_TOOL_NAME) == 0);
+    assert(s_registeredTool.schemaJson != NULL && s_registeredTool.invoke != NULL);
+    const char* byFirings = "{\"top\":1,\"sortBy\":\"firings\"}";
+    MCP_Content* params = MCP_ContentCreateFromJson(byFirings, strlen(byFirings));
+    assert(s_registeredTool.invoke("session", "op", params) == 0);
+    MCP_ContentFree(params);
+    assert(s_sentSuccess && strstr(s_sentResult, "\"sortBy\":\"firings\",\"rules\":[{\"id\":") != NULL);
+
+    const char* byMaxLatency = "{\"top\":1,\"sortBy\":\"maxActionLatency\"}";
+    MCP_ToolResult result = MCP_AutomationProfileToolHandler(byMaxLatency, strlen(byMaxLatency));
+    assert(result.status == 0 && strstr(result.resultJson, "\"sortBy\":\"maxActionLatency\"") != NULL);
+    free((void*)result.resultJson);
+
+    const char* request = "{\"top\":2,\"sortBy\":\"evaluations\",\"reset\":true}";
+    result = MCP_AutomationProfileToolHandler(request, strlen(request));
+    assert(result.status == 0);
+    assert(strstr(result.resultJson, "\"rules\":[{\"id\":\"pf_heavy\",\"evaluations\":15") != NULL);
+    free((void*)result.resultJson);
+
+    assert(MCP_AutomationGetRuleProfile("pf_heavy", &profile) == 0);
+    assert(profile.evaluations == 0 && profile.firings == 0);
+
+    // Disabled profiling records nothing
+    MCP_AutomationSetProfiling(false, NULL, 0);
+    set_number("load", 9);
+    MCP_AutomationProcess(30);
+    assert(MCP_AutomationGetRuleProfile("pf_light", &profile) == 0);
+    assert(profile.evaluations == 0 && profile.firings == 0);
+
+    for (int i = 0; i < 3; i++) {
+        const char* id = i == 0 ? "pf_light" : (i == 1 ? "pf_heavy" : "pf_manual");
+        MCP_AutomationDeleteRule(id);
+    }
+
+    printf("Rule profiler tests passed!\n");
+}
+
+// Benchmark per-update CPU: one sensor changes per pass
+static void bench_update_cost() {
+    printf("\nBenchmark: per-update cost (one of N sensors changes, then process)\n");
+    printf("%8s %16s %16s\n", "rules", "incremental us", "full scan us");
+
+    const int ruleCounts[] = { 10, 100, 1000 };
+    char json[256];
+    char name[32];
+
+    for (size_t c = 0; c < sizeof(ruleCounts) / sizeof(ruleCounts[0]); c++) {
+        int ruleCount = ruleCounts[c];
+        MCP_RuleProgram** programs = (MCP_RuleProgram**)malloc(ruleCount * sizeof(MCP_RuleProgram*));
+        int* handles = (int*)malloc(ruleCount * sizeof(int));
+
+        set_number("mode", 1);
+        for (int i = 0; i < ruleCount; i++) {
+            snprintf(name, sizeof(name), "sensor_%d", i);
+            set_number(name, 0);
+            handles[i] = MCP_RuleGetVariableHandle(name);
+
+            snprintf(json, sizeof(json),
+                     "{\"id\":\"bench_%d\",\"triggers\":[{\"type\":\"condition\",\"expression\":\"sensor_%d > 50 && mode == 1\"}],"
+                     "\"actions\":[{\"type\":\"notification\"}]}", i, i);
+            assert(MCP_AutomationCreateRule(json, strlen(json)) != NULL);
+
+            snprintf(json, sizeof(json), "sensor_%d > 50 && mode == 1", i);
+            programs[i] = MCP_RuleCompile(json);
+        }
+        MCP_AutomationProcess(0);
+
+        // Incremental: only the changed sensor's condition is evaluated
+        double start = now_seconds();
+        for (int u = 0; u < BENCH_UPDATES; u++) {
+            MCP_RuleSetVariableByHandle(handles[u % ruleCount], MCP_RuleCreateNumberValue(u & 127));
+            MCP_AutomationProcess(u);
+        }
+        double incremental = (now_seconds() - start) / BENCH_UPDATES * 1e6;
+
+        // Baseline: re-evaluate every rule's condition on each update
+        volatile int fired = 0;
+        start = now_seconds();
+        for (int u = 0; u < BENCH_UPDATES; u++) {
+            MCP_RuleSetVariableByHandle(handles[u % ruleCount], MCP_RuleCreateNumberValue(u & 127));
+            for (int i = 0; i < ruleCount; i++) {
+                MCP_RuleValue value = MCP_RuleExecute(programs[i]);
+                fired += value.value.boolValue;
+            }
+        }
+        double fullScan = (now_seconds() - start) / BENCH_UPDATES * 1e6;
+
+        printf("%8d %16.3f %16.3f\n", ruleCount, incremental, fullScan);
+
+        for (int i = 0; i < ruleCount; i++) {
+            snprintf(json, sizeof(json), "bench_%d", i);
+            MCP_AutomationDeleteRule(json);
+            MCP_RuleFreeProgram(programs[i]);
+        }
+        free(programs);
+        free(handles);
+    }
+}
+
+// Benchmark per-pass cost with many scheduled rules of which a few are due
+static void bench_schedule_pass() {
+    printf("\nBenchmark: %d scheduled rules, 1 ms passes, 5 due per pass\n", BENCH_SCHEDULED_RULES);
+
+    char json[256];
+    char ids[BENCH_SCHEDULED_RULES][16];
+    uint32_t last[BENCH_SCHEDULED_RULES];
+
+    MCP_AutomationProcess(0);
+    for (int i = 0; i < BENCH_SCHEDULED_RULES; i++) {
+        snprintf(json, sizeof(json),
+                 "{\"id\":\"sched_%d\",\"triggers\":[{\"type\":\"schedule\",\"interval\":200,\"at\":%d}],"
+                 "\"actions\":[{\"type\":\"notification\"}]}", i, i % 200);
+        assert(MCP_AutomationCreateRule(json, strlen(json)) != NULL);
+        snprintf(ids[i], sizeof(ids[i]), "sched_%d", i);
+        last[i] = 0;
+    }
+
+    // Deadline queue
+    double start = now_seconds();
+    for (uint32_t t = 1; t <= BENCH_UPDATES; t++) {
+        MCP_AutomationProcess(t);
+    }
+    double queued = (now_seconds() - start) / BENCH_UPDATES * 1e6;
+
+    // Previous approach: every rule looked up by id and checked on every pass
+    volatile int due = 0;
+    start = now_seconds();
+    for (uint32_t t = 1; t <= BENCH_UPDATES / 10; t++) {
+        for (int i = 0; i < BENCH_SCHEDULED_RULES; i++) {
+            int found = 0;
+            while (strcmp(ids[found], ids[i]) != 0) {
+                found++;
+            }
+            if (t - last[found] >= 200) {
+                last[found] = t;
+                due++;
+            }
+        }
+    }
+    double scanned = (now_seconds() - start) / (BENCH_UPDATES / 10) * 1e6;
+
+    printf("deadline queue: %.3f us/pass, id lookup + scan: %.3f us/pass\n", queued, scanned);
+
+    for (int i = 0; i < BENCH_SCHEDULED_RULES; i++) {
+        MCP_AutomationDeleteRule(ids[i]);
+    }
+}
+
+// Benchmark many overlapping rules writing a few relays
+static void bench_overlapping_actions() {
+    const int ruleCount = 200;
+    const int relayCount = 10;
+    const int passes = 200;
+    char json[256];
+
+    printf("\nBenchmark: %d rules firing together onto %d relays\n", ruleCount, relayCount);
+
+    set_number("alarm", 0);
+    MCP_AutomationProcess(0);
+    for (int i = 0; i < ruleCount; i++) {
+        snprintf(json, sizeof(json),
+                 "{\"id\":\"o%d\",\"priority\":%d,\"triggers\":[{\"type\":\"condition\",\"expression\":\"alarm == 1\"}],"
+                 "\"actions\":[{\"type\":\"actuator\",\"target\":\"relay_%d\",\"command\":\"on\"}]}",
+                 i, i % 3, i % relayCount);
+        assert(MCP_AutomationCreateRule(json, strlen(json)) != NULL);
+    }
+
+    s_driverSpin = 2000;
+
+    // Inline: every fired rule drives the actuator itself
+    s_actuatorCalls = 0;
+    double start = now_seconds();
+    for (int p = 0; p < passes; p++) {
+        for (int i = 0; i < ruleCount; i++) {
+            snprintf(json, sizeof(json), "o%d", i);
+            MCP_AutomationTriggerRule(json);
+        }
+    }
+    double inlineUs = (now_seconds() - start) / passes * 1e6;
+    int inlineCalls = s_actuatorCalls / passes;
+
+    // Queued: writes to the same relay coalesce within the pass
+    s_actuatorCalls = 0;
+    double total = 0;
+    for (int p = 0; p < passes; p++) {
+        set_number("alarm", 1);
+        start = now_seconds();
+        MCP_AutomationProcess(2 * p + 1);
+        total += now_seconds() - start;
+        set_number("alarm", 0);
+        MCP_AutomationProcess(2 * p + 2);
+    }
+    double queuedUs = total / passes * 1e6;
+    int queuedCalls = s_actuatorCalls / passes;
+
+    printf("%10s %14s %14s\n", "", "calls/pass", "us/pass");
+    printf("%10s %14d %14.1f\n", "inline", inlineCalls, inlineUs);
+    printf("%10s %14d %14.1f\n", "queued", queuedCalls, queuedUs);
+    assert(queuedCalls == relayCount);
+
+    s_driverSpin = 0;
+    for (int i = 0; i < ruleCount; i++) {
+        snprintf(json, sizeof(json), "o%d", i);
+        MCP_AutomationDeleteRule(json);
+    }
+}
+
+// Benchmark cold start: rebuilding the rule set from JSON versus a snapshot
+static void bench_cold_start() {
+    const int passes = 20;
+    char json[256];
+    char id[32];
+
+    printf("\nBenchmark: cold start with %d rules\n", BENCH_COLD_START_RULES);
+
+    MCP_AutomationProcess(0);
+    for (int i = 0; i < BENCH_COLD_START_RULES; i++) {
+        snprintf(json, sizeof(json),
+                 "{\"id\":\"cold_%d\",\"name\":\"Cold %d\",\"triggers\":[{\"type\":\"condition\","
+                 "\"expression\":\"temp_%d > %d && (mode == 2 || override == 1)\"}],"
+                 "\"actions\":[{\"type\":\"actuator\",\"target\":\"fan_%d\",\"command\":\"on\"}]}",
+                 i, i, i % 50, 20 + i % 10, i % 20);
+        assert(MCP_AutomationCreateRule(json, strlen(json)) != NULL);
+    }
+
+    size_t jsonSize = 512 * BENCH_COLD_START_RULES;
+    char* exported = (char*)malloc(jsonSize);
+    int jsonLength = MCP_AutomationExportRules(exported, jsonSize);
+    int snapshotLength = MCP_AutomationSaveSnapshot(NULL, 0);
+    uint8_t* snapshot = (uint8_t*)malloc(snapshotLength);
+    assert(jsonLength > 0);
+    assert(MCP_AutomationSaveSnapshot(snapshot, snapshotLength) == snapshotLength);
+
+    double jsonTime = 0;
+    double snapshotTime = 0;
+    for (int p = 0; p < passes; p++) {
+        for (int i = 0; i < BENCH_COLD_START_RULES; i++) {
+            snprintf(id, sizeof(id), "cold_%d", i);
+            MCP_AutomationDeleteRule(id);
+        }
+        double start = now_seconds();
+        assert(MCP_AutomationImportRules(exported, jsonLength) == BENCH_COLD_START_RULES);
+        jsonTime += now_seconds() - start;
+
+        for (int i = 0; i < BENCH_COLD_START_RULES; i++) {
+            snprintf(id, sizeof(id), "cold_%d", i);
+            MCP_AutomationDeleteRule(id);
+        }
+        start = now_seconds();
+        assert(MCP_AutomationLoadSnapshot(snapshot, snapshotLength) == BENCH_COLD_START_RULES);
+        snapshotTime += now_seconds() - start;
+    }
+
+    printf("%10s %10s %12s\n", "", "bytes", "load ms");
+    printf("%10s %10d %12.3f\n", "json", jsonLength, jsonTime / passes * 1e3);
+    printf("%10s %10d %12.3f\n", "snapshot", snapshotLength, snapshotTime / passes * 1e3);
+
+    for (int i = 0; i < BENCH_COLD_START_RULES; i++) {
+        snprintf(id, sizeof(id), "cold_%d", i);
+        MCP_AutomationDeleteRule(id);
+    }
+    free(exported);
+    free(snapshot);
+}
+
+// Benchmark profiler overhead on the incremental update path
+static void bench_profiler_overhead() {
+    const int ruleCount = 100;
+    const char* modes[] = { "off", "counters", "timed" };
+    char json[256];
+    char name[32];
+    int handles[100];
+
+    printf("\nBenchmark: profiler overhead, %d rules, one sensor changes per pass\n", ruleCount);
+
+    for (int i = 0; i < ruleCount; i++) {
+        snprintf(name, sizeof(name), "prof_%d", i);
+        set_number(name, 0);
+        handles[i] = MCP_RuleGetVariableHandle(name);
+
+        snprintf(json, sizeof(json),
+                 "{\"id\":\"prof_%d\",\"triggers\":[{\"type\":\"condition\",\"expression\":\"prof_%d > 50\"}],"
+                 "\"actions\":[{\"type\":\"notification\"}]}", i, i);
+        assert(MCP_AutomationCreateRule(json, strlen(json)) != NULL);
+    }
+    MCP_AutomationProcess(0);
+
+    printf("%10s %12s %10s\n", "profiling", "us/update", "overhead");
+    double baseline = 0;
+    for (int m = 0; m < 3; m++) {
+        MCP_AutomationSetProfiling(m > 0, m == 2 ? monotonic_ns : NULL, 1000);
+
+        // Best of several runs to keep scheduler noise out of a small difference
+        double best = 1e9;
+        for (int run = 0; run < 5; run++) {
+            double start = now_seconds();
+            for (int u = 0; u < BENCH_UPDATES; u++) {
+                MCP_RuleSetVariableByHandle(handles[u % ruleCount], MCP_RuleCreateNumberValue(u & 127));
+                MCP_AutomationProcess(u);
+            }
+            double elapsed = (now_seconds() - start) / BENCH_UPDATES * 1e6;
+            best = elapsed < best ? elapsed : best;
+        }
+
+        if (m == 0) {
+            baseline = best;
+        }
+        printf("%10s %12.3f %9.1f%%\n", modes[m], best, (best - baseline) / baseline * 100);
+    }
+    MCP_AutomationSetProfiling(false, NULL, 0);
+
+    for (int i = 0; i < ruleCount; i++) {
+        snprintf(json, sizeof(json), "prof_%d", i);
+        MCP_AutomationDeleteRule(json);
+    }
+}
+
+int main() {
+    printf("Starting automation engine tests...\n");
+
+    MCP_RuleInterpreterInit();
+    assert(MCP_AutomationInit() == 0);
+
+    test_condition_triggers();
+    test_shared_conditions();
+    test_event_and_schedule_triggers();
+    test_schedule_queue();
+    test_noisy_trace_qualifiers();
+    test_action_queue();
+    test_rule_persistence();
+    test_rule_profiler();
+    bench_update_cost();
+    bench_schedule_pass();
+    bench_overlapping_actions();
+    bench_cold_start();
+    bench_profiler_overhead();
+
+    printf("\nAll automation engine tests passed!\n");
+    return 0;
+}
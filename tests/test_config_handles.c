@@ -0,0 +1,341 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "../src/core/kernel/config_system.h"
+
+// Lookups timed per table size in the benchmark
+#define BENCH_LOOKUPS 2000000
+
+// config_system.c saves through persistent storage; nothing here saves
+int persistent_storage_write(const char* key, const void* data, size_t size) {
+    (void)key;
+    (void)data;
+    (void)size;
+    return 0;
+}
+
+int persistent_storage_read(const char* key, void* data, size_t maxSize, size_t* actualSize) {
+    (void)key;
+    (void)data;
+    (void)maxSize;
+    (void)actualSize;
+    return -1;
+}
+
+bool persistent_storage_exists(const char* key) {
+    (void)key;
+    return false;
+}
+
+int persistent_storage_delete(const char* key) {
+    (void)key;
+    return -2;
+}
+
+int persistent_storage_get_size(const char* key) {
+    (void)key;
+    return -2;
+}
+
+int persistent_storage_begin_transaction(void) {
+    return -1;
+}
+
+int persistent_storage_end_transaction(void) {
+    return 0;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void make_key(char* key, size_t size, int i) {
+    snprintf(key, size, "sensor.%d.sample_interval", i);
+}
+
+static void test_hashed_lookup() {
+    printf("Testing hashed configuration lookup...\n");
+
+    assert(MCP_ConfigInit(600) == 0);
+    assert(MCP_ConfigInit(600) == -1);
+
+    char key[64];
+    for (int i = 0; i < 600; i++) {
+        make_key(key, sizeof(key), i);
+        assert(MCP_ConfigSetInt(key, i, false) == 0);
+    }
+    assert(MCP_ConfigSetInt("one.too.many", 1, false) == -1);
+
+    // Removing entries keeps the rest of every probe run reachable
+    for (int i = 0; i < 600; i += 3) {
+        make_key(key, sizeof(key), i);
+        assert(MCP_ConfigRemove(key) == 0);
+        assert(MCP_ConfigRemove(key) == -1);
+    }
+    for (int i = 0; i < 600; i++) {
+        make_key(key, sizeof(key), i);
+        assert(MCP_ConfigGetInt(key, -1) == (i % 3 == 0 ? -1 : i));
+    }
+
+    // Freed slots are reused
+    for (int i = 0; i < 600; i += 3) {
+        make_key(key, sizeof(key), i);
+        assert(MCP_ConfigSetInt(key, i * 2, false) == 0);
+    }
+    for (int i = 0; i < 600; i++) {
+        make_key(key, sizeof(key), i);
+        assert(MCP_ConfigGetInt(key, -1) == (i % 3 == 0 ? i * 2 : i));
+    }
+
+    MCP_ConfigDeinit();
+    printf("Hashed lookup test passed!\n\n");
+}
+
+static void test_handles() {
+    printf("Testing configuration handles...\n");
+
+    assert(MCP_ConfigInit(8) == 0);
+
+    // A handle can be resolved before the key is set
+    MCP_ConfigHandle level = MCP_ConfigGetHandle("log.level");
+    assert(level.index != MCP_CONFIG_INVALID_INDEX);
+    assert(MCP_ConfigHandleValid(level));
+    assert(MCP_ConfigHandleGetInt(level, 3) == 3);
+    assert(MCP_ConfigGetInt("log.level", 3) == 3);
+
+    // Unset entries are left out of exports
+    char json[256];
+    assert(MCP_ConfigExportJson(json, sizeof(json)) == 2);
+    assert(strcmp(json, "{}") == 0);
+
+    assert(MCP_ConfigSetInt("log.level", 1, false) == 0);
+    assert(MCP_ConfigHandleGetInt(level, 3) == 1);
+    assert(MCP_ConfigHandleGetFloat(level, 2.5f) == 2.5f);
+
+    // Strings are read in place and keep their address while unchanged
+    MCP_ConfigHandle name = MCP_ConfigGetHandle("device.name");
+    assert(MCP_ConfigSetString("device.name", "hub", true) == 0);
+    const char* value = MCP_ConfigHandleGetString(name, NULL);
+    assert(value != NULL && strcmp(value, "hub") == 0);
+    assert(value == MCP_ConfigGetString("device.name", NULL));
+    assert(MCP_ConfigSetString("device.name", "hub", true) == 0);
+    assert(MCP_ConfigHandleGetString(name, NULL) == value);
+
+    assert(MCP_ConfigSetBool("server.enabled", true, false) == 0);
+    assert(MCP_ConfigHandleGetBool(MCP_ConfigGetHandle("server.enabled"), false));
+    int object = 0;
+    assert(MCP_ConfigSetObject("server.context", &object, false) == 0);
+    assert(MCP_ConfigHandleGetObject(MCP_ConfigGetHandle("server.context"), NULL) == &object);
+
+    // A removed entry's handle goes stale, even once the slot is reused
+    assert(MCP_ConfigRemove("log.level") == 0);
+    assert(!MCP_ConfigHandleValid(level));
+    assert(MCP_ConfigHandleGetInt(level, 3) == 3);
+    assert(MCP_ConfigSetInt("sample.rate", 10, false) == 0);
+    assert(MCP_ConfigHandleGetInt(level, 3) == 3);
+    assert(MCP_ConfigSetInt("log.level", 2, false) == 0);
+    assert(MCP_ConfigHandleGetInt(level, 3) == 3);
+    level = MCP_ConfigGetHandle("log.level");
+    assert(MCP_ConfigHandleGetInt(level, 3) == 2);
+
+    MCP_ConfigHandle invalid;
+    invalid.index = MCP_CONFIG_INVALID_INDEX;
+    invalid.generation = 0;
+    assert(!MCP_ConfigHandleValid(invalid));
+    assert(MCP_ConfigHandleGetInt(invalid, 7) == 7);
+
+    MCP_ConfigDeinit();
+    assert(MCP_ConfigHandleGetInt(level, 3) == 3);
+    printf("Configuration handle test passed!\n\n");
+}
+
+typedef struct {
+    int calls;
+    char lastKey[64];
+    MCP_ConfigHandle lastHandle;
+} ChangeLog;
+
+static void record_change(const char* key, MCP_ConfigHandle handle, void* context) {
+    ChangeLog* log = (ChangeLog*)context;
+    log->calls++;
+    strncpy(log->lastKey, key, sizeof(log->lastKey) - 1);
+    log->lastHandle = handle;
+}
+
+// Subscriber that caches its value and refreshes it on change
+static int32_t s_cachedLevel = 0;
+
+static void refresh_level(const char* key, MCP_ConfigHandle handle, void* context) {
+    (void)key;
+    (void)context;
+    s_cachedLevel = MCP_ConfigHandleGetInt(handle, 0);
+}
+
+static void test_change_hooks() {
+    printf("Testing configuration change hooks...\n");
+
+    assert(MCP_ConfigInit(16) == 0);
+
+    ChangeLog logChanges;
+    ChangeLog allChanges;
+    memset(&logChanges, 0, sizeof(logChanges));
+    memset(&allChanges, 0, sizeof(allChanges));
+    int logSubscription = MCP_ConfigSubscribe("log.", record_change, &logChanges);
+    int allSubscription = MCP_ConfigSubscribe(NULL, record_change, &allChanges);
+    assert(logSubscription >= 0 && allSubscription >= 0 && logSubscription != allSubscription);
+    assert(MCP_ConfigSubscribe("x", NULL, NULL) == -1);
+
+    // Only matching prefixes hear of a change, and only of a real one
+    assert(MCP_ConfigSetInt("log.level", 2, false) == 0);
+    assert(logChanges.calls == 1 && allChanges.calls == 1);
+    assert(strcmp(logChanges.lastKey, "log.level") == 0);
+    assert(MCP_ConfigHandleGetInt(logChanges.lastHandle, 0) == 2);
+
+    assert(MCP_ConfigSetInt("log.level", 2, true) == 0);
+    assert(logChanges.calls == 1);
+    assert(MCP_ConfigSetFloat("log.level", 2.0f, false) == 0);
+    assert(logChanges.calls == 2);
+    assert(MCP_ConfigSetString("net.host", "a", false) == 0);
+    assert(MCP_ConfigSetString("net.host", "a", false) == 0);
+    assert(MCP_ConfigSetString("net.host", "b", false) == 0);
+    assert(logChanges.calls == 2 && allChanges.calls == 4);
+
+    // Resolving a handle is not a change; removal is, with the handle already stale
+    MCP_ConfigGetHandle("log.format");
+    assert(logChanges.calls == 2);
+    assert(MCP_ConfigRemove("log.format") == 0);
+    assert(logChanges.calls == 2);
+    assert(MCP_ConfigRemove("log.level") == 0);
+    assert(logChanges.calls == 3 && strcmp(logChanges.lastKey, "log.level") == 0);
+    assert(!MCP_ConfigHandleValid(logChanges.lastHandle));
+
+    // A subscriber can keep a cached copy in step
+    int cacheSubscription = MCP_ConfigSubscribe("log.level", refresh_level, NULL);
+    assert(MCP_ConfigSetInt("log.level", 4, false) == 0);
+    assert(s_cachedLevel == 4);
+    assert(MCP_ConfigSetInt("log.level", 5, false) == 0);
+    assert(s_cachedLevel == 5);
+
+    assert(logChanges.calls == 5);
+    assert(MCP_ConfigUnsubscribe(logSubscription) == 0);
+    assert(MCP_ConfigUnsubscribe(logSubscription) == -1);
+    assert(MCP_ConfigUnsubscribe(-1) == -1);
+    assert(MCP_ConfigSetInt("log.level", 6, false) == 0);
+    assert(logChanges.calls == 5 && s_cachedLevel == 6);
+
+    // The subscription table is bounded
+    int extra[MCP_CONFIG_MAX_SUBSCRIBERS];
+    int extraCount = 0;
+    for (;;) {
+        int subscription = MCP_ConfigSubscribe(NULL, record_change, &allChanges);
+        if (subscription < 0) {
+            assert(subscription == -2);
+            break;
+        }
+        extra[extraCount++] = subscription;
+    }
+    assert(extraCount == MCP_CONFIG_MAX_SUBSCRIBERS - 2);
+    for (int i = 0; i < extraCount; i++) {
+        assert(MCP_ConfigUnsubscribe(extra[i]) == 0);
+    }
+    assert(MCP_ConfigUnsubscribe(cacheSubscription) == 0);
+    assert(MCP_ConfigUnsubscribe(allSubscription) == 0);
+
+    MCP_ConfigDeinit();
+    printf("Change hook test passed!\n\n");
+}
+
+// The lookup MCP_ConfigGet* did before: a strcmp scan over every slot
+static int32_t linear_get_int(char** keys, const int32_t* values, int count, const char* key, int32_t defaultValue) {
+    for (int i = 0; i < count; i++) {
+        if (keys[i] != NULL && strcmp(keys[i], key) == 0) {
+            return values[i];
+        }
+    }
+    return defaultValue;
+}
+
+static void bench_get(int entryCount) {
+    char** keys = (char**)malloc(entryCount * sizeof(char*));
+    int32_t* values = (int32_t*)malloc(entryCount * sizeof(int32_t));
+    MCP_ConfigHandle* handles = (MCP_ConfigHandle*)malloc(entryCount * sizeof(MCP_ConfigHandle));
+    int* order = (int*)malloc(BENCH_LOOKUPS * sizeof(int));
+    assert(keys != NULL && values != NULL && handles != NULL && order != NULL);
+
+    assert(MCP_ConfigInit((uint16_t)entryCount) == 0);
+    char key[64];
+    for (int i = 0; i < entryCount; i++) {
+        make_key(key, sizeof(key), i);
+        keys[i] = strdup(key);
+        values[i] = i;
+        assert(MCP_ConfigSetInt(key, i, false) == 0);
+        handles[i] = MCP_ConfigGetHandle(key);
+    }
+
+    uint32_t seed = 99;
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        seed = seed * 1103515245u + 12345u;
+        order[i] = (int)((seed >> 8) % (uint32_t)entryCount);
+    }
+
+    // The linear scan is slow enough at scale to time on fewer lookups
+    int linearLookups = BENCH_LOOKUPS / (entryCount >= 256 ? 20 : 1);
+    int64_t sum = 0;
+    double start = now_seconds();
+    for (int i = 0; i < linearLookups; i++) {
+        sum += linear_get_int(keys, values, entryCount, keys[order[i]], -1);
+    }
+    double linearNs = (now_seconds() - start) * 1e9 / linearLookups;
+
+    start = now_seconds();
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        sum += MCP_ConfigGetInt(keys[order[i]], -1);
+    }
+    double hashedNs = (now_seconds() - start) * 1e9 / BENCH_LOOKUPS;
+
+    start = now_seconds();
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        sum += MCP_ConfigHandleGetInt(handles[order[i]], -1);
+    }
+    double handleNs = (now_seconds() - start) * 1e9 / BENCH_LOOKUPS;
+
+    // Every lookup found its value
+    int64_t expected = 0;
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        expected += order[i] * (i < linearLookups ? 3 : 2);
+    }
+    assert(sum == expected);
+
+    printf("  %5d entries %12.1f %12.1f %12.1f\n", entryCount, linearNs, hashedNs, handleNs);
+
+    MCP_ConfigDeinit();
+    for (int i = 0; i < entryCount; i++) {
+        free(keys[i]);
+    }
+    free(keys);
+    free(values);
+    free(handles);
+    free(order);
+}
+
+int main() {
+    printf("=== Configuration Handle Tests ===\n\n");
+
+    test_hashed_lookup();
+    test_handles();
+    test_change_hooks();
+
+    printf("Benchmarking MCP_ConfigGetInt latency (ns per get)\n");
+    printf("  %13s %12s %12s %12s\n", "", "linear scan", "hashed key", "handle");
+    bench_get(16);
+    bench_get(256);
+    bench_get(2048);
+
+    printf("\nAll configuration handle tests passed!\n");
+    return 0;
+}
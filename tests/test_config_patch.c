@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "../src/core/mcp/config/config_fields.h"
+#include "../src/core/mcp/config/mcp_config.h"
+
+#define BENCH_RUNS 20000
+
+// Small struct exercising every field type and nested sections
+typedef struct {
+    bool flag;
+    int16_t offset;
+    uint8_t level;
+    char name[8];
+    struct {
+        uint32_t rate;
+        char mode[16];
+    } outer;
+} TestConfig;
+
+enum { TEST_TOP, TEST_ONE, TEST_TWO, TEST_OTHER };
+
+static const char* const s_test_sections[] = { "top", "outer.one", "outer.two", "other" };
+
+static const MCP_ConfigField s_test_fields[] = {
+    MCP_CONFIG_FIELD(TEST_TOP, "flag", BOOL, TestConfig, flag),
+    MCP_CONFIG_FIELD(TEST_TOP, "offset", INT, TestConfig, offset),
+    MCP_CONFIG_FIELD(TEST_TOP, "name", STRING, TestConfig, name),
+    MCP_CONFIG_FIELD(TEST_ONE, "rate", UINT, TestConfig, outer.rate),
+    MCP_CONFIG_FIELD(TEST_TWO, "mode", STRING, TestConfig, outer.mode),
+    MCP_CONFIG_FIELD(TEST_OTHER, "level", UINT, TestConfig, level),
+};
+
+static const MCP_ConfigFieldTable s_test_table = { s_test_sections, 4, s_test_fields, 6 };
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void test_config_defaults(TestConfig* config) {
+    memset(config, 0, sizeof(TestConfig));
+    config->flag = true;
+    config->offset = -5;
+    config->level = 3;
+    strcpy(config->name, "dev");
+    config->outer.rate = 9600;
+    strcpy(config->outer.mode, "auto");
+}
+
+static void test_patch_semantics() {
+    printf("Testing merge patch semantics...\n");
+
+    TestConfig defaults;
+    TestConfig config;
+    test_config_defaults(&defaults);
+    test_config_defaults(&config);
+    uint32_t changed = 0;
+
+    // Only the named member changes
+    assert(MCP_ConfigFieldsApplyPatch(&s_test_table, &config, &defaults,
+                                      "{\"outer\": {\"one\": {\"rate\": 115200}}}", &changed) == 0);
+    assert(config.outer.rate == 115200);
+    assert(changed == (1u << TEST_ONE));
+    assert(config.flag && config.offset == -5 && strcmp(config.outer.mode, "auto") == 0);
+
+    // Dotted names address the same members
+    assert(MCP_ConfigFieldsApplyPatch(&s_test_table, &config, &defaults,
+                                      "{\"top.offset\": -300, \"outer\": {\"two.mode\": \"fast\"}}", &changed) == 0);
+    assert(config.offset == -300 && strcmp(config.outer.mode, "fast") == 0);
+    assert(changed == ((1u << TEST_TOP) | (1u << TEST_TWO)));
+
+    // Writing the current value is no change
+    assert(MCP_ConfigFieldsApplyPatch(&s_test_table, &config, &defaults, "{\"top\": {\"flag\": true}}", &changed) == 0);
+    assert(changed == 0);
+
+    // Unknown members, wrong types and values the member cannot hold are ignored
+    assert(MCP_ConfigFieldsApplyPatch(&s_test_table, &config, &defaults,
+                                      "{\"top\": {\"flag\": 1, \"offset\": 40000, \"name\": false, \"extra\": [1, {\"a\": null}]},"
+                                      " \"other\": {\"level\": 256}, \"outer\": {\"one\": {\"rate\": 1.5}}, \"missing\": {}}",
+                                      &changed) == 0);
+    assert(changed == 0);
+    assert(config.flag && config.offset == -300 && config.level == 3 && config.outer.rate == 115200);
+
+    // Null restores a member, or every member of the sections below a path
+    config.level = 7;
+    assert(MCP_ConfigFieldsApplyPatch(&s_test_table, &config, &defaults, "{\"outer\": null, \"other\": {\"level\": null}}",
+                                      &changed) == 0);
+    assert(config.outer.rate == 9600 && strcmp(config.outer.mode, "auto") == 0 && config.level == 3);
+    assert(changed == ((1u << TEST_ONE) | (1u << TEST_TWO) | (1u << TEST_OTHER)));
+    assert(config.offset == -300);
+
+    // Without defaults, null clears
+    assert(MCP_ConfigFieldsApplyPatch(&s_test_table, &config, NULL, "{\"top\": {\"name\": null}}", &changed) == 0);
+    assert(config.name[0] == '\0');
+
+    // Strings are unescaped and truncated to the member
+    assert(MCP_ConfigFieldsApplyPatch(&s_test_table, &config, &defaults,
+                                      "{\"top\": {\"name\": \"a\\\"b\\\\c\\u00e9\"}}", &changed) == 0);
+    assert(strcmp(config.name, "a\"b\\c\xc3\xa9") == 0);
+    assert(MCP_ConfigFieldsApplyPatch(&s_test_table, &config, &defaults,
+                                      "{\"top\": {\"name\": \"abcdefghijkl\"}}", &changed) == 0);
+    assert(strcmp(config.name, "abcdefg") == 0);
+
+    // A malformed document changes nothing, even members before the error
+    TestConfig before = config;
+    const char* malformed[] = {
+        "{\"top\": {\"offset\": 1}",
+        "{\"top\": {\"offset\": 1}} trailing",
+        "{\"top\": {\"offset\": 1,}}",
+        "{\"top\": {\"name\": \"unterminated}}",
+        "{\"top\": {\"offset\": tru}}",
+        "[1, 2]",
+        "",
+        NULL
+    };
+    for (int i = 0; malformed[i] != NULL; i++) {
+        assert(MCP_ConfigFieldsApplyPatch(&s_test_table, &config, &defaults, malformed[i], &changed) == -2);
+        assert(changed == 0);
+        assert(memcmp(&before, &config, sizeof(config)) == 0);
+    }
+}
+
+static void test_serialize_cache() {
+    printf("Testing cached per-section serialization...\n");
+
+    TestConfig config;
+    test_config_defaults(&config);
+    strcpy(config.name, "q\"t");
+
+    char uncached[512];
+    char cached[512];
+    int length = MCP_ConfigFieldsSerialize(&s_test_table, &config, NULL, uncached, sizeof(uncached));
+    assert(length > 0 && (size_t)length == strlen(uncached));
+    assert(strcmp(uncached,
+        "{\n"
+        "  \"top\": {\n"
+        "    \"flag\": true,\n"
+        "    \"offset\": -5,\n"
+        "    \"name\": \"q\\\"t\"\n"
+        "  },\n"
+        "  \"outer\": {\n"
+        "    \"one\": {\n"
+        "      \"rate\": 9600\n"
+        "    },\n"
+        "    \"two\": {\n"
+        "      \"mode\": \"auto\"\n"
+        "    }\n"
+        "  },\n"
+        "  \"other\": {\n"
+        "    \"level\": 3\n"
+        "  }\n"
+        "}\n") == 0);
+
+    // The output parses back to the same values
+    TestConfig parsed;
+    memset(&parsed, 0, sizeof(parsed));
+    assert(MCP_ConfigFieldsApplyPatch(&s_test_table, &parsed, NULL, uncached, NULL) == 0);
+    assert(memcmp(&parsed, &config, sizeof(config)) == 0);
+
+    MCP_ConfigJsonCache cache;
+    memset(&cache, 0, sizeof(cache));
+    assert(MCP_ConfigFieldsSerialize(&s_test_table, &config, &cache, cached, sizeof(cached)) == length);
+    assert(strcmp(cached, uncached) == 0);
+    assert(cache.sectionRenders == 4);
+
+    // Nothing invalidated, nothing rendered
+    assert(MCP_ConfigFieldsSerialize(&s_test_table, &config, &cache, cached, sizeof(cached)) == length);
+    assert(cache.sectionRenders == 4);
+
+    // A patch renders only the sections it changed
+    uint32_t changed = 0;
+    assert(MCP_ConfigFieldsApplyPatch(&s_test_table, &config, NULL, "{\"outer\": {\"two\": {\"mode\": \"off\"}}}", &changed) == 0);
+    MCP_ConfigJsonCacheInvalidate(&cache, changed);
+    assert(MCP_ConfigFieldsSerialize(&s_test_table, &config, &cache, cached, sizeof(cached)) > 0);
+    assert(cache.sectionRenders == 5);
+    assert(MCP_ConfigFieldsSerialize(&s_test_table, &config, NULL, uncached, sizeof(uncached)) > 0);
+    assert(strcmp(cached, uncached) == 0);
+
+    // A buffer too small fails without a partial document
+    assert(MCP_ConfigFieldsSerialize(&s_test_table, &config, &cache, cached, 16) == -2);
+
+    MCP_ConfigJsonCacheFree(&cache);
+}
+
+static void test_platform_config() {
+    printf("Testing platform configuration updates...\n");
+
+    // Keep the API from writing a config file
+    assert(MCP_SetConfiguration("{\"system\": {\"enable_persistence\": false}}") == 0);
+
+    MCP_PLATFORM_CONFIG config;
+    MCP_ConfigInit(&config);
+    strcpy(config.common.device_name, "JSON Test Device");
+    config.common.server_port = 9090;
+    config.common.network.enabled = true;
+    strcpy(config.common.network.ssid, "TestNetwork");
+    config.common.interfaces.uart.baud_rate = 57600;
+    config.enable_camera = true;
+    config.camera_resolution = 1080;
+
+    // A serialized config parses back to the same values
+    char json[4096];
+    int length = MCP_ConfigSerializeToJSON(&config, json, sizeof(json));
+    assert(length > 0);
+    assert(strstr(json, "  \"network\": {\n    \"wifi\": {\n      \"enabled\": true,") != NULL);
+    assert(strstr(json, "\"platform\": {\n    \"rpi\": {\n      \"enable_camera\": true,") != NULL);
+
+    MCP_PLATFORM_CONFIG parsed;
+    MCP_ConfigInit(&parsed);
+    assert(MCP_ConfigUpdateFromJSON(&parsed, json) == 0);
+    assert(memcmp(&parsed, &config, sizeof(config)) == 0);
+
+    // One field through the API; the cached text follows it
+    assert(MCP_SetConfiguration("{\"server\": {\"port\": 7777}, \"device\": {\"name\": \"API Test Device\"}}") == 0);
+    char first[4096];
+    char second[4096];
+    assert(MCP_GetConfiguration(first, sizeof(first)) > 0);
+    assert(strstr(first, "\"port\": 7777") != NULL);
+    assert(strstr(first, "\"name\": \"API Test Device\"") != NULL);
+
+    assert(MCP_SetConfiguration("{\"server.port\": 7778}") == 0);
+    assert(MCP_GetConfiguration(second, sizeof(second)) > 0);
+    assert(strstr(second, "\"port\": 7778") != NULL);
+
+    MCP_PLATFORM_CONFIG api_config;
+    MCP_ConfigInit(&api_config);
+    assert(MCP_ConfigUpdateFromJSON(&api_config, second) == 0);
+    assert(api_config.common.server_port == 7778);
+    assert(strcmp(api_config.common.device_name, "API Test Device") == 0);
+    assert(!api_config.common.enable_persistence);
+
+    // Null restores the default
+    assert(MCP_SetConfiguration("{\"server\": {\"port\": null}}") == 0);
+    assert(MCP_GetConfiguration(second, sizeof(second)) > 0);
+    assert(strstr(second, "\"port\": 8080") != NULL);
+
+    // A malformed update is rejected as a whole
+    assert(MCP_SetConfiguration("{\"server\": {\"port\": 1}, \"device\": ") == -2);
+    assert(MCP_GetConfiguration(first, sizeof(first)) > 0);
+    assert(strcmp(first, second) == 0);
+}
+
+static void bench_platform_config() {
+    printf("Benchmarking platform configuration updates (us per call)...\n");
+
+    MCP_PLATFORM_CONFIG config;
+    MCP_ConfigInit(&config);
+    char full[4096];
+    char out[4096];
+    assert(MCP_ConfigSerializeToJSON(&config, full, sizeof(full)) > 0);
+
+    double start = now_seconds();
+    for (int i = 0; i < BENCH_RUNS; i++) {
+        assert(MCP_ConfigUpdateFromJSON(&config, full) == 0);
+    }
+    printf("  %-40s %8.3f\n", "full document update", (now_seconds() - start) * 1e6 / BENCH_RUNS);
+
+    char patch[64];
+    start = now_seconds();
+    for (int i = 0; i < BENCH_RUNS; i++) {
+        snprintf(patch, sizeof(patch), "{\"server\": {\"port\": %d}}", 1000 + (i & 1023));
+        assert(MCP_SetConfiguration(patch) == 0);
+    }
+    printf("  %-40s %8.3f\n", "MCP_SetConfiguration, one field", (now_seconds() - start) * 1e6 / BENCH_RUNS);
+
+    start = now_seconds();
+    for (int i = 0; i < BENCH_RUNS; i++) {
+        assert(MCP_ConfigSerializeToJSON(&config, out, sizeof(out)) > 0);
+    }
+    printf("  %-40s %8.3f\n", "serialize, uncached", (now_seconds() - start) * 1e6 / BENCH_RUNS);
+
+    start = now_seconds();
+    for (int i = 0; i < BENCH_RUNS; i++) {
+        assert(MCP_GetConfiguration(out, sizeof(out)) > 0);
+    }
+    printf("  %-40s %8.3f\n", "MCP_GetConfiguration, unchanged", (now_seconds() - start) * 1e6 / BENCH_RUNS);
+
+    start = now_seconds();
+    for (int i = 0; i < BENCH_RUNS; i++) {
+        snprintf(patch, sizeof(patch), "{\"server\": {\"port\": %d}}", 1000 + (i & 1023));
+        assert(MCP_SetConfiguration(patch) == 0);
+        assert(MCP_GetConfiguration(out, sizeof(out)) > 0);
+    }
+    printf("  %-40s %8.3f\n", "one-field set + get", (now_seconds() - start) * 1e6 / BENCH_RUNS);
+}
+
+int main() {
+    test_patch_semantics();
+    test_serialize_cache();
+    test_platform_config();
+    bench_platform_config();
+
+    printf("All configuration patch tests passed!\n");
+    return 0;
+}
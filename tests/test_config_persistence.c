@@ -0,0 +1,378 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "../src/system/persistent_storage.h"
+#include "../src/core/kernel/config_system.h"
+
+// Keys in the round trip and the benchmark
+#define CONFIG_KEYS 200
+#define BENCH_RUNS 20
+
+// Mirrors StoredConfigEntry in config_system.c, which earlier versions wrote once per key
+typedef struct {
+    char key[64];
+    MCP_ConfigType type;
+    union {
+        bool boolValue;
+        int32_t intValue;
+        float floatValue;
+        char stringValue[256];
+    } value;
+} LegacyEntry;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void init_storage(void) {
+    StorageConfig config = { .type = STORAGE_TYPE_EEPROM, .size = 256 * 1024 };
+    assert(persistent_storage_init(&config) == 0);
+}
+
+// Start the config system over on whatever the storage holds
+static void restart_config(void) {
+    MCP_ConfigDeinit();
+    assert(MCP_ConfigInit(CONFIG_KEYS + 16) == 0);
+}
+
+static void set_keys(int count) {
+    char key[32];
+    char text[32];
+    for (int i = 0; i < count; i++) {
+        snprintf(key, sizeof(key), "key%03d", i);
+        switch (i % 4) {
+            case 0:
+                assert(MCP_ConfigSetBool(key, (i / 4) % 2 == 0, true) == 0);
+                break;
+            case 1:
+                assert(MCP_ConfigSetInt(key, i * 1000 - 7, true) == 0);
+                break;
+            case 2:
+                assert(MCP_ConfigSetFloat(key, i + 0.25f, true) == 0);
+                break;
+            default:
+                snprintf(text, sizeof(text), "value-%d", i);
+                assert(MCP_ConfigSetString(key, text, true) == 0);
+                break;
+        }
+    }
+}
+
+static void check_keys(int count) {
+    char key[32];
+    char text[32];
+    for (int i = 0; i < count; i++) {
+        snprintf(key, sizeof(key), "key%03d", i);
+        switch (i % 4) {
+            case 0:
+                assert(MCP_ConfigGetBool(key, (i / 4) % 2 != 0) == ((i / 4) % 2 == 0));
+                break;
+            case 1:
+                assert(MCP_ConfigGetInt(key, 0) == i * 1000 - 7);
+                break;
+            case 2:
+                assert(MCP_ConfigGetFloat(key, 0.0f) == i + 0.25f);
+                break;
+            default:
+                snprintf(text, sizeof(text), "value-%d", i);
+                assert(strcmp(MCP_ConfigGetString(key, ""), text) == 0);
+                break;
+        }
+    }
+}
+
+static uint64_t bytes_written(void) {
+    StorageWriteStats stats;
+    assert(persistent_storage_get_write_stats(&stats) == 0);
+    return stats.mediaBytesWritten;
+}
+
+static uint32_t media_writes(void) {
+    StorageWriteStats stats;
+    assert(persistent_storage_get_write_stats(&stats) == 0);
+    return stats.mediaWrites;
+}
+
+static void test_round_trip() {
+    printf("Testing config blob round trip...\n");
+
+    init_storage();
+    restart_config();
+    set_keys(CONFIG_KEYS);
+    assert(MCP_ConfigSetInt("volatile", 5, false) == 0);
+    int object = 0;
+    assert(MCP_ConfigSetObject("object", &object, true) == 0);
+    assert(MCP_ConfigSave() == 0);
+
+    // One blob holds every key
+    assert(persistent_storage_exists("config.blob"));
+    assert(!persistent_storage_exists("config.delta"));
+    assert(!persistent_storage_exists("key000"));
+
+    restart_config();
+    assert(MCP_ConfigLoad() == 0);
+    check_keys(CONFIG_KEYS);
+    assert(MCP_ConfigGetInt("volatile", -1) == -1);
+    assert(MCP_ConfigGetObject("object", NULL) == NULL);
+
+    // Loading is not a change to save
+    uint32_t before = media_writes();
+    assert(MCP_ConfigSave() == 0);
+    assert(media_writes() == before);
+
+    MCP_ConfigDeinit();
+    persistent_storage_deinit();
+}
+
+static void test_delta_saves() {
+    printf("Testing config delta saves...\n");
+
+    init_storage();
+    restart_config();
+    set_keys(CONFIG_KEYS);
+    assert(MCP_ConfigSave() == 0);
+    int snapshotSize = persistent_storage_get_size("config.blob");
+    assert(snapshotSize > 0);
+
+    // One changed key writes a delta a few dozen bytes long
+    assert(MCP_ConfigSetInt("key001", 42, true) == 0);
+    uint64_t before = bytes_written();
+    assert(MCP_ConfigSave() == 0);
+    assert(persistent_storage_exists("config.delta"));
+    int deltaSize = persistent_storage_get_size("config.delta");
+    assert(deltaSize > 0 && deltaSize < 64);
+    assert(persistent_storage_get_size("config.blob") == snapshotSize);
+    assert(bytes_written() - before < (uint64_t)snapshotSize);
+
+    // Setting a key to its current value is not a change
+    assert(MCP_ConfigSetInt("key001", 42, true) == 0);
+    uint32_t writes = media_writes();
+    assert(MCP_ConfigSave() == 0);
+    assert(media_writes() == writes);
+
+    // Removals and keys set again after a removal come back the same way
+    assert(MCP_ConfigRemove("key002") == 0);
+    assert(MCP_ConfigRemove("key003") == 0);
+    assert(MCP_ConfigSetString("key003", "again", true) == 0);
+    assert(MCP_ConfigSetBool("added", true, true) == 0);
+    assert(MCP_ConfigSetInt("key005", 9, false) == 0);  // No longer persistent
+    assert(MCP_ConfigSave() == 0);
+
+    restart_config();
+    assert(MCP_ConfigLoad() == 0);
+    assert(MCP_ConfigGetInt("key001", 0) == 42);
+    assert(MCP_ConfigGetFloat("key002", -1.0f) == -1.0f);
+    assert(strcmp(MCP_ConfigGetString("key003", ""), "again") == 0);
+    assert(MCP_ConfigGetBool("added", false));
+    assert(MCP_ConfigGetInt("key005", -1) == -1);
+    assert(MCP_ConfigGetInt("key009", 0) == 9 * 1000 - 7);
+
+    // Once the delta outgrows a quarter of the snapshot it is folded into a new one
+    char key[32];
+    for (int i = 100; i < CONFIG_KEYS; i++) {
+        snprintf(key, sizeof(key), "key%03d", i);
+        assert(MCP_ConfigSetInt(key, -i, true) == 0);
+        assert(MCP_ConfigSave() == 0);
+        if (!persistent_storage_exists("config.delta")) {
+            break;
+        }
+        assert(persistent_storage_get_size("config.delta") <= snapshotSize / 4);
+    }
+    assert(!persistent_storage_exists("config.delta"));
+
+    restart_config();
+    assert(MCP_ConfigLoad() == 0);
+    assert(MCP_ConfigGetInt("key001", 0) == 42);
+    assert(MCP_ConfigGetInt("key101", 0) == -101);
+    assert(MCP_ConfigGetInt("key009", 0) == 9 * 1000 - 7);
+    assert(strcmp(MCP_ConfigGetString("key003", ""), "again") == 0);
+
+    MCP_ConfigDeinit();
+    persistent_storage_deinit();
+}
+
+static void test_corrupt_and_stale_blobs() {
+    printf("Testing corrupt and stale config blobs...\n");
+
+    init_storage();
+    restart_config();
+    set_keys(CONFIG_KEYS);
+    assert(MCP_ConfigSave() == 0);
+
+    // Keep a delta that belongs to the first snapshot
+    assert(MCP_ConfigSetInt("key001", 1, true) == 0);
+    assert(MCP_ConfigSave() == 0);
+    uint8_t staleDelta[256];
+    size_t staleSize = 0;
+    assert(persistent_storage_read("config.delta", staleDelta, sizeof(staleDelta), &staleSize) == 0);
+
+    // Rewrite the snapshot, then put the old delta back
+    for (int i = 0; i < CONFIG_KEYS; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "key%03d", i);
+        assert(MCP_ConfigSetInt(key, 2, true) == 0);
+    }
+    assert(MCP_ConfigSave() == 0);
+    assert(!persistent_storage_exists("config.delta"));
+    assert(persistent_storage_write("config.delta", staleDelta, staleSize) == 0);
+
+    restart_config();
+    assert(MCP_ConfigLoad() == 0);
+    assert(MCP_ConfigGetInt("key001", 0) == 2);
+
+    // A flipped bit in the snapshot fails the load
+    int size = persistent_storage_get_size("config.blob");
+    uint8_t* blob = (uint8_t*)malloc(size);
+    size_t actualSize = 0;
+    assert(persistent_storage_read("config.blob", blob, size, &actualSize) == 0);
+    blob[size / 2] ^= 0x10;
+    assert(persistent_storage_write("config.blob", blob, actualSize) == 0);
+    free(blob);
+
+    restart_config();
+    assert(MCP_ConfigLoad() == -4);
+    assert(MCP_ConfigGetInt("key001", -1) == -1);
+
+    MCP_ConfigDeinit();
+    persistent_storage_deinit();
+}
+
+static void test_legacy_migration() {
+    printf("Testing migration of per-key config entries...\n");
+
+    init_storage();
+    LegacyEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    strcpy(entry.key, "deviceName");
+    entry.type = MCP_CONFIG_TYPE_STRING;
+    strcpy(entry.value.stringValue, "legacy-device");
+    assert(persistent_storage_write("deviceName", &entry, sizeof(entry)) == 0);
+
+    memset(&entry, 0, sizeof(entry));
+    strcpy(entry.key, "capabilities.tools");
+    entry.type = MCP_CONFIG_TYPE_BOOL;
+    entry.value.boolValue = true;
+    assert(persistent_storage_write("capabilities.tools", &entry, sizeof(entry)) == 0);
+
+    restart_config();
+    assert(MCP_ConfigLoad() == 0);
+    assert(strcmp(MCP_ConfigGetString("deviceName", ""), "legacy-device") == 0);
+    assert(MCP_ConfigGetBool("capabilities.tools", false));
+
+    // The next save writes them as a snapshot, which takes over from then on
+    assert(MCP_ConfigSave() == 0);
+    assert(persistent_storage_exists("config.blob"));
+    assert(MCP_ConfigSetString("deviceName", "renamed", true) == 0);
+    assert(MCP_ConfigSave() == 0);
+
+    restart_config();
+    assert(MCP_ConfigLoad() == 0);
+    assert(strcmp(MCP_ConfigGetString("deviceName", ""), "renamed") == 0);
+    assert(MCP_ConfigGetBool("capabilities.tools", false));
+
+    MCP_ConfigDeinit();
+    persistent_storage_deinit();
+}
+
+static void bench_row(const char* name, double seconds, uint32_t writes, uint64_t bytes) {
+    printf("  %-30s %10.3f %12.1f %12.1f\n", name, seconds * 1000.0 / BENCH_RUNS,
+           (double)writes / BENCH_RUNS, bytes / 1024.0 / BENCH_RUNS);
+}
+
+static void bench_persistence() {
+    printf("Benchmarking %d config keys per save or load (ms, media write calls, KB written)...\n", CONFIG_KEYS);
+    printf("  %-30s %10s %12s %12s\n", "operation", "time", "media writes", "media KB");
+
+    init_storage();
+    restart_config();
+    set_keys(CONFIG_KEYS);
+
+    // Earlier versions wrote a fixed-size entry per key
+    LegacyEntry* legacy = (LegacyEntry*)calloc(CONFIG_KEYS, sizeof(LegacyEntry));
+    for (int i = 0; i < CONFIG_KEYS; i++) {
+        snprintf(legacy[i].key, sizeof(legacy[i].key), "key%03d", i);
+        legacy[i].type = MCP_CONFIG_TYPE_INT;
+        legacy[i].value.intValue = i;
+    }
+
+    uint32_t writes = media_writes();
+    uint64_t bytes = bytes_written();
+    double start = now_seconds();
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        assert(persistent_storage_begin_transaction() == 0);
+        for (int i = 0; i < CONFIG_KEYS; i++) {
+            legacy[i].value.intValue++;
+            assert(persistent_storage_write(legacy[i].key, &legacy[i], sizeof(LegacyEntry)) == 0);
+        }
+        assert(persistent_storage_end_transaction() == 0);
+    }
+    bench_row("per-key save", now_seconds() - start, media_writes() - writes, bytes_written() - bytes);
+
+    start = now_seconds();
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        LegacyEntry stored;
+        size_t actualSize;
+        for (int i = 0; i < CONFIG_KEYS; i++) {
+            assert(persistent_storage_read(legacy[i].key, &stored, sizeof(stored), &actualSize) == 0);
+            assert(MCP_ConfigSetInt(stored.key, stored.value.intValue, true) == 0);
+        }
+    }
+    bench_row("per-key load and set", now_seconds() - start, 0, 0);
+    for (int i = 0; i < CONFIG_KEYS; i++) {
+        assert(persistent_storage_delete(legacy[i].key) == 0);
+    }
+    free(legacy);
+
+    // Every save a full snapshot: flip one key and force the snapshot by removing the old one
+    writes = media_writes();
+    bytes = bytes_written();
+    start = now_seconds();
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        persistent_storage_delete("config.blob");
+        assert(MCP_ConfigSetInt("key001", run, true) == 0);
+        assert(MCP_ConfigSave() == 0);
+    }
+    bench_row("snapshot save", now_seconds() - start, media_writes() - writes, bytes_written() - bytes);
+
+    writes = media_writes();
+    bytes = bytes_written();
+    start = now_seconds();
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        assert(MCP_ConfigSetInt("key001", -run - 1, true) == 0);
+        assert(MCP_ConfigSave() == 0);
+    }
+    bench_row("delta save, one key changed", now_seconds() - start, media_writes() - writes, bytes_written() - bytes);
+
+    writes = media_writes();
+    bytes = bytes_written();
+    start = now_seconds();
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        assert(MCP_ConfigSave() == 0);
+    }
+    bench_row("save, nothing changed", now_seconds() - start, media_writes() - writes, bytes_written() - bytes);
+
+    start = now_seconds();
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        assert(MCP_ConfigLoad() == 0);
+    }
+    bench_row("snapshot + delta load and set", now_seconds() - start, 0, 0);
+
+    MCP_ConfigDeinit();
+    persistent_storage_deinit();
+}
+
+int main() {
+    test_round_trip();
+    test_delta_saves();
+    test_corrupt_and_stale_blobs();
+    test_legacy_migration();
+    bench_persistence();
+
+    printf("All config persistence tests passed!\n");
+    return 0;
+}
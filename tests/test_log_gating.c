@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "../src/system/logging.h"
+
+#define LOG_FILE "build/test_log_gating.log"
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void init_file_logging(LogLevel level) {
+    LogConfig config;
+    memset(&config, 0, sizeof(config));
+    config.level = level;
+    config.outputs = LOG_OUTPUT_FILE;
+    config.logFileName = LOG_FILE;
+    config.includeTimestamp = false;
+    config.colorOutput = false;
+
+    remove(LOG_FILE);
+    assert(log_init(&config) == 0);
+}
+
+// Number of lines in the log file containing text
+static int count_lines(const char* text) {
+    log_flush();
+    FILE* file = fopen(LOG_FILE, "r");
+    assert(file != NULL);
+    int count = 0;
+    char line[1300];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (strstr(line, text) != NULL) {
+            count++;
+        }
+    }
+    fclose(file);
+    return count;
+}
+
+// Argument with a side effect, to see whether a log site evaluated it
+static int s_evaluations = 0;
+
+static int counted(int value) {
+    s_evaluations++;
+    return value;
+}
+
+static void discard_sink(const LogEntry* entry, void* context) {
+    (void)entry;
+    (void)context;
+}
+
+static LogModule s_vmLog = LOG_MODULE_INIT("VM");
+static LogModule s_schedulerLog = LOG_MODULE_INIT("Scheduler");
+
+static void test_runtime_gate() {
+    printf("Testing that disabled levels skip argument evaluation...\n");
+
+    init_file_logging(LOG_LEVEL_INFO);
+    s_evaluations = 0;
+    LOG_DEBUG("Main", "debug %d", counted(1));
+    LOG_TRACE("Main", "trace %d", counted(2));
+    assert(s_evaluations == 0);
+    LOG_INFO("Main", "info %d", counted(3));
+    LOG_ERROR("Main", "error %d", counted(4));
+    assert(s_evaluations == 2);
+    assert(count_lines("info 3") == 1 && count_lines("error 4") == 1);
+
+    // The gate follows the level set at runtime
+    log_set_level(LOG_LEVEL_DEBUG);
+    LOG_DEBUG("Main", "debug %d", counted(5));
+    assert(s_evaluations == 3 && count_lines("debug 5") == 1);
+    log_set_level(LOG_LEVEL_WARN);
+    LOG_INFO("Main", "info %d", counted(6));
+    assert(s_evaluations == 3 && count_lines("info 6") == 0);
+
+    // The macros are expressions, so they also work in conditionals
+    int failed = 1;
+    failed ? LOG_ERROR("Main", "failed") : LOG_INFO("Main", "fine");
+    assert(count_lines("failed") == 1);
+
+    printf("Runtime gate test passed!\n\n");
+}
+
+static void test_module_levels() {
+    printf("Testing per-module levels through handles...\n");
+
+    init_file_logging(LOG_LEVEL_INFO);
+    assert(log_register_module(&s_vmLog) > 0);
+    assert(log_register_module(&s_schedulerLog) > 0);
+    assert(s_vmLog.id != s_schedulerLog.id);
+
+    s_evaluations = 0;
+    LOG_AT(LOG_LEVEL_DEBUG, s_vmLog, "vm step %d", counted(1));
+    assert(s_evaluations == 0);
+
+    // Only the VM module gets debug output
+    assert(log_set_module_level("VM", LOG_LEVEL_DEBUG) == 0);
+    assert(LOG_MODULE_ENABLED(s_vmLog, LOG_LEVEL_DEBUG));
+    assert(!LOG_MODULE_ENABLED(s_vmLog, LOG_LEVEL_TRACE));
+    assert(!LOG_MODULE_ENABLED(s_schedulerLog, LOG_LEVEL_DEBUG));
+    LOG_AT(LOG_LEVEL_DEBUG, s_vmLog, "vm step %d", counted(2));
+    LOG_AT(LOG_LEVEL_DEBUG, s_schedulerLog, "tick %d", counted(3));
+    assert(s_evaluations == 1);
+    assert(count_lines("[VM] vm step 2") == 1 && count_lines("tick 3") == 0);
+
+    // Plain module names follow the module level too
+    LOG_DEBUG("VM", "by name %d", 4);
+    LOG_DEBUG("Scheduler", "by name %d", 5);
+    assert(count_lines("by name 4") == 1 && count_lines("by name 5") == 0);
+
+    // A module can also be quieter than the global level
+    assert(log_set_module_level("Scheduler", LOG_LEVEL_ERROR) == 0);
+    LOG_AT(LOG_LEVEL_WARN, s_schedulerLog, "late %d", counted(6));
+    LOG_AT(LOG_LEVEL_ERROR, s_schedulerLog, "overrun %d", counted(7));
+    assert(s_evaluations == 2 && count_lines("overrun 7") == 1 && count_lines("late 6") == 0);
+    LOG_WARN("Scheduler", "late by name");
+    assert(count_lines("late by name") == 0);
+
+    // Queued messages are filtered the same way when the ring is drained
+    assert(log_set_async(16) == 0);
+    LOG_AT(LOG_LEVEL_DEBUG, s_vmLog, "queued %d", 8);
+    LOG_INFO("Scheduler", "queued %d", 9);
+    log_process(0);
+    assert(count_lines("queued 8") == 1 && count_lines("queued 9") == 0);
+    assert(log_set_async(0) == 0);
+
+    assert(log_clear_module_level("VM") == 0 && log_clear_module_level("Scheduler") == 0);
+    LOG_AT(LOG_LEVEL_DEBUG, s_vmLog, "vm step %d", counted(10));
+    LOG_AT(LOG_LEVEL_WARN, s_schedulerLog, "late %d", counted(11));
+    assert(s_evaluations == 3 && count_lines("late 11") == 1);
+
+    // A sink taking debug messages from one module opens only that module
+    LogModule unregistered = LOG_MODULE_INIT("Sensor");
+    int sink = log_add_sink(discard_sink, NULL, LOG_LEVEL_NONE, 0);
+    assert(sink >= 0);
+    assert(!LOG_MODULE_ENABLED(s_vmLog, LOG_LEVEL_DEBUG));
+    assert(log_set_sink_filter(sink, LOG_LEVEL_DEBUG, 1u << s_vmLog.id) == 0);
+    assert(LOG_MODULE_ENABLED(s_vmLog, LOG_LEVEL_DEBUG));
+    assert(!LOG_MODULE_ENABLED(s_schedulerLog, LOG_LEVEL_DEBUG));
+    // An unregistered handle cannot tell, so it lets the call through
+    assert(LOG_MODULE_ENABLED(unregistered, LOG_LEVEL_DEBUG));
+    assert(log_remove_sink(sink) == 0);
+
+    assert(log_set_module_level("", LOG_LEVEL_DEBUG) == -1);
+    assert(log_set_module_level("VM", (LogLevel)9) == -1);
+    assert(log_register_module(NULL) == -1);
+
+    printf("Module level test passed!\n\n");
+}
+
+static volatile int32_t s_output;
+
+// Exponential filter over sensor samples, the shape of a sensor processing loop
+#define FILTER_LOOP(LOG_STATEMENT) \
+    int32_t filtered = 0; \
+    for (int i = 0; i < count; i++) { \
+        int32_t sample = samples[i]; \
+        filtered += (sample - filtered) >> 3; \
+        LOG_STATEMENT; \
+    } \
+    s_output = filtered;
+
+// ===== Built with LOG_COMPILE_LEVEL below debug =====
+
+#undef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 3
+
+static void test_compiled_out() {
+    printf("Testing levels removed at compile time...\n");
+
+    init_file_logging(LOG_LEVEL_TRACE);
+    s_evaluations = 0;
+    LOG_DEBUG("Main", "compiled out %d", counted(1));
+    LOG_AT(LOG_LEVEL_TRACE, s_vmLog, "compiled out %d", counted(2));
+    LOG_INFO("Main", "still here %d", counted(3));
+    assert(s_evaluations == 1);
+    assert(count_lines("compiled out") == 0 && count_lines("still here 3") == 1);
+
+    printf("Compile-time gate test passed!\n\n");
+}
+
+static void loop_compiled_out(const int32_t* samples, int count) {
+    FILTER_LOOP(LOG_DEBUG("Sensor", "sample %d filtered %d", (int)sample, (int)filtered))
+}
+
+#undef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 5
+
+// ===== Benchmark =====
+
+static LogModule s_sensorLog = LOG_MODULE_INIT("Sensor");
+
+static void loop_plain(const int32_t* samples, int count) {
+    FILTER_LOOP((void)0)
+}
+
+static void loop_unchecked_call(const int32_t* samples, int count) {
+    FILTER_LOOP(log_message(LOG_LEVEL_DEBUG, "Sensor", "sample %d filtered %d", (int)sample, (int)filtered))
+}
+
+static void loop_named(const int32_t* samples, int count) {
+    FILTER_LOOP(LOG_DEBUG("Sensor", "sample %d filtered %d", (int)sample, (int)filtered))
+}
+
+static void loop_handle(const int32_t* samples, int count) {
+    FILTER_LOOP(LOG_AT(LOG_LEVEL_DEBUG, s_sensorLog, "sample %d filtered %d", (int)sample, (int)filtered))
+}
+
+static double bench_loop(void (*loop)(const int32_t*, int), const int32_t* samples, int count) {
+    double best = 1e9;
+    for (int round = 0; round < 5; round++) {
+        double start = now_seconds();
+        loop(samples, count);
+        double elapsed = now_seconds() - start;
+        best = elapsed < best ? elapsed : best;
+    }
+    return best / count * 1e9;
+}
+
+static void bench_disabled_debug() {
+    printf("Benchmarking a sensor loop with disabled debug logging...\n");
+
+    enum { SAMPLES = 1 << 20 };
+    int32_t* samples = (int32_t*)malloc(SAMPLES * sizeof(int32_t));
+    assert(samples != NULL);
+    for (int i = 0; i < SAMPLES; i++) {
+        samples[i] = (int32_t)((i * 2654435761u) >> 20);
+    }
+
+    init_file_logging(LOG_LEVEL_INFO);
+    log_register_module(&s_sensorLog);
+
+    double plain = bench_loop(loop_plain, samples, SAMPLES);
+    double unchecked = bench_loop(loop_unchecked_call, samples, SAMPLES);
+    double named = bench_loop(loop_named, samples, SAMPLES);
+    double handle = bench_loop(loop_handle, samples, SAMPLES);
+    double compiledOut = bench_loop(loop_compiled_out, samples, SAMPLES);
+    assert(count_lines("sample") == 0);
+
+    printf("  no logging:                     %5.2f ns per sample\n", plain);
+    printf("  log_message call, level off:    %5.2f ns per sample\n", unchecked);
+    printf("  LOG_DEBUG by name, level off:   %5.2f ns per sample\n", named);
+    printf("  LOG_AT with handle, level off:  %5.2f ns per sample\n", handle);
+    printf("  compiled out:                   %5.2f ns per sample\n", compiledOut);
+
+    free(samples);
+    printf("Benchmark complete!\n\n");
+}
+
+int main() {
+    printf("=== Log Level Gating Tests ===\n\n");
+
+    test_runtime_gate();
+    test_module_levels();
+    test_compiled_out();
+    bench_disabled_debug();
+
+    log_deinit();
+    remove(LOG_FILE);
+    printf("All log level gating tests passed!\n");
+    return 0;
+}
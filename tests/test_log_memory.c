@@ -0,0 +1,309 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "../src/system/logging.h"
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Store only, no console output
+static void init_memory_logging(LogLevel level, uint32_t entries) {
+    LogConfig config;
+    memset(&config, 0, sizeof(config));
+    config.level = level;
+    config.outputs = LOG_OUTPUT_MEMORY;
+    config.maxMemoryEntries = entries;
+    config.includeTimestamp = false;
+    config.colorOutput = true;
+    assert(log_init(&config) == 0);
+    log_clear_memory_entries();
+}
+
+static LogStats get_stats(void) {
+    LogStats stats;
+    log_get_stats(&stats);
+    return stats;
+}
+
+static void test_cursor_reads() {
+    printf("Testing cursor reads and level filters...\n");
+
+    init_memory_logging(LOG_LEVEL_DEBUG, 16);
+    uint32_t start = get_stats().memoryNextSequence;
+    LOG_INFO("Main", "hello %d", 1);
+    LOG_ERROR("Storage", "write failed");
+    LOG_DEBUG(NULL, "no module");
+    LOG_TRACE("Main", "not taken by the console");
+    assert(log_get_memory_entry_count() == 3);
+
+    char buffer[512];
+    uint32_t cursor = 0;
+    assert(log_read_memory_entries(&cursor, LOG_LEVEL_TRACE, buffer, sizeof(buffer)) == 3);
+    assert(strcmp(buffer, "[INFO] [Main] hello 1\n[ERROR] [Storage] write failed\n[DEBUG] no module\n") == 0);
+    assert(cursor == start + 3);
+
+    // Nothing new since the cursor
+    assert(log_read_memory_entries(&cursor, LOG_LEVEL_TRACE, buffer, sizeof(buffer)) == 0);
+    assert(buffer[0] == '\0' && cursor == start + 3);
+
+    LOG_WARN("Main", "only the new %s", "ones");
+    LOG_INFO("Main", "second new");
+    assert(log_read_memory_entries(&cursor, LOG_LEVEL_TRACE, buffer, sizeof(buffer)) == 2);
+    assert(strcmp(buffer, "[WARN] [Main] only the new ones\n[INFO] [Main] second new\n") == 0);
+    assert(cursor == start + 5);
+
+    // A level filter skips records but the cursor passes them
+    cursor = start;
+    assert(log_read_memory_entries(&cursor, LOG_LEVEL_WARN, buffer, sizeof(buffer)) == 2);
+    assert(strcmp(buffer, "[ERROR] [Storage] write failed\n[WARN] [Main] only the new ones\n") == 0);
+    assert(cursor == start + 5);
+
+    // A small buffer takes whole lines and the next call continues
+    char small[40];
+    cursor = start;
+    assert(log_read_memory_entries(&cursor, LOG_LEVEL_TRACE, small, sizeof(small)) == 1);
+    assert(strcmp(small, "[INFO] [Main] hello 1\n") == 0 && cursor == start + 1);
+    assert(log_read_memory_entries(&cursor, LOG_LEVEL_TRACE, small, sizeof(small)) == 1);
+    assert(strcmp(small, "[ERROR] [Storage] write failed\n") == 0);
+
+    // A line longer than the buffer is cut rather than blocking the cursor
+    char tiny[12];
+    assert(log_read_memory_entries(&cursor, LOG_LEVEL_TRACE, tiny, sizeof(tiny)) == 1);
+    assert(strcmp(tiny, "[DEBUG] no\n") == 0 && cursor == start + 3);
+
+    assert(log_get_memory_entries(buffer, sizeof(buffer)) == (int)strlen(buffer));
+    assert(strncmp(buffer, "[INFO] [Main] hello 1\n", 22) == 0);
+
+    // Clearing keeps the numbering, so cursors stay valid
+    assert(log_clear_memory_entries() == 5);
+    assert(log_get_memory_entry_count() == 0);
+    LOG_INFO("Main", "after clear");
+    cursor = start + 3;
+    assert(log_read_memory_entries(&cursor, LOG_LEVEL_TRACE, buffer, sizeof(buffer)) == 1);
+    assert(strcmp(buffer, "[INFO] [Main] after clear\n") == 0 && cursor == start + 6);
+
+    assert(log_read_memory_entries(NULL, LOG_LEVEL_TRACE, buffer, sizeof(buffer)) == -1);
+    assert(log_read_memory_entries(&cursor, LOG_LEVEL_TRACE, buffer, 1) == -1);
+
+    printf("Cursor read test passed!\n\n");
+}
+
+// ===== Wraparound =====
+
+// Message of a sequence number, with a length that varies from record to record
+static void expected_message(uint32_t sequence, char* text, size_t size) {
+    int padding = (int)((sequence * 2654435761u) >> 24) % 120;
+    snprintf(text, size, "message %lu %.*s", (unsigned long)sequence, padding,
+             "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz"
+             "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz");
+}
+
+// Check that a read from a cursor returns exactly the expected messages in order
+static void check_read(uint32_t cursor, uint32_t first, uint32_t next, size_t bufferSize) {
+    char* buffer = (char*)malloc(bufferSize);
+    uint32_t expected = cursor < first ? first : cursor;
+    while (expected < next) {
+        int copied = log_read_memory_entries(&cursor, LOG_LEVEL_TRACE, buffer, bufferSize);
+        assert(copied > 0);
+        char* line = buffer;
+        for (int i = 0; i < copied; i++) {
+            char text[200];
+            char wanted[220];
+            expected_message(expected, text, sizeof(text));
+            snprintf(wanted, sizeof(wanted), "[INFO] [Wrap] %s\n", text);
+            assert(strncmp(line, wanted, strlen(wanted)) == 0);
+            line += strlen(wanted);
+            expected++;
+        }
+        assert(*line == '\0' && cursor == expected);
+    }
+    assert(log_read_memory_entries(&cursor, LOG_LEVEL_TRACE, buffer, bufferSize) == 0);
+    free(buffer);
+}
+
+static void test_wraparound() {
+    printf("Testing wraparound with variable-length records...\n");
+
+    init_memory_logging(LOG_LEVEL_INFO, 64);
+    LogStats stats = get_stats();
+    uint32_t capacity = stats.memoryBytes;
+    uint32_t base = stats.memoryNextSequence;
+    assert(capacity >= 4096);
+
+    char text[200];
+    for (uint32_t written = 0; written < 5000; written++) {
+        uint32_t sequence = base + written;
+        expected_message(sequence, text, sizeof(text));
+        LOG_INFO("Wrap", "%s", text);
+
+        stats = get_stats();
+        assert(stats.memoryNextSequence == sequence + 1);
+        assert(log_get_memory_entry_count() == (int)(stats.memoryNextSequence - stats.memoryFirstSequence));
+
+        // Check whole reads and reads from cursors landing on and between checkpoints
+        if (written % 97 == 0 || written == 4999) {
+            uint32_t first = stats.memoryFirstSequence;
+            uint32_t next = stats.memoryNextSequence;
+            check_read(0, first, next, 1 << 16);
+            for (uint32_t cursor = first; cursor < next; cursor += 7) {
+                check_read(cursor, first, next, 300);
+            }
+        }
+    }
+
+    // The store wrapped many times and keeps about as much as fits
+    stats = get_stats();
+    uint32_t kept = stats.memoryNextSequence - stats.memoryFirstSequence;
+    assert(stats.memoryFirstSequence > base + 1000);
+    assert(kept * (16 + 16 + 120) > capacity / 2 && kept * 16 < capacity);
+
+    // A reader that fell behind resumes at the oldest message kept
+    check_read(base, stats.memoryFirstSequence, stats.memoryNextSequence, 4096);
+
+    printf("Wraparound test passed!\n\n");
+}
+
+static void test_outputs_and_async() {
+    printf("Testing memory output from asynchronous mode and log_set_outputs...\n");
+
+    LogConfig config;
+    memset(&config, 0, sizeof(config));
+    config.level = LOG_LEVEL_NONE;
+    config.outputs = LOG_OUTPUT_NONE;
+    assert(log_init(&config) == 0);
+    log_deinit();
+    assert(get_stats().memoryBytes == 0);
+    assert(log_get_memory_entry_count() == 0);
+
+    // Turning the memory output on at runtime allocates the store
+    log_set_level(LOG_LEVEL_INFO);
+    log_set_outputs(LOG_OUTPUT_MEMORY);
+    assert(get_stats().memoryBytes > 0);
+    uint32_t cursor = get_stats().memoryNextSequence;
+    LOG_INFO("Main", "stored %d", 1);
+
+    // Queued messages are stored when the ring is drained, with the module name
+    assert(log_set_async(16) == 0);
+    log_set_deferred(true);
+    LOG_WARN("Queue", "deferred %s %d", "value", 2);
+    assert(log_get_memory_entry_count() == 1);
+    assert(log_process(0) == 1);
+    log_set_deferred(false);
+    assert(log_set_async(0) == 0);
+
+    char buffer[256];
+    assert(log_read_memory_entries(&cursor, LOG_LEVEL_TRACE, buffer, sizeof(buffer)) == 2);
+    assert(strcmp(buffer, "[INFO] [Main] stored 1\n[WARN] [Queue] deferred value 2\n") == 0);
+
+    // Messages longer than half the store are cut to fit
+    char longText[3000];
+    memset(longText, 'x', sizeof(longText) - 1);
+    longText[sizeof(longText) - 1] = '\0';
+    init_memory_logging(LOG_LEVEL_INFO, 16);
+    LOG_INFO("Main", "%s", longText);
+    LOG_INFO("Main", "after long");
+    char* all = (char*)malloc(1 << 14);
+    assert(log_get_memory_entries(all, 1 << 14) > 0);
+    assert(strstr(all, "[INFO] [Main] xxxx") == all && strstr(all, "after long\n") != NULL);
+    assert(strlen(all) < get_stats().memoryBytes);
+    free(all);
+
+    log_set_level(LOG_LEVEL_NONE);
+    log_set_outputs(LOG_OUTPUT_NONE);
+    LOG_ERROR("Main", "memory output off");
+    assert(log_get_memory_entry_count() == 2);
+
+    printf("Output test passed!\n\n");
+}
+
+// ===== Benchmark =====
+
+static void bench_memory_store() {
+    printf("Benchmarking appends and retrieval...\n");
+
+    enum { MESSAGES = 200000 };
+    init_memory_logging(LOG_LEVEL_INFO, 1024);
+    uint32_t capacity = get_stats().memoryBytes;
+
+    double start = now_seconds();
+    for (int i = 0; i < MESSAGES; i++) {
+        log_message(LOG_LEVEL_INFO, "Sensor", "sensor %s read %d in %u us", "temp-1", i, (unsigned)(i * 3));
+    }
+    double append = (now_seconds() - start) / MESSAGES * 1e9;
+
+    // The same messages written as lines to a file instead
+    LogConfig config;
+    memset(&config, 0, sizeof(config));
+    config.level = LOG_LEVEL_INFO;
+    config.outputs = LOG_OUTPUT_FILE;
+    config.logFileName = "/dev/null";
+    assert(log_init(&config) == 0);
+    start = now_seconds();
+    for (int i = 0; i < MESSAGES; i++) {
+        log_message(LOG_LEVEL_INFO, "Sensor", "sensor %s read %d in %u us", "temp-1", i, (unsigned)(i * 3));
+    }
+    double fileLine = (now_seconds() - start) / MESSAGES * 1e9;
+    log_set_outputs(LOG_OUTPUT_MEMORY);
+
+    // Read the whole store
+    size_t bufferSize = (size_t)capacity * 2;
+    char* buffer = (char*)malloc(bufferSize);
+    LogStats stats = get_stats();
+    uint32_t kept = stats.memoryNextSequence - stats.memoryFirstSequence;
+    int rounds = 20;
+    size_t bytes = 0;
+    start = now_seconds();
+    for (int round = 0; round < rounds; round++) {
+        uint32_t cursor = 0;
+        assert(log_read_memory_entries(&cursor, LOG_LEVEL_TRACE, buffer, bufferSize) == (int)kept);
+        bytes += strlen(buffer);
+    }
+    double fullRead = (now_seconds() - start) / rounds;
+
+    // Poll for the last 10 messages; the cost does not depend on the store size
+    int polls = 20000;
+    start = now_seconds();
+    for (int i = 0; i < polls; i++) {
+        uint32_t cursor = stats.memoryNextSequence - 10;
+        assert(log_read_memory_entries(&cursor, LOG_LEVEL_TRACE, buffer, bufferSize) == 10);
+    }
+    double tailRead = (now_seconds() - start) / polls * 1e6;
+
+    // A level filter that matches nothing only walks the records
+    start = now_seconds();
+    for (int round = 0; round < rounds; round++) {
+        uint32_t cursor = 0;
+        assert(log_read_memory_entries(&cursor, LOG_LEVEL_ERROR, buffer, bufferSize) == 0);
+    }
+    double filteredRead = (now_seconds() - start) / rounds;
+
+    printf("  store of %u KB keeps %u messages\n", capacity / 1024, kept);
+    printf("  log_message, memory output:     %6.0f ns per message\n", append);
+    printf("  log_message, file output:       %6.0f ns per message (/dev/null)\n", fileLine);
+    printf("  read whole store:               %6.1f M messages/s, %5.0f MB/s of text\n",
+           kept / fullRead / 1e6, bytes / rounds / fullRead / 1e6);
+    printf("  read last 10 messages:          %6.2f us per call\n", tailRead);
+    printf("  walk store, nothing matches:    %6.1f ns per record\n", filteredRead / kept * 1e9);
+
+    free(buffer);
+    printf("Benchmark complete!\n\n");
+}
+
+int main() {
+    printf("=== In-Memory Log Store Tests ===\n\n");
+
+    test_cursor_reads();
+    test_wraparound();
+    test_outputs_and_async();
+    bench_memory_store();
+
+    log_deinit();
+    printf("All in-memory log store tests passed!\n");
+    return 0;
+}
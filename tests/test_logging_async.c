@@ -0,0 +1,470 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "../src/system/logging.h"
+
+#define LOG_FILE "build/test_logging_async.log"
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void init_file_logging(bool timestamps) {
+    LogConfig config;
+    memset(&config, 0, sizeof(config));
+    config.level = LOG_LEVEL_DEBUG;
+    config.outputs = LOG_OUTPUT_FILE;
+    config.logFileName = LOG_FILE;
+    config.includeTimestamp = timestamps;
+    config.colorOutput = false;
+
+    remove(LOG_FILE);
+    assert(log_init(&config) == 0);
+}
+
+// Read the log file back, one line per entry
+static int read_lines(char*** lines) {
+    FILE* file = fopen(LOG_FILE, "r");
+    assert(file != NULL);
+    int count = 0;
+    int capacity = 64;
+    *lines = (char**)malloc(capacity * sizeof(char*));
+    char line[1300];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (count == capacity) {
+            capacity *= 2;
+            *lines = (char**)realloc(*lines, capacity * sizeof(char*));
+        }
+        line[strcspn(line, "\n")] = '\0';
+        (*lines)[count++] = strdup(line);
+    }
+    fclose(file);
+    return count;
+}
+
+static void free_lines(char** lines, int count) {
+    for (int i = 0; i < count; i++) {
+        free(lines[i]);
+    }
+    free(lines);
+}
+
+static void test_async_matches_sync() {
+    printf("Testing asynchronous output matches synchronous output...\n");
+
+    // Same lines whether formatted by the caller or by the sink
+    init_file_logging(false);
+    LOG_INFO("Main", "value %d of %s", 42, "sensor");
+    LOG_WARN("", "no module");
+    LOG_DEBUG("ModuleNameLongerThanSlot", "long module");
+    LOG_TRACE("Main", "filtered out");
+    log_flush();
+
+    assert(log_set_async(8) == 0);
+    LOG_INFO("Main", "value %d of %s", 42, "sensor");
+    LOG_WARN("", "no module");
+    LOG_DEBUG("ModuleNameLongerThanSlot", "long module");
+    LOG_TRACE("Main", "filtered out");
+
+    // Nothing reaches the file until the sink runs
+    char** lines;
+    int count = read_lines(&lines);
+    assert(count == 3);
+    free_lines(lines, count);
+
+    assert(log_process(2) == 2);
+    assert(log_process(0) == 1);
+    assert(log_process(0) == 0);
+    log_flush();
+
+    count = read_lines(&lines);
+    assert(count == 6);
+    assert(strcmp(lines[0], "[INFO] [Main] value 42 of sensor") == 0);
+    assert(strcmp(lines[1], "[WARN] no module") == 0);
+    for (int i = 0; i < 3; i++) {
+        assert(strcmp(lines[i], lines[i + 3]) == 0);
+    }
+    assert(strcmp(lines[5], "[DEBUG] [ModuleNameLongerThanSlot] long module") == 0);
+    free_lines(lines, count);
+
+    LogStats stats;
+    log_get_stats(&stats);
+    assert(stats.recordsQueued == 3 && stats.recordsWritten == 3 && stats.queueEntries == 8);
+    assert(stats.recordsDropped == 0 && stats.recordsTruncated == 0);
+    assert(log_deinit() == 0);
+
+    printf("Async output test passed!\n\n");
+}
+
+static void test_overflow_and_truncation() {
+    printf("Testing ring overflow and message truncation...\n");
+
+    init_file_logging(true);
+    assert(log_set_async(5) == 0);
+
+    LogStats stats;
+    log_get_stats(&stats);
+    assert(stats.queueEntries == 8);
+
+    // No sink running: the ring fills and the rest is counted
+    for (int i = 0; i < 20; i++) {
+        LOG_INFO("Main", "message %d", i);
+    }
+    log_get_stats(&stats);
+    assert(stats.recordsQueued == 8 && stats.recordsDropped == 12);
+
+    char longText[600];
+    memset(longText, 'x', sizeof(longText) - 1);
+    longText[sizeof(longText) - 1] = '\0';
+    assert(log_process(0) == 8);
+    LOG_ERROR("Main", "%s", longText);
+    assert(log_process(0) == 1);
+    log_flush();
+
+    log_get_stats(&stats);
+    assert(stats.recordsWritten == 9 && stats.recordsTruncated == 1);
+
+    // Queued messages in order, the drop notice, then the cut message on one line
+    char** lines;
+    int count = read_lines(&lines);
+    assert(count == 10);
+    for (int i = 0; i < 8; i++) {
+        char expected[32];
+        snprintf(expected, sizeof(expected), "[INFO] [Main] message %d", i);
+        assert(lines[i][0] == '[' && strstr(lines[i], expected) != NULL);
+    }
+    assert(strstr(lines[8], "[WARN] [log] 12 messages dropped") != NULL);
+    assert(strstr(lines[9], "[ERROR] [Main] xxx") != NULL && strlen(lines[9]) < 300);
+    free_lines(lines, count);
+
+    // Going back to synchronous mode drains what is left
+    LOG_INFO("Main", "last queued");
+    assert(log_set_async(0) == 0);
+    LOG_INFO("Main", "synchronous");
+    log_flush();
+    count = read_lines(&lines);
+    assert(count == 12);
+    assert(strstr(lines[10], "last queued") != NULL && strstr(lines[11], "synchronous") != NULL);
+    free_lines(lines, count);
+    assert(log_deinit() == 0);
+
+    printf("Overflow test passed!\n\n");
+}
+
+// Log the same calls in every mode; the caller's buffer changes after each call
+static void log_format_samples(char* buffer) {
+    strcpy(buffer, "sensor-1");
+    LOG_INFO("Main", "int %d %i %u %x %X %o %c", -42, 7, 3000000000u, 0xbeef, 0xbeef, 8, 'z');
+    LOG_INFO("Main", "width [%5d] [%-5d] [%05d] [%+d] [% d] [%#x]", 42, 42, 42, 42, 42, 255);
+    LOG_INFO("Main", "float %.2f %8.3f %-8.1e| %g %G %a %Lf", 3.14159, -2.5, 12345.678, 0.0001, 1e20, 1.0, (long double)2.5);
+    LOG_INFO("Main", "string [%s] [%10s] [%-10s] [%.3s] [%s]", buffer, "ab", "ab", "abcdef", (const char*)NULL);
+    LOG_INFO("Main", "star [%*d] [%-*d] [%.*s] [%*.*f] [%.*s]", 6, 1, 6, 2, 2, "xyz", 8, 2, 1.5, -1, "all");
+    LOG_INFO("Main", "length %hhd %hd %ld %lld %lu %llu %zu %jd %td", (char)-1, (short)-2, -3L, -4LL, 5UL, 6ULL,
+             (size_t)7, (intmax_t)-8, (ptrdiff_t)9);
+    LOG_INFO("Main", "percent 100%% and %d%%", 50);
+    LOG_INFO("Main", "no arguments");
+    buffer[0] = 'X';
+
+    // Does not fit a slot: formatted by the caller instead
+    char longText[300];
+    memset(longText, 'y', sizeof(longText) - 1);
+    longText[sizeof(longText) - 1] = '\0';
+    LOG_INFO("Main", "long %s", longText);
+}
+
+static void test_deferred_formatting() {
+    printf("Testing deferred formatting by the sink...\n");
+
+    char buffer[16];
+    init_file_logging(false);
+    log_format_samples(buffer);
+    log_flush();
+    char** expected;
+    int expectedCount = read_lines(&expected);
+    assert(expectedCount == 9);
+
+    assert(log_set_async(16) == 0);
+    assert(log_set_deferred(true) == false);
+    log_format_samples(buffer);
+    assert(log_process(0) == 9);
+    log_flush();
+
+    // Identical to the lines the caller formatted, truncation aside
+    char** lines;
+    int count = read_lines(&lines);
+    assert(count == 18);
+    for (int i = 0; i < 8; i++) {
+        if (strcmp(lines[i], lines[i + 9]) != 0) {
+            printf("  mismatch: \"%s\" vs \"%s\"\n", lines[i], lines[i + 9]);
+        }
+        assert(strcmp(lines[i], lines[i + 9]) == 0);
+    }
+    assert(strstr(lines[3], "[sensor-1]") != NULL);
+    assert(strncmp(lines[17], "[INFO] [Main] long yyy", 22) == 0);
+    free_lines(lines, count);
+    free_lines(expected, expectedCount);
+
+    // Only the long message was formatted, and cut, at the call site
+    LogStats stats;
+    log_get_stats(&stats);
+    assert(stats.recordsTruncated == 1);
+    assert(log_set_deferred(false) == true);
+    assert(log_deinit() == 0);
+
+    printf("Deferred formatting test passed!\n\n");
+}
+
+// ===== Concurrent callers and a sink thread =====
+
+static volatile bool s_sinkRunning = false;
+
+static void* sink_thread(void* param) {
+    (void)param;
+    while (__atomic_load_n(&s_sinkRunning, __ATOMIC_ACQUIRE)) {
+        if (log_process(256) == 0) {
+            sched_yield();
+        }
+    }
+    log_process(0);
+    return NULL;
+}
+
+typedef struct {
+    int id;
+    int messages;
+    bool sampleLatency;
+    double* latencies;
+} ProducerArgs;
+
+static void* producer_thread(void* param) {
+    ProducerArgs* args = (ProducerArgs*)param;
+    for (int i = 0; i < args->messages; i++) {
+        if (args->sampleLatency) {
+            double start = now_seconds();
+            LOG_INFO("Bench", "producer %d message %d reading %.2f", args->id, i, i * 0.5);
+            args->latencies[i] = now_seconds() - start;
+        } else {
+            // Give the sink a turn now and then so most messages get through
+            LOG_INFO("Bench", "producer %d message %d reading %.2f", args->id, i, i * 0.5);
+            if (i % 64 == 63) {
+                sched_yield();
+            }
+        }
+    }
+    return NULL;
+}
+
+static void test_concurrent_producers() {
+    printf("Testing concurrent callers with a sink thread...\n");
+
+    enum { PRODUCERS = 4, MESSAGES = 20000 };
+    init_file_logging(false);
+    assert(log_set_async(1024) == 0);
+
+    __atomic_store_n(&s_sinkRunning, true, __ATOMIC_RELEASE);
+    pthread_t sink;
+    pthread_create(&sink, NULL, sink_thread, NULL);
+
+    pthread_t threads[PRODUCERS];
+    ProducerArgs args[PRODUCERS];
+    for (int p = 0; p < PRODUCERS; p++) {
+        args[p].id = p;
+        args[p].messages = MESSAGES;
+        args[p].sampleLatency = false;
+        args[p].latencies = NULL;
+        pthread_create(&threads[p], NULL, producer_thread, &args[p]);
+    }
+    for (int p = 0; p < PRODUCERS; p++) {
+        pthread_join(threads[p], NULL);
+    }
+    __atomic_store_n(&s_sinkRunning, false, __ATOMIC_RELEASE);
+    pthread_join(sink, NULL);
+    log_flush();
+
+    LogStats stats;
+    log_get_stats(&stats);
+    assert(stats.recordsQueued + stats.recordsDropped == PRODUCERS * MESSAGES);
+    assert(stats.recordsWritten == stats.recordsQueued);
+
+    // Every line is whole and each producer's messages keep their order
+    char** lines;
+    int count = read_lines(&lines);
+    int last[PRODUCERS];
+    int seen = 0;
+    for (int p = 0; p < PRODUCERS; p++) {
+        last[p] = -1;
+    }
+    for (int i = 0; i < count; i++) {
+        int producer;
+        int message;
+        float reading;
+        if (sscanf(lines[i], "[INFO] [Bench] producer %d message %d reading %f", &producer, &message, &reading) == 3) {
+            assert(producer >= 0 && producer < PRODUCERS);
+            assert(message > last[producer] && reading == message * 0.5f);
+            last[producer] = message;
+            seen++;
+        } else {
+            assert(strstr(lines[i], "[WARN] [log]") != NULL && strstr(lines[i], "messages dropped") != NULL);
+        }
+    }
+    assert(seen == (int)stats.recordsQueued);
+    free_lines(lines, count);
+
+    printf("  %d messages from %d threads: %u written, %u dropped, %u batches\n",
+           PRODUCERS * MESSAGES, PRODUCERS, stats.recordsWritten, stats.recordsDropped, stats.batchesWritten);
+    assert(log_deinit() == 0);
+
+    printf("Concurrent producer test passed!\n\n");
+}
+
+// ===== Benchmark =====
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static void bench_mode(const char* name, uint32_t queueEntries, int producers) {
+    enum { MESSAGES = 50000 };
+    init_file_logging(true);
+    assert(log_set_async(queueEntries) == 0);
+
+    pthread_t sink;
+    if (queueEntries > 0) {
+        __atomic_store_n(&s_sinkRunning, true, __ATOMIC_RELEASE);
+        pthread_create(&sink, NULL, sink_thread, NULL);
+    }
+
+    pthread_t threads[4];
+    ProducerArgs args[4];
+    double* latencies = (double*)malloc(sizeof(double) * MESSAGES * producers);
+    double start = now_seconds();
+    for (int p = 0; p < producers; p++) {
+        args[p].id = p;
+        args[p].messages = MESSAGES;
+        args[p].sampleLatency = true;
+        args[p].latencies = latencies + p * MESSAGES;
+        pthread_create(&threads[p], NULL, producer_thread, &args[p]);
+    }
+    for (int p = 0; p < producers; p++) {
+        pthread_join(threads[p], NULL);
+    }
+    double callerSeconds = now_seconds() - start;
+
+    if (queueEntries > 0) {
+        __atomic_store_n(&s_sinkRunning, false, __ATOMIC_RELEASE);
+        pthread_join(sink, NULL);
+    }
+    log_flush();
+    double totalSeconds = now_seconds() - start;
+
+    int total = MESSAGES * producers;
+    qsort(latencies, total, sizeof(double), compare_doubles);
+    double sum = 0;
+    for (int i = 0; i < total; i++) {
+        sum += latencies[i];
+    }
+    LogStats stats;
+    log_get_stats(&stats);
+    printf("  %-22s %d thread%s: call mean %6.0f ns, p99 %6.0f ns; %5.2f M msg/s to callers, %5.2f M msg/s written",
+           name, producers, producers > 1 ? "s" : " ", sum / total * 1e9, latencies[total * 99 / 100] * 1e9,
+           total / callerSeconds / 1e6, (queueEntries > 0 ? stats.recordsWritten : (uint32_t)total) / totalSeconds / 1e6);
+    if (queueEntries > 0) {
+        printf(", %u dropped", stats.recordsDropped);
+    }
+    printf("\n");
+
+    free(latencies);
+    assert(log_deinit() == 0);
+}
+
+// Log calls shaped like the ones in the tree
+static void log_realistic(int i) {
+    switch (i & 3) {
+        case 0:
+            LOG_INFO("Sensor", "sensor %s read %d in %u us", "temp-1", i, (unsigned)(i * 3));
+            break;
+        case 1:
+            LOG_DEBUG("BYTECODE", "Executing opcode %d at pc %d, stack depth %d", i & 31, i, 4);
+            break;
+        case 2:
+            LOG_WARN("Storage", "Compacting segment %u: %zu of %zu bytes live", (unsigned)i, (size_t)812, (size_t)4096);
+            break;
+        default:
+            LOG_INFO("Main", "Temperature %.2f C, humidity %.1f%%", 21.5 + i * 0.01, 40.0);
+            break;
+    }
+}
+
+static void bench_format_mode(const char* name, bool async, bool deferred) {
+    enum { CHUNK = 4096, MESSAGES = 48 * CHUNK };
+    init_file_logging(true);
+    assert(log_set_async(async ? CHUNK : 0) == 0);
+    log_set_deferred(deferred);
+
+    // Callers alone: the ring is drained between chunks, outside the timing
+    double callerSeconds = 0;
+    double sinkSeconds = 0;
+    for (int done = 0; done < MESSAGES; done += CHUNK) {
+        double start = now_seconds();
+        for (int i = done; i < done + CHUNK; i++) {
+            log_realistic(i);
+        }
+        double middle = now_seconds();
+        log_process(0);
+        callerSeconds += middle - start;
+        sinkSeconds += now_seconds() - middle;
+    }
+    log_flush();
+
+    LogStats stats;
+    log_get_stats(&stats);
+    printf("  %-22s %6.2f M calls/s", name, MESSAGES / callerSeconds / 1e6);
+    if (async) {
+        assert(stats.recordsWritten == MESSAGES && stats.recordsDropped == 0);
+        printf(", sink %5.2f M msg/s, %5.1f bytes/record", MESSAGES / sinkSeconds / 1e6,
+               (double)stats.recordBytes / stats.recordsWritten);
+    }
+    printf("\n");
+
+    log_set_deferred(false);
+    assert(log_deinit() == 0);
+}
+
+static void bench_logging() {
+    printf("Benchmarking caller latency and throughput with the sink writing to a file...\n");
+
+    bench_mode("synchronous", 0, 1);
+    bench_mode("async, 4096 slots", 4096, 1);
+    bench_mode("synchronous", 0, 4);
+    bench_mode("async, 4096 slots", 4096, 4);
+
+    printf("Comparing text and deferred records on typical formats, one thread...\n");
+    bench_format_mode("synchronous", false, false);
+    bench_format_mode("async text", true, false);
+    bench_format_mode("async deferred", true, true);
+
+    printf("Benchmark complete!\n\n");
+}
+
+int main() {
+    printf("=== Asynchronous Logging Tests ===\n\n");
+
+    test_async_matches_sync();
+    test_overflow_and_truncation();
+    test_deferred_formatting();
+    test_concurrent_producers();
+    bench_logging();
+
+    remove(LOG_FILE);
+    printf("All asynchronous logging tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,302 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "../src/core/mcp/logging/mcp_logging.h"
+#include "../src/system/logging.h"
+
+// Host build of the bridge provides a stand-in server
+struct MCP_Server* MCP_GetServer(void);
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// ===== Subscribed session =====
+
+// Stands in for the transport: keeps the last event sent to subscribers
+static char s_lastEvent[1024];
+static int s_eventCount = 0;
+
+int MCP_ServerSendEvent(const char* eventType, const uint8_t* eventData, size_t eventDataLength) {
+    assert(strcmp(eventType, MCP_EVENT_TYPE_LOG) == 0);
+    assert(eventDataLength < sizeof(s_lastEvent));
+    memcpy(s_lastEvent, eventData, eventDataLength);
+    s_lastEvent[eventDataLength] = '\0';
+    s_eventCount++;
+    return 0;
+}
+
+// ===== Capturing sink =====
+
+typedef struct {
+    int count;
+    LogLevel level;
+    int moduleId;
+    char module[32];
+    char message[256];
+} Capture;
+
+static void capture_sink(const LogEntry* entry, void* context) {
+    Capture* capture = (Capture*)context;
+    capture->count++;
+    capture->level = entry->level;
+    capture->moduleId = entry->moduleId;
+    snprintf(capture->module, sizeof(capture->module), "%s", entry->module);
+    snprintf(capture->message, sizeof(capture->message), "%s", entry->message);
+    assert(strlen(entry->message) == entry->messageLength);
+}
+
+// Console output off, so only the sinks see messages
+static void init_quiet_logging(void) {
+    LogConfig config;
+    memset(&config, 0, sizeof(config));
+    config.level = LOG_LEVEL_NONE;
+    assert(log_init(&config) == 0);
+}
+
+static void test_module_ids() {
+    printf("Testing module interning...\n");
+
+    char copy[16];
+    strcpy(copy, "Storage");
+    int storage = log_module_id("Storage");
+    assert(storage > 0);
+    assert(log_module_id("Storage") == storage);
+    assert(log_module_id(copy) == storage);
+    assert(strcmp(log_module_name(storage), "Storage") == 0);
+
+    // A reused buffer holding another name gets that name's ID
+    strcpy(copy, "Sensor");
+    int sensor = log_module_id(copy);
+    assert(sensor > 0 && sensor != storage);
+    assert(log_module_id("Sensor") == sensor && log_module_id(copy) == sensor);
+
+    assert(log_module_id(NULL) == 0 && log_module_id("") == 0);
+    assert(strcmp(log_module_name(0), "") == 0 && strcmp(log_module_name(LOG_MAX_MODULES), "") == 0);
+
+    printf("Module interning test passed!\n\n");
+}
+
+static void test_sink_filters() {
+    printf("Testing sink level and module filters...\n");
+
+    init_quiet_logging();
+    Capture all;
+    Capture storage;
+    memset(&all, 0, sizeof(all));
+    memset(&storage, 0, sizeof(storage));
+    int storageId = log_module_id("Storage");
+    int allSink = log_add_sink(capture_sink, &all, LOG_LEVEL_DEBUG, LOG_ALL_MODULES);
+    int storageSink = log_add_sink(capture_sink, &storage, LOG_LEVEL_WARN, 1u << storageId);
+    assert(allSink >= 0 && storageSink >= 0 && allSink != storageSink);
+
+    LOG_INFO("Storage", "mounted %d segments", 8);
+    assert(all.count == 1 && storage.count == 0);
+    assert(all.level == LOG_LEVEL_INFO && all.moduleId == storageId);
+    assert(strcmp(all.module, "Storage") == 0 && strcmp(all.message, "mounted 8 segments") == 0);
+
+    LOG_ERROR("Storage", "write failed at %u", 4096u);
+    assert(all.count == 2 && storage.count == 1);
+    assert(strcmp(storage.message, "write failed at 4096") == 0);
+
+    LOG_ERROR("Sensor", "no reading");
+    LOG_TRACE("Storage", "too verbose for either");
+    assert(all.count == 3 && storage.count == 1);
+
+    // Messages without a module have ID 0
+    LOG_WARN(NULL, "bare");
+    assert(all.count == 4 && all.moduleId == 0 && strcmp(all.module, "") == 0);
+
+    // Asynchronous mode hands the entries over when the ring is drained
+    assert(log_set_async(16) == 0);
+    log_set_deferred(true);
+    LOG_ERROR("Storage", "queued %s %d", "entry", 2);
+    assert(all.count == 4 && storage.count == 1);
+    assert(log_process(0) == 1);
+    assert(all.count == 5 && storage.count == 2);
+    assert(strcmp(storage.message, "queued entry 2") == 0 && strcmp(storage.module, "Storage") == 0);
+    log_set_deferred(false);
+    assert(log_set_async(0) == 0);
+
+    assert(log_set_sink_filter(allSink, LOG_LEVEL_NONE, LOG_ALL_MODULES) == 0);
+    LOG_ERROR("Storage", "only one sink");
+    assert(all.count == 5 && storage.count == 3);
+
+    assert(log_remove_sink(allSink) == 0 && log_remove_sink(storageSink) == 0);
+    assert(log_remove_sink(storageSink) == -1 && log_set_sink_filter(storageSink, LOG_LEVEL_INFO, 0) == -1);
+    LOG_ERROR("Storage", "no sinks");
+    assert(storage.count == 3);
+
+    printf("Sink filter test passed!\n\n");
+}
+
+static void test_bridge_events() {
+    printf("Testing log events sent to subscribers...\n");
+
+    init_quiet_logging();
+    assert(MCP_LoggingInit(MCP_GetServer(), LOG_LEVEL_INFO) == 0);
+    s_eventCount = 0;
+
+    LOG_INFO("Main", "value \"%d\"\n\tend \\", 5);
+    assert(s_eventCount == 1);
+    assert(strcmp(s_lastEvent,
+                  "{\"level\":3,\"levelName\":\"INFO\",\"module\":\"Main\","
+                  "\"message\":\"value \\\"5\\\"\\n\\u0009end \\\\\",\"timestamp\":0,"
+                  "\"includeTimestamp\":true,\"includeLevelName\":true,\"includeModuleName\":true}") == 0);
+
+    LOG_WARN(NULL, "no module");
+    assert(s_eventCount == 2 && strstr(s_lastEvent, "\"module\":\"unknown\"") != NULL);
+
+    // Level filter
+    LOG_DEBUG("Main", "not sent");
+    assert(s_eventCount == 2);
+    MCP_LoggingSetMaxLevel(LOG_LEVEL_DEBUG);
+    LOG_DEBUG("Main", "sent");
+    assert(s_eventCount == 3 && strstr(s_lastEvent, "\"levelName\":\"DEBUG\"") != NULL);
+
+    // Module filter
+    assert(MCP_LoggingAddAllowedModule("Main") == 0);
+    assert(MCP_LoggingSetFilterByModule(true) == false);
+    LOG_INFO("Other", "filtered");
+    LOG_INFO(NULL, "filtered");
+    assert(s_eventCount == 3);
+    LOG_INFO("Main", "allowed");
+    assert(s_eventCount == 4);
+    assert(MCP_LoggingAddAllowedModule("Other") == 0);
+    LOG_INFO("Other", "allowed now");
+    assert(s_eventCount == 5 && strstr(s_lastEvent, "\"module\":\"Other\"") != NULL);
+    assert(MCP_LoggingRemoveAllowedModule("Main") == 0);
+    LOG_INFO("Main", "removed");
+    assert(s_eventCount == 5);
+    MCP_LoggingSetFilterByModule(false);
+    LOG_INFO("Main", "unfiltered");
+    assert(s_eventCount == 6);
+
+    // Long messages are cut to one event
+    char longText[2000];
+    memset(longText, '"', sizeof(longText) - 1);
+    longText[sizeof(longText) - 1] = '\0';
+    LOG_INFO("Main", "%s", longText);
+    assert(s_eventCount == 7 && strlen(s_lastEvent) < 768);
+    assert(strstr(s_lastEvent, "\",\"timestamp\":0,") != NULL);
+
+    assert(MCP_LoggingEnable(false) == true);
+    LOG_ERROR("Main", "disabled");
+    assert(s_eventCount == 7);
+    MCP_LoggingEnable(true);
+
+    assert(MCP_LoggingDeinit() == 0);
+    LOG_ERROR("Main", "after deinit");
+    assert(s_eventCount == 7);
+
+    printf("Bridge event test passed!\n\n");
+}
+
+static void test_module_table_limit() {
+    printf("Testing the module table limit...\n");
+
+    // IDs run out after LOG_MAX_MODULES - 1 names; later names share ID 0
+    char name[16];
+    int last = 0;
+    for (int i = 0; i < LOG_MAX_MODULES + 4; i++) {
+        snprintf(name, sizeof(name), "module%d", i);
+        int id = log_module_id(name);
+        assert(id == 0 || id > last);
+        last = id > 0 ? id : last;
+    }
+    assert(last == LOG_MAX_MODULES - 1);
+    assert(log_module_id("one too many") == 0);
+
+    // The bridge still forwards allowed modules beyond the table, by name,
+    // and keeps dropping other modules that share ID 0
+    init_quiet_logging();
+    assert(MCP_LoggingInit(MCP_GetServer(), LOG_LEVEL_INFO) == 0);
+    assert(MCP_LoggingAddAllowedModule("module1") == 0);
+    assert(MCP_LoggingAddAllowedModule("one too many") == 0);
+    MCP_LoggingSetFilterByModule(true);
+    s_eventCount = 0;
+    LOG_INFO("one too many", "allowed");
+    assert(s_eventCount == 1 && strstr(s_lastEvent, "\"module\":\"one too many\"") != NULL);
+    LOG_INFO("module1", "allowed");
+    assert(s_eventCount == 2);
+    snprintf(name, sizeof(name), "module%d", LOG_MAX_MODULES + 2);
+    LOG_INFO(name, "filtered");
+    LOG_INFO(NULL, "filtered");
+    assert(s_eventCount == 2);
+    assert(MCP_LoggingRemoveAllowedModule("one too many") == 0);
+    LOG_INFO("one too many", "removed");
+    assert(s_eventCount == 2);
+    MCP_LoggingClearAllowedModules();
+    assert(MCP_LoggingDeinit() == 0);
+
+    printf("Module table limit test passed!\n\n");
+}
+
+// ===== Benchmark =====
+
+static double bench_calls(LogLevel level, const char* module, int calls) {
+    double start = now_seconds();
+    for (int i = 0; i < calls; i++) {
+        log_message(level, module, "sensor %s read %d in %u us", "temp-1", i, (unsigned)(i * 3));
+    }
+    return (now_seconds() - start) / calls * 1e9;
+}
+
+static void bench_forwarding() {
+    printf("Benchmarking the per-record cost of forwarding to a subscribed session...\n");
+
+    enum { CALLS = 200000 };
+    init_quiet_logging();
+    assert(MCP_LoggingInit(MCP_GetServer(), LOG_LEVEL_INFO) == 0);
+    assert(MCP_LoggingAddAllowedModule("Sensor") == 0);
+    MCP_LoggingSetFilterByModule(true);
+
+    s_eventCount = 0;
+    double forwarded = bench_calls(LOG_LEVEL_INFO, "Sensor", CALLS);
+    assert(s_eventCount == CALLS);
+    double moduleFiltered = bench_calls(LOG_LEVEL_INFO, "Storage", CALLS);
+    double levelFiltered = bench_calls(LOG_LEVEL_DEBUG, "Sensor", CALLS);
+    assert(s_eventCount == CALLS);
+
+    printf("  forwarded, synchronous:        %6.0f ns per record\n", forwarded);
+    printf("  dropped by module mask:        %6.0f ns per record\n", moduleFiltered);
+    printf("  dropped by level:              %6.0f ns per record\n", levelFiltered);
+
+    // Deferred records: the caller queues, the drain formats and sends
+    assert(log_set_async(4096) == 0);
+    log_set_deferred(true);
+    double callerTotal = 0;
+    double drainTotal = 0;
+    for (int done = 0; done < CALLS; done += 4096) {
+        callerTotal += bench_calls(LOG_LEVEL_INFO, "Sensor", 4096) * 4096;
+        double start = now_seconds();
+        assert(log_process(0) == 4096);
+        drainTotal += (now_seconds() - start) * 1e9;
+    }
+    int records = (CALLS + 4095) / 4096 * 4096;
+    printf("  forwarded, deferred:           %6.0f ns caller + %4.0f ns drain per record\n",
+           callerTotal / records, drainTotal / records);
+    log_set_deferred(false);
+    assert(log_set_async(0) == 0);
+
+    assert(MCP_LoggingDeinit() == 0);
+    printf("Benchmark complete!\n\n");
+}
+
+int main() {
+    printf("=== MCP Logging Bridge Tests ===\n\n");
+
+    test_module_ids();
+    test_sink_filters();
+    test_bridge_events();
+    bench_forwarding();
+    test_module_table_limit();
+
+    printf("All MCP logging bridge tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,588 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <math.h>
+
+#include "../src/core/tool_system/rule_interpreter.h"
+
+// Benchmark iteration count
+#define BENCH_ITERATIONS 200000
+
+// Samples pushed per window size in the aggregate benchmark
+#define BENCH_SAMPLES 100000
+
+// Heap allocation counter, fed by the linker wraps in build_rule_interpreter_test.sh
+static long s_allocations = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+char* __real_strdup(const char* s);
+
+void* __wrap_malloc(size_t size) {
+    s_allocations++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    s_allocations++;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    s_allocations++;
+    return __real_realloc(ptr, size);
+}
+
+char* __wrap_strdup(const char* s) {
+    s_allocations++;
+    return __real_strdup(s);
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool eval_bool(const char* expression) {
+    MCP_RuleValue value = MCP_RuleEvaluate(expression);
+    assert(value.type == MCP_RULE_VALUE_BOOL);
+    return value.value.boolValue;
+}
+
+static double eval_number(const char* expression) {
+    MCP_RuleValue value = MCP_RuleEvaluate(expression);
+    assert(value.type == MCP_RULE_VALUE_NUMBER);
+    return value.value.numberValue;
+}
+
+static MCP_RuleValue rule_greatest(MCP_RuleValue* params, int paramCount) {
+    double best = 0;
+    for (int i = 0; i < paramCount; i++) {
+        if (params[i].type == MCP_RULE_VALUE_NUMBER && (i == 0 || params[i].value.numberValue > best)) {
+            best = params[i].value.numberValue;
+        }
+    }
+    return MCP_RuleCreateNumberValue(best);
+}
+
+// Test expression semantics
+static void test_expressions() {
+    printf("Testing rule expressions...\n");
+    
+    MCP_RuleRegisterVariable("temperature", MCP_RuleCreateNumberValue(31.5));
+    MCP_RuleRegisterVariable("humidity", MCP_RuleCreateNumberValue(55));
+    MCP_RuleRegisterVariable("override", MCP_RuleCreateBoolValue(false));
+    MCP_RuleRegisterVariable("state", MCP_RuleCreateStringValue("open"));
+    assert(MCP_RuleRegisterFunction("greatest", rule_greatest) == 0);
+    
+    // Window aggregate names stay built in
+    assert(MCP_RuleRegisterFunction("max", rule_greatest) == -3);
+    assert(MCP_RuleRegisterFunction("count_above", rule_greatest) == -3);
+    
+    assert(eval_number("1 + 2 * 3") == 7);
+    assert(eval_number("(1 + 2) * 3") == 9);
+    assert(eval_number("10 - 4 - 3") == 3);
+    assert(eval_number("-2 * -3") == 6);
+    assert(eval_number("7 % 4") == 3);
+    assert(eval_number("greatest(1, temperature, 4)") == 31.5);
+    assert(eval_number("greatest(2, greatest(5, 3)) + 1") == 6);
+    
+    assert(eval_bool("temperature > 30"));
+    assert(!eval_bool("temperature < 30"));
+    assert(eval_bool("temperature > 30 && humidity < 60"));
+    assert(eval_bool("temperature > 40 || humidity <= 55"));
+    assert(!eval_bool("temperature > 30 && override"));
+    assert(eval_bool("!override && state == 'open'"));
+    assert(eval_bool("state != \"closed\""));
+    assert(eval_bool("1 + 1 == 2 && 3 >= 3"));
+    
+    // Unregistered names evaluate to null
+    MCP_RuleValue value = MCP_RuleEvaluate("missing + 1");
+    assert(value.type == MCP_RULE_VALUE_NULL);
+    value = MCP_RuleEvaluate("unknown_fn(1)");
+    assert(value.type == MCP_RULE_VALUE_NULL);
+    
+    // Syntax errors
+    assert(MCP_RuleCompile("1 +") == NULL);
+    assert(MCP_RuleCompile("(1 + 2") == NULL);
+    assert(MCP_RuleCompile("1 2") == NULL);
+    assert(MCP_RuleCompile("a $ b") == NULL);
+    
+    printf("Rule expression test passed!\n\n");
+}
+
+// Test that compiled programs track later variable changes
+static void test_compiled_program() {
+    printf("Testing compiled rule programs...\n");
+    
+    MCP_RuleProgram* program = MCP_RuleCompile("pressure > limit");
+    assert(program != NULL);
+    
+    // Not registered yet
+    MCP_RuleValue value = MCP_RuleExecute(program);
+    assert(value.type == MCP_RULE_VALUE_NULL);
+    
+    MCP_RuleRegisterVariable("pressure", MCP_RuleCreateNumberValue(1010));
+    MCP_RuleRegisterVariable("limit", MCP_RuleCreateNumberValue(1000));
+    value = MCP_RuleExecute(program);
+    assert(value.type == MCP_RULE_VALUE_BOOL && value.value.boolValue);
+    
+    MCP_RuleRegisterVariable("pressure", MCP_RuleCreateNumberValue(990));
+    value = MCP_RuleExecute(program);
+    assert(value.type == MCP_RULE_VALUE_BOOL && !value.value.boolValue);
+    
+    MCP_RuleFreeProgram(program);
+    
+    printf("Compiled rule program test passed!\n\n");
+}
+
+// Load a serialized program with one byte changed; returns whether it was accepted
+static bool load_patched(const uint8_t* buffer, int length, int offset, uint8_t byte) {
+    uint8_t patched[256];
+    assert(length <= (int)sizeof(patched));
+    memcpy(patched, buffer, length);
+    patched[offset] = byte;
+    
+    MCP_RuleProgram* program = MCP_RuleProgramDeserialize(patched, length, NULL);
+    MCP_RuleFreeProgram(program);
+    return program != NULL;
+}
+
+// Test that loaded bytecode gets the stack and jump checks the compiler guarantees
+static void test_program_verification() {
+    printf("Testing verification of loaded programs...\n");
+    
+    // load, push, >, and-jump to 8, load, push, <, to-bool
+    MCP_RuleProgram* program = MCP_RuleCompile("temperature > 30 && humidity < 60");
+    assert(program != NULL);
+    uint8_t buffer[256];
+    int length = MCP_RuleProgramSerialize(program, buffer, sizeof(buffer));
+    assert(length > 0);
+    MCP_RuleFreeProgram(program);
+    
+    // Header is 8 bytes, then 4 bytes per instruction: opcode, argc, operand
+    const int maxStackOffset = 4;
+    const int jump = 8 + 3 * 4;
+    assert(buffer[jump + 2] == 8);
+    
+    program = MCP_RuleProgramDeserialize(buffer, length, NULL);
+    assert(program != NULL);
+    MCP_RuleValue value = MCP_RuleExecute(program);
+    assert(value.type == MCP_RULE_VALUE_BOOL && value.value.boolValue);
+    MCP_RuleFreeProgram(program);
+    
+    assert(load_patched(buffer, length, jump + 2, 8));
+    assert(!load_patched(buffer, length, jump + 2, 2));     // Backward jump
+    assert(!load_patched(buffer, length, jump + 2, 3));     // Jump to itself
+    assert(!load_patched(buffer, length, jump + 2, 9));     // Past the end
+    assert(!load_patched(buffer, length, jump + 2, 4));     // Arrives with a different depth
+    assert(!load_patched(buffer, length, maxStackOffset, 1));     // Needs two slots
+    assert(!load_patched(buffer, length, maxStackOffset, 33));    // Above RULE_MAX_STACK
+    assert(!load_patched(buffer, length, 8, 3));            // Binary operator on an empty stack
+    assert(!load_patched(buffer, length, 8 + 7 * 4, 0));    // Two values left
+    
+    printf("Program verification test passed!\n\n");
+}
+
+// Test bulk and handle-based variable updates
+static void test_variable_updates() {
+    printf("Testing bulk variable updates...\n");
+    
+    MCP_RuleVariableUpdate updates[3] = {
+        { "batch_a", MCP_RuleCreateNumberValue(1) },
+        { "batch_b", MCP_RuleCreateNumberValue(2) },
+        { "batch_c", MCP_RuleCreateStringValue("ok") }
+    };
+    assert(MCP_RuleUpdateVariables(updates, 3) == 3);
+    assert(eval_bool("batch_a + batch_b == 3 && batch_c == 'ok'"));
+    
+    int handle = MCP_RuleGetVariableHandle("batch_a");
+    assert(handle >= 0);
+    assert(handle == MCP_RuleGetVariableHandle("batch_a"));
+    assert(MCP_RuleSetVariableByHandle(handle, MCP_RuleCreateNumberValue(10)) == 0);
+    assert(eval_number("batch_a") == 10);
+    assert(MCP_RuleSetVariableByHandle(-1, MCP_RuleCreateNumberValue(0)) < 0);
+    
+    printf("Bulk variable update test passed!\n\n");
+}
+
+static double execute_number(const MCP_RuleProgram* program) {
+    MCP_RuleValue value = MCP_RuleExecute(program);
+    assert(value.type == MCP_RULE_VALUE_NUMBER);
+    return value.value.numberValue;
+}
+
+// Reference aggregates computed from scratch over the last samples
+static void reference_aggregates(const double* samples, int count, double threshold, double* out) {
+    double sum = 0, sumXY = 0, low = samples[0], high = samples[0];
+    int above = 0;
+    for (int i = 0; i < count; i++) {
+        sum += samples[i];
+        sumXY += i * samples[i];
+        low = samples[i] < low ? samples[i] : low;
+        high = samples[i] > high ? samples[i] : high;
+        above += samples[i] > threshold;
+    }
+    double n = count, sumX = n * (n - 1) / 2, sumXX = (n - 1) * n * (2 * n - 1) / 6;
+    out[0] = sum / n;
+    out[1] = low;
+    out[2] = high;
+    out[3] = count > 1 ? (n * sumXY - sumX * sum) / (n * sumXX - sumX * sumX) : 0;
+    out[4] = above;
+}
+
+// Test sliding window aggregates against a from-scratch computation
+static void test_window_aggregates() {
+    printf("Testing window aggregates...\n");
+    
+    const int size = 50;
+    const char* expressions[] = { "avg(wsensor)", "min(wsensor)", "max(wsensor)", "slope(wsensor)",
+                                  "count_above(wsensor, 60)" };
+    MCP_RuleProgram* programs[5];
+    double history[400];
+    double expected[5];
+    
+    // No window yet: aggregates are null
+    MCP_RuleValue value = MCP_RuleEvaluate("avg(wsensor)");
+    assert(value.type == MCP_RULE_VALUE_NULL);
+    assert(MCP_RuleCompile("avg(3)") == NULL);
+    assert(MCP_RuleCompile("count_above(wsensor)") == NULL);
+    
+    assert(MCP_RuleSetSampleWindow("wsensor", size) == 0);
+    for (int i = 0; i < 5; i++) {
+        programs[i] = MCP_RuleCompile(expressions[i]);
+        assert(programs[i] != NULL);
+    }
+    
+    // Noisy ramp, checked while filling and after many evictions
+    unsigned seed = 7;
+    int handle = MCP_RuleGetVariableHandle("wsensor");
+    for (int t = 0; t < 400; t++) {
+        seed = seed * 1103515245 + 12345;
+        history[t] = t * 0.25 + (double)((seed >> 16) % 200) / 10.0;
+        assert(MCP_RuleSetVariableByHandle(handle, MCP_RuleCreateNumberValue(history[t])) == 0);
+        
+        int count = t + 1 < size ? t + 1 : size;
+        reference_aggregates(&history[t + 1 - count], count, 60, expected);
+        for (int i = 0; i < 5; i++) {
+            assert(fabs(execute_number(programs[i]) - expected[i]) < 1e-6);
+        }
+    }
+    
+    // More thresholds than are tracked still give exact counts
+    const char* thresholds[] = { "count_above(wsensor, 70)", "count_above(wsensor, 80)",
+                                 "count_above(wsensor, 90)", "count_above(wsensor, 100)" };
+    for (int i = 0; i < 4; i++) {
+        reference_aggregates(&history[400 - size], size, 70 + 10 * i, expected);
+        assert(eval_number(thresholds[i]) == expected[4]);
+    }
+    
+    // Batched samples: one push, the last becomes the value
+    double batch[120];
+    for (int i = 0; i < 120; i++) {
+        batch[i] = 100 - i;
+    }
+    assert(MCP_RulePushSamples(handle, batch, 120) == 0);
+    assert(eval_number("wsensor") == batch[119]);
+    assert(eval_number("max(wsensor)") == batch[70]);
+    assert(eval_number("min(wsensor)") == batch[119]);
+    assert(fabs(eval_number("slope(wsensor)") + 1) < 1e-9);
+    assert(eval_bool("avg(wsensor) < 60 && count_above(wsensor, 20) == 10"));
+    
+    // Serialized programs keep their window references
+    uint8_t buffer[128];
+    int length = MCP_RuleProgramSerialize(programs[4], buffer, sizeof(buffer));
+    assert(length > 0);
+    MCP_RuleProgram* loaded = MCP_RuleProgramDeserialize(buffer, length, NULL);
+    assert(loaded != NULL && execute_number(loaded) == 0);
+    MCP_RuleFreeProgram(loaded);
+    
+    int variables[2];
+    assert(MCP_RuleProgramGetVariables(programs[0], variables, 2) == 1 && variables[0] == handle);
+    
+    for (int i = 0; i < 5; i++) {
+        MCP_RuleFreeProgram(programs[i]);
+    }
+    assert(MCP_RulePushSamples(MCP_RuleGetVariableHandle("batch_x"), batch, 1) == -2);
+    assert(MCP_RuleSetSampleWindow("wsensor", 0) == 0);
+    
+    printf("Window aggregate test passed!\n\n");
+}
+
+static MCP_RuleValue rule_starts_with(MCP_RuleValue* params, int paramCount) {
+    if (paramCount != 2 || params[0].type != MCP_RULE_VALUE_STRING || params[1].type != MCP_RULE_VALUE_STRING) {
+        return MCP_RuleCreateBoolValue(false);
+    }
+    size_t length = strlen(params[1].value.stringValue);
+    return MCP_RuleCreateBoolValue(strncmp(params[0].value.stringValue, params[1].value.stringValue, length) == 0);
+}
+
+static MCP_RuleValue rule_first(MCP_RuleValue* params, int paramCount) {
+    return paramCount > 0 ? MCP_RuleCreateStringValue(params[0].value.stringValue) : MCP_RuleCreateBoolValue(false);
+}
+
+// Rules with string comparisons used by the allocation test and benchmark
+static const char* const s_stringRules[] = {
+    "door == 'open' && mode != 'away'",
+    "state == 'error' || starts_with(state, 'err') || door == 'forced'",
+    "mode == 'home' && (door == 'open' || window == 'open') && state != 'idle'"
+};
+
+static void set_string_states(void) {
+    MCP_RuleVariableUpdate updates[4] = {
+        { "door", MCP_RuleCreateStringValue("open") },
+        { "mode", MCP_RuleCreateStringValue("home") },
+        { "state", MCP_RuleCreateStringValue("err_sensor") },
+        { "window", MCP_RuleCreateStringValue("closed") }
+    };
+    assert(MCP_RuleUpdateVariables(updates, 4) == 4);
+}
+
+// Test that compiled evaluation does not touch the heap
+static void test_allocation_free_evaluation() {
+    printf("Testing allocation-free evaluation...\n");
+    
+    MCP_RuleRegisterFunction("starts_with", rule_starts_with);
+    MCP_RuleRegisterFunction("first", rule_first);
+    set_string_states();
+    
+    MCP_RuleProgram* programs[3];
+    for (int i = 0; i < 3; i++) {
+        programs[i] = MCP_RuleCompile(s_stringRules[i]);
+        assert(programs[i] != NULL);
+    }
+    
+    const bool expected[3] = { true, true, true };
+    s_allocations = 0;
+    for (int run = 0; run < 100; run++) {
+        for (int i = 0; i < 3; i++) {
+            MCP_RuleValue value = MCP_RuleExecute(programs[i]);
+            assert(value.type == MCP_RULE_VALUE_BOOL && value.value.boolValue == expected[i]);
+            MCP_RuleFreeValue(value);
+        }
+    }
+    printf("  allocations per boolean string rule: %.2f\n", s_allocations / 300.0);
+    assert(s_allocations == 0);
+    
+    // A string result is the caller's to free: exactly one copy
+    MCP_RuleProgram* program = MCP_RuleCompile("door");
+    s_allocations = 0;
+    MCP_RuleValue value = MCP_RuleExecute(program);
+    assert(s_allocations == 1);
+    assert(value.type == MCP_RULE_VALUE_STRING && strcmp(value.value.stringValue, "open") == 0);
+    MCP_RuleFreeValue(value);
+    MCP_RuleFreeProgram(program);
+    
+    // Strings returned by functions are owned by the evaluator and released
+    program = MCP_RuleCompile("first(door) == 'open' && first(mode) == 'home'");
+    value = MCP_RuleExecute(program);
+    assert(value.type == MCP_RULE_VALUE_BOOL && value.value.boolValue);
+    MCP_RuleFreeProgram(program);
+    
+    for (int i = 0; i < 3; i++) {
+        MCP_RuleFreeProgram(programs[i]);
+    }
+    
+    printf("Allocation-free evaluation test passed!\n\n");
+}
+
+// Benchmark compiled rules dominated by string comparisons
+static void bench_string_rules() {
+    printf("Benchmarking string comparison rules...\n");
+    
+    set_string_states();
+    for (int i = 0; i < 3; i++) {
+        MCP_RuleProgram* program = MCP_RuleCompile(s_stringRules[i]);
+        assert(program != NULL);
+        
+        volatile int sink = 0;
+        s_allocations = 0;
+        double start = now_seconds();
+        for (int n = 0; n < BENCH_ITERATIONS; n++) {
+            MCP_RuleValue value = MCP_RuleExecute(program);
+            sink += value.value.boolValue;
+            MCP_RuleFreeValue(value);
+        }
+        double elapsed = now_seconds() - start;
+        (void)sink;
+        
+        printf("  rule %d: %10.0f evals/s, %.1f allocations/eval\n",
+               i + 1, BENCH_ITERATIONS / elapsed, (double)s_allocations / BENCH_ITERATIONS);
+        MCP_RuleFreeProgram(program);
+    }
+    
+    printf("\n");
+}
+
+static void bench_expression(const char* label, const char* expression) {
+    volatile int sink = 0;
+    
+    double start = now_seconds();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        MCP_RuleValue value = MCP_RuleEvaluate(expression);
+        sink += value.type == MCP_RULE_VALUE_BOOL && value.value.boolValue;
+        MCP_RuleFreeValue(value);
+    }
+    double interpreted = now_seconds() - start;
+    
+    MCP_RuleProgram* program = MCP_RuleCompile(expression);
+    assert(program != NULL);
+    
+    start = now_seconds();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        MCP_RuleValue value = MCP_RuleExecute(program);
+        sink += value.type == MCP_RULE_VALUE_BOOL && value.value.boolValue;
+        MCP_RuleFreeValue(value);
+    }
+    double compiled = now_seconds() - start;
+    
+    MCP_RuleFreeProgram(program);
+    
+    printf("  %-22s interpreted %10.0f evals/s, compiled %10.0f evals/s (x%.1f)\n",
+           label, BENCH_ITERATIONS / interpreted, BENCH_ITERATIONS / compiled,
+           interpreted / compiled);
+    (void)sink;
+}
+
+// Benchmark interpreted versus compiled evaluation
+static void bench_compiled_vs_interpreted() {
+    printf("Benchmarking rule evaluation...\n");
+    
+    bench_expression("threshold", "temperature > 30");
+    bench_expression("boolean combination", "temperature > 30 && humidity < 60 || override");
+    bench_expression("arithmetic", "(temperature - 2) * 1.8 + 32 >= 86 && !override");
+    
+    printf("\n");
+}
+
+// Benchmark evaluation cost as the variable environment grows
+static void bench_environment_size() {
+    printf("Benchmarking evaluation against environment size...\n");
+    
+    static const int sizes[] = { 10, 100, 1000 };
+    static MCP_RuleVariableUpdate updates[1000];
+    static char names[1000][16];
+    int registered = 0;
+    
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int size = sizes[s];
+        
+        // Grow the environment with a bulk update
+        for (int i = registered; i < size; i++) {
+            snprintf(names[i], sizeof(names[i]), "env_%d", i);
+        }
+        for (int i = 0; i < size; i++) {
+            updates[i].name = names[i];
+            updates[i].value = MCP_RuleCreateNumberValue(i);
+        }
+        
+        double start = now_seconds();
+        assert(MCP_RuleUpdateVariables(updates, size) == size);
+        double bulk = now_seconds() - start;
+        registered = size;
+        
+        // Reference the most recently registered variables
+        char expression[96];
+        snprintf(expression, sizeof(expression), "%s > 5 && %s < %d",
+                 names[size - 1], names[size / 2], size);
+        
+        volatile int sink = 0;
+        start = now_seconds();
+        for (int i = 0; i < BENCH_ITERATIONS; i++) {
+            MCP_RuleValue value = MCP_RuleEvaluate(expression);
+            sink += value.type == MCP_RULE_VALUE_BOOL && value.value.boolValue;
+        }
+        double elapsed = now_seconds() - start;
+        (void)sink;
+        
+        printf("  %4d variables: %7.1f ns/eval (interpreted), bulk update %6.1f ns/variable\n",
+               size, elapsed * 1e9 / BENCH_ITERATIONS, bulk * 1e9 / size);
+    }
+    
+    printf("\n");
+}
+
+// Benchmark a windowed rule: incremental aggregates versus recomputing over the samples
+static void bench_window_aggregates() {
+    printf("Benchmarking window aggregate rules against window size...\n");
+    printf("  %8s %18s %18s\n", "window", "incremental ns", "recompute ns");
+    
+    static const int sizes[] = { 16, 128, 1024, 8192 };
+    static double ring[8192];
+    
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int size = sizes[s];
+        char name[32];
+        char expression[160];
+        snprintf(name, sizeof(name), "bench_w%d", size);
+        snprintf(expression, sizeof(expression),
+                 "avg(%s) > 55 && count_above(%s, 90) > 3 || max(%s) - min(%s) > 99 || slope(%s) > 0.5",
+                 name, name, name, name, name);
+        
+        assert(MCP_RuleSetSampleWindow(name, (uint16_t)size) == 0);
+        int handle = MCP_RuleGetVariableHandle(name);
+        MCP_RuleProgram* program = MCP_RuleCompile(expression);
+        assert(program != NULL);
+        
+        // Incremental: push the sample, then evaluate the rule
+        volatile int sink = 0;
+        unsigned seed = 1;
+        double start = now_seconds();
+        for (int i = 0; i < BENCH_SAMPLES; i++) {
+            seed = seed * 1103515245 + 12345;
+            MCP_RuleSetVariableByHandle(handle, MCP_RuleCreateNumberValue((seed >> 16) % 100));
+            MCP_RuleValue value = MCP_RuleExecute(program);
+            sink += value.value.boolValue;
+        }
+        double incremental = (now_seconds() - start) / BENCH_SAMPLES * 1e9;
+        
+        // Recompute: every aggregate rebuilt from the full sample ring on each sample
+        int samples = BENCH_SAMPLES / (size / 16 + 1);
+        double aggregates[5];
+        for (int i = 0; i < size; i++) {
+            ring[i] = i % 100;
+        }
+        seed = 1;
+        start = now_seconds();
+        for (int i = 0; i < samples; i++) {
+            seed = seed * 1103515245 + 12345;
+            ring[i % size] = (seed >> 16) % 100;
+            reference_aggregates(ring, size, 90, aggregates);
+            sink += (aggregates[0] > 55 && aggregates[4] > 3) || aggregates[2] - aggregates[1] > 99 || aggregates[3] > 0.5;
+        }
+        double recompute = (now_seconds() - start) / samples * 1e9;
+        (void)sink;
+        
+        printf("  %8d %18.1f %18.1f\n", size, incremental, recompute);
+        
+        MCP_RuleFreeProgram(program);
+        MCP_RuleSetSampleWindow(name, 0);
+    }
+    
+    printf("\n");
+}
+
+int main() {
+    printf("=== Rule Interpreter Tests ===\n\n");
+    
+    assert(MCP_RuleInterpreterInit() == 0);
+    
+    // Window aggregates first, on a registry with no functions yet
+    test_window_aggregates();
+    bench_window_aggregates();
+    test_expressions();
+    test_compiled_program();
+    test_program_verification();
+    test_variable_updates();
+    test_allocation_free_evaluation();
+    bench_compiled_vs_interpreted();
+    bench_environment_size();
+    bench_string_rules();
+    
+    printf("All rule interpreter tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,429 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "../src/system/storage_cache.h"
+#include "../src/system/persistent_storage.h"
+#include "../src/core/kernel/config_system.h"
+
+// Config keys saved per run in the benchmark
+#define BENCH_CONFIG_KEYS 100
+#define BENCH_RUNS 20
+
+// Size of StoredConfigEntry in config_system.c, written once per key
+#define STORED_ENTRY_SIZE (64 + 4 + 256)
+
+static char s_root[64];
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void make_path(char* path, size_t size, const char* name) {
+    snprintf(path, size, "%s/%s", s_root, name);
+}
+
+static void free_keys(char** keys, int count) {
+    for (int i = 0; i < count; i++) {
+        free(keys[i]);
+    }
+}
+
+static void test_cache_module() {
+    printf("Testing write-behind cache entries...\n");
+
+    StorageCache* cache = storage_cache_create();
+    assert(cache != NULL);
+
+    bool replaced = true;
+    assert(storage_cache_put(cache, "b", "1234", 4, &replaced) == 0);
+    assert(!replaced);
+    assert(storage_cache_put(cache, "a", "xy", 2, &replaced) == 0);
+    assert(storage_cache_put(cache, "b", "56", 2, &replaced) == 0);
+    assert(replaced);
+    assert(storage_cache_count(cache) == 2);
+    assert(storage_cache_bytes(cache) == 1 + 2 + 1 + 2);
+
+    StorageCacheEntry entry;
+    assert(storage_cache_find(cache, "b", &entry));
+    assert(!entry.deleted && entry.size == 2 && memcmp(entry.data, "56", 2) == 0);
+    assert(!storage_cache_find(cache, "c", &entry));
+
+    // A delete replaces the pending value but keeps the key's position
+    assert(storage_cache_delete(cache, "b", &replaced) == 0);
+    assert(replaced);
+    assert(storage_cache_get(cache, 0, &entry) == 0);
+    assert(strcmp(entry.key, "b") == 0 && entry.deleted && entry.data == NULL);
+    assert(storage_cache_get(cache, 1, &entry) == 0 && strcmp(entry.key, "a") == 0);
+    assert(storage_cache_get(cache, 2, &entry) == -1);
+    assert(storage_cache_bytes(cache) == 1 + 1 + 2);
+
+    // Empty values still come back with a usable buffer
+    assert(storage_cache_put(cache, "empty", NULL, 0, NULL) == 0);
+    assert(storage_cache_find(cache, "empty", &entry) && entry.data != NULL && entry.size == 0);
+
+    // Growth keeps every key reachable and in order
+    char key[16];
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        assert(storage_cache_put(cache, key, &i, sizeof(i), NULL) == 0);
+    }
+    assert(storage_cache_count(cache) == 1003);
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        assert(storage_cache_find(cache, key, &entry) && *(const int*)entry.data == i);
+        assert(storage_cache_get(cache, (uint32_t)i + 3, &entry) == 0 && strcmp(entry.key, key) == 0);
+    }
+
+    storage_cache_clear(cache);
+    assert(storage_cache_count(cache) == 0 && storage_cache_bytes(cache) == 0);
+    assert(!storage_cache_find(cache, "a", NULL));
+    storage_cache_destroy(cache);
+
+    printf("Write-behind cache entries test passed!\n\n");
+}
+
+static void test_transaction_group_commit() {
+    printf("Testing transactions as group commits...\n");
+
+    StorageConfig config = { .type = STORAGE_TYPE_EEPROM, .size = 64 * 1024 };
+    assert(persistent_storage_init(&config) == 0);
+
+    int value = 1;
+    assert(persistent_storage_write("kept", &value, sizeof(value)) == 0);
+    assert(persistent_storage_write("doomed", &value, sizeof(value)) == 0);
+
+    StorageWriteStats stats;
+    assert(persistent_storage_get_write_stats(&stats) == 0);
+    uint32_t mediaWrites = stats.mediaWrites;
+    assert(stats.groupCommits == 0);
+
+    // Nothing reaches the medium until the transaction ends
+    assert(persistent_storage_begin_transaction() == 0);
+    char key[16];
+    for (int i = 0; i < 10; i++) {
+        snprintf(key, sizeof(key), "staged.%d", i);
+        for (int round = 0; round < 3; round++) {
+            value = i * 10 + round;
+            assert(persistent_storage_write(key, &value, sizeof(value)) == 0);
+        }
+    }
+    assert(persistent_storage_delete("doomed") == 0);
+    assert(persistent_storage_delete("doomed") == -2);
+    assert(persistent_storage_write("ghost", &value, sizeof(value)) == 0);
+    assert(persistent_storage_delete("ghost") == 0);
+
+    assert(persistent_storage_get_write_stats(&stats) == 0);
+    assert(stats.mediaWrites == mediaWrites);
+    assert(stats.pendingEntries == 12);
+    assert(stats.absorbed == 21);
+
+    // Reads and listings see the staged state
+    size_t actual = 0;
+    assert(persistent_storage_read("staged.4", &value, sizeof(value), &actual) == 0);
+    assert(value == 42 && actual == sizeof(value));
+    assert(persistent_storage_get_size("staged.4") == (int)sizeof(value));
+    assert(!persistent_storage_exists("doomed"));
+    assert(!persistent_storage_exists("ghost"));
+    assert(persistent_storage_read("doomed", &value, sizeof(value), &actual) == -2);
+
+    char* keys[32];
+    int count = persistent_storage_get_keys(keys, 32);
+    assert(count == 11);
+    free_keys(keys, count);
+    count = persistent_storage_get_keys_with_prefix("staged.", keys, 32);
+    assert(count == 10);
+    free_keys(keys, count);
+
+    assert(persistent_storage_end_transaction() == 0);
+    assert(persistent_storage_get_write_stats(&stats) == 0);
+    assert(stats.groupCommits == 1 && stats.entriesFlushed == 12 && stats.pendingEntries == 0);
+    assert(stats.mediaWrites > mediaWrites);
+
+    assert(persistent_storage_read("staged.9", &value, sizeof(value), &actual) == 0);
+    assert(value == 92);
+    assert(!persistent_storage_exists("doomed"));
+    count = persistent_storage_get_keys(keys, 32);
+    assert(count == 11);
+    free_keys(keys, count);
+    assert(persistent_storage_deinit() == 0);
+
+    printf("Transaction group commit test passed!\n\n");
+}
+
+static void test_write_behind() {
+    printf("Testing write-behind thresholds...\n");
+
+    char image[128];
+    make_path(image, sizeof(image), "write_behind.img");
+    StorageConfig config = {
+        .type = STORAGE_TYPE_EEPROM,
+        .size = 64 * 1024,
+        .imagePath = image,
+        .writeBehindBytes = 1024,
+        .writeBehindDelayMs = 100
+    };
+    assert(persistent_storage_init(&config) == 0);
+
+    // Small writes wait in the cache, repeated ones are absorbed
+    uint8_t value[100];
+    memset(value, 0x11, sizeof(value));
+    StorageWriteStats stats;
+    assert(persistent_storage_get_write_stats(&stats) == 0);
+    uint32_t mediaWrites = stats.mediaWrites;
+    for (int round = 0; round < 5; round++) {
+        assert(persistent_storage_write("config.a", value, 40) == 0);
+        assert(persistent_storage_write("config.b", value, 40) == 0);
+    }
+    assert(persistent_storage_get_write_stats(&stats) == 0);
+    assert(stats.mediaWrites == mediaWrites && stats.absorbed == 8 && stats.pendingEntries == 2);
+    assert(persistent_storage_exists("config.a"));
+
+    // The time limit counts from the first poll that sees the entries
+    assert(persistent_storage_poll(1000) == 0);
+    assert(persistent_storage_poll(1099) == 0);
+    assert(persistent_storage_poll(1100) == 1);
+    assert(persistent_storage_get_write_stats(&stats) == 0);
+    assert(stats.groupCommits == 1 && stats.pendingEntries == 0 && stats.mediaWrites > mediaWrites);
+    assert(persistent_storage_poll(5000) == 0);
+
+    // The size limit commits on the write that reaches it
+    char key[16];
+    for (int i = 0; i < 9; i++) {
+        snprintf(key, sizeof(key), "bulk.%d", i);
+        assert(persistent_storage_write(key, value, sizeof(value)) == 0);
+    }
+    assert(persistent_storage_get_write_stats(&stats) == 0);
+    assert(stats.groupCommits == 1 && stats.pendingEntries == 9);
+    assert(persistent_storage_write("bulk.9", value, sizeof(value)) == 0);
+    assert(persistent_storage_get_write_stats(&stats) == 0);
+    assert(stats.groupCommits == 2 && stats.pendingEntries == 0);
+
+    // Polls never commit inside a transaction
+    assert(persistent_storage_begin_transaction() == 0);
+    assert(persistent_storage_write("config.c", value, 4) == 0);
+    assert(persistent_storage_poll(10000) == 0);
+    assert(persistent_storage_poll(20000) == 0);
+    assert(persistent_storage_end_transaction() == 0);
+
+    // Deinit commits what is still staged
+    value[0] = 0x22;
+    assert(persistent_storage_write("config.a", value, 40) == 0);
+    assert(persistent_storage_delete("bulk.3") == 0);
+    assert(persistent_storage_deinit() == 0);
+
+    assert(persistent_storage_init(&config) == 0);
+    uint8_t out[100];
+    size_t actual = 0;
+    assert(persistent_storage_read("config.a", out, sizeof(out), &actual) == 0);
+    assert(actual == 40 && out[0] == 0x22);
+    assert(persistent_storage_exists("config.c"));
+    assert(!persistent_storage_exists("bulk.3"));
+    assert(persistent_storage_exists("bulk.9"));
+
+    // Clearing drops staged writes too
+    assert(persistent_storage_write("config.d", value, 4) == 0);
+    assert(persistent_storage_clear() == 0);
+    assert(!persistent_storage_exists("config.d"));
+    assert(persistent_storage_deinit() == 0);
+
+    // Syncing every write bypasses the cache
+    config.syncPolicy = STORAGE_SYNC_ALWAYS;
+    assert(persistent_storage_init(&config) == 0);
+    assert(persistent_storage_write("config.e", value, 4) == 0);
+    assert(persistent_storage_get_write_stats(&stats) == 0);
+    assert(stats.pendingEntries == 0 && stats.mediaWrites > 0);
+    assert(persistent_storage_deinit() == 0);
+
+    printf("Write-behind thresholds test passed!\n\n");
+}
+
+static void test_failed_commit() {
+    printf("Testing that a failed group commit keeps the staged writes...\n");
+
+    StorageConfig config = {
+        .type = STORAGE_TYPE_EEPROM,
+        .size = 8 * 1024,
+        .writeBehindBytes = 1024
+    };
+    assert(persistent_storage_init(&config) == 0);
+
+    // The size limit commits on the oversized write, which cannot fit
+    static uint8_t value[12 * 1024];
+    memset(value, 0x33, sizeof(value));
+    StorageWriteStats stats;
+    assert(persistent_storage_write("config.a", value, 40) == 0);
+    assert(persistent_storage_write("blob", value, sizeof(value)) < 0);
+    assert(persistent_storage_get_write_stats(&stats) == 0);
+    assert(stats.groupCommits == 0 && stats.pendingEntries == 2);
+    assert(persistent_storage_commit() < 0);
+
+    // Once the entry fits, the next commit applies everything that was staged
+    assert(persistent_storage_write("blob", value, 16) == 0);
+    assert(persistent_storage_commit() == 0);
+    assert(persistent_storage_get_write_stats(&stats) == 0);
+    assert(stats.groupCommits == 1 && stats.entriesFlushed == 2 && stats.pendingEntries == 0);
+
+    uint8_t out[64];
+    size_t actual = 0;
+    assert(persistent_storage_read("config.a", out, sizeof(out), &actual) == 0 && actual == 40);
+    assert(persistent_storage_read("blob", out, sizeof(out), &actual) == 0 && actual == 16);
+    assert(persistent_storage_deinit() == 0);
+
+    printf("Failed commit test passed!\n\n");
+}
+
+static void setup_config_entries(void) {
+    static bool initialized = false;
+    if (!initialized) {
+        assert(MCP_ConfigInit(BENCH_CONFIG_KEYS + 8) == 0);
+        initialized = true;
+    }
+
+    char key[32];
+    for (int i = 0; i < BENCH_CONFIG_KEYS; i++) {
+        snprintf(key, sizeof(key), "config.setting%d", i);
+        if (i % 4 == 0) {
+            assert(MCP_ConfigSetString(key, "sensor-hub.local", true) == 0);
+        } else {
+            assert(MCP_ConfigSetInt(key, i * 7, true) == 0);
+        }
+    }
+}
+
+// Save the way MCP_ConfigSave did before: one committed write per key
+static void save_per_key(void) {
+    static uint8_t entry[STORED_ENTRY_SIZE];
+    char key[32];
+    for (int i = 0; i < BENCH_CONFIG_KEYS; i++) {
+        snprintf(key, sizeof(key), "config.setting%d", i);
+        entry[0] = (uint8_t)i;
+        assert(persistent_storage_write(key, entry, sizeof(entry)) == 0);
+    }
+}
+
+// How a benchmark row saves the config
+typedef enum {
+    SAVE_PER_KEY,       // One committed write per key
+    SAVE_GROUPED,       // Every key in one group commit
+    SAVE_BLOB           // MCP_ConfigSave: one checksummed blob
+} BenchSave;
+
+static void bench_config_save(const char* label, StorageConfig* config, BenchSave save, bool counted) {
+    double total = 0;
+    StorageWriteStats stats;
+
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        assert(persistent_storage_init(config) == 0);
+        double start = now_seconds();
+        if (save == SAVE_BLOB) {
+            assert(MCP_ConfigSave() == 0);
+        } else if (save == SAVE_GROUPED) {
+            assert(persistent_storage_begin_transaction() == 0);
+            save_per_key();
+            assert(persistent_storage_end_transaction() == 0);
+        } else {
+            save_per_key();
+        }
+        total += now_seconds() - start;
+
+        assert(persistent_storage_get_write_stats(&stats) == 0);
+        assert(persistent_storage_exists(save == SAVE_BLOB ? "config.blob" : "config.setting99"));
+        persistent_storage_clear();
+        persistent_storage_deinit();
+    }
+
+    if (counted) {
+        printf("  %-30s %10.3f %12u %12.1f\n", label, total / BENCH_RUNS * 1e3,
+               stats.mediaWrites, stats.mediaBytesWritten / 1024.0);
+    } else {
+        printf("  %-30s %10.3f %12s %12s\n", label, total / BENCH_RUNS * 1e3, "-", "-");
+    }
+}
+
+static void bench_repeated_saves(void) {
+    // Three saves in quick succession with a write-behind window
+    StorageConfig config = {
+        .type = STORAGE_TYPE_EEPROM,
+        .size = 256 * 1024,
+        .writeBehindBytes = 256 * 1024,
+        .writeBehindDelayMs = 500
+    };
+    assert(persistent_storage_init(&config) == 0);
+    double start = now_seconds();
+    for (int i = 0; i < 3; i++) {
+        save_per_key();
+        assert(persistent_storage_poll((uint32_t)i * 100) == 0);
+    }
+    assert(persistent_storage_poll(600) == 1);
+    double elapsed = now_seconds() - start;
+
+    StorageWriteStats stats;
+    assert(persistent_storage_get_write_stats(&stats) == 0);
+    printf("  %-30s %10.3f %12u %12.1f   (%u absorbed)\n", "3 saves, write-behind 500 ms",
+           elapsed * 1e3, stats.mediaWrites, stats.mediaBytesWritten / 1024.0, stats.absorbed);
+    assert(stats.absorbed == 2 * BENCH_CONFIG_KEYS && stats.groupCommits == 1);
+    persistent_storage_deinit();
+}
+
+static void bench_config_saves() {
+    printf("Benchmarking a save of %d config keys (ms, media write calls, KB written)...\n", BENCH_CONFIG_KEYS);
+    printf("  %-30s %10s %12s %12s\n", "backend / save", "time", "media writes", "media KB");
+
+    setup_config_entries();
+
+    char image[128];
+    char directory[128];
+    make_path(image, sizeof(image), "bench.img");
+    make_path(directory, sizeof(directory), "bench_keys");
+
+    StorageConfig ram = { .type = STORAGE_TYPE_EEPROM, .size = 256 * 1024 };
+    StorageConfig log = { .type = STORAGE_TYPE_FLASH, .size = 256 * 1024 };
+    StorageConfig mapped = { .type = STORAGE_TYPE_EEPROM, .size = 256 * 1024, .imagePath = image };
+    StorageConfig files = { .type = STORAGE_TYPE_FILE_SYSTEM, .basePath = directory };
+
+    bench_config_save("directory, per-key commit", &ram, SAVE_PER_KEY, true);
+    bench_config_save("directory, group commit", &ram, SAVE_GROUPED, true);
+    bench_config_save("directory, MCP_ConfigSave", &ram, SAVE_BLOB, true);
+    bench_config_save("log, per-key commit", &log, SAVE_PER_KEY, true);
+    bench_config_save("log, group commit", &log, SAVE_GROUPED, true);
+    bench_config_save("log, MCP_ConfigSave", &log, SAVE_BLOB, true);
+    bench_config_save("mmap image, per-key commit", &mapped, SAVE_PER_KEY, true);
+    bench_config_save("mmap image, group commit", &mapped, SAVE_GROUPED, true);
+    bench_config_save("mmap image, MCP_ConfigSave", &mapped, SAVE_BLOB, true);
+    bench_config_save("file per key, per-key commit", &files, SAVE_PER_KEY, false);
+    bench_config_save("file per key, group commit", &files, SAVE_GROUPED, false);
+    bench_config_save("file per key, MCP_ConfigSave", &files, SAVE_BLOB, false);
+    bench_repeated_saves();
+    printf("\n");
+}
+
+static void remove_tree(void) {
+    char command[128];
+    snprintf(command, sizeof(command), "rm -rf %s", s_root);
+    if (system(command) != 0) {
+        printf("Could not remove %s\n", s_root);
+    }
+}
+
+int main() {
+    printf("=== Storage Write-Behind Tests ===\n\n");
+
+    snprintf(s_root, sizeof(s_root), "/tmp/mcp_cache_XXXXXX");
+    assert(mkdtemp(s_root) != NULL);
+
+    test_cache_module();
+    test_transaction_group_commit();
+    test_write_behind();
+    test_failed_commit();
+    bench_config_saves();
+
+    remove_tree();
+    printf("All storage write-behind tests passed!\n");
+    return 0;
+}
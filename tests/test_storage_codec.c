@@ -0,0 +1,438 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "../src/system/storage_codec.h"
+#include "../src/system/persistent_storage.h"
+#include "../src/core/kernel/config_system.h"
+#include "../src/core/tool_system/bytecode_interpreter.h"
+
+// Bytes pushed through each codec per benchmark measurement
+#define BENCH_BYTES (8 * 1024 * 1024)
+
+static uint32_t s_seed = 12345;
+
+static uint32_t next_random(void) {
+    s_seed = s_seed * 1103515245u + 12345u;
+    return s_seed >> 8;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Encode, decode and compare one value
+static size_t check_roundtrip(const void* data, size_t size) {
+    size_t capacity = storage_codec_bound(size);
+    uint8_t* blob = (uint8_t*)malloc(capacity);
+    uint8_t* out = (uint8_t*)malloc(size + 1);
+    assert(blob != NULL && out != NULL);
+
+    size_t blobSize = storage_codec_encode(data, size, blob, capacity);
+    if (blobSize > 0) {
+        size_t originalSize = 0;
+        assert(storage_codec_parse_header(blob, blobSize, NULL, &originalSize));
+        assert(originalSize == size);
+
+        size_t actual = 0;
+        assert(storage_codec_decode(blob, blobSize, out, size + 1, &actual) == 0);
+        assert(actual == size);
+        assert(size == 0 || memcmp(out, data, size) == 0);
+    }
+
+    free(blob);
+    free(out);
+    return blobSize;
+}
+
+static void test_codec_roundtrips() {
+    printf("Testing codec round trips...\n");
+
+    // Highly repetitive data shrinks with long, overlapping matches
+    static uint8_t buffer[200000];
+    memset(buffer, 'a', sizeof(buffer));
+    size_t blobSize = check_roundtrip(buffer, sizeof(buffer));
+    assert(blobSize > 0 && blobSize < 1000);
+
+    // Repeated text
+    size_t length = 0;
+    while (length + 64 < sizeof(buffer)) {
+        length += (size_t)sprintf((char*)buffer + length, "{\"key\":\"sensor.%u\",\"value\":%u},", (unsigned)(length % 97), (unsigned)(length % 13));
+    }
+    blobSize = check_roundtrip(buffer, length);
+    assert(blobSize > 0 && blobSize < length / 4);
+
+    // Random data does not shrink and stays raw
+    for (size_t i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = (uint8_t)next_random();
+    }
+    assert(check_roundtrip(buffer, sizeof(buffer)) == 0);
+
+    // Every small size, with and without repetition
+    for (size_t size = 0; size < 300; size++) {
+        for (size_t i = 0; i < size; i++) {
+            buffer[i] = (uint8_t)(i % 7 == 0 ? next_random() : 'x');
+        }
+        check_roundtrip(buffer, size);
+    }
+
+    // Text repeated beyond the 64 KB window is matched against nearer copies
+    static uint8_t payload[sizeof(buffer) + 4096];
+    static uint8_t out[sizeof(buffer)];
+    for (size_t i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = (uint8_t)(i % 3000 < 1500 ? next_random() : 'a' + (i * 7 / 3000) % 26);
+    }
+    memcpy(buffer + 100000, buffer, 1500);
+    size_t payloadSize = storage_codec_compress(STORAGE_CODEC_LZ, buffer, sizeof(buffer), payload, sizeof(payload));
+    assert(payloadSize > 0);
+    size_t actual = 0;
+    assert(storage_codec_decompress(STORAGE_CODEC_LZ, payload, payloadSize, out, sizeof(out), &actual) == 0);
+    assert(actual == sizeof(buffer) && memcmp(out, buffer, sizeof(buffer)) == 0);
+
+    // Each codec on its own
+    memset(buffer, 0, 500);
+    memcpy(buffer + 100, "literal bytes between runs", 26);
+    StorageCodec codecs[] = { STORAGE_CODEC_NONE, STORAGE_CODEC_RLE, STORAGE_CODEC_LZ };
+    for (size_t i = 0; i < 3; i++) {
+        payloadSize = storage_codec_compress(codecs[i], buffer, 500, payload, 600);
+        assert(payloadSize > 0);
+        assert(storage_codec_decompress(codecs[i], payload, payloadSize, out, 500, &actual) == 0);
+        assert(actual == 500 && memcmp(out, buffer, 500) == 0);
+
+        // A short buffer receives a prefix
+        assert(storage_codec_decompress(codecs[i], payload, payloadSize, out, 110, &actual) == 0);
+        assert(actual == 110 && memcmp(out, buffer, 110) == 0);
+
+        // Too little room to compress is reported, not overrun
+        assert(storage_codec_compress(codecs[i], buffer, 500, payload, 2) == 0);
+    }
+
+    printf("Codec round trip test passed!\n\n");
+}
+
+static void test_codec_headers() {
+    printf("Testing codec headers...\n");
+
+    // A raw value that looks like a header is wrapped so it reads back intact
+    uint8_t lookalike[32];
+    uint8_t blob[64];
+    const char* text = "abcabcabcabcabcabcabcabcabcabcabcabc";
+    size_t blobSize = storage_codec_encode(text, strlen(text), blob, sizeof(blob));
+    assert(blobSize > 0);
+    memcpy(lookalike, blob, STORAGE_CODEC_HEADER_SIZE);
+    for (size_t i = STORAGE_CODEC_HEADER_SIZE; i < sizeof(lookalike); i++) {
+        lookalike[i] = (uint8_t)next_random();
+    }
+    StorageCodec codec;
+    blobSize = storage_codec_encode(lookalike, sizeof(lookalike), blob, sizeof(blob));
+    assert(blobSize == sizeof(lookalike) + STORAGE_CODEC_HEADER_SIZE);
+    assert(storage_codec_parse_header(blob, blobSize, &codec, NULL) && codec == STORAGE_CODEC_NONE);
+    uint8_t out[64];
+    size_t actual = 0;
+    assert(storage_codec_decode(blob, blobSize, out, sizeof(out), &actual) == 0);
+    assert(actual == sizeof(lookalike) && memcmp(out, lookalike, actual) == 0);
+
+    // Unencoded and damaged headers are told apart
+    assert(storage_codec_decode("plain value", 11, out, sizeof(out), &actual) == -1);
+    blobSize = storage_codec_encode(text, strlen(text), blob, sizeof(blob));
+    blob[4] ^= 1;
+    assert(!storage_codec_parse_header(blob, blobSize, NULL, NULL));
+    assert(!storage_codec_parse_header(blob, STORAGE_CODEC_HEADER_SIZE - 1, NULL, NULL));
+
+    printf("Codec header test passed!\n\n");
+}
+
+static void test_codec_corruption() {
+    printf("Testing decoding of damaged blobs...\n");
+
+    static uint8_t value[4096];
+    size_t length = 0;
+    while (length + 40 < sizeof(value)) {
+        length += (size_t)sprintf((char*)value + length, "\"reading\":%u,\"unit\":\"C\",", (unsigned)(next_random() % 50));
+    }
+
+    static uint8_t blob[4096 + STORAGE_CODEC_HEADER_SIZE];
+    size_t blobSize = storage_codec_encode(value, length, blob, sizeof(blob));
+    assert(blobSize > 0);
+
+    // Damaged payloads must fail cleanly or decode to the right length
+    static uint8_t damaged[sizeof(blob)];
+    static uint8_t out[4096];
+    int failures = 0;
+    for (int trial = 0; trial < 20000; trial++) {
+        memcpy(damaged, blob, blobSize);
+        int flips = 1 + (int)(next_random() % 4);
+        for (int i = 0; i < flips; i++) {
+            size_t position = STORAGE_CODEC_HEADER_SIZE + next_random() % (blobSize - STORAGE_CODEC_HEADER_SIZE);
+            damaged[position] = (uint8_t)next_random();
+        }
+        size_t cut = blobSize - (trial % 3 == 0 ? next_random() % 16 : 0);
+        size_t actual = 0;
+        int result = storage_codec_decode(damaged, cut, out, sizeof(out), &actual);
+        assert(result == 0 || result == -2);
+        if (result == 0) {
+            assert(actual == length);
+        } else {
+            failures++;
+        }
+    }
+    assert(failures > 0);
+
+    printf("Damaged blob test passed!\n\n");
+}
+
+static void test_storage_compression() {
+    printf("Testing compressed persistent storage...\n");
+
+    StorageConfig config = { .type = STORAGE_TYPE_EEPROM, .size = 64 * 1024 };
+    assert(persistent_storage_init(&config) == 0);
+
+    char json[2048];
+    size_t length = 0;
+    for (int i = 0; i < 30; i++) {
+        length += (size_t)snprintf(json + length, sizeof(json) - length, "{\"channel\":%d,\"gain\":1.0},", i);
+    }
+
+    // Written before compression was enabled
+    assert(persistent_storage_write("raw", json, length) == 0);
+    assert(persistent_storage_set_compression(true) == 0);
+    assert(persistent_storage_write("packed", json, length) == 0);
+
+    StorageWriteStats stats;
+    assert(persistent_storage_get_write_stats(&stats) == 0);
+    assert(persistent_storage_get_size("packed") == (int)length);
+    assert(persistent_storage_get_size("raw") == (int)length);
+
+    char out[2048];
+    size_t actual = 0;
+    assert(persistent_storage_read("packed", out, sizeof(out), &actual) == 0);
+    assert(actual == length && memcmp(out, json, length) == 0);
+    assert(persistent_storage_read("raw", out, sizeof(out), &actual) == 0);
+    assert(actual == length && memcmp(out, json, length) == 0);
+
+    // A short buffer gets the start of the value, compressed or not
+    assert(persistent_storage_read("packed", out, 100, &actual) == 0);
+    assert(actual == 100 && memcmp(out, json, 100) == 0);
+    assert(persistent_storage_read("raw", out, 100, &actual) == 0);
+    assert(actual == 100 && memcmp(out, json, 100) == 0);
+
+    // Staged values are encoded too
+    assert(persistent_storage_begin_transaction() == 0);
+    assert(persistent_storage_write("staged", json, length) == 0);
+    assert(persistent_storage_get_size("staged") == (int)length);
+    assert(persistent_storage_read("staged", out, sizeof(out), &actual) == 0);
+    assert(actual == length && memcmp(out, json, length) == 0);
+    assert(persistent_storage_end_transaction() == 0);
+
+    // Small and incompressible values are stored as-is
+    assert(persistent_storage_write("small", "on", 2) == 0);
+    assert(persistent_storage_get_size("small") == 2);
+    assert(persistent_storage_read("small", out, sizeof(out), &actual) == 0);
+    assert(actual == 2 && memcmp(out, "on", 2) == 0);
+
+    // Compressed values take less space than their raw copies
+    int freeBefore = persistent_storage_get_free_space();
+    assert(persistent_storage_delete("packed") == 0);
+    int packedSpace = persistent_storage_get_free_space() - freeBefore;
+    freeBefore = persistent_storage_get_free_space();
+    assert(persistent_storage_delete("raw") == 0);
+    int rawSpace = persistent_storage_get_free_space() - freeBefore;
+    assert(packedSpace < rawSpace / 2);
+
+    assert(persistent_storage_deinit() == 0);
+
+    printf("Compressed persistent storage test passed!\n\n");
+}
+
+// A driver definition in the format MCP_DynamicDriverSave writes
+static size_t make_driver_json(char* json, size_t size) {
+    static const char* script =
+        "function init(config) {\\n"
+        "  bus.i2cBegin(config.sda, config.scl, config.frequency);\\n"
+        "  bus.i2cWrite(config.address, [0xF2, config.humidityOversampling]);\\n"
+        "  bus.i2cWrite(config.address, [0xF4, (config.temperatureOversampling << 5) | (config.pressureOversampling << 2) | 3]);\\n"
+        "  bus.i2cWrite(config.address, [0xF5, (config.standby << 5) | (config.filter << 2)]);\\n"
+        "  var calibration = bus.i2cRead(config.address, 0x88, 26);\\n"
+        "  state.digT1 = calibration[0] | (calibration[1] << 8);\\n"
+        "  state.digT2 = calibration[2] | (calibration[3] << 8);\\n"
+        "  state.digT3 = calibration[4] | (calibration[5] << 8);\\n"
+        "  state.digP1 = calibration[6] | (calibration[7] << 8);\\n"
+        "  state.digP2 = calibration[8] | (calibration[9] << 8);\\n"
+        "  state.digP3 = calibration[10] | (calibration[11] << 8);\\n"
+        "  return 0;\\n"
+        "}\\n"
+        "function read() {\\n"
+        "  var raw = bus.i2cRead(state.address, 0xF7, 8);\\n"
+        "  var adcP = (raw[0] << 12) | (raw[1] << 4) | (raw[2] >> 4);\\n"
+        "  var adcT = (raw[3] << 12) | (raw[4] << 4) | (raw[5] >> 4);\\n"
+        "  var adcH = (raw[6] << 8) | raw[7];\\n"
+        "  var var1 = (((adcT >> 3) - (state.digT1 << 1)) * state.digT2) >> 11;\\n"
+        "  var var2 = (((((adcT >> 4) - state.digT1) * ((adcT >> 4) - state.digT1)) >> 12) * state.digT3) >> 14;\\n"
+        "  state.tFine = var1 + var2;\\n"
+        "  return { temperature: ((state.tFine * 5 + 128) >> 8) / 100, pressure: adcP, humidity: adcH };\\n"
+        "}\\n";
+    static const char* schema =
+        "{\"type\":\"object\",\"properties\":{"
+        "\"address\":{\"type\":\"integer\",\"default\":118,\"description\":\"I2C address\"},"
+        "\"sda\":{\"type\":\"integer\",\"default\":21,\"description\":\"SDA pin\"},"
+        "\"scl\":{\"type\":\"integer\",\"default\":22,\"description\":\"SCL pin\"},"
+        "\"frequency\":{\"type\":\"integer\",\"default\":400000,\"description\":\"I2C clock in Hz\"},"
+        "\"temperatureOversampling\":{\"type\":\"integer\",\"default\":1,\"minimum\":0,\"maximum\":5},"
+        "\"pressureOversampling\":{\"type\":\"integer\",\"default\":1,\"minimum\":0,\"maximum\":5},"
+        "\"humidityOversampling\":{\"type\":\"integer\",\"default\":1,\"minimum\":0,\"maximum\":5},"
+        "\"standby\":{\"type\":\"integer\",\"default\":5,\"minimum\":0,\"maximum\":7},"
+        "\"filter\":{\"type\":\"integer\",\"default\":0,\"minimum\":0,\"maximum\":4}}}";
+
+    return (size_t)snprintf(json, size,
+                            "{\"id\":\"bme280\",\"name\":\"BME280 environmental sensor\",\"version\":\"1.2.0\","
+                            "\"type\":1,\"implementation\":{\"script\":\"%s\"},\"configSchema\":%s,\"persistent\":true}",
+                            script, schema);
+}
+
+// A configuration export from MCP_ConfigExportJson
+static size_t make_config_export(char* json, size_t size) {
+    static bool initialized = false;
+    if (!initialized) {
+        assert(MCP_ConfigInit(128) == 0);
+        char key[48];
+        for (int i = 0; i < 100; i++) {
+            snprintf(key, sizeof(key), "%s.%s%d", i % 3 == 0 ? "network" : (i % 3 == 1 ? "sensor" : "system"),
+                     i % 2 == 0 ? "interval" : "label", i);
+            if (i % 2 == 0) {
+                assert(MCP_ConfigSetInt(key, 1000 + i * 250, false) == 0);
+            } else {
+                assert(MCP_ConfigSetString(key, i % 4 == 1 ? "greenhouse-north" : "enabled", false) == 0);
+            }
+        }
+        initialized = true;
+    }
+
+    int length = MCP_ConfigExportJson(json, size);
+    assert(length > 0);
+    return (size_t)length;
+}
+
+// A compiled program image: instructions followed by a string pool
+static size_t make_bytecode_image(uint8_t* image, size_t size) {
+    static const char* strings[] = { "temperature", "humidity", "pressure", "threshold", "fan", "heater", "alert" };
+    size_t count = 0;
+    size_t maxInstructions = (size - 256) / sizeof(MCP_BytecodeInstruction);
+    MCP_BytecodeInstruction* instructions = (MCP_BytecodeInstruction*)image;
+    memset(image, 0, size);
+
+    // Rules of the form: if (sensor > threshold) { set actuator; } repeated with varying operands
+    for (uint16_t rule = 0; count + 8 <= maxInstructions && rule < 120; rule++) {
+        instructions[count].opcode = MCP_BYTECODE_OP_PUSH_VAR;
+        instructions[count++].operand.variableIndex = rule % 3;
+        instructions[count].opcode = MCP_BYTECODE_OP_PUSH_NUM;
+        instructions[count++].operand.numberValue = 20.0 + rule % 15;
+        instructions[count++].opcode = MCP_BYTECODE_OP_GT;
+        instructions[count].opcode = MCP_BYTECODE_OP_JUMP_IF_NOT;
+        instructions[count].operand.jumpAddress = (uint16_t)(count + 4);
+        count++;
+        instructions[count].opcode = MCP_BYTECODE_OP_PUSH_BOOL;
+        instructions[count++].operand.boolValue = rule % 2 == 0;
+        instructions[count].opcode = MCP_BYTECODE_OP_SET_VAR;
+        instructions[count++].operand.variableIndex = 4 + rule % 3;
+        instructions[count].opcode = MCP_BYTECODE_OP_PUSH_STR;
+        instructions[count++].operand.stringIndex = 6;
+        instructions[count++].opcode = MCP_BYTECODE_OP_POP;
+    }
+    instructions[count++].opcode = MCP_BYTECODE_OP_HALT;
+
+    size_t length = count * sizeof(MCP_BytecodeInstruction);
+    for (size_t i = 0; i < sizeof(strings) / sizeof(strings[0]); i++) {
+        size_t stringLength = strlen(strings[i]) + 1;
+        memcpy(image + length, strings[i], stringLength);
+        length += stringLength;
+    }
+    return length;
+}
+
+static void bench_codec(const char* label, const uint8_t* data, size_t size) {
+    size_t capacity = storage_codec_bound(size);
+    uint8_t* payload = (uint8_t*)malloc(capacity);
+    uint8_t* out = (uint8_t*)malloc(size);
+    assert(payload != NULL && out != NULL);
+
+    int rounds = (int)(BENCH_BYTES / size) + 1;
+    StorageCodec codecs[] = { STORAGE_CODEC_RLE, STORAGE_CODEC_LZ };
+    const char* names[] = { "RLE", "LZ" };
+
+    for (int c = 0; c < 2; c++) {
+        size_t payloadSize = 0;
+        double start = now_seconds();
+        for (int i = 0; i < rounds; i++) {
+            payloadSize = storage_codec_compress(codecs[c], data, size, payload, capacity);
+        }
+        double compressTime = now_seconds() - start;
+        if (payloadSize == 0) {
+            printf("  %-22s %-4s %7zu %8s\n", label, names[c], size, "no fit");
+            continue;
+        }
+
+        size_t actual = 0;
+        start = now_seconds();
+        for (int i = 0; i < rounds; i++) {
+            assert(storage_codec_decompress(codecs[c], payload, payloadSize, out, size, &actual) == 0);
+        }
+        double decompressTime = now_seconds() - start;
+        assert(actual == size && memcmp(out, data, size) == 0);
+
+        double megabytes = (double)size * rounds / (1024.0 * 1024.0);
+        printf("  %-22s %-4s %7zu %8zu %7.2fx %10.0f %10.0f\n", label, names[c], size, payloadSize,
+               (double)size / payloadSize, megabytes / compressTime, megabytes / decompressTime);
+    }
+
+    free(payload);
+    free(out);
+}
+
+static size_t load_file(const char* path, uint8_t* buffer, size_t size) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+    size_t length = fread(buffer, 1, size, file);
+    fclose(file);
+    return length;
+}
+
+static void bench_codecs() {
+    printf("Benchmarking codecs on stored payloads (bytes, ratio, MB/s)...\n");
+    printf("  %-22s %-4s %7s %8s %8s %10s %10s\n", "payload", "", "size", "encoded", "ratio", "compress", "decompress");
+
+    static char text[16384];
+    size_t length = make_driver_json(text, sizeof(text));
+    bench_codec("driver JSON", (const uint8_t*)text, length);
+
+    length = load_file("docs/examples/no_code_setup_sequence.json", (uint8_t*)text, sizeof(text));
+    if (length > 0) {
+        bench_codec("setup sequence JSON", (const uint8_t*)text, length);
+    }
+
+    length = make_config_export(text, sizeof(text));
+    bench_codec("config export", (const uint8_t*)text, length);
+
+    static uint8_t image[16384];
+    length = make_bytecode_image(image, sizeof(image));
+    bench_codec("bytecode image", image, length);
+    printf("\n");
+}
+
+int main() {
+    printf("=== Storage Codec Tests ===\n\n");
+
+    test_codec_roundtrips();
+    test_codec_headers();
+    test_codec_corruption();
+    test_storage_compression();
+    bench_codecs();
+
+    printf("All storage codec tests passed!\n");
+    return 0;
+}
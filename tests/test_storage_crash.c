@@ -0,0 +1,604 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "../src/system/storage_directory.h"
+#include "../src/system/storage_log.h"
+#include "../src/system/persistent_storage.h"
+
+// Keys of the crash workloads; values are derived from a seed so any state can be checked
+#define CRASH_KEYS 12
+#define MAX_VALUE 160
+
+#define DIRECTORY_MEDIUM_SIZE (16 * 1024)
+#define LOG_MEDIUM_SIZE (8 * 1024)
+#define LOG_SEGMENT_SIZE 1024
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Medium that loses power after a byte budget: the write or erase crossing the
+// budget is applied partially and every later one is dropped
+typedef struct {
+    uint8_t* buffer;
+    long budget;        // Bytes that still reach the medium, -1 for unlimited
+    long written;
+    bool cut;
+    bool failWrites;    // Writes report an error and change nothing
+} FaultMedium;
+
+static size_t fault_consume(FaultMedium* fault, size_t size) {
+    size_t applied = size;
+    if (fault->budget >= 0) {
+        if ((long)size > fault->budget) {
+            applied = (size_t)fault->budget;
+            fault->cut = true;
+        }
+        fault->budget -= (long)applied;
+    }
+    fault->written += (long)applied;
+    return applied;
+}
+
+static int fault_read(void* context, uint32_t offset, void* data, size_t size) {
+    FaultMedium* fault = (FaultMedium*)context;
+    memcpy(data, fault->buffer + offset, size);
+    return 0;
+}
+
+static int fault_write(void* context, uint32_t offset, const void* data, size_t size) {
+    FaultMedium* fault = (FaultMedium*)context;
+    if (fault->failWrites) {
+        return -1;
+    }
+    memcpy(fault->buffer + offset, data, fault_consume(fault, size));
+    return 0;
+}
+
+static int fault_erase(void* context, uint32_t offset, uint32_t size) {
+    FaultMedium* fault = (FaultMedium*)context;
+    memset(fault->buffer + offset, 0xFF, fault_consume(fault, size));
+    return 0;
+}
+
+static void init_fault_medium(StorageMedium* medium, FaultMedium* fault, uint8_t* buffer, uint32_t size, long budget) {
+    fault->buffer = buffer;
+    fault->budget = budget;
+    fault->written = 0;
+    fault->cut = false;
+    fault->failWrites = false;
+    medium->read = fault_read;
+    medium->write = fault_write;
+    medium->erase = fault_erase;
+    medium->sync = NULL;
+    medium->context = fault;
+    medium->size = size;
+}
+
+// ===== Key model =====
+
+typedef struct {
+    int key;
+    int size;           // -1 to delete
+    int seed;
+} CrashOp;
+
+typedef struct {
+    bool present[CRASH_KEYS];
+    int size[CRASH_KEYS];
+    int seed[CRASH_KEYS];
+} KeyState;
+
+static void key_name(char* name, size_t length, int key) {
+    snprintf(name, length, "crash.%d", key);
+}
+
+static void fill_value(uint8_t* value, int size, int seed) {
+    for (int i = 0; i < size; i++) {
+        value[i] = (uint8_t)(seed * 37 + i * 11);
+    }
+}
+
+static void state_apply(KeyState* state, const CrashOp* ops, int count) {
+    for (int i = 0; i < count; i++) {
+        state->present[ops[i].key] = ops[i].size >= 0;
+        state->size[ops[i].key] = ops[i].size;
+        state->seed[ops[i].key] = ops[i].seed;
+    }
+}
+
+// ===== Layouts under test =====
+
+typedef struct {
+    const char* name;
+    uint32_t mediumSize;
+    void* (*mount)(const StorageMedium* medium);
+    void (*unmount)(void* store);
+    int (*commit)(void* store, const CrashOp* ops, int count);
+    int (*read)(void* store, const char* key, void* data, size_t maxSize, size_t* actualSize);
+    int (*key_count)(void* store);
+} CrashLayout;
+
+static int apply_op(void* store, const CrashOp* op,
+                    int (*write)(void*, const char*, const void*, size_t),
+                    int (*remove)(void*, const char*)) {
+    char key[24];
+    key_name(key, sizeof(key), op->key);
+    if (op->size < 0) {
+        int result = remove(store, key);
+        return result == -2 ? 0 : result;
+    }
+
+    uint8_t value[MAX_VALUE];
+    fill_value(value, op->size, op->seed);
+    return write(store, key, value, (size_t)op->size);
+}
+
+static void* directory_mount(const StorageMedium* medium) {
+    return storage_directory_mount(medium, 32);
+}
+
+static void directory_unmount(void* store) {
+    storage_directory_unmount((StorageDirectory*)store);
+}
+
+static int directory_write(void* store, const char* key, const void* data, size_t size) {
+    return storage_directory_write((StorageDirectory*)store, key, data, size);
+}
+
+static int directory_delete(void* store, const char* key) {
+    return storage_directory_delete((StorageDirectory*)store, key);
+}
+
+static int directory_commit(void* store, const CrashOp* ops, int count) {
+    for (int i = 0; i < count; i++) {
+        int result = apply_op(store, &ops[i], directory_write, directory_delete);
+        if (result != 0) {
+            return result;
+        }
+    }
+    return storage_directory_commit((StorageDirectory*)store);
+}
+
+static int directory_read(void* store, const char* key, void* data, size_t maxSize, size_t* actualSize) {
+    return storage_directory_read((StorageDirectory*)store, key, data, maxSize, actualSize);
+}
+
+static int directory_key_count(void* store) {
+    char* keys[CRASH_KEYS + 4];
+    int count = storage_directory_get_keys((StorageDirectory*)store, NULL, keys, CRASH_KEYS + 4);
+    for (int i = 0; i < count; i++) {
+        free(keys[i]);
+    }
+    return count;
+}
+
+static void* log_mount(const StorageMedium* medium) {
+    return storage_log_mount(medium, LOG_SEGMENT_SIZE);
+}
+
+static void log_unmount(void* store) {
+    storage_log_unmount((StorageLog*)store);
+}
+
+static int log_write(void* store, const char* key, const void* data, size_t size) {
+    return storage_log_write((StorageLog*)store, key, data, size);
+}
+
+static int log_delete(void* store, const char* key) {
+    return storage_log_delete((StorageLog*)store, key);
+}
+
+static int log_commit(void* store, const CrashOp* ops, int count) {
+    StorageLog* log = (StorageLog*)store;
+    int result = storage_log_begin_batch(log);
+    for (int i = 0; i < count && result == 0; i++) {
+        result = apply_op(store, &ops[i], log_write, log_delete);
+    }
+    if (result != 0) {
+        storage_log_abort_batch(log);
+        return result;
+    }
+    return storage_log_end_batch(log);
+}
+
+static int log_read(void* store, const char* key, void* data, size_t maxSize, size_t* actualSize) {
+    return storage_log_read((StorageLog*)store, key, data, maxSize, actualSize);
+}
+
+static int log_key_count(void* store) {
+    StorageLogStats stats;
+    storage_log_get_stats((StorageLog*)store, &stats);
+    return (int)stats.keyCount;
+}
+
+static const CrashLayout s_directoryLayout = {
+    "directory", DIRECTORY_MEDIUM_SIZE, directory_mount, directory_unmount, directory_commit,
+    directory_read, directory_key_count
+};
+
+static const CrashLayout s_logLayout = {
+    "log", LOG_MEDIUM_SIZE, log_mount, log_unmount, log_commit, log_read, log_key_count
+};
+
+static bool state_matches(const CrashLayout* layout, void* store, const KeyState* state) {
+    char key[24];
+    uint8_t expected[MAX_VALUE];
+    uint8_t actual[MAX_VALUE];
+    int keys = 0;
+
+    for (int k = 0; k < CRASH_KEYS; k++) {
+        key_name(key, sizeof(key), k);
+        size_t size = 0;
+        int result = layout->read(store, key, actual, sizeof(actual), &size);
+        if (!state->present[k]) {
+            if (result != -2) {
+                return false;
+            }
+            continue;
+        }
+
+        fill_value(expected, state->size[k], state->seed[k]);
+        if (result != 0 || size != (size_t)state->size[k] || memcmp(actual, expected, size) != 0) {
+            return false;
+        }
+        keys++;
+    }
+    return layout->key_count(store) == keys;
+}
+
+// ===== Power cut at every byte =====
+
+typedef struct {
+    const CrashOp* base;    // Committed one op at a time to set up the medium
+    int baseCount;
+    const CrashOp* update;  // Committed as one group under test
+    int updateCount;
+} CrashWorkload;
+
+static void run_power_cuts(const CrashLayout* layout, const char* label, const CrashWorkload* workload) {
+    uint8_t* base = (uint8_t*)malloc(layout->mediumSize);
+    uint8_t* buffer = (uint8_t*)malloc(layout->mediumSize);
+    assert(base != NULL && buffer != NULL);
+    StorageMedium medium;
+    FaultMedium fault;
+
+    // Medium holding the state before the update
+    memset(base, 0xFF, layout->mediumSize);
+    init_fault_medium(&medium, &fault, base, layout->mediumSize, -1);
+    void* store = layout->mount(&medium);
+    assert(store != NULL);
+    KeyState before;
+    memset(&before, 0, sizeof(before));
+    for (int i = 0; i < workload->baseCount; i++) {
+        assert(layout->commit(store, &workload->base[i], 1) == 0);
+    }
+    state_apply(&before, workload->base, workload->baseCount);
+    assert(state_matches(layout, store, &before));
+    layout->unmount(store);
+
+    KeyState after = before;
+    state_apply(&after, workload->update, workload->updateCount);
+
+    // Dry run to size the write stream of the update
+    memcpy(buffer, base, layout->mediumSize);
+    init_fault_medium(&medium, &fault, buffer, layout->mediumSize, -1);
+    store = layout->mount(&medium);
+    assert(store != NULL);
+    long mountBytes = fault.written;
+    assert(layout->commit(store, workload->update, workload->updateCount) == 0);
+    assert(state_matches(layout, store, &after));
+    layout->unmount(store);
+    long total = fault.written - mountBytes;
+
+    int oldStates = 0;
+    int newStates = 0;
+    double recoverTotal = 0;
+    double recoverMax = 0;
+
+    for (long cut = 0; cut <= total; cut++) {
+        memcpy(buffer, base, layout->mediumSize);
+        init_fault_medium(&medium, &fault, buffer, layout->mediumSize, mountBytes + cut);
+        store = layout->mount(&medium);
+        assert(store != NULL);
+
+        // Once the power is cut the store works from stale media, so the result is moot
+        int result = layout->commit(store, workload->update, workload->updateCount);
+        assert(fault.cut || result == 0);
+        layout->unmount(store);
+
+        // Power back on
+        init_fault_medium(&medium, &fault, buffer, layout->mediumSize, -1);
+        double start = now_seconds();
+        store = layout->mount(&medium);
+        double elapsed = now_seconds() - start;
+        assert(store != NULL);
+        recoverTotal += elapsed;
+        recoverMax = elapsed > recoverMax ? elapsed : recoverMax;
+
+        // All of the update or none of it, never a mix
+        bool isNew = state_matches(layout, store, &after);
+        bool isOld = !isNew && state_matches(layout, store, &before);
+        if (!isNew && !isOld) {
+            printf("  %s, %s: inconsistent state after a cut at byte %ld of %ld\n", layout->name, label, cut, total);
+        }
+        assert(isNew || isOld);
+        assert(cut < total || isNew);
+        newStates += isNew;
+        oldStates += isOld;
+
+        // The recovered store takes another commit and keeps it across a remount
+        CrashOp extra = { CRASH_KEYS - 1, 24, 900 + (int)(cut % 50) };
+        KeyState expected = isNew ? after : before;
+        state_apply(&expected, &extra, 1);
+        assert(layout->commit(store, &extra, 1) == 0);
+        layout->unmount(store);
+        store = layout->mount(&medium);
+        assert(store != NULL && state_matches(layout, store, &expected));
+        layout->unmount(store);
+    }
+
+    printf("  %-9s %-18s %5ld cuts: %5d old, %5d new; recovery mount mean %5.1f us, max %5.1f us\n",
+           layout->name, label, total + 1, oldStates, newStates,
+           recoverTotal / (total + 1) * 1e6, recoverMax * 1e6);
+    free(base);
+    free(buffer);
+}
+
+static const CrashOp s_baseOps[] = {
+    {0, 40, 1}, {1, 48, 2}, {2, 56, 3}, {3, 64, 4}, {4, 72, 5}, {5, 80, 6}, {6, 88, 7}, {7, 96, 8}
+};
+
+// Same size as before, which the old directory rewrote in place
+static const CrashOp s_singleOps[] = {
+    {2, 56, 31}
+};
+
+static const CrashOp s_groupOps[] = {
+    {0, 120, 21},   // Grows
+    {1, 10, 22},    // Shrinks
+    {2, 56, 23},    // Same size
+    {8, 64, 24},    // New
+    {9, 0, 25},     // New and empty
+    {3, -1, 0},     // Deleted
+    {4, -1, 0},
+    {6, 30, 26},    // Written twice
+    {6, 50, 27},
+    {10, 80, 28},   // New, then deleted again
+    {10, -1, 0}
+};
+
+static void test_power_cuts() {
+    printf("Testing power cuts at every byte of single and group commits...\n");
+
+    CrashWorkload single = { s_baseOps, 8, s_singleOps, 1 };
+    CrashWorkload group = { s_baseOps, 8, s_groupOps, (int)(sizeof(s_groupOps) / sizeof(s_groupOps[0])) };
+    run_power_cuts(&s_directoryLayout, "single key", &single);
+    run_power_cuts(&s_directoryLayout, "group of 11", &group);
+    run_power_cuts(&s_logLayout, "single key", &single);
+    run_power_cuts(&s_logLayout, "group of 11", &group);
+
+    printf("Power cut test passed!\n\n");
+}
+
+static void test_power_cuts_during_compaction() {
+    printf("Testing power cuts while a log batch forces compaction...\n");
+
+    // Churn fills most segments with dead records, so the batch has to
+    // compact while it is open and its records cross segments
+    static CrashOp churn[120];
+    for (int i = 0; i < 120; i++) {
+        churn[i].key = i % 8;
+        churn[i].size = 40 + (i * 13) % 100;
+        churn[i].seed = 100 + i;
+    }
+    static CrashOp batch[16];
+    for (int i = 0; i < 16; i++) {
+        batch[i].key = i % CRASH_KEYS;
+        batch[i].size = i % 7 == 6 ? -1 : 60 + (i * 17) % 90;
+        batch[i].seed = 500 + i;
+    }
+
+    // Make sure the batch really compacts
+    uint8_t* buffer = (uint8_t*)malloc(LOG_MEDIUM_SIZE);
+    memset(buffer, 0xFF, LOG_MEDIUM_SIZE);
+    StorageMedium medium;
+    storage_medium_init_memory(&medium, buffer, LOG_MEDIUM_SIZE);
+    StorageLog* log = storage_log_mount(&medium, LOG_SEGMENT_SIZE);
+    for (int i = 0; i < 120; i++) {
+        assert(log_commit(log, &churn[i], 1) == 0);
+    }
+    StorageLogStats before;
+    storage_log_get_stats(log, &before);
+    assert(log_commit(log, batch, 16) == 0);
+    StorageLogStats after;
+    storage_log_get_stats(log, &after);
+    assert(after.segmentsErased > before.segmentsErased);
+    storage_log_unmount(log);
+    free(buffer);
+
+    CrashWorkload workload = { churn, 120, batch, 16 };
+    run_power_cuts(&s_logLayout, "group of 16", &workload);
+
+    printf("Compaction power cut test passed!\n\n");
+}
+
+static void test_batch_semantics() {
+    printf("Testing log batches and directory rollback...\n");
+
+    uint8_t* buffer = (uint8_t*)malloc(LOG_MEDIUM_SIZE);
+    memset(buffer, 0xFF, LOG_MEDIUM_SIZE);
+    StorageMedium medium;
+    storage_medium_init_memory(&medium, buffer, LOG_MEDIUM_SIZE);
+    StorageLog* log = storage_log_mount(&medium, LOG_SEGMENT_SIZE);
+    assert(log != NULL);
+
+    int one = 1;
+    int two = 2;
+    int value = 0;
+    size_t actual = 0;
+    assert(storage_log_write(log, "a", &one, sizeof(one)) == 0);
+    assert(storage_log_end_batch(log) == -2);
+
+    // Readers see the store without the open batch
+    assert(storage_log_begin_batch(log) == 0);
+    assert(storage_log_begin_batch(log) == -2);
+    assert(storage_log_write(log, "a", &two, sizeof(two)) == 0);
+    assert(storage_log_write(log, "b", &two, sizeof(two)) == 0);
+    assert(storage_log_read(log, "a", &value, sizeof(value), &actual) == 0 && value == 1);
+    assert(!storage_log_exists(log, "b"));
+    assert(storage_log_delete(log, "b") == 0);
+    assert(storage_log_delete(log, "b") == -2);
+    assert(storage_log_end_batch(log) == 0);
+    assert(storage_log_read(log, "a", &value, sizeof(value), &actual) == 0 && value == 2);
+    assert(!storage_log_exists(log, "b"));
+
+    // An aborted batch is gone, now and after a remount
+    assert(storage_log_begin_batch(log) == 0);
+    assert(storage_log_write(log, "c", &one, sizeof(one)) == 0);
+    assert(storage_log_delete(log, "a") == 0);
+    assert(storage_log_abort_batch(log) == 0);
+    assert(storage_log_write(log, "d", &one, sizeof(one)) == 0);
+    assert(!storage_log_exists(log, "c") && storage_log_exists(log, "a"));
+    storage_log_unmount(log);
+
+    log = storage_log_mount(&medium, LOG_SEGMENT_SIZE);
+    StorageLogStats stats;
+    storage_log_get_stats(log, &stats);
+    assert(stats.keyCount == 2 && stats.batchesDiscarded == 1);
+    assert(!storage_log_exists(log, "c") && storage_log_exists(log, "d"));
+    assert(storage_log_read(log, "a", &value, sizeof(value), &actual) == 0 && value == 2);
+    storage_log_unmount(log);
+    free(buffer);
+
+    // Directory rollback rereads the committed table and frees what was written since
+    buffer = (uint8_t*)malloc(DIRECTORY_MEDIUM_SIZE);
+    memset(buffer, 0xFF, DIRECTORY_MEDIUM_SIZE);
+    storage_medium_init_memory(&medium, buffer, DIRECTORY_MEDIUM_SIZE);
+    StorageDirectory* directory = storage_directory_mount(&medium, 16);
+    assert(directory != NULL);
+    assert(storage_directory_write(directory, "a", &one, sizeof(one)) == 0);
+    assert(storage_directory_commit(directory) == 0);
+    int freeSpace = storage_directory_get_free_space(directory);
+
+    assert(storage_directory_write(directory, "a", &two, sizeof(two)) == 0);
+    assert(storage_directory_write(directory, "b", &two, sizeof(two)) == 0);
+    assert(storage_directory_delete(directory, "a") == 0);
+    assert(storage_directory_rollback(directory) == 0);
+    assert(storage_directory_read(directory, "a", &value, sizeof(value), &actual) == 0 && value == 1);
+    assert(!storage_directory_exists(directory, "b"));
+    assert(storage_directory_get_free_space(directory) == freeSpace);
+    storage_directory_unmount(directory);
+    free(buffer);
+
+    printf("Batch semantics test passed!\n\n");
+}
+
+static void test_directory_write_errors() {
+    printf("Testing directory writes that fail on the medium...\n");
+
+    uint8_t* buffer = (uint8_t*)malloc(DIRECTORY_MEDIUM_SIZE);
+    memset(buffer, 0xFF, DIRECTORY_MEDIUM_SIZE);
+    StorageMedium medium;
+    FaultMedium fault;
+    init_fault_medium(&medium, &fault, buffer, DIRECTORY_MEDIUM_SIZE, -1);
+    StorageDirectory* directory = storage_directory_mount(&medium, 32);
+    assert(directory != NULL);
+
+    uint8_t value[MAX_VALUE];
+    uint8_t expected[MAX_VALUE];
+    size_t actual = 0;
+    fill_value(expected, MAX_VALUE, 1);
+    assert(storage_directory_write(directory, "kept", expected, MAX_VALUE) == 0);
+    assert(storage_directory_commit(directory) == 0);
+    int freeSpace = storage_directory_get_free_space(directory);
+
+    // The failed write must not hand the committed extent to the next commit
+    fault.failWrites = true;
+    fill_value(value, MAX_VALUE, 2);
+    assert(storage_directory_write(directory, "kept", value, MAX_VALUE) == -5);
+    fault.failWrites = false;
+    assert(storage_directory_get_free_space(directory) == freeSpace);
+    assert(storage_directory_write(directory, "other", value, MAX_VALUE) == 0);
+    assert(storage_directory_commit(directory) == 0);
+
+    // Fill every byte that is free now; none of it may be the kept value's
+    char key[24];
+    int filled = 0;
+    for (;;) {
+        snprintf(key, sizeof(key), "fill.%d", filled);
+        if (storage_directory_write(directory, key, value, MAX_VALUE) != 0) {
+            break;
+        }
+        filled++;
+    }
+    assert(filled > 0);
+    assert(storage_directory_commit(directory) == 0);
+    assert(storage_directory_read(directory, "kept", value, sizeof(value), &actual) == 0);
+    assert(actual == MAX_VALUE && memcmp(value, expected, MAX_VALUE) == 0);
+    storage_directory_unmount(directory);
+
+    directory = storage_directory_mount(&medium, 32);
+    assert(directory != NULL);
+    assert(storage_directory_read(directory, "kept", value, sizeof(value), &actual) == 0);
+    assert(actual == MAX_VALUE && memcmp(value, expected, MAX_VALUE) == 0);
+    storage_directory_unmount(directory);
+    free(buffer);
+
+    printf("Directory write error test passed!\n\n");
+}
+
+static void test_persistent_storage_groups() {
+    printf("Testing atomic group commits through persistent storage...\n");
+
+    StorageType types[] = { STORAGE_TYPE_EEPROM, STORAGE_TYPE_FLASH };
+    for (int t = 0; t < 2; t++) {
+        StorageConfig config;
+        memset(&config, 0, sizeof(config));
+        config.type = types[t];
+        config.size = 64 * 1024;
+        assert(persistent_storage_init(&config) == 0);
+
+        int one = 1;
+        int value = 0;
+        size_t actual = 0;
+        assert(persistent_storage_write("kept", &one, sizeof(one)) == 0);
+
+        // A group with an entry the backend refuses applies none of its entries
+        static uint8_t huge[128 * 1024];
+        assert(persistent_storage_begin_transaction() == 0);
+        assert(persistent_storage_write("first", &one, sizeof(one)) == 0);
+        assert(persistent_storage_write("huge", huge, sizeof(huge)) == 0);
+        assert(persistent_storage_delete("kept") == 0);
+        assert(persistent_storage_end_transaction() != 0);
+        assert(!persistent_storage_exists("first") && !persistent_storage_exists("huge"));
+        assert(persistent_storage_read("kept", &value, sizeof(value), &actual) == 0 && value == 1);
+
+        assert(persistent_storage_begin_transaction() == 0);
+        assert(persistent_storage_write("first", &one, sizeof(one)) == 0);
+        assert(persistent_storage_delete("kept") == 0);
+        assert(persistent_storage_end_transaction() == 0);
+        assert(persistent_storage_exists("first") && !persistent_storage_exists("kept"));
+        assert(persistent_storage_deinit() == 0);
+    }
+
+    printf("Persistent storage group commit test passed!\n\n");
+}
+
+int main() {
+    printf("=== Storage Crash Consistency Tests ===\n\n");
+
+    test_batch_semantics();
+    test_directory_write_errors();
+    test_persistent_storage_groups();
+    test_power_cuts();
+    test_power_cuts_during_compaction();
+
+    printf("All storage crash consistency tests passed!\n");
+    return 0;
+}
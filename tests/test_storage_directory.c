@@ -0,0 +1,619 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "../src/system/storage_directory.h"
+#include "../src/system/persistent_storage.h"
+
+// Space churn workload
+#define CHURN_KEYS 64
+#define CHURN_OPS 20000
+#define CHURN_MAX_VALUE 200
+
+// Lookups per directory size in the benchmark
+#define BENCH_LOOKUPS 200000
+#define BENCH_ENUMERATIONS 50
+#define BENCH_GROUPS 16
+
+// Slot and header sizes on the medium, used to find them when damaging a table
+#define SLOT_BYTES 64
+#define HEADER_BYTES 32
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint8_t* new_medium(StorageMedium* medium, uint32_t size) {
+    uint8_t* buffer = (uint8_t*)malloc(size);
+    assert(buffer != NULL);
+    memset(buffer, 0xFF, size);
+    assert(storage_medium_init_memory(medium, buffer, size) == 0);
+    return buffer;
+}
+
+// Medium over a RAM medium whose writes can be made to fail without writing anything
+typedef struct {
+    StorageMedium inner;
+    bool failWrites;
+} FailingMedium;
+
+static int failing_read(void* context, uint32_t offset, void* data, size_t size) {
+    FailingMedium* failing = (FailingMedium*)context;
+    return failing->inner.read(failing->inner.context, offset, data, size);
+}
+
+static int failing_write(void* context, uint32_t offset, const void* data, size_t size) {
+    FailingMedium* failing = (FailingMedium*)context;
+    if (failing->failWrites) {
+        return -1;
+    }
+    return failing->inner.write(failing->inner.context, offset, data, size);
+}
+
+static int failing_erase(void* context, uint32_t offset, uint32_t size) {
+    FailingMedium* failing = (FailingMedium*)context;
+    return failing->inner.erase(failing->inner.context, offset, size);
+}
+
+static uint8_t* new_failing_medium(StorageMedium* medium, FailingMedium* failing, uint32_t size) {
+    uint8_t* buffer = new_medium(&failing->inner, size);
+    failing->failWrites = false;
+    *medium = failing->inner;
+    medium->read = failing_read;
+    medium->write = failing_write;
+    medium->erase = failing_erase;
+    medium->sync = NULL;
+    medium->context = failing;
+    return buffer;
+}
+
+static void free_keys(char** keys, int count) {
+    for (int i = 0; i < count; i++) {
+        free(keys[i]);
+    }
+}
+
+static void test_basic_operations() {
+    printf("Testing basic directory operations...\n");
+
+    StorageMedium medium;
+    uint8_t* buffer = new_medium(&medium, 64 * 1024);
+    StorageDirectory* directory = storage_directory_mount(&medium, 0);
+    assert(directory != NULL);
+    assert(storage_directory_get_capacity(directory) >= 32);
+    int emptySpace = storage_directory_get_free_space(directory);
+
+    uint8_t value[256];
+    for (int i = 0; i < (int)sizeof(value); i++) {
+        value[i] = (uint8_t)i;
+    }
+
+    assert(storage_directory_write(directory, "alpha", value, 100) == 0);
+    assert(storage_directory_write(directory, "beta", value, 10) == 0);
+    assert(storage_directory_write(directory, "empty", value, 0) == 0);
+    assert(storage_directory_exists(directory, "alpha"));
+    assert(!storage_directory_exists(directory, "gamma"));
+    assert(storage_directory_get_size(directory, "alpha") == 100);
+    assert(storage_directory_get_size(directory, "empty") == 0);
+    assert(storage_directory_get_free_space(directory) == emptySpace - 110);
+
+    // Shrinking rewrites in place, growing moves the value
+    assert(storage_directory_write(directory, "alpha", value + 1, 50) == 0);
+    assert(storage_directory_write(directory, "beta", value + 2, 200) == 0);
+    assert(storage_directory_get_free_space(directory) == emptySpace - 250);
+
+    uint8_t out[256];
+    size_t actual = 0;
+    assert(storage_directory_read(directory, "alpha", out, sizeof(out), &actual) == 0);
+    assert(actual == 50 && memcmp(out, value + 1, 50) == 0);
+    assert(storage_directory_read(directory, "beta", out, 20, &actual) == 0);
+    assert(actual == 20 && memcmp(out, value + 2, 20) == 0);
+    assert(storage_directory_read(directory, "gamma", out, sizeof(out), &actual) == -2);
+
+    char longKey[STORAGE_DIRECTORY_MAX_KEY_LENGTH + 2];
+    memset(longKey, 'k', sizeof(longKey) - 1);
+    longKey[sizeof(longKey) - 1] = '\0';
+    assert(storage_directory_write(directory, longKey, value, 4) == -4);
+    assert(!storage_directory_exists(directory, longKey));
+    longKey[STORAGE_DIRECTORY_MAX_KEY_LENGTH] = '\0';
+    assert(storage_directory_write(directory, longKey, value, 4) == 0);
+
+    assert(storage_directory_delete(directory, "empty") == 0);
+    assert(storage_directory_delete(directory, "empty") == -2);
+    assert(storage_directory_commit(directory) == 0);
+
+    // Changes after the last commit do not reach the table on the medium
+    assert(storage_directory_write(directory, "uncommitted", value, 8) == 0);
+    storage_directory_unmount(directory);
+
+    directory = storage_directory_mount(&medium, 0);
+    assert(directory != NULL);
+    assert(!storage_directory_exists(directory, "uncommitted"));
+    assert(storage_directory_read(directory, "beta", out, sizeof(out), &actual) == 0);
+    assert(actual == 200 && memcmp(out, value + 2, 200) == 0);
+    assert(storage_directory_exists(directory, longKey));
+    assert(storage_directory_get_free_space(directory) == emptySpace - 254);
+
+    assert(storage_directory_clear(directory) == 0);
+    assert(!storage_directory_exists(directory, "alpha"));
+    assert(storage_directory_get_free_space(directory) == emptySpace);
+    storage_directory_unmount(directory);
+    free(buffer);
+
+    printf("Basic directory operations test passed!\n\n");
+}
+
+static void test_many_keys() {
+    printf("Testing thousands of keys...\n");
+
+    StorageMedium medium;
+    uint8_t* buffer = new_medium(&medium, 2 * 1024 * 1024);
+    StorageDirectory* directory = storage_directory_mount(&medium, 5000);
+    assert(directory != NULL);
+    int capacity = storage_directory_get_capacity(directory);
+    assert(capacity >= 5000);
+
+    char key[32];
+    for (int i = 0; i < 5000; i++) {
+        snprintf(key, sizeof(key), "item.%d", i);
+        assert(storage_directory_write(directory, key, &i, sizeof(i)) == 0);
+    }
+
+    // Deleting shifts probe chains back; every other key must stay reachable
+    for (int i = 0; i < 5000; i += 3) {
+        snprintf(key, sizeof(key), "item.%d", i);
+        assert(storage_directory_delete(directory, key) == 0);
+    }
+    assert(storage_directory_commit(directory) == 0);
+    storage_directory_unmount(directory);
+
+    // The capacity comes from the medium now, not the argument
+    directory = storage_directory_mount(&medium, 10);
+    assert(directory != NULL);
+    assert(storage_directory_get_capacity(directory) == capacity);
+    for (int i = 0; i < 5000; i++) {
+        snprintf(key, sizeof(key), "item.%d", i);
+        int value = -1;
+        size_t actual = 0;
+        if (i % 3 == 0) {
+            assert(!storage_directory_exists(directory, key));
+        } else {
+            assert(storage_directory_read(directory, key, &value, sizeof(value), &actual) == 0);
+            assert(value == i);
+        }
+    }
+
+    // Fill up to the capacity, then one more key is refused
+    int live = 5000 - (5000 + 2) / 3;
+    for (int i = 5000; live < capacity; i++, live++) {
+        snprintf(key, sizeof(key), "item.%d", i);
+        assert(storage_directory_write(directory, key, &i, sizeof(i)) == 0);
+    }
+    assert(storage_directory_write(directory, "one.more", key, 1) == -3);
+    assert(storage_directory_write(directory, "item.1", key, 1) == 0);
+    storage_directory_unmount(directory);
+    free(buffer);
+
+    printf("Many keys test passed!\n\n");
+}
+
+static void test_prefix_enumeration() {
+    printf("Testing prefix enumeration...\n");
+
+    StorageMedium medium;
+    uint8_t* buffer = new_medium(&medium, 256 * 1024);
+    StorageDirectory* directory = storage_directory_mount(&medium, 512);
+    assert(directory != NULL);
+
+    char key[32];
+    for (int i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "driver_%03d", i);
+        assert(storage_directory_write(directory, key, &i, sizeof(i)) == 0);
+        snprintf(key, sizeof(key), "rule.%03d", i);
+        assert(storage_directory_write(directory, key, &i, sizeof(i)) == 0);
+    }
+    assert(storage_directory_write(directory, "driver", key, 1) == 0);
+    assert(storage_directory_write(directory, "config.port", key, 1) == 0);
+
+    char* keys[256];
+    int count = storage_directory_get_keys(directory, "driver_", keys, 256);
+    assert(count == 100);
+    for (int i = 0; i < count; i++) {
+        snprintf(key, sizeof(key), "driver_%03d", i);
+        assert(strcmp(keys[i], key) == 0);
+    }
+    free_keys(keys, count);
+
+    count = storage_directory_get_keys(directory, "rule.05", keys, 256);
+    assert(count == 10 && strcmp(keys[0], "rule.050") == 0);
+    free_keys(keys, count);
+
+    assert(storage_directory_get_keys(directory, "zzz", keys, 256) == 0);
+    assert(storage_directory_get_keys(directory, "config.port.x", keys, 256) == 0);
+
+    count = storage_directory_get_keys(directory, NULL, keys, 256);
+    assert(count == 202);
+    assert(strcmp(keys[0], "config.port") == 0 && strcmp(keys[1], "driver") == 0);
+    free_keys(keys, count);
+
+    // The cached order follows adds and deletes
+    assert(storage_directory_delete(directory, "driver_000") == 0);
+    assert(storage_directory_write(directory, "driver_100", key, 1) == 0);
+    count = storage_directory_get_keys(directory, "driver_", keys, 5);
+    assert(count == 5 && strcmp(keys[0], "driver_001") == 0);
+    free_keys(keys, count);
+    count = storage_directory_get_keys(directory, "driver_1", keys, 256);
+    assert(count == 1 && strcmp(keys[0], "driver_100") == 0);
+    free_keys(keys, count);
+
+    storage_directory_unmount(directory);
+    free(buffer);
+
+    printf("Prefix enumeration test passed!\n\n");
+}
+
+static void test_space_reuse() {
+    printf("Testing space reuse under churn...\n");
+
+    StorageMedium medium;
+    uint8_t* buffer = new_medium(&medium, 32 * 1024);
+    StorageDirectory* directory = storage_directory_mount(&medium, CHURN_KEYS);
+    assert(directory != NULL);
+    int emptySpace = storage_directory_get_free_space(directory);
+
+    // Live data stays well under the data area, so gaps must be reused
+    static uint8_t model[CHURN_KEYS][CHURN_MAX_VALUE];
+    int sizes[CHURN_KEYS];
+    uint8_t value[CHURN_MAX_VALUE];
+    char key[16];
+    srand(7);
+    for (int k = 0; k < CHURN_KEYS; k++) {
+        sizes[k] = -1;
+    }
+
+    for (int op = 0; op < CHURN_OPS; op++) {
+        int k = rand() % CHURN_KEYS;
+        snprintf(key, sizeof(key), "churn.%d", k);
+        if (rand() % 4 == 0 && sizes[k] >= 0) {
+            assert(storage_directory_delete(directory, key) == 0);
+            sizes[k] = -1;
+        } else {
+            int size = rand() % CHURN_MAX_VALUE;
+            for (int i = 0; i < size; i++) {
+                value[i] = (uint8_t)(op + i);
+            }
+            assert(storage_directory_write(directory, key, value, (size_t)size) == 0);
+            memcpy(model[k], value, (size_t)size);
+            sizes[k] = size;
+        }
+        if (op % 1000 == 999) {
+            assert(storage_directory_commit(directory) == 0);
+            storage_directory_unmount(directory);
+            directory = storage_directory_mount(&medium, 0);
+            assert(directory != NULL);
+        }
+    }
+
+    int liveBytes = 0;
+    for (int k = 0; k < CHURN_KEYS; k++) {
+        snprintf(key, sizeof(key), "churn.%d", k);
+        if (sizes[k] < 0) {
+            assert(!storage_directory_exists(directory, key));
+            continue;
+        }
+        size_t actual = 0;
+        assert(storage_directory_read(directory, key, value, sizeof(value), &actual) == 0);
+        assert(actual == (size_t)sizes[k] && memcmp(value, model[k], actual) == 0);
+        liveBytes += sizes[k];
+    }
+    assert(storage_directory_get_free_space(directory) == emptySpace - liveBytes);
+
+    // With everything deleted the gaps merge back into one free area
+    for (int k = 0; k < CHURN_KEYS; k++) {
+        snprintf(key, sizeof(key), "churn.%d", k);
+        storage_directory_delete(directory, key);
+    }
+    assert(storage_directory_get_free_space(directory) == emptySpace);
+    uint8_t* whole = (uint8_t*)malloc((size_t)emptySpace);
+    memset(whole, 0x5A, (size_t)emptySpace);
+
+    // Deleted values are reused once the deletes are committed
+    assert(storage_directory_write(directory, "whole", whole, (size_t)emptySpace) == -2);
+    assert(storage_directory_commit(directory) == 0);
+    assert(storage_directory_write(directory, "whole", whole, (size_t)emptySpace) == 0);
+    assert(storage_directory_write(directory, "extra", whole, 1) == -2);
+
+    // A value that cannot grow keeps its old contents
+    assert(storage_directory_delete(directory, "whole") == 0);
+    assert(storage_directory_write(directory, "first", whole, (size_t)emptySpace / 2) == 0);
+    assert(storage_directory_write(directory, "second", whole, 16) == 0);
+    assert(storage_directory_write(directory, "first", whole, (size_t)emptySpace) == -2);
+    assert(storage_directory_get_size(directory, "first") == emptySpace / 2);
+    assert(storage_directory_get_free_space(directory) == emptySpace - emptySpace / 2 - 16);
+    free(whole);
+
+    storage_directory_unmount(directory);
+    free(buffer);
+
+    printf("Space reuse test passed!\n\n");
+}
+
+static void test_damaged_table() {
+    printf("Testing damaged directory recovery...\n");
+
+    StorageMedium medium;
+    uint8_t* buffer = new_medium(&medium, 64 * 1024);
+    StorageDirectory* directory = storage_directory_mount(&medium, 64);
+    assert(directory != NULL);
+
+    char key[16];
+    for (int i = 0; i < 40; i++) {
+        snprintf(key, sizeof(key), "key.%d", i);
+        assert(storage_directory_write(directory, key, &i, sizeof(i)) == 0);
+    }
+    assert(storage_directory_commit(directory) == 0);
+    storage_directory_unmount(directory);
+
+    // Flip a key byte in the first used slot of each table copy; only that key is lost
+    uint32_t slotCount;
+    memcpy(&slotCount, buffer + 8, sizeof(slotCount));
+    for (uint32_t copy = 0; copy < 2; copy++) {
+        for (uint32_t slot = 1 + copy * slotCount; slot < 1 + (copy + 1) * slotCount; slot++) {
+            if (buffer[slot * SLOT_BYTES + 12] != 0) {
+                buffer[slot * SLOT_BYTES + 16] ^= 0x01;
+                break;
+            }
+        }
+    }
+
+    directory = storage_directory_mount(&medium, 0);
+    assert(directory != NULL);
+    char* keys[64];
+    int count = storage_directory_get_keys(directory, "key.", keys, 64);
+    assert(count == 39);
+    free_keys(keys, count);
+    for (int i = 0; i < 40; i++) {
+        snprintf(key, sizeof(key), "key.%d", i);
+        int value = -1;
+        size_t actual = 0;
+        if (storage_directory_read(directory, key, &value, sizeof(value), &actual) == 0) {
+            assert(value == i);
+        }
+    }
+    assert(storage_directory_commit(directory) == 0);
+    storage_directory_unmount(directory);
+
+    // With both headers corrupt there is no directory to trust
+    buffer[4] ^= 0xFF;
+    buffer[HEADER_BYTES + 4] ^= 0xFF;
+    directory = storage_directory_mount(&medium, 0);
+    assert(directory != NULL);
+    assert(storage_directory_get_keys(directory, NULL, keys, 64) == 0);
+    storage_directory_unmount(directory);
+    free(buffer);
+
+    printf("Damaged directory test passed!\n\n");
+}
+
+static void test_persistent_storage_directory() {
+    printf("Testing persistent storage on the directory layout...\n");
+
+    StorageConfig config = {
+        .type = STORAGE_TYPE_EEPROM,
+        .size = 256 * 1024,
+        .maxKeys = 1000
+    };
+    assert(persistent_storage_init(&config) == 0);
+
+    char key[32];
+    for (int i = 0; i < 500; i++) {
+        snprintf(key, sizeof(key), i % 2 ? "driver_%d" : "rule.%d", i);
+        assert(persistent_storage_write(key, &i, sizeof(i)) == 0);
+    }
+
+    char* keys[512];
+    int count = persistent_storage_get_keys_with_prefix("driver_", keys, 512);
+    assert(count == 250);
+    free_keys(keys, count);
+    count = persistent_storage_get_keys(keys, 512);
+    assert(count == 500);
+    free_keys(keys, count);
+
+    int value = 0;
+    size_t actual = 0;
+    assert(persistent_storage_read("rule.498", &value, sizeof(value), &actual) == 0);
+    assert(value == 498);
+    assert(persistent_storage_delete("rule.498") == 0);
+    assert(persistent_storage_get_free_space() > 0);
+    assert(persistent_storage_deinit() == 0);
+
+    // The log layout filters its keys the same way
+    config.type = STORAGE_TYPE_FLASH;
+    assert(persistent_storage_init(&config) == 0);
+    assert(persistent_storage_write("driver_a", &value, sizeof(value)) == 0);
+    assert(persistent_storage_write("rule.a", &value, sizeof(value)) == 0);
+    count = persistent_storage_get_keys_with_prefix("driver_", keys, 512);
+    assert(count == 1 && strcmp(keys[0], "driver_a") == 0);
+    free_keys(keys, count);
+    assert(persistent_storage_deinit() == 0);
+
+    printf("Persistent storage directory test passed!\n\n");
+}
+
+// The fixed 32-entry table this layout replaces, scanned with strcmp
+typedef struct {
+    char key[32];
+    uint32_t address;
+    uint32_t size;
+} LinearEntry;
+
+static int linear_find(const LinearEntry* entries, int count, const char* key) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(entries[i].key, key) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void bench_directory(int keyCount) {
+    StorageMedium medium;
+    uint8_t* buffer = new_medium(&medium, 4 * 1024 * 1024);
+    StorageDirectory* directory = storage_directory_mount(&medium, (uint32_t)keyCount);
+    assert(directory != NULL);
+
+    LinearEntry* linear = (LinearEntry*)calloc((size_t)keyCount, sizeof(LinearEntry));
+    char (*names)[32] = (char (*)[32])malloc((size_t)keyCount * 32);
+    for (int i = 0; i < keyCount; i++) {
+        snprintf(names[i], 32, "group%02d/item%d", i % BENCH_GROUPS, i);
+        assert(storage_directory_write(directory, names[i], &i, sizeof(i)) == 0);
+        strcpy(linear[i].key, names[i]);
+    }
+    assert(storage_directory_commit(directory) == 0);
+
+    // Hits in a scrambled order, then misses
+    int value = 0;
+    size_t actual = 0;
+    uint32_t step = 2654435761u;
+    double start = now_seconds();
+    for (uint32_t i = 0; i < BENCH_LOOKUPS; i++) {
+        int k = (int)((i * step) % (uint32_t)keyCount);
+        assert(storage_directory_read(directory, names[k], &value, sizeof(value), &actual) == 0);
+    }
+    double hit = (now_seconds() - start) / BENCH_LOOKUPS;
+
+    start = now_seconds();
+    for (uint32_t i = 0; i < BENCH_LOOKUPS; i++) {
+        assert(!storage_directory_exists(directory, "group99/missing"));
+    }
+    double miss = (now_seconds() - start) / BENCH_LOOKUPS;
+
+    int linearLookups = BENCH_LOOKUPS / (keyCount / 32 + 1);
+    int found = 0;
+    start = now_seconds();
+    for (int i = 0; i < linearLookups; i++) {
+        int k = (int)(((uint32_t)i * step) % (uint32_t)keyCount);
+        found += linear_find(linear, keyCount, names[k]) >= 0;
+    }
+    double linearHit = (now_seconds() - start) / linearLookups;
+    assert(found == linearLookups);
+
+    char** keys = (char**)malloc((size_t)keyCount * sizeof(char*));
+    double all = 0;
+    double prefix = 0;
+    for (int e = 0; e < BENCH_ENUMERATIONS; e++) {
+        // Adding a key drops the cached order, so every pass pays for the sort
+        storage_directory_delete(directory, "bench.marker");
+        assert(storage_directory_write(directory, "bench.marker", &e, sizeof(e)) == 0);
+
+        start = now_seconds();
+        int count = storage_directory_get_keys(directory, NULL, keys, (size_t)keyCount);
+        all += now_seconds() - start;
+        free_keys(keys, count);
+
+        start = now_seconds();
+        count = storage_directory_get_keys(directory, "group07/", keys, (size_t)keyCount);
+        prefix += now_seconds() - start;
+        assert(count == keyCount / BENCH_GROUPS + (keyCount % BENCH_GROUPS > 7));
+        free_keys(keys, count);
+    }
+
+    printf("  %6d %10.0f %10.0f %12.0f %12.1f %12.1f\n",
+           keyCount, hit * 1e9, miss * 1e9, linearHit * 1e9,
+           all / BENCH_ENUMERATIONS * 1e6, prefix / BENCH_ENUMERATIONS * 1e6);
+
+    free(keys);
+    free(names);
+    free(linear);
+    storage_directory_unmount(directory);
+    free(buffer);
+}
+
+static void bench_lookup_and_enumerate() {
+    printf("Benchmarking lookup (ns) and enumeration (us, 1/%d of keys match the prefix)...\n", BENCH_GROUPS);
+    printf("  %6s %10s %10s %12s %12s %12s\n",
+           "keys", "hit", "miss", "linear hit", "all keys", "prefix");
+
+    static const int counts[] = { 32, 1000, 10000 };
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        bench_directory(counts[i]);
+    }
+    printf("\n");
+}
+
+// Read a key and check its size and fill byte
+static void check_value(StorageDirectory* directory, const char* key, size_t size, uint8_t fill) {
+    uint8_t value[256];
+    size_t actual = 0;
+    assert(storage_directory_read(directory, key, value, sizeof(value), &actual) == 0);
+    assert(actual == size);
+    for (size_t i = 0; i < actual; i++) {
+        assert(value[i] == fill);
+    }
+}
+
+static void test_failed_writes() {
+    printf("Testing writes that fail on the medium...\n");
+
+    StorageMedium medium;
+    FailingMedium failing;
+    uint8_t* buffer = new_failing_medium(&medium, &failing, 16 * 1024);
+    StorageDirectory* directory = storage_directory_mount(&medium, 16);
+    assert(directory != NULL);
+
+    uint8_t value[256];
+    memset(value, 0x11, sizeof(value));
+    assert(storage_directory_write(directory, "committed", value, 100) == 0);
+    assert(storage_directory_commit(directory) == 0);
+    memset(value, 0x22, sizeof(value));
+    assert(storage_directory_write(directory, "fresh", value, 100) == 0);
+    int freeSpace = storage_directory_get_free_space(directory);
+
+    // Each path keeps the old value and space: a new extent for a committed
+    // value, a rewrite in place and a larger rewrite of an uncommitted value,
+    // and a new key
+    failing.failWrites = true;
+    memset(value, 0x33, sizeof(value));
+    assert(storage_directory_write(directory, "committed", value, 50) == -5);
+    assert(storage_directory_write(directory, "fresh", value, 50) == -5);
+    assert(storage_directory_write(directory, "fresh", value, 200) == -5);
+    assert(storage_directory_write(directory, "new", value, 10) == -5);
+    failing.failWrites = false;
+
+    check_value(directory, "committed", 100, 0x11);
+    check_value(directory, "fresh", 100, 0x22);
+    assert(!storage_directory_exists(directory, "new"));
+    assert(storage_directory_get_free_space(directory) == freeSpace);
+
+    // The space the failed writes took is reused, never the old values'
+    assert(storage_directory_write(directory, "other", value, 200) == 0);
+    check_value(directory, "committed", 100, 0x11);
+    check_value(directory, "fresh", 100, 0x22);
+    check_value(directory, "other", 200, 0x33);
+
+    storage_directory_unmount(directory);
+    free(buffer);
+
+    printf("Failed write test passed!\n\n");
+}
+
+int main() {
+    printf("=== Storage Directory Tests ===\n\n");
+
+    test_basic_operations();
+    test_many_keys();
+    test_prefix_enumeration();
+    test_space_reuse();
+    test_damaged_table();
+    test_failed_writes();
+    test_persistent_storage_directory();
+    bench_lookup_and_enumerate();
+
+    printf("All storage directory tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,601 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "../src/system/storage_flash_sim.h"
+#include "../src/system/storage_ftl.h"
+#include "../src/system/storage_directory.h"
+#include "../src/system/storage_log.h"
+#include "../src/system/persistent_storage.h"
+
+#define BLOCK_SIZE 4096
+#define BLOCK_COUNT 64
+
+// Benchmark workload
+#define BENCH_BLOCKS 256
+#define BENCH_COLD_KEYS 40
+#define BENCH_HOT_KEYS 16
+#define BENCH_UPDATES 20000
+
+static uint32_t s_seed = 4321;
+
+static uint32_t next_random(void) {
+    s_seed = s_seed * 1103515245u + 12345u;
+    return s_seed >> 8;
+}
+
+static StorageFlashSim* create_sim(uint32_t blockCount, uint32_t endurance) {
+    StorageFlashSimConfig config;
+    memset(&config, 0, sizeof(config));
+    config.blockSize = BLOCK_SIZE;
+    config.blockCount = blockCount;
+    config.endurance = endurance;
+    StorageFlashSim* sim = storage_flash_sim_create(&config);
+    assert(sim != NULL);
+    return sim;
+}
+
+static StorageFtl* mount_ftl(const StorageMedium* flash) {
+    StorageFtlConfig config;
+    memset(&config, 0, sizeof(config));
+    config.blockSize = BLOCK_SIZE;
+    return storage_ftl_mount(flash, &config);
+}
+
+static void test_flash_sim() {
+    printf("Testing simulated flash...\n");
+
+    StorageFlashSim* sim = create_sim(4, 3);
+    StorageMedium flash;
+    assert(storage_flash_sim_get_medium(sim, &flash) == 0);
+    assert(flash.size == 4 * BLOCK_SIZE);
+
+    // Programming clears bits, erasing sets them
+    uint8_t byte = 0x0F;
+    assert(flash.write(flash.context, 10, &byte, 1) == 0);
+    byte = 0xF1;
+    assert(flash.write(flash.context, 10, &byte, 1) == 0);
+    assert(flash.read(flash.context, 10, &byte, 1) == 0 && byte == 0x01);
+
+    StorageFlashSimStats stats;
+    assert(storage_flash_sim_get_stats(sim, &stats) == 0);
+    assert(stats.bitsRaised == 1 && stats.programs == 2);
+    assert(stats.busyUs == 2 * 700 + 4);
+
+    assert(flash.erase(flash.context, 100, BLOCK_SIZE) == -1);
+    assert(flash.erase(flash.context, 0, BLOCK_SIZE) == 0);
+    assert(flash.read(flash.context, 10, &byte, 1) == 0 && byte == 0xFF);
+    assert(storage_flash_sim_get_erase_count(sim, 0) == 1);
+
+    // Worn-out and bad blocks refuse work
+    assert(flash.erase(flash.context, 0, BLOCK_SIZE) == 0);
+    assert(flash.erase(flash.context, 0, BLOCK_SIZE) == 0);
+    assert(flash.erase(flash.context, 0, BLOCK_SIZE) == -2);
+    assert(flash.write(flash.context, 10, &byte, 1) == -2);
+    assert(storage_flash_sim_mark_bad(sim, 2) == 0);
+    assert(flash.write(flash.context, 2 * BLOCK_SIZE, &byte, 1) == -2);
+    assert(flash.write(flash.context, BLOCK_SIZE, &byte, 1) == 0);
+
+    storage_flash_sim_destroy(sim);
+    printf("Simulated flash test passed!\n\n");
+}
+
+// Apply random writes and erases to the medium and a RAM copy, then compare
+static void exercise(const StorageMedium* medium, uint8_t* shadow, int operations) {
+    static uint8_t data[3000];
+    for (int i = 0; i < operations; i++) {
+        uint32_t size = 1 + next_random() % (next_random() % 4 == 0 ? sizeof(data) : 300);
+        uint32_t offset = next_random() % (medium->size - size);
+
+        if (next_random() % 10 == 0) {
+            assert(medium->erase(medium->context, offset, size) == 0);
+            memset(shadow + offset, 0xFF, size);
+        } else {
+            for (uint32_t j = 0; j < size; j++) {
+                data[j] = (uint8_t)next_random();
+            }
+            assert(medium->write(medium->context, offset, data, size) == 0);
+            memcpy(shadow + offset, data, size);
+        }
+    }
+}
+
+static void check_contents(const StorageMedium* medium, const uint8_t* shadow) {
+    static uint8_t contents[BLOCK_COUNT * BLOCK_SIZE];
+    assert(medium->read(medium->context, 0, contents, medium->size) == 0);
+    assert(memcmp(contents, shadow, medium->size) == 0);
+}
+
+static void test_ftl_translation() {
+    printf("Testing flash translation...\n");
+
+    StorageFlashSim* sim = create_sim(BLOCK_COUNT, 0);
+    StorageMedium flash;
+    storage_flash_sim_get_medium(sim, &flash);
+
+    StorageFtl* ftl = mount_ftl(&flash);
+    assert(ftl != NULL);
+    StorageMedium medium;
+    assert(storage_ftl_get_medium(ftl, &medium) == 0);
+
+    // Spare blocks are kept out of the logical size
+    StorageFtlStats stats;
+    assert(storage_ftl_get_stats(ftl, &stats) == 0);
+    assert(stats.slotsPerBlock == (BLOCK_SIZE - 32) / (256 + 4));
+    assert(stats.logicalPages == (BLOCK_COUNT - BLOCK_COUNT / 8) * stats.slotsPerBlock);
+    assert(medium.size == stats.logicalPages * 256);
+
+    // Unwritten space reads as erased
+    static uint8_t shadow[BLOCK_COUNT * BLOCK_SIZE];
+    memset(shadow, 0xFF, medium.size);
+    check_contents(&medium, shadow);
+
+    // Many times the capacity in random writes, verified along the way
+    for (int round = 0; round < 20; round++) {
+        exercise(&medium, shadow, 2000);
+        check_contents(&medium, shadow);
+    }
+
+    assert(storage_ftl_get_stats(ftl, &stats) == 0);
+    assert(stats.collections > 0);
+    assert(stats.flashPageWrites >= stats.hostPageWrites);
+
+    // Nothing was ever programmed over unerased flash
+    StorageFlashSimStats simStats;
+    storage_flash_sim_get_stats(sim, &simStats);
+    assert(simStats.bitsRaised == 0);
+
+    // The map is rebuilt from flash on the next mount
+    storage_ftl_unmount(ftl);
+    ftl = mount_ftl(&flash);
+    assert(ftl != NULL);
+    storage_ftl_get_medium(ftl, &medium);
+    check_contents(&medium, shadow);
+    exercise(&medium, shadow, 2000);
+    check_contents(&medium, shadow);
+
+    // A different geometry is refused
+    StorageFtlConfig config;
+    memset(&config, 0, sizeof(config));
+    config.blockSize = 3000;
+    assert(storage_ftl_mount(&flash, &config) == NULL);
+
+    storage_ftl_unmount(ftl);
+    storage_flash_sim_destroy(sim);
+    printf("Flash translation test passed!\n\n");
+}
+
+// Medium that silently drops every write and erase after a budget runs out
+typedef struct {
+    StorageMedium inner;
+    int budget;
+} CutMedium;
+
+static int cut_read(void* context, uint32_t offset, void* data, size_t size) {
+    CutMedium* cut = (CutMedium*)context;
+    return cut->inner.read(cut->inner.context, offset, data, size);
+}
+
+static int cut_write(void* context, uint32_t offset, const void* data, size_t size) {
+    CutMedium* cut = (CutMedium*)context;
+    if (cut->budget <= 0) {
+        return 0;
+    }
+    cut->budget--;
+    return cut->inner.write(cut->inner.context, offset, data, size);
+}
+
+static int cut_erase(void* context, uint32_t offset, uint32_t size) {
+    CutMedium* cut = (CutMedium*)context;
+    if (cut->budget <= 0) {
+        return 0;
+    }
+    cut->budget--;
+    return cut->inner.erase(cut->inner.context, offset, size);
+}
+
+static void test_ftl_power_loss() {
+    printf("Testing power loss during flash translation...\n");
+
+    static uint8_t shadow[BLOCK_COUNT * BLOCK_SIZE];
+    static uint8_t previous[BLOCK_COUNT * BLOCK_SIZE];
+    static uint8_t contents[BLOCK_COUNT * BLOCK_SIZE];
+
+    for (int trial = 0; trial < 60; trial++) {
+        StorageFlashSim* sim = create_sim(16, 0);
+        CutMedium cut;
+        storage_flash_sim_get_medium(sim, &cut.inner);
+        cut.budget = 1 << 30;
+
+        StorageMedium flash = cut.inner;
+        flash.read = cut_read;
+        flash.write = cut_write;
+        flash.erase = cut_erase;
+        flash.context = &cut;
+
+        StorageFtl* ftl = mount_ftl(&flash);
+        assert(ftl != NULL);
+        StorageMedium medium;
+        storage_ftl_get_medium(ftl, &medium);
+        memset(shadow, 0xFF, medium.size);
+
+        // Fill the medium a few times over, then cut power somewhere in the next writes
+        exercise(&medium, shadow, 400);
+        cut.budget = 1 + (int)(next_random() % 400);
+
+        uint32_t offset = 0;
+        uint32_t size = 0;
+        while (cut.budget > 0) {
+            memcpy(previous, shadow, medium.size);
+            size = 1 + next_random() % 600;
+            offset = next_random() % (medium.size - size);
+            uint8_t data[600];
+            for (uint32_t j = 0; j < size; j++) {
+                data[j] = (uint8_t)next_random();
+            }
+            assert(medium.write(medium.context, offset, data, size) == 0);
+            memcpy(shadow + offset, data, size);
+        }
+        storage_ftl_unmount(ftl);
+
+        // Everything before the interrupted write survives; its pages hold old or new data
+        StorageMedium raw;
+        storage_flash_sim_get_medium(sim, &raw);
+        ftl = mount_ftl(&raw);
+        assert(ftl != NULL);
+        storage_ftl_get_medium(ftl, &medium);
+        assert(medium.read(medium.context, 0, contents, medium.size) == 0);
+
+        for (uint32_t page = 0; page < medium.size / 256; page++) {
+            const uint8_t* now = contents + page * 256;
+            assert(memcmp(now, previous + page * 256, 256) == 0 || memcmp(now, shadow + page * 256, 256) == 0);
+        }
+        assert(memcmp(contents, previous, offset) == 0);
+        uint32_t end = (offset + size + 255) / 256 * 256;
+        assert(memcmp(contents + end, previous + end, medium.size - end) == 0);
+
+        // And the medium keeps working
+        exercise(&medium, contents, 300);
+        check_contents(&medium, contents);
+
+        storage_ftl_unmount(ftl);
+        storage_flash_sim_destroy(sim);
+    }
+
+    printf("Power loss test passed!\n\n");
+}
+
+// Rewrite a few hot pages over cold data until the part with an endurance of
+// 100 erases wears out, checking that nothing written was lost
+static int wear_out(uint32_t wearLevelThreshold, StorageFtlStats* stats) {
+    StorageFlashSim* sim = create_sim(BLOCK_COUNT, 100);
+    StorageMedium flash;
+    storage_flash_sim_get_medium(sim, &flash);
+    StorageFtlConfig config;
+    memset(&config, 0, sizeof(config));
+    config.blockSize = BLOCK_SIZE;
+    config.wearLevelThreshold = wearLevelThreshold;
+    StorageFtl* ftl = storage_ftl_mount(&flash, &config);
+    assert(ftl != NULL);
+    StorageMedium medium;
+    storage_ftl_get_medium(ftl, &medium);
+
+    static uint8_t shadow[BLOCK_COUNT * BLOCK_SIZE];
+    static uint8_t data[256];
+    memset(shadow, 0xFF, medium.size);
+    for (uint32_t offset = 8 * 256; offset < medium.size; offset += 256) {
+        memset(data, (uint8_t)(offset / 256), sizeof(data));
+        assert(medium.write(medium.context, offset, data, sizeof(data)) == 0);
+        memcpy(shadow + offset, data, sizeof(data));
+    }
+
+    int result = 0;
+    int written = 0;
+    while (result == 0) {
+        uint32_t page = next_random() % 8;
+        memset(data, (uint8_t)written, sizeof(data));
+        result = medium.write(medium.context, page * 256, data, sizeof(data));
+        if (result == 0) {
+            memcpy(shadow + page * 256, data, sizeof(data));
+            written++;
+        }
+    }
+    assert(result == -2 || result == -5);
+    check_contents(&medium, shadow);
+
+    storage_ftl_get_stats(ftl, stats);
+    storage_ftl_unmount(ftl);
+    storage_flash_sim_destroy(sim);
+    return written;
+}
+
+static void test_ftl_bad_blocks() {
+    printf("Testing bad block handling...\n");
+
+    StorageFlashSim* sim = create_sim(BLOCK_COUNT, 0);
+    StorageMedium flash;
+    storage_flash_sim_get_medium(sim, &flash);
+    StorageFtl* ftl = mount_ftl(&flash);
+    StorageMedium medium;
+    storage_ftl_get_medium(ftl, &medium);
+
+    static uint8_t shadow[BLOCK_COUNT * BLOCK_SIZE];
+    memset(shadow, 0xFF, medium.size);
+    exercise(&medium, shadow, 3000);
+
+    // Blocks failing under live data are retired without losing it
+    for (uint32_t block = 5; block < 10; block++) {
+        storage_flash_sim_mark_bad(sim, block);
+        exercise(&medium, shadow, 1000);
+        check_contents(&medium, shadow);
+    }
+
+    StorageFtlStats stats;
+    storage_ftl_get_stats(ftl, &stats);
+    assert(stats.badBlocks == 5);
+
+    // Retired blocks stay retired after a remount
+    storage_ftl_unmount(ftl);
+    ftl = mount_ftl(&flash);
+    assert(ftl != NULL);
+    storage_ftl_get_medium(ftl, &medium);
+    check_contents(&medium, shadow);
+    storage_ftl_get_stats(ftl, &stats);
+    assert(stats.badBlocks == 5);
+    storage_ftl_unmount(ftl);
+    storage_flash_sim_destroy(sim);
+
+    // Worn-out blocks retire until the part is used up; wear leveling wears
+    // every block nearly to its endurance first
+    StorageFtlStats unleveled;
+    StorageFtlStats leveled;
+    int unleveledWrites = wear_out(1000, &unleveled);
+    int leveledWrites = wear_out(0, &leveled);
+    printf("  %d page writes before wearing out, %d without wear leveling\n", leveledWrites, unleveledWrites);
+    printf("  erase counts %u..%u, %u..%u without\n", leveled.eraseCountMin, leveled.eraseCountMax,
+           unleveled.eraseCountMin, unleveled.eraseCountMax);
+    assert(leveled.badBlocks > 0 && leveled.wearLevelMoves > 0);
+    assert(leveled.eraseCountMin >= 80 && unleveled.eraseCountMin < 10);
+    assert(leveledWrites > unleveledWrites);
+
+    printf("Bad block test passed!\n\n");
+}
+
+static void test_persistent_storage_ftl() {
+    printf("Testing persistent storage on the translation layer...\n");
+
+    char image[] = "/tmp/mcp_ftl_XXXXXX";
+    int fd = mkstemp(image);
+    assert(fd >= 0);
+    close(fd);
+
+    StorageConfig config;
+    memset(&config, 0, sizeof(config));
+    config.type = STORAGE_TYPE_FLASH;
+    config.layout = STORAGE_LAYOUT_DIRECTORY;
+    config.size = 64 * BLOCK_SIZE;
+    config.imagePath = image;
+    config.eraseBlockSize = BLOCK_SIZE;
+    assert(persistent_storage_init(&config) == 0);
+
+    StorageFtlStats stats;
+    assert(persistent_storage_get_ftl_stats(&stats) == 0);
+    assert(persistent_storage_get_total_space() == (int)(stats.logicalPages * 256));
+
+    char key[32];
+    char value[64];
+    for (int round = 0; round < 50; round++) {
+        for (int i = 0; i < 20; i++) {
+            snprintf(key, sizeof(key), "config.%d", i);
+            snprintf(value, sizeof(value), "value %d of %d", round, i);
+            assert(persistent_storage_write(key, value, strlen(value) + 1) == 0);
+        }
+    }
+    assert(persistent_storage_deinit() == 0);
+
+    // The image holds the translated flash, and mounts again
+    assert(persistent_storage_init(&config) == 0);
+    size_t actual = 0;
+    assert(persistent_storage_read("config.7", value, sizeof(value), &actual) == 0);
+    assert(strcmp(value, "value 49 of 7") == 0);
+    assert(persistent_storage_get_ftl_stats(&stats) == 0);
+    assert(stats.eraseCountMax > 0);
+    assert(persistent_storage_deinit() == 0);
+
+    // Without the block size the translation layer is not used
+    config.eraseBlockSize = 0;
+    config.imagePath = NULL;
+    assert(persistent_storage_init(&config) == 0);
+    assert(persistent_storage_get_ftl_stats(&stats) == -2);
+    assert(persistent_storage_deinit() == 0);
+
+    // A block size that does not divide the storage is refused
+    config.eraseBlockSize = 3000;
+    assert(persistent_storage_init(&config) != 0);
+
+    unlink(image);
+    printf("Persistent storage translation layer test passed!\n\n");
+}
+
+// Medium that rewrites flash in place by erasing and reprogramming whole blocks
+static StorageMedium s_inPlaceFlash;
+static uint8_t s_blockBuffer[BLOCK_SIZE];
+
+static int in_place_read(void* context, uint32_t offset, void* data, size_t size) {
+    (void)context;
+    return s_inPlaceFlash.read(s_inPlaceFlash.context, offset, data, size);
+}
+
+static int in_place_update(uint32_t offset, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        uint32_t block = offset / BLOCK_SIZE;
+        uint32_t within = offset % BLOCK_SIZE;
+        size_t chunk = BLOCK_SIZE - within < size ? BLOCK_SIZE - within : size;
+        uint32_t base = block * BLOCK_SIZE;
+
+        // Program directly when only bits are cleared, otherwise erase and rewrite the block
+        s_inPlaceFlash.read(s_inPlaceFlash.context, base, s_blockBuffer, BLOCK_SIZE);
+        bool programmable = true;
+        for (size_t i = 0; i < chunk; i++) {
+            uint8_t next = data != NULL ? data[i] : 0xFF;
+            programmable = programmable && (s_blockBuffer[within + i] & next) == next;
+        }
+        if (programmable) {
+            if (data != NULL && s_inPlaceFlash.write(s_inPlaceFlash.context, offset, data, chunk) != 0) {
+                return -5;
+            }
+        } else {
+            if (data != NULL) {
+                memcpy(s_blockBuffer + within, data, chunk);
+            } else {
+                memset(s_blockBuffer + within, 0xFF, chunk);
+            }
+            if (s_inPlaceFlash.erase(s_inPlaceFlash.context, base, BLOCK_SIZE) != 0 ||
+                s_inPlaceFlash.write(s_inPlaceFlash.context, base, s_blockBuffer, BLOCK_SIZE) != 0) {
+                return -5;
+            }
+        }
+
+        if (data != NULL) {
+            data += chunk;
+        }
+        offset += (uint32_t)chunk;
+        size -= chunk;
+    }
+    return 0;
+}
+
+static int in_place_write(void* context, uint32_t offset, const void* data, size_t size) {
+    (void)context;
+    return in_place_update(offset, (const uint8_t*)data, size);
+}
+
+static int in_place_erase(void* context, uint32_t offset, uint32_t size) {
+    (void)context;
+    return in_place_update(offset, NULL, size);
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t left = *(const uint64_t*)a;
+    uint64_t right = *(const uint64_t*)b;
+    return left < right ? -1 : (left > right ? 1 : 0);
+}
+
+typedef enum {
+    BENCH_IN_PLACE,
+    BENCH_FTL,
+    BENCH_LOG
+} BenchMode;
+
+static void bench_workload(const char* label, BenchMode mode) {
+    StorageFlashSim* sim = create_sim(BENCH_BLOCKS, 0);
+    StorageMedium flash;
+    storage_flash_sim_get_medium(sim, &flash);
+
+    StorageFtl* ftl = NULL;
+    StorageMedium medium = flash;
+    if (mode == BENCH_IN_PLACE) {
+        s_inPlaceFlash = flash;
+        medium.read = in_place_read;
+        medium.write = in_place_write;
+        medium.erase = in_place_erase;
+    } else if (mode == BENCH_FTL) {
+        ftl = mount_ftl(&flash);
+        assert(ftl != NULL);
+        storage_ftl_get_medium(ftl, &medium);
+    }
+
+    StorageDirectory* directory = NULL;
+    StorageLog* log = NULL;
+    if (mode == BENCH_LOG) {
+        log = storage_log_mount(&medium, BLOCK_SIZE);
+        assert(log != NULL);
+    } else {
+        directory = storage_directory_mount(&medium, 128);
+        assert(directory != NULL);
+    }
+
+    // Driver definitions written once, then frequent small config and state saves
+    char key[32];
+    static char value[1500];
+    for (int i = 0; i < BENCH_COLD_KEYS; i++) {
+        snprintf(key, sizeof(key), "driver_%d", i);
+        memset(value, 'a' + i % 26, sizeof(value));
+        int result = log != NULL ? storage_log_write(log, key, value, sizeof(value))
+                                 : storage_directory_write(directory, key, value, sizeof(value));
+        assert(result == 0);
+        assert(log != NULL ? storage_log_sync(log) == 0 : storage_directory_commit(directory) == 0);
+    }
+
+    static uint64_t latencies[BENCH_UPDATES];
+    StorageFlashSimStats stats;
+    for (int i = 0; i < BENCH_UPDATES; i++) {
+        snprintf(key, sizeof(key), "state.%u", next_random() % BENCH_HOT_KEYS);
+        size_t size = 16 + next_random() % 200;
+        memset(value, (char)i, size);
+
+        storage_flash_sim_get_stats(sim, &stats);
+        uint64_t before = stats.busyUs;
+        int result = log != NULL ? storage_log_write(log, key, value, size)
+                                 : storage_directory_write(directory, key, value, size);
+        assert(result == 0);
+        assert(log != NULL ? storage_log_sync(log) == 0 : storage_directory_commit(directory) == 0);
+        storage_flash_sim_get_stats(sim, &stats);
+        latencies[i] = stats.busyUs - before;
+    }
+
+    qsort(latencies, BENCH_UPDATES, sizeof(uint64_t), compare_u64);
+    uint64_t total = 0;
+    for (int i = 0; i < BENCH_UPDATES; i++) {
+        total += latencies[i];
+    }
+
+    uint32_t minErases = UINT32_MAX;
+    uint32_t maxErases = 0;
+    uint64_t sumErases = 0;
+    for (uint32_t block = 0; block < BENCH_BLOCKS; block++) {
+        uint32_t count = storage_flash_sim_get_erase_count(sim, block);
+        minErases = count < minErases ? count : minErases;
+        maxErases = count > maxErases ? count : maxErases;
+        sumErases += count;
+    }
+    double meanErases = (double)sumErases / BENCH_BLOCKS;
+
+    printf("  %-22s %8.2f %8.2f %8.2f %8.2f %8.2f | %6u %8.1f %6u %7.1fx\n", label,
+           total / 1000.0 / BENCH_UPDATES, latencies[BENCH_UPDATES / 2] / 1000.0,
+           latencies[BENCH_UPDATES * 99 / 100] / 1000.0, latencies[BENCH_UPDATES * 999 / 1000] / 1000.0,
+           latencies[BENCH_UPDATES - 1] / 1000.0, minErases, meanErases, maxErases,
+           meanErases > 0 ? maxErases / meanErases : 0.0);
+    assert(stats.bitsRaised == 0);
+
+    storage_directory_unmount(directory);
+    storage_log_unmount(log);
+    storage_ftl_unmount(ftl);
+    storage_flash_sim_destroy(sim);
+}
+
+static void bench_wear() {
+    printf("Benchmarking %d hot-key saves on %d x 4 KB simulated NOR blocks\n", BENCH_UPDATES, BENCH_BLOCKS);
+    printf("  %-22s %8s %8s %8s %8s %8s | %6s %8s %6s %8s\n", "(device ms per save)", "mean", "p50", "p99",
+           "p99.9", "max", "erases", "mean", "max", "max/mean");
+    bench_workload("directory, in place", BENCH_IN_PLACE);
+    bench_workload("directory on FTL", BENCH_FTL);
+    bench_workload("log, direct", BENCH_LOG);
+    printf("\n");
+}
+
+int main() {
+    printf("=== Flash Translation Layer Tests ===\n\n");
+
+    test_flash_sim();
+    test_ftl_translation();
+    test_ftl_power_loss();
+    test_ftl_bad_blocks();
+    test_persistent_storage_ftl();
+    bench_wear();
+
+    printf("All flash translation layer tests passed!\n");
+    return 0;
+}
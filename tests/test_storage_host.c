@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../src/system/persistent_storage.h"
+#include "../src/system/storage_host.h"
+
+// Writes per run in the benchmark (fsync-bound runs use fewer)
+#define BENCH_SMALL_WRITES 2000
+#define BENCH_LARGE_WRITES 200
+#define BENCH_SYNC_DIVISOR 10
+#define BENCH_KEYS 16
+
+// Config-sized value and driver blob
+#define SMALL_VALUE 48
+#define LARGE_VALUE (32 * 1024)
+
+static char s_root[64];
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void make_path(char* path, size_t size, const char* name) {
+    snprintf(path, size, "%s/%s", s_root, name);
+}
+
+static bool file_exists(const char* directory, const char* name) {
+    char path[256];
+    struct stat st;
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+    return stat(path, &st) == 0;
+}
+
+static void test_file_backend() {
+    printf("Testing one-file-per-key backend...\n");
+
+    char directory[128];
+    make_path(directory, sizeof(directory), "keys");
+
+    StorageConfig config = {
+        .type = STORAGE_TYPE_FILE_SYSTEM,
+        .basePath = directory,
+        .syncPolicy = STORAGE_SYNC_ON_COMMIT
+    };
+    assert(persistent_storage_init(&config) == 0);
+
+    static uint8_t blob[LARGE_VALUE];
+    for (size_t i = 0; i < sizeof(blob); i++) {
+        blob[i] = (uint8_t)(i * 13);
+    }
+
+    int port = 8080;
+    assert(persistent_storage_write("config.port", &port, sizeof(port)) == 0);
+    assert(persistent_storage_write("drivers/dht22:blob", blob, sizeof(blob)) == 0);
+    assert(persistent_storage_write(".hidden", "x", 1) == 0);
+    assert(file_exists(directory, "config.port"));
+    assert(file_exists(directory, "drivers%2Fdht22%3Ablob"));
+    assert(file_exists(directory, "%2Ehidden"));
+
+    // Inside a transaction values are staged in RAM but reads see them
+    assert(persistent_storage_begin_transaction() == 0);
+    port = 9090;
+    assert(persistent_storage_write("config.port", &port, sizeof(port)) == 0);
+    assert(persistent_storage_write("config.new", &port, sizeof(port)) == 0);
+    assert(!file_exists(directory, "~config.new"));
+    assert(!file_exists(directory, "config.new"));
+
+    int value = 0;
+    size_t actual = 0;
+    assert(persistent_storage_read("config.port", &value, sizeof(value), &actual) == 0);
+    assert(value == 9090);
+    assert(persistent_storage_exists("config.new"));
+
+    char* keys[8];
+    int count = persistent_storage_get_keys(keys, 8);
+    assert(count == 4);
+    for (int i = 0; i < count; i++) {
+        free(keys[i]);
+    }
+    assert(persistent_storage_end_transaction() == 0);
+    assert(file_exists(directory, "config.new"));
+    assert(!file_exists(directory, "~config.new"));
+
+    assert(persistent_storage_delete(".hidden") == 0);
+    assert(persistent_storage_delete(".hidden") == -2);
+    assert(persistent_storage_get_free_space() > 0);
+    assert(persistent_storage_deinit() == 0);
+
+    // Everything survives a restart
+    assert(persistent_storage_init(&config) == 0);
+    assert(persistent_storage_read("config.port", &value, sizeof(value), &actual) == 0);
+    assert(value == 9090 && actual == sizeof(value));
+    assert(persistent_storage_get_size("drivers/dht22:blob") == LARGE_VALUE);
+
+    static uint8_t readBack[LARGE_VALUE];
+    assert(persistent_storage_read("drivers/dht22:blob", readBack, sizeof(readBack), &actual) == 0);
+    assert(actual == sizeof(blob) && memcmp(readBack, blob, sizeof(blob)) == 0);
+
+    count = persistent_storage_get_keys(keys, 8);
+    assert(count == 3);
+    bool foundBlob = false;
+    for (int i = 0; i < count; i++) {
+        foundBlob |= strcmp(keys[i], "drivers/dht22:blob") == 0;
+        free(keys[i]);
+    }
+    assert(foundBlob);
+
+    assert(persistent_storage_clear() == 0);
+    assert(!persistent_storage_exists("config.port"));
+    assert(persistent_storage_deinit() == 0);
+
+    // Values that were never synced are dropped on the next open
+    StorageFiles* files = storage_files_open(directory, true);
+    assert(files != NULL);
+    assert(storage_files_write(files, "uncommitted", "abc", 3) == 0);
+    assert(storage_files_exists(files, "uncommitted"));
+    storage_files_close(files);
+    files = storage_files_open(directory, true);
+    assert(!storage_files_exists(files, "uncommitted"));
+    storage_files_close(files);
+
+    printf("File backend test passed!\n\n");
+}
+
+static void test_image_backend() {
+    printf("Testing memory-mapped image backend...\n");
+
+    static const StorageLayout layouts[] = { STORAGE_LAYOUT_DIRECTORY, STORAGE_LAYOUT_LOG };
+    for (int l = 0; l < 2; l++) {
+        char image[128];
+        make_path(image, sizeof(image), l == 0 ? "directory.img" : "log.img");
+
+        StorageConfig config = {
+            .type = STORAGE_TYPE_FLASH,
+            .size = 256 * 1024,
+            .layout = layouts[l],
+            .imagePath = image
+        };
+        assert(persistent_storage_init(&config) == 0);
+
+        char key[32];
+        for (int i = 0; i < 20; i++) {
+            snprintf(key, sizeof(key), "sensor.%d.offset", i);
+            assert(persistent_storage_write(key, &i, sizeof(i)) == 0);
+        }
+        assert(persistent_storage_delete("sensor.3.offset") == 0);
+        assert(persistent_storage_deinit() == 0);
+
+        struct stat st;
+        assert(stat(image, &st) == 0 && st.st_size == 256 * 1024);
+
+        assert(persistent_storage_init(&config) == 0);
+        for (int i = 0; i < 20; i++) {
+            snprintf(key, sizeof(key), "sensor.%d.offset", i);
+            int value = -1;
+            size_t actual = 0;
+            if (i == 3) {
+                assert(!persistent_storage_exists(key));
+            } else {
+                assert(persistent_storage_read(key, &value, sizeof(value), &actual) == 0);
+                assert(value == i);
+            }
+        }
+        assert(persistent_storage_deinit() == 0);
+    }
+
+    printf("Image backend test passed!\n\n");
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void bench_backend(const char* label, StorageConfig* config, StorageSyncPolicy policy, size_t size) {
+    static uint8_t value[LARGE_VALUE];
+    static double samples[BENCH_SMALL_WRITES];
+    static const char* policyNames[] = { "commit", "always", "none" };
+
+    int writes = size == SMALL_VALUE ? BENCH_SMALL_WRITES : BENCH_LARGE_WRITES;
+    if (policy != STORAGE_SYNC_NONE) {
+        writes /= BENCH_SYNC_DIVISOR;
+    }
+
+    config->syncPolicy = policy;
+    assert(persistent_storage_init(config) == 0);
+
+    char key[32];
+    for (int i = 0; i < writes; i++) {
+        snprintf(key, sizeof(key), "bench.%d", i % BENCH_KEYS);
+        value[0] = (uint8_t)i;
+        double start = now_seconds();
+        assert(persistent_storage_write(key, value, size) == 0);
+        samples[i] = now_seconds() - start;
+    }
+
+    double total = 0;
+    for (int i = 0; i < writes; i++) {
+        total += samples[i];
+    }
+    qsort(samples, (size_t)writes, sizeof(double), compare_doubles);
+    double p99 = samples[writes * 99 / 100];
+
+    int reads = writes * 4;
+    size_t actual = 0;
+    double start = now_seconds();
+    for (int i = 0; i < reads; i++) {
+        snprintf(key, sizeof(key), "bench.%d", i % BENCH_KEYS);
+        assert(persistent_storage_read(key, value, sizeof(value), &actual) == 0);
+    }
+    double readTime = now_seconds() - start;
+
+    persistent_storage_clear();
+    persistent_storage_deinit();
+
+    printf("  %-18s %-7s %6zu %10.1f %10.1f %10.1f %10.2f %10.0f\n",
+           label, policyNames[policy], size,
+           total / writes * 1e6, p99 * 1e6, writes * size / total / 1e6,
+           readTime / reads * 1e6, reads * size / readTime / 1e6);
+}
+
+static void bench_host_backends() {
+    printf("Benchmarking host backends (latency in us, throughput in MB/s)...\n");
+    printf("  %-18s %-7s %6s %10s %10s %10s %10s %10s\n",
+           "backend", "sync", "value", "write", "write p99", "write MB/s", "read", "read MB/s");
+
+    char directory[128];
+    char directoryImage[128];
+    char logImage[128];
+    make_path(directory, sizeof(directory), "bench_keys");
+    make_path(directoryImage, sizeof(directoryImage), "bench_directory.img");
+    make_path(logImage, sizeof(logImage), "bench_log.img");
+
+    StorageConfig files = { .type = STORAGE_TYPE_FILE_SYSTEM, .basePath = directory };
+    StorageConfig mappedDirectory = {
+        .type = STORAGE_TYPE_EEPROM, .size = 1024 * 1024, .imagePath = directoryImage
+    };
+    StorageConfig mappedLog = {
+        .type = STORAGE_TYPE_FLASH, .size = 4 * 1024 * 1024, .segmentSize = 64 * 1024, .imagePath = logImage
+    };
+    StorageConfig ram = { .type = STORAGE_TYPE_EEPROM, .size = 1024 * 1024 };
+
+    static const size_t sizes[] = { SMALL_VALUE, LARGE_VALUE };
+    static const StorageSyncPolicy policies[] = { STORAGE_SYNC_NONE, STORAGE_SYNC_ON_COMMIT, STORAGE_SYNC_ALWAYS };
+
+    for (size_t s = 0; s < 2; s++) {
+        bench_backend("ram (baseline)", &ram, STORAGE_SYNC_NONE, sizes[s]);
+        for (size_t p = 0; p < 3; p += 1) {
+            bench_backend("file per key", &files, policies[p], sizes[s]);
+            bench_backend("mmap directory", &mappedDirectory, policies[p], sizes[s]);
+            bench_backend("mmap log", &mappedLog, policies[p], sizes[s]);
+        }
+    }
+    printf("\n");
+}
+
+static void remove_tree(void) {
+    char command[128];
+    snprintf(command, sizeof(command), "rm -rf %s", s_root);
+    if (system(command) != 0) {
+        printf("Could not remove %s\n", s_root);
+    }
+}
+
+int main() {
+    printf("=== Host Storage Tests ===\n\n");
+
+    snprintf(s_root, sizeof(s_root), "/tmp/mcp_storage_XXXXXX");
+    assert(mkdtemp(s_root) != NULL);
+
+    test_file_backend();
+    test_image_backend();
+    bench_host_backends();
+
+    remove_tree();
+    printf("All host storage tests passed!\n");
+    return 0;
+}